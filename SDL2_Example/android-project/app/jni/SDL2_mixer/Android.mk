@@ -23,6 +23,10 @@ MODPLUG_LIBRARY_PATH := external/libmodplug-0.8.9.0
 SUPPORT_MID_TIMIDITY ?= true
 TIMIDITY_LIBRARY_PATH := timidity
 
+# Enable this to mark the mixing callback, the decoders and the loads as
+# sections in systrace and Perfetto captures, on Android 6.0 and up
+SUPPORT_TRACE ?= false
+
 
 # Build the library
 ifeq ($(SUPPORT_FLAC),true)
@@ -58,10 +62,17 @@ include $(CLEAR_VARS)
 
 LOCAL_MODULE := SDL2_mixer
 
-LOCAL_SRC_FILES := $(notdir $(filter-out %/playmus.c %/playwave.c, $(wildcard $(LOCAL_PATH)/*.c))) \
+LOCAL_SRC_FILES := $(notdir $(filter-out %/playmus.c %/playwave.c %/mixbench.c %/mixer_bus.c, $(wildcard $(LOCAL_PATH)/*.c))) \
+
+# The mixing kernels pick NEON at runtime, so only they get built with it
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_SRC_FILES += mixer_bus.c.neon
+else
+    LOCAL_SRC_FILES += mixer_bus.c
+endif
 
 LOCAL_CFLAGS :=
-LOCAL_LDLIBS :=
+LOCAL_LDLIBS := -lOpenSLES
 LOCAL_STATIC_LIBRARIES :=
 LOCAL_SHARED_LIBRARIES := SDL2
 
@@ -98,6 +109,11 @@ ifeq ($(SUPPORT_MID_TIMIDITY),true)
     LOCAL_STATIC_LIBRARIES += timidity
 endif
 
+ifeq ($(SUPPORT_TRACE),true)
+    LOCAL_CFLAGS += -DMIX_USE_ATRACE
+    LOCAL_LDLIBS += -ldl
+endif
+
 LOCAL_EXPORT_C_INCLUDES += $(LOCAL_PATH)
 
 include $(BUILD_SHARED_LIBRARY)
@@ -110,7 +110,7 @@ extern DECLSPEC void SDLCALL Mix_Quit(void);
 
 /* The internal format for an audio chunk */
 typedef struct Mix_Chunk {
-    int allocated;
+    int allocated;      /* 0 if abuf belongs to the app, 1 if malloc'd, 2 if mapped, 3 if streamed, 4 if ADPCM */
     Uint8 *abuf;
     Uint32 alen;
     Uint8 volume;       /* Per-sample volume, 0-128 */
@@ -123,6 +123,21 @@ typedef enum {
     MIX_FADING_IN
 } Mix_Fading;
 
+/* What to do when a sound is played on channel -1 and no channel is free */
+typedef enum {
+    MIX_STEAL_NONE,             /* fail, the default */
+    MIX_STEAL_OLDEST,           /* stop the sound that has played longest */
+    MIX_STEAL_QUIETEST,         /* stop the sound with the lowest volume */
+    MIX_STEAL_LOWEST_PRIORITY   /* stop the least important sound, then the oldest */
+} Mix_StealPolicy;
+
+/* How channels played at another rate, and MIDI instruments, are interpolated */
+typedef enum {
+    MIX_RESAMPLE_LINEAR,        /* the default */
+    MIX_RESAMPLE_CUBIC,         /* smoother, for more CPU */
+    MIX_RESAMPLE_NEAREST        /* cheapest and harshest, MIDI only */
+} Mix_Resampler;
+
 /* These are types of music files (not libraries used to load them) */
 typedef enum {
     MUS_NONE,
@@ -137,15 +152,58 @@ typedef enum {
     MUS_MODPLUG_UNUSED
 } Mix_MusicType;
 
+/* Number of music types, keep it after the last one above */
+#define MIX_MUSIC_TYPES (MUS_MODPLUG_UNUSED + 1)
+
 /* The internal format for a music chunk interpreted via mikmod */
 typedef struct _Mix_Music Mix_Music;
 
-/* Open the mixer with a certain audio format */
+/* A music file being loaded in the background, see Mix_PreloadMUS() */
+typedef struct _Mix_MusicPreload Mix_MusicPreload;
+
+/* Open the mixer with a certain audio format.  A 'frequency' or
+   'chunksize' of 0 is taken as Mix_OpenAudioDevice() takes it.
+ */
 extern DECLSPEC int SDLCALL Mix_OpenAudio(int frequency, Uint16 format, int channels, int chunksize);
 
-/* Open the mixer with specific device and certain audio format */
+/* Open the mixer with specific device and certain audio format.  A
+   'frequency' of 0 picks the device's native sample rate where it reports
+   one (on Android, AudioManager.PROPERTY_OUTPUT_SAMPLE_RATE), and
+   MIX_DEFAULT_FREQUENCY otherwise; any other frequency is asked for as
+   given.  A 'chunksize' of 0 leaves it to the mixer: the smallest multiple
+   of the device's burst size covering 10 ms where it reports one (on
+   Android, AudioManager.PROPERTY_OUTPUT_FRAMES_PER_BUFFER), a power of two
+   otherwise.  Mix_OpenAudio() and Mix_OpenAudioNative() take 0 the same
+   way.
+ */
 extern DECLSPEC int SDLCALL Mix_OpenAudioDevice(int frequency, Uint16 format, int channels, int chunksize, const char* device, int allowed_changes);
 
+/* Open the mixer on the platform's own low latency output rather than an
+   SDL audio device: an OpenSL ES buffer queue on Android, whose callback
+   mixes each buffer directly.  The device's native sample rate is used in
+   place of 'frequency' where it reports one, and 'chunksize' is rounded up
+   to a whole number of the device's bursts at that rate, check
+   Mix_QuerySpec() for what was opened.  The format is AUDIO_S16SYS or
+   AUDIO_F32SYS, float saves the mixer converting its output and falls
+   back to 16-bit where the device can't play it.  Returns -1 if
+   there is no such output, Mix_OpenAudio() still works then.  Close it
+   with Mix_CloseAudio() as usual.
+ */
+extern DECLSPEC int SDLCALL Mix_OpenAudioNative(int frequency, Uint16 format, int channels, int chunksize);
+
+/* Open the mixer without an audio device, for rendering to memory.
+   The format is taken as given.  Nothing is mixed until Mix_RenderOffline()
+   is called, and channel timeouts and fades follow the rendered output
+   rather than the wall clock, so the same calls always give the same audio.
+   Close it with Mix_CloseAudio() as usual.
+ */
+extern DECLSPEC int SDLCALL Mix_OpenAudioOffline(int frequency, Uint16 format, int channels, int chunksize);
+
+/* Mix the next 'len' bytes of output into 'stream', as fast as possible.
+   Returns 0, or -1 if the mixer wasn't opened with Mix_OpenAudioOffline().
+ */
+extern DECLSPEC int SDLCALL Mix_RenderOffline(Uint8 *stream, int len);
+
 /* Dynamically change the number of channels managed by the mixer.
    If decreasing the number of channels, the upper channels are
    stopped.
@@ -153,12 +211,69 @@ extern DECLSPEC int SDLCALL Mix_OpenAudioDevice(int frequency, Uint16 format, in
  */
 extern DECLSPEC int SDLCALL Mix_AllocateChannels(int numchans);
 
+/* Mix the channels on 'threads' extra worker threads (up to 7) whenever at
+   least 'min_channels' of them are playing, 0 threads (the default) mixes
+   everything on the audio thread.  While threaded, channel effects run on
+   the workers and so must not share state between channels, and channel
+   finished callbacks are made at the end of the buffer.  Streamed chunks
+   always stay on the audio thread.
+   This can be called before or after opening the audio device.
+   Returns 0, or -1 if the threads couldn't be started.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMixThreads(int threads, int min_channels);
+
+/* Scheduling for the thread running the audio callback */
+typedef enum {
+    MIX_THREAD_DEFAULT,     /* left as it is */
+    MIX_THREAD_HIGH,        /* audio priority, as Android's own audio threads */
+    MIX_THREAD_REALTIME     /* real-time scheduling, where the app may have it */
+} Mix_ThreadPriority;
+
+/* Ask for 'priority' for the thread running the audio callback and, unless
+   'cpu_mask' is 0, keep it on the cores whose bits are set in it (bit 0 for
+   core 0), such as the big cores of a big.LITTLE device.  The callback
+   applies it to its own thread the next time it runs, and again after the
+   device is reopened; real-time falls back to high priority where it isn't
+   allowed.  Mix_GetMixerStats() tells what was got and which cores the
+   callback ran on.  Pinning only works on Linux and Android.
+   Returns 0, or -1 if 'cpu_mask' names no core that exists.
+ */
+extern DECLSPEC int SDLCALL Mix_SetAudioThreadPolicy(Mix_ThreadPriority priority, Uint32 cpu_mask);
+
+/* Stop the output once nothing has played for 'ms' milliseconds: no
+   channel playing or paused, no music and no music or postmix hook.  The
+   callback stops running, and the output clock with it, until a channel
+   or music starts, a hook is set or a command is queued, which resume it
+   from silence.  0 (the default) keeps the output running.  A device
+   from Mix_OpenAudioDevice() is paused, which still has SDL feed it
+   silence; the Mix_OpenAudioNative() output stops queuing buffers
+   altogether.  Offline output is never suspended.
+   Returns 0, or -1 if 'ms' is negative.
+ */
+extern DECLSPEC int SDLCALL Mix_SetAutoSuspend(int ms);
+extern DECLSPEC int SDLCALL Mix_OutputSuspended(void);
+
+/* Suspend the output, or with 0 let it run again, such as while the app is
+   in the background.  The device stays open and every chunk, music and
+   channel is kept as it is: what was playing carries on from where it was
+   when the output resumes, and what is started while it's paused waits
+   for it.  Mix_OutputSuspended() is 1 while paused.
+   Returns 0, or -1 if the audio isn't open.
+ */
+extern DECLSPEC int SDLCALL Mix_PauseOutput(int pause_on);
+
 /* Find out what the actual audio device parameters are.
    This function returns 1 if the audio has been opened, 0 otherwise.
  */
 extern DECLSPEC int SDLCALL Mix_QuerySpec(int *frequency,Uint16 *format,int *channels);
 
-/* Load a wave file or a music (.mod .s3m .it .xm) file */
+/* Load a wave file or a music (.mod .s3m .it .xm) file.  The samples
+   are converted to the device's format; when that differs from the
+   file's, the samples as loaded are kept too, so that after the device is
+   reopened with another format (a headset at another rate, say) the chunk
+   is converted again in the background instead of having to be reloaded.
+   A chunk not converted yet is converted when it's played.
+ */
 extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAV_RW(SDL_RWops *src, int freesrc);
 #define Mix_LoadWAV(file)   Mix_LoadWAV_RW(SDL_RWFromFile(file, "rb"), 1)
 extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUS(const char *file);
@@ -170,12 +285,203 @@ extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUS_RW(SDL_RWops *src, int freesrc);
 /* Load a music file from an SDL_RWop object assuming a specific format */
 extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int freesrc);
 
+/* Load a music file known to be in format 'type', going straight to that
+   format's decoders: neither Mix_SetMusicCMD() nor the name or header of
+   the file are looked at.  MUS_NONE reads the header to find it out.
+ */
+extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUSType(const char *file, Mix_MusicType type);
+
+/* Where a network stream is, see Mix_GetMusicStreamStatus() */
+typedef enum {
+    MIX_STREAM_CONNECTING,
+    MIX_STREAM_BUFFERING,       /* filling the buffer before playing, or
+                                   again after it ran dry */
+    MIX_STREAM_PLAYING,
+    MIX_STREAM_RECONNECTING,    /* a live stream dropped, what's buffered
+                                   still plays meanwhile */
+    MIX_STREAM_ENDED,           /* all of a stream of known length arrived */
+    MIX_STREAM_FAILED           /* it couldn't be reached or isn't audio */
+} Mix_StreamState;
+
+typedef struct Mix_StreamStatus {
+    Mix_StreamState state;
+    int buffered_ms;            /* audio waiting to be decoded, timed by
+                                   the stream's bitrate */
+    int buffer_ms;              /* what playing waits for the buffer to hold */
+    int bitrate;                /* kbit/s, from the server or the decoder */
+    Uint32 underruns;           /* times the buffer ran dry while playing */
+    Uint32 reconnects;
+    Uint64 bytes_received;      /* of audio, the metadata left out */
+    char name[128];             /* the station's icy-name, UTF-8 */
+    char title[256];            /* StreamTitle of the last ICY metadata */
+} Mix_StreamStatus;
+
+#define MIX_DEFAULT_STREAM_BUFFER_MS    2000
+
+/* Play MP3 music from an http:// address, such as an Icecast or Shoutcast
+   station, with mpg123. Nothing is read here: a worker thread connects
+   and keeps a jitter buffer of 'buffer_ms' milliseconds filled (100 to
+   30000, 0 for the default), and the music plays silence until the buffer
+   holds that much, or again after the network let it run dry. A live
+   stream that drops is reconnected. Network streams can't be seeked or
+   decoded whole, and https:// isn't supported. On Android the app needs
+   the INTERNET permission.
+ */
+extern DECLSPEC Mix_Music * SDLCALL Mix_LoadMUSStream(const char *url, int buffer_ms);
+
+/* Fill in 'status' for music from Mix_LoadMUSStream(), from any thread
+   while the music isn't being freed. Returns 0, or -1 for other music. */
+extern DECLSPEC int SDLCALL Mix_GetMusicStreamStatus(Mix_Music *music, Mix_StreamStatus *status);
+
+/* Load a music file on a background thread, so the calling thread doesn't
+   wait on opening it, finding out its type and parsing its headers. The
+   music is also prepared to play 'loops' times (see Mix_PrepareMusic())
+   and its first buffer decoded, so that a Mix_PlayMusic() of it with the
+   same loops has nothing left to do.
+   The audio device has to be open. Returns NULL if the thread couldn't be
+   started, otherwise every preload has to be collected with
+   Mix_GetPreloadedMUS(), before Mix_CloseAudio() at the latest.
+ */
+extern DECLSPEC Mix_MusicPreload * SDLCALL Mix_PreloadMUS(const char *file, int loops);
+
+/* Returns 1 once the music of 'preload' is loaded (or failed to), so that
+   Mix_GetPreloadedMUS() won't wait, 0 otherwise. */
+extern DECLSPEC int SDLCALL Mix_PreloadedMUSReady(Mix_MusicPreload *preload);
+
+/* Wait for 'preload' to finish and free it, returns its music, or NULL if
+   it couldn't be loaded. */
+extern DECLSPEC Mix_Music * SDLCALL Mix_GetPreloadedMUS(Mix_MusicPreload *preload);
+
+/* Make one music of the 'count' stems of a piece (up to 8), played in
+   lockstep: each is decoded for the same frames and mixed in with a gain
+   of its own, see Mix_FadeMusicLayer(). The first stem keeps the time, its
+   position, duration and end are the layered music's, so the stems should
+   be the same length. Layers all start at full volume. With 'skip_muted'
+   a silent layer other than the first isn't decoded at all, and seeks to
+   where the first one is when it fades back in. Layered music is always
+   decoded in the audio callback, and Mix_GetMusicType() of it is MUS_NONE.
+   On success the stems belong to the layered music and are freed with it,
+   otherwise they're left as they were. Returns NULL on error.
+ */
+extern DECLSPEC Mix_Music * SDLCALL Mix_LoadLayeredMUS(Mix_Music **stems, int count, int skip_muted);
+
+/* Move the gain of 'layer' of a layered music to 'volume' (0 to
+   MIX_MAX_VOLUME), over 'ms' milliseconds or at once with 0. It's applied
+   on top of the music volume, and works whether the music is playing or
+   not, without touching where the layer is in the piece.
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_FadeMusicLayer(Mix_Music *music, int layer, int volume, int ms);
+
 /* Load a wave file of the mixer format from a memory buffer */
 extern DECLSPEC Mix_Chunk * SDLCALL Mix_QuickLoad_WAV(Uint8 *mem);
 
-/* Load raw audio data of the mixer format from a memory buffer */
+/* Load raw audio data of the mixer format from a memory buffer. A chunk
+   shorter than a buffer of the device that plays looping is copied when it
+   starts, so changes to 'mem' while it plays aren't heard. */
 extern DECLSPEC Mix_Chunk * SDLCALL Mix_QuickLoad_RAW(Uint8 *mem, Uint32 len);
 
+/* Load a sound that is decoded as it plays instead of all at once, which
+   suits long compressed sounds (ambience loops and the like). Only a couple
+   of buffers of it are kept decoded, so its abuf and alen describe that
+   look-ahead rather than the whole sound. It takes the same formats as
+   Mix_LoadWAV_RW(). A streamed chunk plays on one channel at a time:
+   starting it again stops it on the channel it was playing on.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAVStreamed_RW(SDL_RWops *src, int freesrc);
+#define Mix_LoadWAVStreamed(file) Mix_LoadWAVStreamed_RW(SDL_RWFromFile(file, "rb"), 1)
+
+/* Set how many bytes at a time the loaders read ahead from the files and
+   streams they are given, so decoders that read a few bytes at a time
+   don't each go to the file (or, on Android, to the asset manager). It
+   applies to the sounds and music loaded after the call; memory streams are
+   never buffered. 0 turns it off, a negative value only asks. Returns the
+   size it was set to before, 16384 unless changed.
+ */
+extern DECLSPEC int SDLCALL Mix_SetReadBufferSize(int bytes);
+
+/* Load a wave file without copying its samples, if it is already in the
+   audio device format: the data is mapped into memory straight from the
+   file, or from the APK on Android (the asset has to be stored uncompressed,
+   e.g. with aaptOptions { noCompress 'wav' }). Anything else is loaded just
+   like Mix_LoadWAV_RW() does. Free it with Mix_FreeChunk() as usual.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAVMapped_RW(SDL_RWops *src, int freesrc);
+#define Mix_LoadWAVMapped(file) Mix_LoadWAVMapped_RW(SDL_RWFromFile(file, "rb"), 1)
+
+/* Load a wave file like Mix_LoadWAV_RW() does, but keep it IMA ADPCM
+   compressed in memory, a quarter of the size of 16-bit samples, and
+   decode it as it is mixed.  This is lossy, and meant for sound effects
+   that are played a lot but don't need the full quality.  abuf and alen
+   hold the compressed data, free it with Mix_FreeChunk() as usual.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAVCompressed_RW(SDL_RWops *src, int freesrc);
+#define Mix_LoadWAVCompressed(file) Mix_LoadWAVCompressed_RW(SDL_RWFromFile(file, "rb"), 1)
+
+/* Load a wave file through a cache shared by the whole program: loading the
+   same file again returns the same chunk, with one more reference to it.
+   Every Mix_LoadWAVCached() needs its own Mix_FreeChunk(), and the chunk is
+   only freed when the last reference is gone. Since the chunk is shared,
+   so is its Mix_VolumeChunk() setting.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAVCached(const char *file);
+
+/* Mix_LoadWAVCached() of an already open stream, such as part of an asset
+   pack, shared and kept on disk under the name 'file' instead of a path.
+   A cached chunk is returned without reading 'src' at all.
+ */
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWAVCached_RW(SDL_RWops *src, int freesrc, const char *file);
+
+/* Keep a copy of every chunk from Mix_LoadWAVCached() in 'path', already
+   converted to the audio device format, so later runs don't have to decode
+   the files again. The directory has to exist. NULL turns this off.
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_SetChunkCacheDir(const char *path);
+
+/* Keep the samples of the loaded chunks under 'bytes' of memory, 0 (the
+   default) for no limit.  Past it, a worker thread writes the chunks that
+   went the longest without playing to the directory of
+   Mix_SetChunkCacheDir() and frees their samples; without that directory
+   nothing is evicted.  Playing an evicted chunk reads it back first, which
+   Mix_PrefetchChunk() gets started on the worker ahead of time.  While a
+   chunk is evicted its abuf is NULL and its alen 0.  Chunks that are
+   playing are never evicted, so the budget can be exceeded for a while.
+   Only chunks from Mix_LoadWAV_RW() and Mix_LoadWAVCached() count.
+   These return 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_SetChunkBudget(Uint32 bytes);
+extern DECLSPEC int SDLCALL Mix_PrefetchChunk(Mix_Chunk *chunk);
+
+/* Load chunks in the background, on a few worker threads.
+   These return a handle for the load, or NULL if it couldn't be started.
+   The callback, if any, is called on the worker thread once the chunk is
+   loaded (with NULL if that failed). Each handle has to be passed to
+   Mix_LoadWait() exactly once, which waits for the load if it is still
+   running, frees the handle and returns the chunk (or NULL on error).
+   Mix_LoadReady() returns 1 if Mix_LoadWait() won't have to wait.
+   Mix_CloseAudio() finishes any pending loads first.
+ */
+typedef struct _Mix_LoadHandle Mix_LoadHandle;
+typedef void (SDLCALL *Mix_LoadCallback)(Mix_Chunk *chunk, void *udata);
+
+extern DECLSPEC Mix_LoadHandle * SDLCALL Mix_LoadWAVAsync_RW(SDL_RWops *src, int freesrc, Mix_LoadCallback callback, void *udata);
+#define Mix_LoadWAVAsync(file, callback, udata) Mix_LoadWAVAsync_RW(SDL_RWFromFile(file, "rb"), 1, callback, udata)
+extern DECLSPEC Mix_LoadHandle * SDLCALL Mix_LoadWAVCachedAsync(const char *file, Mix_LoadCallback callback, void *udata);
+extern DECLSPEC Mix_LoadHandle * SDLCALL Mix_LoadWAVCachedAsync_RW(SDL_RWops *src, int freesrc, const char *file, Mix_LoadCallback callback, void *udata);
+extern DECLSPEC int SDLCALL Mix_LoadReady(Mix_LoadHandle *handle);
+extern DECLSPEC Mix_Chunk * SDLCALL Mix_LoadWait(Mix_LoadHandle *handle);
+
+/* Run the background loads on the application's threads instead of the
+   mixer's own.  The handler is called with a job to run once with data
+   on some other thread, and returns 0 if it took it or -1 if it didn't,
+   which leaves the job to the mixer's loader threads.  Set it before
+   the loads start, NULL goes back to the loader threads.  Mix_CloseAudio()
+   waits for the jobs it handed out, the handler has to run them until then.
+ */
+typedef int (SDLCALL *Mix_JobHandler)(void (SDLCALL *job)(void *data), void *data, void *udata);
+extern DECLSPEC void SDLCALL Mix_SetJobHandler(Mix_JobHandler handler, void *udata);
+
 /* Free an audio chunk previously loaded */
 extern DECLSPEC void SDLCALL Mix_FreeChunk(Mix_Chunk *chunk);
 extern DECLSPEC void SDLCALL Mix_FreeMusic(Mix_Music *music);
@@ -211,17 +517,131 @@ extern DECLSPEC SDL_bool SDLCALL Mix_HasMusicDecoder(const char *name);
 */
 extern DECLSPEC Mix_MusicType SDLCALL Mix_GetMusicType(const Mix_Music *music);
 
+/* Cores Mix_MixerStats counts callbacks on */
+#define MIX_STATS_CPUS  16
+
+/* Profiling counters of the audio callback, since the device was opened or
+   Mix_ResetMixerStats() was last called. Mixing here means everything the
+   callback does (music, channels, effects and the postmix hook).
+ */
+typedef struct Mix_MixerStats {
+    Uint32 callbacks;               /* number of callbacks measured */
+    Uint32 callback_min_us;         /* time spent mixing a callback */
+    Uint32 callback_avg_us;
+    Uint32 callback_max_us;
+    Uint32 callback_p99_us;         /* within 20 microseconds */
+    int active_channels;            /* channels mixed in the last callback */
+    int max_active_channels;
+    Uint64 effects_us;              /* total time in channel and post effects */
+    Uint64 decode_us[MIX_MUSIC_TYPES];  /* total music decode time, by type */
+    Uint32 underruns;               /* callbacks late enough that the device
+                                       most likely ran out of audio */
+    Uint32 suspends;                /* times Mix_SetAutoSuspend() stopped
+                                       the output */
+    Uint32 callback_cpus[MIX_STATS_CPUS];   /* callbacks run on each core, the
+                                               last counts any higher core */
+    Mix_ThreadPriority thread_priority;     /* what the callback's thread got,
+                                               see Mix_SetAudioThreadPolicy() */
+} Mix_MixerStats;
+
+/* Fill in 'stats', returns 0, or -1 on error */
+extern DECLSPEC int SDLCALL Mix_GetMixerStats(Mix_MixerStats *stats);
+extern DECLSPEC void SDLCALL Mix_ResetMixerStats(void);
+
+/* Memory the mixer holds now. Chunks only count if they came from
+   Mix_LoadWAV_RW() or Mix_LoadWAVCached(), and music decoders only by
+   number, what their libraries allocate isn't seen.
+ */
+typedef struct Mix_MemoryStats {
+    Uint64 chunk_bytes;             /* samples of those chunks in memory,
+                                       with copies kept for reconversion */
+    int chunks;
+    int chunks_evicted;             /* written out by Mix_SetChunkBudget() */
+    Uint32 chunk_evictions;         /* times chunks were written out */
+    Uint32 chunk_restores;          /* times they were read back */
+    int musics;                     /* Mix_Music objects not freed yet */
+    Uint64 music_decoded_bytes;     /* samples of the music decoded whole */
+    Uint64 effect_table_bytes;      /* volume tables of the 8-bit formats */
+    Uint64 mixer_bytes;             /* channels and mixing buffers of the
+                                       open device */
+} Mix_MemoryStats;
+
+/* Fill in 'stats', returns 0, or -1 on error */
+extern DECLSPEC int SDLCALL Mix_GetMemoryStats(Mix_MemoryStats *stats);
+
 /* Set a function that is called after all mixing is performed.
    This can be used to provide real-time visual display of the audio stream
    or add a custom mixer filter for the stream data.
 */
 extern DECLSPEC void SDLCALL Mix_SetPostMix(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg);
 
+/* The same, but 'mix_func' gets the mix on the float bus, 'frames' frames
+   of 'channels' interleaved floats with 1.0 at full scale, to change in
+   place. It runs after the MIX_CHANNEL_POST filters and before the mix is
+   measured by Mix_SetAnalysis(), clipped and converted to the device
+   format, so device-format posteffects and Mix_SetPostMix() see what it
+   made. No conversion is done for it whatever the audio format.
+   It can be set along with Mix_SetPostMix(); NULL removes it.
+ */
+extern DECLSPEC void SDLCALL Mix_SetPostMixFloat(void (SDLCALL *mix_func)(void *udata, float *bus, int frames, int channels), void *arg);
+
+/* Levels per channel of at most this many output channels */
+#define MIX_ANALYSIS_CHANNELS   8
+/* The largest spectrum Mix_SetAnalysis() takes */
+#define MIX_ANALYSIS_MAX_FFT    4096
+
+/* What Mix_SetAnalysis() measured of the output, before it was clipped and
+   converted to the device format. 1.0 is full scale throughout.
+ */
+typedef struct Mix_Analysis {
+    Uint64 frame;                   /* output frames up to the end of the
+                                       buffer measured */
+    int freq;                       /* output rate, for the bins' frequencies */
+    int channels;                   /* channels with levels */
+    float rms[MIX_ANALYSIS_CHANNELS];   /* over the last buffer */
+    float peak[MIX_ANALYSIS_CHANNELS];
+    int fft_size;                   /* 0 without a spectrum */
+    float spectrum[MIX_ANALYSIS_MAX_FFT / 2 + 1];   /* magnitude of bin i,
+                                       at i * freq / fft_size Hz, of the
+                                       channels' average over the latest
+                                       fft_size frames, Hann windowed so
+                                       a full scale sine peaks at 1.0 */
+} Mix_Analysis;
+
+/* Measure the output of every buffer, for meters and visualizers, without
+   a postmix callback. The callback measures the levels of each channel, and
+   unless 'fft_size' is 0 a worker thread takes a spectrum of that many
+   frames (a power of two from 64 to MIX_ANALYSIS_MAX_FFT) each buffer.
+   Music alone is mixed through the float bus while this is on. This can be
+   called before or after opening the audio device, and lasts until
+   Mix_SetAnalysis(SDL_FALSE, 0) or until the device is closed.
+   Returns 0, or -1 if the size is wrong or the thread couldn't be started.
+ */
+extern DECLSPEC int SDLCALL Mix_SetAnalysis(SDL_bool enable, int fft_size);
+
+/* Copy the latest measurement into 'analysis', without waiting on the
+   audio callback or the worker. Call it from one thread at a time, the one
+   calling Mix_SetAnalysis().
+   Returns 0, or -1 if analysis is off or nothing was measured yet.
+ */
+extern DECLSPEC int SDLCALL Mix_GetAnalysis(Mix_Analysis *analysis);
+
 /* Add your own music player or additional mixer function.
    If 'mix_func' is NULL, the default music player is re-enabled.
  */
 extern DECLSPEC void SDLCALL Mix_HookMusic(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len), void *arg);
 
+/* The same, but 'mix_func' adds its music to the float bus, 'frames'
+   frames of 'channels' interleaved floats with 1.0 at full scale, which
+   holds silence when it's called. The channels are mixed on top and the
+   bus is clipped once at the end, so nothing is converted on the way in
+   or out. This replaces the music player and any Mix_HookMusic() hook,
+   goes to the bus Mix_RouteMusic() picked, and Mix_GetMusicHookData()
+   returns 'arg'. If 'mix_func' is NULL, the default music player is
+   re-enabled.
+ */
+extern DECLSPEC void SDLCALL Mix_HookMusicFloat(void (SDLCALL *mix_func)(void *udata, float *bus, int frames, int channels), void *arg);
+
 /* Add your own callback for when the music has finished playing or when it is
  * stopped from a call to Mix_HaltMusic.
  */
@@ -245,6 +665,9 @@ extern DECLSPEC void SDLCALL Mix_ChannelFinished(void (SDLCALL *channel_finished
 
 #define MIX_CHANNEL_POST  -2
 
+/* The channel number that stands for a submix bus, see Mix_CreateBus() */
+#define MIX_BUS_CHANNEL(bus)  (-3 - (bus))
+
 /* This is the format of a special effect callback:
  *
  *   myeffect(int chan, void *stream, int len, void *udata);
@@ -275,6 +698,18 @@ typedef void (SDLCALL *Mix_EffectFunc_t)(int chan, void *stream, int len, void *
  */
 typedef void (SDLCALL *Mix_EffectDone_t)(int chan, void *udata);
 
+/* An effect that can read its input from one buffer and write its output
+ *  to another, see Mix_RegisterCopyEffect():
+ *
+ *   mycopyeffect(int chan, const void *src, void *dst, int len, void *udata);
+ *
+ * (src) and (dst) are both (len) bytes and never overlap. Every sample of
+ *  (dst) has to be written, (src) must not be changed.
+ *
+ * DO NOT EVER call SDL_LockAudio() from your callback function!
+ */
+typedef void (SDLCALL *Mix_EffectCopyFunc_t)(int chan, const void *src, void *dst, int len, void *udata);
+
 
 /* Register a special effect function. At mixing time, the channel data is
  *  copied into a buffer and passed through each registered effect function.
@@ -324,6 +759,15 @@ typedef void (SDLCALL *Mix_EffectDone_t)(int chan, void *udata);
  */
 extern DECLSPEC int SDLCALL Mix_RegisterEffect(int chan, Mix_EffectFunc_t f, Mix_EffectDone_t d, void *arg);
 
+/* The same as Mix_RegisterEffect(), with (copy) doing what (f) does while
+ *  reading the chunk and writing the effect buffer. When the effect is the
+ *  first one on a channel the mixer calls (copy) instead of copying the
+ *  chunk and calling (f), saving a pass over the samples; elsewhere in the
+ *  chain and as a posteffect (f) is used. Unregister it through (f).
+ */
+extern DECLSPEC int SDLCALL Mix_RegisterCopyEffect(int chan, Mix_EffectFunc_t f, Mix_EffectCopyFunc_t copy,
+                                                   Mix_EffectDone_t d, void *arg);
+
 
 /* You may not need to call this explicitly, unless you need to stop an
  *  effect from processing in the middle of a chunk's playback.
@@ -460,6 +904,91 @@ extern DECLSPEC int SDLCALL Mix_SetPosition(int channel, Sint16 angle, Uint8 dis
 extern DECLSPEC int SDLCALL Mix_SetDistance(int channel, Uint8 distance);
 
 
+/* Position channels in 3D around a listener instead of by angle and
+ *  distance. The application sets the listener and the rolloff model
+ *  once, then hands over the positions of all its emitters in one call to
+ *  Mix_UpdateEmitters() each frame, which takes the audio lock once for
+ *  the whole batch. The angle and distance of each emitter are worked out
+ *  on the audio thread, the next time the channel is mixed, and applied
+ *  through the same effect as Mix_SetPosition(). Gains ramp between
+ *  updates, so emitters can move every frame.
+ *
+ * Distances are in the application's own units. With MIX_ROLLOFF_INVERSE
+ *  the gain is ref / (ref + factor * (d - ref)), with MIX_ROLLOFF_LINEAR it
+ *  falls from 1 to 1 - factor between ref and max, and with
+ *  MIX_ROLLOFF_EXPONENTIAL it is (d / ref) ^ -factor. The distance is
+ *  clamped to [ref, max] first in every model. The default is
+ *  MIX_ROLLOFF_INVERSE with ref 1, max 1000 and factor 1.
+ */
+typedef enum {
+    MIX_ROLLOFF_NONE,
+    MIX_ROLLOFF_INVERSE,
+    MIX_ROLLOFF_LINEAR,
+    MIX_ROLLOFF_EXPONENTIAL
+} Mix_Rolloff;
+
+typedef struct Mix_Emitter {
+    int channel;
+    float x, y, z;
+} Mix_Emitter;
+
+/* Place the listener at (x, y, z), facing along (at_x, at_y, at_z) with
+ *  (up_x, up_y, up_z) pointing up. The listener starts at the origin,
+ *  facing -z with +y up.
+ */
+extern DECLSPEC void SDLCALL Mix_SetListener(float x, float y, float z,
+                                             float at_x, float at_y, float at_z,
+                                             float up_x, float up_y, float up_z);
+
+/* Pick how emitters get quieter with distance, see above.
+ * returns zero if the parameters are invalid, nonzero otherwise.
+ */
+extern DECLSPEC int SDLCALL Mix_SetRolloff(Mix_Rolloff model, float ref_distance,
+                                           float max_distance, float factor);
+
+/* Move (count) emitters at once; each one's channel is positioned from then
+ *  on, until it finishes playing or Mix_RemoveEmitter() is called.
+ *  MIX_CHANNEL_POST is not accepted as an emitter's channel.
+ * returns the number of emitters updated, which is less than (count) if
+ *  one of them failed. Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_UpdateEmitters(const Mix_Emitter *emitters, int count);
+
+/* Stop positioning (channel) as an emitter.
+ * returns zero if error (no such channel), nonzero otherwise.
+ */
+extern DECLSPEC int SDLCALL Mix_RemoveEmitter(int channel);
+
+/* Position (channel) for headphones: instead of turning one side down,
+ *  Mix_SetPosition() and emitters filter the channel for each ear with a
+ *  short head related transfer function for its angle, so sounds behind
+ *  or to the side are heard there rather than just panned. The sound is
+ *  summed to mono first. It works with stereo devices in any format, on
+ *  the float bus after the channel's other effects, and costs two 1.5 ms
+ *  FIR filters per channel. Mix_SetPanning() still pans as usual.
+ *
+ * The setting stays with the channel whatever it plays, until it's turned
+ *  off or the audio device is closed, and takes effect the next time
+ *  Mix_SetPosition(), Mix_SetDistance() or Mix_UpdateEmitters() is
+ *  called for the channel. MIX_CHANNEL_POST and submix buses are not
+ *  accepted. On other devices than stereo ones this changes nothing.
+ *
+ * returns zero if error (audio not open, no such channel or out of
+ *  memory), nonzero otherwise. Error messages can be retrieved from
+ *  Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetBinaural(int channel, int on);
+
+/* Keep the cost of Mix_SetBinaural() down by letting at most (channels)
+ *  channels be binaural at once, 8 by default. Channels positioned while
+ *  the budget is used up are panned as usual until they're positioned
+ *  again with room in it. -1 leaves the budget as it is.
+ *
+ * returns the budget before the call.
+ */
+extern DECLSPEC int SDLCALL Mix_SetBinauralBudget(int channels);
+
+
 /*
  * !!! FIXME : Haven't implemented, since the effect goes past the
  *              end of the sound buffer. Will have to think about this.
@@ -490,14 +1019,15 @@ extern no_parse_DECLSPEC int SDLCALL Mix_SetReverb(int channel, Uint8 echo);
  *  set to non-zero reverses the chunks's usual channels. If (flip) is zero,
  *  the effect is unregistered.
  *
- * This uses the Mix_RegisterEffect() API internally, and thus is probably
- *  more CPU intensive than having the user just plug in his speakers
- *  correctly. Mix_SetReverseStereo() returns without registering the effect
- *  function if the audio device is not configured for stereo output.
+ * On a channel the sides are swapped as the channel is mixed, after all of
+ *  its effects, which costs nothing. Like an effect, this is undone when
+ *  the channel finishes playing or by Mix_UnregisterAllEffects().
+ *  Mix_SetReverseStereo() returns without doing anything if the audio
+ *  device is not configured for stereo output.
  *
- * If you specify MIX_CHANNEL_POST for (channel), then this the effect is used
- *  on the final mixed stream before sending it on to the audio device (a
- *  posteffect).
+ * If you specify MIX_CHANNEL_POST for (channel), then this uses the
+ *  Mix_RegisterEffect() API on the final mixed stream before sending it on
+ *  to the audio device (a posteffect), and the same goes for a submix bus.
  *
  * returns zero if error (no such channel or Mix_RegisterEffect() fails),
  *  nonzero if reversing effect is enabled. Note that an audio device in mono
@@ -506,6 +1036,84 @@ extern no_parse_DECLSPEC int SDLCALL Mix_SetReverb(int channel, Uint8 echo);
  */
 extern DECLSPEC int SDLCALL Mix_SetReverseStereo(int channel, int flip);
 
+/* Filters for Mix_SetFilter() */
+typedef enum {
+    MIX_FILTER_NONE,
+    MIX_FILTER_LOWPASS,
+    MIX_FILTER_HIGHPASS
+} Mix_FilterType;
+
+/* Run a channel through a 12 dB per octave low-pass or high-pass filter,
+ *  e.g. a low-pass for a sound behind a wall. (cutoff) is in Hz and (q) is
+ *  the resonance, 0.7071 for a flat response. MIX_FILTER_NONE removes the
+ *  filter.
+ *
+ * The filter works on the mixer's float bus, in any audio format, after
+ *  the channel's other effects. Calling this again while the channel plays
+ *  changes the filter without taking the audio lock, so it can be updated
+ *  every frame. Like the other effects it's removed when the channel
+ *  finishes playing.
+ *
+ * If you specify MIX_CHANNEL_POST for (channel), the whole mix is filtered
+ *  before it's clipped, ahead of any other posteffects. MIX_BUS_CHANNEL()
+ *  filters everything routed to a submix bus at once.
+ *
+ * returns zero if error (no such channel or bad parameters), nonzero if
+ *  the filter is set up. Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetFilter(int channel, Mix_FilterType type, float cutoff, float q);
+
+/* Set up the reverb that channels send to with Mix_SetReverbSend().
+ *  (room_size) and (damping) are from 0.0 to 1.0, bigger rooms ring longer
+ *  and more damping takes the treble out of the tail. (wet) is the level
+ *  of the reverb in the mix, 0.0 turns it off.
+ *
+ * There's one reverb for all the channels, it runs once per callback on
+ *  what they send to it and is added to the mix before it's clipped.
+ *
+ * returns zero if error (bad parameters or out of memory), nonzero if the
+ *  reverb is set up. Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetReverb(float room_size, float damping, float wet);
+
+/* Send a channel to the reverb at (level), from 0.0 to 1.0, on top of what
+ *  it adds to the mix. The send is after the channel's volume, fade and
+ *  panning. It's reset to 0.0 when the channel finishes playing.
+ *
+ * returns zero if error (no such channel or bad level), nonzero otherwise.
+ *  Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetReverbSend(int channel, float level);
+
+/* Compress the final mix: everything over (threshold_db) dBFS is reduced
+ *  by (ratio), e.g. 4.0 lets 1 dB through for every 4 dB over. Use a big
+ *  ratio like 100.0 for a limiter, 1.0 or less removes the compressor.
+ *  (attack_ms) and (release_ms) are how fast it reacts to the level going
+ *  up and down, and (makeup_db) is a gain applied after the compression.
+ *
+ * This runs on MIX_CHANNEL_POST on the float bus, before the mix is
+ *  clipped. Calling it again changes the settings without taking the
+ *  audio lock.
+ *
+ * returns zero if error (bad parameters), nonzero if the compressor is set
+ *  up or removed. Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_SetCompressor(float threshold_db, float ratio,
+                                              float attack_ms, float release_ms,
+                                              float makeup_db);
+
+/* Allocate up front what Mix_SetPanning(), Mix_SetDistance() and
+ *  Mix_SetPosition() would otherwise allocate the first time they're used,
+ *  so they don't touch the heap during gameplay: the 64k volume table of an
+ *  8-bit device and the settings of each allocated channel.
+ *  Mix_OpenAudioDevice() already builds the table, call this after
+ *  Mix_AllocateChannels().
+ *
+ * returns zero if error (audio not open or out of memory), nonzero if
+ *  everything is ready. Error messages can be retrieved from Mix_GetError().
+ */
+extern DECLSPEC int SDLCALL Mix_WarmUpEffects(void);
+
 /* end of effects API. --ryan. */
 
 
@@ -539,6 +1147,42 @@ extern DECLSPEC int SDLCALL Mix_GroupOldest(int tag);
 /* Finds the "most recent" (i.e. last) sample playing in a group of channels */
 extern DECLSPEC int SDLCALL Mix_GroupNewer(int tag);
 
+/* Submix buses.
+   Channels routed to a bus are summed into it, the bus's effects run once
+   over the sum, and the bus is added into the master mix at its volume.
+   Effects are put on a bus with the usual functions, such as
+   Mix_RegisterEffect() and Mix_SetFilter(), by passing MIX_BUS_CHANNEL(bus)
+   as the channel. Unlike a channel's, they stay until they're unregistered
+   or the audio device is closed. A bus's Mix_EffectFunc_t effects see it
+   in the device format, clipped, while Mix_SetFilter() works on floats.
+   Buses belong to the open audio device and go away with it.
+ */
+#define MIX_BUS_MASTER  -1
+
+/* Create a bus, or find the one with that name already.
+   Returns the bus number, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_CreateBus(const char *name);
+/* Returns the number of the bus with that name, or -1 if there's none */
+extern DECLSPEC int SDLCALL Mix_GetBus(const char *name);
+/* Route a channel, or all of them if 'which' is -1, to a bus.
+   MIX_BUS_MASTER mixes it straight into the master mix, as by default.
+   The route stays with the channel whatever it plays.
+   Returns true if everything was OK.
+ */
+extern DECLSPEC int SDLCALL Mix_RouteChannel(int which, int bus);
+/* Route all the channels that have a tag, see Mix_GroupChannel().
+   Returns the number of channels routed.
+ */
+extern DECLSPEC int SDLCALL Mix_RouteGroup(int tag, int bus);
+/* Route the music, including a Mix_HookMusic() hook, to a bus */
+extern DECLSPEC int SDLCALL Mix_RouteMusic(int bus);
+/* Set the volume of a bus, from 0 to MIX_MAX_VOLUME, ramped over the next
+   buffer. If 'volume' is -1 it isn't changed. Returns the previous volume,
+   or -1 if there's no such bus.
+ */
+extern DECLSPEC int SDLCALL Mix_BusVolume(int bus, int volume);
+
 /* Play an audio chunk on a specific channel.
    If the specified channel is -1, play on the first free channel.
    If 'loops' is greater than zero, loop the sound that many times.
@@ -548,11 +1192,35 @@ extern DECLSPEC int SDLCALL Mix_GroupNewer(int tag);
 #define Mix_PlayChannel(channel,chunk,loops) Mix_PlayChannelTimed(channel,chunk,loops,-1)
 /* The same as above, but the sound is played at most 'ticks' milliseconds */
 extern DECLSPEC int SDLCALL Mix_PlayChannelTimed(int channel, Mix_Chunk *chunk, int loops, int ticks);
+
+/* Play an audio chunk starting exactly at sample frame 'frame' of the output
+   clock, which counts the frames sent to the device since it was opened.
+   Schedule a little ahead of Mix_GetOutputFrame(): frames already played
+   start at the beginning of the next buffer.
+   Returns which channel was used to play the sound.
+*/
+extern DECLSPEC int SDLCALL Mix_PlayChannelAt(int channel, Mix_Chunk *chunk, int loops, Uint64 frame);
+extern DECLSPEC Uint64 SDLCALL Mix_GetOutputFrame(void);
 extern DECLSPEC int SDLCALL Mix_PlayMusic(Mix_Music *music, int loops);
 
 /* Fade in music or a channel over "ms" milliseconds, same semantics as the "Play" functions */
 extern DECLSPEC int SDLCALL Mix_FadeInMusic(Mix_Music *music, int loops, int ms);
 extern DECLSPEC int SDLCALL Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position);
+
+/* Get 'music' ready to play from the start 'loops' times, ahead of when it's
+   needed: the next Mix_PlayMusic(), Mix_FadeInMusic() or Mix_CrossFadeMusic()
+   of it with the same loops then starts without any decoder set up, and if
+   music is decoded ahead (see Mix_SetMusicDecodeAhead()) it starts filling
+   up right away. Returns 0, or -1 on error (e.g. the music is playing).
+ */
+extern DECLSPEC int SDLCALL Mix_PrepareMusic(Mix_Music *music, int loops);
+
+/* Switch to 'music' with no gap, fading it in over "ms" milliseconds while
+   the music playing before fades out over the same time, both decoding at
+   once. Starting another crossfade before one finishes ends the older music
+   at once. Same semantics as Mix_FadeInMusic() otherwise.
+ */
+extern DECLSPEC int SDLCALL Mix_CrossFadeMusic(Mix_Music *music, int loops, int ms);
 #define Mix_FadeInChannel(channel,chunk,loops,ms) Mix_FadeInChannelTimed(channel,chunk,loops,ms,-1)
 extern DECLSPEC int SDLCALL Mix_FadeInChannelTimed(int channel, Mix_Chunk *chunk, int loops, int ms, int ticks);
 
@@ -562,9 +1230,81 @@ extern DECLSPEC int SDLCALL Mix_FadeInChannelTimed(int channel, Mix_Chunk *chunk
    If the specified volume is -1, just return the current volume.
 */
 extern DECLSPEC int SDLCALL Mix_Volume(int channel, int volume);
+
+/* Play a channel at 'rate' times the normal speed, which raises or lowers
+   its pitch with it, so one chunk can serve several pitches.  The rate goes
+   from 1/256 to 16, 1.0 plays the chunk as it is.  If the specified channel
+   is -1, set the rate for all channels.  Like the volume, the rate stays
+   until it's changed.  Streamed chunks always play at the normal rate.
+   Returns 0, or -1 if the rate is out of range.
+*/
+extern DECLSPEC int SDLCALL Mix_SetChannelRate(int channel, float rate);
+extern DECLSPEC float SDLCALL Mix_GetChannelRate(int channel);
+
+/* Choose how a channel playing at another rate is interpolated.
+   If the specified channel is -1, set it for all channels.
+*/
+extern DECLSPEC int SDLCALL Mix_SetChannelResampler(int channel, Mix_Resampler resampler);
 extern DECLSPEC int SDLCALL Mix_VolumeChunk(Mix_Chunk *chunk, int volume);
+
+/* Set the priority of a chunk for voice stealing: a sound is never stopped
+   to make room for one with a lower priority. The default is 0, the higher
+   the more important. If the specified priority is -1, just return the
+   current priority. Returns the original priority, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_PriorityChunk(Mix_Chunk *chunk, int priority);
+
+/* Limit how a chunk can be played: at most 'max_instances' channels play it
+   at once, and it doesn't start again within 'min_frames' sample frames of
+   the output (see Mix_GetOutputFrame()) of the last time it started. 0 means
+   no limit, for either. Plays over a limit fail, returning -1.
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL Mix_LimitChunk(Mix_Chunk *chunk, int max_instances, int min_frames);
+
+/* Make playing on channel -1 stop another sound when all unreserved channels
+   are busy, picking it with 'policy'. If 'tag' isn't -1, only channels in
+   that group can be stopped. Returns 0.
+ */
+extern DECLSPEC int SDLCALL Mix_SetVoiceStealing(Mix_StealPolicy policy, int tag);
 extern DECLSPEC int SDLCALL Mix_VolumeMusic(int volume);
 
+/* Decode the music 'ms' milliseconds ahead on a thread of its own, so a
+   slow stretch of decoding doesn't hold up the audio callback. 0 (the
+   default) decodes in the audio callback. Only WAVE, Ogg, MP3 and FLAC
+   music is decoded ahead, starting with the next time music is played.
+   The music volume still changes at once, a seek drops what was decoded
+   ahead, and if the decoder ever falls behind the music drops out rather
+   than the whole mixer. Returns 0, or -1 if 'ms' is negative.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMusicDecodeAhead(int ms);
+
+/* Decode music that's no longer than 'ms' milliseconds whole, into the
+   format of the audio device, when it's loaded by Mix_LoadMUS() and the
+   like while the device is open: playing it is then a copy per callback,
+   and loops and seeks cost nothing. 0 (the default) decodes all music as
+   it plays. Only WAVE (without loop points), Ogg, MP3, FLAC and Timidity
+   MIDI music is decoded whole, and Ogg LOOPSTART and LOOPEND still loop
+   as they would. It takes 'ms' * frequency * frame size bytes, so keep it
+   to jingles and short loops. Music played after the device format
+   changed streams from its decoder again.
+   Returns 0, or -1 if 'ms' is negative.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMusicDecodeWhole(int ms);
+
+/* Queue channel commands for the audio callback without taking the
+   audio lock, so they never block the calling thread. They are all meant
+   to be called from one single thread (usually the game loop), and take
+   effect at the start of the next mixing callback.
+   These return 0, or -1 on error (e.g. the queue is full). There is no way
+   to find out which channel Mix_QueuePlayChannel() picked for channel -1.
+ */
+#define Mix_QueuePlayChannel(channel,chunk,loops) Mix_QueuePlayChannelTimed(channel,chunk,loops,-1)
+extern DECLSPEC int SDLCALL Mix_QueuePlayChannelTimed(int channel, Mix_Chunk *chunk, int loops, int ticks);
+extern DECLSPEC int SDLCALL Mix_QueueVolume(int channel, int volume);
+extern DECLSPEC int SDLCALL Mix_QueueHaltChannel(int channel);
+extern DECLSPEC int SDLCALL Mix_QueueFadeOutChannel(int which, int ms);
+
 /* Halt playing of a particular channel */
 extern DECLSPEC int SDLCALL Mix_HaltChannel(int channel);
 extern DECLSPEC int SDLCALL Mix_HaltGroup(int tag);
@@ -607,6 +1347,22 @@ extern DECLSPEC int SDLCALL Mix_PausedMusic(void);
 */
 extern DECLSPEC int SDLCALL Mix_SetMusicPosition(double position);
 
+/* Get the current position in seconds of 'music', or of the playing music
+   if 'music' is NULL.  Audio that is already decoded ahead but not played
+   yet doesn't count.
+   This returns -1.0 if it failed or isn't implemented, which at the moment
+   is the case for everything but WAVE, OGG, FLAC, MP3_MPG and MIDI with
+   the built in Timidity.
+*/
+extern DECLSPEC double SDLCALL Mix_GetMusicPosition(Mix_Music *music);
+
+/* Get the total length in seconds of 'music', or of the playing music if
+   'music' is NULL.
+   This returns -1.0 if the length is unknown or isn't implemented, for the
+   same music formats as Mix_GetMusicPosition().
+*/
+extern DECLSPEC double SDLCALL Mix_MusicDuration(Mix_Music *music);
+
 /* Check the status of a specific channel.
    If the specified channel is -1, check all channels.
 */
@@ -625,6 +1381,99 @@ extern DECLSPEC int SDLCALL Mix_SetSoundFonts(const char *paths);
 extern DECLSPEC const char* SDLCALL Mix_GetSoundFonts(void);
 extern DECLSPEC int SDLCALL Mix_EachSoundFont(int (SDLCALL *function)(const char*, void*), void *data);
 
+/* How the FluidSynth backend interpolates its samples, cheapest first */
+typedef enum {
+    MIX_FLUID_INTERP_NONE,
+    MIX_FLUID_INTERP_LINEAR,
+    MIX_FLUID_INTERP_4THORDER,  /* the default */
+    MIX_FLUID_INTERP_7THORDER
+} Mix_FluidInterpolation;
+
+typedef struct Mix_FluidSynthSettings {
+    int polyphony;              /* 1 to 65535 voices, or 0 for FluidSynth's own (256) */
+    Mix_FluidInterpolation interpolation;
+    int reverb;                 /* 1 (the default) or 0 */
+    int chorus;                 /* 1 (the default) or 0 */
+} Mix_FluidSynthSettings;
+
+/* Change the FluidSynth settings, or go back to the defaults if 'settings'
+   is NULL. They take effect on the next buffer, also for music that is
+   already playing. Values out of range are clamped. The SoundFonts are
+   loaded once and shared by every song, for as long as the audio device is
+   open and Mix_SetSoundFonts() doesn't change them.
+ */
+extern DECLSPEC void SDLCALL Mix_SetFluidSynthSettings(const Mix_FluidSynthSettings *settings);
+extern DECLSPEC void SDLCALL Mix_GetFluidSynthSettings(Mix_FluidSynthSettings *settings);
+
+/* Set the most notes the built-in MIDI player mixes at once, from 1 to 256,
+   or 0 for the default (256). When a note starts with all of them in use,
+   the quietest released note is cut to make room. This takes effect on the
+   next buffer, also for music that is already playing, which gives MIDI
+   playback a hard limit on its CPU cost.
+ */
+extern DECLSPEC void SDLCALL Mix_SetMIDIVoices(int voices);
+extern DECLSPEC int SDLCALL Mix_GetMIDIVoices(void);
+
+/* Choose how the built-in MIDI player interpolates its instruments, which is
+   where most of its time goes. Like Mix_SetMIDIVoices() this also applies to
+   music that is already playing.
+   Returns 0, or -1 if the resampler is unknown.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMIDIResampler(Mix_Resampler resampler);
+extern DECLSPEC Mix_Resampler SDLCALL Mix_GetMIDIResampler(void);
+
+/* Mix the built-in MIDI player's notes on 'threads' extra worker threads
+   (up to 7) whenever at least 'min_voices' of them are sounding, 0 threads
+   (the default) mixes them all on the thread decoding the music. The output
+   is the same either way. This can be called at any time, and the threads
+   are kept until Mix_Quit().
+   Returns 0, or -1 if the threads couldn't be started.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMIDIThreads(int threads, int min_voices);
+
+/* Keep the events the built-in MIDI player parses out of each MIDI file in
+   'dir' (which has to exist already), so that loading the same file at the
+   same output rate again skips the parsing. The files are named after a hash
+   of the MIDI data. NULL, the default, turns the cache off.
+   Returns 0, or -1 if out of memory.
+ */
+extern DECLSPEC int SDLCALL Mix_SetMIDICacheDir(const char *dir);
+extern DECLSPEC const char * SDLCALL Mix_GetMIDICacheDir(void);
+
+/* How the ModPlug backend renders modules, cheapest first */
+typedef enum {
+    MIX_MOD_RESAMPLE_NEAREST,
+    MIX_MOD_RESAMPLE_LINEAR,
+    MIX_MOD_RESAMPLE_SPLINE,
+    MIX_MOD_RESAMPLE_FIR        /* the default */
+} Mix_ModResampler;
+
+typedef struct Mix_ModSettings {
+    Mix_ModResampler resampler;
+    int oversampling;           /* 1 (the default) or 0 */
+    int reverb;                 /* reverb depth, 0 (off, the default) to 100 */
+    int megabass;               /* bass boost, 0 (off, the default) to 100 */
+    int surround;               /* surround depth, 0 (off, the default) to 100 */
+    int max_mix_channels;       /* 32 to 256, or 0 for ModPlug's own (32) */
+} Mix_ModSettings;
+
+/* Change the ModPlug settings, or go back to the defaults if 'settings' is
+   NULL. Everything but max_mix_channels takes effect on the next buffer,
+   also for music that is already playing; max_mix_channels applies to
+   modules loaded afterwards. Values out of range are clamped.
+ */
+extern DECLSPEC void SDLCALL Mix_SetModSettings(const Mix_ModSettings *settings);
+extern DECLSPEC void SDLCALL Mix_GetModSettings(Mix_ModSettings *settings);
+
+/* Have MP3s synthesized straight at the device's rate by mpg123's own
+   resampler, instead of decoded at the file's rate and converted after.
+   That saves a pass over every buffer, though mpg123's resampler is
+   plainer than SDL's. This applies to music loaded afterwards, and to
+   nothing when mpg123 was built without it.
+ */
+extern DECLSPEC void SDLCALL Mix_SetMP3DeviceRate(int enable);
+extern DECLSPEC int SDLCALL Mix_GetMP3DeviceRate(void);
+
 /* Get the Mix_Chunk currently associated with a mixer channel
     Returns NULL if it's an invalid channel, or there's no chunk associated.
 */
@@ -633,10 +1482,14 @@ extern DECLSPEC Mix_Chunk * SDLCALL Mix_GetChunk(int channel);
 /* Close the mixer, halting all playing audio */
 extern DECLSPEC void SDLCALL Mix_CloseAudio(void);
 
-/* We'll use SDL for reporting errors */
+/* We'll use SDL for reporting errors.  Errors from the mixing and decode
+   threads only become messages when Mix_GetError() is called on the
+   thread that had them, so call it rather than SDL_GetError(), and
+   Mix_ClearError() rather than SDL_ClearError().
+ */
 #define Mix_SetError    SDL_SetError
-#define Mix_GetError    SDL_GetError
-#define Mix_ClearError  SDL_ClearError
+extern DECLSPEC const char * SDLCALL Mix_GetError(void);
+extern DECLSPEC void SDLCALL Mix_ClearError(void);
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
@@ -0,0 +1,329 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "chunk_cache.h"
+
+/* On-disk cache files: a header followed by the samples, in little endian */
+#define CACHE_MAGIC     0x4358494d      /* "MIXC" */
+#define CACHE_VERSION   1
+
+typedef struct _Mix_CachedChunk
+{
+    char *file;
+    Sint64 size;        /* size of the source file, to notice changes */
+    int freq;
+    Uint16 format;
+    int channels;
+    Mix_Chunk *chunk;
+    int refcount;
+    struct _Mix_CachedChunk *next;
+} cached_chunk;
+
+static cached_chunk *cached_chunks = NULL;
+static SDL_SpinLock cache_lock = 0;
+static char *cache_dir = NULL;
+
+int Mix_SetChunkCacheDir(const char *path)
+{
+    char *dir = NULL;
+
+    if (path) {
+        dir = SDL_strdup(path);
+        if (!dir) {
+            Mix_SetError("Out of memory");
+            return(-1);
+        }
+    }
+    SDL_AtomicLock(&cache_lock);
+    SDL_free(cache_dir);
+    cache_dir = dir;
+    SDL_AtomicUnlock(&cache_lock);
+    return(0);
+}
+
+/* Must be called with cache_lock held */
+static cached_chunk *find_cached_chunk(const char *file, Sint64 size, int freq, Uint16 format, int channels)
+{
+    cached_chunk *entry;
+
+    for (entry = cached_chunks; entry; entry = entry->next) {
+        if (entry->size == size && entry->freq == freq &&
+            entry->format == format && entry->channels == channels &&
+            SDL_strcmp(entry->file, file) == 0) {
+            return entry;
+        }
+    }
+    return NULL;
+}
+
+/* Build the name of the on-disk cache file for 'file', or NULL if disabled */
+char *_Mix_CacheFilePath(const char *file, const char *ext)
+{
+    char *path = NULL;
+
+    SDL_AtomicLock(&cache_lock);
+    if (cache_dir) {
+        size_t dirlen = SDL_strlen(cache_dir);
+        size_t len = dirlen + 1 + SDL_strlen(file) + SDL_strlen(ext) + 1;
+        path = (char *)SDL_malloc(len);
+        if (path) {
+            char *p;
+            SDL_snprintf(path, len, "%s/%s%s", cache_dir, file, ext);
+            /* Flatten the source path into a single file name */
+            for (p = path + dirlen + 1; *p; ++p) {
+                if (*p == '/' || *p == '\\' || *p == ':') {
+                    *p = '_';
+                }
+            }
+        }
+    }
+    SDL_AtomicUnlock(&cache_lock);
+    return path;
+}
+
+/* Load the samples saved by save_chunk(), if they still match the source */
+static Mix_Chunk *load_chunk(const char *path, const char *file, Sint64 size, int freq, Uint16 format, int channels)
+{
+    SDL_RWops *rw;
+    Mix_Chunk *chunk = NULL;
+    SDL_AudioSpec spec;
+    Uint32 namelen, alen;
+    char *name;
+    SDL_bool ok;
+
+    rw = SDL_RWFromFile(path, "rb");
+    if (!rw) {
+        return NULL;
+    }
+
+    ok = (SDL_ReadLE32(rw) == CACHE_MAGIC &&
+          SDL_ReadLE32(rw) == CACHE_VERSION &&
+          (Sint64)SDL_ReadLE64(rw) == size &&
+          (int)SDL_ReadLE32(rw) == freq &&
+          SDL_ReadLE16(rw) == format &&
+          SDL_ReadLE16(rw) == channels);
+    if (ok) {
+        /* Different sources can flatten to the same file name */
+        namelen = SDL_ReadLE32(rw);
+        ok = (namelen == SDL_strlen(file));
+        if (ok) {
+            name = (char *)SDL_malloc(namelen);
+            ok = (name && SDL_RWread(rw, name, 1, namelen) == namelen &&
+                  SDL_memcmp(name, file, namelen) == 0);
+            SDL_free(name);
+        }
+    }
+    if (ok) {
+        alen = SDL_ReadLE32(rw);
+        chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
+        if (chunk) {
+            chunk->abuf = alen ? (Uint8 *)SDL_malloc(alen) : NULL;
+            if (!chunk->abuf || SDL_RWread(rw, chunk->abuf, 1, alen) != alen) {
+                /* Truncated or unreadable, decode it again */
+                SDL_free(chunk->abuf);
+                SDL_free(chunk);
+                chunk = NULL;
+            } else {
+                chunk->allocated = 1;
+                chunk->alen = alen;
+                chunk->volume = MIX_MAX_VOLUME;
+                spec.freq = freq;
+                spec.format = format;
+                spec.channels = (Uint8)channels;
+                _Mix_KeepChunkSource(chunk, &spec, NULL, 0);
+            }
+        }
+    }
+    SDL_RWclose(rw);
+    return chunk;
+}
+
+static void save_chunk(const char *path, const char *file, Sint64 size, int freq, Uint16 format, int channels, const Mix_Chunk *chunk)
+{
+    SDL_RWops *rw;
+    Uint32 namelen = (Uint32)SDL_strlen(file);
+
+    rw = SDL_RWFromFile(path, "wb");
+    if (!rw) {
+        return;
+    }
+    /* A short write is caught by load_chunk() the next time around */
+    SDL_WriteLE32(rw, CACHE_MAGIC);
+    SDL_WriteLE32(rw, CACHE_VERSION);
+    SDL_WriteLE64(rw, (Uint64)size);
+    SDL_WriteLE32(rw, (Uint32)freq);
+    SDL_WriteLE16(rw, format);
+    SDL_WriteLE16(rw, (Uint16)channels);
+    SDL_WriteLE32(rw, namelen);
+    SDL_RWwrite(rw, file, 1, namelen);
+    SDL_WriteLE32(rw, chunk->alen);
+    SDL_RWwrite(rw, chunk->abuf, 1, chunk->alen);
+    SDL_RWclose(rw);
+}
+
+Mix_Chunk *Mix_LoadWAVCached(const char *file)
+{
+    SDL_RWops *src;
+
+    if (!file) {
+        Mix_SetError("Mix_LoadWAVCached with NULL file");
+        return(NULL);
+    }
+    src = SDL_RWFromFile(file, "rb");
+    if (!src) {
+        return(NULL);
+    }
+    return Mix_LoadWAVCached_RW(src, 1, file);
+}
+
+Mix_Chunk *Mix_LoadWAVCached_RW(SDL_RWops *src, int freesrc, const char *file)
+{
+    cached_chunk *entry;
+    Mix_Chunk *chunk;
+    Sint64 size;
+    int freq, channels;
+    Uint16 format;
+    char *path;
+
+    if (!src) {
+        Mix_SetError("Mix_LoadWAVCached_RW with NULL src");
+        return(NULL);
+    }
+    if (!file) {
+        Mix_SetError("Mix_LoadWAVCached_RW with NULL file");
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+    if (!Mix_QuerySpec(&freq, &format, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+    size = SDL_RWsize(src);
+
+    SDL_AtomicLock(&cache_lock);
+    entry = find_cached_chunk(file, size, freq, format, channels);
+    if (entry) {
+        ++entry->refcount;
+        chunk = entry->chunk;
+    }
+    SDL_AtomicUnlock(&cache_lock);
+    if (entry) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(chunk);
+    }
+
+    /* Try the copy from a previous run before decoding it again */
+    path = _Mix_CacheFilePath(file, ".pcm");
+    chunk = path ? load_chunk(path, file, size, freq, format, channels) : NULL;
+    if (chunk) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+    } else {
+        chunk = Mix_LoadWAV_RW(src, freesrc);
+        if (chunk && path) {
+            save_chunk(path, file, size, freq, format, channels, chunk);
+        }
+    }
+    SDL_free(path);
+    if (!chunk) {
+        return(NULL);
+    }
+
+    entry = (cached_chunk *)SDL_malloc(sizeof(cached_chunk));
+    if (entry) {
+        entry->file = SDL_strdup(file);
+    }
+    if (!entry || !entry->file) {
+        /* Still usable, it just won't be shared */
+        SDL_free(entry);
+        return(chunk);
+    }
+    entry->size = size;
+    entry->freq = freq;
+    entry->format = format;
+    entry->channels = channels;
+    entry->chunk = chunk;
+    entry->refcount = 1;
+
+    SDL_AtomicLock(&cache_lock);
+    {
+        /* Another thread may have loaded the same file meanwhile */
+        cached_chunk *other = find_cached_chunk(file, size, freq, format, channels);
+        Mix_Chunk *shared = NULL;
+        if (other) {
+            ++other->refcount;
+            shared = other->chunk;
+        } else {
+            entry->next = cached_chunks;
+            cached_chunks = entry;
+        }
+        SDL_AtomicUnlock(&cache_lock);
+        if (shared) {
+            SDL_free(entry->file);
+            SDL_free(entry);
+            Mix_FreeChunk(chunk);
+            chunk = shared;
+        }
+    }
+    return(chunk);
+}
+
+SDL_bool _Mix_ReleaseCachedChunk(Mix_Chunk *chunk)
+{
+    cached_chunk *entry, *prev = NULL;
+    SDL_bool in_use = SDL_FALSE;
+
+    SDL_AtomicLock(&cache_lock);
+    for (entry = cached_chunks; entry; prev = entry, entry = entry->next) {
+        if (entry->chunk == chunk) {
+            break;
+        }
+    }
+    if (entry) {
+        if (--entry->refcount > 0) {
+            in_use = SDL_TRUE;
+        } else if (prev) {
+            prev->next = entry->next;
+        } else {
+            cached_chunks = entry->next;
+        }
+    }
+    SDL_AtomicUnlock(&cache_lock);
+
+    if (entry && !in_use) {
+        SDL_free(entry->file);
+        SDL_free(entry);
+    }
+    return in_use;
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,51 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Cache of decoded chunks shared across Mix_LoadWAVCached() calls, plus an
+   optional on-disk copy of their samples in the device format.
+ */
+
+#ifndef CHUNK_CACHE_H_
+#define CHUNK_CACHE_H_
+
+/* Drop one reference to a chunk from Mix_LoadWAVCached().
+   Returns SDL_TRUE if the chunk is still in use and must not be freed.
+ */
+extern SDL_bool _Mix_ReleaseCachedChunk(Mix_Chunk *chunk);
+
+/* Returns the path of 'file' with extension 'ext' in the cache directory
+   set with Mix_SetChunkCacheDir(), to be freed with SDL_free(), or NULL
+   if there is no cache directory.
+ */
+extern char *_Mix_CacheFilePath(const char *file, const char *ext);
+
+/* Remember what 'chunk' was loaded as, so that a device opened with
+   another format gets it converted again, see Mix_LoadWAV_RW().  'source'
+   holds the samples in 'spec' when they differ from the chunk's, and is
+   then the mixer's to free; NULL means abuf still holds them, in the
+   device's format at this point.  Without the memory for the bookkeeping
+   the chunk simply stays as it is.
+ */
+extern void _Mix_KeepChunkSource(Mix_Chunk *chunk, const SDL_AudioSpec *spec, Uint8 *source, Uint32 len);
+
+#endif /* CHUNK_CACHE_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
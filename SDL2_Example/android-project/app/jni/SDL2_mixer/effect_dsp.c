@@ -0,0 +1,724 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+
+  Built-in effects that work on the float bus: filters, a shared reverb
+  and a compressor for the final mix. Whatever the device format, they see
+  floats and never convert, and they work through the buffer in blocks.
+*/
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include "mixer.h"
+#include "mixer_bus.h"
+
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
+
+/* Most channels a device can have */
+#define DSP_MAX_CHANNELS    8
+
+#define DSP_PI              3.14159265358979323846
+
+/* Decibels per natural log unit of amplitude, 20 / ln(10) */
+#define DSP_DB_PER_LOG      8.68588963806503655302
+
+/* Serializes the game threads changing the effects, the audio thread
+   never takes it. Parameters are handed over through triple buffers. */
+static SDL_SpinLock dsp_lock = 0;
+
+
+/*
+ * Filters, see Mix_SetFilter().
+ */
+
+typedef struct _Eff_filtercoefs
+{
+    float b0, b1, b2;
+    float a1, a2;
+} filter_coefs;
+
+typedef struct _Eff_filterargs
+{
+    filter_coefs coefs;             /* the audio thread's copy */
+    float z1[DSP_MAX_CHANNELS];     /* transposed direct form II state */
+    float z2[DSP_MAX_CHANNELS];
+    int channels;
+    filter_coefs set;               /* the game thread's, published below */
+    filter_coefs slots[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+    SDL_atomic_t in_use;
+} filter_args;
+
+static filter_args **filter_args_array = NULL;
+static filter_args *filter_args_post = NULL;
+static int filter_channels = 0;
+static filter_args **filter_args_bus = NULL;    /* see Mix_CreateBus() */
+static int filter_buses = 0;
+
+static void SDLCALL _Eff_filter(int chan, float *buf, int samples, void *udata)
+{
+    filter_args *args = (filter_args *) udata;
+    const int channels = args->channels;
+    const int frames = samples / channels;
+    float b0, b1, b2, a1, a2;
+    int c, i;
+
+    if (_Eff_slot_acquire(&args->middle, &args->front)) {
+        /* The state carries over, so the filter can sweep */
+        args->coefs = args->slots[args->front];
+    }
+    b0 = args->coefs.b0;
+    b1 = args->coefs.b1;
+    b2 = args->coefs.b2;
+    a1 = args->coefs.a1;
+    a2 = args->coefs.a2;
+
+    /* A channel at a time, so the state stays in registers */
+    for (c = 0; c < channels; ++c) {
+        float *ptr = buf + c;
+        float z1 = args->z1[c];
+        float z2 = args->z2[c];
+
+        for (i = 0; i < frames; ++i, ptr += channels) {
+            const float x = *ptr;
+            const float y = b0 * x + z1;
+            z1 = b1 * x - a1 * y + z2;
+            z2 = b2 * x - a2 * y;
+            *ptr = y;
+        }
+
+        /* Don't let a silent channel decay into denormals */
+        if (z1 > -1e-15f && z1 < 1e-15f) {
+            z1 = 0.0f;
+        }
+        if (z2 > -1e-15f && z2 < 1e-15f) {
+            z2 = 0.0f;
+        }
+        args->z1[c] = z1;
+        args->z2[c] = z2;
+    }
+}
+
+/* The args stay allocated for the next time the channel is filtered */
+static void SDLCALL _Eff_FilterDone(int channel, void *udata)
+{
+    SDL_AtomicSet(&((filter_args *) udata)->in_use, 0);
+}
+
+/* From the Audio EQ Cookbook by Robert Bristow-Johnson */
+static void filter_coefficients(filter_coefs *coefs, Mix_FilterType type,
+                                double cutoff, double q, int freq)
+{
+    const double w0 = 2.0 * DSP_PI * cutoff / freq;
+    const double cosw = SDL_cos(w0);
+    const double alpha = SDL_sin(w0) / (2.0 * q);
+    const double a0 = 1.0 + alpha;
+    double b0, b1;
+
+    if (type == MIX_FILTER_LOWPASS) {
+        b1 = 1.0 - cosw;
+        b0 = b1 / 2.0;
+    } else {
+        b1 = -(1.0 + cosw);
+        b0 = -b1 / 2.0;
+    }
+    coefs->b0 = (float) (b0 / a0);
+    coefs->b1 = (float) (b1 / a0);
+    coefs->b2 = coefs->b0;
+    coefs->a1 = (float) (-2.0 * cosw / a0);
+    coefs->a2 = (float) ((1.0 - alpha) / a0);
+}
+
+static void init_filter_args(filter_args *args)
+{
+    SDL_memset(args, '\0', sizeof (filter_args));
+    args->back = 0;
+    args->front = 1;
+    SDL_AtomicSet(&args->middle, 2);
+}
+
+/* Entry 'index' of a list of args, grown to fit */
+static filter_args **filter_slot(filter_args ***list, int *count, int index)
+{
+    void *rc;
+    int i;
+
+    if (index >= *count) {
+        rc = SDL_realloc(*list, (index + 1) * sizeof (filter_args *));
+        if (rc == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+        *list = (filter_args **) rc;
+        for (i = *count; i <= index; i++) {
+            (*list)[i] = NULL;
+        }
+        *count = index + 1;
+    }
+    return(&(*list)[index]);
+}
+
+/* MAKE SURE you hold dsp_lock before calling this! Args that aren't in
+   use start over with a clean state. */
+static filter_args *get_filter_arg(int channel)
+{
+    filter_args **args;
+
+    if (channel == MIX_CHANNEL_POST) {
+        args = &filter_args_post;
+    } else if (channel <= MIX_BUS_CHANNEL(0)) {
+        args = filter_slot(&filter_args_bus, &filter_buses, MIX_BUS_CHANNEL(0) - channel);
+    } else if (channel < 0) {
+        Mix_SetError("Invalid channel number");
+        return(NULL);
+    } else {
+        args = filter_slot(&filter_args_array, &filter_channels, channel);
+    }
+    if (args == NULL) {
+        return(NULL);
+    }
+
+    if (*args == NULL) {
+        *args = (filter_args *) SDL_calloc(1, sizeof (filter_args));
+        if (*args == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+    }
+    if (!SDL_AtomicGet(&(*args)->in_use)) {
+        init_filter_args(*args);
+    }
+
+    return(*args);
+}
+
+int Mix_SetFilter(int channel, Mix_FilterType type, float cutoff, float q)
+{
+    filter_args *args;
+    int freq, channels;
+    int retval = 1;
+
+    if (!Mix_QuerySpec(&freq, NULL, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+    if (type != MIX_FILTER_NONE) {
+        if ((type != MIX_FILTER_LOWPASS && type != MIX_FILTER_HIGHPASS) ||
+            !(cutoff > 0.0f) || !(q > 0.0f)) {
+            Mix_SetError("Invalid filter parameters");
+            return(0);
+        }
+        if (cutoff > 0.49f * freq) {
+            cutoff = 0.49f * freq;
+        }
+    }
+
+    SDL_AtomicLock(&dsp_lock);
+    args = get_filter_arg(channel);
+    if (!args) {
+        SDL_AtomicUnlock(&dsp_lock);
+        return(0);
+    }
+
+    if (type == MIX_FILTER_NONE) {
+        if (SDL_AtomicGet(&args->in_use)) {
+            Mix_LockAudio();
+            retval = _Mix_UnregisterBusEffect_locked(channel, _Eff_filter);
+            Mix_UnlockAudio();
+        }
+        SDL_AtomicUnlock(&dsp_lock);
+        return(retval);
+    }
+
+    filter_coefficients(&args->set, type, cutoff, q, freq);
+    if (SDL_AtomicGet(&args->in_use)) {
+        /* Running already, no need for the audio lock */
+        args->slots[args->back] = args->set;
+        args->back = _Eff_slot_publish(&args->middle, args->back);
+    } else {
+        args->coefs = args->set;
+        args->channels = channels;
+        SDL_AtomicSet(&args->in_use, 1);
+        Mix_LockAudio();
+        retval = _Mix_RegisterBusEffect_locked(channel, _Eff_filter, _Eff_FilterDone, args);
+        Mix_UnlockAudio();
+        if (!retval) {
+            SDL_AtomicSet(&args->in_use, 0);
+        }
+    }
+
+    SDL_AtomicUnlock(&dsp_lock);
+    return(retval);
+}
+
+
+/*
+ * Reverb, see Mix_SetReverb(). A cut down Freeverb: four damped combs and
+ *  two allpasses for each side, fed with the channel sends summed to mono.
+ *  The right side's delays are a little longer, for width.
+ */
+
+#define REVERB_COMBS        4
+#define REVERB_ALLPASSES    2
+#define REVERB_BLOCK        256     /* frames worked through at a time */
+#define REVERB_SPREAD       23
+
+/* Delay lengths at 44100 Hz */
+static const int reverb_comb_tuning[REVERB_COMBS] = { 1116, 1188, 1277, 1356 };
+static const int reverb_allpass_tuning[REVERB_ALLPASSES] = { 556, 441 };
+
+/* Half of Freeverb's input gain, as there are half as many combs */
+#define REVERB_INPUT_GAIN   0.03f
+
+typedef struct _Eff_reverbparams
+{
+    float feedback;
+    float damp;
+    float wet;
+} reverb_params;
+
+typedef struct _Eff_delayline
+{
+    float *buf;
+    int len;
+    int pos;
+    float filt;     /* damping low-pass state, combs only */
+} delay_line;
+
+static struct
+{
+    delay_line combs[2][REVERB_COMBS];
+    delay_line allpasses[2][REVERB_ALLPASSES];
+    float *memory;          /* all the delay lines */
+    int memory_len;
+    int sides;              /* 1 for a mono device, else 2 */
+    int channels;
+    reverb_params params;   /* the audio thread's copy */
+    reverb_params set;      /* the game thread's, published below */
+    reverb_params slots[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+    SDL_bool on;            /* is the mixer's send effect */
+} reverb;
+
+static void reverb_comb(delay_line *d, const float *in, float *out, int frames,
+                        float feedback, float damp)
+{
+    const float undamp = 1.0f - damp;
+    float *buf = d->buf;
+    float filt = d->filt;
+    int pos = d->pos;
+    int i;
+
+    for (i = 0; i < frames; ++i) {
+        const float y = buf[pos];
+        filt = y * undamp + filt * damp;
+        buf[pos] = in[i] + filt * feedback;
+        out[i] += y;
+        if (++pos == d->len) {
+            pos = 0;
+        }
+    }
+
+    if (filt > -1e-15f && filt < 1e-15f) {
+        filt = 0.0f;
+    }
+    d->filt = filt;
+    d->pos = pos;
+}
+
+static void reverb_allpass(delay_line *d, float *io, int frames)
+{
+    float *buf = d->buf;
+    int pos = d->pos;
+    int i;
+
+    for (i = 0; i < frames; ++i) {
+        const float b = buf[pos];
+        buf[pos] = io[i] + b * 0.5f;
+        io[i] = b - io[i];
+        if (++pos == d->len) {
+            pos = 0;
+        }
+    }
+    d->pos = pos;
+}
+
+static void SDLCALL _Eff_reverb(const float *send, float *bus, int samples, void *udata)
+{
+    const int channels = reverb.channels;
+    const float scale = REVERB_INPUT_GAIN / channels;
+    int frames = samples / channels;
+    float in[REVERB_BLOCK], out[REVERB_BLOCK];
+    float wet;
+    int n, i, k, c, s;
+
+    if (_Eff_slot_acquire(&reverb.middle, &reverb.front)) {
+        reverb.params = reverb.slots[reverb.front];
+    }
+    wet = reverb.params.wet;
+
+    while (frames > 0) {
+        n = SDL_min(frames, REVERB_BLOCK);
+
+        for (i = 0; i < n; ++i) {
+            float x = 0.0f;
+            for (c = 0; c < channels; ++c) {
+                x += send[i * channels + c];
+            }
+            in[i] = x * scale;
+        }
+
+        for (s = 0; s < reverb.sides; ++s) {
+            SDL_memset(out, 0, n * sizeof (float));
+            for (k = 0; k < REVERB_COMBS; ++k) {
+                reverb_comb(&reverb.combs[s][k], in, out, n,
+                            reverb.params.feedback, reverb.params.damp);
+            }
+            for (k = 0; k < REVERB_ALLPASSES; ++k) {
+                reverb_allpass(&reverb.allpasses[s][k], out, n);
+            }
+
+            /* Left on the even channels and right on the odd ones, but
+               keep the reverb out of the LFE of 5.1 */
+            for (c = s; c < channels; c += reverb.sides) {
+                if (channels == 6 && c == 5) {
+                    continue;
+                }
+                for (i = 0; i < n; ++i) {
+                    bus[i * channels + c] += out[i] * wet;
+                }
+            }
+        }
+
+        send += n * channels;
+        bus += n * channels;
+        frames -= n;
+    }
+}
+
+/* Set up the delay lines for the device, or clear them if they are */
+static int reverb_alloc(int freq, int channels)
+{
+    float *mem;
+    int len[2][REVERB_COMBS + REVERB_ALLPASSES];
+    int total = 0;
+    int s, k;
+
+    if (reverb.memory != NULL) {
+        SDL_memset(reverb.memory, 0, reverb.memory_len * sizeof (float));
+        for (s = 0; s < reverb.sides; ++s) {
+            for (k = 0; k < REVERB_COMBS; ++k) {
+                reverb.combs[s][k].pos = 0;
+                reverb.combs[s][k].filt = 0.0f;
+            }
+            for (k = 0; k < REVERB_ALLPASSES; ++k) {
+                reverb.allpasses[s][k].pos = 0;
+            }
+        }
+        return(1);
+    }
+
+    reverb.sides = (channels > 1) ? 2 : 1;
+    for (s = 0; s < reverb.sides; ++s) {
+        for (k = 0; k < REVERB_COMBS + REVERB_ALLPASSES; ++k) {
+            const int tuning = (k < REVERB_COMBS) ? reverb_comb_tuning[k] :
+                               reverb_allpass_tuning[k - REVERB_COMBS];
+            len[s][k] = (int) ((Sint64) (tuning + s * REVERB_SPREAD) * freq / 44100);
+            if (len[s][k] < 1) {
+                len[s][k] = 1;
+            }
+            total += len[s][k];
+        }
+    }
+
+    mem = (float *) SDL_calloc(total, sizeof (float));
+    if (mem == NULL) {
+        Mix_SetError("Out of memory");
+        return(0);
+    }
+    reverb.memory = mem;
+    reverb.memory_len = total;
+    reverb.channels = channels;
+    for (s = 0; s < reverb.sides; ++s) {
+        for (k = 0; k < REVERB_COMBS + REVERB_ALLPASSES; ++k) {
+            delay_line *d = (k < REVERB_COMBS) ? &reverb.combs[s][k] :
+                            &reverb.allpasses[s][k - REVERB_COMBS];
+            d->buf = mem;
+            d->len = len[s][k];
+            d->pos = 0;
+            d->filt = 0.0f;
+            mem += len[s][k];
+        }
+    }
+    return(1);
+}
+
+int Mix_SetReverb(float room_size, float damping, float wet)
+{
+    int freq, channels;
+    int retval = 1;
+
+    if (!Mix_QuerySpec(&freq, NULL, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+    if (!(room_size >= 0.0f && room_size <= 1.0f) ||
+        !(damping >= 0.0f && damping <= 1.0f) || !(wet >= 0.0f)) {
+        Mix_SetError("Invalid reverb parameters");
+        return(0);
+    }
+
+    SDL_AtomicLock(&dsp_lock);
+    if (wet == 0.0f) {
+        if (reverb.on) {
+            Mix_LockAudio();
+            _Mix_SetSendEffect_locked(NULL, NULL);
+            Mix_UnlockAudio();
+            reverb.on = SDL_FALSE;
+        }
+        SDL_AtomicUnlock(&dsp_lock);
+        return(1);
+    }
+
+    /* Freeverb's scaling of its controls */
+    reverb.set.feedback = room_size * 0.28f + 0.7f;
+    reverb.set.damp = damping * 0.4f;
+    reverb.set.wet = wet * 3.0f;
+
+    if (reverb.on) {
+        reverb.slots[reverb.back] = reverb.set;
+        reverb.back = _Eff_slot_publish(&reverb.middle, reverb.back);
+    } else if (reverb_alloc(freq, channels)) {
+        reverb.params = reverb.set;
+        reverb.back = 0;
+        reverb.front = 1;
+        SDL_AtomicSet(&reverb.middle, 2);
+        Mix_LockAudio();
+        _Mix_SetSendEffect_locked(_Eff_reverb, NULL);
+        Mix_UnlockAudio();
+        reverb.on = SDL_TRUE;
+    } else {
+        retval = 0;
+    }
+
+    SDL_AtomicUnlock(&dsp_lock);
+    return(retval);
+}
+
+int Mix_SetReverbSend(int channel, float level)
+{
+    int retval;
+
+    if (!(level >= 0.0f && level <= 1.0f)) {
+        Mix_SetError("Invalid send level");
+        return(0);
+    }
+
+    Mix_LockAudio();
+    retval = _Mix_SetChannelSend_locked(channel, level);
+    Mix_UnlockAudio();
+    return(retval);
+}
+
+
+/*
+ * Compressor, see Mix_SetCompressor(). The peak of each block is followed
+ *  by an envelope, and the gain ramps across the block to what the
+ *  envelope calls for, so it's applied with the SIMD gain kernels.
+ */
+
+/* A whole number of _Mix_BusGains() blocks with 1, 2, 4, 6 or 8 channels */
+#define COMPRESSOR_BLOCK    48
+
+typedef struct _Eff_compressorparams
+{
+    float threshold_db;
+    float slope;        /* dB taken off per dB over the threshold */
+    float attack;       /* envelope coefficients per block */
+    float release;
+    float makeup_db;
+} compressor_params;
+
+static struct
+{
+    compressor_params params;   /* the audio thread's copy */
+    float env;                  /* peak envelope */
+    float gain;                 /* where the last block left off */
+    int channels;
+    compressor_params set;      /* the game thread's, published below */
+    compressor_params slots[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+    SDL_atomic_t in_use;
+} compressor;
+
+static void SDLCALL _Eff_compressor(int chan, float *buf, int samples, void *udata)
+{
+    const int channels = compressor.channels;
+    int frames = samples / channels;
+    float gains[DSP_MAX_CHANNELS], steps[DSP_MAX_CHANNELS];
+    float peak, coef, level, over, target, step;
+    int n, i, c;
+
+    if (_Eff_slot_acquire(&compressor.middle, &compressor.front)) {
+        compressor.params = compressor.slots[compressor.front];
+    }
+
+    while (frames > 0) {
+        n = SDL_min(frames, COMPRESSOR_BLOCK);
+
+        peak = 0.0f;
+        for (i = 0; i < n * channels; ++i) {
+            const float x = (buf[i] < 0.0f) ? -buf[i] : buf[i];
+            if (x > peak) {
+                peak = x;
+            }
+        }
+        coef = (peak > compressor.env) ? compressor.params.attack : compressor.params.release;
+        compressor.env = peak + coef * (compressor.env - peak);
+
+        level = (compressor.env > 1e-6f) ? (float) (DSP_DB_PER_LOG * SDL_log(compressor.env)) : -120.0f;
+        over = level - compressor.params.threshold_db;
+        level = compressor.params.makeup_db;
+        if (over > 0.0f) {
+            level -= over * compressor.params.slope;
+        }
+        target = (float) SDL_pow(10.0, level / 20.0);
+
+        /* Reach the new gain on the last frame of the block */
+        step = (target - compressor.gain) / n;
+        for (c = 0; c < channels; ++c) {
+            gains[c] = compressor.gain + step;
+            steps[c] = step;
+        }
+        _Mix_BusGains((Uint8 *) buf, AUDIO_F32SYS, n * channels, channels, gains, steps);
+        compressor.gain = target;
+
+        buf += n * channels;
+        frames -= n;
+    }
+}
+
+static void SDLCALL _Eff_CompressorDone(int channel, void *udata)
+{
+    SDL_AtomicSet(&compressor.in_use, 0);
+}
+
+/* How much of the way to a new level the envelope stays each block, so
+   that it's 99% there after 'ms' milliseconds */
+static float compressor_coef(float ms, int freq)
+{
+    if (ms <= 0.0f) {
+        return 0.0f;
+    }
+    return (float) SDL_pow(0.01, (COMPRESSOR_BLOCK * 1000.0) / ((double) ms * freq));
+}
+
+int Mix_SetCompressor(float threshold_db, float ratio,
+                      float attack_ms, float release_ms, float makeup_db)
+{
+    int freq, channels;
+    int retval = 1;
+
+    if (!Mix_QuerySpec(&freq, NULL, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+
+    SDL_AtomicLock(&dsp_lock);
+    if (!(ratio > 1.0f)) {
+        if (SDL_AtomicGet(&compressor.in_use)) {
+            Mix_LockAudio();
+            retval = _Mix_UnregisterBusEffect_locked(MIX_CHANNEL_POST, _Eff_compressor);
+            Mix_UnlockAudio();
+        }
+        SDL_AtomicUnlock(&dsp_lock);
+        return(retval);
+    }
+    if (!(attack_ms >= 0.0f) || !(release_ms >= 0.0f)) {
+        SDL_AtomicUnlock(&dsp_lock);
+        Mix_SetError("Invalid compressor parameters");
+        return(0);
+    }
+
+    compressor.set.threshold_db = threshold_db;
+    compressor.set.slope = 1.0f - 1.0f / ratio;
+    compressor.set.attack = compressor_coef(attack_ms, freq);
+    compressor.set.release = compressor_coef(release_ms, freq);
+    compressor.set.makeup_db = makeup_db;
+
+    if (SDL_AtomicGet(&compressor.in_use)) {
+        compressor.slots[compressor.back] = compressor.set;
+        compressor.back = _Eff_slot_publish(&compressor.middle, compressor.back);
+    } else {
+        compressor.params = compressor.set;
+        compressor.env = 0.0f;
+        compressor.gain = 1.0f;
+        compressor.channels = channels;
+        compressor.back = 0;
+        compressor.front = 1;
+        SDL_AtomicSet(&compressor.middle, 2);
+        SDL_AtomicSet(&compressor.in_use, 1);
+        Mix_LockAudio();
+        retval = _Mix_RegisterBusEffect_locked(MIX_CHANNEL_POST, _Eff_compressor,
+                                               _Eff_CompressorDone, NULL);
+        Mix_UnlockAudio();
+        if (!retval) {
+            SDL_AtomicSet(&compressor.in_use, 0);
+        }
+    }
+
+    SDL_AtomicUnlock(&dsp_lock);
+    return(retval);
+}
+
+
+void _Eff_DSPDeinit(void)
+{
+    int i;
+
+    for (i = 0; i < filter_channels; i++) {
+        SDL_free(filter_args_array[i]);
+    }
+    SDL_free(filter_args_array);
+    filter_args_array = NULL;
+    filter_channels = 0;
+    for (i = 0; i < filter_buses; i++) {
+        SDL_free(filter_args_bus[i]);
+    }
+    SDL_free(filter_args_bus);
+    filter_args_bus = NULL;
+    filter_buses = 0;
+    SDL_free(filter_args_post);
+    filter_args_post = NULL;
+
+    SDL_free(reverb.memory);
+    SDL_zero(reverb);
+    SDL_AtomicSet(&compressor.in_use, 0);
+}
+
+/* end of effect_dsp.c ... */
+
+/* vi: set ts=4 sw=4 expandtab: */
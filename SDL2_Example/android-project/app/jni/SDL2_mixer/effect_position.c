@@ -34,6 +34,7 @@
 #include "SDL_endian.h"
 #include "SDL_mixer.h"
 #include "mixer.h"
+#include "mixer_bus.h"
 
 #define __MIX_INTERNAL_EFFECT__
 #include "effects_internal.h"
@@ -57,6 +58,31 @@
  * Positional effects...panning, distance attenuation, etc.
  */
 
+/* The longest head related impulse response of Mix_SetBinaural(), in
+   frames; they are 1.5 ms, so this is enough up to 96 kHz */
+#define BINAURAL_MAX_TAPS   160
+
+/* Everything Mix_SetPanning(), Mix_SetDistance() and Mix_SetPosition() set */
+typedef struct _Eff_positionparams
+{
+    float left_f;
+    float right_f;
+    float left_rear_f;
+    float right_rear_f;
+    float center_f;
+    float lfe_f;
+    float distance_f;
+    Uint8 left_u8;
+    Uint8 right_u8;
+    Uint8 left_rear_u8;
+    Uint8 right_rear_u8;
+    Uint8 center_u8;
+    Uint8 lfe_u8;
+    Uint8 distance_u8;
+    Sint16 room_angle;
+    Sint16 angle;               /* what Mix_SetPosition() was given */
+} position_params;
+
 typedef struct _Eff_positionargs
 {
     volatile float left_f;
@@ -74,14 +100,91 @@ typedef struct _Eff_positionargs
     volatile float distance_f;
     volatile Uint8 distance_u8;
     volatile Sint16 room_angle;
-    volatile int in_use;
+    volatile Sint16 angle;
+    SDL_atomic_t in_use;
     volatile int channels;
+    Uint16 format;
+    /* The fields above are the audio thread's copy. The game thread changes
+       'set' and publishes it through a triple buffer: it fills slots[back]
+       and swaps that with 'middle', the effect swaps slots[front] with
+       'middle' when that's newer. Neither side ever waits for the other. */
+    position_params set;
+    position_params slots[3];
+    int back;
+    int front;
+    SDL_atomic_t middle;
+    Mix_EffectFunc_t effect;    /* the positional effect for the format */
+    /* Where the S16 and F32 effects left the gains, so the next callback
+       can ramp to new ones instead of stepping; only the effect uses these */
+    float ramp_gains[6];
+    Sint16 ramp_room_angle;
+    int ramp_valid;
+    /* Registered as _Eff_binaural() rather than the positional effect,
+       only changed by the game thread while the args aren't in use */
+    int binaural;
+    /* Where the binaural effect left the angle and gain, and the last
+       BINAURAL_MAX_TAPS - 1 mono frames it was given */
+    float hrtf_angle;
+    float hrtf_gain;
+    int hrtf_valid;
+    float hrtf_history[BINAURAL_MAX_TAPS];
 } position_args;
 
 static position_args **pos_args_array = NULL;
 static position_args *pos_args_global = NULL;
 static int position_channels = 0;
 
+/* Serializes the game threads setting positions, the audio thread never
+   takes it. It's a mutex as it's held while the audio lock is waited for,
+   to register an effect. The args are only freed by _Eff_PositionDeinit(),
+   so the effects can keep using them while pos_args_array is reallocated. */
+static SDL_mutex *position_lock = NULL;
+
+static void position_load(volatile position_args *args, const position_params *params)
+{
+    args->left_f = params->left_f;
+    args->right_f = params->right_f;
+    args->left_rear_f = params->left_rear_f;
+    args->right_rear_f = params->right_rear_f;
+    args->center_f = params->center_f;
+    args->lfe_f = params->lfe_f;
+    args->distance_f = params->distance_f;
+    args->left_u8 = params->left_u8;
+    args->right_u8 = params->right_u8;
+    args->left_rear_u8 = params->left_rear_u8;
+    args->right_rear_u8 = params->right_rear_u8;
+    args->center_u8 = params->center_u8;
+    args->lfe_u8 = params->lfe_u8;
+    args->distance_u8 = params->distance_u8;
+    args->room_angle = params->room_angle;
+    args->angle = params->angle;
+}
+
+/* Game thread, with position_lock held */
+static void position_publish(position_args *args)
+{
+    args->slots[args->back] = args->set;
+    args->back = _Eff_slot_publish(&args->middle, args->back);
+}
+
+/* Audio thread, at the start of every callback */
+static void position_sync(position_args *args)
+{
+    if (_Eff_slot_acquire(&args->middle, &args->front)) {
+        position_load(args, &args->slots[args->front]);
+    }
+}
+
+static void _Eff_EmitterDeinit(void);
+static void _Eff_BinauralDeinit(void);
+
+void _Eff_PositionInit(void)
+{
+    if (!position_lock) {
+        position_lock = SDL_CreateMutex();
+    }
+}
+
 void _Eff_PositionDeinit(void)
 {
     int i;
@@ -95,23 +198,179 @@ void _Eff_PositionDeinit(void)
     pos_args_global = NULL;
     SDL_free(pos_args_array);
     pos_args_array = NULL;
+
+    _Eff_EmitterDeinit();
+    _Eff_BinauralDeinit();
+
+    SDL_DestroyMutex(position_lock);
+    position_lock = NULL;
 }
 
 
-/* This just frees up the callback-specific data. */
+/* The args stay allocated for the next time the channel is positioned,
+   a game thread may be publishing to them right now */
 static void SDLCALL _Eff_PositionDone(int channel, void *udata)
 {
-    if (channel < 0) {
-        if (pos_args_global != NULL) {
-            SDL_free(pos_args_global);
-            pos_args_global = NULL;
+    SDL_AtomicSet(&((position_args *) udata)->in_use, 0);
+}
+
+
+/* Take one snapshot of 'args' per callback: the gain of each of up to six
+   speakers with the distance folded in, and the room angle */
+static int position_gains(volatile position_args *args, float *gains)
+{
+    const float distance = args->distance_f;
+
+    gains[0] = args->left_f * distance;
+    gains[1] = args->right_f * distance;
+    gains[2] = args->left_rear_f * distance;
+    gains[3] = args->right_rear_f * distance;
+    gains[4] = args->center_f * distance;
+    gains[5] = args->lfe_f * distance;
+    return args->room_angle;
+}
+
+/* Which input speaker each of the four front and rear ones plays, and the
+   two that make up the center, for the room rotated by 0, 90, 180 and 270 */
+static const int room_order[4][4] = {
+    { 0, 1, 2, 3 }, { 1, 3, 0, 2 }, { 3, 2, 1, 0 }, { 2, 0, 3, 1 }
+};
+static const int room_center[4][2] = {
+    { 4, 4 }, { 1, 3 }, { 3, 2 }, { 0, 2 }
+};
+
+/* Move the already scaled speakers of 'frames' frames around the room */
+static void position_rotate_s16lsb(Sint16 *ptr, int frames, int channels, int room_angle)
+{
+    const int *order = room_order[room_angle / 90];
+    const int *center = room_center[room_angle / 90];
+    Sint16 in[6];
+    int i;
+
+    if (channels == 2) {
+        for (i = 0; i < frames; ++i, ptr += 2) {
+            const Sint16 l = ptr[0];
+            ptr[0] = ptr[1];
+            ptr[1] = l;
+        }
+        return;
+    }
+    for (i = 0; i < frames; ++i, ptr += channels) {
+        SDL_memcpy(in, ptr, channels * sizeof(Sint16));
+        ptr[0] = in[order[0]];
+        ptr[1] = in[order[1]];
+        ptr[2] = in[order[2]];
+        ptr[3] = in[order[3]];
+        if (channels == 6) {
+            ptr[4] = (Sint16) SDL_SwapLE16((Sint16) SDL_SwapLE16(in[center[0]])/2 + (Sint16) SDL_SwapLE16(in[center[1]])/2);
+        }
+    }
+}
+
+static void position_rotate_f32sys(float *ptr, int frames, int channels, int room_angle)
+{
+    const int *order = room_order[room_angle / 90];
+    const int *center = room_center[room_angle / 90];
+    float in[6];
+    int i;
+
+    if (channels == 2) {
+        for (i = 0; i < frames; ++i, ptr += 2) {
+            const float l = ptr[0];
+            ptr[0] = ptr[1];
+            ptr[1] = l;
+        }
+        return;
+    }
+    for (i = 0; i < frames; ++i, ptr += channels) {
+        SDL_memcpy(in, ptr, channels * sizeof(float));
+        ptr[0] = in[order[0]];
+        ptr[1] = in[order[1]];
+        ptr[2] = in[order[2]];
+        ptr[3] = in[order[3]];
+        if (channels == 6) {
+            ptr[4] = in[center[0]]/2.0f + in[center[1]]/2.0f;
+        }
+    }
+}
+
+/* The gains for the next 'frames' frames, with the room angle they are
+   for: 'gains' for the first frame and 'steps' for the change per frame.
+   New gains are reached by a linear ramp over the frames, so emitters can
+   be moved every frame without zipper noise. A change of room angle
+   reorders the speakers, so that one still takes effect at once.
+   Returns SDL_FALSE if the gains stay the same throughout. */
+static SDL_bool position_ramp(volatile position_args *args, int frames, int channels,
+                              int *room_angle, float *gains, float *steps)
+{
+    float target[6];
+    SDL_bool ramp = SDL_FALSE;
+    int c;
+
+    *room_angle = position_gains(args, target);
+    for (c = 0; c < channels; ++c) {
+        gains[c] = target[c];
+        steps[c] = 0.0f;
+    }
+    if (args->ramp_valid && args->ramp_room_angle == *room_angle) {
+        for (c = 0; c < channels; ++c) {
+            steps[c] = (target[c] - args->ramp_gains[c]) / (float) frames;
+            gains[c] = args->ramp_gains[c] + steps[c];
+            if (steps[c] != 0.0f) {
+                ramp = SDL_TRUE;
+            }
+        }
+    }
+    for (c = 0; c < channels; ++c) {
+        args->ramp_gains[c] = target[c];
+    }
+    args->ramp_room_angle = (Sint16) *room_angle;
+    args->ramp_valid = 1;
+    return ramp;
+}
+
+/* Scale from 'src' into 'stream', which may be the same buffer, then
+   rotate if the room is turned; the speaker gains are always in the order
+   of the device's channels */
+static void position_apply(const void *src, void *stream, int len, volatile position_args *args,
+                           SDL_AudioFormat format, int channels)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(format) / 8;
+    const int samples = len / sample_size;
+    const int frames = samples / channels;
+    float gains[6], steps[6];
+    int room_angle;
+
+    if (frames <= 0) {
+        return;
+    }
+    if (position_ramp(args, frames, channels, &room_angle, gains, steps)) {
+        _Mix_BusGainsCopy((Uint8 *) stream, (const Uint8 *) src, format, samples, channels, gains, steps);
+    } else {
+        _Mix_BusGainsCopy((Uint8 *) stream, (const Uint8 *) src, format, samples, channels, gains, NULL);
+    }
+    if (room_angle == 90 || room_angle == 180 || room_angle == 270) {
+        if (format == AUDIO_F32SYS) {
+            position_rotate_f32sys((float *) stream, samples / channels, channels, room_angle);
+        } else {
+            position_rotate_s16lsb((Sint16 *) stream, samples / channels, channels, room_angle);
         }
     }
+}
+
+/* Hand the gains over to the mixer while the room isn't turned, then the
+   channel is scaled as it's mixed instead of going through the effect */
+static SDL_bool SDLCALL _Eff_position_gains(int chan, int frames, float *gains, float *steps, void *udata)
+{
+    volatile position_args *args = (volatile position_args *) udata;
+    int room_angle;
 
-    else if (pos_args_array[channel] != NULL) {
-        SDL_free(pos_args_array[channel]);
-        pos_args_array[channel] = NULL;
+    position_sync((position_args *) udata);
+    if (args->room_angle != 0) {
+        return SDL_FALSE;
     }
+    position_ramp(args, frames, args->channels, &room_angle, gains, steps);
+    return SDL_TRUE;
 }
 
 
@@ -364,9 +623,9 @@ static void SDLCALL _Eff_position_table_u8(int chan, void *stream, int len, void
     Uint8 *ptr = (Uint8 *) stream;
     Uint32 *p;
     int i;
-    Uint8 *l = ((Uint8 *) _Eff_volume_table) + (256 * args->left_u8);
-    Uint8 *r = ((Uint8 *) _Eff_volume_table) + (256 * args->right_u8);
-    Uint8 *d = ((Uint8 *) _Eff_volume_table) + (256 * args->distance_u8);
+    Uint8 *l = ((Uint8 *) _Eff_volume_table_u8) + (256 * args->left_u8);
+    Uint8 *r = ((Uint8 *) _Eff_volume_table_u8) + (256 * args->right_u8);
+    Uint8 *d = ((Uint8 *) _Eff_volume_table_u8) + (256 * args->distance_u8);
 
     if (args->room_angle == 180) {
         Uint8 *temp = l;
@@ -392,15 +651,15 @@ static void SDLCALL _Eff_position_table_u8(int chan, void *stream, int len, void
 
     for (i = 0; i < len; i += sizeof (Uint32)) {
 #if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-        *p = (d[l[(*p & 0xFF000000) >> 24]] << 24) |
-             (d[r[(*p & 0x00FF0000) >> 16]] << 16) |
-             (d[l[(*p & 0x0000FF00) >>  8]] <<  8) |
-             (d[r[(*p & 0x000000FF)      ]]     ) ;
+        *p = ((Uint32) d[l[(*p & 0xFF000000) >> 24]] << 24) |
+             ((Uint32) d[r[(*p & 0x00FF0000) >> 16]] << 16) |
+             ((Uint32) d[l[(*p & 0x0000FF00) >>  8]] <<  8) |
+             ((Uint32) d[r[(*p & 0x000000FF)      ]]     ) ;
 #else
-        *p = (d[r[(*p & 0xFF000000) >> 24]] << 24) |
-             (d[l[(*p & 0x00FF0000) >> 16]] << 16) |
-             (d[r[(*p & 0x0000FF00) >>  8]] <<  8) |
-             (d[l[(*p & 0x000000FF)      ]]     ) ;
+        *p = ((Uint32) d[r[(*p & 0xFF000000) >> 24]] << 24) |
+             ((Uint32) d[l[(*p & 0x00FF0000) >> 16]] << 16) |
+             ((Uint32) d[r[(*p & 0x0000FF00) >>  8]] <<  8) |
+             ((Uint32) d[l[(*p & 0x000000FF)      ]]     ) ;
 #endif
         ++p;
     }
@@ -558,9 +817,9 @@ static void SDLCALL _Eff_position_table_s8(int chan, void *stream, int len, void
     Sint8 *ptr = (Sint8 *) stream;
     Uint32 *p;
     int i;
-    Sint8 *l = ((Sint8 *) _Eff_volume_table) + (256 * args->left_u8);
-    Sint8 *r = ((Sint8 *) _Eff_volume_table) + (256 * args->right_u8);
-    Sint8 *d = ((Sint8 *) _Eff_volume_table) + (256 * args->distance_u8);
+    Sint8 *l = ((Sint8 *) _Eff_volume_table_s8) + (256 * args->left_u8);
+    Sint8 *r = ((Sint8 *) _Eff_volume_table_s8) + (256 * args->right_u8);
+    Sint8 *d = ((Sint8 *) _Eff_volume_table_s8) + (256 * args->distance_u8);
 
     if (args->room_angle == 180) {
         Sint8 *temp = l;
@@ -569,11 +828,12 @@ static void SDLCALL _Eff_position_table_s8(int chan, void *stream, int len, void
     }
 
 
+    /* The table's columns start at sample -128, for both lookups */
     while (len % sizeof (Uint32) != 0) {
-        *ptr = d[l[*ptr]];
+        *ptr = d[l[*ptr + 128] + 128];
         ptr++;
         if (args->channels > 1) {
-            *ptr = d[r[*ptr]];
+            *ptr = d[r[*ptr + 128] + 128];
             ptr++;
         }
         len -= args->channels;
@@ -583,15 +843,15 @@ static void SDLCALL _Eff_position_table_s8(int chan, void *stream, int len, void
 
     for (i = 0; i < len; i += sizeof (Uint32)) {
 #if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-        *p = (d[l[((Sint16)(Sint8)((*p & 0xFF000000) >> 24))+128]] << 24) |
-             (d[r[((Sint16)(Sint8)((*p & 0x00FF0000) >> 16))+128]] << 16) |
-             (d[l[((Sint16)(Sint8)((*p & 0x0000FF00) >>  8))+128]] <<  8) |
-             (d[r[((Sint16)(Sint8)((*p & 0x000000FF)     ))+128]]     ) ;
+        *p = ((Uint32) (Uint8) d[l[((Sint16)(Sint8)((*p & 0xFF000000) >> 24))+128] + 128] << 24) |
+             ((Uint32) (Uint8) d[r[((Sint16)(Sint8)((*p & 0x00FF0000) >> 16))+128] + 128] << 16) |
+             ((Uint32) (Uint8) d[l[((Sint16)(Sint8)((*p & 0x0000FF00) >>  8))+128] + 128] <<  8) |
+             ((Uint32) (Uint8) d[r[((Sint16)(Sint8)((*p & 0x000000FF)     ))+128] + 128]     ) ;
 #else
-        *p = (d[r[((Sint16)(Sint8)((*p & 0xFF000000) >> 24))+128]] << 24) |
-             (d[l[((Sint16)(Sint8)((*p & 0x00FF0000) >> 16))+128]] << 16) |
-             (d[r[((Sint16)(Sint8)((*p & 0x0000FF00) >>  8))+128]] <<  8) |
-             (d[l[((Sint16)(Sint8)((*p & 0x000000FF)     ))+128]]     ) ;
+        *p = ((Uint32) (Uint8) d[r[((Sint16)(Sint8)((*p & 0xFF000000) >> 24))+128] + 128] << 24) |
+             ((Uint32) (Uint8) d[l[((Sint16)(Sint8)((*p & 0x00FF0000) >> 16))+128] + 128] << 16) |
+             ((Uint32) (Uint8) d[r[((Sint16)(Sint8)((*p & 0x0000FF00) >>  8))+128] + 128] <<  8) |
+             ((Uint32) (Uint8) d[l[((Sint16)(Sint8)((*p & 0x000000FF)     ))+128] + 128]     ) ;
 #endif
         ++p;
     }
@@ -743,132 +1003,18 @@ static void SDLCALL _Eff_position_u16lsb_c6(int chan, void *stream, int len, voi
 static void SDLCALL _Eff_position_s16lsb(int chan, void *stream, int len, void *udata)
 {
     /* 16 signed bits (lsb) * 2 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    Sint16 *ptr = (Sint16 *) stream;
-    int i;
-
-#if 0
-    if (len % (sizeof(Sint16) * 2)) {
-        fprintf(stderr,"Not an even number of frames! len=%d\n", len);
-        return;
-    }
-#endif
-
-    for (i = 0; i < len; i += sizeof (Sint16) * 2) {
-        Sint16 swapl = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+0))) *
-                                    args->left_f) * args->distance_f);
-        Sint16 swapr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+1))) *
-                                    args->right_f) * args->distance_f);
-    if (args->room_angle == 180) {
-            *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-            *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-    }
-    else {
-            *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-            *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-    }
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_S16LSB, 2);
 }
 static void SDLCALL _Eff_position_s16lsb_c4(int chan, void *stream, int len, void *udata)
 {
     /* 16 signed bits (lsb) * 4 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    Sint16 *ptr = (Sint16 *) stream;
-    int i;
-
-    for (i = 0; i < len; i += sizeof (Sint16) * 4) {
-        Sint16 swapl = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+0))) *
-                                    args->left_f) * args->distance_f);
-        Sint16 swapr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+1))) *
-                                    args->right_f) * args->distance_f);
-        Sint16 swaplr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+1))) *
-                                    args->left_rear_f) * args->distance_f);
-        Sint16 swaprr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+2))) *
-                                    args->right_rear_f) * args->distance_f);
-    switch (args->room_angle) {
-        case 0:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-            break;
-        case 90:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-            break;
-        case 180:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-            break;
-        case 270:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-            break;
-    }
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_S16LSB, 4);
 }
 
 static void SDLCALL _Eff_position_s16lsb_c6(int chan, void *stream, int len, void *udata)
 {
     /* 16 signed bits (lsb) * 6 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    Sint16 *ptr = (Sint16 *) stream;
-    int i;
-
-    for (i = 0; i < len; i += sizeof (Sint16) * 6) {
-        Sint16 swapl = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+0))) *
-                                    args->left_f) * args->distance_f);
-        Sint16 swapr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+1))) *
-                                    args->right_f) * args->distance_f);
-        Sint16 swaplr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+2))) *
-                                    args->left_rear_f) * args->distance_f);
-        Sint16 swaprr = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+3))) *
-                                    args->right_rear_f) * args->distance_f);
-        Sint16 swapce = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+4))) *
-                                    args->center_f) * args->distance_f);
-        Sint16 swapwf = (Sint16) ((((float) (Sint16) SDL_SwapLE16(*(ptr+5))) *
-                                    args->lfe_f) * args->distance_f);
-    switch (args->room_angle) {
-        case 0:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapce);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapwf);
-            break;
-        case 90:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr)/2 + (Sint16) SDL_SwapLE16(swaprr)/2;
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapwf);
-            break;
-        case 180:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr)/2 + (Sint16) SDL_SwapLE16(swaplr)/2;
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapwf);
-            break;
-        case 270:
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaplr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swaprr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapr);
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapl)/2 + (Sint16) SDL_SwapLE16(swaplr)/2;
-                *(ptr++) = (Sint16) SDL_SwapLE16(swapwf);
-            break;
-    }
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_S16LSB, 6);
 }
 
 static void SDLCALL _Eff_position_u16msb(int chan, void *stream, int len, void *udata)
@@ -1382,140 +1528,65 @@ static void SDLCALL _Eff_position_s32msb_c6(int chan, void *stream, int len, voi
 static void SDLCALL _Eff_position_f32sys(int chan, void *stream, int len, void *udata)
 {
     /* float * 2 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    float *ptr = (float *) stream;
-    int i;
-
-    for (i = 0; i < len; i += sizeof (float) * 2) {
-        float swapl = ((*(ptr+0) * args->left_f) * args->distance_f);
-        float swapr = ((*(ptr+1) * args->right_f) * args->distance_f);
-        *(ptr++) = swapl;
-        *(ptr++) = swapr;
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_F32SYS, 2);
 }
 static void SDLCALL _Eff_position_f32sys_c4(int chan, void *stream, int len, void *udata)
 {
     /* float * 4 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    float *ptr = (float *) stream;
-    int i;
-
-    for (i = 0; i < len; i += sizeof (float) * 4) {
-        float swapl = ((*(ptr+0) * args->left_f) * args->distance_f);
-        float swapr = ((*(ptr+1) * args->right_f) * args->distance_f);
-        float swaplr = ((*(ptr+2) * args->left_rear_f) * args->distance_f);
-        float swaprr = ((*(ptr+3) * args->right_rear_f) * args->distance_f);
-        switch (args->room_angle) {
-        case 0:
-                *(ptr++) = swapl;
-                *(ptr++) = swapr;
-                *(ptr++) = swaplr;
-                *(ptr++) = swaprr;
-            break;
-        case 90:
-                *(ptr++) = swapr;
-                *(ptr++) = swaprr;
-                *(ptr++) = swapl;
-                *(ptr++) = swaplr;
-            break;
-        case 180:
-                *(ptr++) = swaprr;
-                *(ptr++) = swaplr;
-                *(ptr++) = swapr;
-                *(ptr++) = swapl;
-            break;
-        case 270:
-                *(ptr++) = swaplr;
-                *(ptr++) = swapl;
-                *(ptr++) = swaprr;
-                *(ptr++) = swapr;
-            break;
-        }
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_F32SYS, 4);
 }
 static void SDLCALL _Eff_position_f32sys_c6(int chan, void *stream, int len, void *udata)
 {
     /* float * 6 channels. */
-    volatile position_args *args = (volatile position_args *) udata;
-    float *ptr = (float *) stream;
-    int i;
-
-    for (i = 0; i < len; i += sizeof (float) * 6) {
-        float swapl = ((*(ptr+0) * args->left_f) * args->distance_f);
-        float swapr = ((*(ptr+1) * args->right_f) * args->distance_f);
-        float swaplr = ((*(ptr+2) * args->left_rear_f) * args->distance_f);
-        float swaprr = ((*(ptr+3) * args->right_rear_f) * args->distance_f);
-        float swapce = ((*(ptr+4) * args->center_f) * args->distance_f);
-        float swapwf = ((*(ptr+5) * args->lfe_f) * args->distance_f);
-
-    switch (args->room_angle) {
-        case 0:
-                *(ptr++) = swapl;
-                *(ptr++) = swapr;
-                *(ptr++) = swaplr;
-                *(ptr++) = swaprr;
-                *(ptr++) = swapce;
-                *(ptr++) = swapwf;
-            break;
-        case 90:
-                *(ptr++) = swapr;
-                *(ptr++) = swaprr;
-                *(ptr++) = swapl;
-                *(ptr++) = swaplr;
-                *(ptr++) = swapr/2.0f + swaprr/2.0f;
-                *(ptr++) = swapwf;
-            break;
-        case 180:
-                *(ptr++) = swaprr;
-                *(ptr++) = swaplr;
-                *(ptr++) = swapr;
-                *(ptr++) = swapl;
-                *(ptr++) = swaprr/2.0f + swaplr/2.0f;
-                *(ptr++) = swapwf;
-            break;
-        case 270:
-                *(ptr++) = swaplr;
-                *(ptr++) = swapl;
-                *(ptr++) = swaprr;
-                *(ptr++) = swapr;
-                *(ptr++) = swapl/2.0f + swaplr/2.0f;
-                *(ptr++) = swapwf;
-            break;
-    }
-    }
+    position_apply(stream, stream, len, (volatile position_args *) udata, AUDIO_F32SYS, 6);
 }
 
 static void init_position_args(position_args *args)
 {
+    position_params *set = &args->set;
+
     SDL_memset(args, '\0', sizeof (position_args));
-    args->in_use = 0;
-    args->room_angle = 0;
-    args->left_u8 = args->right_u8 = args->distance_u8 = 255;
-    args->left_f  = args->right_f  = args->distance_f  = 1.0f;
-    args->left_rear_u8 = args->right_rear_u8 = args->center_u8 = args->lfe_u8 = 255;
-    args->left_rear_f = args->right_rear_f = args->center_f = args->lfe_f = 1.0f;
-    Mix_QuerySpec(NULL, NULL, (int *) &args->channels);
+    set->room_angle = 0;
+    set->left_u8 = set->right_u8 = set->distance_u8 = 255;
+    set->left_f  = set->right_f  = set->distance_f  = 1.0f;
+    set->left_rear_u8 = set->right_rear_u8 = set->center_u8 = set->lfe_u8 = 255;
+    set->left_rear_f = set->right_rear_f = set->center_f = set->lfe_f = 1.0f;
+    position_load(args, set);
+    args->back = 0;
+    args->front = 1;
+    SDL_AtomicSet(&args->middle, 2);
+    Mix_QuerySpec(NULL, &args->format, (int *) &args->channels);
 }
 
 
+/* MAKE SURE you hold position_lock before calling this! Args that aren't
+   in use start over from the defaults, as they did when they were freed. */
 static position_args *get_position_arg(int channel)
 {
     void *rc;
     int i;
 
-    if (channel < 0) {
+    if (channel == MIX_CHANNEL_POST) {
         if (pos_args_global == NULL) {
-            pos_args_global = SDL_malloc(sizeof (position_args));
+            pos_args_global = (position_args *) SDL_calloc(1, sizeof (position_args));
             if (pos_args_global == NULL) {
                 Mix_SetError("Out of memory");
                 return(NULL);
             }
+        }
+        if (!SDL_AtomicGet(&pos_args_global->in_use)) {
             init_position_args(pos_args_global);
         }
 
         return(pos_args_global);
     }
 
+    /* Submix buses aren't positioned, their channels are */
+    if (channel < 0) {
+        Mix_SetError("Invalid channel number");
+        return(NULL);
+    }
+
     if (channel >= position_channels) {
         rc = SDL_realloc(pos_args_array, (channel + 1) * sizeof (position_args *));
         if (rc == NULL) {
@@ -1530,11 +1601,13 @@ static position_args *get_position_arg(int channel)
     }
 
     if (pos_args_array[channel] == NULL) {
-        pos_args_array[channel] = (position_args *)SDL_malloc(sizeof(position_args));
+        pos_args_array[channel] = (position_args *) SDL_calloc(1, sizeof (position_args));
         if (pos_args_array[channel] == NULL) {
             Mix_SetError("Out of memory");
             return(NULL);
         }
+    }
+    if (!SDL_AtomicGet(&pos_args_array[channel]->in_use)) {
         init_position_args(pos_args_array[channel]);
     }
 
@@ -1719,9 +1792,362 @@ static Mix_EffectFunc_t get_position_effect_func(Uint16 format, int channels)
     return(f);
 }
 
-static Uint8 speaker_amplitude[6];
 
-static void set_amplitudes(int channels, int angle, int room_angle)
+/*
+ * Binaural positioning, see Mix_SetBinaural(). The head related impulse
+ *  responses come from the spherical head model of Brown and Duda: a delay
+ *  for the sound to get around the head to each ear and a shelf for the
+ *  shadow of the head, plus a small treble cut for sources behind so front
+ *  and back differ. They are worked out for the device rate every 10
+ *  degrees, and the ones in between interpolated.
+ */
+
+#define BINAURAL_ANGLES     36      /* filters, one every 10 degrees */
+#define BINAURAL_BLOCK      256     /* frames filtered at a time */
+#define BINAURAL_FADE       8       /* taps the responses are faded out over */
+#define BINAURAL_PI         3.14159265358979323846
+
+/* Of the head, in meters, and of sound, in meters per second */
+#define BINAURAL_HEAD_RADIUS    0.0875
+#define BINAURAL_SOUND_SPEED    343.0
+
+/* The filters for the left ear, reversed for _Mix_BusDot(); a source at
+   some angle sounds to the right ear like one at minus that angle does to
+   the left. Built once the first time a channel is made binaural. */
+static struct
+{
+    int taps;
+    float *filters;             /* BINAURAL_ANGLES times 'taps' */
+} hrtf = { 0, NULL };
+
+/* Which channels Mix_SetBinaural() asked for, only the game threads use
+   this, with position_lock held */
+static Uint8 *binaural_channels = NULL;
+static int num_binaural_channels = 0;
+
+/* How many channels may be binaural at once, and how many are */
+static int binaural_budget = 8;
+static SDL_atomic_t binaural_active;
+
+static void _Eff_BinauralDeinit(void)
+{
+    SDL_free(hrtf.filters);
+    hrtf.filters = NULL;
+    hrtf.taps = 0;
+    SDL_free(binaural_channels);
+    binaural_channels = NULL;
+    num_binaural_channels = 0;
+    SDL_AtomicSet(&binaural_active, 0);
+}
+
+/* Run 'h' through a first order shelf, in place: a gain of 1 at DC and of
+   'alpha' well above 1 / (2 pi tau) Hz, by the bilinear transform */
+static void binaural_shelf(double *h, int taps, double alpha, double tau, int freq)
+{
+    const double k = 2.0 * freq * tau;
+    const double b0 = (1.0 + alpha * k) / (1.0 + k);
+    const double b1 = (1.0 - alpha * k) / (1.0 + k);
+    const double a1 = (1.0 - k) / (1.0 + k);
+    double x1 = 0.0, y1 = 0.0;
+    int i;
+
+    for (i = 0; i < taps; ++i) {
+        const double x = h[i];
+        const double y = b0 * x + b1 * x1 - a1 * y1;
+        x1 = x;
+        y1 = y;
+        h[i] = y;
+    }
+}
+
+/* MAKE SURE you hold position_lock before calling this! */
+static int binaural_build(int freq)
+{
+    const double head = BINAURAL_HEAD_RADIUS / BINAURAL_SOUND_SPEED;
+    double h[BINAURAL_MAX_TAPS];
+    float *filters;
+    int taps, i, n;
+
+    if (hrtf.filters != NULL) {
+        return(1);
+    }
+
+    /* 1.5 ms, a whole number of SIMD vectors long */
+    taps = ((freq * 3 / 2000) + 7) & ~7;
+    if (taps < 2 * BINAURAL_FADE) {
+        taps = 2 * BINAURAL_FADE;
+    } else if (taps > BINAURAL_MAX_TAPS) {
+        taps = BINAURAL_MAX_TAPS;
+    }
+    filters = (float *) SDL_malloc(BINAURAL_ANGLES * taps * sizeof (float));
+    if (filters == NULL) {
+        Mix_SetError("Out of memory");
+        return(0);
+    }
+
+    for (i = 0; i < BINAURAL_ANGLES; ++i) {
+        const int degrees = i * 360 / BINAURAL_ANGLES;
+        /* From the left ear, which points at 270 degrees, to the source */
+        const int away = (degrees + 90) % 360;
+        const double incidence = ((away > 180) ? 360 - away : away) * BINAURAL_PI / 180.0;
+        const double behind = -SDL_cos(degrees * BINAURAL_PI / 180.0);
+        double delay, alpha, sum;
+        int at;
+
+        if (incidence < BINAURAL_PI / 2.0) {
+            delay = head * (1.0 - SDL_cos(incidence));
+        } else {
+            delay = head * (1.0 + incidence - BINAURAL_PI / 2.0);
+        }
+        delay = 1.0 + delay * freq;
+        if (delay > taps - BINAURAL_FADE - 2) {
+            delay = taps - BINAURAL_FADE - 2;
+        }
+        at = (int) delay;
+        SDL_memset(h, 0, sizeof (h));
+        h[at] = 1.0 - (delay - at);
+        h[at + 1] = delay - at;
+
+        /* 6 dB up facing the ear, 20 dB down at 150 degrees from it */
+        alpha = 1.05 + 0.95 * SDL_cos(incidence * (180.0 / 150.0));
+        binaural_shelf(h, taps, alpha, head / 2.0, freq);
+        if (behind > 0.0) {
+            binaural_shelf(h, taps, 1.0 - 0.3 * behind, 1.0 / (2.0 * BINAURAL_PI * 4000.0), freq);
+        }
+
+        sum = 0.0;
+        for (n = 0; n < taps; ++n) {
+            if (n >= taps - BINAURAL_FADE) {
+                h[n] *= 0.5 + 0.5 * SDL_cos((n - (taps - BINAURAL_FADE) + 1) *
+                                            BINAURAL_PI / (BINAURAL_FADE + 1));
+            }
+            sum += h[n];
+        }
+        /* Keep the bass as loud as the flat panning's, whatever is cut off */
+        for (n = 0; n < taps; ++n) {
+            filters[i * taps + taps - 1 - n] = (float) (h[n] / sum);
+        }
+    }
+
+    hrtf.taps = taps;
+    hrtf.filters = filters;
+    return(1);
+}
+
+/* The left ear's filter for a source at 'angle', which is from 0 to 360 */
+static void binaural_filter(float angle, float *h)
+{
+    const int taps = hrtf.taps;
+    const float pos = angle * (BINAURAL_ANGLES / 360.0f);
+    const int i = (int) pos;
+    const float t = pos - (float) i;
+    const float *a = hrtf.filters + (i % BINAURAL_ANGLES) * taps;
+    const float *b = hrtf.filters + ((i + 1) % BINAURAL_ANGLES) * taps;
+    int n;
+
+    for (n = 0; n < taps; ++n) {
+        h[n] = a[n] + t * (b[n] - a[n]);
+    }
+}
+
+/* Filter the stereo floats at 'buf', summed to mono, for each ear. The
+   angle moves to the new one a block at a time and the gain a frame at a
+   time, taking the short way round. */
+static void binaural_render(volatile position_args *args, float *buf, int samples)
+{
+    const int taps = hrtf.taps;
+    const int frames = samples / 2;
+    const int blocks = (frames + BINAURAL_BLOCK - 1) / BINAURAL_BLOCK;
+    const float target_angle = (float) args->angle;
+    const float target_gain = args->distance_f;
+    float x[BINAURAL_MAX_TAPS - 1 + BINAURAL_BLOCK];
+    float left[BINAURAL_MAX_TAPS], right[BINAURAL_MAX_TAPS];
+    float *ptr = buf;
+    float turn, gain, step, angle;
+    int block, done, n, i;
+
+    if (frames <= 0) {
+        return;
+    }
+    if (!args->hrtf_valid) {
+        args->hrtf_angle = target_angle;
+        args->hrtf_gain = target_gain;
+        args->hrtf_valid = 1;
+    }
+    turn = target_angle - args->hrtf_angle;
+    if (turn > 180.0f) {
+        turn -= 360.0f;
+    } else if (turn < -180.0f) {
+        turn += 360.0f;
+    }
+    gain = args->hrtf_gain;
+    step = (target_gain - gain) / (float) frames;
+
+    SDL_memcpy(x, (const float *) args->hrtf_history, (taps - 1) * sizeof (float));
+    for (block = 1, done = 0; done < frames; ++block, done += n) {
+        n = SDL_min(frames - done, BINAURAL_BLOCK);
+
+        angle = args->hrtf_angle + turn * (float) block / (float) blocks;
+        if (angle < 0.0f) {
+            angle += 360.0f;
+        } else if (angle >= 360.0f) {
+            angle -= 360.0f;
+        }
+        binaural_filter(angle, left);
+        binaural_filter((angle > 0.0f) ? 360.0f - angle : 0.0f, right);
+
+        for (i = 0; i < n; ++i) {
+            x[taps - 1 + i] = 0.5f * (ptr[2 * i] + ptr[2 * i + 1]);
+        }
+        for (i = 0; i < n; ++i, ptr += 2) {
+            ptr[0] = gain * _Mix_BusDot(left, x + i, taps);
+            ptr[1] = gain * _Mix_BusDot(right, x + i, taps);
+            gain += step;
+        }
+        SDL_memmove(x, x + n, (taps - 1) * sizeof (float));
+    }
+    SDL_memcpy((float *) args->hrtf_history, x, (taps - 1) * sizeof (float));
+    args->hrtf_angle = target_angle;
+    args->hrtf_gain = target_gain;
+}
+
+static void SDLCALL _Eff_binaural(int chan, float *buf, int samples, void *udata)
+{
+    position_args *args = (position_args *) udata;
+
+    position_sync(args);
+    binaural_render(args, buf, samples);
+}
+
+static void SDLCALL _Eff_BinauralDone(int channel, void *udata)
+{
+    SDL_AtomicAdd(&binaural_active, -1);
+    SDL_AtomicSet(&((position_args *) udata)->in_use, 0);
+}
+
+/* Whether 'channel' gets to be binaural the next time it's registered:
+   it asked to be, the device is stereo and there's room in the budget, or
+   it's 'counted' in the budget already as it's playing binaural.
+   MAKE SURE you hold position_lock before calling this! */
+static SDL_bool binaural_wanted(int channel, int channels, SDL_bool counted)
+{
+    if (channels != 2 || hrtf.filters == NULL ||
+        channel < 0 || channel >= num_binaural_channels || !binaural_channels[channel]) {
+        return SDL_FALSE;
+    }
+    if (counted) {
+        return SDL_TRUE;
+    }
+    return (SDL_AtomicGet(&binaural_active) < binaural_budget) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* The S16 and F32 effects can leave the scaling to the mixer */
+static SDL_bool position_has_gains(Uint16 format, int channels)
+{
+    return ((format == AUDIO_S16LSB || format == AUDIO_F32SYS) &&
+            (channels == 2 || channels == 4 || channels == 6)) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Pick up what was published last, then run the effect for the format */
+static void SDLCALL _Eff_position(int chan, void *stream, int len, void *udata)
+{
+    position_args *args = (position_args *) udata;
+
+    position_sync(args);
+    args->effect(chan, stream, len, udata);
+}
+
+/* The S16 and F32 effects can read the chunk themselves when they come
+   first on a channel, saving the mixer its copy */
+static void SDLCALL _Eff_position_copy(int chan, const void *src, void *dst, int len, void *udata)
+{
+    position_args *args = (position_args *) udata;
+
+    position_sync(args);
+    position_apply(src, dst, len, args, args->format, args->channels);
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static int register_position_effect(int channel, Uint16 format,
+                                    int channels, position_args *args)
+{
+    int retval;
+
+    if (args->binaural) {
+        SDL_AtomicAdd(&binaural_active, 1);
+        retval = _Mix_RegisterBusEffect_locked(channel, _Eff_binaural, _Eff_BinauralDone, (void *) args);
+        if (!retval) {
+            SDL_AtomicAdd(&binaural_active, -1);
+        }
+        return retval;
+    }
+    if (position_has_gains(format, channels)) {
+        return _Mix_RegisterGainEffect_locked(channel, _Eff_position, _Eff_position_copy,
+                                              _Eff_PositionDone, _Eff_position_gains, (void *) args);
+    }
+    return _Mix_RegisterEffect_locked(channel, _Eff_position, _Eff_PositionDone, (void *) args);
+}
+
+/* Hand 'set' over to the effect. The audio lock is only taken to register
+   it, an effect that's already running picks the change up by itself.
+   MAKE SURE you hold position_lock before calling this! */
+static int position_commit(int channel, position_args *args, Mix_EffectFunc_t f,
+                           Uint16 format, int channels)
+{
+    int retval;
+
+    if (SDL_AtomicGet(&args->in_use)) {
+        position_publish(args);
+        return(1);
+    }
+
+    position_load(args, &args->set);
+    args->effect = f;
+    SDL_AtomicSet(&args->in_use, 1);
+    Mix_LockAudio();
+    retval = register_position_effect(channel, format, channels, args);
+    Mix_UnlockAudio();
+    if (!retval) {
+        SDL_AtomicSet(&args->in_use, 0);
+    }
+    return(retval);
+}
+
+/* Unregister the effect, if it's registered.
+   MAKE SURE you hold position_lock before calling this! */
+static int position_remove(int channel, position_args *args)
+{
+    int retval = 1;
+
+    if (SDL_AtomicGet(&args->in_use)) {
+        Mix_LockAudio();
+        if (args->binaural) {
+            retval = _Mix_UnregisterBusEffect_locked(channel, _Eff_binaural);
+        } else {
+            retval = _Mix_UnregisterEffect_locked(channel, _Eff_position);
+        }
+        Mix_UnlockAudio();
+    }
+    return(retval);
+}
+
+/* Have the effect registered as binaural or not from now on, taking it off
+   the channel if it's playing the other way.
+   MAKE SURE you hold position_lock before calling this! */
+static int position_switch(int channel, position_args *args, SDL_bool binaural)
+{
+    int retval = 1;
+
+    if (SDL_AtomicGet(&args->in_use) && args->binaural != (int) binaural) {
+        retval = position_remove(channel, args);
+    }
+    if (!SDL_AtomicGet(&args->in_use)) {
+        args->binaural = (int) binaural;
+    }
+    return(retval);
+}
+
+static void set_amplitudes(int channels, int angle, int room_angle, Uint8 *speaker_amplitude)
 {
     int left = 255, right = 255;
     int left_rear = 255, right_rear = 255, center = 255;
@@ -1850,6 +2276,46 @@ static void set_amplitudes(int channels, int angle, int room_angle)
     speaker_amplitude[5] = 255;
 }
 
+/* Point the speakers of 'params' at 'angle', which is from 0 to 359 */
+static void position_set_angle(position_params *params, int channels, int angle)
+{
+    Uint8 speaker_amplitude[6];
+    Sint16 room_angle = 0;
+
+    if (channels == 2)
+    {
+    if (angle > 180)
+        room_angle = 180; /* exchange left and right channels */
+    else room_angle = 0;
+    }
+
+    if (channels == 4 || channels == 6)
+    {
+    if (angle > 315) room_angle = 0;
+    else if (angle > 225) room_angle = 270;
+    else if (angle > 135) room_angle = 180;
+    else if (angle > 45) room_angle = 90;
+    else room_angle = 0;
+    }
+
+    set_amplitudes(channels, angle, room_angle, speaker_amplitude);
+
+    params->left_u8 = speaker_amplitude[0];
+    params->left_f = ((float) speaker_amplitude[0]) / 255.0f;
+    params->right_u8 = speaker_amplitude[1];
+    params->right_f = ((float) speaker_amplitude[1]) / 255.0f;
+    params->left_rear_u8 = speaker_amplitude[2];
+    params->left_rear_f = ((float) speaker_amplitude[2]) / 255.0f;
+    params->right_rear_u8 = speaker_amplitude[3];
+    params->right_rear_f = ((float) speaker_amplitude[3]) / 255.0f;
+    params->center_u8 = speaker_amplitude[4];
+    params->center_f = ((float) speaker_amplitude[4]) / 255.0f;
+    params->lfe_u8 = speaker_amplitude[5];
+    params->lfe_f = ((float) speaker_amplitude[5]) / 255.0f;
+    params->room_angle = room_angle;
+    params->angle = (Sint16) angle;
+}
+
 int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance);
 
 int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
@@ -1882,37 +2348,33 @@ int Mix_SetPanning(int channel, Uint8 left, Uint8 right)
     if (f == NULL)
         return(0);
 
-    Mix_LockAudio();
+    SDL_LockMutex(position_lock);
     args = get_position_arg(channel);
     if (!args) {
-        Mix_UnlockAudio();
+        SDL_UnlockMutex(position_lock);
         return(0);
     }
 
         /* it's a no-op; unregister the effect, if it's registered. */
-    if ((args->distance_u8 == 255) && (left == 255) && (right == 255)) {
-        if (args->in_use) {
-            retval = _Mix_UnregisterEffect_locked(channel, f);
-            Mix_UnlockAudio();
-            return(retval);
-        } else {
-            Mix_UnlockAudio();
-            return(1);
-        }
+    if ((args->set.distance_u8 == 255) && (left == 255) && (right == 255)) {
+        retval = position_remove(channel, args);
+        SDL_UnlockMutex(position_lock);
+        return(retval);
     }
 
-    args->left_u8 = left;
-    args->left_f = ((float) left) / 255.0f;
-    args->right_u8 = right;
-    args->right_f = ((float) right) / 255.0f;
-    args->room_angle = 0;
+    args->set.left_u8 = left;
+    args->set.left_f = ((float) left) / 255.0f;
+    args->set.right_u8 = right;
+    args->set.right_f = ((float) right) / 255.0f;
+    args->set.room_angle = 0;
 
-    if (!args->in_use) {
-        args->in_use = 1;
-        retval=_Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void*)args);
+    /* Panned by hand, so never binaural */
+    if (!position_switch(channel, args, SDL_FALSE)) {
+        SDL_UnlockMutex(position_lock);
+        return(0);
     }
-
-    Mix_UnlockAudio();
+    retval = position_commit(channel, args, f, format, channels);
+    SDL_UnlockMutex(position_lock);
     return(retval);
 }
 
@@ -1930,35 +2392,31 @@ int Mix_SetDistance(int channel, Uint8 distance)
     if (f == NULL)
         return(0);
 
-    Mix_LockAudio();
+    SDL_LockMutex(position_lock);
     args = get_position_arg(channel);
     if (!args) {
-        Mix_UnlockAudio();
+        SDL_UnlockMutex(position_lock);
         return(0);
     }
 
     distance = 255 - distance;  /* flip it to our scale. */
 
         /* it's a no-op; unregister the effect, if it's registered. */
-    if ((distance == 255) && (args->left_u8 == 255) && (args->right_u8 == 255)) {
-        if (args->in_use) {
-            retval = _Mix_UnregisterEffect_locked(channel, f);
-            Mix_UnlockAudio();
-            return(retval);
-        } else {
-            Mix_UnlockAudio();
-            return(1);
-        }
+    if ((distance == 255) && (args->set.left_u8 == 255) && (args->set.right_u8 == 255)) {
+        retval = position_remove(channel, args);
+        SDL_UnlockMutex(position_lock);
+        return(retval);
     }
 
-    args->distance_u8 = distance;
-    args->distance_f = ((float) distance) / 255.0f;
-    if (!args->in_use) {
-        args->in_use = 1;
-        retval = _Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void *) args);
+    args->set.distance_u8 = distance;
+    args->set.distance_f = ((float) distance) / 255.0f;
+    if (!position_switch(channel, args, binaural_wanted(channel, channels,
+                         SDL_AtomicGet(&args->in_use) && args->binaural))) {
+        SDL_UnlockMutex(position_lock);
+        return(0);
     }
-
-    Mix_UnlockAudio();
+    retval = position_commit(channel, args, f, format, channels);
+    SDL_UnlockMutex(position_lock);
     return(retval);
 }
 
@@ -1969,7 +2427,6 @@ int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance)
     Uint16 format;
     int channels;
     position_args *args = NULL;
-    Sint16 room_angle = 0;
     int retval = 1;
 
     Mix_QuerySpec(NULL, &format, &channels);
@@ -1979,67 +2436,485 @@ int Mix_SetPosition(int channel, Sint16 angle, Uint8 distance)
 
     angle = SDL_abs(angle) % 360;  /* make angle between 0 and 359. */
 
-    Mix_LockAudio();
+    SDL_LockMutex(position_lock);
     args = get_position_arg(channel);
     if (!args) {
-        Mix_UnlockAudio();
+        SDL_UnlockMutex(position_lock);
         return(0);
     }
 
         /* it's a no-op; unregister the effect, if it's registered. */
     if ((!distance) && (!angle)) {
-        if (args->in_use) {
-            retval = _Mix_UnregisterEffect_locked(channel, f);
-            Mix_UnlockAudio();
-            return(retval);
-        } else {
-            Mix_UnlockAudio();
+        retval = position_remove(channel, args);
+        SDL_UnlockMutex(position_lock);
+        return(retval);
+    }
+
+    position_set_angle(&args->set, channels, angle);
+    distance = 255 - distance;  /* flip it to scale Mix_SetDistance() uses. */
+
+    args->set.distance_u8 = distance;
+    args->set.distance_f = ((float) distance) / 255.0f;
+    if (!position_switch(channel, args, binaural_wanted(channel, channels,
+                         SDL_AtomicGet(&args->in_use) && args->binaural))) {
+        SDL_UnlockMutex(position_lock);
+        return(0);
+    }
+    retval = position_commit(channel, args, f, format, channels);
+    SDL_UnlockMutex(position_lock);
+    return(retval);
+}
+
+
+int Mix_WarmUpEffects(void)
+{
+    Uint16 format;
+    int channels, numchans, i;
+    int retval = 1;
+
+    if (!Mix_QuerySpec(NULL, &format, &channels)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+    if (!_Eff_PrepareVolumeTables(format)) {
+        Mix_SetError("Out of memory");
+        return(0);
+    }
+
+    /* Args not in use are only reset, so this leaves playing ones be */
+    numchans = Mix_AllocateChannels(-1);
+    SDL_LockMutex(position_lock);
+    for (i = 0; i < numchans && retval; i++) {
+        retval = (get_position_arg(i) != NULL);
+    }
+    if (retval) {
+        retval = (get_position_arg(MIX_CHANNEL_POST) != NULL);
+    }
+    SDL_UnlockMutex(position_lock);
+    return(retval);
+}
+
+
+int Mix_SetBinaural(int channel, int on)
+{
+    int freq;
+    void *rc;
+    int i;
+
+    if (!Mix_QuerySpec(&freq, NULL, NULL)) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(0);
+    }
+    if (channel < 0) {
+        Mix_SetError("Invalid channel number");
+        return(0);
+    }
+
+    SDL_LockMutex(position_lock);
+    if (on && !binaural_build(freq)) {
+        SDL_UnlockMutex(position_lock);
+        return(0);
+    }
+    if (channel >= num_binaural_channels) {
+        if (!on) {
+            SDL_UnlockMutex(position_lock);
             return(1);
         }
+        rc = SDL_realloc(binaural_channels, (channel + 1) * sizeof (Uint8));
+        if (rc == NULL) {
+            SDL_UnlockMutex(position_lock);
+            Mix_SetError("Out of memory");
+            return(0);
+        }
+        binaural_channels = (Uint8 *) rc;
+        for (i = num_binaural_channels; i <= channel; i++) {
+            binaural_channels[i] = 0;
+        }
+        num_binaural_channels = channel + 1;
     }
+    binaural_channels[channel] = on ? 1 : 0;
+    SDL_UnlockMutex(position_lock);
+    return(1);
+}
 
-    if (channels == 2)
-    {
-    if (angle > 180)
-        room_angle = 180; /* exchange left and right channels */
-    else room_angle = 0;
+
+int Mix_SetBinauralBudget(int channels)
+{
+    int previous;
+
+    SDL_LockMutex(position_lock);
+    previous = binaural_budget;
+    if (channels >= 0) {
+        binaural_budget = channels;
     }
+    SDL_UnlockMutex(position_lock);
+    return(previous);
+}
 
-    if (channels == 4 || channels == 6)
-    {
-    if (angle > 315) room_angle = 0;
-    else if (angle > 225) room_angle = 270;
-    else if (angle > 135) room_angle = 180;
-    else if (angle > 45) room_angle = 90;
-    else room_angle = 0;
+
+/*
+ * Emitters, see Mix_UpdateEmitters().
+ */
+
+typedef struct _Eff_emitterinfo
+{
+    position_args args;         /* what the positional effect plays with */
+    float slots[3][3];          /* x, y and z, triple buffered like 'set' */
+    int back;
+    int front;
+    SDL_atomic_t middle;
+    Uint32 listener_serial;     /* of the listener 'args' was worked out for */
+    SDL_atomic_t in_use;
+} emitter_info;
+
+static emitter_info **emitters = NULL;
+static int num_emitters = 0;
+
+/* Degrees per radian */
+#define EMITTER_DEGREES (180.0 / 3.14159265358979323846)
+
+/* Only changed with the audio lock held, the audio thread reads it */
+static struct
+{
+    float x, y, z;
+    float right[3];             /* unit vectors */
+    float front[3];
+    Mix_Rolloff model;
+    float ref_distance;
+    float max_distance;
+    float factor;
+    Uint32 serial;              /* bumped on every change */
+} listener = {
+    0.0f, 0.0f, 0.0f,
+    { 1.0f, 0.0f, 0.0f },
+    { 0.0f, 0.0f, -1.0f },
+    MIX_ROLLOFF_INVERSE, 1.0f, 1000.0f, 1.0f,
+    1
+};
+
+static void _Eff_EmitterDeinit(void)
+{
+    int i;
+
+    for (i = 0; i < num_emitters; i++) {
+        SDL_free(emitters[i]);
+    }
+    SDL_free(emitters);
+    emitters = NULL;
+    num_emitters = 0;
+}
+
+static float emitter_rolloff(float distance)
+{
+    const float ref = listener.ref_distance;
+    const float max = listener.max_distance;
+    float gain = 1.0f;
+
+    if (distance < ref) {
+        distance = ref;
+    } else if (distance > max) {
+        distance = max;
+    }
+    switch (listener.model) {
+    case MIX_ROLLOFF_INVERSE:
+        gain = ref / (ref + listener.factor * (distance - ref));
+        break;
+    case MIX_ROLLOFF_LINEAR:
+        gain = (max > ref) ? 1.0f - listener.factor * (distance - ref) / (max - ref) : 1.0f;
+        break;
+    case MIX_ROLLOFF_EXPONENTIAL:
+        gain = (float) SDL_pow(distance / ref, -listener.factor);
+        break;
+    default:
+        break;
+    }
+    if (gain < 0.0f) {
+        gain = 0.0f;
+    } else if (gain > 1.0f) {
+        gain = 1.0f;
     }
+    return gain;
+}
 
+/* Work out the angle and distance of an emitter, on the audio thread */
+static void emitter_refresh(emitter_info *e)
+{
+    position_params params;
+    const float *pos;
+    float dx, dy, dz, side, ahead, gain;
+    int angle = 0;
 
-    distance = 255 - distance;  /* flip it to scale Mix_SetDistance() uses. */
+    if (!_Eff_slot_acquire(&e->middle, &e->front) && e->listener_serial == listener.serial) {
+        return;
+    }
+    e->listener_serial = listener.serial;
+
+    pos = e->slots[e->front];
+    dx = pos[0] - listener.x;
+    dy = pos[1] - listener.y;
+    dz = pos[2] - listener.z;
+    side = dx * listener.right[0] + dy * listener.right[1] + dz * listener.right[2];
+    ahead = dx * listener.front[0] + dy * listener.front[1] + dz * listener.front[2];
+    if (side != 0.0f || ahead != 0.0f) {
+        /* Clockwise from straight ahead, like Mix_SetPosition() */
+        angle = (int) (SDL_atan2(side, ahead) * EMITTER_DEGREES + 360.5) % 360;
+    }
+    position_set_angle(&params, e->args.channels, angle);
+
+    gain = emitter_rolloff((float) SDL_sqrt(dx * dx + dy * dy + dz * dz));
+    params.distance_u8 = (Uint8) (gain * 255.0f + 0.5f);
+    params.distance_f = gain;
+    position_load(&e->args, &params);
+}
+
+static void SDLCALL _Eff_emitter(int chan, void *stream, int len, void *udata)
+{
+    emitter_info *e = (emitter_info *) udata;
+
+    emitter_refresh(e);
+    e->args.effect(chan, stream, len, &e->args);
+}
+
+static void SDLCALL _Eff_emitter_copy(int chan, const void *src, void *dst, int len, void *udata)
+{
+    emitter_info *e = (emitter_info *) udata;
+
+    emitter_refresh(e);
+    position_apply(src, dst, len, &e->args, e->args.format, e->args.channels);
+}
+
+static SDL_bool SDLCALL _Eff_emitter_gains(int chan, int frames, float *gains, float *steps, void *udata)
+{
+    emitter_info *e = (emitter_info *) udata;
+
+    emitter_refresh(e);
+    return _Eff_position_gains(chan, frames, gains, steps, &e->args);
+}
+
+static void SDLCALL _Eff_emitter_binaural(int chan, float *buf, int samples, void *udata)
+{
+    emitter_info *e = (emitter_info *) udata;
+
+    emitter_refresh(e);
+    binaural_render(&e->args, buf, samples);
+}
+
+/* The emitter stays allocated for the next time the channel plays */
+static void SDLCALL _Eff_EmitterDone(int channel, void *udata)
+{
+    SDL_AtomicSet(&((emitter_info *) udata)->in_use, 0);
+}
+
+static void SDLCALL _Eff_EmitterBinauralDone(int channel, void *udata)
+{
+    SDL_AtomicAdd(&binaural_active, -1);
+    SDL_AtomicSet(&((emitter_info *) udata)->in_use, 0);
+}
+
+/* MAKE SURE you hold position_lock before calling this! */
+static int emitter_register(int channel, emitter_info *e, Uint16 format, int channels)
+{
+    int retval;
+
+    Mix_LockAudio();
+    if (e->args.binaural) {
+        SDL_AtomicAdd(&binaural_active, 1);
+        retval = _Mix_RegisterBusEffect_locked(channel, _Eff_emitter_binaural,
+                                               _Eff_EmitterBinauralDone, e);
+        if (!retval) {
+            SDL_AtomicAdd(&binaural_active, -1);
+        }
+    } else if (position_has_gains(format, channels)) {
+        retval = _Mix_RegisterGainEffect_locked(channel, _Eff_emitter,
+                        _Eff_emitter_copy, _Eff_EmitterDone, _Eff_emitter_gains, e);
+    } else {
+        retval = _Mix_RegisterEffect_locked(channel, _Eff_emitter, _Eff_EmitterDone, e);
+    }
+    Mix_UnlockAudio();
+    return(retval);
+}
+
+/* MAKE SURE you hold position_lock before calling this! */
+static int emitter_remove(int channel, emitter_info *e)
+{
+    int retval;
+
+    Mix_LockAudio();
+    if (e->args.binaural) {
+        retval = _Mix_UnregisterBusEffect_locked(channel, _Eff_emitter_binaural);
+    } else {
+        retval = _Mix_UnregisterEffect_locked(channel, _Eff_emitter);
+    }
+    Mix_UnlockAudio();
+    return(retval);
+}
 
-    set_amplitudes(channels, angle, room_angle);
-
-    args->left_u8 = speaker_amplitude[0];
-    args->left_f = ((float) speaker_amplitude[0]) / 255.0f;
-    args->right_u8 = speaker_amplitude[1];
-    args->right_f = ((float) speaker_amplitude[1]) / 255.0f;
-    args->left_rear_u8 = speaker_amplitude[2];
-    args->left_rear_f = ((float) speaker_amplitude[2]) / 255.0f;
-    args->right_rear_u8 = speaker_amplitude[3];
-    args->right_rear_f = ((float) speaker_amplitude[3]) / 255.0f;
-    args->center_u8 = speaker_amplitude[4];
-    args->center_f = ((float) speaker_amplitude[4]) / 255.0f;
-    args->lfe_u8 = speaker_amplitude[5];
-    args->lfe_f = ((float) speaker_amplitude[5]) / 255.0f;
-    args->distance_u8 = distance;
-    args->distance_f = ((float) distance) / 255.0f;
-    args->room_angle = room_angle;
-    if (!args->in_use) {
-        args->in_use = 1;
-        retval = _Mix_RegisterEffect_locked(channel, f, _Eff_PositionDone, (void *) args);
+/* MAKE SURE you hold position_lock before calling this! */
+static emitter_info *get_emitter(int channel)
+{
+    void *rc;
+    int i;
+
+    /* Checked before the array grows to fit it, not when it's registered */
+    if (channel < 0 || channel >= Mix_AllocateChannels(-1)) {
+        Mix_SetError("Invalid channel number");
+        return(NULL);
+    }
+
+    if (channel >= num_emitters) {
+        rc = SDL_realloc(emitters, (channel + 1) * sizeof (emitter_info *));
+        if (rc == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+        emitters = (emitter_info **) rc;
+        for (i = num_emitters; i <= channel; i++) {
+            emitters[i] = NULL;
+        }
+        num_emitters = channel + 1;
+    }
+
+    if (emitters[channel] == NULL) {
+        emitters[channel] = (emitter_info *) SDL_calloc(1, sizeof (emitter_info));
+        if (emitters[channel] == NULL) {
+            Mix_SetError("Out of memory");
+            return(NULL);
+        }
+    }
+
+    return(emitters[channel]);
+}
+
+static void emitter_normalize(float *v)
+{
+    const float len = (float) SDL_sqrt(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+
+    if (len > 0.0f) {
+        v[0] /= len;
+        v[1] /= len;
+        v[2] /= len;
+    }
+}
+
+void Mix_SetListener(float x, float y, float z,
+                     float at_x, float at_y, float at_z,
+                     float up_x, float up_y, float up_z)
+{
+    float front[3], right[3];
+
+    front[0] = at_x;
+    front[1] = at_y;
+    front[2] = at_z;
+    emitter_normalize(front);
+    right[0] = front[1] * up_z - front[2] * up_y;
+    right[1] = front[2] * up_x - front[0] * up_z;
+    right[2] = front[0] * up_y - front[1] * up_x;
+    emitter_normalize(right);
+    if (right[0] == 0.0f && right[1] == 0.0f && right[2] == 0.0f) {
+        /* No way to tell left from right, keep the old orientation */
+        front[0] = listener.front[0];
+        front[1] = listener.front[1];
+        front[2] = listener.front[2];
+        right[0] = listener.right[0];
+        right[1] = listener.right[1];
+        right[2] = listener.right[2];
+    }
+
+    Mix_LockAudio();
+    listener.x = x;
+    listener.y = y;
+    listener.z = z;
+    SDL_memcpy(listener.front, front, sizeof (front));
+    SDL_memcpy(listener.right, right, sizeof (right));
+    ++listener.serial;
+    Mix_UnlockAudio();
+}
+
+int Mix_SetRolloff(Mix_Rolloff model, float ref_distance, float max_distance, float factor)
+{
+    if (model < MIX_ROLLOFF_NONE || model > MIX_ROLLOFF_EXPONENTIAL ||
+        !(ref_distance > 0.0f) || max_distance < ref_distance || factor < 0.0f) {
+        Mix_SetError("Invalid rolloff parameters");
+        return(0);
     }
 
+    Mix_LockAudio();
+    listener.model = model;
+    listener.ref_distance = ref_distance;
+    listener.max_distance = max_distance;
+    listener.factor = factor;
+    ++listener.serial;
     Mix_UnlockAudio();
+    return(1);
+}
+
+int Mix_UpdateEmitters(const Mix_Emitter *list, int count)
+{
+    Mix_EffectFunc_t f = NULL;
+    Uint16 format;
+    int channels;
+    SDL_bool binaural;
+    int fresh;
+    int i;
+
+    Mix_QuerySpec(NULL, &format, &channels);
+    f = get_position_effect_func(format, channels);
+    if (f == NULL)
+        return(0);
+
+    SDL_LockMutex(position_lock);
+    for (i = 0; i < count; i++) {
+        emitter_info *e = get_emitter(list[i].channel);
+        if (!e) {
+            break;
+        }
+        /* One that's made binaural or given the budget back starts over */
+        binaural = binaural_wanted(list[i].channel, channels,
+                                   SDL_AtomicGet(&e->in_use) && e->args.binaural);
+        if (SDL_AtomicGet(&e->in_use) && e->args.binaural != (int) binaural &&
+            !emitter_remove(list[i].channel, e)) {
+            break;
+        }
+        fresh = !SDL_AtomicGet(&e->in_use);
+        if (fresh) {
+            init_position_args(&e->args);
+            e->args.effect = f;
+            e->args.binaural = (int) binaural;
+            e->back = 0;
+            e->front = 1;
+            SDL_AtomicSet(&e->middle, 2);
+            e->listener_serial = 0;
+        }
+        e->slots[e->back][0] = list[i].x;
+        e->slots[e->back][1] = list[i].y;
+        e->slots[e->back][2] = list[i].z;
+        e->back = _Eff_slot_publish(&e->middle, e->back);
+        if (fresh) {
+            /* Only a new emitter needs the audio lock */
+            SDL_AtomicSet(&e->in_use, 1);
+            if (!emitter_register(list[i].channel, e, format, channels)) {
+                SDL_AtomicSet(&e->in_use, 0);
+                break;
+            }
+        }
+    }
+    SDL_UnlockMutex(position_lock);
+    return(i);
+}
+
+int Mix_RemoveEmitter(int channel)
+{
+    int retval = 1;
+
+    SDL_LockMutex(position_lock);
+    if (channel < 0) {
+        Mix_SetError("Invalid channel number");
+        retval = 0;
+    } else if (channel < num_emitters && emitters[channel] &&
+               SDL_AtomicGet(&emitters[channel]->in_use)) {
+        retval = emitter_remove(channel, emitters[channel]);
+    }
+    SDL_UnlockMutex(position_lock);
     return(retval);
 }
 
@@ -31,6 +31,7 @@
 
 #include "SDL.h"
 #include "SDL_mixer.h"
+#include "mixer.h"
 
 #define __MIX_INTERNAL_EFFECT__
 #include "effects_internal.h"
@@ -127,6 +128,15 @@ int Mix_SetReverseStereo(int channel, int flip)
             return(0);
         }
 
+        if (channel >= 0) {
+            /* The mixer swaps the sides of a channel for free as it
+               mixes it, which saves the effect's pass over the buffer */
+            int retval;
+            Mix_LockAudio();
+            retval = _Mix_SetChannelReverse_locked(channel, flip);
+            Mix_UnlockAudio();
+            return(retval);
+        }
         if (!flip) {
             return(Mix_UnregisterEffect(channel, f));
         } else {
@@ -44,15 +44,43 @@ int _Mix_effects_max_speed = 0;
 void _Mix_InitEffects(void)
 {
     _Mix_effects_max_speed = (SDL_getenv(MIX_EFFECTSMAXSPEED) != NULL);
+    _Eff_PositionInit();
 }
 
 void _Mix_DeinitEffects(void)
 {
     _Eff_PositionDeinit();
+    _Eff_DSPDeinit();
 }
 
 
-void *_Eff_volume_table = NULL;
+/* The middle slot of a triple buffer holds this when it's newer than front */
+#define SLOT_FRESH  4
+#define SLOT_INDEX  3
+
+/* Publish the filled in 'back' slot, returns the slot to fill next time */
+int _Eff_slot_publish(SDL_atomic_t *middle, int back)
+{
+    SDL_MemoryBarrierRelease();
+    return SDL_AtomicSet(middle, back | SLOT_FRESH) & SLOT_INDEX;
+}
+
+/* Trade 'front' for the newest slot, if something was published since */
+SDL_bool _Eff_slot_acquire(SDL_atomic_t *middle, int *front)
+{
+    if (!(SDL_AtomicGet(middle) & SLOT_FRESH)) {
+        return SDL_FALSE;
+    }
+    *front = SDL_AtomicSet(middle, *front) & SLOT_INDEX;
+    SDL_MemoryBarrierAcquire();
+    return SDL_TRUE;
+}
+
+
+/* One table per format, a device reopened as the other 8-bit format can't
+   reuse the first one's */
+void *_Eff_volume_table_u8 = NULL;
+void *_Eff_volume_table_s8 = NULL;
 
 
 /* Build the volume table for Uint8-format samples.
@@ -72,10 +100,10 @@ void *_Eff_build_volume_table_u8(void)
         return(NULL);
     }
 
-    if (!_Eff_volume_table) {
+    if (!_Eff_volume_table_u8) {
         rc = SDL_malloc(256 * 256);
         if (rc) {
-            _Eff_volume_table = (void *) rc;
+            _Eff_volume_table_u8 = (void *) rc;
             for (volume = 0; volume < 256; volume++) {
                 for (sample = -128; sample < 128; sample ++) {
                     *rc = (Uint8)(((float) sample) * ((float) volume / 255.0))
@@ -86,7 +114,7 @@ void *_Eff_build_volume_table_u8(void)
         }
     }
 
-    return(_Eff_volume_table);
+    return(_Eff_volume_table_u8);
 }
 
 
@@ -103,10 +131,10 @@ void *_Eff_build_volume_table_s8(void)
     int sample;
     Sint8 *rc;
 
-    if (!_Eff_volume_table) {
+    if (!_Eff_volume_table_s8) {
         rc = SDL_malloc(256 * 256);
         if (rc) {
-            _Eff_volume_table = (void *) rc;
+            _Eff_volume_table_s8 = (void *) rc;
             for (volume = 0; volume < 256; volume++) {
                 for (sample = -128; sample < 128; sample ++) {
                     *rc = (Sint8)(((float) sample) * ((float) volume / 255.0));
@@ -116,7 +144,23 @@ void *_Eff_build_volume_table_s8(void)
         }
     }
 
-    return(_Eff_volume_table);
+    return(_Eff_volume_table_s8);
+}
+
+
+/* Build the table the positional effects will want for a device in
+ *  'format', so that they never allocate it while the game is running.
+ *  Only the 8-bit formats use one. Returns zero if it couldn't be built.
+ */
+int _Eff_PrepareVolumeTables(Uint16 format)
+{
+    if (format == AUDIO_U8 && _Mix_effects_max_speed) {
+        return(_Eff_build_volume_table_u8() != NULL);
+    }
+    if (format == AUDIO_S8) {
+        return(_Eff_build_volume_table_s8() != NULL);
+    }
+    return(1);
 }
 
 
@@ -28,22 +28,68 @@
 #error You should not include this file or use these functions.
 #endif
 
+#include "SDL_atomic.h"
 #include "SDL_mixer.h"
 
 extern int _Mix_effects_max_speed;
-extern void *_Eff_volume_table;
+extern void *_Eff_volume_table_u8;
+extern void *_Eff_volume_table_s8;
 void *_Eff_build_volume_table_u8(void);
 void *_Eff_build_volume_table_s8(void);
+int _Eff_PrepareVolumeTables(Uint16 format);
 
 void _Mix_InitEffects(void);
 void _Mix_DeinitEffects(void);
+void _Eff_PositionInit(void);
 void _Eff_PositionDeinit(void);
+void _Eff_DSPDeinit(void);
+
+/* Triple buffers for effect parameters: the game thread fills slot 'back'
+   and publishes it, the effect trades its slot 'front' for the newest one.
+   Start with back 0, front 1 and 'middle' set to 2. */
+int _Eff_slot_publish(SDL_atomic_t *middle, int back);
+SDL_bool _Eff_slot_acquire(SDL_atomic_t *middle, int *front);
 
 int _Mix_RegisterEffect_locked(int channel, Mix_EffectFunc_t f,
                                Mix_EffectDone_t d, void *arg);
+
+/* An effect that only scales each speaker can also offer the mixer its
+   gains for the next 'frames' frames instead: 'gains' for the first frame
+   and 'steps' for how they change per frame, one entry per channel.
+   When it's the last effect on a channel the mixer applies them as it
+   adds the channel to the bus, skipping the effect buffer. Returns
+   SDL_FALSE if those frames need the effect function after all. */
+typedef SDL_bool (*_Mix_EffectGains_t)(int chan, int frames, float *gains, float *steps, void *udata);
+
+int _Mix_RegisterGainEffect_locked(int channel, Mix_EffectFunc_t f,
+                                   Mix_EffectCopyFunc_t c, Mix_EffectDone_t d,
+                                   _Mix_EffectGains_t g, void *arg);
 int _Mix_UnregisterEffect_locked(int channel, Mix_EffectFunc_t f);
 int _Mix_UnregisterAllEffects_locked(int channel);
 
+/* An effect on the float bus, for 'samples' interleaved floats of the
+   device's channels. On a channel these run after all of its other
+   effects, as it's converted for adding to the bus. On MIX_CHANNEL_POST
+   they run on the whole bus before it's clipped, so before the other
+   posteffects. */
+typedef void (*_Mix_EffectBus_t)(int chan, float *buf, int samples, void *udata);
+
+int _Mix_RegisterBusEffect_locked(int channel, _Mix_EffectBus_t f,
+                                  Mix_EffectDone_t d, void *arg);
+int _Mix_UnregisterBusEffect_locked(int channel, _Mix_EffectBus_t f);
+
+/* What a channel adds to the bus is also added to a send bus, scaled by
+   its send level, while there's a send effect. That runs once per
+   callback on the summed sends and adds its output to 'bus'. */
+typedef void (*_Mix_EffectSend_t)(const float *send, float *bus, int samples, void *udata);
+
+void _Mix_SetSendEffect_locked(_Mix_EffectSend_t f, void *arg);
+int _Mix_SetChannelSend_locked(int channel, float level);
+
+/* Have the mixer swap the sides of a stereo channel as it adds it to the
+   bus, after the channel's effects, see Mix_SetReverseStereo() */
+int _Mix_SetChannelReverse_locked(int channel, int flip);
+
 #endif /* _INCLUDE_EFFECTS_INTERNAL_H_ */
 
 /* vi: set ts=4 sw=4 expandtab: */
@@ -44,6 +44,23 @@ LOCAL_SRC_FILES := \
     src/libFLAC/ogg_helper.c \
     src/libFLAC/ogg_mapping.c
 
+# The NEON restore loops, picked at runtime on armeabi-v7a
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_CFLAGS += -DFLAC__HAS_NEONINTRIN=1
+    LOCAL_SRC_FILES += \
+        src/libFLAC/fixed_intrin_neon.c.neon \
+        src/libFLAC/lpc_intrin_neon.c.neon
+    LOCAL_STATIC_LIBRARIES += cpufeatures
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+    LOCAL_CFLAGS += -DFLAC__HAS_NEONINTRIN=1
+    LOCAL_SRC_FILES += \
+        src/libFLAC/fixed_intrin_neon.c \
+        src/libFLAC/lpc_intrin_neon.c
+endif
+
 LOCAL_EXPORT_C_INCLUDES += $(LOCAL_C_INCLUDES)
 
 include $(BUILD_STATIC_LIBRARY)
+
+$(call import-module,android/cpufeatures)
@@ -11,7 +11,13 @@
 #define CPU_IS_LITTLE_ENDIAN 1
 
 /* Set FLAC__BYTES_PER_WORD to 8 (4 is the default) */
+/* The one config.h serves every ABI; the 64-bit ones read and write the
+   bitstream a machine word at a time */
+#if defined(__aarch64__) || defined(__x86_64__)
+#define ENABLE_64_BIT_WORDS 1
+#else
 #define ENABLE_64_BIT_WORDS 0
+#endif
 
 /* define to align allocated memory on 32-byte boundaries */
 #define FLAC__ALIGN_MALLOC_DATA 1
@@ -47,6 +47,10 @@
 #  include <cpuid.h> /* for __get_cpuid() and __get_cpuid_max() */
 #endif
 
+#if defined FLAC__CPU_ARM && !defined FLAC__NO_ASM && FLAC__HAS_NEONINTRIN && defined __ANDROID__
+#  include <cpu-features.h> /* for android_getCpuFeatures() */
+#endif
+
 #ifdef DEBUG
 #include <stdio.h>
 
@@ -233,6 +237,26 @@ x86_64_cpu_info (FLAC__CPUInfo *info)
 #endif
 }
 
+static void
+arm_cpu_info (FLAC__CPUInfo *info)
+{
+#if defined FLAC__NO_ASM || !FLAC__HAS_NEONINTRIN
+	info->use_asm = false;
+#else
+	info->use_asm = true;
+#if defined FLAC__CPU_ARM64
+	info->arm.neon = true;	/* part of ARMv8-A */
+#elif defined __ANDROID__
+	info->arm.neon = (android_getCpuFamily() == ANDROID_CPU_FAMILY_ARM &&
+	                  (android_getCpuFeatures() & ANDROID_CPU_ARM_FEATURE_NEON)) ? true : false;
+#else
+	info->arm.neon = true;	/* the build said so */
+#endif
+	dfprintf(stderr, "CPU info (ARM):\n");
+	dfprintf(stderr, "  NEON ....... %c\n", info->arm.neon ? 'Y' : 'n');
+#endif
+}
+
 void FLAC__cpu_info (FLAC__CPUInfo *info)
 {
 	memset(info, 0, sizeof(*info));
@@ -241,6 +265,8 @@ void FLAC__cpu_info (FLAC__CPUInfo *info)
 	info->type = FLAC__CPUINFO_TYPE_IA32;
 #elif defined FLAC__CPU_X86_64
 	info->type = FLAC__CPUINFO_TYPE_X86_64;
+#elif defined FLAC__CPU_ARM || defined FLAC__CPU_ARM64
+	info->type = FLAC__CPUINFO_TYPE_ARM;
 #else
 	info->type = FLAC__CPUINFO_TYPE_UNKNOWN;
 	info->use_asm = false;
@@ -253,6 +279,9 @@ void FLAC__cpu_info (FLAC__CPUInfo *info)
 	case FLAC__CPUINFO_TYPE_X86_64:
 		x86_64_cpu_info (info);
 		break;
+	case FLAC__CPUINFO_TYPE_ARM:
+		arm_cpu_info (info);
+		break;
 	default:
 		info->use_asm = false;
 		break;
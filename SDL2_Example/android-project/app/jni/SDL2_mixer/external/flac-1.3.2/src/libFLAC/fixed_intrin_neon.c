@@ -0,0 +1,102 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2000-2009  Josh Coalson
+ * Copyright (C) 2011-2016  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if (defined FLAC__CPU_ARM || defined FLAC__CPU_ARM64) && FLAC__HAS_NEONINTRIN
+#include "private/fixed.h"
+
+#include "FLAC/assert.h"
+
+#include <arm_neon.h>
+
+/* The four lanes summed up from the first, on top of 'carry', which holds
+ * the sum just before them in every lane */
+static inline int32x4_t running_sum_(int32x4_t v, int32x4_t carry)
+{
+	const int32x4_t zero = vdupq_n_s32(0);
+
+	v = vaddq_s32(v, vextq_s32(zero, v, 3));
+	v = vaddq_s32(v, vextq_s32(zero, v, 2));
+	return vaddq_s32(v, carry);
+}
+
+/*
+ * The fixed predictor of order n makes the residual the n-th difference of
+ * the signal, so the signal is the residual summed up n times over.  Each
+ * of those running sums picks up from the matching difference of the
+ * warm-up samples, and the sums are four samples at a time.  The wrapping
+ * of the additions is the same as that of the C loop.
+ */
+void FLAC__fixed_restore_signal_intrin_neon(const FLAC__int32 residual[], unsigned data_len, unsigned order, FLAC__int32 data[])
+{
+	FLAC__int32 delta[FLAC__MAX_FIXED_ORDER];
+	int32x4_t carry[FLAC__MAX_FIXED_ORDER];
+	unsigned i, j, k;
+
+	FLAC__ASSERT(order <= FLAC__MAX_FIXED_ORDER);
+
+	if(order == 0 || data_len < 4) {
+		FLAC__fixed_restore_signal(residual, data_len, order, data);
+		return;
+	}
+
+	/* delta[k] becomes the k-th difference at data[-1] */
+	for(k = 0; k < order; k++)
+		delta[k] = data[(int)k - (int)order];
+	for(k = 0; k < order; k++) {
+		FLAC__int32 last = delta[order - 1];
+		for(j = order - 1; j > k; j--)
+			delta[j] = (FLAC__int32)((FLAC__uint32)delta[j] - (FLAC__uint32)delta[j - 1]);
+		delta[k] = last;
+	}
+	for(k = 0; k < order; k++)
+		carry[k] = vdupq_n_s32(delta[order - 1 - k]);
+
+	for(i = 0; i + 4 <= data_len; i += 4) {
+		int32x4_t v = vld1q_s32(residual + i);
+		for(k = 0; k < order; k++) {
+			v = running_sum_(v, carry[k]);
+			carry[k] = vdupq_lane_s32(vget_high_s32(v), 1);
+		}
+		vst1q_s32(data + i, v);
+	}
+	FLAC__fixed_restore_signal(residual + i, data_len - i, order, data + i);
+}
+
+#endif /* (FLAC__CPU_ARM || FLAC__CPU_ARM64) && FLAC__HAS_NEONINTRIN */
+#endif /* FLAC__NO_ASM */
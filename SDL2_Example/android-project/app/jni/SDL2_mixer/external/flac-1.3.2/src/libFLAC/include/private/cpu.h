@@ -55,6 +55,28 @@
 
 #endif
 
+#ifndef FLAC__CPU_ARM64
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define FLAC__CPU_ARM64
+#endif
+
+#endif
+
+#ifndef FLAC__CPU_ARM
+
+#if defined(__arm__) || defined(_M_ARM)
+#define FLAC__CPU_ARM
+#endif
+
+#endif
+
+/* Set by the build when the NEON sources are compiled in; on 32-bit ARM
+ * only those files are built with NEON, so it can't come from __ARM_NEON */
+#ifndef FLAC__HAS_NEONINTRIN
+#define FLAC__HAS_NEONINTRIN 0
+#endif
+
 
 #if FLAC__HAS_X86INTRIN
 /* SSE intrinsics support by ICC/MSVC/GCC */
@@ -135,6 +157,7 @@
 typedef enum {
 	FLAC__CPUINFO_TYPE_IA32,
 	FLAC__CPUINFO_TYPE_X86_64,
+	FLAC__CPUINFO_TYPE_ARM,
 	FLAC__CPUINFO_TYPE_UNKNOWN
 } FLAC__CPUInfo_Type;
 
@@ -167,12 +190,17 @@ typedef struct {
 	FLAC__bool fma;
 } FLAC__CPUInfo_x86;
 
+typedef struct {
+	FLAC__bool neon;
+} FLAC__CPUInfo_ARM;
+
 
 typedef struct {
 	FLAC__bool use_asm;
 	FLAC__CPUInfo_Type type;
 	FLAC__CPUInfo_IA32 ia32;
 	FLAC__CPUInfo_x86 x86;
+	FLAC__CPUInfo_ARM arm;
 } FLAC__CPUInfo;
 
 void FLAC__cpu_info(FLAC__CPUInfo *info);
@@ -103,5 +103,8 @@ void FLAC__fixed_compute_residual(const FLAC__int32 data[], unsigned data_len, u
  *	OUT data[0,data_len-1]            original signal
  */
 void FLAC__fixed_restore_signal(const FLAC__int32 residual[], unsigned data_len, unsigned order, FLAC__int32 data[]);
+#if !defined FLAC__NO_ASM && (defined FLAC__CPU_ARM || defined FLAC__CPU_ARM64) && FLAC__HAS_NEONINTRIN
+void FLAC__fixed_restore_signal_intrin_neon(const FLAC__int32 residual[], unsigned data_len, unsigned order, FLAC__int32 data[]);
+#endif
 
 #endif
@@ -0,0 +1,135 @@
+/* libFLAC - Free Lossless Audio Codec library
+ * Copyright (C) 2000-2009  Josh Coalson
+ * Copyright (C) 2011-2016  Xiph.Org Foundation
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * - Redistributions of source code must retain the above copyright
+ * notice, this list of conditions and the following disclaimer.
+ *
+ * - Redistributions in binary form must reproduce the above copyright
+ * notice, this list of conditions and the following disclaimer in the
+ * documentation and/or other materials provided with the distribution.
+ *
+ * - Neither the name of the Xiph.org Foundation nor the names of its
+ * contributors may be used to endorse or promote products derived from
+ * this software without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR
+ * A PARTICULAR PURPOSE ARE DISCLAIMED.  IN NO EVENT SHALL THE FOUNDATION OR
+ * CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL,
+ * EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO,
+ * PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR
+ * PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF
+ * LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING
+ * NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF THE USE OF THIS
+ * SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH DAMAGE.
+ */
+
+#ifdef HAVE_CONFIG_H
+#  include <config.h>
+#endif
+
+#include "private/cpu.h"
+
+#ifndef FLAC__NO_ASM
+#if (defined FLAC__CPU_ARM || defined FLAC__CPU_ARM64) && FLAC__HAS_NEONINTRIN
+#include "private/lpc.h"
+
+#include "FLAC/assert.h"
+#include "FLAC/format.h"
+
+#include <arm_neon.h>
+
+/*
+ * Every sample depends on the ones just before it, so these vectorize the
+ * predictor's dot product rather than the loop over the samples.  The
+ * coefficients are reversed and padded with zeroes at the front to a
+ * multiple of four taps, so that four samples loaded straight from the
+ * history line up with the coefficients the C loop multiplies them with.
+ * The padding reaches up to three samples before data[-order], which the
+ * stream decoder keeps zeroed in front of its output buffers.  Orders
+ * under four gain nothing and go to the C versions.
+ */
+
+static unsigned load_taps_(const FLAC__int32 qlp_coeff[], unsigned order, int32x4_t taps[8])
+{
+	FLAC__int32 reversed[32];
+	unsigned padded = (order + 3) & ~3u, j;
+
+	for(j = 0; j < padded - order; j++)
+		reversed[j] = 0;
+	for(j = 0; j < order; j++)
+		reversed[padded - 1 - j] = qlp_coeff[j];
+	for(j = 0; j < padded / 4; j++)
+		taps[j] = vld1q_s32(reversed + 4 * j);
+	return padded;
+}
+
+static inline FLAC__int32 sum_lanes_(int32x4_t sum)
+{
+#if defined FLAC__CPU_ARM64
+	return vaddvq_s32(sum);
+#else
+	int32x2_t half = vadd_s32(vget_low_s32(sum), vget_high_s32(sum));
+	return vget_lane_s32(vpadd_s32(half, half), 0);
+#endif
+}
+
+void FLAC__lpc_restore_signal_intrin_neon(const FLAC__int32 residual[], unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 data[])
+{
+	int32x4_t taps[8];
+	unsigned i, j, padded;
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order < 4) {
+		FLAC__lpc_restore_signal(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	padded = load_taps_(qlp_coeff, order, taps);
+	for(i = 0; i < data_len; i++) {
+		const FLAC__int32 *history = data + i - padded;
+		int32x4_t sum = vmulq_s32(vld1q_s32(history), taps[0]);
+		for(j = 1; j < padded / 4; j++)
+			sum = vmlaq_s32(sum, vld1q_s32(history + 4 * j), taps[j]);
+		data[i] = residual[i] + (sum_lanes_(sum) >> lp_quantization);
+	}
+}
+
+void FLAC__lpc_restore_signal_wide_intrin_neon(const FLAC__int32 residual[], unsigned data_len, const FLAC__int32 qlp_coeff[], unsigned order, int lp_quantization, FLAC__int32 data[])
+{
+	int32x4_t taps[8];
+	unsigned i, j, padded;
+
+	FLAC__ASSERT(order > 0);
+	FLAC__ASSERT(order <= 32);
+
+	if(order < 4) {
+		FLAC__lpc_restore_signal_wide(residual, data_len, qlp_coeff, order, lp_quantization, data);
+		return;
+	}
+
+	padded = load_taps_(qlp_coeff, order, taps);
+	for(i = 0; i < data_len; i++) {
+		const FLAC__int32 *history = data + i - padded;
+		int64x2_t sum = vdupq_n_s64(0);
+		FLAC__int64 total;
+		for(j = 0; j < padded / 4; j++) {
+			int32x4_t samples = vld1q_s32(history + 4 * j);
+			sum = vmlal_s32(sum, vget_low_s32(samples), vget_low_s32(taps[j]));
+			sum = vmlal_s32(sum, vget_high_s32(samples), vget_high_s32(taps[j]));
+		}
+		total = vgetq_lane_s64(sum, 0) + vgetq_lane_s64(sum, 1);
+		data[i] = residual[i] + (FLAC__int32)(total >> lp_quantization);
+	}
+}
+
+#endif /* (FLAC__CPU_ARM || FLAC__CPU_ARM64) && FLAC__HAS_NEONINTRIN */
+#endif /* FLAC__NO_ASM */
@@ -8,8 +8,14 @@ LOCAL_C_INCLUDES := $(LOCAL_PATH)/src $(LOCAL_PATH)/src/libmodplug
 
 LOCAL_CFLAGS += -DHAVE_SETENV -DHAVE_SINF
 
+# fastmix.cpp picks its NEON mixing loops at compile time
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_SRC_FILES += src/fastmix.cpp.neon
+else
+    LOCAL_SRC_FILES += src/fastmix.cpp
+endif
+
 LOCAL_SRC_FILES += \
-    src/fastmix.cpp \
     src/load_669.cpp \
     src/load_abc.cpp \
     src/load_amf.cpp \
@@ -9,6 +9,11 @@
 #include "sndfile.h"
 #include <math.h>
 
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define MODPLUG_NEON
+#endif
+
 #ifdef MSC_VER
 #pragma bss_seg(".modplug")
 #endif
@@ -568,6 +573,152 @@ CzWINDOWEDFIR sfir;
 	fy2 = fy1; fy1 = vol_l;\
 	fy4 = fy3; fy3 = vol_r;\
 
+//////////////////////////////////////////////////////////
+// NEON versions of the 16-bit linear and spline loops
+//
+// Four output frames per iteration. NEON has no gather load, so the sample
+// positions are still walked one at a time, but the interpolation and the
+// accumulation into the mix buffer are done four frames at once. Results are
+// identical to the scalar macros, which also handle the remaining frames.
+
+#ifdef MODPLUG_NEON
+
+static inline int32x4_t NEON_Sum4(int32x4_t a, int32x4_t b, int32x4_t c, int32x4_t d)
+{
+	int32x2_t ab = vpadd_s32(vpadd_s32(vget_low_s32(a), vget_high_s32(a)),
+				 vpadd_s32(vget_low_s32(b), vget_high_s32(b)));
+	int32x2_t cd = vpadd_s32(vpadd_s32(vget_low_s32(c), vget_high_s32(c)),
+				 vpadd_s32(vget_low_s32(d), vget_high_s32(d)));
+	return vcombine_s32(ab, cd);
+}
+
+static inline int32x4_t NEON_GetMonoVol16Linear(const signed short *p, LONG &nPos, LONG nInc)
+{
+	int16_t src[4], dest[4];
+	int32_t frac[4];
+	for (int i=0; i<4; i++)
+	{
+		int poshi = nPos >> 16;
+		src[i] = p[poshi];
+		dest[i] = p[poshi+1];
+		frac[i] = (nPos >> 8) & 0xFF;
+		nPos += nInc;
+	}
+	int16x4_t s = vld1_s16(src);
+	int32x4_t delta = vmulq_s32(vsubl_s16(vld1_s16(dest), s), vld1q_s32(frac));
+	return vsraq_n_s32(vmovl_s16(s), delta, 8);
+}
+
+static inline int32x4_t NEON_GetMonoVol16Spline(const signed short *p, LONG &nPos, LONG nInc)
+{
+	int32x4_t t[4];
+	for (int i=0; i<4; i++)
+	{
+		int poshi = nPos >> 16;
+		int poslo = (nPos >> SPLINE_FRACSHIFT) & SPLINE_FRACMASK;
+		t[i] = vmull_s16(vld1_s16(&CzCUBICSPLINE::lut[poslo]), vld1_s16(p+poshi-1));
+		nPos += nInc;
+	}
+	return vshrq_n_s32(NEON_Sum4(t[0], t[1], t[2], t[3]), SPLINE_16SHIFT);
+}
+
+static inline void NEON_GetStereoVol16Linear(const signed short *p, LONG &nPos, LONG nInc, int32x4_t &vol_l, int32x4_t &vol_r)
+{
+	int16_t src_l[4], src_r[4], dest_l[4], dest_r[4];
+	int32_t frac[4];
+	for (int i=0; i<4; i++)
+	{
+		const signed short *s = p + (nPos >> 16) * 2;
+		src_l[i] = s[0];
+		src_r[i] = s[1];
+		dest_l[i] = s[2];
+		dest_r[i] = s[3];
+		frac[i] = (nPos >> 8) & 0xFF;
+		nPos += nInc;
+	}
+	int32x4_t f = vld1q_s32(frac);
+	int16x4_t sl = vld1_s16(src_l);
+	int16x4_t sr = vld1_s16(src_r);
+	vol_l = vsraq_n_s32(vmovl_s16(sl), vmulq_s32(vsubl_s16(vld1_s16(dest_l), sl), f), 8);
+	vol_r = vsraq_n_s32(vmovl_s16(sr), vmulq_s32(vsubl_s16(vld1_s16(dest_r), sr), f), 8);
+}
+
+static inline void NEON_GetStereoVol16Spline(const signed short *p, LONG &nPos, LONG nInc, int32x4_t &vol_l, int32x4_t &vol_r)
+{
+	int32x4_t tl[4], tr[4];
+	for (int i=0; i<4; i++)
+	{
+		int poshi = nPos >> 16;
+		int poslo = (nPos >> SPLINE_FRACSHIFT) & SPLINE_FRACMASK;
+		int16x4_t c = vld1_s16(&CzCUBICSPLINE::lut[poslo]);
+		int16x4x2_t s = vld2_s16(p+(poshi-1)*2);
+		tl[i] = vmull_s16(c, s.val[0]);
+		tr[i] = vmull_s16(c, s.val[1]);
+		nPos += nInc;
+	}
+	vol_l = vshrq_n_s32(NEON_Sum4(tl[0], tl[1], tl[2], tl[3]), SPLINE_16SHIFT);
+	vol_r = vshrq_n_s32(NEON_Sum4(tr[0], tr[1], tr[2], tr[3]), SPLINE_16SHIFT);
+}
+
+#define SNDMIX_BEGINSAMPLELOOP16NEON\
+	register MODCHANNEL * const pChn = pChannel;\
+	nPos = pChn->nPosLo;\
+	const signed short *p = (signed short *)(pChn->pCurrentSample+(pChn->nPos*2));\
+	if (pChn->dwFlags & CHN_STEREO) p += pChn->nPos;\
+	int *pvol = pbuffer;\
+	while (pbufmax - pvol >= 8) {
+
+// The vector loop has already stepped nPos; what follows is the scalar tail
+#define SNDMIX_ENDSAMPLELOOPNEON\
+	}\
+	while (pvol < pbufmax) {
+
+#define SNDMIX_GETMONOVOL16LINEARNEON\
+	int32x4_t vol = NEON_GetMonoVol16Linear(p, nPos, pChn->nInc);
+
+#define SNDMIX_GETMONOVOL16SPLINENEON\
+	int32x4_t vol = NEON_GetMonoVol16Spline(p, nPos, pChn->nInc);
+
+#define SNDMIX_GETSTEREOVOL16LINEARNEON\
+	int32x4_t vol_l, vol_r;\
+	NEON_GetStereoVol16Linear(p, nPos, pChn->nInc, vol_l, vol_r);
+
+#define SNDMIX_GETSTEREOVOL16SPLINENEON\
+	int32x4_t vol_l, vol_r;\
+	NEON_GetStereoVol16Spline(p, nPos, pChn->nInc, vol_l, vol_r);
+
+#define SNDMIX_STOREMONOVOLNEON\
+	int32x4x2_t acc = vld2q_s32(pvol);\
+	acc.val[0] = vmlaq_n_s32(acc.val[0], vol, pChn->nRightVol);\
+	acc.val[1] = vmlaq_n_s32(acc.val[1], vol, pChn->nLeftVol);\
+	vst2q_s32(pvol, acc);\
+	pvol += 8;
+
+#define SNDMIX_STORESTEREOVOLNEON\
+	int32x4x2_t acc = vld2q_s32(pvol);\
+	acc.val[0] = vmlaq_n_s32(acc.val[0], vol_l, pChn->nRightVol);\
+	acc.val[1] = vmlaq_n_s32(acc.val[1], vol_r, pChn->nLeftVol);\
+	vst2q_s32(pvol, acc);\
+	pvol += 8;
+
+#define SNDMIX_STOREFASTMONOVOLNEON\
+	int32x4x2_t acc = vld2q_s32(pvol);\
+	int32x4_t v = vmulq_n_s32(vol, pChn->nRightVol);\
+	acc.val[0] = vaddq_s32(acc.val[0], v);\
+	acc.val[1] = vaddq_s32(acc.val[1], v);\
+	vst2q_s32(pvol, acc);\
+	pvol += 8;
+
+#define END_NEONMIX_INTERFACE()\
+		nPos += pChn->nInc;\
+	}\
+	pChn->nPos += nPos >> 16;\
+	pChn->nPosLo = nPos & 0xFFFF;\
+	}
+
+#endif // MODPLUG_NEON
+
+
 //////////////////////////////////////////////////////////
 // Interfaces
 
@@ -693,10 +844,20 @@ BEGIN_MIX_INTERFACE(Mono8BitLinearMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(Mono16BitLinearMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETMONOVOL16LINEARNEON
+	SNDMIX_STOREMONOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETMONOVOL16LINEAR
+	SNDMIX_STOREMONOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETMONOVOL16LINEAR
 	SNDMIX_STOREMONOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(Mono8BitSplineMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -705,10 +866,20 @@ BEGIN_MIX_INTERFACE(Mono8BitSplineMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(Mono16BitSplineMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETMONOVOL16SPLINENEON
+	SNDMIX_STOREMONOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETMONOVOL16SPLINE
+	SNDMIX_STOREMONOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETMONOVOL16SPLINE
 	SNDMIX_STOREMONOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(Mono8BitFirFilterMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -795,10 +966,20 @@ BEGIN_MIX_INTERFACE(FastMono8BitLinearMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(FastMono16BitLinearMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETMONOVOL16LINEARNEON
+	SNDMIX_STOREFASTMONOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETMONOVOL16LINEAR
+	SNDMIX_STOREFASTMONOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETMONOVOL16LINEAR
 	SNDMIX_STOREFASTMONOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(FastMono8BitSplineMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -807,10 +988,20 @@ BEGIN_MIX_INTERFACE(FastMono8BitSplineMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(FastMono16BitSplineMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETMONOVOL16SPLINENEON
+	SNDMIX_STOREFASTMONOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETMONOVOL16SPLINE
+	SNDMIX_STOREFASTMONOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETMONOVOL16SPLINE
 	SNDMIX_STOREFASTMONOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(FastMono8BitFirFilterMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -897,10 +1088,20 @@ BEGIN_MIX_INTERFACE(Stereo8BitLinearMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(Stereo16BitLinearMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETSTEREOVOL16LINEARNEON
+	SNDMIX_STORESTEREOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETSTEREOVOL16LINEAR
+	SNDMIX_STORESTEREOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETSTEREOVOL16LINEAR
 	SNDMIX_STORESTEREOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(Stereo8BitSplineMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -909,10 +1110,20 @@ BEGIN_MIX_INTERFACE(Stereo8BitSplineMix)
 END_MIX_INTERFACE()
 
 BEGIN_MIX_INTERFACE(Stereo16BitSplineMix)
+#ifdef MODPLUG_NEON
+	SNDMIX_BEGINSAMPLELOOP16NEON
+	SNDMIX_GETSTEREOVOL16SPLINENEON
+	SNDMIX_STORESTEREOVOLNEON
+	SNDMIX_ENDSAMPLELOOPNEON
+	SNDMIX_GETSTEREOVOL16SPLINE
+	SNDMIX_STORESTEREOVOL
+END_NEONMIX_INTERFACE()
+#else
 	SNDMIX_BEGINSAMPLELOOP16
 	SNDMIX_GETSTEREOVOL16SPLINE
 	SNDMIX_STORESTEREOVOL
 END_MIX_INTERFACE()
+#endif
 
 BEGIN_MIX_INTERFACE(Stereo8BitFirFilterMix)
 	SNDMIX_BEGINSAMPLELOOP8
@@ -2029,6 +2240,14 @@ done:;
 // Will fill in later.
 void MPPASMCALL X86_InitMixBuffer(int *pBuffer, UINT nSamples)
 {
+#ifdef MODPLUG_NEON
+	const int32x4_t zero = vdupq_n_s32(0);
+	for (; nSamples >= 8; nSamples -= 8, pBuffer += 8)
+	{
+		vst1q_s32(pBuffer, zero);
+		vst1q_s32(pBuffer+4, zero);
+	}
+#endif
 	memset(pBuffer, 0, nSamples * sizeof(int));
 }
 #endif
@@ -2104,7 +2323,15 @@ stloop:
 VOID MPPASMCALL X86_MonoFromStereo(int *pMixBuf, UINT nSamples)
 {
 	UINT j;
-	for(UINT i = 0; i < nSamples; i++)
+	UINT i = 0;
+#ifdef MODPLUG_NEON
+	for (; i + 4 <= nSamples; i += 4)
+	{
+		int32x4x2_t lr = vld2q_s32(pMixBuf + i*2);
+		vst1q_s32(pMixBuf + i, vhaddq_s32(lr.val[0], lr.val[1]));
+	}
+#endif
+	for(; i < nSamples; i++)
 	{
 		j = i << 1;
 		pMixBuf[i] = (pMixBuf[j] + pMixBuf[j + 1]) >> 1;
@@ -2203,8 +2430,11 @@ void MPPASMCALL X86_StereoFill(int *pBuffer, UINT nSamples, LPLONG lpROfs, LPLON
 		X86_InitMixBuffer(pBuffer, nSamples*2);
 		return;
 	}
-	for (UINT i=0; i<nSamples; i++)
+	UINT i;
+	for (i=0; i<nSamples; i++)
 	{
+		// Both offsets decay to exactly zero, after which the rest is silence
+		if ((!rofs) && (!lofs)) break;
 		int x_r = (rofs + (((-rofs)>>31) & OFSDECAYMASK)) >> OFSDECAYSHIFT;
 		int x_l = (lofs + (((-lofs)>>31) & OFSDECAYMASK)) >> OFSDECAYSHIFT;
 		rofs -= x_r;
@@ -2212,6 +2442,7 @@ void MPPASMCALL X86_StereoFill(int *pBuffer, UINT nSamples, LPLONG lpROfs, LPLON
 		pBuffer[i*2] = x_r;
 		pBuffer[i*2+1] = x_l;
 	}
+	if (i < nSamples) X86_InitMixBuffer(pBuffer+i*2, (nSamples-i)*2);
 	*lpROfs = rofs;
 	*lpLOfs = lofs;
 }
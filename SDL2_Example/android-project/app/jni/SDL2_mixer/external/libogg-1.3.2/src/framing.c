@@ -700,28 +700,27 @@ long ogg_sync_pageseek(ogg_sync_state *oy,ogg_page *og){
 
   if(oy->bodybytes+oy->headerbytes>bytes)return(0);
 
-  /* The whole test page is buffered.  Verify the checksum */
+  /* The whole test page is buffered.  Verify the checksum, counting
+     the checksum field as zero without writing to the page, so that
+     pages can be synced straight out of read only memory */
   {
-    /* Grab the checksum bytes, set the header field to zero */
-    char chksum[4];
-    ogg_page log;
+    ogg_uint32_t crc_reg=0;
+    ogg_uint32_t chksum;
+    int i,len=oy->headerbytes+oy->bodybytes;
 
-    memcpy(chksum,page+22,4);
-    memset(page+22,0,4);
+    for(i=0;i<22;i++)
+      crc_reg=(crc_reg<<8)^crc_lookup[((crc_reg >> 24)&0xff)^page[i]];
+    for(;i<26;i++)
+      crc_reg=(crc_reg<<8)^crc_lookup[((crc_reg >> 24)&0xff)];
+    for(;i<len;i++)
+      crc_reg=(crc_reg<<8)^crc_lookup[((crc_reg >> 24)&0xff)^page[i]];
 
-    /* set up a temp page struct and recompute the checksum */
-    log.header=page;
-    log.header_len=oy->headerbytes;
-    log.body=page+oy->headerbytes;
-    log.body_len=oy->bodybytes;
-    ogg_page_checksum_set(&log);
+    chksum=page[22]|(page[23]<<8)|(page[24]<<16)|((ogg_uint32_t)page[25]<<24);
 
     /* Compare */
-    if(memcmp(chksum,page+22,4)){
+    if(chksum!=crc_reg){
       /* D'oh.  Mismatch! Corrupt page (or miscapture and not a page
          at all) */
-      /* replace the computed checksum with the one actually read in */
-      memcpy(page+22,chksum,4);
 
       /* Bad checksum. Lose sync */
       goto sync_fail;
@@ -8,9 +8,22 @@ LOCAL_C_INCLUDES :=
 
 LOCAL_CFLAGS :=
 
+LOCAL_STATIC_LIBRARIES :=
+
+# asm_arm.h is 32-bit ARM only, on arm64 the C wide math is already a
+# single smull.  The NEON loops are picked at runtime on armeabi-v7a.
 ifeq ($(TARGET_ARCH),arm)
     LOCAL_CFLAGS += -D_ARM_ASSEM_
 endif
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_CFLAGS += -DVORBIS_NEON
+    LOCAL_SRC_FILES += neon.c.arm.neon
+    LOCAL_STATIC_LIBRARIES += cpufeatures
+endif
+ifeq ($(TARGET_ARCH_ABI),arm64-v8a)
+    LOCAL_CFLAGS += -DVORBIS_NEON
+    LOCAL_SRC_FILES += neon.c
+endif
 
 LOCAL_SRC_FILES += \
     mdct.c.arm \
@@ -30,3 +43,5 @@ LOCAL_SRC_FILES += \
 LOCAL_SHARED_LIBRARIES := ogg
 
 include $(BUILD_STATIC_LIBRARY)
+
+$(call import-module,android/cpufeatures)
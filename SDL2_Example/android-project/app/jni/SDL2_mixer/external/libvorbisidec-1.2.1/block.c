@@ -25,6 +25,18 @@
 #include "window.h"
 #include "registry.h"
 #include "misc.h"
+#include "neon.h"
+
+/* pcm[i]+=p[i] for i<n */
+static void overlap_add(ogg_int32_t *pcm,const ogg_int32_t *p,long n){
+  long i=0;
+#ifdef _V_NEON
+  if(vorbis_has_neon())
+    i=_vorbis_overlap_add_neon(pcm,p,n);
+#endif
+  for(;i<n;i++)
+    pcm[i]+=p[i];
+}
 
 static int ilog(unsigned int v){
   int ret=0;
@@ -318,30 +330,26 @@ int vorbis_synthesis_blockin(vorbis_dsp_state *v,vorbis_block *vb){
 	  /* large/large */
 	  ogg_int32_t *pcm=v->pcm[j]+prevCenter;
 	  ogg_int32_t *p=vb->pcm[j];
-	  for(i=0;i<n1;i++)
-	    pcm[i]+=p[i];
+	  overlap_add(pcm,p,n1);
 	}else{
 	  /* large/small */
 	  ogg_int32_t *pcm=v->pcm[j]+prevCenter+n1/2-n0/2;
 	  ogg_int32_t *p=vb->pcm[j];
-	  for(i=0;i<n0;i++)
-	    pcm[i]+=p[i];
+	  overlap_add(pcm,p,n0);
 	}
       }else{
 	if(v->W){
 	  /* small/large */
 	  ogg_int32_t *pcm=v->pcm[j]+prevCenter;
 	  ogg_int32_t *p=vb->pcm[j]+n1/2-n0/2;
-	  for(i=0;i<n0;i++)
-	    pcm[i]+=p[i];
-	  for(;i<n1/2+n0/2;i++)
+	  overlap_add(pcm,p,n0);
+	  for(i=n0;i<n1/2+n0/2;i++)
 	    pcm[i]=p[i];
 	}else{
 	  /* small/small */
 	  ogg_int32_t *pcm=v->pcm[j]+prevCenter;
 	  ogg_int32_t *p=vb->pcm[j];
-	  for(i=0;i<n0;i++)
-	    pcm[i]+=p[i];
+	  overlap_add(pcm,p,n0);
 	}
       }
       
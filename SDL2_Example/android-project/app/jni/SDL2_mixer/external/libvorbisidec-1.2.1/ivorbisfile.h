@@ -83,6 +83,11 @@ typedef struct OggVorbis_File {
 
   ov_callbacks callbacks;
 
+  /* The whole stream, for ov_open_memory() */
+  const unsigned char *memory;
+  ogg_int64_t      memory_size;
+  ogg_int64_t      memory_pos; /* how much of it the framer was given */
+
 } OggVorbis_File;
 
 extern int ov_clear(OggVorbis_File *vf);
@@ -90,6 +95,11 @@ extern int ov_open(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes);
 extern int ov_open_callbacks(void *datasource, OggVorbis_File *vf,
 		const char *initial, long ibytes, ov_callbacks callbacks);
 
+/* ov_open_memory() is there, which parses the pages in place */
+#define OV_HAVE_OPEN_MEMORY 1
+extern int ov_open_memory(void *datasource, OggVorbis_File *vf,
+		const void *data, ogg_int64_t size, ov_callbacks callbacks);
+
 extern int ov_test(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes);
 extern int ov_test_callbacks(void *datasource, OggVorbis_File *vf,
 		const char *initial, long ibytes, ov_callbacks callbacks);
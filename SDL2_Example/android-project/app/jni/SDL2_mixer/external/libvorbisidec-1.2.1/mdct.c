@@ -37,6 +37,7 @@
 #include "misc.h"
 #include "mdct.h"
 #include "mdct_lookup.h"
+#include "neon.h"
 
 
 /* 8 point butterfly (in place) */
@@ -398,6 +399,12 @@ void mdct_backward(int n, DATA_TYPE *in, DATA_TYPE *out){
     DATA_TYPE *oX2=out+n2+n4;
     DATA_TYPE *iX =out;
 
+#ifdef _V_NEON
+    /* one table pair after another, as 2048 sample blocks go */
+    if(step==2 && vorbis_has_neon())
+      mdct_rotate_neon(out,sincos_lookup1,n);
+    else
+#endif
     switch(step) {
       default: {
         T=(step>=4)?(sincos_lookup0+(step>>1)):sincos_lookup1;
@@ -477,6 +484,12 @@ void mdct_backward(int n, DATA_TYPE *in, DATA_TYPE *out){
       }
     }
 
+#ifdef _V_NEON
+    if(vorbis_has_neon()){
+      mdct_unfold_neon(out,n);
+      return;
+    }
+#endif
     iX=out+n2+n4;
     oX1=out+n4;
     oX2=oX1;
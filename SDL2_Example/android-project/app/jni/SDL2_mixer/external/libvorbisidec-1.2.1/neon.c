@@ -0,0 +1,131 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis 'TREMOR' CODEC SOURCE CODE.   *
+ *                                                                  *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis 'TREMOR' SOURCE CODE IS (C) COPYRIGHT 1994-2002    *
+ * BY THE Xiph.Org FOUNDATION http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: NEON versions of the synthesis inner loops
+
+ ********************************************************************/
+
+#include "ivorbiscodec.h"
+#include "misc.h"
+#include "neon.h"
+
+#ifdef _V_NEON
+
+#include <arm_neon.h>
+#if defined(__ANDROID__) && !defined(__aarch64__)
+#include <cpu-features.h>
+#endif
+
+int vorbis_has_neon(void){
+#if defined(__aarch64__)
+  return 1;
+#elif defined(__ANDROID__)
+  /* Asking is cheap enough, cpufeatures only looks once */
+  return android_getCpuFamily()==ANDROID_CPU_FAMILY_ARM &&
+    (android_getCpuFeatures()&ANDROID_CPU_ARM_FEATURE_NEON);
+#else
+  return 1;
+#endif
+}
+
+/* MULT31() four at a time: vqdmulh gives (x*y)>>31, MULT31() drops the
+   lowest bit of that.  Saturation only happens for -1*-1, which none of
+   the tables hold. */
+STIN int32x4_t mult31_neon(int32x4_t x,int32x4_t y){
+  return vandq_s32(vqdmulhq_s32(x,y),vdupq_n_s32(~1));
+}
+
+/* The four lanes in the opposite order */
+STIN int32x4_t reverse_neon(int32x4_t x){
+  x=vrev64q_s32(x);
+  return vcombine_s32(vget_high_s32(x),vget_low_s32(x));
+}
+
+long _vorbis_window_neon(ogg_int32_t *d,const ogg_int32_t *w,long n){
+  long i;
+  for(i=0;i+4<=n;i+=4)
+    vst1q_s32(d+i,mult31_neon(vld1q_s32(d+i),vld1q_s32(w+i)));
+  return i;
+}
+
+long _vorbis_window_reverse_neon(ogg_int32_t *d,const ogg_int32_t *w,long n){
+  long i;
+  for(i=0;i+4<=n;i+=4)
+    vst1q_s32(d+i,mult31_neon(vld1q_s32(d+i),reverse_neon(vld1q_s32(w-i-3))));
+  return i;
+}
+
+long _vorbis_overlap_add_neon(ogg_int32_t *d,const ogg_int32_t *s,long n){
+  long i;
+  for(i=0;i+4<=n;i+=4)
+    vst1q_s32(d+i,vaddq_s32(vld1q_s32(d+i),vld1q_s32(s+i)));
+  return i;
+}
+
+/* Four of
+     XPROD31( iX[0], -iX[1], T[0], T[1], &oX1[3], &oX2[0] ); T+=2;
+   per pass, as in mdct_backward() */
+void mdct_rotate_neon(ogg_int32_t *out,const ogg_int32_t *T,int n){
+  int n2=n>>1;
+  int n4=n>>2;
+  ogg_int32_t *oX1=out+n2+n4;
+  ogg_int32_t *oX2=out+n2+n4;
+  ogg_int32_t *iX =out;
+
+  do{
+    int32x4x2_t in=vld2q_s32(iX);
+    int32x4x2_t tv=vld2q_s32(T);
+    int32x4_t a=in.val[0];
+    int32x4_t b=vnegq_s32(in.val[1]);
+    int32x4_t x=vaddq_s32(mult31_neon(a,tv.val[0]),mult31_neon(b,tv.val[1]));
+    int32x4_t y=vsubq_s32(mult31_neon(b,tv.val[0]),mult31_neon(a,tv.val[1]));
+
+    oX1-=4;
+    vst1q_s32(oX1,reverse_neon(x));
+    vst1q_s32(oX2,y);
+    T+=8;
+    oX2+=4;
+    iX+=8;
+  }while(iX<oX1);
+}
+
+/* The last two loops of mdct_backward() */
+void mdct_unfold_neon(ogg_int32_t *out,int n){
+  int n2=n>>1;
+  int n4=n>>2;
+  ogg_int32_t *iX=out+n2+n4;
+  ogg_int32_t *oX1=out+n4;
+  ogg_int32_t *oX2=oX1;
+
+  do{
+    int32x4_t x;
+    oX1-=4;
+    iX-=4;
+    x=vld1q_s32(iX);
+    vst1q_s32(oX1,x);
+    vst1q_s32(oX2,vnegq_s32(reverse_neon(x)));
+    oX2+=4;
+  }while(oX2<iX);
+
+  iX=out+n2+n4;
+  oX1=out+n2+n4;
+  oX2=out+n2;
+
+  do{
+    oX1-=4;
+    vst1q_s32(oX1,reverse_neon(vld1q_s32(iX)));
+    iX+=4;
+  }while(oX1>oX2);
+}
+
+#endif
@@ -0,0 +1,48 @@
+/********************************************************************
+ *                                                                  *
+ * THIS FILE IS PART OF THE OggVorbis 'TREMOR' CODEC SOURCE CODE.   *
+ *                                                                  *
+ * USE, DISTRIBUTION AND REPRODUCTION OF THIS LIBRARY SOURCE IS     *
+ * GOVERNED BY A BSD-STYLE SOURCE LICENSE INCLUDED WITH THIS SOURCE *
+ * IN 'COPYING'. PLEASE READ THESE TERMS BEFORE DISTRIBUTING.       *
+ *                                                                  *
+ * THE OggVorbis 'TREMOR' SOURCE CODE IS (C) COPYRIGHT 1994-2002    *
+ * BY THE Xiph.Org FOUNDATION http://www.xiph.org/                  *
+ *                                                                  *
+ ********************************************************************
+
+ function: NEON versions of the synthesis inner loops
+
+ ********************************************************************/
+
+#ifndef _V_NEON_H_
+#define _V_NEON_H_
+
+/* Built with VORBIS_NEON (see Android.mk) the windowing, overlap/add
+   and the MDCT's output passes have NEON versions in neon.c, used when
+   the CPU has NEON.  They round as the C MULT31() does, not as the
+   _ARM_ASSEM_ one.  Each does the part of the work it can and returns
+   how much, the C code finishes off the rest. */
+
+#if defined(VORBIS_NEON) && !defined(_LOW_ACCURACY_)
+#define _V_NEON
+
+extern int vorbis_has_neon(void);
+
+/* d[i]=MULT31(d[i],w[i]) for i<n */
+extern long _vorbis_window_neon(ogg_int32_t *d,const ogg_int32_t *w,long n);
+/* d[i]=MULT31(d[i],w[-i]) for i<n, w working down */
+extern long _vorbis_window_reverse_neon(ogg_int32_t *d,const ogg_int32_t *w,
+					long n);
+/* d[i]+=s[i] for i<n */
+extern long _vorbis_overlap_add_neon(ogg_int32_t *d,const ogg_int32_t *s,
+				     long n);
+
+/* The rotate pass of mdct_backward() for tables stepped through one
+   pair at a time, and the two copies that unfold its output */
+extern void mdct_rotate_neon(ogg_int32_t *out,const ogg_int32_t *T,int n);
+extern void mdct_unfold_neon(ogg_int32_t *out,int n);
+
+#endif
+
+#endif
@@ -58,9 +58,32 @@
  * grokking near the end of the file */
 
 
+/* The most of an in memory stream the framer is pointed at at once,
+   its counts are ints */
+#define MEMORY_WINDOW 0x40000000
+
 /* read a little more data from the file/pipe into the ogg_sync framer */
 static long _get_data(OggVorbis_File *vf){
   errno=0;
+  if(vf->memory){
+    /* no reading or copying: the framer is pointed at the stream itself,
+       from the first byte it hasn't returned, to the end */
+    ogg_int64_t start=vf->memory_pos-(vf->oy.fill-vf->oy.returned);
+    ogg_int64_t end=vf->memory_size;
+    long bytes;
+
+    if(end-start>MEMORY_WINDOW)end=start+MEMORY_WINDOW;
+    bytes=(long)(end-vf->memory_pos);
+    if(bytes<=0)return(0);
+
+    /* libogg syncs pages without writing to them, so the memory can be
+       a read only mapping */
+    vf->oy.data=(unsigned char *)vf->memory+start;
+    vf->oy.storage=vf->oy.fill=(int)(end-start);
+    vf->oy.returned=0;
+    vf->memory_pos=end;
+    return(bytes);
+  }
   if(!(vf->callbacks.read_func))return(-1);
   if(vf->datasource){
     char *buffer=ogg_sync_buffer(&vf->oy,CHUNKSIZE);
@@ -74,7 +97,13 @@ static long _get_data(OggVorbis_File *vf){
 
 /* save a tiny smidge of verbosity to make the code more readable */
 static int _seek_helper(OggVorbis_File *vf,ogg_int64_t offset){
-  if(vf->datasource){
+  if(vf->memory){
+    if(offset<0 || offset>vf->memory_size)
+      return OV_EREAD;
+    vf->offset=offset;
+    vf->memory_pos=offset;
+    ogg_sync_reset(&vf->oy);
+  }else if(vf->datasource){
     if(!(vf->callbacks.seek_func)||
        (vf->callbacks.seek_func)(vf->datasource, offset, SEEK_SET) == -1)
       return OV_EREAD;
@@ -619,7 +648,9 @@ static int _open_seekable2(OggVorbis_File *vf){
   ogg_int64_t pcmoffset = _initial_pcmoffset(vf,vf->vi);
 
   /* we can seek, so set out learning all about this file */
-  if(vf->callbacks.seek_func && vf->callbacks.tell_func){
+  if(vf->memory){
+    vf->offset=vf->end=vf->memory_size;
+  }else if(vf->callbacks.seek_func && vf->callbacks.tell_func){
     (vf->callbacks.seek_func)(vf->datasource,0,SEEK_END);
     vf->offset=vf->end=(vf->callbacks.tell_func)(vf->datasource);
   }else{
@@ -867,8 +898,10 @@ static int _fseek64_wrap(FILE *f,ogg_int64_t off,int whence){
 }
 
 static int _ov_open1(void *f,OggVorbis_File *vf,const char *initial,
-                     long ibytes, ov_callbacks callbacks){
-  int offsettest=((f && callbacks.seek_func)?callbacks.seek_func(f,0,SEEK_CUR):-1);
+                     long ibytes, ov_callbacks callbacks,
+                     const void *memory, ogg_int64_t memory_size){
+  int offsettest=memory?0:
+    ((f && callbacks.seek_func)?callbacks.seek_func(f,0,SEEK_CUR):-1);
   ogg_uint32_t *serialno_list=NULL;
   int serialno_list_size=0;
   int ret;
@@ -876,6 +909,8 @@ static int _ov_open1(void *f,OggVorbis_File *vf,const char *initial,
   memset(vf,0,sizeof(*vf));
   vf->datasource=f;
   vf->callbacks = callbacks;
+  vf->memory=(const unsigned char *)memory;
+  vf->memory_size=memory_size;
 
   /* init the framing state */
   ogg_sync_init(&vf->oy);
@@ -962,6 +997,7 @@ int ov_clear(OggVorbis_File *vf){
     if(vf->pcmlengths)_ogg_free(vf->pcmlengths);
     if(vf->serialnos)_ogg_free(vf->serialnos);
     if(vf->offsets)_ogg_free(vf->offsets);
+    if(vf->memory)vf->oy.data=NULL; /* the stream's, not the framer's */
     ogg_sync_clear(&vf->oy);
     if(vf->datasource && vf->callbacks.close_func)
       (vf->callbacks.close_func)(vf->datasource);
@@ -983,7 +1019,21 @@ int ov_clear(OggVorbis_File *vf){
 
 int ov_open_callbacks(void *f,OggVorbis_File *vf,
     const char *initial,long ibytes,ov_callbacks callbacks){
-  int ret=_ov_open1(f,vf,initial,ibytes,callbacks);
+  int ret=_ov_open1(f,vf,initial,ibytes,callbacks,NULL,0);
+  if(ret)return ret;
+  return _ov_open2(vf);
+}
+
+/* Open the stream that is the 'size' bytes at 'data', such as a file
+   mapped into memory, which have to stay there until ov_clear.  Pages
+   are parsed where they are instead of being read into the framer's
+   buffer, so read_func, seek_func and tell_func aren't called;
+   close_func still gets 'f' on ov_clear. */
+int ov_open_memory(void *f,OggVorbis_File *vf,
+    const void *data,ogg_int64_t size,ov_callbacks callbacks){
+  int ret;
+  if(!data || size<0)return(OV_EINVAL);
+  ret=_ov_open1(f,vf,NULL,0,callbacks,data,size);
   if(ret)return ret;
   return _ov_open2(vf);
 }
@@ -1018,7 +1068,7 @@ int ov_fopen(const char *path,OggVorbis_File *vf){
 int ov_test_callbacks(void *f,OggVorbis_File *vf,
     const char *initial,long ibytes,ov_callbacks callbacks)
 {
-  return _ov_open1(f,vf,initial,ibytes,callbacks);
+  return _ov_open1(f,vf,initial,ibytes,callbacks,NULL,0);
 }
 
 int ov_test(FILE *f,OggVorbis_File *vf,const char *initial,long ibytes){
@@ -20,6 +20,7 @@
 #include "misc.h"
 #include "window.h"
 #include "window_lookup.h"
+#include "neon.h"
 
 const void *_vorbis_window(int type, int left){
 
@@ -72,10 +73,26 @@ void _vorbis_apply_window(ogg_int32_t *d,const void *window_p[2],
   for(i=0;i<leftbegin;i++)
     d[i]=0;
 
-  for(p=0;i<leftend;i++,p++)
+  p=0;
+#ifdef _V_NEON
+  if(vorbis_has_neon()){
+    p=_vorbis_window_neon(d+i,window[lW],leftend-i);
+    i+=p;
+  }
+#endif
+  for(;i<leftend;i++,p++)
     d[i]=MULT31(d[i],window[lW][p]);
 
-  for(i=rightbegin,p=rn/2-1;i<rightend;i++,p--)
+  i=rightbegin;
+  p=rn/2-1;
+#ifdef _V_NEON
+  if(vorbis_has_neon()){
+    long done=_vorbis_window_reverse_neon(d+i,window[nW]+p,rightend-i);
+    i+=done;
+    p-=done;
+  }
+#endif
+  for(;i<rightend;i++,p--)
     d[i]=MULT31(d[i],window[nW][p]);
 
   for(;i<n;i++)
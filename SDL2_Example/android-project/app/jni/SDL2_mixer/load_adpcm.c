@@ -0,0 +1,217 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer_bus.h"
+#include "load_adpcm.h"
+
+/* Each block starts every channel over from a stored state, so decoding
+   can begin at any block, and channels sharing the chunk don't need any
+   decoder state of their own. */
+#define ADPCM_BLOCK_FRAMES  256
+#define ADPCM_CHANNEL_BYTES (4 + ADPCM_BLOCK_FRAMES / 2)
+
+/* What chunk->abuf points to, followed by the blocks */
+typedef struct _Mix_ADPCMHeader
+{
+    Uint32 frames;
+    Uint32 pcm_len;     /* the chunk's length in the device format */
+    int channels;
+    int padding;
+} adpcm_header;
+
+static const Sint16 adpcm_steps[89] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37,
+    41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118, 130, 143, 157, 173,
+    190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658,
+    724, 796, 876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894,
+    6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289,
+    16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+
+static const Sint8 adpcm_index_steps[16] = {
+    -1, -1, -1, -1, 2, 4, 6, 8, -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+/* Run the decoder over one nibble, returns the new sample */
+static SDL_INLINE int adpcm_step(int nibble, int *sample, int *index)
+{
+    const int step = adpcm_steps[*index];
+    int diff = step >> 3;
+
+    if (nibble & 4) diff += step;
+    if (nibble & 2) diff += step >> 1;
+    if (nibble & 1) diff += step >> 2;
+    if (nibble & 8) diff = -diff;
+
+    *sample = SDL_max(-32768, SDL_min(32767, *sample + diff));
+    *index = SDL_max(0, SDL_min(88, *index + adpcm_index_steps[nibble]));
+    return *sample;
+}
+
+/* Pick the nibble that gets closest to 'target' */
+static int adpcm_encode(int target, int *sample, int *index)
+{
+    const int step = adpcm_steps[*index];
+    int diff = target - *sample;
+    int nibble = 0;
+
+    if (diff < 0) {
+        nibble = 8;
+        diff = -diff;
+    }
+    if (diff >= step) {
+        nibble |= 4;
+        diff -= step;
+    }
+    if (diff >= step >> 1) {
+        nibble |= 2;
+        diff -= step >> 1;
+    }
+    if (diff >= step >> 2) {
+        nibble |= 1;
+    }
+
+    /* Track what the decoder is going to make of it */
+    adpcm_step(nibble, sample, index);
+    return nibble;
+}
+
+static Uint8 *adpcm_block(const Mix_Chunk *chunk, Uint32 block)
+{
+    const adpcm_header *header = (const adpcm_header *)chunk->abuf;
+    return chunk->abuf + sizeof(*header) + block * header->channels * ADPCM_CHANNEL_BYTES;
+}
+
+Uint32 _Mix_ADPCMLength(const Mix_Chunk *chunk)
+{
+    return ((const adpcm_header *)chunk->abuf)->pcm_len;
+}
+
+void _Mix_ADPCMDecode(const Mix_Chunk *chunk, Uint32 frame, int frames, float *dst)
+{
+    const adpcm_header *header = (const adpcm_header *)chunk->abuf;
+    const int channels = header->channels;
+    Uint32 block = frame / ADPCM_BLOCK_FRAMES;
+    int skip = (int)(frame % ADPCM_BLOCK_FRAMES);
+    int c, i, n, sample, index;
+    const Uint8 *data;
+    float *out;
+
+    while (frames > 0) {
+        n = SDL_min(frames, ADPCM_BLOCK_FRAMES - skip);
+        data = adpcm_block(chunk, block);
+
+        /* The channels are stored one after the other in a block */
+        for (c = 0; c < channels; ++c, data += ADPCM_CHANNEL_BYTES) {
+            sample = (Sint16)(data[0] | (data[1] << 8));
+            index = data[2];
+            out = dst + c;
+            for (i = 0; i < skip + n; ++i) {
+                const int byte = data[4 + i / 2];
+                adpcm_step((i & 1) ? (byte >> 4) : (byte & 0x0F), &sample, &index);
+                if (i >= skip) {
+                    *out = (float)sample * (1.0f / 32768.0f);
+                    out += channels;
+                }
+            }
+        }
+        dst += n * channels;
+        frames -= n;
+        skip = 0;
+        ++block;
+    }
+}
+
+Mix_Chunk *Mix_LoadWAVCompressed_RW(SDL_RWops *src, int freesrc)
+{
+    Mix_Chunk *pcm, *chunk;
+    adpcm_header *header;
+    Uint16 format;
+    int channels, frame_size, blocks, b, c, i, n, sample, index, target;
+    float *samples;
+    int *indexes;       /* where each channel's step size got to */
+    Uint8 *data;
+
+    pcm = Mix_LoadWAV_RW(src, freesrc);
+    if (!pcm) {
+        return(NULL);
+    }
+    Mix_QuerySpec(NULL, &format, &channels);
+    frame_size = (SDL_AUDIO_BITSIZE(format) / 8) * channels;
+
+    chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
+    samples = (float *)SDL_malloc(ADPCM_BLOCK_FRAMES * channels * sizeof(float));
+    indexes = (int *)SDL_calloc(channels, sizeof(int));
+    header = NULL;
+    blocks = (int)(((pcm->alen / frame_size) + ADPCM_BLOCK_FRAMES - 1) / ADPCM_BLOCK_FRAMES);
+    if (chunk && samples && indexes) {
+        header = (adpcm_header *)SDL_malloc(sizeof(*header) + blocks * channels * ADPCM_CHANNEL_BYTES);
+    }
+    if (!header) {
+        SDL_free(chunk);
+        SDL_free(samples);
+        SDL_free(indexes);
+        Mix_FreeChunk(pcm);
+        Mix_SetError("Out of memory");
+        return(NULL);
+    }
+    header->frames = pcm->alen / frame_size;
+    header->pcm_len = header->frames * frame_size;
+    header->channels = channels;
+    header->padding = 0;
+    chunk->allocated = MIX_CHUNK_ADPCM;
+    chunk->abuf = (Uint8 *)header;
+    chunk->alen = (Uint32)(sizeof(*header) + blocks * channels * ADPCM_CHANNEL_BYTES);
+    chunk->volume = pcm->volume;
+
+    for (b = 0; b < blocks; ++b) {
+        n = (int)SDL_min(header->frames - b * ADPCM_BLOCK_FRAMES, ADPCM_BLOCK_FRAMES);
+        _Mix_BusLoad(samples, pcm->abuf + b * ADPCM_BLOCK_FRAMES * frame_size, format, n * channels);
+        data = adpcm_block(chunk, b);
+        SDL_memset(data, 0, channels * ADPCM_CHANNEL_BYTES);
+
+        for (c = 0; c < channels; ++c, data += ADPCM_CHANNEL_BYTES) {
+            /* Start the block off its first sample, and the step size
+               the block before ended up with */
+            sample = (int)SDL_max(-32768.0f, SDL_min(32767.0f, samples[c] * 32768.0f));
+            index = indexes[c];
+            data[0] = (Uint8)(sample & 0xFF);
+            data[1] = (Uint8)((sample >> 8) & 0xFF);
+            data[2] = (Uint8)index;
+            for (i = 0; i < n; ++i) {
+                target = (int)SDL_max(-32768.0f, SDL_min(32767.0f, samples[i * channels + c] * 32768.0f));
+                data[4 + i / 2] |= (Uint8)(adpcm_encode(target, &sample, &index) << ((i & 1) * 4));
+            }
+            indexes[c] = index;
+        }
+    }
+
+    SDL_free(samples);
+    SDL_free(indexes);
+    Mix_FreeChunk(pcm);
+    return(chunk);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,40 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Chunks that stay IMA ADPCM compressed in memory and are decoded as they
+   are mixed, for about a quarter of the memory of 16-bit samples.
+ */
+
+#ifndef LOAD_ADPCM_H_
+#define LOAD_ADPCM_H_
+
+/* Mix_Chunk.allocated value for chunks from Mix_LoadWAVCompressed_RW() */
+#define MIX_CHUNK_ADPCM     4
+
+/* Bytes the samples of a MIX_CHUNK_ADPCM chunk take in the device format */
+extern Uint32 _Mix_ADPCMLength(const Mix_Chunk *chunk);
+
+/* Decode 'frames' frames from frame 'frame' on to floats in [-1.0, 1.0] */
+extern void _Mix_ADPCMDecode(const Mix_Chunk *chunk, Uint32 frame, int frames, float *dst);
+
+#endif /* LOAD_ADPCM_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
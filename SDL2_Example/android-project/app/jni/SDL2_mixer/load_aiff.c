@@ -31,6 +31,7 @@
 #include "SDL_endian.h"
 #include "SDL_mixer.h"
 #include "load_aiff.h"
+#include "load_mmap.h"
 
 /*********************************************/
 /* Define values for AIFF (IFF audio) format */
@@ -60,150 +61,240 @@ static Uint32 SANE_to_Uint32 (Uint8 *sanebuf)
         | (sanebuf[5] >> 1)) >> (29 - sanebuf[1]);
 }
 
-/* This function is based on SDL_LoadWAV_RW(). */
+/* The chunk headers are read at once, this much of the file and all of
+   it only if they don't fit */
+#define AIFF_HEAD_SIZE  4096
 
-SDL_AudioSpec *Mix_LoadAIFF_RW (SDL_RWops *src, int freesrc,
-    SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
-{
-    int was_error;
+/* What the chunk headers say */
+typedef struct {
+    Uint32 AIFFmagic;
     int found_SSND;
     int found_COMM;
     int found_VHDR;
     int found_BODY;
-    Sint64 start = 0;
+    int truncated;          /* the headers went on past the data parsed */
+    size_t start;           /* offset of the samples */
+    Uint16 channels;
+    Uint32 numsamples;
+    Uint16 samplesize;
+    Uint32 frequency;
+} aiff_info;
+
+/* These read from 'data' at 'pos' and move it on, giving 0 past the end
+   like SDL_ReadBE32() and friends do */
+static Uint32 aiff_read32(const Uint8 *data, size_t size, size_t *pos, SDL_bool big)
+{
+    Uint32 value = 0;
+
+    if (*pos <= size && size - *pos >= 4) {
+        SDL_memcpy(&value, data + *pos, 4);
+        value = big ? SDL_SwapBE32(value) : SDL_SwapLE32(value);
+    }
+    *pos += 4;
+    return value;
+}
+
+static Uint16 aiff_read16(const Uint8 *data, size_t size, size_t *pos)
+{
+    Uint16 value = 0;
+
+    if (*pos <= size && size - *pos >= 2) {
+        SDL_memcpy(&value, data + *pos, 2);
+        value = SDL_SwapBE16(value);
+    }
+    *pos += 2;
+    return value;
+}
+
+/* Go through the chunks in the 'size' bytes at 'data', which start with
+   the FORM header. Returns 0, or -1 with the error set. */
+static int aiff_parse(const Uint8 *data, size_t size, aiff_info *info)
+{
+    size_t pos = 0;
 
     Uint32 chunk_type;
     Uint32 chunk_length;
-    Sint64 next_chunk;
+    size_t next_chunk;
 
     /* AIFF magic header */
     Uint32 FORMchunk;
-    Uint32 AIFFmagic;
 
     /* SSND chunk */
     Uint32 offset;
-    Uint32 blocksize;
 
     /* COMM format chunk */
-    Uint16 channels = 0;
-    Uint32 numsamples = 0;
-    Uint16 samplesize = 0;
     Uint8 sane_freq[10];
-    Uint32 frequency = 0;
 
-    /* Make sure we are passed a valid data source */
-    was_error = 0;
-    if (src == NULL) {
-        was_error = 1;
-        goto done;
-    }
+    SDL_memset(info, 0, sizeof(*info));
 
-    FORMchunk   = SDL_ReadLE32(src);
-    chunk_length    = SDL_ReadBE32(src);
+    FORMchunk   = aiff_read32(data, size, &pos, SDL_FALSE);
+    chunk_length    = aiff_read32(data, size, &pos, SDL_TRUE);
     if (chunk_length == AIFF) { /* The FORMchunk has already been read */
-        AIFFmagic    = chunk_length;
+        info->AIFFmagic = chunk_length;
         chunk_length = FORMchunk;
         FORMchunk    = FORM;
     } else {
-        AIFFmagic    = SDL_ReadLE32(src);
+        info->AIFFmagic = aiff_read32(data, size, &pos, SDL_FALSE);
     }
-    if ((FORMchunk != FORM) || ((AIFFmagic != AIFF) && (AIFFmagic != _8SVX))) {
+    if ((FORMchunk != FORM) || ((info->AIFFmagic != AIFF) && (info->AIFFmagic != _8SVX))) {
         SDL_SetError("Unrecognized file type (not AIFF nor 8SVX)");
-        was_error = 1;
-        goto done;
+        return -1;
     }
 
     /* TODO: Better santity-checking. */
 
-    found_SSND = 0;
-    found_COMM = 0;
-    found_VHDR = 0;
-    found_BODY = 0;
-
     do {
-        chunk_type  = SDL_ReadLE32(src);
-        chunk_length = SDL_ReadBE32(src);
-        next_chunk  = SDL_RWtell(src) + chunk_length;
+        chunk_type  = aiff_read32(data, size, &pos, SDL_FALSE);
+        chunk_length = aiff_read32(data, size, &pos, SDL_TRUE);
         /* Paranoia to avoid infinite loops */
+        if (pos > size) {
+            info->truncated = 1;
+            break;
+        }
         if (chunk_length == 0)
             break;
+        next_chunk  = (chunk_length > size - pos) ? size + 1 : pos + chunk_length;
 
         switch (chunk_type) {
             case SSND:
-                found_SSND  = 1;
-                offset      = SDL_ReadBE32(src);
-                blocksize   = SDL_ReadBE32(src);
-                start       = SDL_RWtell(src) + offset;
+                info->found_SSND = 1;
+                offset      = aiff_read32(data, size, &pos, SDL_TRUE);
+                aiff_read32(data, size, &pos, SDL_TRUE);    /* block size */
+                info->start = pos + offset;
                 break;
 
             case COMM:
-                found_COMM  = 1;
-                channels    = SDL_ReadBE16(src);
-                numsamples  = SDL_ReadBE32(src);
-                samplesize  = SDL_ReadBE16(src);
-                SDL_RWread(src, sane_freq, sizeof(sane_freq), 1);
-                frequency   = SANE_to_Uint32(sane_freq);
-                if (frequency == 0) {
+                info->found_COMM = 1;
+                info->channels   = aiff_read16(data, size, &pos);
+                info->numsamples = aiff_read32(data, size, &pos, SDL_TRUE);
+                info->samplesize = aiff_read16(data, size, &pos);
+                SDL_memset(sane_freq, 0, sizeof(sane_freq));
+                if (pos < size) {
+                    SDL_memcpy(sane_freq, data + pos, SDL_min(sizeof(sane_freq), size - pos));
+                }
+                pos += sizeof(sane_freq);
+                info->frequency  = SANE_to_Uint32(sane_freq);
+                if (info->frequency == 0 && pos <= size) {
                     SDL_SetError("Bad AIFF sample frequency");
-                    was_error = 1;
-                    goto done;
+                    return -1;
                 }
                 break;
 
             case VHDR:
-                found_VHDR  = 1;
-                SDL_ReadBE32(src);
-                SDL_ReadBE32(src);
-                SDL_ReadBE32(src);
-                frequency = SDL_ReadBE16(src);
-                channels = 1;
-                samplesize = 8;
+                info->found_VHDR = 1;
+                pos += 12;
+                info->frequency  = aiff_read16(data, size, &pos);
+                info->channels   = 1;
+                info->samplesize = 8;
                 break;
 
             case BODY:
-                found_BODY  = 1;
-                numsamples  = chunk_length;
-                start       = SDL_RWtell(src);
+                info->found_BODY = 1;
+                info->numsamples = chunk_length;
+                info->start      = pos;
                 break;
 
             default:
                 break;
         }
+        if (pos > size) {
+            info->truncated = 1;
+        }
         /* a 0 pad byte can be stored for any odd-length chunk */
         if (chunk_length&1)
             next_chunk++;
-    } while ((((AIFFmagic == AIFF) && (!found_SSND || !found_COMM))
-          || ((AIFFmagic == _8SVX) && (!found_VHDR || !found_BODY)))
-          && SDL_RWseek(src, next_chunk, RW_SEEK_SET) != 1);
+        pos = next_chunk;
+    } while (((info->AIFFmagic == AIFF) && (!info->found_SSND || !info->found_COMM))
+          || ((info->AIFFmagic == _8SVX) && (!info->found_VHDR || !info->found_BODY)));
 
-    if ((AIFFmagic == AIFF) && !found_SSND) {
+    return 0;
+}
+
+/* This function is based on SDL_LoadWAV_RW(). */
+
+SDL_AudioSpec *Mix_LoadAIFF_RW (SDL_RWops *src, int freesrc,
+    SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
+{
+    int was_error;
+    aiff_info info;
+
+    /* The start of the file, or all of it */
+    Uint8 head[AIFF_HEAD_SIZE];
+    const Uint8 *data;
+    size_t size = 0;
+    Sint64 head_pos = 0;
+    void *file = NULL;
+
+    Uint64 length;
+    size_t copied;
+    int short_read;
+    void *ptr;
+
+    /* Make sure we are passed a valid data source */
+    was_error = 0;
+    if (src == NULL) {
+        was_error = 1;
+        goto done;
+    }
+
+    /* A memory stream is parsed where it is, anything else from one read
+       of its start, or if the headers go on past that, of all of it */
+    data = (const Uint8 *)_Mix_RWMemory(src, &size);
+    if (data == NULL) {
+        head_pos = SDL_RWtell(src);
+        size = SDL_RWread(src, head, 1, sizeof(head));
+        data = head;
+    }
+    if (aiff_parse(data, size, &info) < 0) {
+        was_error = 1;
+        goto done;
+    }
+    if (data == head && info.truncated && size == sizeof(head)) {
+        if (SDL_RWseek(src, head_pos, RW_SEEK_SET) != head_pos) {
+            was_error = 1;
+            goto done;
+        }
+        data = (const Uint8 *)_Mix_RWReadAll(src, &size, &file);
+        if (data == NULL || aiff_parse(data, size, &info) < 0) {
+            was_error = 1;
+            goto done;
+        }
+    }
+
+    if ((info.AIFFmagic == AIFF) && !info.found_SSND) {
         SDL_SetError("Bad AIFF (no SSND chunk)");
         was_error = 1;
         goto done;
     }
 
-    if ((AIFFmagic == AIFF) && !found_COMM) {
+    if ((info.AIFFmagic == AIFF) && !info.found_COMM) {
         SDL_SetError("Bad AIFF (no COMM chunk)");
         was_error = 1;
         goto done;
     }
 
-    if ((AIFFmagic == _8SVX) && !found_VHDR) {
+    if ((info.AIFFmagic == _8SVX) && !info.found_VHDR) {
         SDL_SetError("Bad 8SVX (no VHDR chunk)");
         was_error = 1;
         goto done;
     }
 
-    if ((AIFFmagic == _8SVX) && !found_BODY) {
+    if ((info.AIFFmagic == _8SVX) && !info.found_BODY) {
         SDL_SetError("Bad 8SVX (no BODY chunk)");
         was_error = 1;
         goto done;
     }
 
+    if ((info.AIFFmagic == AIFF) && info.frequency == 0) {
+        SDL_SetError("Bad AIFF sample frequency");
+        was_error = 1;
+        goto done;
+    }
+
     /* Decode the audio data format */
     SDL_memset(spec, 0, sizeof(*spec));
-    spec->freq = frequency;
-    switch (samplesize) {
+    spec->freq = info.frequency;
+    switch (info.samplesize) {
         case 8:
             spec->format = AUDIO_S8;
             break;
@@ -215,25 +306,67 @@ SDL_AudioSpec *Mix_LoadAIFF_RW (SDL_RWops *src, int freesrc,
             was_error = 1;
             goto done;
     }
-    spec->channels = (Uint8) channels;
+    spec->channels = (Uint8) info.channels;
     spec->samples = 4096;       /* Good default buffer size */
 
-    *audio_len = channels * numsamples * (samplesize / 8);
-    *audio_buf = (Uint8 *)SDL_malloc(*audio_len);
-    if (*audio_buf == NULL) {
-        SDL_SetError("Out of memory");
-        return(NULL);
-    }
-    SDL_RWseek(src, start, RW_SEEK_SET);
-    if (SDL_RWread(src, *audio_buf, *audio_len, 1) != 1) {
+    length = (Uint64)info.channels * info.numsamples * (info.samplesize / 8);
+    if (length > SDL_MAX_SINT32 ||
+        (data != head && (info.start > size || length > size - info.start))) {
         SDL_SetError("Unable to read audio data");
-        return(NULL);
+        was_error = 1;
+        goto done;
+    }
+    *audio_len = (Uint32)length;
+
+    if (file) {
+        /* The samples are moved to the front of the buffer the file was
+           read into, and the rest of it given back */
+        SDL_memmove(file, data + info.start, *audio_len);
+        *audio_buf = (Uint8 *)file;
+        file = NULL;
+        ptr = SDL_realloc(*audio_buf, *audio_len);
+        if (ptr != NULL) {
+            *audio_buf = (Uint8 *)ptr;
+        }
+    } else {
+        *audio_buf = (Uint8 *)SDL_malloc(*audio_len);
+        if (*audio_buf == NULL) {
+            SDL_SetError("Out of memory");
+            was_error = 1;
+            goto done;
+        }
+        if (data != head) {
+            SDL_memcpy(*audio_buf, data + info.start, *audio_len);
+        } else {
+            /* Whatever of the samples came with the headers is kept, the
+               rest is read straight into place */
+            copied = 0;
+            short_read = 0;
+            if (info.start < size) {
+                copied = SDL_min(size - info.start, (size_t)*audio_len);
+                SDL_memcpy(*audio_buf, head + info.start, copied);
+            } else if (SDL_RWseek(src, head_pos + (Sint64)info.start, RW_SEEK_SET) < 0) {
+                short_read = 1;
+            }
+            if (!short_read && copied < *audio_len &&
+                SDL_RWread(src, *audio_buf + copied, *audio_len - copied, 1) != 1) {
+                short_read = 1;
+            }
+            if (short_read) {
+                SDL_free(*audio_buf);
+                *audio_buf = NULL;
+                SDL_SetError("Unable to read audio data");
+                was_error = 1;
+                goto done;
+            }
+        }
     }
 
     /* Don't return a buffer that isn't a multiple of samplesize */
-    *audio_len &= ~((samplesize / 8) - 1);
+    *audio_len &= ~((info.samplesize / 8) - 1);
 
 done:
+    SDL_free(file);
     if (freesrc && src) {
         SDL_RWclose(src);
     }
@@ -0,0 +1,218 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include "load_buffered.h"
+
+#define DEFAULT_BLOCK_SIZE  16384
+
+static SDL_atomic_t block_size = { DEFAULT_BLOCK_SIZE };
+
+typedef struct {
+    SDL_RWops *src;
+    int freesrc;
+    Sint64 size;        /* of 'src', -1 if it doesn't know */
+    Sint64 pos;         /* where the wrapper was read or seeked to */
+    Sint64 src_pos;     /* where 'src' is, -1 after a failed seek */
+    Sint64 buf_start;   /* the offset of buf[0] in 'src' */
+    size_t buf_len;
+    size_t block;
+    Uint8 *buf;
+} Buffered_Stream;
+
+int Mix_SetReadBufferSize(int bytes)
+{
+    if (bytes < 0) {
+        return SDL_AtomicGet(&block_size);
+    }
+    return SDL_AtomicSet(&block_size, bytes);
+}
+
+/* Get 'src' to where the wrapper is, if it isn't already */
+static SDL_bool buffered_sync(Buffered_Stream *stream)
+{
+    if (stream->src_pos != stream->pos) {
+        stream->src_pos = SDL_RWseek(stream->src, stream->pos, RW_SEEK_SET);
+        if (stream->src_pos != stream->pos) {
+            stream->src_pos = -1;
+            return SDL_FALSE;
+        }
+    }
+    return SDL_TRUE;
+}
+
+static Sint64 SDLCALL buffered_size(SDL_RWops *context)
+{
+    Buffered_Stream *stream = (Buffered_Stream *)context->hidden.unknown.data1;
+    return stream->size;
+}
+
+static Sint64 SDLCALL buffered_seek(SDL_RWops *context, Sint64 offset, int whence)
+{
+    Buffered_Stream *stream = (Buffered_Stream *)context->hidden.unknown.data1;
+    Sint64 pos;
+
+    switch (whence) {
+    case RW_SEEK_SET:
+        pos = offset;
+        break;
+    case RW_SEEK_CUR:
+        pos = stream->pos + offset;
+        break;
+    case RW_SEEK_END:
+        if (stream->size < 0) {
+            return SDL_SetError("Can't seek from the end of this stream");
+        }
+        pos = stream->size + offset;
+        break;
+    default:
+        return SDL_SetError("Unknown value for 'whence'");
+    }
+    if (pos < 0) {
+        return SDL_SetError("Seek before the start of the stream");
+    }
+    /* 'src' follows on the next read that misses the buffer */
+    stream->pos = pos;
+    return pos;
+}
+
+static size_t SDLCALL buffered_read(SDL_RWops *context, void *ptr, size_t size, size_t maxnum)
+{
+    Buffered_Stream *stream = (Buffered_Stream *)context->hidden.unknown.data1;
+    Uint8 *dst = (Uint8 *)ptr;
+    size_t wanted, total = 0;
+
+    if (size == 0 || maxnum == 0) {
+        return 0;
+    }
+    wanted = size * maxnum;
+    if (wanted / size != maxnum) {
+        SDL_SetError("Read size overflow");
+        return 0;
+    }
+
+    while (total < wanted) {
+        size_t amount;
+
+        if (stream->pos >= stream->buf_start &&
+            stream->pos < stream->buf_start + (Sint64)stream->buf_len) {
+            size_t offset = (size_t)(stream->pos - stream->buf_start);
+            amount = SDL_min(stream->buf_len - offset, wanted - total);
+            SDL_memcpy(dst + total, stream->buf + offset, amount);
+        } else if (!buffered_sync(stream)) {
+            break;
+        } else if (wanted - total >= stream->block) {
+            /* Nothing to gain from copying big reads through the buffer */
+            amount = SDL_RWread(stream->src, dst + total, 1, wanted - total);
+            if (amount == 0) {
+                break;
+            }
+            stream->src_pos += amount;
+        } else {
+            stream->buf_start = stream->pos;
+            stream->buf_len = SDL_RWread(stream->src, stream->buf, 1, stream->block);
+            stream->src_pos += stream->buf_len;
+            if (stream->buf_len == 0) {
+                break;
+            }
+            continue;
+        }
+        total += amount;
+        stream->pos += amount;
+    }
+
+    /* Like stdio, a partial object is read but not counted */
+    return total / size;
+}
+
+static size_t SDLCALL buffered_write(SDL_RWops *context, const void *ptr, size_t size, size_t num)
+{
+    SDL_SetError("Can't write to a read buffer");
+    return 0;
+}
+
+static int SDLCALL buffered_close(SDL_RWops *context)
+{
+    int retval = 0;
+
+    if (context) {
+        Buffered_Stream *stream = (Buffered_Stream *)context->hidden.unknown.data1;
+
+        if (stream->freesrc) {
+            retval = SDL_RWclose(stream->src);
+        } else {
+            SDL_RWseek(stream->src, stream->pos, RW_SEEK_SET);
+        }
+        SDL_free(stream->buf);
+        SDL_free(stream);
+        SDL_FreeRW(context);
+    }
+    return retval;
+}
+
+SDL_RWops *_Mix_RWFromBuffered(SDL_RWops *src, int freesrc)
+{
+    Buffered_Stream *stream;
+    SDL_RWops *context;
+    int block = SDL_AtomicGet(&block_size);
+
+    if (!src || block <= 0 ||
+        src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO) {
+        return src;
+    }
+
+    stream = (Buffered_Stream *)SDL_calloc(1, sizeof(*stream));
+    if (!stream) {
+        return src;
+    }
+    stream->buf = (Uint8 *)SDL_malloc(block);
+    context = SDL_AllocRW();
+    if (!stream->buf || !context) {
+        if (context) {
+            SDL_FreeRW(context);
+        }
+        SDL_free(stream->buf);
+        SDL_free(stream);
+        return src;
+    }
+
+    stream->src = src;
+    stream->freesrc = freesrc;
+    stream->block = (size_t)block;
+    stream->pos = SDL_RWtell(src);
+    if (stream->pos < 0) {
+        stream->pos = 0;
+    }
+    stream->src_pos = stream->pos;
+    stream->size = SDL_RWsize(src);
+
+    context->size = buffered_size;
+    context->seek = buffered_seek;
+    context->read = buffered_read;
+    context->write = buffered_write;
+    context->close = buffered_close;
+    context->type = SDL_RWOPS_UNKNOWN;
+    context->hidden.unknown.data1 = stream;
+    return context;
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
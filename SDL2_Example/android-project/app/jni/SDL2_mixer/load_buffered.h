@@ -0,0 +1,39 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* A read-ahead buffer in front of the streams the loaders read from. The
+   decoders mostly read a few bytes at a time (TiMidity an event, the
+   codecs' read callbacks whatever the library asks for), and on Android
+   each of those is a JNI call into the asset manager without it.
+ */
+
+#ifndef LOAD_BUFFERED_H_
+#define LOAD_BUFFERED_H_
+
+/* Wrap 'src' so it is read a block at a time, see Mix_SetReadBufferSize().
+   Closing the wrapper closes 'src' if 'freesrc' is set, and otherwise puts
+   it back at the position the wrapper was read to. Returns 'src' itself for
+   memory streams, when buffering is off, or if there is no memory. */
+extern SDL_RWops *_Mix_RWFromBuffered(SDL_RWops *src, int freesrc);
+
+#endif /* LOAD_BUFFERED_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,371 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "load_mmap.h"
+
+#if defined(__ANDROID__) || defined(__unix__) || defined(__APPLE__)
+#define HAVE_MMAP 1
+#include <stdio.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#endif
+
+#define RIFF        0x46464952      /* "RIFF" */
+#define WAVE        0x45564157      /* "WAVE" */
+#define FMT         0x20746D66      /* "fmt " */
+#define DATA        0x61746164      /* "data" */
+
+/* Read streams that can't tell their size this much at first */
+#define READ_ALL_BLOCK  65536
+
+#define PCM_CODE        0x0001
+#define IEEE_FLOAT_CODE 0x0003
+
+#ifdef HAVE_MMAP
+typedef struct _Mix_ChunkMapping
+{
+    Mix_Chunk *chunk;
+    void *base;
+    size_t length;
+    struct _Mix_ChunkMapping *next;
+} chunk_mapping;
+
+static chunk_mapping *mappings = NULL;
+static SDL_SpinLock mappings_lock = 0;
+
+/* Find the file descriptor behind 'src', and where the stream starts in it */
+static int get_rwops_fd(SDL_RWops *src, Sint64 *start)
+{
+#ifdef __ANDROID__
+    /* Only assets stored uncompressed in the APK have a descriptor */
+    if (src->type == SDL_RWOPS_JNIFILE && src->hidden.androidio.assetFileDescriptorRef) {
+        *start = src->hidden.androidio.offset;
+        return src->hidden.androidio.fd;
+    }
+#endif
+    if (src->type == SDL_RWOPS_STDFILE) {
+        *start = 0;
+        return fileno((FILE *)src->hidden.stdio.fp);
+    }
+    return -1;
+}
+
+/* Look for the sample data of a wave file in 'format', positioned at 'src' */
+static SDL_bool find_wave_data(SDL_RWops *src, Sint64 *offset, Uint32 *length)
+{
+    int freq, channels;
+    Uint16 format, wave_format = 0;
+    SDL_bool have_fmt = SDL_FALSE;
+    Uint32 chunk_type, chunk_length;
+    Sint64 next;
+
+    if (!Mix_QuerySpec(&freq, &format, &channels)) {
+        return SDL_FALSE;
+    }
+    if (SDL_ReadLE32(src) != RIFF) {
+        return SDL_FALSE;
+    }
+    SDL_ReadLE32(src);
+    if (SDL_ReadLE32(src) != WAVE) {
+        return SDL_FALSE;
+    }
+
+    for (;;) {
+        chunk_type = SDL_ReadLE32(src);
+        chunk_length = SDL_ReadLE32(src);
+        next = SDL_RWtell(src) + chunk_length + (chunk_length & 1);
+        if (chunk_type == 0 && chunk_length == 0) {
+            return SDL_FALSE;   /* end of file */
+        }
+
+        if (chunk_type == FMT) {
+            Uint16 encoding = SDL_ReadLE16(src);
+            Uint16 wave_channels = SDL_ReadLE16(src);
+            Uint32 wave_freq = SDL_ReadLE32(src);
+            Uint16 bits;
+
+            SDL_ReadLE32(src);  /* byte rate */
+            SDL_ReadLE16(src);  /* block align */
+            bits = SDL_ReadLE16(src);
+            if (encoding == PCM_CODE && bits == 8) {
+                wave_format = AUDIO_U8;
+            } else if (encoding == PCM_CODE && bits == 16) {
+                wave_format = AUDIO_S16LSB;
+            } else if (encoding == PCM_CODE && bits == 32) {
+                wave_format = AUDIO_S32LSB;
+            } else if (encoding == IEEE_FLOAT_CODE && bits == 32) {
+                wave_format = AUDIO_F32LSB;
+            }
+            if (wave_format != format || wave_channels != channels || (int)wave_freq != freq) {
+                return SDL_FALSE;
+            }
+            have_fmt = SDL_TRUE;
+        } else if (chunk_type == DATA) {
+            if (!have_fmt) {
+                return SDL_FALSE;
+            }
+            *offset = SDL_RWtell(src);
+            *length = chunk_length;
+            return SDL_TRUE;
+        }
+        if (SDL_RWseek(src, next, RW_SEEK_SET) != next) {
+            return SDL_FALSE;
+        }
+    }
+}
+
+static Mix_Chunk *map_wave(SDL_RWops *src)
+{
+    Sint64 start, offset, aligned, size;
+    Uint32 length, frame_size;
+    size_t page_size, map_length;
+    void *base;
+    int fd, channels;
+    Uint16 format;
+    chunk_mapping *mapping;
+    Mix_Chunk *chunk;
+
+    fd = get_rwops_fd(src, &start);
+    if (fd < 0 || !find_wave_data(src, &offset, &length)) {
+        return NULL;
+    }
+
+    /* The data chunk of a truncated file claims more than there is, and
+       reading the mapping past the end of the file or asset would fault
+       or read whatever else is in the APK */
+    size = SDL_RWsize(src);
+    if (size < 0 || offset >= size) {
+        return NULL;
+    }
+    if ((Sint64)length > size - offset) {
+        length = (Uint32)(size - offset);
+    }
+    Mix_QuerySpec(NULL, &format, &channels);
+    frame_size = (Uint32)((SDL_AUDIO_BITSIZE(format) / 8) * channels);
+    length -= length % frame_size;
+    if (length == 0) {
+        return NULL;
+    }
+
+    /* mmap() wants a page aligned file offset */
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    offset += start;
+    aligned = offset & ~(Sint64)(page_size - 1);
+    map_length = (size_t)(offset - aligned) + length;
+
+    base = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, (off_t)aligned);
+    if (base == MAP_FAILED) {
+        return NULL;
+    }
+
+    chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
+    mapping = (chunk_mapping *)SDL_malloc(sizeof(chunk_mapping));
+    if (!chunk || !mapping) {
+        SDL_free(chunk);
+        SDL_free(mapping);
+        munmap(base, map_length);
+        return NULL;
+    }
+    chunk->allocated = MIX_CHUNK_MAPPED;
+    chunk->abuf = (Uint8 *)base + (offset - aligned);
+    chunk->alen = length;
+    chunk->volume = MIX_MAX_VOLUME;
+
+    mapping->chunk = chunk;
+    mapping->base = base;
+    mapping->length = map_length;
+    SDL_AtomicLock(&mappings_lock);
+    mapping->next = mappings;
+    mappings = mapping;
+    SDL_AtomicUnlock(&mappings_lock);
+
+    return chunk;
+}
+#endif /* HAVE_MMAP */
+
+Mix_Chunk *Mix_LoadWAVMapped_RW(SDL_RWops *src, int freesrc)
+{
+    Mix_Chunk *chunk = NULL;
+    Sint64 start;
+
+    if (!src) {
+        SDL_SetError("Mix_LoadWAVMapped_RW with NULL src");
+        return(NULL);
+    }
+
+    start = SDL_RWtell(src);
+#ifdef HAVE_MMAP
+    chunk = map_wave(src);
+#endif
+    if (chunk) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(chunk);
+    }
+
+    /* Compressed asset, other format, no mmap(): read it the usual way */
+    SDL_RWseek(src, start, RW_SEEK_SET);
+    return Mix_LoadWAV_RW(src, freesrc);
+}
+
+#ifdef HAVE_MMAP
+/* The close of a stream made by _Mix_RWFromMapped(), the mapping starts at
+   the page the stream data is in */
+static int SDLCALL mapped_close(SDL_RWops *context)
+{
+    if (context) {
+        const size_t page_size = (size_t)sysconf(_SC_PAGESIZE);
+        Uint8 *base = (Uint8 *)((uintptr_t)context->hidden.mem.base & ~(uintptr_t)(page_size - 1));
+
+        munmap(base, (size_t)(context->hidden.mem.stop - base));
+        SDL_FreeRW(context);
+    }
+    return 0;
+}
+#endif /* HAVE_MMAP */
+
+SDL_RWops *_Mix_RWFromMapped(SDL_RWops *src)
+{
+#ifdef HAVE_MMAP
+    Sint64 start, pos, size, offset, aligned;
+    size_t page_size, map_length;
+    SDL_RWops *mem;
+    void *base;
+    int fd;
+
+    fd = get_rwops_fd(src, &start);
+    if (fd < 0) {
+        return src;
+    }
+    pos = SDL_RWtell(src);
+    size = SDL_RWsize(src);
+    if (pos < 0 || size <= pos || (size - pos) > SDL_MAX_SINT32) {
+        return src;
+    }
+
+    page_size = (size_t)sysconf(_SC_PAGESIZE);
+    offset = start + pos;
+    aligned = offset & ~(Sint64)(page_size - 1);
+    map_length = (size_t)(offset - aligned + (size - pos));
+
+    base = mmap(NULL, map_length, PROT_READ, MAP_PRIVATE, fd, (off_t)aligned);
+    if (base == MAP_FAILED) {
+        return src;
+    }
+    mem = SDL_RWFromConstMem((Uint8 *)base + (offset - aligned), (int)(size - pos));
+    if (!mem) {
+        munmap(base, map_length);
+        return src;
+    }
+    mem->close = mapped_close;
+
+    /* The mapping stays valid without the descriptor */
+    SDL_RWclose(src);
+    return mem;
+#else
+    return src;
+#endif
+}
+
+const void *_Mix_RWMemory(SDL_RWops *src, size_t *size)
+{
+    if (src->type != SDL_RWOPS_MEMORY && src->type != SDL_RWOPS_MEMORY_RO) {
+        return NULL;
+    }
+    *size = (size_t)(src->hidden.mem.stop - src->hidden.mem.here);
+    return src->hidden.mem.here;
+}
+
+const void *_Mix_RWReadAll(SDL_RWops *src, size_t *size, void **owned)
+{
+    const void *mem;
+    Sint64 pos, end;
+    SDL_bool sized;
+    size_t alloc, len = 0;
+    Uint8 *buf, *grown;
+
+    *owned = NULL;
+    mem = _Mix_RWMemory(src, size);
+    if (mem) {
+        return mem;
+    }
+
+    pos = SDL_RWtell(src);
+    end = SDL_RWsize(src);
+    sized = (pos >= 0 && end >= pos && (Uint64)(end - pos) <= SDL_MAX_SINT32);
+    alloc = sized ? (size_t)(end - pos) : READ_ALL_BLOCK;
+    buf = (Uint8 *)SDL_malloc(alloc);
+    if (!buf) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    while (len < alloc) {
+        size_t amount = SDL_RWread(src, buf + len, 1, alloc - len);
+        if (amount == 0) {
+            break;
+        }
+        len += amount;
+        if (len == alloc && !sized) {
+            grown = (Uint8 *)SDL_realloc(buf, alloc * 2);
+            if (!grown) {
+                SDL_free(buf);
+                SDL_OutOfMemory();
+                return NULL;
+            }
+            buf = grown;
+            alloc *= 2;
+        }
+    }
+    *size = len;
+    *owned = buf;
+    return buf;
+}
+
+void _Mix_UnmapChunk(Mix_Chunk *chunk)
+{
+#ifdef HAVE_MMAP
+    chunk_mapping *mapping, *prev = NULL;
+
+    SDL_AtomicLock(&mappings_lock);
+    for (mapping = mappings; mapping; prev = mapping, mapping = mapping->next) {
+        if (mapping->chunk == chunk) {
+            if (prev) {
+                prev->next = mapping->next;
+            } else {
+                mappings = mapping->next;
+            }
+            break;
+        }
+    }
+    SDL_AtomicUnlock(&mappings_lock);
+
+    if (mapping) {
+        munmap(mapping->base, mapping->length);
+        SDL_free(mapping);
+    }
+#endif
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,56 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Zero-copy loading of wave files that are already in the device format:
+   the sample data is mapped into memory instead of read into the heap.
+   Music files are mapped too, so decoders read them without a syscall (or
+   a JNI call, for Android assets) per read.
+ */
+
+#ifndef LOAD_MMAP_H_
+#define LOAD_MMAP_H_
+
+/* Mix_Chunk.allocated value for chunks whose samples are a file mapping */
+#define MIX_CHUNK_MAPPED    2
+
+/* Unmap the samples of a MIX_CHUNK_MAPPED chunk */
+extern void _Mix_UnmapChunk(Mix_Chunk *chunk);
+
+/* Replace 'src', a plain file or an asset stored uncompressed in the APK,
+   with a memory stream over a mapping of it from its current position to
+   the end, and close it. Returns 'src' itself if it can't be mapped. */
+extern SDL_RWops *_Mix_RWFromMapped(SDL_RWops *src);
+
+/* If 'src' is a memory stream, such as one made by _Mix_RWFromMapped(),
+   return its data from the current position on and set 'size' to its
+   length, without copying. Returns NULL for any other kind of stream. */
+extern const void *_Mix_RWMemory(SDL_RWops *src, size_t *size);
+
+/* The rest of 'src' in memory, with its length in 'size': a memory
+   stream's own data, or anything else read in as few reads as its size
+   allows into a buffer left in 'owned' for the caller, who may keep it.
+   'owned' is NULL when nothing was read. Returns NULL with the error set
+   if there is no memory. */
+extern const void *_Mix_RWReadAll(SDL_RWops *src, size_t *size, void **owned);
+
+#endif /* LOAD_MMAP_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
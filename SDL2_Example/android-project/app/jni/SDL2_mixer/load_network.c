@@ -0,0 +1,719 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+#include "load_network.h"
+
+#if defined(__unix__) || defined(__ANDROID__) || defined(__APPLE__)
+#define HAVE_NETWORK_STREAMS
+#endif
+
+#ifdef HAVE_NETWORK_STREAMS
+
+#include <errno.h>
+#include <fcntl.h>
+#include <netdb.h>
+#include <poll.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL        0   /* SO_NOSIGPIPE is set instead */
+#endif
+
+#define MAX_REDIRECTS       5
+#define MAX_HEADER_BYTES    16384
+#define POLL_MS             100     /* how soon the worker sees it's asked to stop */
+#define CONNECT_TIMEOUT_MS  10000
+#define STALL_TIMEOUT_MS    10000   /* no data for this long drops the connection */
+#define RECONNECT_MS        1000    /* doubled after each failed try, up to the max */
+#define MAX_RECONNECT_MS    16000
+#define DEFAULT_KBPS        128     /* until the server or the decoder says */
+#define MAX_KBPS            320     /* what the buffer is sized for */
+#define MIN_RING_BYTES      65536
+#define RECV_BYTES          8192
+
+struct Mix_NetStream {
+    char *host;
+    char *port;
+    char *path;
+
+    SDL_Thread *thread;
+    SDL_atomic_t quit;
+    SDL_atomic_t state;         /* Mix_StreamState, as the worker sees it */
+    SDL_bool connected;         /* worker only: got a response once */
+    SDL_bool live;              /* worker only: the last response had no length */
+
+    /* The jitter buffer, a ring the worker writes and the audio thread
+       reads. The counts are of all bytes ever, wrapping. */
+    Uint8 *ring;
+    Uint32 ring_size;           /* a power of two */
+    SDL_atomic_t written;
+    SDL_atomic_t read;
+    SDL_atomic_t buffering;     /* nothing is read until the target is met */
+    SDL_atomic_t bytes_per_sec;
+    int buffer_ms;
+
+    SDL_atomic_t underruns;
+    SDL_atomic_t reconnects;
+
+    SDL_SpinLock info_lock;     /* for what follows */
+    Uint64 bytes_received;
+    char name[128];
+    char title[256];
+};
+
+static char *net_strndup(const char *src, size_t len)
+{
+    char *dst = (char *)SDL_malloc(len + 1);
+    if (dst) {
+        SDL_memcpy(dst, src, len);
+        dst[len] = '\0';
+    }
+    return dst;
+}
+
+/* Split an http:// address into the stream's host, port and path */
+static int net_parse_url(Mix_NetStream *stream, const char *url)
+{
+    const char *host, *host_end, *port = NULL, *path;
+    char *new_host, *new_port, *new_path;
+
+    if (SDL_strncasecmp(url, "http://", 7) != 0) {
+        if (SDL_strncasecmp(url, "https://", 8) == 0) {
+            return Mix_SetError("https:// streams aren't supported");
+        }
+        return Mix_SetError("Not an http:// address: %s", url);
+    }
+    host = url + 7;
+    path = host + strcspn(host, "/?#");
+    if (*host == '[') {
+        /* An IPv6 address */
+        host_end = SDL_strchr(host, ']');
+        if (!host_end || host_end > path) {
+            return Mix_SetError("Bad address: %s", url);
+        }
+        ++host;
+        if (host_end[1] == ':') {
+            port = host_end + 2;
+        }
+    } else {
+        host_end = SDL_strchr(host, ':');
+        if (host_end && host_end < path) {
+            port = host_end + 1;
+        } else {
+            host_end = path;
+        }
+    }
+    if (host_end == host || (port && port == path)) {
+        return Mix_SetError("Bad address: %s", url);
+    }
+
+    new_host = net_strndup(host, host_end - host);
+    new_port = port ? net_strndup(port, path - port) : SDL_strdup("80");
+    new_path = *path == '/' ? SDL_strdup(path) : SDL_strdup("/");
+    if (!new_host || !new_port || !new_path) {
+        SDL_free(new_host);
+        SDL_free(new_port);
+        SDL_free(new_path);
+        return SDL_OutOfMemory();
+    }
+    /* Anything after a '#' isn't sent */
+    new_path[strcspn(new_path, "#")] = '\0';
+
+    SDL_free(stream->host);
+    SDL_free(stream->port);
+    SDL_free(stream->path);
+    stream->host = new_host;
+    stream->port = new_port;
+    stream->path = new_path;
+    return 0;
+}
+
+/* Wait for 'fd' to be ready for 'events', a slice at a time so a close
+   doesn't wait on the network. Returns 1 when ready, 0 on timeout, -1 on
+   error or when asked to stop. */
+static int net_wait(Mix_NetStream *stream, int fd, short events, int timeout_ms)
+{
+    struct pollfd pfd;
+    int waited, result;
+
+    for (waited = 0; waited < timeout_ms; waited += POLL_MS) {
+        if (SDL_AtomicGet(&stream->quit)) {
+            return -1;
+        }
+        pfd.fd = fd;
+        pfd.events = events;
+        pfd.revents = 0;
+        result = poll(&pfd, 1, POLL_MS);
+        if (result > 0) {
+            return 1;
+        }
+        if (result < 0 && errno != EINTR) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+static int net_connect(Mix_NetStream *stream)
+{
+    struct addrinfo hints, *addrs, *addr;
+    int fd = -1, flags, error;
+    socklen_t len;
+
+    SDL_zero(hints);
+    hints.ai_family = AF_UNSPEC;
+    hints.ai_socktype = SOCK_STREAM;
+    if (getaddrinfo(stream->host, stream->port, &hints, &addrs) != 0) {
+        return -1;
+    }
+    for (addr = addrs; addr; addr = addr->ai_next) {
+        fd = socket(addr->ai_family, addr->ai_socktype, addr->ai_protocol);
+        if (fd < 0) {
+            continue;
+        }
+#ifdef SO_NOSIGPIPE
+        flags = 1;
+        setsockopt(fd, SOL_SOCKET, SO_NOSIGPIPE, &flags, sizeof(flags));
+#endif
+        /* Connect without blocking, so it can be given up on */
+        flags = fcntl(fd, F_GETFL, 0);
+        fcntl(fd, F_SETFL, flags | O_NONBLOCK);
+        if (connect(fd, addr->ai_addr, addr->ai_addrlen) == 0 ||
+            (errno == EINPROGRESS && net_wait(stream, fd, POLLOUT, CONNECT_TIMEOUT_MS) > 0)) {
+            error = 0;
+            len = sizeof(error);
+            if (getsockopt(fd, SOL_SOCKET, SO_ERROR, &error, &len) == 0 && error == 0) {
+                fcntl(fd, F_SETFL, flags);
+                break;
+            }
+        }
+        close(fd);
+        fd = -1;
+        if (SDL_AtomicGet(&stream->quit)) {
+            break;
+        }
+    }
+    freeaddrinfo(addrs);
+    return fd;
+}
+
+static SDL_bool net_send_all(int fd, const char *data, size_t len)
+{
+    while (len > 0) {
+        ssize_t sent = send(fd, data, len, MSG_NOSIGNAL);
+        if (sent < 0 && errno == EINTR) {
+            continue;
+        }
+        if (sent <= 0) {
+            return SDL_FALSE;
+        }
+        data += sent;
+        len -= (size_t)sent;
+    }
+    return SDL_TRUE;
+}
+
+/* Bytes received into 'dst', 0 once the server closes, -1 on an error,
+   a stall or when asked to stop */
+static ssize_t net_recv(Mix_NetStream *stream, int fd, void *dst, size_t len)
+{
+    ssize_t got;
+
+    if (net_wait(stream, fd, POLLIN, STALL_TIMEOUT_MS) <= 0) {
+        return -1;
+    }
+    do {
+        got = recv(fd, dst, len, 0);
+    } while (got < 0 && errno == EINTR);
+    return got;
+}
+
+/* The value of header 'name' in 'headers', which runs to the blank line,
+   copied into 'value' */
+static SDL_bool net_header(const char *headers, const char *name, char *value, size_t maxlen)
+{
+    size_t name_len = SDL_strlen(name), len;
+    const char *line = SDL_strchr(headers, '\n');
+
+    while (line && line[1] != '\r' && line[1] != '\n' && line[1] != '\0') {
+        ++line;
+        if (SDL_strncasecmp(line, name, name_len) == 0 && line[name_len] == ':') {
+            line += name_len + 1;
+            while (*line == ' ' || *line == '\t') {
+                ++line;
+            }
+            len = strcspn(line, "\r\n");
+            if (len >= maxlen) {
+                len = maxlen - 1;
+            }
+            SDL_memcpy(value, line, len);
+            value[len] = '\0';
+            return SDL_TRUE;
+        }
+        line = SDL_strchr(line, '\n');
+    }
+    return SDL_FALSE;
+}
+
+static Uint32 net_target_bytes(Mix_NetStream *stream)
+{
+    Uint32 bytes = (Uint32)((Uint64)SDL_AtomicGet(&stream->bytes_per_sec) * stream->buffer_ms / 1000);
+    return SDL_min(bytes, stream->ring_size / 4 * 3);
+}
+
+/* Copy audio into the ring, waiting for the reader to make room. Returns
+   SDL_FALSE when asked to stop. */
+static SDL_bool net_push(Mix_NetStream *stream, const Uint8 *data, size_t len)
+{
+    const Uint32 mask = stream->ring_size - 1;
+
+    while (len > 0) {
+        Uint32 w = (Uint32)SDL_AtomicGet(&stream->written);
+        Uint32 room = stream->ring_size - (w - (Uint32)SDL_AtomicGet(&stream->read));
+        Uint32 n, first;
+
+        /* The room is only free once the reader has copied out of it */
+        SDL_MemoryBarrierAcquire();
+        if (room == 0) {
+            /* Full, as it gets while the music is paused */
+            if (SDL_AtomicGet(&stream->quit)) {
+                return SDL_FALSE;
+            }
+            SDL_Delay(10);
+            continue;
+        }
+        n = (Uint32)SDL_min(len, room);
+        first = SDL_min(n, stream->ring_size - (w & mask));
+        SDL_memcpy(stream->ring + (w & mask), data, first);
+        SDL_memcpy(stream->ring, data + first, n - first);
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&stream->written, (int)(w + n));
+
+        SDL_AtomicLock(&stream->info_lock);
+        stream->bytes_received += n;
+        SDL_AtomicUnlock(&stream->info_lock);
+        data += n;
+        len -= n;
+    }
+    return SDL_TRUE;
+}
+
+/* Keep the StreamTitle='...'; of an ICY metadata block */
+static void net_metadata(Mix_NetStream *stream, const char *meta)
+{
+    const char *start = SDL_strstr(meta, "StreamTitle='");
+    const char *end;
+    size_t len;
+
+    if (!start) {
+        return;
+    }
+    start += 13;
+    end = SDL_strstr(start, "';");
+    len = end ? (size_t)(end - start) : SDL_strlen(start);
+    if (len >= sizeof(stream->title)) {
+        len = sizeof(stream->title) - 1;
+    }
+    SDL_AtomicLock(&stream->info_lock);
+    SDL_memcpy(stream->title, start, len);
+    stream->title[len] = '\0';
+    SDL_AtomicUnlock(&stream->info_lock);
+}
+
+/* Pass the body on to the ring, without the metadata blocks that come
+   every 'metaint' bytes of audio. Returns 1 once the server closed the
+   stream, 0 if it was lost. */
+static int net_body(Mix_NetStream *stream, int fd, Uint8 *buf, size_t have, int metaint)
+{
+    char meta[16 * 255 + 1];
+    int audio_left = metaint, meta_len = -1, meta_pos = 0;
+    ssize_t got;
+    size_t pos, n;
+
+    for (;;) {
+        for (pos = 0; pos < have; pos += n) {
+            if (metaint <= 0 || audio_left > 0) {
+                n = have - pos;
+                if (metaint > 0 && n > (size_t)audio_left) {
+                    n = (size_t)audio_left;
+                }
+                if (!net_push(stream, buf + pos, n)) {
+                    return 0;
+                }
+                audio_left -= (int)n;
+            } else if (meta_len < 0) {
+                /* The length of the block, in 16 bytes */
+                meta_len = buf[pos] * 16;
+                meta_pos = 0;
+                n = 1;
+            } else {
+                n = SDL_min(have - pos, (size_t)(meta_len - meta_pos));
+                SDL_memcpy(meta + meta_pos, buf + pos, n);
+                meta_pos += (int)n;
+            }
+            if (meta_len >= 0 && meta_pos == meta_len) {
+                if (meta_len > 0) {
+                    meta[meta_len] = '\0';
+                    net_metadata(stream, meta);
+                }
+                meta_len = -1;
+                audio_left = metaint;
+            }
+        }
+
+        got = net_recv(stream, fd, buf, RECV_BYTES);
+        if (got <= 0) {
+            return got == 0 ? 1 : 0;
+        }
+        have = (size_t)got;
+    }
+}
+
+/* One request for the stream and what comes of it, after any redirects.
+   Returns 1 when the stream is over, 0 when a live stream was lost and
+   -1 if there was no audio to be had. */
+static int net_fetch(Mix_NetStream *stream)
+{
+    Uint8 buf[MAX_HEADER_BYTES + 1];
+    char request[1024], value[256];
+    int redirects, status, metaint, fd;
+    size_t have, header_len;
+    ssize_t got;
+    char *end;
+    SDL_bool ipv6;
+
+    for (redirects = 0; redirects <= MAX_REDIRECTS; ++redirects) {
+        fd = net_connect(stream);
+        if (fd < 0) {
+            return -1;
+        }
+        /* An IPv6 address goes back in its brackets, see net_parse_url() */
+        ipv6 = SDL_strchr(stream->host, ':') ? SDL_TRUE : SDL_FALSE;
+        SDL_snprintf(request, sizeof(request),
+                     "GET %s HTTP/1.0\r\n"
+                     "Host: %s%s%s:%s\r\n"
+                     "User-Agent: SDL_mixer/%d.%d.%d\r\n"
+                     "Icy-MetaData: 1\r\n"
+                     "Connection: close\r\n"
+                     "\r\n",
+                     stream->path, ipv6 ? "[" : "", stream->host, ipv6 ? "]" : "", stream->port,
+                     SDL_MIXER_MAJOR_VERSION, SDL_MIXER_MINOR_VERSION, SDL_MIXER_PATCHLEVEL);
+        if (!net_send_all(fd, request, SDL_strlen(request))) {
+            close(fd);
+            return -1;
+        }
+
+        /* Read up to the end of the headers, what's after it is audio */
+        have = 0;
+        end = NULL;
+        while (!end && have < MAX_HEADER_BYTES) {
+            got = net_recv(stream, fd, buf + have, MAX_HEADER_BYTES - have);
+            if (got <= 0) {
+                break;
+            }
+            have += (size_t)got;
+            buf[have] = '\0';
+            if ((end = SDL_strstr((char *)buf, "\r\n\r\n")) != NULL) {
+                end += 4;
+            } else if ((end = SDL_strstr((char *)buf, "\n\n")) != NULL) {
+                end += 2;
+            }
+        }
+        if (!end) {
+            close(fd);
+            return -1;
+        }
+        header_len = (size_t)(end - (char *)buf);
+
+        /* Shoutcast answers "ICY 200 OK" */
+        if (SDL_strncmp((char *)buf, "ICY ", 4) == 0) {
+            status = SDL_atoi((char *)buf + 4);
+            stream->live = SDL_TRUE;
+        } else if (SDL_strncmp((char *)buf, "HTTP/", 5) == 0 && SDL_strchr((char *)buf, ' ')) {
+            status = SDL_atoi(SDL_strchr((char *)buf, ' ') + 1);
+            stream->live = !net_header((char *)buf, "Content-Length", value, sizeof(value));
+        } else {
+            status = 0;
+        }
+
+        if (status >= 300 && status < 400 &&
+            net_header((char *)buf, "Location", value, sizeof(value))) {
+            close(fd);
+            if (net_parse_url(stream, value) < 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (status != 200) {
+            close(fd);
+            return -1;
+        }
+
+        metaint = 0;
+        if (net_header((char *)buf, "icy-metaint", value, sizeof(value))) {
+            metaint = SDL_atoi(value);
+        }
+        if (net_header((char *)buf, "icy-br", value, sizeof(value)) && SDL_atoi(value) > 0) {
+            _Mix_NetStreamSetBitrate(stream, SDL_atoi(value));
+        }
+        if (net_header((char *)buf, "icy-name", value, sizeof(value))) {
+            SDL_AtomicLock(&stream->info_lock);
+            SDL_strlcpy(stream->name, value, sizeof(stream->name));
+            SDL_AtomicUnlock(&stream->info_lock);
+        }
+
+        stream->connected = SDL_TRUE;
+        SDL_AtomicSet(&stream->state, MIX_STREAM_PLAYING);
+        SDL_memmove(buf, buf + header_len, have - header_len);
+        status = net_body(stream, fd, buf, have - header_len, metaint);
+        close(fd);
+        /* A download that's cut short is over too, it can't be resumed */
+        return (status || !stream->live) ? 1 : 0;
+    }
+    return -1;
+}
+
+static int SDLCALL net_thread(void *data)
+{
+    Mix_NetStream *stream = (Mix_NetStream *)data;
+    int delay = RECONNECT_MS, waited, result;
+    Uint64 received, last_received = 0;
+
+    while (!SDL_AtomicGet(&stream->quit)) {
+        result = net_fetch(stream);
+        if (SDL_AtomicGet(&stream->quit)) {
+            break;
+        }
+        if (result > 0 && !stream->live) {
+            SDL_AtomicSet(&stream->state, MIX_STREAM_ENDED);
+            break;
+        }
+        if (!stream->connected) {
+            SDL_AtomicSet(&stream->state, MIX_STREAM_FAILED);
+            break;
+        }
+
+        /* A live stream that dropped, or a station that went down */
+        SDL_AtomicLock(&stream->info_lock);
+        received = stream->bytes_received;
+        SDL_AtomicUnlock(&stream->info_lock);
+        if (received != last_received) {
+            delay = RECONNECT_MS;
+        }
+        last_received = received;
+        SDL_AtomicSet(&stream->state, MIX_STREAM_RECONNECTING);
+        SDL_AtomicAdd(&stream->reconnects, 1);
+        for (waited = 0; waited < delay && !SDL_AtomicGet(&stream->quit); waited += POLL_MS) {
+            SDL_Delay(POLL_MS);
+        }
+        delay = SDL_min(delay * 2, MAX_RECONNECT_MS);
+    }
+    return 0;
+}
+
+Mix_NetStream *_Mix_NetStreamOpen(const char *url, int buffer_ms)
+{
+    Mix_NetStream *stream;
+    Uint32 ring_size = MIN_RING_BYTES;
+
+    if (buffer_ms == 0) {
+        buffer_ms = MIX_DEFAULT_STREAM_BUFFER_MS;
+    }
+    if (buffer_ms < 100 || buffer_ms > 30000) {
+        Mix_SetError("Stream buffers are 100 to 30000 milliseconds");
+        return NULL;
+    }
+
+    stream = (Mix_NetStream *)SDL_calloc(1, sizeof(*stream));
+    if (!stream) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    if (net_parse_url(stream, url) < 0) {
+        _Mix_NetStreamClose(stream);
+        return NULL;
+    }
+
+    /* Room for twice the time asked for at the highest MP3 bitrate, so the
+       worker can run ahead of a buffer that's being drained */
+    while (ring_size < (Uint32)((Uint64)MAX_KBPS * 1000 / 8 * buffer_ms / 1000 * 2)) {
+        ring_size *= 2;
+    }
+    stream->ring = (Uint8 *)SDL_malloc(ring_size);
+    if (!stream->ring) {
+        _Mix_NetStreamClose(stream);
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    stream->ring_size = ring_size;
+    stream->buffer_ms = buffer_ms;
+    SDL_AtomicSet(&stream->buffering, 1);
+    SDL_AtomicSet(&stream->bytes_per_sec, DEFAULT_KBPS * 1000 / 8);
+    SDL_AtomicSet(&stream->state, MIX_STREAM_CONNECTING);
+
+    stream->thread = SDL_CreateThread(net_thread, "SDL_mixer stream", stream);
+    if (!stream->thread) {
+        _Mix_NetStreamClose(stream);
+        Mix_SetError("Couldn't start the stream thread");
+        return NULL;
+    }
+    return stream;
+}
+
+size_t _Mix_NetStreamRead(Mix_NetStream *stream, void *dst, size_t len)
+{
+    const Uint32 mask = stream->ring_size - 1;
+    Uint32 r = (Uint32)SDL_AtomicGet(&stream->read);
+    Uint32 avail = (Uint32)SDL_AtomicGet(&stream->written) - r;
+    int state = SDL_AtomicGet(&stream->state);
+    SDL_bool over = (state == MIX_STREAM_ENDED || state == MIX_STREAM_FAILED);
+    Uint32 n, first;
+
+    /* What's below 'written' is only there once it's been seen */
+    SDL_MemoryBarrierAcquire();
+    if (SDL_AtomicGet(&stream->buffering)) {
+        if (avail < net_target_bytes(stream) && !over) {
+            return 0;
+        }
+        SDL_AtomicSet(&stream->buffering, 0);
+    }
+    if (avail == 0) {
+        if (!over) {
+            /* Ran dry, wait for the whole buffer again rather than play
+               every scrap that comes in */
+            SDL_AtomicAdd(&stream->underruns, 1);
+            SDL_AtomicSet(&stream->buffering, 1);
+        }
+        return 0;
+    }
+
+    n = (Uint32)SDL_min(len, avail);
+    first = SDL_min(n, stream->ring_size - (r & mask));
+    SDL_memcpy(dst, stream->ring + (r & mask), first);
+    SDL_memcpy((Uint8 *)dst + first, stream->ring, n - first);
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&stream->read, (int)(r + n));
+    return n;
+}
+
+SDL_bool _Mix_NetStreamEnded(Mix_NetStream *stream)
+{
+    int state = SDL_AtomicGet(&stream->state);
+
+    return ((state == MIX_STREAM_ENDED || state == MIX_STREAM_FAILED) &&
+            SDL_AtomicGet(&stream->written) == SDL_AtomicGet(&stream->read)) ? SDL_TRUE : SDL_FALSE;
+}
+
+void _Mix_NetStreamSetBitrate(Mix_NetStream *stream, int kbps)
+{
+    if (kbps > 0) {
+        SDL_AtomicSet(&stream->bytes_per_sec, kbps * 1000 / 8);
+    }
+}
+
+void _Mix_NetStreamStatus(Mix_NetStream *stream, Mix_StreamStatus *status)
+{
+    Uint32 avail = (Uint32)SDL_AtomicGet(&stream->written) - (Uint32)SDL_AtomicGet(&stream->read);
+    int bytes_per_sec = SDL_AtomicGet(&stream->bytes_per_sec);
+
+    SDL_zerop(status);
+    status->state = (Mix_StreamState)SDL_AtomicGet(&stream->state);
+    if (status->state == MIX_STREAM_PLAYING && SDL_AtomicGet(&stream->buffering)) {
+        status->state = MIX_STREAM_BUFFERING;
+    }
+    status->buffered_ms = (int)((Uint64)avail * 1000 / bytes_per_sec);
+    status->buffer_ms = stream->buffer_ms;
+    status->bitrate = bytes_per_sec * 8 / 1000;
+    status->underruns = (Uint32)SDL_AtomicGet(&stream->underruns);
+    status->reconnects = (Uint32)SDL_AtomicGet(&stream->reconnects);
+
+    SDL_AtomicLock(&stream->info_lock);
+    status->bytes_received = stream->bytes_received;
+    SDL_strlcpy(status->name, stream->name, sizeof(status->name));
+    SDL_strlcpy(status->title, stream->title, sizeof(status->title));
+    SDL_AtomicUnlock(&stream->info_lock);
+}
+
+void _Mix_NetStreamClose(Mix_NetStream *stream)
+{
+    if (stream->thread) {
+        SDL_AtomicSet(&stream->quit, 1);
+        SDL_WaitThread(stream->thread, NULL);
+    }
+    SDL_free(stream->ring);
+    SDL_free(stream->host);
+    SDL_free(stream->port);
+    SDL_free(stream->path);
+    SDL_free(stream);
+}
+
+#else
+
+/* Only built with BSD sockets */
+
+Mix_NetStream *_Mix_NetStreamOpen(const char *url, int buffer_ms)
+{
+    (void)url;
+    (void)buffer_ms;
+    Mix_SetError("Network streams aren't supported on this platform");
+    return NULL;
+}
+
+size_t _Mix_NetStreamRead(Mix_NetStream *stream, void *dst, size_t len)
+{
+    (void)stream;
+    (void)dst;
+    (void)len;
+    return 0;
+}
+
+SDL_bool _Mix_NetStreamEnded(Mix_NetStream *stream)
+{
+    (void)stream;
+    return SDL_TRUE;
+}
+
+void _Mix_NetStreamSetBitrate(Mix_NetStream *stream, int kbps)
+{
+    (void)stream;
+    (void)kbps;
+}
+
+void _Mix_NetStreamStatus(Mix_NetStream *stream, Mix_StreamStatus *status)
+{
+    (void)stream;
+    SDL_zerop(status);
+    status->state = MIX_STREAM_FAILED;
+}
+
+void _Mix_NetStreamClose(Mix_NetStream *stream)
+{
+    (void)stream;
+}
+
+#endif /* HAVE_NETWORK_STREAMS */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,58 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Music streamed over HTTP, such as Shoutcast and Icecast radio. A worker
+   thread connects, takes the ICY metadata out of the stream and fills a
+   jitter buffer, which the decoder reads from on the audio thread without
+   ever waiting on the network: it gets nothing until the buffer holds the
+   time asked for, and again after it ran dry, until it's refilled.
+ */
+
+#ifndef LOAD_NETWORK_H_
+#define LOAD_NETWORK_H_
+
+typedef struct Mix_NetStream Mix_NetStream;
+
+/* Start fetching 'url', an http:// address, into a buffer of 'buffer_ms'
+   milliseconds (see Mix_LoadMUSStream()). Returns NULL with the error set
+   if the address can't be used or the worker can't be started, a stream
+   that can't be reached is reported by _Mix_NetStreamStatus() instead. */
+extern Mix_NetStream *_Mix_NetStreamOpen(const char *url, int buffer_ms);
+
+/* Up to 'len' bytes of the stream, 0 while the buffer is filling. Safe on
+   the audio thread, it never blocks. */
+extern size_t _Mix_NetStreamRead(Mix_NetStream *stream, void *dst, size_t len);
+
+/* Whether the stream is over and all of it has been read */
+extern SDL_bool _Mix_NetStreamEnded(Mix_NetStream *stream);
+
+/* The decoder found the bitrate, in kbit/s, that the buffer is timed by */
+extern void _Mix_NetStreamSetBitrate(Mix_NetStream *stream, int kbps);
+
+/* Fill in 'status', with the ICY name and title as the server sent them */
+extern void _Mix_NetStreamStatus(Mix_NetStream *stream, Mix_StreamStatus *status);
+
+/* Stop the worker and free the stream */
+extern void _Mix_NetStreamClose(Mix_NetStream *stream);
+
+#endif /* LOAD_NETWORK_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
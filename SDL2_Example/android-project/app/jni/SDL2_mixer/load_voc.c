@@ -31,6 +31,7 @@
 
 #include "SDL_mixer.h"
 #include "load_voc.h"
+#include "load_mmap.h"
 
 /* Private data for VOC file */
 typedef struct vocstuff {
@@ -45,6 +46,13 @@ typedef struct vocstuff {
     int     has_extended;   /* Has an extended block been read? */
 } vs_t;
 
+/* The whole file, in memory, so that the block headers cost no reads */
+typedef struct vocdata {
+    const Uint8 *data;
+    size_t  size;
+    size_t  pos;            /* next byte to parse */
+} voc_src;
+
 /* Size field */
 /* SJB: note that the 1st 3 are sometimes used as sizeof(type) */
 #define ST_SIZE_BYTE    1
@@ -78,57 +86,100 @@ typedef struct vocstuff {
 #define VOC_DATA_16     9
 
 
-static int voc_check_header(SDL_RWops *src)
+/* Take the next 'len' bytes of the file, NULL if it ends before them */
+static const Uint8 *voc_take(voc_src *src, size_t len)
+{
+    const Uint8 *p;
+
+    if (len > src->size - src->pos)
+        return NULL;
+    p = src->data + src->pos;
+    src->pos += len;
+    return p;
+}
+
+static int voc_byte(voc_src *src, Uint8 *val)
+{
+    const Uint8 *p = voc_take(src, 1);
+
+    if (p == NULL)
+        return 0;
+    *val = p[0];
+    return 1;
+}
+
+static int voc_le16(voc_src *src, Uint16 *val)
+{
+    const Uint8 *p = voc_take(src, 2);
+
+    if (p == NULL)
+        return 0;
+    *val = (Uint16)(p[0] | (p[1] << 8));
+    return 1;
+}
+
+static int voc_le32(voc_src *src, Uint32 *val)
+{
+    const Uint8 *p = voc_take(src, 4);
+
+    if (p == NULL)
+        return 0;
+    *val = (Uint32)p[0] | ((Uint32)p[1] << 8) | ((Uint32)p[2] << 16) | ((Uint32)p[3] << 24);
+    return 1;
+}
+
+
+static int voc_check_header(voc_src *src)
 {
     /* VOC magic header */
-    Uint8  signature[20];  /* "Creative Voice File\032" */
+    const Uint8 *signature;  /* "Creative Voice File\032" */
     Uint16 datablockofs;
 
-    SDL_RWseek(src, 0, RW_SEEK_SET);
+    src->pos = 0;
 
-    if (SDL_RWread(src, signature, sizeof (signature), 1) != 1)
+    signature = voc_take(src, 20);
+    if (signature == NULL)
         return(0);
 
-    if (SDL_memcmp(signature, "Creative Voice File\032", sizeof (signature)) != 0) {
+    if (SDL_memcmp(signature, "Creative Voice File\032", 20) != 0) {
         SDL_SetError("Unrecognized file type (not VOC)");
         return(0);
     }
 
         /* get the offset where the first datablock is located */
-    if (SDL_RWread(src, &datablockofs, sizeof (Uint16), 1) != 1)
+    if (!voc_le16(src, &datablockofs))
         return(0);
 
-    datablockofs = SDL_SwapLE16(datablockofs);
-
-    if (SDL_RWseek(src, datablockofs, RW_SEEK_SET) != datablockofs)
+    if (datablockofs > src->size)
         return(0);
+    src->pos = datablockofs;
 
     return(1);  /* success! */
 } /* voc_check_header */
 
 
-/* Read next block header, save info, leave position at start of data */
-static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
+/* Read next block header, save info, leave position at start of data.
+   Data that runs past the end of the file is cut off there. */
+static int voc_get_block(voc_src *src, vs_t *v, SDL_AudioSpec *spec)
 {
-    Uint8 bits24[3];
+    const Uint8 *bits24;
     Uint8 uc, block;
     Uint32 sblen;
     Uint16 new_rate_short;
     Uint32 new_rate_long;
-    Uint8 trash[6];
     Uint16 period;
-    unsigned int i;
 
     v->silent = 0;
     while (v->rest == 0)
     {
-        if (SDL_RWread(src, &block, sizeof (block), 1) != 1)
+        if (!voc_byte(src, &block))
             return 1;  /* assume that's the end of the file. */
 
         if (block == VOC_TERM)
             return 1;
 
-        if (SDL_RWread(src, bits24, sizeof (bits24), 1) != 1)
+        bits24 = voc_take(src, 3);
+        if (bits24 == NULL)
             return 1;  /* assume that's the end of the file. */
 
         /* Size is an 24-bit value. Ugh. */
@@ -137,7 +188,7 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
         switch(block)
         {
             case VOC_DATA:
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
 
                 /* When DATA block preceeded by an EXTENDED     */
@@ -161,7 +212,7 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                     v->channels = 1;
                 }
 
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
 
                 if (uc != 0)
@@ -171,14 +222,13 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                 }
 
                 v->has_extended = 0;
-                v->rest = sblen - 2;
+                v->rest = (sblen > 2) ? sblen - 2 : 0;
                 v->size = ST_SIZE_BYTE;
-                return 1;
+                break;
 
             case VOC_DATA_16:
-                if (SDL_RWread(src, &new_rate_long, sizeof (new_rate_long), 1) != 1)
+                if (!voc_le32(src, &new_rate_long))
                     return 0;
-                new_rate_long = SDL_SwapLE32(new_rate_long);
                 if (new_rate_long == 0)
                 {
                     SDL_SetError("VOC Sample rate is zero?");
@@ -192,7 +242,7 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                 v->rate = new_rate_long;
                 spec->freq = new_rate_long;
 
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
 
                 switch (uc)
@@ -204,25 +254,24 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                         return 0;
                 }
 
-                if (SDL_RWread(src, &v->channels, sizeof (Uint8), 1) != 1)
+                if (!voc_byte(src, &v->channels))
                     return 0;
 
-                if (SDL_RWread(src, trash, sizeof (Uint8), 6) != 6)
+                if (voc_take(src, 6) == NULL)
                     return 0;
 
-                v->rest = sblen - 12;
-                return 1;
+                v->rest = (sblen > 12) ? sblen - 12 : 0;
+                break;
 
             case VOC_CONT:
                 v->rest = sblen;
-                return 1;
+                break;
 
             case VOC_SILENCE:
-                if (SDL_RWread(src, &period, sizeof (period), 1) != 1)
+                if (!voc_le16(src, &period))
                     return 0;
-                period = SDL_SwapLE16(period);
 
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
                 if (uc == 0)
                 {
@@ -243,24 +292,14 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                 v->silent = 1;
                 return 1;
 
-            case VOC_LOOP:
-            case VOC_LOOPEND:
-                for(i = 0; i < sblen; i++)   /* skip repeat loops. */
-                {
-                    if (SDL_RWread(src, trash, sizeof (Uint8), 1) != 1)
-                        return 0;
-                }
-                break;
-
             case VOC_EXTENDED:
                 /* An Extended block is followed by a data block */
                 /* Set this byte so we know to use the rate      */
                 /* value from the extended block and not the     */
                 /* data block.                     */
                 v->has_extended = 1;
-                if (SDL_RWread(src, &new_rate_short, sizeof (new_rate_short), 1) != 1)
+                if (!voc_le16(src, &new_rate_short))
                     return 0;
-                new_rate_short = SDL_SwapLE16(new_rate_short);
                 if (new_rate_short == 0)
                 {
                    SDL_SetError("VOC sample rate is zero");
@@ -273,7 +312,7 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                 }
                 v->rate = new_rate_short;
 
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
 
                 if (uc != 0)
@@ -282,7 +321,7 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                     return 0;
                 }
 
-                if (SDL_RWread(src, &uc, sizeof (uc), 1) != 1)
+                if (!voc_byte(src, &uc))
                     return 0;
 
                 if (uc)
@@ -296,98 +335,113 @@ static int voc_get_block(SDL_RWops *src, vs_t *v, SDL_AudioSpec *spec)
                 continue;
 
             case VOC_MARKER:
-                if (SDL_RWread(src, trash, sizeof (Uint8), 2) != 2)
+                if (voc_take(src, 2) == NULL)
                     return 0;
 
                 /* Falling! Falling! */
 
-            default:  /* text block or other krapola. */
-                for(i = 0; i < sblen; i++)
-                {
-                    if (SDL_RWread(src, &trash, sizeof (Uint8), 1) != 1)
-                        return 0;
-                }
+            default:  /* text block, repeat loops or other krapola. */
+                if (voc_take(src, sblen) == NULL)
+                    return 0;
 
-                if (block == VOC_TEXT)
-                    continue;    /* get next block */
+                continue;    /* get next block */
         }
+
+        /* A sound block, of whatever there is left */
+        if (v->rest > src->size - src->pos)
+            v->rest = (Uint32)(src->size - src->pos);
+        return 1;
     }
 
     return 1;
 }
 
 
-static int voc_read(SDL_RWops *src, vs_t *v, Uint8 *buf, SDL_AudioSpec *spec)
+/* Go through the sound from the block voc_get_block() last found to the
+   end, writing it to 'out', or with no 'out' only adding it up. Writing
+   into the file's own buffer is safe as long as no block is written past
+   where its data starts; 'lead' is raised to how much further on the file
+   would have to start for that.
+   Returns the length of the samples, or -1 on error. */
+static Sint64 voc_convert(voc_src *src, vs_t *v, SDL_AudioSpec *spec,
+                          Uint8 *out, size_t *lead)
 {
-    Uint32 done = 0;
-    Uint8 silence = 0x80;
-
-    if (v->rest == 0)
-    {
-        if (!voc_get_block(src, v, spec))
-            return 0;
-    }
-
-    if (v->rest == 0)
-        return 0;
+    Uint32 total = 0;
+    Uint8 silence;
 
-    if (v->silent)
+    while (v->rest > 0)
     {
-        if (v->size == ST_SIZE_WORD)
-            silence = 0x00;
-
-        /* Fill in silence */
-        SDL_memset(buf, silence, v->rest);
-        done = v->rest;
-        v->rest = 0;
-    }
+        if (total + v->rest < total)
+        {
+            SDL_SetError("VOC data is too long");
+            return -1;
+        }
 
-    else
-    {
-        done = (Uint32)SDL_RWread(src, buf, 1, v->rest);
-        v->rest -= done;
-        if (v->size == ST_SIZE_WORD)
+        if (v->silent)
         {
-            #if (SDL_BYTEORDER == SDL_BIG_ENDIAN)
-                Uint16 *samples = (Uint16 *)buf;
-                for (; v->rest > 0; v->rest -= 2)
-                {
-                    *samples = SDL_SwapLE16(*samples);
-                    samples++;
-                }
-            #endif
-            done >>= 1;
+            /* Fill in silence */
+            silence = (v->size == ST_SIZE_WORD) ? 0x00 : 0x80;
+            if (total + v->rest > src->pos + *lead)
+                *lead = total + v->rest - src->pos;
+            if (out)
+                SDL_memset(out + total, silence, v->rest);
         }
+        else
+        {
+            if (total > src->pos + *lead)
+                *lead = total - src->pos;
+            if (out)
+                SDL_memmove(out + total, src->data + src->pos, v->rest);
+            src->pos += v->rest;
+        }
+        total += v->rest;
+        v->rest = 0;
+
+        if (!voc_get_block(src, v, spec))
+            return -1;
     }
 
-    return done;
-} /* voc_read */
+    return total;
+} /* voc_convert */
 
 
 /* don't call this directly; use Mix_LoadWAV_RW() for now. */
 SDL_AudioSpec *Mix_LoadVOC_RW (SDL_RWops *src, int freesrc,
         SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
 {
-    vs_t v;
+    vs_t v, first;
+    voc_src data;
+    SDL_AudioSpec first_spec;
+    size_t lead = 0;
+    void *file = NULL;
+    Sint64 len;
+    size_t start;
     int was_error = 1;
     int samplesize;
-    Uint8 *fillptr;
     void *ptr;
 
     if ((!src) || (!audio_buf) || (!audio_len))   /* sanity checks. */
         goto done;
 
-    if (!voc_check_header(src))
+    /* Take the whole file at once, the blocks are parsed from memory */
+    SDL_RWseek(src, 0, RW_SEEK_SET);
+    data.data = (const Uint8 *)_Mix_RWReadAll(src, &data.size, &file);
+    if (data.data == NULL)
+        goto done;
+
+    if (!voc_check_header(&data))
         goto done;
 
     v.rate = -1;
     v.rest = 0;
+    v.size = ST_SIZE_BYTE;
+    v.channels = 1;
     v.has_extended = 0;
     *audio_buf = NULL;
     *audio_len = 0;
     SDL_memset(spec, '\0', sizeof (SDL_AudioSpec));
 
-    if (!voc_get_block(src, &v, spec))
+    if (!voc_get_block(&data, &v, spec))
         goto done;
 
     if (v.rate == -1)
@@ -400,32 +454,54 @@ SDL_AudioSpec *Mix_LoadVOC_RW (SDL_RWops *src, int freesrc,
     if (spec->channels == 0)
         spec->channels = v.channels;
 
-    *audio_len = v.rest;
-    *audio_buf = SDL_malloc(v.rest);
-    if (*audio_buf == NULL)
+    /* Size the output from the block headers, then fill it */
+    first = v;
+    first_spec = *spec;
+    start = data.pos;
+    len = voc_convert(&data, &v, spec, NULL, &lead);
+    if (len < 0)
         goto done;
 
-    fillptr = *audio_buf;
-
-    while (voc_read(src, &v, fillptr, spec) > 0)
+    if (file)
     {
-        if (!voc_get_block(src, &v, spec))
-            goto done;
-
-        *audio_len += v.rest;
-        ptr = SDL_realloc(*audio_buf, *audio_len);
-        if (ptr == NULL)
+        /* The samples are moved down over the headers they came with,
+           after moving the file up if silence would overtake them */
+        if (lead > 0)
         {
-            SDL_free(*audio_buf);
-            *audio_buf = NULL;
-            *audio_len = 0;
+            ptr = SDL_realloc(file, data.size + lead);
+            if (ptr == NULL)
+            {
+                SDL_OutOfMemory();
+                goto done;
+            }
+            SDL_memmove((Uint8 *)ptr + lead, ptr, data.size);
+            file = ptr;
+            data.data = (const Uint8 *)ptr + lead;
+        }
+        *audio_buf = (Uint8 *)file;
+        file = NULL;
+    }
+    else
+    {
+        *audio_buf = (Uint8 *)SDL_malloc((size_t)len);
+        if (*audio_buf == NULL)
+        {
+            SDL_OutOfMemory();
             goto done;
         }
-
-        *audio_buf = ptr;
-        fillptr = ((Uint8 *) ptr) + (*audio_len - v.rest);
     }
 
+    v = first;
+    *spec = first_spec;
+    data.pos = start;
+    voc_convert(&data, &v, spec, *audio_buf, &lead);
+    *audio_len = (Uint32)len;
+
+    /* Give back what the headers took, if the buffer was the file's */
+    ptr = SDL_realloc(*audio_buf, *audio_len);
+    if (ptr != NULL)
+        *audio_buf = (Uint8 *)ptr;
+
     spec->samples = (Uint16)(*audio_len / v.size);
 
     was_error = 0;  /* success, baby! */
@@ -435,6 +511,7 @@ SDL_AudioSpec *Mix_LoadVOC_RW (SDL_RWops *src, int freesrc,
     *audio_len &= ~(samplesize-1);
 
 done:
+    SDL_free(file);
     if (freesrc && src) {
         SDL_RWclose(src);
     }
@@ -0,0 +1,515 @@
+/*
+  MIXBENCH:  A benchmark for the SDL mixer library.
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* $Id$ */
+
+/* Everything here renders through Mix_OpenAudioOffline(), so the numbers
+   only depend on the CPU and not on the audio driver.  Each case is run a
+   few times and the fastest run is reported, which keeps the results
+   stable enough to compare builds and ABIs against each other.
+
+   With -j every result is printed as a line of JSON instead, for
+   bench/runbench.sh to collect, and the last line is the peak resident
+   set size of the process.  With -d the mixing cases are skipped and
+   each file is only decoded, whole and streamed.
+ */
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_mixer.h"
+
+#define BENCH_RUNS      3
+
+static int bench_rate = MIX_DEFAULT_FREQUENCY;
+static int bench_chunksize = 1024;
+static int bench_seconds = 10;
+static int bench_max_chunks = 64;
+static int bench_json = 0;
+static Uint8 *bench_buffer = NULL;
+
+
+static void Usage(char *argv0)
+{
+    SDL_Log("Usage: %s [-j] [-r rate] [-b chunksize] [-s seconds] [-n maxchunks] <wavefile> [musicfile...]\n", argv0);
+    SDL_Log("       %s [-j] -d [-r rate] [-b chunksize] [-s seconds] <file>...\n", argv0);
+}
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') {
+            printf("\\%c", *text);
+        } else if ((unsigned char)*text < 0x20) {
+            printf("\\u%04x", (unsigned char)*text);
+        } else {
+            putchar(*text);
+        }
+    }
+    putchar('"');
+}
+
+/* Print the result of a case, leaving out the values that are negative.
+   'file' is only printed with -j. */
+static void report(const char *name, const char *file, double load_ms,
+                   double frames_per_s, double decode_mb_s)
+{
+    int rate = 0;
+
+    Mix_QuerySpec(&rate, NULL, NULL);
+    if (bench_json) {
+        printf("{\"case\":");
+        print_json_string(name);
+        if (file) {
+            printf(",\"file\":");
+            print_json_string(file);
+        }
+        if (load_ms >= 0.0) {
+            printf(",\"load_ms\":%.3f", load_ms);
+        }
+        if (frames_per_s >= 0.0) {
+            printf(",\"frames_per_s\":%.0f,\"realtime\":%.1f", frames_per_s,
+                   (rate > 0) ? frames_per_s / rate : 0.0);
+        }
+        if (decode_mb_s >= 0.0) {
+            printf(",\"decode_mb_s\":%.2f", decode_mb_s);
+        }
+        printf("}\n");
+        return;
+    }
+
+    printf("%-36s", name);
+    if (load_ms >= 0.0) {
+        printf(" %14.3f ms", load_ms);
+    }
+    if (frames_per_s >= 0.0) {
+        printf(" %14.0f frames/s %10.1fx realtime", frames_per_s,
+               (rate > 0) ? frames_per_s / rate : 0.0);
+    }
+    if (decode_mb_s >= 0.0) {
+        printf(" %10.2f MB/s", decode_mb_s);
+    }
+    printf("\n");
+}
+
+/* A case that couldn't load its file, as a JSON line with -j so it
+   isn't lost */
+static void report_error(const char *name, const char *file, const char *error)
+{
+    if (bench_json) {
+        printf("{\"case\":");
+        print_json_string(name);
+        printf(",\"file\":");
+        print_json_string(file);
+        printf(",\"error\":");
+        print_json_string(error);
+        printf("}\n");
+    } else {
+        SDL_Log("Couldn't load %s: %s\n", file, error);
+    }
+}
+
+/* In kilobytes, -1 where it can't be told */
+static long peak_rss_kb(void)
+{
+#ifdef __linux__
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return -1;
+}
+
+static const char *format_name(Uint16 format)
+{
+    switch (format) {
+        case AUDIO_U8:      return "u8";
+        case AUDIO_S8:      return "s8";
+        case AUDIO_U16LSB:  return "u16lsb";
+        case AUDIO_S16LSB:  return "s16lsb";
+        case AUDIO_U16MSB:  return "u16msb";
+        case AUDIO_S16MSB:  return "s16msb";
+        case AUDIO_S32LSB:  return "s32lsb";
+        case AUDIO_S32MSB:  return "s32msb";
+        case AUDIO_F32LSB:  return "f32lsb";
+        case AUDIO_F32MSB:  return "f32msb";
+        default:            return "unknown";
+    }
+}
+
+static const char *music_type_name(Mix_MusicType type)
+{
+    switch (type) {
+        case MUS_CMD:           return "cmd";
+        case MUS_WAV:           return "wav";
+        case MUS_MOD:           return "mod";
+        case MUS_MID:           return "midi";
+        case MUS_OGG:           return "ogg";
+        case MUS_MP3:           return "mp3";
+        case MUS_MP3_MAD_UNUSED: return "mp3 (mad)";
+        case MUS_FLAC:          return "flac";
+        case MUS_MODPLUG_UNUSED: return "modplug";
+        default:                return "none";
+    }
+}
+
+static int open_offline(int rate, Uint16 format, int channels)
+{
+    Mix_CloseAudio();
+    if (Mix_OpenAudioOffline(rate, format, channels, bench_chunksize) < 0) {
+        SDL_Log("Couldn't open %d Hz %s %d channel mixer: %s\n",
+                rate, format_name(format), channels, Mix_GetError());
+        return -1;
+    }
+    SDL_free(bench_buffer);
+    bench_buffer = (Uint8 *)SDL_malloc(bench_chunksize * channels * (SDL_AUDIO_BITSIZE(format) / 8));
+    if (bench_buffer == NULL) {
+        SDL_Log("Out of memory\n");
+        return -1;
+    }
+    return 0;
+}
+
+/* Render bench_seconds of output, returns the best of BENCH_RUNS in
+   frames per second */
+static double run_bench(void)
+{
+    int rate, channels, len, run;
+    Uint16 format;
+    Uint64 frames, blocks, i, start, best = 0;
+    double seconds, fps;
+
+    Mix_QuerySpec(&rate, &format, &channels);
+    len = bench_chunksize * channels * (SDL_AUDIO_BITSIZE(format) / 8);
+    frames = (Uint64)rate * bench_seconds;
+    blocks = (frames + bench_chunksize - 1) / bench_chunksize;
+
+    for (run = 0; run < BENCH_RUNS; ++run) {
+        start = SDL_GetPerformanceCounter();
+        for (i = 0; i < blocks; ++i) {
+            Mix_RenderOffline(bench_buffer, len);
+        }
+        start = SDL_GetPerformanceCounter() - start;
+        if (run == 0 || start < best) {
+            best = start;
+        }
+    }
+
+    seconds = (double)best / SDL_GetPerformanceFrequency();
+    fps = (seconds > 0.0) ? (blocks * bench_chunksize) / seconds : 0.0;
+    return fps;
+}
+
+static void bench_chunks(const char *file)
+{
+    Mix_Chunk *wave;
+    char name[64];
+    int n, i;
+
+    if (open_offline(bench_rate, AUDIO_S16SYS, 2) < 0) {
+        return;
+    }
+    wave = Mix_LoadWAV(file);
+    if (wave == NULL) {
+        report_error("chunks", file, Mix_GetError());
+        return;
+    }
+
+    for (n = 1; n <= bench_max_chunks; n *= 2) {
+        Mix_AllocateChannels(n);
+        for (i = 0; i < n; ++i) {
+            Mix_PlayChannel(i, wave, -1);
+        }
+        SDL_snprintf(name, sizeof(name), "chunks x%d", n);
+        report(name, file, -1.0, run_bench(), -1.0);
+        Mix_HaltChannel(-1);
+    }
+    Mix_FreeChunk(wave);
+}
+
+/* One line per _Eff_position_* variant that Mix_SetPosition() can pick */
+static void bench_position(const char *file)
+{
+    static const Uint16 formats[] = {
+        AUDIO_U8, AUDIO_S8, AUDIO_U16LSB, AUDIO_S16LSB, AUDIO_U16MSB,
+        AUDIO_S16MSB, AUDIO_S32LSB, AUDIO_S32MSB, AUDIO_F32SYS
+    };
+    static const int channel_counts[] = { 2, 4, 6 };
+    Mix_Chunk *wave;
+    char name[64];
+    int f, c, i;
+
+    for (f = 0; f < (int)SDL_arraysize(formats); ++f) {
+        for (c = 0; c < (int)SDL_arraysize(channel_counts); ++c) {
+            if (open_offline(bench_rate, formats[f], channel_counts[c]) < 0) {
+                continue;
+            }
+            SDL_snprintf(name, sizeof(name), "position %s %dch x8",
+                         format_name(formats[f]), channel_counts[c]);
+            wave = Mix_LoadWAV(file);
+            if (wave == NULL) {
+                report_error(name, file, Mix_GetError());
+                return;
+            }
+            Mix_AllocateChannels(8);
+            for (i = 0; i < 8; ++i) {
+                if (!Mix_SetPosition(i, (Sint16)(i * 45), (Uint8)(i * 30 + 1))) {
+                    break;
+                }
+                Mix_PlayChannel(i, wave, -1);
+            }
+            if (i == 8) {
+                report(name, file, -1.0, run_bench(), -1.0);
+            }
+            Mix_HaltChannel(-1);
+            Mix_FreeChunk(wave);
+        }
+    }
+}
+
+static void bench_music(const char *file)
+{
+    Mix_Music *music;
+    char name[64];
+
+    if (open_offline(bench_rate, AUDIO_S16SYS, 2) < 0) {
+        return;
+    }
+    music = Mix_LoadMUS(file);
+    if (music == NULL) {
+        report_error("music", file, Mix_GetError());
+        return;
+    }
+    Mix_PlayMusic(music, -1);
+    SDL_snprintf(name, sizeof(name), "music %s", music_type_name(Mix_GetMusicType(music)));
+    report(name, file, -1.0, run_bench(), -1.0);
+    Mix_HaltMusic();
+    Mix_FreeMusic(music);
+}
+
+/* For -d: how long Mix_LoadWAV() takes to decode all of the file to the
+   device's format, and Mix_LoadMUS() to open it and how fast it streams.
+   The decode rate is of the S16 stereo output, so it's comparable across
+   codecs.  A file that only loads one way, such as a VOC, gets one line. */
+static void bench_decode(const char *file)
+{
+    const char *ext = SDL_strrchr(file, '.');
+    Mix_Chunk *wave;
+    Mix_Music *music = NULL;
+    Uint64 start, best = 0;
+    Uint32 bytes = 0;
+    double seconds, fps;
+    char name[64];
+    int decoded = 0;
+    int run;
+
+    if (open_offline(bench_rate, AUDIO_S16SYS, 2) < 0) {
+        return;
+    }
+    ext = (ext != NULL) ? ext + 1 : "none";
+
+    SDL_snprintf(name, sizeof(name), "decode %s", ext);
+    for (run = 0; run < BENCH_RUNS; ++run) {
+        start = SDL_GetPerformanceCounter();
+        wave = Mix_LoadWAV(file);
+        start = SDL_GetPerformanceCounter() - start;
+        if (wave == NULL) {
+            report_error(name, file, Mix_GetError());
+            break;
+        }
+        bytes = wave->alen;
+        Mix_FreeChunk(wave);
+        if (run == 0 || start < best) {
+            best = start;
+        }
+    }
+    if (run == BENCH_RUNS) {
+        decoded = 1;
+        seconds = (double)best / SDL_GetPerformanceFrequency();
+        report(name, file, seconds * 1000.0, -1.0,
+               (seconds > 0.0) ? bytes / seconds / 1000000.0 : 0.0);
+    }
+
+    SDL_snprintf(name, sizeof(name), "stream %s", ext);
+    for (run = 0; run < BENCH_RUNS; ++run) {
+        if (music != NULL) {
+            Mix_FreeMusic(music);
+        }
+        start = SDL_GetPerformanceCounter();
+        music = Mix_LoadMUS(file);
+        start = SDL_GetPerformanceCounter() - start;
+        if (music == NULL) {
+            if (!decoded) {
+                report_error(name, file, Mix_GetError());
+            }
+            return;
+        }
+        if (run == 0 || start < best) {
+            best = start;
+        }
+    }
+    Mix_PlayMusic(music, -1);
+    fps = run_bench();
+    report(name, file, (double)best * 1000.0 / SDL_GetPerformanceFrequency(), fps,
+           fps * 2 * sizeof(Sint16) / 1000000.0);
+    Mix_HaltMusic();
+    Mix_FreeMusic(music);
+}
+
+/* Loading at the file's own rate skips the resampler in SDL_AudioCVT */
+static void bench_load(const char *file)
+{
+    SDL_AudioSpec spec;
+    Uint8 *buf;
+    Uint32 len;
+    Uint64 start, best;
+    char name[64];
+    int rates[2], r, run;
+    Mix_Chunk *wave;
+
+    if (SDL_LoadWAV(file, &spec, &buf, &len) == NULL) {
+        report_error("load", file, SDL_GetError());
+        return;
+    }
+    SDL_FreeWAV(buf);
+    rates[0] = spec.freq;
+    rates[1] = (spec.freq == 48000) ? 44100 : 48000;
+
+    for (r = 0; r < 2; ++r) {
+        if (open_offline(rates[r], AUDIO_S16SYS, 2) < 0) {
+            return;
+        }
+        best = 0;
+        for (run = 0; run < BENCH_RUNS; ++run) {
+            start = SDL_GetPerformanceCounter();
+            wave = Mix_LoadWAV(file);
+            start = SDL_GetPerformanceCounter() - start;
+            if (wave == NULL) {
+                report_error("load", file, Mix_GetError());
+                return;
+            }
+            Mix_FreeChunk(wave);
+            if (run == 0 || start < best) {
+                best = start;
+            }
+        }
+        SDL_snprintf(name, sizeof(name), "load %s %d -> %d Hz",
+                     (r == 0) ? "native" : "resampled", spec.freq, rates[r]);
+        report(name, file, (double)best * 1000.0 / SDL_GetPerformanceFrequency(), -1.0, -1.0);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    int decode_only = 0;
+    long rss;
+    int i;
+
+    for (i=1; argv[i] && (*argv[i] == '-'); ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            bench_json = 1;
+        } else
+        if (strcmp(argv[i], "-d") == 0) {
+            decode_only = 1;
+        } else
+        if ((strcmp(argv[i], "-r") == 0) && argv[i+1]) {
+            ++i;
+            bench_rate = atoi(argv[i]);
+        } else
+        if ((strcmp(argv[i], "-b") == 0) && argv[i+1]) {
+            ++i;
+            bench_chunksize = atoi(argv[i]);
+        } else
+        if ((strcmp(argv[i], "-s") == 0) && argv[i+1]) {
+            ++i;
+            bench_seconds = atoi(argv[i]);
+        } else
+        if ((strcmp(argv[i], "-n") == 0) && argv[i+1]) {
+            ++i;
+            bench_max_chunks = atoi(argv[i]);
+        } else {
+            Usage(argv[0]);
+            return(1);
+        }
+    }
+    if (! argv[i] || bench_rate <= 0 || bench_chunksize <= 0 || bench_seconds <= 0) {
+        Usage(argv[0]);
+        return(1);
+    }
+
+#ifdef SDL_MAIN_HANDLED
+    /* Built as a command line program, nothing ran SDL_main() */
+    SDL_SetMainReady();
+#endif
+    if (SDL_Init(0) < 0) {
+        SDL_Log("Couldn't initialize SDL: %s\n",SDL_GetError());
+        return(255);
+    }
+    Mix_Init(MIX_INIT_FLAC|MIX_INIT_MOD|MIX_INIT_MP3|MIX_INIT_OGG|MIX_INIT_MID);
+
+    if (bench_json) {
+        printf("{\"case\":\"config\",\"rate\":%d,\"chunksize\":%d,\"seconds\":%d,\"runs\":%d,\"simd\":\"%s\"}\n",
+               bench_rate, bench_chunksize, bench_seconds, BENCH_RUNS,
+               SDL_HasNEON() ? "neon" : SDL_HasSSE2() ? "sse2" : "scalar");
+    } else {
+        printf("%d Hz, %d frame chunks, %d seconds per case, best of %d\n",
+               bench_rate, bench_chunksize, bench_seconds, BENCH_RUNS);
+    }
+
+    if (decode_only) {
+        for (; argv[i]; ++i) {
+            bench_decode(argv[i]);
+        }
+    } else {
+        bench_chunks(argv[i]);
+        bench_position(argv[i]);
+        bench_load(argv[i]);
+        for (++i; argv[i]; ++i) {
+            bench_music(argv[i]);
+        }
+    }
+
+    rss = peak_rss_kb();
+    if (bench_json) {
+        printf("{\"case\":\"process\",\"peak_rss_kb\":%ld}\n", rss);
+    } else if (rss >= 0) {
+        printf("%-36s %14ld kB\n", "peak rss", rss);
+    }
+
+    Mix_CloseAudio();
+    SDL_free(bench_buffer);
+    Mix_Quit();
+    SDL_Quit();
+    return(0);
+}
+
+/* end of mixbench.c ... */
+
+/* vi: set ts=4 sw=4 expandtab: */
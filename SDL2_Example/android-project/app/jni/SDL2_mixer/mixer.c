@@ -29,9 +29,20 @@
 
 #include "SDL_mixer.h"
 #include "mixer.h"
+#include "mixer_analysis.h"
+#include "mixer_bus.h"
+#include "mixer_convert.h"
+#include "mixer_stats.h"
+#include "mixer_opensles.h"
+#include "mixer_thread.h"
+#include "mixer_trace.h"
+#include "chunk_cache.h"
 #include "music.h"
 #include "load_aiff.h"
 #include "load_voc.h"
+#include "load_mmap.h"
+#include "load_buffered.h"
+#include "load_adpcm.h"
 
 #define __MIX_INTERNAL_EFFECT__
 #include "effects_internal.h"
@@ -45,16 +56,56 @@
 static int audio_opened = 0;
 static SDL_AudioSpec mixer;
 static SDL_AudioDeviceID audio_device;
+static SDL_bool audio_offline = SDL_FALSE;   /* see Mix_OpenAudioOffline() */
+static SDL_bool audio_native = SDL_FALSE;    /* see Mix_OpenAudioNative() */
+
+/* Mix_SetAudioThreadPolicy(), applied by the callback to its own thread */
+static Mix_ThreadPriority thread_priority = MIX_THREAD_DEFAULT;
+static Uint32 thread_cpu_mask = 0;
+static SDL_bool thread_policy_pending = SDL_FALSE;
+
+/* Mix_SetAutoSuspend(): the callback suspends the output once it's been
+   idle for 'suspend_after_ms', and _Mix_WakeOutput() brings it back */
+static int suspend_after_ms = 0;
+static Uint32 idle_frames = 0;
+static SDL_atomic_t output_suspended;
+/* Mix_PauseOutput(): the output stays suspended, whatever wants to play */
+static SDL_atomic_t output_paused;
 
 typedef struct _Mix_effectinfo
 {
     Mix_EffectFunc_t callback;
     Mix_EffectDone_t done_callback;
+    Mix_EffectCopyFunc_t copy;  /* 'callback' from the chunk, see Mix_RegisterCopyEffect() */
+    _Mix_EffectGains_t gains;   /* see _Mix_RegisterGainEffect_locked() */
+    _Mix_EffectBus_t bus;       /* instead of 'callback', see _Mix_RegisterBusEffect_locked() */
     void *udata;
     struct _Mix_effectinfo *next;
 } effect_info;
 
-static struct _Mix_Channel {
+/* Most channels a gain effect can be applied to while mixing */
+#define MIX_MAX_GAIN_CHANNELS   8
+
+/* Mix_Chunk.allocated value for chunks from Mix_LoadWAVStreamed_RW() */
+#define MIX_CHUNK_STREAMED  3
+
+/* Decoder state of a chunk from Mix_LoadWAVStreamed_RW() */
+typedef struct _Mix_ChunkStream
+{
+    Mix_Chunk *chunk;
+    Mix_MusicInterface *interface;
+    void *context;
+    Uint8 *ring;        /* look-ahead of decoded samples, also chunk->abuf */
+    int size;
+    int pos;            /* next byte of the ring to mix */
+    int fill;           /* bytes of the ring holding samples */
+    SDL_bool done;      /* the decoder has nothing more after this */
+    struct _Mix_ChunkStream *next;
+} Mix_ChunkStream;
+
+static Mix_ChunkStream *chunk_streams = NULL;
+
+struct _Mix_Channel {
     Mix_Chunk *chunk;
     int playing;
     int paused;
@@ -62,25 +113,188 @@ static struct _Mix_Channel {
     int volume;
     int looping;
     int tag;
+    int group_next;     /* next channel with the same tag, or -1, see mix_groups */
     Uint32 expire;
     Uint32 start_time;
     Mix_Fading fading;
-    int fade_volume;
-    int fade_volume_reset;
-    Uint32 fade_length;
-    Uint32 ticks_fade;
+    Uint32 fade_frames;     /* length of the fade in sample frames */
+    Uint32 fade_pos;        /* sample frames of the fade already mixed */
     effect_info *effects;
-} *mix_channel = NULL;
+    int active;     /* slot in active_channels, or -1 if not playing */
+    Uint64 start_frame; /* output frame to start at, 0 to start right away */
+    Mix_ChunkStream *stream;    /* set if the chunk is decoded as it plays */
+    int priority;       /* of the chunk playing, see Mix_PriorityChunk() */
+    int done_pending;   /* finished on a mixing worker, see mix_defer_done */
+    Uint32 rate;        /* source frames per output frame, 16.16 fixed point */
+    Uint32 rate_pos;    /* fraction of a source frame already played */
+    Mix_Resampler resampler;
+    float send;         /* level sent to mix_send_effect, see _Mix_SetChannelSend_locked() */
+    int submix;         /* bus it's routed to, or MIX_BUS_MASTER */
+    int reverse;        /* swap the sides as it's mixed, see Mix_SetReverseStereo() */
+    Uint8 *tile;        /* a short looping chunk repeated, see _Mix_channel_tile() */
+    Uint32 tile_len;    /* bytes of it that are the chunk playing, 0 for none */
+    Uint32 tile_size;   /* bytes allocated */
+};
+
+/* The channels live in pages that are never moved or freed until the
+   device closes, so Mix_AllocateChannels() can add more while the
+   callback goes on mixing the ones it has. */
+#define MIX_CHANNEL_PAGE_SHIFT  5
+#define MIX_CHANNEL_PAGE        (1 << MIX_CHANNEL_PAGE_SHIFT)
+#define MIX_MAX_CHANNEL_PAGES   512
+#define mix_channel(i)  (mix_channel_pages[(i) >> MIX_CHANNEL_PAGE_SHIFT][(i) & (MIX_CHANNEL_PAGE - 1)])
+
+static struct _Mix_Channel *mix_channel_pages[MIX_MAX_CHANNEL_PAGES];
+static int num_channel_pages = 0;
+
+/* Mix_SetChannelRate() range, in 16.16 fixed point */
+#define MIX_RATE_ONE    0x10000
+#define MIX_RATE_MIN    (MIX_RATE_ONE / 256)
+#define MIX_RATE_MAX    (MIX_RATE_ONE * 16)
 
 static effect_info *posteffects = NULL;
 
+/* Settings of chunks given a priority with Mix_PriorityChunk() or limits
+   with Mix_LimitChunk(), the other chunks use the defaults (all 0) */
+typedef struct _Mix_ChunkInfo
+{
+    Mix_Chunk *chunk;
+    int priority;
+    int max_instances;  /* 0 for no limit */
+    int min_frames;     /* between two starts of the chunk */
+    SDL_bool started;
+    Uint64 last_start;  /* output frame the chunk last started at */
+    struct _Mix_ChunkInfo *next;
+} chunk_info;
+
+static chunk_info *chunk_infos = NULL;
+
+/* What to do when there's no free channel, see Mix_SetVoiceStealing() */
+static Mix_StealPolicy steal_policy = MIX_STEAL_NONE;
+static int steal_tag = -1;
+
 static int num_channels;
+static int max_channels = 0;    /* room in the pages and the active list */
 static int reserved_channels = 0;
 
+/* The channels of each tag in channel order, so the group queries only
+   visit the channels they ask about, see Mix_GroupChannel() */
+typedef struct _Mix_Group
+{
+    int tag;
+    int count;
+    int first;          /* the lowest channel, the rest follow group_next */
+} mix_group;
+
+static mix_group *mix_groups = NULL;
+static int num_groups = 0;
+static int max_groups = 0;
+
+/* The channels that are playing, so the callback only visits those.
+   mix_order is where the callback takes its snapshot of the list. */
+static int *active_channels = NULL;
+static int *mix_order = NULL;
+static int num_active = 0;
+
+/* Scratch space for channel effects and resampling, allocated when the
+   audio device is opened so that the mixing callback never has to touch
+   the heap. Each thread that mixes channels has its own. */
+typedef struct _Mix_Scratch
+{
+    Uint8 *effects;         /* effect_scratch_len bytes */
+    Uint8 *resampled;       /* effect_scratch_len bytes */
+    float *resample_in;     /* resample_in_frames frames of the chunk */
+    float *resample_out;    /* mix_bus_samples samples */
+    float *effects_bus;     /* mix_bus_samples samples, for float effects */
+    float *send;            /* mix_bus_samples samples, lined up with 'bus' */
+    float *submix;          /* mix_bus_samples samples for each submix bus */
+    const float *bus;       /* the bus this thread mixes into */
+} mix_scratch;
+
+static mix_scratch audio_scratch;
+static int effect_scratch_len = 0;
+static int resample_in_frames = 0;
+
+/* Float accumulation bus, one entry per sample of the device buffer */
+static float *mix_bus = NULL;
+static int mix_bus_samples = 0;
+
+/* Run over the summed channel sends once per callback, if set */
+static _Mix_EffectSend_t mix_send_effect = NULL;
+static void *mix_send_data = NULL;
+
+/* Submix buses, see Mix_CreateBus(). Each thread sums the channels routed
+   to a bus into its own part of scratch->submix, the bus then goes through
+   its effects and into mix_bus on the audio thread. */
+typedef struct _Mix_Submix
+{
+    char *name;
+    int volume;
+    float gain;             /* the bus was last added at, ramps to 'volume' */
+    effect_info *effects;
+} mix_submix;
+
+static mix_submix *submixes = NULL;
+static int num_submixes = 0;
+static int music_submix = MIX_BUS_MASTER;
+
+/* Number of sample frames handed to the device since it was opened */
+static Uint64 mix_output_frame = 0;
+
+/*
+ * Parallel mixing, see Mix_SetMixThreads().
+ *  When enough channels are playing, the callback hands some of them to a
+ *  few worker threads, each mixing into a bus of its own, and sums those
+ *  buses into mix_bus once they're all done.
+ */
+#define MIX_MAX_MIX_THREADS 7
+
+typedef struct _Mix_MixJob
+{
+    int channel;
+    int offset;         /* byte of the buffer the channel starts at */
+    int owner;          /* 0 for the audio thread, else worker owner-1 */
+} mix_job;
+
+typedef struct _Mix_MixWorker
+{
+    SDL_Thread *thread;
+    SDL_sem *go;        /* posted when there's a buffer to mix */
+    float *bus;
+    mix_scratch scratch;
+} mix_worker;
+
+static mix_worker mix_workers[MIX_MAX_MIX_THREADS];
+static int num_mix_workers = 0;
+static int mix_threads_wanted = 0;
+static int mix_threads_min_channels = 1;
+static SDL_sem *mix_workers_done = NULL;
+static SDL_bool mix_workers_quit = SDL_FALSE;
+
+/* The channels to mix in the current buffer, one slot per channel */
+static mix_job *mix_jobs = NULL;
+static int num_mix_jobs = 0;
+static int mix_len = 0;
+
+/* Set while workers run, so finished channels are reported afterwards on
+   the audio thread instead of calling back the app from a worker */
+static SDL_bool mix_defer_done = SDL_FALSE;
+
+/* The clock for channel expiry, which follows the output when offline */
+static Uint32 _Mix_GetTicks(void)
+{
+    if (audio_offline) {
+        return (Uint32)((mix_output_frame * 1000) / mixer.freq);
+    }
+    return SDL_GetTicks();
+}
+
 
 /* Support for hooking into the mixer callback system */
 static void (SDLCALL *mix_postmix)(void *udata, Uint8 *stream, int len) = NULL;
 static void *mix_postmix_data = NULL;
+static void (SDLCALL *mix_postmix_float)(void *udata, float *bus, int frames, int channels) = NULL;
+static void *mix_postmix_float_data = NULL;
 
 /* rcg07062001 callback to alert when channels are done playing. */
 static void (SDLCALL *channel_done_callback)(int channel) = NULL;
@@ -88,6 +302,8 @@ static void (SDLCALL *channel_done_callback)(int channel) = NULL;
 /* Support for user defined music functions */
 static void (SDLCALL *mix_music)(void *udata, Uint8 *stream, int len) = music_mixer;
 static void *music_data = NULL;
+/* Set instead of mix_music by Mix_HookMusicFloat(), sharing music_data */
+static void (SDLCALL *mix_music_float)(void *udata, float *bus, int frames, int channels) = NULL;
 
 /* rcg06042009 report available decoders at runtime. */
 static const char **chunk_decoders = NULL;
@@ -198,309 +414,2309 @@ void Mix_Quit()
     unload_music();
 }
 
-static int _Mix_remove_all_effects(int channel, effect_info **e);
+/* An error from _Mix_SetErrorLater(), one per thread that reported one */
+typedef struct _Mix_DeferredError
+{
+    Mix_ErrorFormatter format;
+    const char *what;
+    int code;
+} Mix_DeferredError;
 
-/*
- * rcg06122001 Cleanup effect callbacks.
- *  MAKE SURE Mix_LockAudio() is called before this (or you're in the
- *   audio callback).
- */
-static void _Mix_channel_done_playing(int channel)
+static SDL_TLSID deferred_error_id = 0;
+static SDL_SpinLock deferred_error_lock;
+
+static Mix_DeferredError *_Mix_GetDeferredError(SDL_bool create)
 {
-    if (channel_done_callback) {
-        channel_done_callback(channel);
+    Mix_DeferredError *deferred;
+
+    if (deferred_error_id == 0) {
+        if (!create) {
+            return NULL;
+        }
+        SDL_AtomicLock(&deferred_error_lock);
+        if (deferred_error_id == 0) {
+            deferred_error_id = SDL_TLSCreate();
+        }
+        SDL_AtomicUnlock(&deferred_error_lock);
     }
 
-    /*
-     * Call internal function directly, to avoid locking audio from
-     *   inside audio callback.
-     */
-    _Mix_remove_all_effects(channel, &mix_channel[channel].effects);
+    deferred = (Mix_DeferredError *)SDL_TLSGet(deferred_error_id);
+    if (deferred == NULL && create) {
+        deferred = (Mix_DeferredError *)SDL_calloc(1, sizeof(*deferred));
+        if (deferred != NULL && SDL_TLSSet(deferred_error_id, deferred, SDL_free) < 0) {
+            SDL_free(deferred);
+            deferred = NULL;
+        }
+    }
+    return deferred;
 }
 
-
-static void *Mix_DoEffects(int chan, void *snd, int len)
+int _Mix_SetErrorLater(Mix_ErrorFormatter format, const char *what, int code)
 {
-    int posteffect = (chan == MIX_CHANNEL_POST);
-    effect_info *e = ((posteffect) ? posteffects : mix_channel[chan].effects);
-    void *buf = snd;
+    Mix_DeferredError *deferred = _Mix_GetDeferredError(SDL_TRUE);
 
-    if (e != NULL) {    /* are there any registered effects? */
-        /* if this is the postmix, we can just overwrite the original. */
-        if (!posteffect) {
-            buf = SDL_malloc(len);
-            if (buf == NULL) {
-                return(snd);
-            }
-            SDL_memcpy(buf, snd, len);
+    if (deferred == NULL) {
+        /* Out of memory, so there's no saving the formatting */
+        if (format) {
+            format(what, code);
+        } else {
+            Mix_SetError("%s", what);
         }
+        return(-1);
+    }
 
-        for (; e != NULL; e = e->next) {
-            if (e->callback != NULL) {
-                e->callback(chan, buf, len, e->udata);
+    /* With SDL's error cleared, any error set after this one shows */
+    SDL_ClearError();
+    deferred->format = format;
+    deferred->what = what;
+    deferred->code = code;
+    return(-1);
+}
+
+const char *Mix_GetError(void)
+{
+    Mix_DeferredError *deferred = _Mix_GetDeferredError(SDL_FALSE);
+
+    if (deferred != NULL && deferred->what != NULL) {
+        if (*SDL_GetError() == '\0') {
+            if (deferred->format) {
+                deferred->format(deferred->what, deferred->code);
+            } else {
+                Mix_SetError("%s", deferred->what);
             }
         }
+        deferred->what = NULL;
     }
+    return(SDL_GetError());
+}
 
-    /* be sure to SDL_free() the return value if != snd ... */
-    return(buf);
+void Mix_ClearError(void)
+{
+    Mix_DeferredError *deferred = _Mix_GetDeferredError(SDL_FALSE);
+
+    if (deferred != NULL) {
+        deferred->what = NULL;
+    }
+    SDL_ClearError();
 }
 
+static int _Mix_remove_all_effects(int channel, effect_info **e);
+static void _Mix_DrainCommands(void);
+static SDL_bool _Mix_CommandsPending(void);
+static void _Mix_UnqueueChunk(Mix_Chunk *chunk);
+static SDL_bool _Mix_chunk_in_use(const Mix_Chunk *chunk);
+static void _Mix_HaltChannel_locked(int which);
+static void _Mix_free_chunk_info(Mix_Chunk *chunk);
 
-/* Mixing function */
-static void SDLCALL
-mix_channels(void *udata, Uint8 *stream, int len)
+/*
+ * Add or remove a channel from the active list.
+ *  MAKE SURE Mix_LockAudio() is called before this (or you're in the
+ *   audio callback).
+ */
+static void _Mix_channel_activate(int which)
 {
-    Uint8 *mix_input;
-    int i, mixable, volume = MIX_MAX_VOLUME;
-    Uint32 sdl_ticks;
+    if (mix_channel(which).active < 0) {
+        mix_channel(which).active = num_active;
+        active_channels[num_active++] = which;
+        _Mix_WakeOutput();
+    }
+}
 
-#if SDL_VERSION_ATLEAST(1, 3, 0)
-    /* Need to initialize the stream in SDL 1.3+ */
-    SDL_memset(stream, mixer.silence, len);
-#endif
+static void _Mix_channel_deactivate(int which)
+{
+    int slot = mix_channel(which).active;
 
-    /* Mix the music (must be done before the channels are added) */
-    mix_music(music_data, stream, len);
+    if (slot >= 0) {
+        int last = active_channels[--num_active];
+        active_channels[slot] = last;
+        mix_channel(last).active = slot;
+        mix_channel(which).active = -1;
+    }
+}
 
-    /* Mix any playing channels... */
-    sdl_ticks = SDL_GetTicks();
-    for (i=0; i<num_channels; ++i) {
-        if (!mix_channel[i].paused) {
-            if (mix_channel[i].expire > 0 && mix_channel[i].expire < sdl_ticks) {
-                /* Expiration delay for that channel is reached */
-                mix_channel[i].playing = 0;
-                mix_channel[i].looping = 0;
-                mix_channel[i].fading = MIX_NO_FADING;
-                mix_channel[i].expire = 0;
-                _Mix_channel_done_playing(i);
-            } else if (mix_channel[i].fading != MIX_NO_FADING) {
-                Uint32 ticks = sdl_ticks - mix_channel[i].ticks_fade;
-                if (ticks >= mix_channel[i].fade_length) {
-                    Mix_Volume(i, mix_channel[i].fade_volume_reset); /* Restore the volume */
-                    if(mix_channel[i].fading == MIX_FADING_OUT) {
-                        mix_channel[i].playing = 0;
-                        mix_channel[i].looping = 0;
-                        mix_channel[i].expire = 0;
-                        _Mix_channel_done_playing(i);
-                    }
-                    mix_channel[i].fading = MIX_NO_FADING;
-                } else {
-                    if (mix_channel[i].fading == MIX_FADING_OUT) {
-                        Mix_Volume(i, (mix_channel[i].fade_volume * (mix_channel[i].fade_length-ticks))
-                                   / mix_channel[i].fade_length);
-                    } else {
-                        Mix_Volume(i, (mix_channel[i].fade_volume * ticks) / mix_channel[i].fade_length);
-                    }
-                }
-            }
-            if (mix_channel[i].playing > 0) {
-                int index = 0;
-                int remaining = len;
-                while (mix_channel[i].playing > 0 && index < len) {
-                    remaining = len - index;
-                    volume = (mix_channel[i].volume*mix_channel[i].chunk->volume) / MIX_MAX_VOLUME;
-                    mixable = mix_channel[i].playing;
-                    if (mixable > remaining) {
-                        mixable = remaining;
-                    }
-
-                    mix_input = Mix_DoEffects(i, mix_channel[i].samples, mixable);
-                    SDL_MixAudioFormat(stream+index,mix_input,mixer.format,mixable,volume);
-                    if (mix_input != mix_channel[i].samples)
-                        SDL_free(mix_input);
-
-                    mix_channel[i].samples += mixable;
-                    mix_channel[i].playing -= mixable;
-                    index += mixable;
-
-                    /* rcg06072001 Alert app if channel is done playing. */
-                    if (!mix_channel[i].playing && !mix_channel[i].looping) {
-                        _Mix_channel_done_playing(i);
-                    }
-                }
+static mix_group *_Mix_find_group(int tag)
+{
+    int i;
 
-                /* If looping the sample and we are at its end, make sure
-                   we will still return a full buffer */
-                while (mix_channel[i].looping && index < len) {
-                    int alen = mix_channel[i].chunk->alen;
-                    remaining = len - index;
-                    if (remaining > alen) {
-                        remaining = alen;
-                    }
-
-                    mix_input = Mix_DoEffects(i, mix_channel[i].chunk->abuf, remaining);
-                    SDL_MixAudioFormat(stream+index, mix_input, mixer.format, remaining, volume);
-                    if (mix_input != mix_channel[i].chunk->abuf)
-                        SDL_free(mix_input);
-
-                    if (mix_channel[i].looping > 0) {
-                        --mix_channel[i].looping;
-                    }
-                    mix_channel[i].samples = mix_channel[i].chunk->abuf + remaining;
-                    mix_channel[i].playing = mix_channel[i].chunk->alen - remaining;
-                    index += remaining;
-                }
-                if (! mix_channel[i].playing && mix_channel[i].looping) {
-                    if (mix_channel[i].looping > 0) {
-                        --mix_channel[i].looping;
-                    }
-                    mix_channel[i].samples = mix_channel[i].chunk->abuf;
-                    mix_channel[i].playing = mix_channel[i].chunk->alen;
-                }
-            }
+    for (i = 0; i < num_groups; ++i) {
+        if (mix_groups[i].tag == tag) {
+            return &mix_groups[i];
         }
     }
+    return NULL;
+}
 
-    /* rcg06122001 run posteffects... */
-    Mix_DoEffects(MIX_CHANNEL_POST, stream, len);
+/* Make sure one more group fits, so moving a channel can't fail halfway */
+static int _Mix_reserve_group(void)
+{
+    mix_group *groups;
 
-    if (mix_postmix) {
-        mix_postmix(mix_postmix_data, stream, len);
+    if (num_groups < max_groups) {
+        return 0;
+    }
+    groups = (mix_group *)SDL_realloc(mix_groups, (max_groups + 4) * sizeof(mix_group));
+    if (groups == NULL) {
+        return -1;
     }
+    mix_groups = groups;
+    max_groups += 4;
+    return 0;
 }
 
-#if 0
-static void PrintFormat(char *title, SDL_AudioSpec *fmt)
+/*
+ * Take a channel out of the group of its tag, or put it in the one of
+ *  'tag', after _Mix_reserve_group().
+ *  MAKE SURE Mix_LockAudio() is called before this (or you're in the
+ *   audio callback).
+ */
+static void _Mix_group_remove(int which)
 {
-    printf("%s: %d bit %s audio (%s) at %u Hz\n", title, (fmt->format&0xFF),
-            (fmt->format&0x8000) ? "signed" : "unsigned",
-            (fmt->channels > 2) ? "surround" :
-            (fmt->channels > 1) ? "stereo" : "mono", fmt->freq);
+    mix_group *group = _Mix_find_group(mix_channel(which).tag);
+    int *link;
+
+    if (group == NULL) {
+        return;
+    }
+    for (link = &group->first; *link >= 0 && *link != which; link = &mix_channel(*link).group_next) {
+    }
+    if (*link < 0) {
+        return;
+    }
+    *link = mix_channel(which).group_next;
+    mix_channel(which).group_next = -1;
+    if (--group->count == 0) {
+        *group = mix_groups[--num_groups];
+    }
 }
-#endif
 
-/* Open the mixer with a certain desired audio format */
-int Mix_OpenAudioDevice(int frequency, Uint16 format, int nchannels, int chunksize,
-                        const char* device, int allowed_changes)
+static void _Mix_group_add(int which, int tag)
+{
+    mix_group *group = _Mix_find_group(tag);
+    int *link;
+
+    if (group == NULL) {
+        group = &mix_groups[num_groups++];
+        group->tag = tag;
+        group->count = 0;
+        group->first = -1;
+    }
+    for (link = &group->first; *link >= 0 && *link < which; link = &mix_channel(*link).group_next) {
+    }
+    mix_channel(which).group_next = *link;
+    *link = which;
+    mix_channel(which).tag = tag;
+    ++group->count;
+}
+
+/* Index the tags of all the channels afresh, after they were reallocated */
+static int _Mix_regroup_channels(void)
 {
     int i;
-    SDL_AudioSpec desired;
 
-    /* This used to call SDL_OpenAudio(), which initializes the audio
-       subsystem if necessary. Since SDL_OpenAudioDevice() doesn't,
-       we have to handle this case here. */
-    if (!SDL_WasInit(SDL_INIT_AUDIO)) {
-        if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+    num_groups = 0;
+    /* From the top, so every channel goes in at the head of its group */
+    for (i = num_channels - 1; i >= 0; --i) {
+        if (!_Mix_find_group(mix_channel(i).tag) && _Mix_reserve_group() < 0) {
             return -1;
         }
+        _Mix_group_add(i, mix_channel(i).tag);
     }
+    return 0;
+}
 
-    /* If the mixer is already opened, increment open count */
-    if (audio_opened) {
-        if (format == mixer.format && nchannels == mixer.channels) {
-            ++audio_opened;
-            return(0);
-        }
-        while (audio_opened) {
-            Mix_CloseAudio();
+/* Make room for 'numchans' channels.  The new pages go where the callback
+   doesn't look yet, only the active list moves, and that under the lock
+   for as long as it takes to copy the channels playing. */
+static int _Mix_reserve_channels(int numchans)
+{
+    int pages = (numchans + MIX_CHANNEL_PAGE - 1) >> MIX_CHANNEL_PAGE_SHIFT;
+    int capacity = pages << MIX_CHANNEL_PAGE_SHIFT;
+    int *active, *old_active, *order, *old_order;
+    mix_job *jobs, *old_jobs;
+
+    if (pages > MIX_MAX_CHANNEL_PAGES) {
+        Mix_SetError("Can't allocate more than %d channels", MIX_MAX_CHANNEL_PAGES * MIX_CHANNEL_PAGE);
+        return -1;
+    }
+    while (num_channel_pages < pages) {
+        struct _Mix_Channel *page = (struct _Mix_Channel *)SDL_calloc(MIX_CHANNEL_PAGE, sizeof(struct _Mix_Channel));
+        if (page == NULL) {
+            Mix_SetError("Out of memory");
+            return -1;
         }
+        mix_channel_pages[num_channel_pages++] = page;
+    }
+    if (capacity <= max_channels) {
+        return 0;
     }
 
-    /* Set the desired format and frequency */
-    desired.freq = frequency;
-    desired.format = format;
-    desired.channels = nchannels;
-    desired.samples = chunksize;
-    desired.callback = mix_channels;
-    desired.userdata = NULL;
-
-    /* Accept nearly any audio format */
-    if ((audio_device = SDL_OpenAudioDevice(device, 0, &desired, &mixer, allowed_changes)) == 0) {
-        return(-1);
+    active = (int *)SDL_malloc(capacity * sizeof(int));
+    order = (int *)SDL_malloc(capacity * sizeof(int));
+    jobs = (mix_job *)SDL_malloc(capacity * sizeof(mix_job));
+    if (active == NULL || order == NULL || jobs == NULL) {
+        SDL_free(active);
+        SDL_free(order);
+        SDL_free(jobs);
+        Mix_SetError("Out of memory");
+        return -1;
     }
-#if 0
-    PrintFormat("Audio device", &mixer);
-#endif
+    /* mix_order and mix_jobs only hold anything while the callback runs */
+    Mix_LockAudio();
+    if (num_active > 0) {
+        SDL_memcpy(active, active_channels, num_active * sizeof(int));
+    }
+    old_active = active_channels;
+    old_order = mix_order;
+    old_jobs = mix_jobs;
+    active_channels = active;
+    mix_order = order;
+    mix_jobs = jobs;
+    max_channels = capacity;
+    Mix_UnlockAudio();
+    SDL_free(old_active);
+    SDL_free(old_order);
+    SDL_free(old_jobs);
+    return 0;
+}
 
-    num_channels = MIX_CHANNELS;
-    mix_channel = (struct _Mix_Channel *) SDL_malloc(num_channels * sizeof(struct _Mix_Channel));
+static void _Mix_init_channel(int i)
+{
+    mix_channel(i).chunk = NULL;
+    mix_channel(i).playing = 0;
+    mix_channel(i).looping = 0;
+    mix_channel(i).volume = MIX_MAX_VOLUME;
+    mix_channel(i).fading = MIX_NO_FADING;
+    mix_channel(i).tag = -1;
+    mix_channel(i).group_next = -1;
+    mix_channel(i).expire = 0;
+    mix_channel(i).effects = NULL;
+    mix_channel(i).paused = 0;
+    mix_channel(i).active = -1;
+    mix_channel(i).start_frame = 0;
+    mix_channel(i).stream = NULL;
+    mix_channel(i).priority = 0;
+    mix_channel(i).done_pending = 0;
+    mix_channel(i).rate = MIX_RATE_ONE;
+    mix_channel(i).rate_pos = 0;
+    mix_channel(i).resampler = MIX_RESAMPLE_LINEAR;
+    mix_channel(i).send = 0.0f;
+    mix_channel(i).submix = MIX_BUS_MASTER;
+    mix_channel(i).reverse = 0;
+    /* The tile stays allocated for the channel's next loop */
+    mix_channel(i).tile_len = 0;
+}
 
-    /* Clear out the audio channels */
-    for (i=0; i<num_channels; ++i) {
-        mix_channel[i].chunk = NULL;
-        mix_channel[i].playing = 0;
-        mix_channel[i].looping = 0;
-        mix_channel[i].volume = SDL_MIX_MAXVOLUME;
-        mix_channel[i].fade_volume = SDL_MIX_MAXVOLUME;
-        mix_channel[i].fade_volume_reset = SDL_MIX_MAXVOLUME;
-        mix_channel[i].fading = MIX_NO_FADING;
-        mix_channel[i].tag = -1;
-        mix_channel[i].expire = 0;
-        mix_channel[i].effects = NULL;
-        mix_channel[i].paused = 0;
+/*
+ * rcg06122001 Cleanup effect callbacks.
+ *  MAKE SURE Mix_LockAudio() is called before this (or you're in the
+ *   audio callback).
+ */
+static void _Mix_channel_done_playing(int channel)
+{
+    if (mix_defer_done) {
+        mix_channel(channel).done_pending = 1;
+        return;
     }
-    Mix_VolumeMusic(SDL_MIX_MAXVOLUME);
 
-    _Mix_InitEffects();
+    if (channel_done_callback) {
+        channel_done_callback(channel);
+    }
 
-    add_chunk_decoder("WAVE");
-    add_chunk_decoder("AIFF");
-    add_chunk_decoder("VOC");
+    /*
+     * Call internal function directly, to avoid locking audio from
+     *   inside audio callback.
+     */
+    _Mix_remove_all_effects(channel, &mix_channel(channel).effects);
+    mix_channel(channel).send = 0.0f;
+    mix_channel(channel).reverse = 0;
+}
 
-    /* Initialize the music players */
-    open_music(&mixer);
 
-    audio_opened = 1;
-    SDL_PauseAudioDevice(audio_device, 0);
-    return(0);
+static void _Mix_free_scratch(mix_scratch *scratch)
+{
+    SDL_free(scratch->effects);
+    SDL_free(scratch->resampled);
+    SDL_free(scratch->resample_in);
+    SDL_free(scratch->resample_out);
+    SDL_free(scratch->effects_bus);
+    SDL_free(scratch->send);
+    SDL_free(scratch->submix);
+    SDL_zerop(scratch);
 }
 
-/* Open the mixer with a certain desired audio format */
-int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
+static int _Mix_alloc_scratch(mix_scratch *scratch)
 {
-    return Mix_OpenAudioDevice(frequency, format, nchannels, chunksize, NULL,
-                                SDL_AUDIO_ALLOW_FREQUENCY_CHANGE |
-                                SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+    scratch->effects = (Uint8 *)SDL_malloc(effect_scratch_len);
+    scratch->resampled = (Uint8 *)SDL_malloc(effect_scratch_len);
+    scratch->resample_in = (float *)SDL_malloc(resample_in_frames * mixer.channels * sizeof(float));
+    scratch->resample_out = (float *)SDL_malloc(mix_bus_samples * sizeof(float));
+    scratch->effects_bus = (float *)SDL_malloc(mix_bus_samples * sizeof(float));
+    scratch->send = (float *)SDL_malloc(mix_bus_samples * sizeof(float));
+    scratch->submix = NULL;
+    if (num_submixes > 0) {
+        scratch->submix = (float *)SDL_malloc(num_submixes * mix_bus_samples * sizeof(float));
+    }
+    if (!scratch->effects || !scratch->resampled ||
+        !scratch->resample_in || !scratch->resample_out ||
+        !scratch->effects_bus || !scratch->send ||
+        (num_submixes > 0 && !scratch->submix)) {
+        _Mix_free_scratch(scratch);
+        return -1;
+    }
+    return 0;
 }
 
-/* Dynamically change the number of channels managed by the mixer.
-   If decreasing the number of channels, the upper channels are
-   stopped.
- */
-int Mix_AllocateChannels(int numchans)
+/* 'scratch' is unused for MIX_CHANNEL_POST. The effects run up to, and
+   not including, 'stop', which may be NULL to run all of them. */
+static void *Mix_DoEffects(int chan, void *snd, int len, mix_scratch *scratch, effect_info *stop)
 {
-    if (numchans<0 || numchans==num_channels)
-        return(num_channels);
+    int posteffect = (chan == MIX_CHANNEL_POST);
+    effect_info *e = ((posteffect) ? posteffects : mix_channel(chan).effects);
+    void *buf = snd;
+    Uint64 start;
 
-    if (numchans < num_channels) {
-        /* Stop the affected channels */
-        int i;
-        for(i=numchans; i < num_channels; i++) {
-            Mix_UnregisterAllEffects(i);
-            Mix_HaltChannel(i);
-        }
+    /* Float effects are left for Mix_DoBusEffects() */
+    while (e != stop && e->callback == NULL) {
+        e = e->next;
     }
-    Mix_LockAudio();
-    mix_channel = (struct _Mix_Channel *) SDL_realloc(mix_channel, numchans * sizeof(struct _Mix_Channel));
-    if (numchans > num_channels) {
-        /* Initialize the new channels */
-        int i;
-        for(i=num_channels; i < numchans; i++) {
-            mix_channel[i].chunk = NULL;
-            mix_channel[i].playing = 0;
-            mix_channel[i].looping = 0;
-            mix_channel[i].volume = MIX_MAX_VOLUME;
-            mix_channel[i].fade_volume = MIX_MAX_VOLUME;
-            mix_channel[i].fade_volume_reset = MIX_MAX_VOLUME;
-            mix_channel[i].fading = MIX_NO_FADING;
-            mix_channel[i].tag = -1;
-            mix_channel[i].expire = 0;
-            mix_channel[i].effects = NULL;
-            mix_channel[i].paused = 0;
+    if (e != stop) {    /* are there any registered effects? */
+        start = _Mix_StatsBeginCallback();
+
+        /* if this is the postmix, we can just overwrite the original. */
+        if (!posteffect) {
+            if (len <= effect_scratch_len) {
+                buf = scratch->effects;
+            } else {
+                /* The callback never asks for more than mixer.size bytes */
+                buf = SDL_malloc(len);
+                if (buf == NULL) {
+                    return(snd);
+                }
+            }
+            /* The chunk is shared, so the first effect has to leave it be */
+            if (e->copy != NULL) {
+                e->copy(chan, snd, buf, len, e->udata);
+                e = e->next;
+            } else {
+                SDL_memcpy(buf, snd, len);
+            }
+        }
+
+        for (; e != stop; e = e->next) {
+            if (e->callback != NULL) {
+                e->callback(chan, buf, len, e->udata);
+            }
         }
+        _Mix_StatsAddEffects(start);
     }
-    num_channels = numchans;
-    Mix_UnlockAudio();
-    return(num_channels);
+
+    /* be sure to call Mix_FreeEffects() on the return value ... */
+    return(buf);
 }
 
-/* Return the actual mixer parameters */
-int Mix_QuerySpec(int *frequency, Uint16 *format, int *channels)
+static void Mix_FreeEffects(void *buf, void *snd, mix_scratch *scratch)
 {
-    if (audio_opened) {
-        if (frequency) {
-            *frequency = mixer.freq;
+    if (buf != snd && buf != scratch->effects) {
+        SDL_free(buf);
+    }
+}
+
+static SDL_bool _Mix_has_bus_effects(const effect_info *e)
+{
+    for (; e != NULL; e = e->next) {
+        if (e->bus != NULL) {
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
+
+/* Run the float effects of a channel, or of MIX_CHANNEL_POST, over 'buf' */
+static void Mix_DoBusEffects(int chan, float *buf, int samples)
+{
+    effect_info *e = (chan == MIX_CHANNEL_POST) ? posteffects : mix_channel(chan).effects;
+    Uint64 start = _Mix_StatsBeginCallback();
+
+    for (; e != NULL; e = e->next) {
+        if (e->bus != NULL) {
+            e->bus(chan, buf, samples, e->udata);
+        }
+    }
+    _Mix_StatsAddEffects(start);
+}
+
+
+/* Convert a fade length to sample frames of the device */
+static Uint32 _Mix_ms_to_frames(int ms)
+{
+    if (ms <= 0) {
+        return 0;
+    }
+    return (Uint32)(((Uint64)ms * mixer.freq) / 1000);
+}
+
+/* The fade level of a channel after 'pos' frames of its fade */
+static float _Mix_channel_fade_gain(int which, Uint32 pos)
+{
+    const Uint32 frames = mix_channel(which).fade_frames;
+    float level;
+
+    if (pos >= frames) {
+        level = 1.0f;
+    } else {
+        level = (float)pos / frames;
+    }
+    if (mix_channel(which).fading == MIX_FADING_OUT) {
+        level = 1.0f - level;
+    }
+    return level;
+}
+
+/* Move the fade of a channel on by 'frames' frames. Returns the gain of
+   the first of those frames, with 'gain' folded in, and sets 'step' to
+   how much it changes per frame. */
+static float _Mix_channel_fade_ramp(int which, int frames, float gain, float *step)
+{
+    const float gain0 = gain * _Mix_channel_fade_gain(which, mix_channel(which).fade_pos);
+    const float gain1 = gain * _Mix_channel_fade_gain(which, mix_channel(which).fade_pos + frames);
+
+    *step = (frames > 0) ? (gain1 - gain0) / frames : 0.0f;
+    mix_channel(which).fade_pos += frames;
+    return gain0;
+}
+
+/* The last effect of a channel, if it's a gain effect that has handed
+   over its gains for the next 'frames' frames */
+static effect_info *_Mix_channel_gain_effect(int i, int frames, float *gains, float *steps)
+{
+    effect_info *e = mix_channel(i).effects;
+
+    if (e == NULL || frames <= 0 || mixer.channels > MIX_MAX_GAIN_CHANNELS) {
+        return NULL;
+    }
+    while (e->next != NULL) {
+        e = e->next;
+    }
+    if (e->gains == NULL || !e->gains(i, frames, gains, steps, e->udata)) {
+        return NULL;
+    }
+    return e;
+}
+
+/* Where channel 'i' mixes to, at the same offset as 'bus' */
+static float *_Mix_channel_bus(int i, float *bus, mix_scratch *scratch)
+{
+    const int k = mix_channel(i).submix;
+
+    if (k == MIX_BUS_MASTER) {
+        return bus;
+    }
+    return scratch->submix + k * mix_bus_samples + (bus - scratch->bus);
+}
+
+/* Scale a piece of a channel's samples and add it to the bus, applying
+   the channel's effects and fade. Returns how many bytes were mixed, which
+   is less than 'mixable' if the fade ends first. */
+static int _Mix_channel_mix(int i, float *bus, Uint8 *samples, int mixable, mix_scratch *scratch)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    const int frame_size = sample_size * mixer.channels;
+    int volume = (mix_channel(i).volume*mix_channel(i).chunk->volume) / MIX_MAX_VOLUME;
+    float gain = (float)volume / MIX_MAX_VOLUME;
+    const float send = mix_send_effect ? mix_channel(i).send : 0.0f;
+    float *send_bus = scratch->send + (bus - scratch->bus);
+    float *out = _Mix_channel_bus(i, bus, scratch);
+    const SDL_bool floats = _Mix_has_bus_effects(mix_channel(i).effects);
+    const SDL_bool reverse = (mix_channel(i).reverse && mixer.channels == 2);
+    float gains[MIX_MAX_GAIN_CHANNELS], steps[MIX_MAX_GAIN_CHANNELS];
+    effect_info *fused;
+    Uint8 *mix_input;
+    const Uint8 *src;
+    SDL_AudioFormat src_format;
+    int count, c;
+
+    if (mix_channel(i).fading != MIX_NO_FADING) {
+        /* Don't let a single piece run past the end of the fade */
+        Uint32 left = mix_channel(i).fade_frames - mix_channel(i).fade_pos;
+        if ((Uint32)(mixable / frame_size) > left) {
+            mixable = (int)left * frame_size;
+        }
+    }
+
+    /* A gain effect at the end of the chain is folded into the mix, unless
+       its gains would have to ramp along with a fade or float effects
+       come after it */
+    fused = NULL;
+    if (mix_channel(i).fading == MIX_NO_FADING && !floats) {
+        fused = _Mix_channel_gain_effect(i, mixable / frame_size, gains, steps);
+    }
+    mix_input = Mix_DoEffects(i, samples, mixable, scratch, fused);
+    count = mixable / sample_size;
+    src = mix_input;
+    src_format = mixer.format;
+    if (floats) {
+        _Mix_BusLoad(scratch->effects_bus, mix_input, mixer.format, count);
+        Mix_DoBusEffects(i, scratch->effects_bus, count);
+        src = (const Uint8 *)scratch->effects_bus;
+        src_format = AUDIO_F32SYS;
+    }
+
+    /* The send gets the same gains, so it's after the fade and panning */
+    if (reverse) {
+        /* Swapping the sides costs nothing on top of the per-channel gains */
+        if (mix_channel(i).fading != MIX_NO_FADING) {
+            float step;
+            gain = _Mix_channel_fade_ramp(i, mixable / frame_size, gain, &step);
+            gains[0] = gains[1] = gain;
+            steps[0] = steps[1] = step;
+        } else if (fused) {
+            for (c = 0; c < 2; ++c) {
+                gains[c] *= gain;
+                steps[c] *= gain;
+            }
+        } else {
+            gains[0] = gains[1] = gain;
+            steps[0] = steps[1] = 0.0f;
+        }
+        _Mix_BusMixGainsSwapped(out, src, src_format, count, gains, steps);
+        if (send > 0.0f) {
+            for (c = 0; c < 2; ++c) {
+                gains[c] *= send;
+                steps[c] *= send;
+            }
+            _Mix_BusMixGainsSwapped(send_bus, src, src_format, count, gains, steps);
+        }
+    } else if (mix_channel(i).fading != MIX_NO_FADING) {
+        float step;
+        float gain0 = _Mix_channel_fade_ramp(i, mixable / frame_size, gain, &step);
+        _Mix_BusMixRamp(out, src, src_format, count, mixer.channels, gain0, step);
+        if (send > 0.0f) {
+            _Mix_BusMixRamp(send_bus, src, src_format, count, mixer.channels, gain0 * send, step * send);
+        }
+    } else if (fused) {
+        for (c = 0; c < mixer.channels; ++c) {
+            gains[c] *= gain;
+            steps[c] *= gain;
+        }
+        _Mix_BusMixGains(out, src, src_format, count, mixer.channels, gains, steps);
+        if (send > 0.0f) {
+            for (c = 0; c < mixer.channels; ++c) {
+                gains[c] *= send;
+                steps[c] *= send;
+            }
+            _Mix_BusMixGains(send_bus, src, src_format, count, mixer.channels, gains, steps);
+        }
+    } else {
+        _Mix_BusMix(out, src, src_format, count, gain);
+        if (send > 0.0f) {
+            _Mix_BusMix(send_bus, src, src_format, count, gain * send);
+        }
+    }
+    Mix_FreeEffects(mix_input, samples, scratch);
+
+    return mixable;
+}
+
+/* Wrap up the fade of a channel once it has been mixed all the way */
+static void _Mix_channel_end_fade(int i)
+{
+    if (mix_channel(i).fading != MIX_NO_FADING &&
+        mix_channel(i).fade_pos >= mix_channel(i).fade_frames) {
+        if (mix_channel(i).fading == MIX_FADING_OUT) {
+            mix_channel(i).playing = 0;
+            mix_channel(i).looping = 0;
+            mix_channel(i).expire = 0;
+        }
+        mix_channel(i).fading = MIX_NO_FADING;
+    }
+}
+
+/* Decode the next ring full of a streamed chunk, SDL_FALSE if there's none */
+static SDL_bool _Mix_stream_refill(Mix_ChunkStream *stream)
+{
+    const int frame_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * mixer.channels;
+    int left;
+
+    MIX_TRACE_DECODE(stream->interface->type);
+    left = stream->interface->GetAudio(stream->context, stream->ring, stream->size);
+    MIX_TRACE_END();
+
+    if (left > 0) {
+        stream->done = SDL_TRUE;
+    } else if (stream->interface->IsPlaying) {
+        stream->done = !stream->interface->IsPlaying(stream->context);
+    }
+    if (left < 0) {
+        /* Decoding error, treat it as the end */
+        stream->done = SDL_TRUE;
+        left = stream->size;
+    }
+    stream->pos = 0;
+    stream->fill = (stream->size - left) - (stream->size - left) % frame_size;
+    return (stream->fill > 0) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Mix a channel playing a streamed chunk, decoding it as needed */
+static void _Mix_mix_stream_channel(int i, float *bus, int index, int len, mix_scratch *scratch)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    Mix_ChunkStream *stream = mix_channel(i).stream;
+    int mixable;
+
+    while (mix_channel(i).playing > 0 && index < len) {
+        if (stream->pos == stream->fill) {
+            if (stream->done || !_Mix_stream_refill(stream)) {
+                mix_channel(i).playing = 0;
+                _Mix_channel_done_playing(i);
+                break;
+            }
+        }
+
+        mixable = stream->fill - stream->pos;
+        if (mixable > len - index) {
+            mixable = len - index;
+        }
+        mixable = _Mix_channel_mix(i, bus + index / sample_size, stream->ring + stream->pos, mixable, scratch);
+        stream->pos += mixable;
+        index += mixable;
+
+        _Mix_channel_end_fade(i);
+        if (!mix_channel(i).playing) {
+            _Mix_channel_done_playing(i);
+        }
+    }
+}
+
+/* Bytes of samples a chunk plays for in the device format */
+static Uint32 _Mix_chunk_length(const Mix_Chunk *chunk)
+{
+    if (chunk->allocated == MIX_CHUNK_ADPCM) {
+        return _Mix_ADPCMLength(chunk);
+    }
+    return chunk->alen;
+}
+
+/* Get 'frames' frames of a chunk from frame 'frame' on as floats */
+static void _Mix_chunk_load(const Mix_Chunk *chunk, Uint32 frame, int frames, float *dst)
+{
+    const int frame_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * mixer.channels;
+
+    if (chunk->allocated == MIX_CHUNK_ADPCM) {
+        _Mix_ADPCMDecode(chunk, frame, frames, dst);
+    } else {
+        _Mix_BusLoad(dst, chunk->abuf + frame * frame_size, mixer.format, frames * mixer.channels);
+    }
+}
+
+/* Mix a piece of a channel that has to be decoded or resampled first, see
+   Mix_LoadWAVCompressed_RW() and Mix_SetChannelRate().
+   Returns how many bytes of the 'len' left in the buffer were mixed. */
+static int _Mix_channel_mix_decoded(int i, float *bus, int len, mix_scratch *scratch)
+{
+    const int channels = mixer.channels;
+    const int frame_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * channels;
+    const Mix_Chunk *chunk = mix_channel(i).chunk;
+    const Uint32 step = mix_channel(i).rate;
+    const Uint32 pos = mix_channel(i).rate_pos;
+    float *in = scratch->resample_in;
+    Uint32 frame;
+    int frames, src_frames, last, count, k, mixable;
+    Uint64 end;
+
+    src_frames = mix_channel(i).playing / frame_size;
+    if (src_frames == 0) {
+        /* Not even a frame left to interpolate from */
+        mix_channel(i).playing = 0;
+        mix_channel(i).looping = 0;
+        return 0;
+    }
+    frame = (_Mix_chunk_length(chunk) - mix_channel(i).playing) / frame_size;
+
+    /* Stop where the chunk or this buffer runs out */
+    frames = len / frame_size;
+    end = (((Uint64)src_frames << 16) - pos + step - 1) / step;
+    if ((Uint64)frames > end) {
+        frames = (int)end;
+    }
+
+    if (step == MIX_RATE_ONE) {
+        _Mix_chunk_load(chunk, frame, frames, scratch->resample_out);
+    } else {
+        /* ... or the input scratch */
+        end = (((Uint64)(resample_in_frames - 4) << 16) - pos) / step + 1;
+        if ((Uint64)frames > end) {
+            frames = (int)end;
+        }
+
+        /* The interpolation reads one frame before the first and two after
+           the last, the edges of the chunk are repeated for those */
+        last = (int)((pos + (Uint64)(frames - 1) * step) >> 16);
+        count = SDL_min(last + 3, src_frames);
+        if (frame > 0) {
+            _Mix_chunk_load(chunk, frame - 1, count + 1, in);
+        } else {
+            _Mix_chunk_load(chunk, frame, count, in + channels);
+            SDL_memcpy(in, in + channels, channels * sizeof(float));
+        }
+        for (k = count; k < last + 3; ++k) {
+            SDL_memcpy(in + (k + 1) * channels, in + k * channels, channels * sizeof(float));
+        }
+
+        _Mix_BusResample(scratch->resample_out, in, channels, frames, pos, step,
+                         mix_channel(i).resampler == MIX_RESAMPLE_CUBIC);
+    }
+    _Mix_BusStore(scratch->resampled, scratch->resample_out, mixer.format, frames * channels);
+    mixable = _Mix_channel_mix(i, bus, scratch->resampled, frames * frame_size, scratch);
+
+    /* Move through the chunk by however much ended up being mixed */
+    end = pos + (Uint64)(mixable / frame_size) * step;
+    k = (int)SDL_min(end >> 16, (Uint64)src_frames);
+    if (chunk->allocated != MIX_CHUNK_ADPCM) {
+        mix_channel(i).samples += k * frame_size;
+    }
+    mix_channel(i).playing -= k * frame_size;
+    mix_channel(i).rate_pos = (Uint32)(end & 0xFFFF);
+    return mixable;
+}
+
+/* Mix a piece of a channel looping a chunk shorter than a buffer, straight
+   from its tile so that one or two pieces fill the buffer.  Returns how
+   many bytes of the 'len' left in the buffer were mixed. */
+static int _Mix_channel_mix_tiled(int i, float *bus, int len, mix_scratch *scratch)
+{
+    const Uint32 alen = mix_channel(i).chunk->alen;
+    const Uint32 offset = alen - (Uint32)mix_channel(i).playing;
+    Uint64 left = (Uint64)mix_channel(i).playing;
+    Uint32 pos, wraps;
+    int mixable;
+
+    /* No further than the tile goes, or than the loops left play */
+    if (mix_channel(i).looping < 0) {
+        left = mix_channel(i).tile_len;
+    } else {
+        left += (Uint64)mix_channel(i).looping * alen;
+    }
+    mixable = (int)(mix_channel(i).tile_len - offset);
+    if ((Uint64)mixable > left) {
+        mixable = (int)left;
+    }
+    if (mixable > len) {
+        mixable = len;
+    }
+    mixable = _Mix_channel_mix(i, bus, mix_channel(i).tile + offset, mixable, scratch);
+
+    /* Back to a place in the chunk itself, counting the loops passed */
+    pos = offset + (Uint32)mixable;
+    wraps = pos / alen;
+    pos %= alen;
+    if (wraps > 0 && pos == 0) {
+        /* At the end of a repetition, which restarts as it always has */
+        --wraps;
+        pos = alen;
+    }
+    if (mix_channel(i).looping > 0) {
+        mix_channel(i).looping -= (int)wraps;
+    }
+    mix_channel(i).samples = mix_channel(i).chunk->abuf + pos;
+    mix_channel(i).playing = (int)(alen - pos);
+    return mixable;
+}
+
+/* Mix 'len' bytes of a playing channel into 'bus', from byte 'index' on */
+static void _Mix_mix_channel(int i, float *bus, int index, int len, mix_scratch *scratch)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    int mixable;
+
+    /* A done callback of a channel mixed before may have halted this one */
+    if (mix_channel(i).active < 0 || mix_channel(i).playing <= 0) {
+        return;
+    }
+
+    if (mix_channel(i).stream) {
+        _Mix_mix_stream_channel(i, bus, index, len, scratch);
+    } else while (index < len) {
+        if (mix_channel(i).playing <= 0) {
+            /* At the end of the sample, start it over if looping */
+            if (!mix_channel(i).looping) {
+                break;
+            }
+            if (mix_channel(i).looping > 0) {
+                --mix_channel(i).looping;
+            }
+            mix_channel(i).samples = mix_channel(i).chunk->abuf;
+            mix_channel(i).playing = _Mix_chunk_length(mix_channel(i).chunk);
+        }
+
+        if (mix_channel(i).rate != MIX_RATE_ONE || mix_channel(i).chunk->allocated == MIX_CHUNK_ADPCM) {
+            mixable = _Mix_channel_mix_decoded(i, bus + index / sample_size, len - index, scratch);
+        } else if (mix_channel(i).tile_len > 0) {
+            mixable = _Mix_channel_mix_tiled(i, bus + index / sample_size, len - index, scratch);
+        } else {
+            mixable = mix_channel(i).playing;
+            if (mixable > len - index) {
+                mixable = len - index;
+            }
+            mixable = _Mix_channel_mix(i, bus + index / sample_size, mix_channel(i).samples, mixable, scratch);
+
+            mix_channel(i).samples += mixable;
+            mix_channel(i).playing -= mixable;
+        }
+        index += mixable;
+
+        _Mix_channel_end_fade(i);
+
+        /* rcg06072001 Alert app if channel is done playing. */
+        if (!mix_channel(i).playing && !mix_channel(i).looping) {
+            _Mix_channel_done_playing(i);
+        }
+    }
+
+    /* Keep 'playing' set while the sample loops across buffers */
+    if (! mix_channel(i).playing && mix_channel(i).looping) {
+        if (mix_channel(i).looping > 0) {
+            --mix_channel(i).looping;
+        }
+        mix_channel(i).samples = mix_channel(i).chunk->abuf;
+        mix_channel(i).playing = _Mix_chunk_length(mix_channel(i).chunk);
+    }
+}
+
+/* Silence the first 'samples' samples of each of a thread's submixes */
+static void _Mix_clear_submixes(mix_scratch *scratch, int samples)
+{
+    int k;
+
+    for (k = 0; k < num_submixes; ++k) {
+        SDL_memset(scratch->submix + k * mix_bus_samples, 0, samples * sizeof(float));
+    }
+}
+
+/* Run the effects of submix bus 'bus' over 'buf' in the order they were
+   registered, converting for the ones that work in the device format */
+static void _Mix_submix_effects(int bus, float *buf, int samples)
+{
+    const int chan = MIX_BUS_CHANNEL(bus);
+    const int len = samples * (SDL_AUDIO_BITSIZE(mixer.format) / 8);
+    Uint8 *stream = audio_scratch.effects;
+    SDL_bool floats = SDL_TRUE;
+    effect_info *e = submixes[bus].effects;
+    Uint64 start;
+
+    if (e == NULL) {
+        return;
+    }
+    start = _Mix_StatsBeginCallback();
+    for (; e != NULL; e = e->next) {
+        if (e->bus != NULL) {
+            if (!floats) {
+                _Mix_BusLoad(buf, stream, mixer.format, samples);
+                floats = SDL_TRUE;
+            }
+            e->bus(chan, buf, samples, e->udata);
+        } else {
+            if (floats) {
+                _Mix_BusStore(stream, buf, mixer.format, samples);
+                floats = SDL_FALSE;
+            }
+            e->callback(chan, stream, len, e->udata);
+        }
+    }
+    if (!floats) {
+        _Mix_BusLoad(buf, stream, mixer.format, samples);
+    }
+    _Mix_StatsAddEffects(start);
+}
+
+/* Put each submix bus through its effects and add it into mix_bus */
+static void _Mix_mix_submixes(int samples)
+{
+    const int frames = samples / mixer.channels;
+    mix_submix *sub;
+    float *buf, gain, step;
+    int k;
+
+    for (k = 0; k < num_submixes; ++k) {
+        sub = &submixes[k];
+        buf = audio_scratch.submix + k * mix_bus_samples;
+        gain = (float)sub->volume / MIX_MAX_VOLUME;
+
+        _Mix_submix_effects(k, buf, samples);
+        if (gain != sub->gain && frames > 0) {
+            step = (gain - sub->gain) / frames;
+            _Mix_BusMixRamp(mix_bus, (const Uint8 *)buf, AUDIO_F32SYS, samples, mixer.channels, sub->gain, step);
+            sub->gain = gain;
+        } else if (gain > 0.0f) {
+            _Mix_BusMix(mix_bus, (const Uint8 *)buf, AUDIO_F32SYS, samples, gain);
+        }
+    }
+}
+
+static int SDLCALL _Mix_mix_worker(void *data)
+{
+    const int owner = (int)((mix_worker *)data - mix_workers) + 1;
+    mix_worker *worker = (mix_worker *)data;
+    const int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    int n;
+
+    for (;;) {
+        SDL_SemWait(worker->go);
+        if (mix_workers_quit) {
+            break;
+        }
+        SDL_memset(worker->bus, 0, (mix_len / sample_size) * sizeof(float));
+        if (mix_send_effect) {
+            SDL_memset(worker->scratch.send, 0, (mix_len / sample_size) * sizeof(float));
+        }
+        _Mix_clear_submixes(&worker->scratch, mix_len / sample_size);
+        for (n = 0; n < num_mix_jobs; ++n) {
+            if (mix_jobs[n].owner == owner) {
+                _Mix_mix_channel(mix_jobs[n].channel, worker->bus, mix_jobs[n].offset, mix_len, &worker->scratch);
+            }
+        }
+        SDL_SemPost(mix_workers_done);
+    }
+    return 0;
+}
+
+/* Share mix_jobs out between the audio thread and the workers */
+static void _Mix_mix_parallel(int len)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    int n, w, k, next = 0;
+
+    for (n = 0; n < num_mix_jobs; ++n) {
+        if (mix_channel(mix_jobs[n].channel).stream) {
+            /* Decoders are only ever run from the audio thread */
+            mix_jobs[n].owner = 0;
+        } else {
+            mix_jobs[n].owner = next;
+            next = (next + 1) % (num_mix_workers + 1);
+        }
+    }
+
+    mix_len = len;
+    mix_defer_done = SDL_TRUE;
+    for (w = 0; w < num_mix_workers; ++w) {
+        SDL_SemPost(mix_workers[w].go);
+    }
+    for (n = 0; n < num_mix_jobs; ++n) {
+        if (mix_jobs[n].owner == 0) {
+            _Mix_mix_channel(mix_jobs[n].channel, mix_bus, mix_jobs[n].offset, len, &audio_scratch);
+        }
+    }
+    for (w = 0; w < num_mix_workers; ++w) {
+        SDL_SemWait(mix_workers_done);
+    }
+    mix_defer_done = SDL_FALSE;
+
+    /* Always sum in the same order, so the output doesn't depend on timing */
+    for (w = 0; w < num_mix_workers; ++w) {
+        _Mix_BusMix(mix_bus, (const Uint8 *)mix_workers[w].bus, AUDIO_F32SYS, len / sample_size, 1.0f);
+        if (mix_send_effect) {
+            _Mix_BusMix(audio_scratch.send, (const Uint8 *)mix_workers[w].scratch.send,
+                        AUDIO_F32SYS, len / sample_size, 1.0f);
+        }
+        for (k = 0; k < num_submixes; ++k) {
+            _Mix_BusMix(audio_scratch.submix + k * mix_bus_samples,
+                        (const Uint8 *)(mix_workers[w].scratch.submix + k * mix_bus_samples),
+                        AUDIO_F32SYS, len / sample_size, 1.0f);
+        }
+    }
+}
+
+/* Stop the mixing workers, with the audio callback not running */
+static void _Mix_StopMixWorkers(void)
+{
+    int w;
+
+    mix_workers_quit = SDL_TRUE;
+    for (w = 0; w < num_mix_workers; ++w) {
+        SDL_SemPost(mix_workers[w].go);
+    }
+    for (w = 0; w < num_mix_workers; ++w) {
+        SDL_WaitThread(mix_workers[w].thread, NULL);
+        SDL_DestroySemaphore(mix_workers[w].go);
+        SDL_free(mix_workers[w].bus);
+        _Mix_free_scratch(&mix_workers[w].scratch);
+    }
+    num_mix_workers = 0;
+    mix_workers_quit = SDL_FALSE;
+    if (mix_workers_done) {
+        SDL_DestroySemaphore(mix_workers_done);
+        mix_workers_done = NULL;
+    }
+}
+
+/* Start mix_threads_wanted workers for the open device */
+static int _Mix_StartMixWorkers(void)
+{
+    mix_worker *worker;
+
+    if (mix_threads_wanted == 0) {
+        return 0;
+    }
+    mix_workers_done = SDL_CreateSemaphore(0);
+    if (!mix_workers_done) {
+        return -1;
+    }
+    while (num_mix_workers < mix_threads_wanted) {
+        worker = &mix_workers[num_mix_workers];
+        worker->go = SDL_CreateSemaphore(0);
+        worker->bus = (float *)SDL_malloc(mix_bus_samples * sizeof(float));
+        worker->thread = NULL;
+        if (_Mix_alloc_scratch(&worker->scratch) == 0 && worker->go && worker->bus) {
+            worker->scratch.bus = worker->bus;
+            worker->thread = SDL_CreateThread(_Mix_mix_worker, "SDL_mixer worker", worker);
+        }
+        if (!worker->thread) {
+            if (worker->go) {
+                SDL_DestroySemaphore(worker->go);
+            }
+            SDL_free(worker->bus);
+            _Mix_free_scratch(&worker->scratch);
+            _Mix_StopMixWorkers();
+            Mix_SetError("Couldn't start the mixing threads");
+            return -1;
+        }
+        ++num_mix_workers;
+    }
+    return 0;
+}
+
+/* Nothing can make a sound until the game does something: no channel is
+   playing or paused, no music, no hooks and no commands waiting.  A reverb
+   tail rings on idle until the output is suspended, so it's cut short only
+   if Mix_SetAutoSuspend() was given less time than the tail.
+ */
+static SDL_bool _Mix_OutputIdle(void)
+{
+    return (num_active == 0 && music_idle() &&
+            mix_music == music_mixer && mix_music_float == NULL &&
+            mix_postmix == NULL && mix_postmix_float == NULL &&
+            !_Mix_CommandsPending());
+}
+
+/* Called from the audio callback, with the audio lock held */
+static void _Mix_SuspendOutput(void)
+{
+    /* Flagged before taking a last look at the command queue, which the
+       game posts to without the lock: either this sees the command, or
+       the game sees the flag and wakes the output */
+    SDL_AtomicSet(&output_suspended, 1);
+    if (!_Mix_OutputIdle()) {
+        SDL_AtomicSet(&output_suspended, 0);
+        return;
+    }
+
+    if (audio_native) {
+        _Mix_OpenSLES_Suspend();
+    } else {
+        /* SDL's device lock is recursive, so this is allowed from here */
+        SDL_PauseAudioDevice(audio_device, 1);
+    }
+    _Mix_StatsSuspended();
+}
+
+void _Mix_WakeOutput(void)
+{
+    if (!SDL_AtomicGet(&output_suspended) || SDL_AtomicGet(&output_paused)) {
+        return;
+    }
+
+    Mix_LockAudio();
+    if (SDL_AtomicGet(&output_suspended) && !SDL_AtomicGet(&output_paused)) {
+        idle_frames = 0;
+        if (audio_native) {
+            _Mix_OpenSLES_Resume();
+        } else {
+            SDL_PauseAudioDevice(audio_device, 0);
+        }
+        SDL_AtomicSet(&output_suspended, 0);
+    }
+    Mix_UnlockAudio();
+}
+
+/* Mixing function */
+static void SDLCALL
+mix_channels(void *udata, Uint8 *stream, int len)
+{
+    int i, n, count;
+    Uint32 sdl_ticks;
+    int sample_size = SDL_AUDIO_BITSIZE(mixer.format) / 8;
+    int frame_size = sample_size * mixer.channels;
+    Uint64 start = _Mix_StatsBeginCallback();
+    SDL_bool post_floats = _Mix_has_bus_effects(posteffects);
+    int mixed = 0;
+
+    MIX_TRACE_BEGIN("mix_channels");
+    /* The device's thread is only known from in here */
+    if (thread_policy_pending) {
+        thread_policy_pending = SDL_FALSE;
+        _Mix_StatsSetThreadPriority(_Mix_ApplyThreadPolicy(thread_priority, thread_cpu_mask));
+    }
+
+#if SDL_VERSION_ATLEAST(1, 3, 0)
+    /* Need to initialize the stream in SDL 1.3+ */
+    SDL_memset(stream, mixer.silence, len);
+#endif
+
+    /* Apply anything the game thread queued up since the last callback */
+    _Mix_DrainCommands();
+
+    /* Mix the music (must be done before the channels are added), a float
+       hook goes straight into its bus below */
+    if (!mix_music_float) {
+        mix_music(music_data, stream, len);
+    }
+
+    /* SDL always asks for exactly mixer.size bytes, which the bus covers */
+    if (len > mix_bus_samples * sample_size) {
+        len = mix_bus_samples * sample_size;
+    }
+
+    /* Mix any playing channels...
+       Work from a snapshot: a channel done callback may start or halt
+       channels, which shuffles the active list. */
+    count = num_active;
+    SDL_memcpy(mix_order, active_channels, count * sizeof(int));
+    sdl_ticks = _Mix_GetTicks();
+    for (n=0; n<count; ++n) {
+        int offset = 0;
+
+        i = mix_order[n];
+        if (mix_channel(i).active < 0) {
+            continue;
+        }
+        if (!mix_channel(i).paused) {
+            if (mix_channel(i).start_frame > mix_output_frame) {
+                /* Scheduled with Mix_PlayChannelAt(), see if it starts in this buffer */
+                Uint64 delay = mix_channel(i).start_frame - mix_output_frame;
+                if (delay >= (Uint64)(len / frame_size)) {
+                    continue;
+                }
+                offset = (int)delay * frame_size;
+            }
+            mix_channel(i).start_frame = 0;
+
+            if (mix_channel(i).expire > 0 && mix_channel(i).expire < sdl_ticks) {
+                /* Expiration delay for that channel is reached */
+                mix_channel(i).playing = 0;
+                mix_channel(i).looping = 0;
+                mix_channel(i).fading = MIX_NO_FADING;
+                mix_channel(i).expire = 0;
+                _Mix_channel_done_playing(i);
+            }
+            if (mix_channel(i).playing > 0) {
+                /* Mixed below, once all the channels are known */
+                mix_jobs[num_mix_jobs].channel = i;
+                mix_jobs[num_mix_jobs].offset = offset;
+                ++num_mix_jobs;
+                continue;
+            }
+        }
+        if (mix_channel(i).playing <= 0 && !mix_channel(i).looping) {
+            _Mix_channel_deactivate(i);
+        }
+    }
+
+    /* A send effect has to run on, for the tail of a reverb, and so do the
+       effects on the submix buses.  Analysis measures the bus even with
+       only music playing, and the float hooks need the bus for theirs. */
+    if (num_mix_jobs > 0 || mix_send_effect || post_floats || num_submixes > 0 ||
+        _Mix_AnalysisActive() || mix_music_float || mix_postmix_float) {
+        /* The music is already in the stream, so it seeds its bus */
+        _Mix_clear_submixes(&audio_scratch, len / sample_size);
+        if (mix_music_float) {
+            SDL_memset(mix_bus, 0, (len / sample_size) * sizeof(float));
+            mix_music_float(music_data, (music_submix == MIX_BUS_MASTER) ? mix_bus :
+                            audio_scratch.submix + music_submix * mix_bus_samples,
+                            len / frame_size, mixer.channels);
+        } else if (music_submix == MIX_BUS_MASTER) {
+            _Mix_BusLoad(mix_bus, stream, mixer.format, len / sample_size);
+        } else {
+            SDL_memset(mix_bus, 0, (len / sample_size) * sizeof(float));
+            _Mix_BusLoad(audio_scratch.submix + music_submix * mix_bus_samples,
+                         stream, mixer.format, len / sample_size);
+        }
+        if (mix_send_effect) {
+            SDL_memset(audio_scratch.send, 0, (len / sample_size) * sizeof(float));
+        }
+        mixed = num_mix_jobs;
+
+        if (num_mix_workers > 0 && num_mix_jobs >= mix_threads_min_channels) {
+            _Mix_mix_parallel(len);
+        } else {
+            for (n=0; n<num_mix_jobs; ++n) {
+                _Mix_mix_channel(mix_jobs[n].channel, mix_bus, mix_jobs[n].offset, len, &audio_scratch);
+            }
+        }
+
+        for (n=0; n<num_mix_jobs; ++n) {
+            i = mix_jobs[n].channel;
+            if (mix_channel(i).done_pending) {
+                mix_channel(i).done_pending = 0;
+                _Mix_channel_done_playing(i);
+            }
+            if (mix_channel(i).active >= 0 &&
+                mix_channel(i).playing <= 0 && !mix_channel(i).looping) {
+                _Mix_channel_deactivate(i);
+            }
+        }
+        num_mix_jobs = 0;
+
+        _Mix_mix_submixes(len / sample_size);
+        if (mix_send_effect) {
+            mix_send_effect(audio_scratch.send, mix_bus, len / sample_size, mix_send_data);
+        }
+        if (post_floats) {
+            Mix_DoBusEffects(MIX_CHANNEL_POST, mix_bus, len / sample_size);
+        }
+        if (mix_postmix_float) {
+            mix_postmix_float(mix_postmix_float_data, mix_bus, len / frame_size, mixer.channels);
+        }
+        _Mix_AnalysisFeed(mix_bus, mixer.channels, len / frame_size, mixer.freq,
+                          mix_output_frame + len / frame_size);
+
+        /* Clip and convert to the device format once, after all channels */
+        _Mix_BusStore(stream, mix_bus, mixer.format, len / sample_size);
+    }
+    mix_output_frame += len / frame_size;
+
+    /* rcg06122001 run posteffects... */
+    Mix_DoEffects(MIX_CHANNEL_POST, stream, len, NULL, NULL);
+
+    if (mix_postmix) {
+        mix_postmix(mix_postmix_data, stream, len);
+    }
+
+    _Mix_StatsEndCallback(start, mixed, len / frame_size, mixer.freq);
+
+    if (suspend_after_ms > 0 && !audio_offline) {
+        if (!_Mix_OutputIdle()) {
+            idle_frames = 0;
+        } else {
+            idle_frames += len / frame_size;
+            if ((Uint64)idle_frames * 1000 >= (Uint64)suspend_after_ms * mixer.freq) {
+                _Mix_SuspendOutput();
+            }
+        }
+    }
+    MIX_TRACE_END();
+}
+
+/* Free everything allocated for the device in Mix_OpenAudioDevice() */
+static void _Mix_free_device_buffers(void)
+{
+    int i;
+
+    for (i = 0; i < num_channel_pages << MIX_CHANNEL_PAGE_SHIFT; ++i) {
+        SDL_free(mix_channel(i).tile);
+    }
+    for (i = 0; i < num_channel_pages; ++i) {
+        SDL_free(mix_channel_pages[i]);
+        mix_channel_pages[i] = NULL;
+    }
+    num_channel_pages = 0;
+    num_channels = 0;
+    max_channels = 0;
+    SDL_free(mix_groups);
+    mix_groups = NULL;
+    num_groups = 0;
+    max_groups = 0;
+    SDL_free(active_channels);
+    active_channels = NULL;
+    SDL_free(mix_order);
+    mix_order = NULL;
+    num_active = 0;
+    SDL_free(mix_jobs);
+    mix_jobs = NULL;
+    num_mix_jobs = 0;
+    _Mix_free_scratch(&audio_scratch);
+    effect_scratch_len = 0;
+    resample_in_frames = 0;
+    SDL_free(mix_bus);
+    mix_bus = NULL;
+    mix_bus_samples = 0;
+    for (i = 0; i < num_submixes; ++i) {
+        SDL_free(submixes[i].name);
+    }
+    SDL_free(submixes);
+    submixes = NULL;
+    num_submixes = 0;
+    music_submix = MIX_BUS_MASTER;
+}
+
+/* What a chunk from Mix_LoadWAV_RW() was loaded as, see _Mix_KeepChunkSource() */
+typedef struct _Mix_ChunkSource {
+    Mix_Chunk *chunk;
+    Uint8 *buf;             /* the samples as loaded, NULL while abuf is them */
+    Uint32 len;
+    Uint16 format;          /* the format of those samples */
+    Uint8 channels;
+    int freq;
+    Uint16 cvt_format;      /* the format abuf is in */
+    Uint8 cvt_channels;
+    int cvt_freq;
+    SDL_bool converting;    /* a thread is at it with the lock let go */
+    SDL_bool failed;        /* the converter threads leave it to Mix_PlayChannel() */
+    Uint32 last_used;       /* chunk_use_clock when it last played */
+    unsigned int serial;    /* names its file in the cache directory */
+    char *spill;            /* that file, once there was a need for it */
+    SDL_bool spill_valid;   /* the file holds abuf as it is now */
+    SDL_bool evicted;       /* abuf is only in the file, spill_len bytes of it */
+    Uint32 spill_len;
+    SDL_bool prefetch;      /* Mix_PrefetchChunk() wants it back */
+    SDL_bool pinned;        /* couldn't be written out, leave it be */
+    struct _Mix_ChunkSource *next;
+} Mix_ChunkSource;
+
+#define MIX_MAX_CONVERTERS 4
+
+static SDL_mutex *chunk_source_lock = NULL;
+static SDL_cond *chunk_source_cond = NULL;  /* a conversion finished */
+static Mix_ChunkSource *chunk_sources = NULL;
+static SDL_atomic_t chunk_sources_stale;    /* how many aren't in the device's format */
+static SDL_Thread *chunk_converters[MIX_MAX_CONVERTERS];
+static int num_converters = 0;
+static int converters_running = 0;
+static SDL_bool chunk_converters_quit = SDL_FALSE;
+
+/* See Mix_SetChunkBudget(), all of these are under chunk_source_lock */
+static Uint32 chunk_budget = 0;
+static Uint64 chunk_resident = 0;   /* bytes of samples the sources keep in memory */
+static Uint32 chunk_use_clock = 0;
+static unsigned int chunk_serial = 0;
+static Uint32 chunk_evictions = 0;
+static Uint32 chunk_restores = 0;
+static SDL_atomic_t chunk_sources_evicted;
+
+/* Bytes of memory a source holds now, what chunk_resident adds up */
+static Uint32 _Mix_chunk_source_bytes(const Mix_ChunkSource *src)
+{
+    return (src->evicted ? 0 : src->chunk->alen) + (src->buf ? src->len : 0);
+}
+
+static SDL_bool _Mix_chunk_over_budget(void)
+{
+    return (chunk_budget > 0 && chunk_resident > chunk_budget);
+}
+
+static SDL_bool _Mix_chunk_source_stale(const Mix_ChunkSource *src)
+{
+    return (src->cvt_format != mixer.format ||
+            src->cvt_channels != mixer.channels ||
+            src->cvt_freq != mixer.freq);
+}
+
+static void _Mix_WakeChunkWorkers(void);
+
+void _Mix_KeepChunkSource(Mix_Chunk *chunk, const SDL_AudioSpec *spec, Uint8 *source, Uint32 len)
+{
+    Mix_ChunkSource *src;
+
+    /* The lock comes with the first Mix_OpenAudio(), before any loader */
+    src = chunk_source_lock ? (Mix_ChunkSource *)SDL_malloc(sizeof(Mix_ChunkSource)) : NULL;
+    if (!src) {
+        SDL_free(source);
+        return;
+    }
+    src->chunk = chunk;
+    src->buf = source;
+    src->len = len;
+    src->format = spec->format;
+    src->channels = spec->channels;
+    src->freq = spec->freq;
+    src->cvt_format = mixer.format;
+    src->cvt_channels = mixer.channels;
+    src->cvt_freq = mixer.freq;
+    src->converting = SDL_FALSE;
+    src->failed = SDL_FALSE;
+    src->spill = NULL;
+    src->spill_valid = SDL_FALSE;
+    src->evicted = SDL_FALSE;
+    src->spill_len = 0;
+    src->prefetch = SDL_FALSE;
+    src->pinned = SDL_FALSE;
+
+    SDL_LockMutex(chunk_source_lock);
+    src->last_used = ++chunk_use_clock;
+    src->serial = ++chunk_serial;
+    src->next = chunk_sources;
+    chunk_sources = src;
+    chunk_resident += _Mix_chunk_source_bytes(src);
+    if (_Mix_chunk_over_budget()) {
+        _Mix_WakeChunkWorkers();
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+}
+
+/* MAKE SURE you hold chunk_source_lock, and that the chunk isn't playing.
+   The lock is let go while the samples are converted. */
+static int _Mix_ReconvertChunk(Mix_ChunkSource *src)
+{
+    Mix_Chunk *chunk = src->chunk;
+    const SDL_AudioSpec spec = mixer;
+    const Uint32 bytes = _Mix_chunk_source_bytes(src);
+    Uint8 *abuf;
+    Uint32 alen;
+
+    if (src->buf && src->format == spec.format &&
+        src->channels == spec.channels && src->freq == spec.freq) {
+        /* Back to the format it was loaded in */
+        abuf = src->buf;
+        alen = src->len;
+        src->buf = NULL;
+        SDL_free(chunk->abuf);
+    } else {
+        /* Always from the samples as loaded, never a conversion of a conversion */
+        const Uint8 *samples = src->buf ? src->buf : chunk->abuf;
+        const Uint32 len = src->buf ? src->len : chunk->alen;
+
+        src->converting = SDL_TRUE;
+        SDL_UnlockMutex(chunk_source_lock);
+        abuf = _Mix_ConvertAudio(samples, len, src->format, src->channels, src->freq,
+                                 spec.format, spec.channels, spec.freq, &alen);
+        SDL_LockMutex(chunk_source_lock);
+        src->converting = SDL_FALSE;
+        SDL_CondBroadcast(chunk_source_cond);
+        if (!abuf) {
+            src->failed = SDL_TRUE;
+            return(-1);
+        }
+        if (src->buf) {
+            SDL_free(chunk->abuf);
+        } else {
+            src->buf = chunk->abuf;
+            src->len = chunk->alen;
+        }
+    }
+    chunk->abuf = abuf;
+    chunk->alen = alen;
+    src->cvt_format = spec.format;
+    src->cvt_channels = spec.channels;
+    src->cvt_freq = spec.freq;
+    src->failed = SDL_FALSE;
+    src->spill_valid = SDL_FALSE;
+    chunk_resident = chunk_resident - bytes + _Mix_chunk_source_bytes(src);
+    SDL_AtomicAdd(&chunk_sources_stale, -1);
+    return(0);
+}
+
+/* Read an evicted chunk back from its file.
+   MAKE SURE you hold chunk_source_lock, it is let go while reading. */
+static int _Mix_RestoreChunk(Mix_ChunkSource *src)
+{
+    Uint8 *abuf;
+    SDL_RWops *rw;
+    SDL_bool ok;
+
+    src->converting = SDL_TRUE;
+    SDL_UnlockMutex(chunk_source_lock);
+    abuf = (Uint8 *)SDL_malloc(src->spill_len ? src->spill_len : 1);
+    rw = abuf ? SDL_RWFromFile(src->spill, "rb") : NULL;
+    ok = (rw && SDL_RWread(rw, abuf, 1, src->spill_len) == src->spill_len);
+    if (rw) {
+        SDL_RWclose(rw);
+    }
+    SDL_LockMutex(chunk_source_lock);
+    src->converting = SDL_FALSE;
+    src->prefetch = SDL_FALSE;
+    SDL_CondBroadcast(chunk_source_cond);
+    if (!ok) {
+        SDL_free(abuf);
+        Mix_SetError("Couldn't read back the evicted chunk from %s", src->spill);
+        return(-1);
+    }
+    /* It can't be playing, so nothing but the lock guards abuf */
+    src->chunk->abuf = abuf;
+    src->chunk->alen = src->spill_len;
+    src->evicted = SDL_FALSE;
+    chunk_resident += src->spill_len;
+    ++chunk_restores;
+    SDL_AtomicAdd(&chunk_sources_evicted, -1);
+    return(0);
+}
+
+/* Write the least recently played of the chunks that aren't playing out to
+   its file and free its samples.  Returns 0 if there was none left to
+   evict.  Takes the audio lock before chunk_source_lock, the same order as
+   a Mix_PlayChannel() from the callback, and holds neither while writing.
+ */
+static int _Mix_EvictChunk(void)
+{
+    Mix_ChunkSource *src, *victim = NULL;
+    Mix_Chunk *chunk;
+    Uint8 *abuf = NULL;
+    Uint32 alen = 0;
+    SDL_RWops *rw;
+    SDL_bool written;
+
+    Mix_LockAudio();
+    SDL_LockMutex(chunk_source_lock);
+    if (_Mix_chunk_over_budget()) {
+        for (src = chunk_sources; src; src = src->next) {
+            if (src->converting || src->evicted || src->pinned ||
+                src->chunk->allocated != 1 || src->chunk->alen == 0) {
+                continue;
+            }
+            if (victim && (Sint32)(src->last_used - victim->last_used) >= 0) {
+                continue;
+            }
+            if (!_Mix_chunk_in_use(src->chunk)) {
+                victim = src;
+            }
+        }
+    }
+    if (victim && !victim->spill) {
+        char name[32];
+        SDL_snprintf(name, sizeof(name), "evicted-%u", victim->serial);
+        victim->spill = _Mix_CacheFilePath(name, ".pcm");
+        if (!victim->spill) {
+            /* No cache directory, nowhere to put any of them */
+            victim = NULL;
+        }
+    }
+    if (victim) {
+        /* Nothing can start it while abuf is NULL, see _Mix_chunk_may_start() */
+        chunk = victim->chunk;
+        abuf = chunk->abuf;
+        alen = chunk->alen;
+        chunk->abuf = NULL;
+        chunk->alen = 0;
+        victim->converting = SDL_TRUE;
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+    Mix_UnlockAudio();
+    if (!victim) {
+        return 0;
+    }
+
+    written = victim->spill_valid;
+    if (!written) {
+        rw = SDL_RWFromFile(victim->spill, "wb");
+        written = (rw && SDL_RWwrite(rw, abuf, 1, alen) == alen);
+        if (rw && SDL_RWclose(rw) < 0) {
+            written = SDL_FALSE;
+        }
+    }
+
+    SDL_LockMutex(chunk_source_lock);
+    victim->converting = SDL_FALSE;
+    SDL_CondBroadcast(chunk_source_cond);
+    if (written) {
+        SDL_free(abuf);
+        chunk_resident -= alen;
+        victim->evicted = SDL_TRUE;
+        victim->spill_valid = SDL_TRUE;
+        ++chunk_evictions;
+        SDL_AtomicAdd(&chunk_sources_evicted, 1);
+        victim->spill_len = alen;
+        if (victim->buf) {
+            /* Converting again will have to do with the samples as they are */
+            chunk_resident -= victim->len;
+            SDL_free(victim->buf);
+            victim->buf = NULL;
+            victim->format = victim->cvt_format;
+            victim->channels = victim->cvt_channels;
+            victim->freq = victim->cvt_freq;
+        }
+    } else {
+        victim->chunk->abuf = abuf;
+        victim->chunk->alen = alen;
+        victim->pinned = SDL_TRUE;
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+    return 1;
+}
+
+/* Bring a chunk loaded for another device format up to date before it plays */
+static int _Mix_PrepareChunk(Mix_Chunk *chunk)
+{
+    Mix_ChunkSource *src;
+    int retval = 0;
+
+    /* Without a budget nothing needs to know which chunks are played */
+    if (SDL_AtomicGet(&chunk_sources_stale) == 0 && chunk_budget == 0 &&
+        SDL_AtomicGet(&chunk_sources_evicted) == 0) {
+        return(0);
+    }
+    SDL_LockMutex(chunk_source_lock);
+    for (src = chunk_sources; src; src = src->next) {
+        if (src->chunk == chunk) {
+            while (src->converting) {
+                SDL_CondWait(chunk_source_cond, chunk_source_lock);
+            }
+            src->last_used = ++chunk_use_clock;
+            if (src->evicted) {
+                retval = _Mix_RestoreChunk(src);
+            }
+            if (retval == 0 && _Mix_chunk_source_stale(src)) {
+                retval = _Mix_ReconvertChunk(src);
+            }
+            break;
+        }
+    }
+    if (_Mix_chunk_over_budget()) {
+        _Mix_WakeChunkWorkers();
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+    return(retval);
+}
+
+/* Drop what Mix_FreeChunk() is about to free from the list */
+static void _Mix_ForgetChunkSource(Mix_Chunk *chunk)
+{
+    Mix_ChunkSource *src, *prev;
+
+    if (!chunk_source_lock) {
+        return;
+    }
+    SDL_LockMutex(chunk_source_lock);
+    for (;;) {
+        prev = NULL;
+        for (src = chunk_sources; src && src->chunk != chunk; src = src->next) {
+            prev = src;
+        }
+        if (!src || !src->converting) {
+            break;
+        }
+        SDL_CondWait(chunk_source_cond, chunk_source_lock);
+    }
+    if (src) {
+        if (prev) {
+            prev->next = src->next;
+        } else {
+            chunk_sources = src->next;
+        }
+        if (_Mix_chunk_source_stale(src)) {
+            SDL_AtomicAdd(&chunk_sources_stale, -1);
+        }
+        if (src->evicted) {
+            SDL_AtomicAdd(&chunk_sources_evicted, -1);
+        }
+        chunk_resident -= _Mix_chunk_source_bytes(src);
+        SDL_free(src->spill);
+        SDL_free(src->buf);
+        SDL_free(src);
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+}
+
+/* Brings chunks back for Mix_PrefetchChunk(), converts them for a new
+   device, and evicts them while the budget is exceeded, until there's
+   nothing left to do */
+static int SDLCALL _Mix_converter_thread(void *data)
+{
+    Mix_ChunkSource *src;
+
+    (void)data;
+    SDL_SetThreadPriority(SDL_THREAD_PRIORITY_LOW);
+    SDL_LockMutex(chunk_source_lock);
+    while (!chunk_converters_quit) {
+        for (src = chunk_sources; src; src = src->next) {
+            if (src->converting || src->failed) {
+                continue;
+            }
+            if (src->evicted ? src->prefetch : _Mix_chunk_source_stale(src)) {
+                break;
+            }
+        }
+        if (src) {
+            if (src->evicted) {
+                if (_Mix_RestoreChunk(src) < 0) {
+                    src->failed = SDL_TRUE;
+                }
+            } else {
+                _Mix_ReconvertChunk(src);
+            }
+            continue;
+        }
+        if (!_Mix_chunk_over_budget()) {
+            break;
+        }
+        SDL_UnlockMutex(chunk_source_lock);
+        if (!_Mix_EvictChunk()) {
+            SDL_LockMutex(chunk_source_lock);
+            break;
+        }
+        SDL_LockMutex(chunk_source_lock);
+    }
+    --converters_running;
+    SDL_UnlockMutex(chunk_source_lock);
+    return 0;
+}
+
+/* Get a converter thread going if none is.
+   MAKE SURE you hold chunk_source_lock. */
+static void _Mix_WakeChunkWorkers(void)
+{
+    int i;
+
+    if (converters_running > 0 || chunk_converters_quit) {
+        return;
+    }
+    if (num_converters == MIX_MAX_CONVERTERS) {
+        /* They're all done, and no longer need the lock to finish */
+        for (i = 0; i < num_converters; ++i) {
+            SDL_WaitThread(chunk_converters[i], NULL);
+        }
+        num_converters = 0;
+    }
+    chunk_converters[num_converters] = SDL_CreateThread(_Mix_converter_thread, "SDL_mixer convert", NULL);
+    if (chunk_converters[num_converters]) {
+        ++num_converters;
+        ++converters_running;
+    }
+}
+
+int Mix_SetChunkBudget(Uint32 bytes)
+{
+    if (!chunk_source_lock) {
+        /* Nothing is loaded before the first Mix_OpenAudio() */
+        chunk_budget = bytes;
+        return(0);
+    }
+    SDL_LockMutex(chunk_source_lock);
+    chunk_budget = bytes;
+    if (_Mix_chunk_over_budget()) {
+        _Mix_WakeChunkWorkers();
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+    return(0);
+}
+
+int Mix_PrefetchChunk(Mix_Chunk *chunk)
+{
+    Mix_ChunkSource *src;
+
+    if (chunk == NULL) {
+        Mix_SetError("Tried to prefetch a NULL chunk");
+        return(-1);
+    }
+    if (!chunk_source_lock) {
+        return(0);
+    }
+    SDL_LockMutex(chunk_source_lock);
+    for (src = chunk_sources; src; src = src->next) {
+        if (src->chunk == chunk) {
+            /* Not the next to go either */
+            src->last_used = ++chunk_use_clock;
+            if (src->evicted && !src->prefetch) {
+                src->prefetch = SDL_TRUE;
+                src->failed = SDL_FALSE;
+                _Mix_WakeChunkWorkers();
+            }
+            break;
+        }
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+    return(0);
+}
+
+/* Memory of one set of buffers from _Mix_alloc_scratch() */
+static size_t _Mix_scratch_bytes(void)
+{
+    return 2 * (size_t)effect_scratch_len +
+           (size_t)(resample_in_frames * mixer.channels + (3 + num_submixes) * mix_bus_samples) * sizeof(float);
+}
+
+int Mix_GetMemoryStats(Mix_MemoryStats *stats)
+{
+    Mix_ChunkSource *src;
+    size_t bytes;
+    int i;
+
+    if (!stats) {
+        Mix_SetError("stats parameter was NULL");
+        return -1;
+    }
+    SDL_zerop(stats);
+
+    if (chunk_source_lock) {
+        SDL_LockMutex(chunk_source_lock);
+        for (src = chunk_sources; src; src = src->next) {
+            ++stats->chunks;
+            if (src->evicted) {
+                ++stats->chunks_evicted;
+            }
+        }
+        stats->chunk_bytes = chunk_resident;
+        stats->chunk_evictions = chunk_evictions;
+        stats->chunk_restores = chunk_restores;
+        SDL_UnlockMutex(chunk_source_lock);
+    }
+    music_memory(&stats->musics, &stats->music_decoded_bytes);
+    if (_Eff_volume_table_u8) {
+        stats->effect_table_bytes += 256 * 256;
+    }
+    if (_Eff_volume_table_s8) {
+        stats->effect_table_bytes += 256 * 256;
+    }
+
+    Mix_LockAudio();
+    if (num_channel_pages > 0) {
+        bytes = (size_t)num_channel_pages * MIX_CHANNEL_PAGE * sizeof(struct _Mix_Channel);
+        bytes += (size_t)max_channels * (2 * sizeof(int) + sizeof(mix_job));
+        bytes += (size_t)max_groups * sizeof(mix_group);
+        /* The audio thread's bus and scratch, and those of each worker */
+        bytes += (size_t)(1 + num_mix_workers) * (mix_bus_samples * sizeof(float) + _Mix_scratch_bytes());
+        for (i = 0; i < num_channel_pages << MIX_CHANNEL_PAGE_SHIFT; ++i) {
+            bytes += mix_channel(i).tile_size;
+        }
+        stats->mixer_bytes = bytes;
+    }
+    Mix_UnlockAudio();
+    return 0;
+}
+
+/* Convert the chunks loaded for the last device to this one's format */
+static void _Mix_StartChunkConversion(void)
+{
+    Mix_ChunkSource *src;
+    int stale = 0;
+
+    if (!chunk_source_lock) {
+        chunk_source_lock = SDL_CreateMutex();
+        chunk_source_cond = SDL_CreateCond();
+        if (!chunk_source_lock || !chunk_source_cond) {
+            /* Chunks just stay in the format they were loaded for */
+            SDL_DestroyMutex(chunk_source_lock);
+            SDL_DestroyCond(chunk_source_cond);
+            chunk_source_lock = NULL;
+            chunk_source_cond = NULL;
+        }
+        return;
+    }
+    SDL_LockMutex(chunk_source_lock);
+    for (src = chunk_sources; src; src = src->next) {
+        src->failed = SDL_FALSE;
+        if (_Mix_chunk_source_stale(src)) {
+            ++stale;
+        }
+    }
+    SDL_AtomicSet(&chunk_sources_stale, stale);
+    /* Without the threads they're converted as they're played */
+    chunk_converters_quit = SDL_FALSE;
+    stale = SDL_min(stale, SDL_min(SDL_GetCPUCount(), MIX_MAX_CONVERTERS));
+    while (num_converters < stale) {
+        chunk_converters[num_converters] = SDL_CreateThread(_Mix_converter_thread, "SDL_mixer convert", NULL);
+        if (!chunk_converters[num_converters]) {
+            break;
+        }
+        ++num_converters;
+        ++converters_running;
+    }
+    if (_Mix_chunk_over_budget()) {
+        _Mix_WakeChunkWorkers();
+    }
+    SDL_UnlockMutex(chunk_source_lock);
+}
+
+static void _Mix_StopChunkConversion(void)
+{
+    int i;
+
+    if (num_converters == 0) {
+        return;
+    }
+    SDL_LockMutex(chunk_source_lock);
+    chunk_converters_quit = SDL_TRUE;
+    SDL_UnlockMutex(chunk_source_lock);
+    for (i = 0; i < num_converters; ++i) {
+        SDL_WaitThread(chunk_converters[i], NULL);
+    }
+    num_converters = 0;
+}
+
+#if 0
+static void PrintFormat(char *title, SDL_AudioSpec *fmt)
+{
+    printf("%s: %d bit %s audio (%s) at %u Hz\n", title, (fmt->format&0xFF),
+            (fmt->format&0x8000) ? "signed" : "unsigned",
+            (fmt->channels > 2) ? "surround" :
+            (fmt->channels > 1) ? "stereo" : "mono", fmt->freq);
+}
+#endif
+
+/* Set up everything but the device itself once 'mixer' holds its spec */
+static int _Mix_OpenMixer(void)
+{
+    int i;
+
+    num_channels = MIX_CHANNELS;
+    effect_scratch_len = (int)mixer.size;
+    mix_bus_samples = (int)mixer.size / (SDL_AUDIO_BITSIZE(mixer.format) / 8);
+    mix_bus = (float *)SDL_malloc(mix_bus_samples * sizeof(float));
+    /* Room for a buffer at twice the rate, faster rates take more pieces */
+    resample_in_frames = 2 * (mix_bus_samples / mixer.channels) + 4;
+    if (_Mix_alloc_scratch(&audio_scratch) < 0 || mix_bus == NULL) {
+        _Mix_free_device_buffers();
+        Mix_SetError("Out of memory");
+        return(-1);
+    }
+    if (_Mix_reserve_channels(num_channels) < 0) {
+        _Mix_free_device_buffers();
+        return(-1);
+    }
+    audio_scratch.bus = mix_bus;
+
+    /* Clear out the audio channels */
+    for (i=0; i<num_channels; ++i) {
+        _Mix_init_channel(i);
+    }
+    if (_Mix_regroup_channels() < 0) {
+        _Mix_free_device_buffers();
+        Mix_SetError("Out of memory");
+        return(-1);
+    }
+    num_active = 0;
+    mix_output_frame = 0;
+    Mix_VolumeMusic(SDL_MIX_MAXVOLUME);
+
+    _Mix_InitEffects();
+    /* Failing here only costs the 8-bit effects their fast path */
+    _Eff_PrepareVolumeTables(mixer.format);
+    _Mix_InitBus();
+    Mix_ResetMixerStats();
+    /* A new device may mean a new thread */
+    thread_policy_pending = SDL_TRUE;
+
+    add_chunk_decoder("WAVE");
+    add_chunk_decoder("AIFF");
+    add_chunk_decoder("VOC");
+
+    /* Initialize the music players */
+    open_music(&mixer);
+
+    /* Without the workers everything is simply mixed on the audio thread */
+    _Mix_StartMixWorkers();
+
+    _Mix_StartChunkConversion();
+
+    return(0);
+}
+
+/* Shortest buffer a chunk size of 0 picks, see Mix_OpenAudioDevice() */
+#define MIX_NATIVE_CHUNK_MS 10
+
+/* The chunk size a 'chunksize' of 0 stands for: the smallest multiple of
+   the device's burst that covers MIX_NATIVE_CHUNK_MS, so each wake-up of
+   the audio thread fills whole bursts and no more of them than it must */
+static int _Mix_NativeChunkSize(int frequency)
+{
+    int target = frequency * MIX_NATIVE_CHUNK_MS / 1000;
+    int burst = _Mix_OpenSLES_GetBurstSize();
+    int native_rate = _Mix_OpenSLES_GetNativeRate();
+    int chunksize;
+
+    if (burst <= 0) {
+        /* Nothing to line up with, take a power of two */
+        for (chunksize = 256; chunksize < target; chunksize *= 2) {
+        }
+        return chunksize;
+    }
+    /* The burst is counted at the device's rate */
+    if (native_rate > 0 && native_rate != frequency) {
+        burst = SDL_max(1, (int)((Sint64)burst * frequency / native_rate));
+    }
+    chunksize = ((target + burst - 1) / burst) * burst;
+    return SDL_min(chunksize, 0x8000);
+}
+
+/* Open the mixer with a certain desired audio format */
+int Mix_OpenAudioDevice(int frequency, Uint16 format, int nchannels, int chunksize,
+                        const char* device, int allowed_changes)
+{
+    SDL_AudioSpec desired;
+
+    /* This used to call SDL_OpenAudio(), which initializes the audio
+       subsystem if necessary. Since SDL_OpenAudioDevice() doesn't,
+       we have to handle this case here. */
+    if (!SDL_WasInit(SDL_INIT_AUDIO)) {
+        if (SDL_InitSubSystem(SDL_INIT_AUDIO) < 0) {
+            return -1;
+        }
+    }
+
+    /* If the mixer is already opened, increment open count */
+    if (audio_opened) {
+        if (format == mixer.format && nchannels == mixer.channels) {
+            ++audio_opened;
+            return(0);
+        }
+        while (audio_opened) {
+            Mix_CloseAudio();
+        }
+    }
+
+    /* Set the desired format and frequency */
+    if (frequency == 0) {
+        /* Nothing resamples the output on the way out at the native rate */
+        frequency = _Mix_OpenSLES_GetNativeRate();
+        if (frequency <= 0) {
+            frequency = MIX_DEFAULT_FREQUENCY;
+        }
+    }
+    if (chunksize == 0) {
+        chunksize = _Mix_NativeChunkSize(frequency);
+    }
+    desired.freq = frequency;
+    desired.format = format;
+    desired.channels = nchannels;
+    desired.samples = chunksize;
+    desired.callback = mix_channels;
+    desired.userdata = NULL;
+
+    /* Accept nearly any audio format */
+    if ((audio_device = SDL_OpenAudioDevice(device, 0, &desired, &mixer, allowed_changes)) == 0) {
+        return(-1);
+    }
+#if 0
+    PrintFormat("Audio device", &mixer);
+#endif
+
+    if (_Mix_OpenMixer() < 0) {
+        SDL_CloseAudioDevice(audio_device);
+        audio_device = 0;
+        return(-1);
+    }
+
+    audio_opened = 1;
+    SDL_PauseAudioDevice(audio_device, 0);
+    return(0);
+}
+
+/* Open the mixer with a certain desired audio format */
+int Mix_OpenAudio(int frequency, Uint16 format, int nchannels, int chunksize)
+{
+    return Mix_OpenAudioDevice(frequency, format, nchannels, chunksize, NULL,
+                                SDL_AUDIO_ALLOW_FREQUENCY_CHANGE |
+                                SDL_AUDIO_ALLOW_CHANNELS_CHANGE);
+}
+
+/* Open the mixer on the platform's low latency output, see SDL_mixer.h */
+int Mix_OpenAudioNative(int frequency, Uint16 format, int nchannels, int chunksize)
+{
+    SDL_AudioSpec desired;
+
+    while (audio_opened) {
+        Mix_CloseAudio();
+    }
+
+    if (chunksize == 0) {
+        chunksize = _Mix_NativeChunkSize(frequency);
+    }
+    SDL_zero(desired);
+    desired.freq = frequency;
+    desired.format = format;
+    desired.channels = (Uint8)nchannels;
+    desired.samples = (Uint16)chunksize;
+    desired.callback = mix_channels;
+    desired.userdata = NULL;
+    if (_Mix_OpenSLES_Open(&desired, &mixer) < 0) {
+        return(-1);
+    }
+
+    audio_device = 0;
+    audio_native = SDL_TRUE;
+    if (_Mix_OpenMixer() < 0) {
+        _Mix_OpenSLES_Close();
+        audio_native = SDL_FALSE;
+        return(-1);
+    }
+
+    audio_opened = 1;
+    _Mix_OpenSLES_Start();
+    return(0);
+}
+
+/* Spread the channels over worker threads, see Mix_SetMixThreads() */
+int Mix_SetMixThreads(int threads, int min_channels)
+{
+    int retval = 0;
+
+    if (threads < 0 || threads > MIX_MAX_MIX_THREADS) {
+        Mix_SetError("Mixing threads must be between 0 and %d", MIX_MAX_MIX_THREADS);
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    _Mix_StopMixWorkers();
+    mix_threads_wanted = threads;
+    mix_threads_min_channels = SDL_max(min_channels, 1);
+    if (audio_opened) {
+        retval = _Mix_StartMixWorkers();
+    }
+    Mix_UnlockAudio();
+    return(retval);
+}
+
+/* Scheduling for the callback's thread, see SDL_mixer.h */
+int Mix_SetAudioThreadPolicy(Mix_ThreadPriority priority, Uint32 cpu_mask)
+{
+    int cpus = SDL_GetCPUCount();
+    Uint32 present = (cpus >= 32) ? 0xFFFFFFFF : ((1u << cpus) - 1);
+
+    if (cpu_mask != 0 && (cpu_mask & present) == 0) {
+        Mix_SetError("None of the cores in the mask exist");
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    thread_priority = priority;
+    thread_cpu_mask = cpu_mask & present;
+    thread_policy_pending = SDL_TRUE;
+    Mix_UnlockAudio();
+    return(0);
+}
+
+int Mix_SetAutoSuspend(int ms)
+{
+    if (ms < 0) {
+        Mix_SetError("Invalid suspend delay %d", ms);
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    suspend_after_ms = ms;
+    idle_frames = 0;
+    Mix_UnlockAudio();
+
+    if (ms == 0) {
+        _Mix_WakeOutput();
+    }
+    return(0);
+}
+
+int Mix_OutputSuspended(void)
+{
+    return(SDL_AtomicGet(&output_suspended));
+}
+
+int Mix_PauseOutput(int pause_on)
+{
+    if (!audio_opened) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(-1);
+    }
+    if (audio_offline) {
+        return(0);
+    }
+
+    if (!pause_on) {
+        SDL_AtomicSet(&output_paused, 0);
+        _Mix_WakeOutput();
+        return(0);
+    }
+
+    Mix_LockAudio();
+    SDL_AtomicSet(&output_paused, 1);
+    if (!SDL_AtomicGet(&output_suspended)) {
+        SDL_AtomicSet(&output_suspended, 1);
+        if (audio_native) {
+            _Mix_OpenSLES_Suspend();
+        } else {
+            SDL_PauseAudioDevice(audio_device, 1);
+        }
+    }
+    Mix_UnlockAudio();
+    return(0);
+}
+
+/* Open the mixer without an audio device, see Mix_RenderOffline() */
+int Mix_OpenAudioOffline(int frequency, Uint16 format, int nchannels, int chunksize)
+{
+    while (audio_opened) {
+        Mix_CloseAudio();
+    }
+    if (frequency <= 0 || nchannels <= 0 || chunksize <= 0 || SDL_AUDIO_BITSIZE(format) == 0) {
+        Mix_SetError("Invalid offline audio format");
+        return(-1);
+    }
+
+    /* What SDL_OpenAudioDevice() would have come back with */
+    SDL_zero(mixer);
+    mixer.freq = frequency;
+    mixer.format = format;
+    mixer.channels = (Uint8)nchannels;
+    mixer.samples = (Uint16)chunksize;
+    mixer.silence = (format == AUDIO_U8) ? 0x80 : 0x00;
+    mixer.size = (Uint32)chunksize * nchannels * (SDL_AUDIO_BITSIZE(format) / 8);
+    mixer.callback = mix_channels;
+
+    audio_device = 0;
+    audio_offline = SDL_TRUE;
+    if (_Mix_OpenMixer() < 0) {
+        audio_offline = SDL_FALSE;
+        return(-1);
+    }
+
+    audio_opened = 1;
+    return(0);
+}
+
+/* Mix the next 'len' bytes of output into 'stream' */
+int Mix_RenderOffline(Uint8 *stream, int len)
+{
+    int n;
+
+    if (!audio_offline || !audio_opened) {
+        Mix_SetError("Mixer isn't open for offline rendering");
+        return(-1);
+    }
+    while (len > 0) {
+        n = SDL_min(len, (int)mixer.size);
+        mix_channels(NULL, stream, n);
+        stream += n;
+        len -= n;
+    }
+    return(0);
+}
+
+/* Dynamically change the number of channels managed by the mixer.
+   If decreasing the number of channels, the upper channels are
+   stopped.
+ */
+int Mix_AllocateChannels(int numchans)
+{
+    int i;
+
+    if (numchans<0 || numchans==num_channels)
+        return(num_channels);
+
+    if (numchans < num_channels) {
+        /* Stop the affected channels, their pages stay for the next time */
+        for(i=numchans; i < num_channels; i++) {
+            Mix_UnregisterAllEffects(i);
+            Mix_HaltChannel(i);
+        }
+    } else {
+        if (_Mix_reserve_channels(numchans) < 0) {
+            /* Keep the channels we have, the new ones won't be usable */
+            return(num_channels);
+        }
+        /* Past num_channels nothing looks at them yet, not even the callback */
+        for(i=num_channels; i < numchans; i++) {
+            _Mix_init_channel(i);
+        }
+    }
+    Mix_LockAudio();
+    num_channels = numchans;
+    if (_Mix_regroup_channels() < 0) {
+        /* Only the groups of the channels past the last one it did are off */
+        Mix_SetError("Out of memory");
+    }
+    Mix_UnlockAudio();
+    return(num_channels);
+}
+
+/* Return the actual mixer parameters */
+int Mix_QuerySpec(int *frequency, Uint16 *format, int *channels)
+{
+    if (audio_opened) {
+        if (frequency) {
+            *frequency = mixer.freq;
         }
         if (format) {
             *format = mixer.format;
@@ -512,32 +2728,25 @@ int Mix_QuerySpec(int *frequency, Uint16 *format, int *channels)
     return(audio_opened);
 }
 
-typedef struct _MusicFragment
-{
-    Uint8 *data;
-    int size;
-    struct _MusicFragment *next;
-} MusicFragment;
-
-static SDL_AudioSpec *Mix_LoadMusic_RW(Mix_MusicType music_type, SDL_RWops *src, int freesrc, SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
+/* Create a decoder for 'src' with the first music interface that can play
+   it in the background. Returns the decoder context, or NULL on error. */
+static void *_Mix_CreateDecoder(Mix_MusicType music_type, SDL_RWops *src, int freesrc, Mix_MusicInterface **decoder)
 {
     int i;
     Mix_MusicInterface *interface = NULL;
     void *music = NULL;
     Sint64 start;
-    SDL_bool playing;
-    MusicFragment *first = NULL, *last = NULL, *fragment = NULL;
-    int count = 0;
-    int fragment_size;
 
+    /* The interface tables aren't thread safe, chunks may load on any thread */
+    Mix_LockAudio();
     if (!load_music_type(music_type) || !open_music_type(music_type)) {
+        Mix_UnlockAudio();
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
         return NULL;
     }
-
-    *spec = mixer;
-
-    /* Use fragments sized on full audio frame boundaries - this'll do */
-    fragment_size = spec->size;
+    Mix_UnlockAudio();
 
     start = SDL_RWtell(src);
     for (i = 0; i < get_num_music_interfaces(); ++i) {
@@ -562,7 +2771,6 @@ static SDL_AudioSpec *Mix_LoadMusic_RW(Mix_MusicType music_type, SDL_RWops *src,
         music = interface->CreateFromRW(src, freesrc);
         if (music) {
             /* The interface owns the data source now */
-            freesrc = SDL_FALSE;
             break;
         }
 
@@ -578,45 +2786,82 @@ static SDL_AudioSpec *Mix_LoadMusic_RW(Mix_MusicType music_type, SDL_RWops *src,
         return NULL;
     }
 
-    Mix_LockAudio();
+    *decoder = interface;
+    return music;
+}
+
+static SDL_AudioSpec *Mix_LoadMusic_RW(Mix_MusicType music_type, SDL_RWops *src, int freesrc, SDL_AudioSpec *spec, Uint8 **audio_buf, Uint32 *audio_len)
+{
+    Mix_MusicInterface *interface = NULL;
+    void *music = NULL;
+    SDL_bool playing;
+    Uint8 *buf = NULL;
+    size_t len = 0, capacity;
+    Sint64 src_size;
+    int fragment_size;
+    SDL_bool locked;
+
+    /* The decoded audio is rarely smaller than the file, so start there */
+    src_size = SDL_RWsize(src) - SDL_RWtell(src);
+
+    music = _Mix_CreateDecoder(music_type, src, freesrc, &interface);
+    if (!music) {
+        return NULL;
+    }
+
+    *spec = mixer;
+
+    /* Decode in pieces sized on full audio frame boundaries - this'll do */
+    fragment_size = spec->size;
+    capacity = 8 * (size_t)fragment_size;
+    if (src_size > (Sint64)capacity && src_size < SDL_MAX_SINT32) {
+        capacity = (size_t)src_size;
+    }
+
+    /* Decoders that keep global state can't run next to the music, and
+       the others shouldn't hold up the audio callback, nor each other */
+    locked = !music_interface_thread_safe(interface);
+    if (locked) {
+        Mix_LockAudio();
+    }
 
     if (interface->Play) {
         interface->Play(music, 1);
     }
     playing = SDL_TRUE;
 
+    /* Decode straight into one buffer, growing it geometrically */
     while (playing) {
         int left;
 
-        fragment = (MusicFragment *)SDL_malloc(sizeof(*fragment));
-        if (!fragment) {
-            /* Uh oh, out of memory, let's return what we have */
-            break;
-        }
-        fragment->data = (Uint8 *)SDL_malloc(fragment_size);
-        if (!fragment->data) {
-            /* Uh oh, out of memory, let's return what we have */
-            SDL_free(fragment);
-            break;
+        if (!buf || len + fragment_size > capacity) {
+            Uint8 *more;
+
+            if (buf) {
+                capacity *= 2;
+            }
+            more = (Uint8 *)SDL_realloc(buf, capacity);
+            if (!more) {
+                /* Uh oh, out of memory, let's return what we have */
+                break;
+            }
+            buf = more;
         }
-        fragment->next = NULL;
 
-        left = interface->GetAudio(music, fragment->data, fragment_size);
+        MIX_TRACE_DECODE(interface->type);
+        left = interface->GetAudio(music, buf + len, fragment_size);
+        MIX_TRACE_END();
         if (left > 0) {
             playing = SDL_FALSE;
         } else if (interface->IsPlaying) {
             playing = interface->IsPlaying(music);
         }
-        fragment->size = (fragment_size - left);
-
-        if (!first) {
-            first = fragment;
-        }
-        if (last) {
-            last->next = fragment;
+        if (left < 0) {
+            /* Decoding error, keep what we have */
+            playing = SDL_FALSE;
+            left = fragment_size;
         }
-        last = fragment;
-        ++count;
+        len += (fragment_size - left);
     }
 
     if (interface->Stop) {
@@ -627,47 +2872,33 @@ static SDL_AudioSpec *Mix_LoadMusic_RW(Mix_MusicType music_type, SDL_RWops *src,
         interface->Delete(music);
     }
 
-    Mix_UnlockAudio();
+    if (locked) {
+        Mix_UnlockAudio();
+    }
 
-    if (count > 0) {
-        *audio_len = (count - 1) * fragment_size + fragment->size;
-        *audio_buf = (Uint8 *)SDL_malloc(*audio_len);
-        if (*audio_buf) {
-            Uint8 *dst = *audio_buf;
-            for (fragment = first; fragment; fragment = fragment->next) {
-                SDL_memcpy(dst, fragment->data, fragment->size);
-                dst += fragment->size;
-            }
-        } else {
-            SDL_OutOfMemory();
-            spec = NULL;
-        }
-    } else {
+    if (len > 0) {
+        /* Give back what the last doubling didn't use */
+        Uint8 *fit = (Uint8 *)SDL_realloc(buf, len);
+        *audio_buf = fit ? fit : buf;
+        *audio_len = (Uint32)len;
+    } else if (buf) {
+        SDL_free(buf);
         Mix_SetError("No audio data");
         spec = NULL;
+    } else {
+        SDL_OutOfMemory();
+        spec = NULL;
     }
 
-    while (first) {
-        fragment = first;
-        first = first->next;
-        SDL_free(fragment->data);
-        SDL_free(fragment);
-    }
-
-    if (freesrc) {
-        SDL_RWclose(src);
-    }
     return spec;
 }
 
 /* Load a wave file */
-Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
+static Mix_Chunk *_Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
 {
     Uint8 magic[4];
     Mix_Chunk *chunk;
     SDL_AudioSpec wavespec, *loaded;
-    SDL_AudioCVT wavecvt;
-    int samplesize;
 
     /* rcg06012001 Make sure src is valid */
     if (!src) {
@@ -709,7 +2940,7 @@ Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
         loaded = SDL_LoadWAV_RW(src, freesrc, &wavespec, (Uint8 **)&chunk->abuf, &chunk->alen);
     } else if (SDL_memcmp(magic, "FORM", 4) == 0) {
         loaded = Mix_LoadAIFF_RW(src, freesrc, &wavespec, (Uint8 **)&chunk->abuf, &chunk->alen);
-    } else if (SDL_memcmp(magic, "CREA", 4) == 0) {
+    } else if (SDL_memcmp(magic, "Crea", 4) == 0) {
         loaded = Mix_LoadVOC_RW(src, freesrc, &wavespec, (Uint8 **)&chunk->abuf, &chunk->alen);
     } else {
         Mix_MusicType music_type = detect_music_type_from_magic(magic);
@@ -721,110 +2952,524 @@ Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
         return(NULL);
     }
 
-#if 0
-    PrintFormat("Audio device", &mixer);
-    PrintFormat("-- Wave file", &wavespec);
-#endif
+#if 0
+    PrintFormat("Audio device", &mixer);
+    PrintFormat("-- Wave file", &wavespec);
+#endif
+
+    chunk->allocated = 1;
+    chunk->volume = MIX_MAX_VOLUME;
+
+    /* Convert to the device's format, keeping the samples as loaded */
+    if (wavespec.format != mixer.format ||
+         wavespec.channels != mixer.channels ||
+         wavespec.freq != mixer.freq) {
+        Uint8 *source = chunk->abuf;
+        Uint32 source_len = chunk->alen;
+
+        chunk->abuf = _Mix_ConvertAudio(source, source_len,
+                wavespec.format, wavespec.channels, wavespec.freq,
+                mixer.format, mixer.channels, mixer.freq, &chunk->alen);
+        if (chunk->abuf == NULL) {
+            SDL_free(source);
+            SDL_free(chunk);
+            return(NULL);
+        }
+        _Mix_KeepChunkSource(chunk, &wavespec, source, source_len);
+    } else {
+        _Mix_KeepChunkSource(chunk, &wavespec, NULL, 0);
+    }
+
+    return(chunk);
+}
+
+Mix_Chunk *Mix_LoadWAV_RW(SDL_RWops *src, int freesrc)
+{
+    Mix_Chunk *chunk;
+
+    MIX_TRACE_BEGIN("Mix_LoadWAV_RW");
+    /* Only a stream the loaders close can be wrapped, the caller would be
+       left reading from one the wrapper had read ahead of */
+    if (src && freesrc) {
+        src = _Mix_RWFromBuffered(src, freesrc);
+    }
+    chunk = _Mix_LoadWAV_RW(src, freesrc);
+    MIX_TRACE_END();
+    return(chunk);
+}
+
+/* Load a sound whose samples are decoded while it plays */
+Mix_Chunk *Mix_LoadWAVStreamed_RW(SDL_RWops *src, int freesrc)
+{
+    Uint8 magic[4];
+    Mix_MusicType music_type;
+    Mix_MusicInterface *interface = NULL;
+    Mix_ChunkStream *stream;
+    Mix_Chunk *chunk;
+    void *context;
+
+    if (!src) {
+        SDL_SetError("Mix_LoadWAVStreamed_RW with NULL src");
+        return(NULL);
+    }
+    if (freesrc) {
+        src = _Mix_RWFromBuffered(src, freesrc);
+    }
+    if (!audio_opened) {
+        SDL_SetError("Audio device hasn't been opened");
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        return(NULL);
+    }
+
+    if (SDL_RWread(src, magic, 1, 4) != 4) {
+        if (freesrc) {
+            SDL_RWclose(src);
+        }
+        Mix_SetError("Couldn't read first 4 bytes of audio data");
+        return(NULL);
+    }
+    SDL_RWseek(src, -4, RW_SEEK_CUR);
+
+    if (SDL_memcmp(magic, "WAVE", 4) == 0 || SDL_memcmp(magic, "RIFF", 4) == 0 ||
+        SDL_memcmp(magic, "FORM", 4) == 0) {
+        music_type = MUS_WAV;
+    } else if (SDL_memcmp(magic, "Crea", 4) == 0) {
+        /* No streaming decoder for VOC, load it all */
+        return Mix_LoadWAV_RW(src, freesrc);
+    } else {
+        music_type = detect_music_type_from_magic(magic);
+    }
+
+    context = _Mix_CreateDecoder(music_type, src, freesrc, &interface);
+    if (!context) {
+        return(NULL);
+    }
+    if (interface->SetVolume) {
+        /* The decoder has to write the samples, not mix them in */
+        interface->SetVolume(context, MIX_MAX_VOLUME);
+    }
+
+    chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
+    stream = (Mix_ChunkStream *)SDL_calloc(1, sizeof(Mix_ChunkStream));
+    if (stream) {
+        /* Two device buffers of look-ahead */
+        stream->size = 2 * mixer.size;
+        stream->ring = (Uint8 *)SDL_malloc(stream->size);
+    }
+    if (!chunk || !stream || !stream->ring) {
+        SDL_OutOfMemory();
+        if (stream) {
+            SDL_free(stream->ring);
+        }
+        SDL_free(stream);
+        SDL_free(chunk);
+        interface->Delete(context);
+        return(NULL);
+    }
+    stream->chunk = chunk;
+    stream->interface = interface;
+    stream->context = context;
+
+    chunk->allocated = MIX_CHUNK_STREAMED;
+    chunk->abuf = stream->ring;
+    chunk->alen = (Uint32)stream->size;
+    chunk->volume = MIX_MAX_VOLUME;
+
+    Mix_LockAudio();
+    stream->next = chunk_streams;
+    chunk_streams = stream;
+    Mix_UnlockAudio();
+
+    return(chunk);
+}
+
+/* Tear down the decoder of a MIX_CHUNK_STREAMED chunk, including its ring */
+static void _Mix_FreeStream(Mix_Chunk *chunk)
+{
+    Mix_ChunkStream *stream, *prev = NULL;
+
+    Mix_LockAudio();
+    for (stream = chunk_streams; stream; prev = stream, stream = stream->next) {
+        if (stream->chunk == chunk) {
+            if (prev) {
+                prev->next = stream->next;
+            } else {
+                chunk_streams = stream->next;
+            }
+            break;
+        }
+    }
+    Mix_UnlockAudio();
+
+    if (stream) {
+        if (stream->interface->Stop) {
+            stream->interface->Stop(stream->context);
+        }
+        stream->interface->Delete(stream->context);
+        SDL_free(stream->ring);
+        SDL_free(stream);
+    }
+}
+
+/* Load a wave file of the mixer format from a memory buffer */
+Mix_Chunk *Mix_QuickLoad_WAV(Uint8 *mem)
+{
+    Mix_Chunk *chunk;
+    Uint8 magic[4];
+
+    /* Make sure audio has been opened */
+    if (! audio_opened) {
+        SDL_SetError("Audio device hasn't been opened");
+        return(NULL);
+    }
+
+    /* Allocate the chunk memory */
+    chunk = (Mix_Chunk *)SDL_calloc(1,sizeof(Mix_Chunk));
+    if (chunk == NULL) {
+        SDL_SetError("Out of memory");
+        return(NULL);
+    }
+
+    /* Essentially just skip to the audio data (no error checking - fast) */
+    chunk->allocated = 0;
+    mem += 12; /* WAV header */
+    do {
+        SDL_memcpy(magic, mem, 4);
+        mem += 4;
+        chunk->alen = ((mem[3]<<24)|(mem[2]<<16)|(mem[1]<<8)|(mem[0]));
+        mem += 4;
+        chunk->abuf = mem;
+        mem += chunk->alen;
+    } while (memcmp(magic, "data", 4) != 0);
+    chunk->volume = MIX_MAX_VOLUME;
+
+    return(chunk);
+}
+
+/* Load raw audio data of the mixer format from a memory buffer */
+Mix_Chunk *Mix_QuickLoad_RAW(Uint8 *mem, Uint32 len)
+{
+    Mix_Chunk *chunk;
+
+    /* Make sure audio has been opened */
+    if (! audio_opened) {
+        SDL_SetError("Audio device hasn't been opened");
+        return(NULL);
+    }
+
+    /* Allocate the chunk memory */
+    chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
+    if (chunk == NULL) {
+        SDL_SetError("Out of memory");
+        return(NULL);
+    }
+
+    /* Essentially just point at the audio data (no error checking - fast) */
+    chunk->allocated = 0;
+    chunk->alen = len;
+    chunk->abuf = mem;
+    chunk->volume = MIX_MAX_VOLUME;
+
+    return(chunk);
+}
+
+/*
+ * Background loading.
+ *  A few worker threads, started on first use, take load jobs off a FIFO,
+ *  unless the application hands them to its own threads instead.
+ */
+#define MIX_MAX_LOADERS 4
+
+struct _Mix_LoadHandle
+{
+    SDL_RWops *src;
+    int freesrc;
+    char *file;             /* set for Mix_LoadWAVCachedAsync() and _RW() */
+    Mix_LoadCallback callback;
+    void *udata;
+    Mix_Chunk *chunk;
+    char error[128];
+    SDL_bool done;
+    struct _Mix_LoadHandle *next;
+};
+
+static SDL_mutex *load_lock = NULL;
+static SDL_cond *load_cond = NULL;         /* a job was queued or finished */
+static SDL_Thread *loaders[MIX_MAX_LOADERS];
+static int num_loaders = 0;
+static SDL_bool loaders_quit = SDL_FALSE;
+static Mix_LoadHandle *load_first = NULL;
+static Mix_LoadHandle *load_last = NULL;
+static Mix_JobHandler load_handler = NULL;
+static void *load_handler_udata = NULL;
+static int loads_handed_out = 0;           /* running on the handler's threads */
+
+static void _Mix_run_load(Mix_LoadHandle *job)
+{
+    if (job->file && job->src) {
+        job->chunk = Mix_LoadWAVCached_RW(job->src, job->freesrc, job->file);
+    } else if (job->file) {
+        job->chunk = Mix_LoadWAVCached(job->file);
+    } else {
+        job->chunk = Mix_LoadWAV_RW(job->src, job->freesrc);
+    }
+    if (!job->chunk) {
+        SDL_strlcpy(job->error, Mix_GetError(), sizeof(job->error));
+    }
+    if (job->callback) {
+        job->callback(job->chunk, job->udata);
+    }
+
+    SDL_LockMutex(load_lock);
+    job->done = SDL_TRUE;
+    SDL_CondBroadcast(load_cond);
+    SDL_UnlockMutex(load_lock);
+}
+
+/* A load on one of the handler's threads, the handle may be gone once it's done */
+static void SDLCALL _Mix_handled_load(void *data)
+{
+    _Mix_run_load((Mix_LoadHandle *)data);
+
+    SDL_LockMutex(load_lock);
+    --loads_handed_out;
+    SDL_CondBroadcast(load_cond);
+    SDL_UnlockMutex(load_lock);
+}
+
+void Mix_SetJobHandler(Mix_JobHandler handler, void *udata)
+{
+    load_handler = handler;
+    load_handler_udata = udata;
+}
+
+static int SDLCALL _Mix_loader_thread(void *data)
+{
+    Mix_LoadHandle *job;
+
+    (void)data;
+    for (;;) {
+        SDL_LockMutex(load_lock);
+        while (!load_first && !loaders_quit) {
+            SDL_CondWait(load_cond, load_lock);
+        }
+        job = load_first;
+        if (!job) {
+            /* Only quit once the queue is empty */
+            SDL_UnlockMutex(load_lock);
+            break;
+        }
+        load_first = job->next;
+        if (!load_first) {
+            load_last = NULL;
+        }
+        SDL_UnlockMutex(load_lock);
+
+        _Mix_run_load(job);
+    }
+    return 0;
+}
+
+/* Finish the queued jobs and stop the loader threads */
+static void _Mix_StopLoaders(void)
+{
+    int i;
+
+    if (!load_lock) {
+        return;
+    }
+    SDL_LockMutex(load_lock);
+    while (loads_handed_out > 0) {
+        SDL_CondWait(load_cond, load_lock);
+    }
+    loaders_quit = SDL_TRUE;
+    SDL_CondBroadcast(load_cond);
+    SDL_UnlockMutex(load_lock);
+    for (i = 0; i < num_loaders; ++i) {
+        SDL_WaitThread(loaders[i], NULL);
+    }
+    num_loaders = 0;
+    loaders_quit = SDL_FALSE;
+}
+
+static Mix_LoadHandle *_Mix_QueueLoad(Mix_LoadHandle *job)
+{
+    if (!load_lock) {
+        load_lock = SDL_CreateMutex();
+        load_cond = SDL_CreateCond();
+        if (!load_lock || !load_cond) {
+            SDL_DestroyMutex(load_lock);
+            SDL_DestroyCond(load_cond);
+            load_lock = NULL;
+            load_cond = NULL;
+            return NULL;
+        }
+    }
+
+    if (load_handler) {
+        SDL_LockMutex(load_lock);
+        ++loads_handed_out;
+        SDL_UnlockMutex(load_lock);
+        if (load_handler(_Mix_handled_load, job, load_handler_udata) == 0) {
+            return job;
+        }
+        /* Turned down, the loader threads take it */
+        SDL_LockMutex(load_lock);
+        --loads_handed_out;
+        SDL_UnlockMutex(load_lock);
+    }
 
-    /* Build the audio converter and create conversion buffers */
-    if (wavespec.format != mixer.format ||
-         wavespec.channels != mixer.channels ||
-         wavespec.freq != mixer.freq) {
-        if (SDL_BuildAudioCVT(&wavecvt,
-                wavespec.format, wavespec.channels, wavespec.freq,
-                mixer.format, mixer.channels, mixer.freq) < 0) {
-            SDL_free(chunk->abuf);
-            SDL_free(chunk);
-            return(NULL);
+    SDL_LockMutex(load_lock);
+    if (num_loaders == 0) {
+        int count = SDL_min(SDL_GetCPUCount(), MIX_MAX_LOADERS);
+        while (num_loaders < count || num_loaders == 0) {
+            loaders[num_loaders] = SDL_CreateThread(_Mix_loader_thread, "SDL_mixer loader", NULL);
+            if (!loaders[num_loaders]) {
+                break;
+            }
+            ++num_loaders;
         }
-        samplesize = ((wavespec.format & 0xFF)/8)*wavespec.channels;
-        wavecvt.len = chunk->alen & ~(samplesize-1);
-        wavecvt.buf = (Uint8 *)SDL_calloc(1, wavecvt.len*wavecvt.len_mult);
-        if (wavecvt.buf == NULL) {
-            SDL_SetError("Out of memory");
-            SDL_free(chunk->abuf);
-            SDL_free(chunk);
-            return(NULL);
+        if (num_loaders == 0) {
+            SDL_UnlockMutex(load_lock);
+            return NULL;
         }
-        SDL_memcpy(wavecvt.buf, chunk->abuf, wavecvt.len);
-        SDL_free(chunk->abuf);
+    }
+    if (load_last) {
+        load_last->next = job;
+    } else {
+        load_first = job;
+    }
+    load_last = job;
+    SDL_CondSignal(load_cond);
+    SDL_UnlockMutex(load_lock);
+    return job;
+}
 
-        /* Run the audio converter */
-        if (SDL_ConvertAudio(&wavecvt) < 0) {
-            SDL_free(wavecvt.buf);
-            SDL_free(chunk);
-            return(NULL);
-        }
+static Mix_LoadHandle *_Mix_NewLoad(Mix_LoadCallback callback, void *udata)
+{
+    Mix_LoadHandle *job;
 
-        chunk->abuf = wavecvt.buf;
-        chunk->alen = wavecvt.len_cvt;
+    if (!audio_opened) {
+        Mix_SetError("Audio device hasn't been opened");
+        return NULL;
     }
+    job = (Mix_LoadHandle *)SDL_calloc(1, sizeof(*job));
+    if (!job) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    job->callback = callback;
+    job->udata = udata;
+    return job;
+}
 
-    chunk->allocated = 1;
-    chunk->volume = MIX_MAX_VOLUME;
+Mix_LoadHandle *Mix_LoadWAVAsync_RW(SDL_RWops *src, int freesrc, Mix_LoadCallback callback, void *udata)
+{
+    Mix_LoadHandle *job;
 
-    return(chunk);
+    if (!src) {
+        SDL_SetError("Mix_LoadWAVAsync_RW with NULL src");
+        return(NULL);
+    }
+    job = _Mix_NewLoad(callback, udata);
+    if (job) {
+        job->src = src;
+        job->freesrc = freesrc;
+        if (!_Mix_QueueLoad(job)) {
+            SDL_free(job);
+            job = NULL;
+        }
+    }
+    if (!job && freesrc) {
+        SDL_RWclose(src);
+    }
+    return(job);
 }
 
-/* Load a wave file of the mixer format from a memory buffer */
-Mix_Chunk *Mix_QuickLoad_WAV(Uint8 *mem)
+Mix_LoadHandle *Mix_LoadWAVCachedAsync(const char *file, Mix_LoadCallback callback, void *udata)
 {
-    Mix_Chunk *chunk;
-    Uint8 magic[4];
+    Mix_LoadHandle *job;
 
-    /* Make sure audio has been opened */
-    if (! audio_opened) {
-        SDL_SetError("Audio device hasn't been opened");
+    if (!file) {
+        Mix_SetError("Mix_LoadWAVCachedAsync with NULL file");
         return(NULL);
     }
+    job = _Mix_NewLoad(callback, udata);
+    if (job) {
+        job->file = SDL_strdup(file);
+        if (!job->file || !_Mix_QueueLoad(job)) {
+            SDL_free(job->file);
+            SDL_free(job);
+            job = NULL;
+        }
+    }
+    return(job);
+}
 
-    /* Allocate the chunk memory */
-    chunk = (Mix_Chunk *)SDL_calloc(1,sizeof(Mix_Chunk));
-    if (chunk == NULL) {
-        SDL_SetError("Out of memory");
+Mix_LoadHandle *Mix_LoadWAVCachedAsync_RW(SDL_RWops *src, int freesrc, const char *file, Mix_LoadCallback callback, void *udata)
+{
+    Mix_LoadHandle *job;
+
+    if (!src) {
+        SDL_SetError("Mix_LoadWAVCachedAsync_RW with NULL src");
         return(NULL);
     }
+    job = NULL;
+    if (!file) {
+        Mix_SetError("Mix_LoadWAVCachedAsync_RW with NULL file");
+    } else {
+        job = _Mix_NewLoad(callback, udata);
+    }
+    if (job) {
+        job->src = src;
+        job->freesrc = freesrc;
+        job->file = SDL_strdup(file);
+        if (!job->file || !_Mix_QueueLoad(job)) {
+            SDL_free(job->file);
+            SDL_free(job);
+            job = NULL;
+        }
+    }
+    if (!job && freesrc) {
+        SDL_RWclose(src);
+    }
+    return(job);
+}
 
-    /* Essentially just skip to the audio data (no error checking - fast) */
-    chunk->allocated = 0;
-    mem += 12; /* WAV header */
-    do {
-        SDL_memcpy(magic, mem, 4);
-        mem += 4;
-        chunk->alen = ((mem[3]<<24)|(mem[2]<<16)|(mem[1]<<8)|(mem[0]));
-        mem += 4;
-        chunk->abuf = mem;
-        mem += chunk->alen;
-    } while (memcmp(magic, "data", 4) != 0);
-    chunk->volume = MIX_MAX_VOLUME;
+int Mix_LoadReady(Mix_LoadHandle *handle)
+{
+    int ready;
 
-    return(chunk);
+    if (!handle) {
+        return(0);
+    }
+    SDL_LockMutex(load_lock);
+    ready = handle->done;
+    SDL_UnlockMutex(load_lock);
+    return(ready);
 }
 
-/* Load raw audio data of the mixer format from a memory buffer */
-Mix_Chunk *Mix_QuickLoad_RAW(Uint8 *mem, Uint32 len)
+Mix_Chunk *Mix_LoadWait(Mix_LoadHandle *handle)
 {
     Mix_Chunk *chunk;
 
-    /* Make sure audio has been opened */
-    if (! audio_opened) {
-        SDL_SetError("Audio device hasn't been opened");
+    if (!handle) {
         return(NULL);
     }
-
-    /* Allocate the chunk memory */
-    chunk = (Mix_Chunk *)SDL_malloc(sizeof(Mix_Chunk));
-    if (chunk == NULL) {
-        SDL_SetError("Out of memory");
-        return(NULL);
+    SDL_LockMutex(load_lock);
+    while (!handle->done) {
+        SDL_CondWait(load_cond, load_lock);
     }
+    SDL_UnlockMutex(load_lock);
 
-    /* Essentially just point at the audio data (no error checking - fast) */
-    chunk->allocated = 0;
-    chunk->alen = len;
-    chunk->abuf = mem;
-    chunk->volume = MIX_MAX_VOLUME;
-
+    chunk = handle->chunk;
+    if (!chunk) {
+        Mix_SetError("%s", handle->error);
+    }
+    SDL_free(handle->file);
+    SDL_free(handle);
     return(chunk);
 }
 
@@ -833,21 +3478,34 @@ void Mix_FreeChunk(Mix_Chunk *chunk)
 {
     int i;
 
+    /* Shared chunks from Mix_LoadWAVCached() stay until the last one goes */
+    if (chunk && _Mix_ReleaseCachedChunk(chunk)) {
+        return;
+    }
+
     /* Caution -- if the chunk is playing, the mixer will crash */
     if (chunk) {
+        _Mix_ForgetChunkSource(chunk);
         /* Guarantee that this chunk isn't playing */
         Mix_LockAudio();
-        if (mix_channel) {
+        _Mix_UnqueueChunk(chunk);
+        _Mix_free_chunk_info(chunk);
+        if (num_channel_pages > 0) {
             for (i=0; i<num_channels; ++i) {
-                if (chunk == mix_channel[i].chunk) {
-                    mix_channel[i].playing = 0;
-                    mix_channel[i].looping = 0;
+                if (chunk == mix_channel(i).chunk) {
+                    mix_channel(i).playing = 0;
+                    mix_channel(i).looping = 0;
+                    _Mix_channel_deactivate(i);
                 }
             }
         }
         Mix_UnlockAudio();
         /* Actually free the chunk */
-        if (chunk->allocated) {
+        if (chunk->allocated == MIX_CHUNK_MAPPED) {
+            _Mix_UnmapChunk(chunk);
+        } else if (chunk->allocated == MIX_CHUNK_STREAMED) {
+            _Mix_FreeStream(chunk);
+        } else if (chunk->allocated) {
             SDL_free(chunk->abuf);
         }
         SDL_free(chunk);
@@ -865,6 +3523,22 @@ void Mix_SetPostMix(void (SDLCALL *mix_func)
     mix_postmix_data = arg;
     mix_postmix = mix_func;
     Mix_UnlockAudio();
+    if (mix_func != NULL) {
+        _Mix_WakeOutput();
+    }
+}
+
+/* The same on the float bus, before it's clipped */
+void Mix_SetPostMixFloat(void (SDLCALL *mix_func)
+                         (void *udata, float *bus, int frames, int channels), void *arg)
+{
+    Mix_LockAudio();
+    mix_postmix_float_data = arg;
+    mix_postmix_float = mix_func;
+    Mix_UnlockAudio();
+    if (mix_func != NULL) {
+        _Mix_WakeOutput();
+    }
 }
 
 /* Add your own music player or mixer function.
@@ -874,6 +3548,7 @@ void Mix_HookMusic(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len)
                                                                 void *arg)
 {
     Mix_LockAudio();
+    mix_music_float = NULL;
     if (mix_func != NULL) {
         music_data = arg;
         mix_music = mix_func;
@@ -882,6 +3557,28 @@ void Mix_HookMusic(void (SDLCALL *mix_func)(void *udata, Uint8 *stream, int len)
         mix_music = music_mixer;
     }
     Mix_UnlockAudio();
+    if (mix_func != NULL) {
+        _Mix_WakeOutput();
+    }
+}
+
+/* Add your own music player on the float bus, see Mix_HookMusic() */
+void Mix_HookMusicFloat(void (SDLCALL *mix_func)(void *udata, float *bus, int frames, int channels),
+                        void *arg)
+{
+    Mix_LockAudio();
+    mix_music = music_mixer;
+    if (mix_func != NULL) {
+        music_data = arg;
+        mix_music_float = mix_func;
+    } else {
+        music_data = NULL;
+        mix_music_float = NULL;
+    }
+    Mix_UnlockAudio();
+    if (mix_func != NULL) {
+        _Mix_WakeOutput();
+    }
 }
 
 void *Mix_GetMusicHookData(void)
@@ -896,27 +3593,352 @@ void Mix_ChannelFinished(void (SDLCALL *channel_finished)(int channel))
     Mix_UnlockAudio();
 }
 
-
-/* Reserve the first channels (0 -> n-1) for the application, i.e. don't allocate
-   them dynamically to the next sample if requested with a -1 value below.
-   Returns the number of reserved channels.
+
+/* Reserve the first channels (0 -> n-1) for the application, i.e. don't allocate
+   them dynamically to the next sample if requested with a -1 value below.
+   Returns the number of reserved channels.
+ */
+int Mix_ReserveChannels(int num)
+{
+    if (num > num_channels)
+        num = num_channels;
+    reserved_channels = num;
+    return num;
+}
+
+static int checkchunkintegral(Mix_Chunk *chunk)
+{
+    int frame_width = 1;
+
+    if ((mixer.format & 0xFF) == 16) frame_width = 2;
+    frame_width *= mixer.channels;
+    while (chunk->alen % frame_width) chunk->alen--;
+    return chunk->alen;
+}
+
+/* Find the settings of a chunk, adding them if 'create' is set.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static chunk_info *_Mix_chunk_info(Mix_Chunk *chunk, SDL_bool create)
+{
+    chunk_info *entry;
+
+    for (entry = chunk_infos; entry; entry = entry->next) {
+        if (entry->chunk == chunk) {
+            return entry;
+        }
+    }
+    if (create) {
+        entry = (chunk_info *)SDL_calloc(1, sizeof(*entry));
+        if (!entry) {
+            SDL_OutOfMemory();
+            return NULL;
+        }
+        entry->chunk = chunk;
+        entry->next = chunk_infos;
+        chunk_infos = entry;
+    }
+    return entry;
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static void _Mix_free_chunk_info(Mix_Chunk *chunk)
+{
+    chunk_info *entry, *prev = NULL;
+
+    for (entry = chunk_infos; entry; prev = entry, entry = entry->next) {
+        if (entry->chunk == chunk) {
+            if (prev) {
+                prev->next = entry->next;
+            } else {
+                chunk_infos = entry->next;
+            }
+            SDL_free(entry);
+            return;
+        }
+    }
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static int _Mix_chunk_priority(Mix_Chunk *chunk)
+{
+    chunk_info *entry = _Mix_chunk_info(chunk, SDL_FALSE);
+    return entry ? entry->priority : 0;
+}
+
+/* Set the priority of a chunk, -1 to just return the current priority */
+int Mix_PriorityChunk(Mix_Chunk *chunk, int priority)
+{
+    chunk_info *entry;
+    int prev_priority;
+
+    if (chunk == NULL) {
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    entry = _Mix_chunk_info(chunk, SDL_FALSE);
+    prev_priority = entry ? entry->priority : 0;
+    if (priority >= 0 && priority != prev_priority) {
+        entry = _Mix_chunk_info(chunk, SDL_TRUE);
+        if (entry) {
+            entry->priority = priority;
+        } else {
+            prev_priority = -1;
+        }
+    }
+    Mix_UnlockAudio();
+    return(prev_priority);
+}
+
+/* Limit how many of a chunk play at once, and how closely they can start */
+int Mix_LimitChunk(Mix_Chunk *chunk, int max_instances, int min_frames)
+{
+    chunk_info *entry;
+
+    if (chunk == NULL) {
+        Mix_SetError("Tried to limit a NULL chunk");
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    entry = _Mix_chunk_info(chunk, SDL_TRUE);
+    if (entry) {
+        entry->max_instances = SDL_max(max_instances, 0);
+        entry->min_frames = SDL_max(min_frames, 0);
+    }
+    Mix_UnlockAudio();
+    return entry ? 0 : -1;
+}
+
+/* Check the limits of a chunk before starting it.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static SDL_bool _Mix_chunk_may_start(Mix_Chunk *chunk)
+{
+    chunk_info *entry = _Mix_chunk_info(chunk, SDL_FALSE);
+    int i, instances = 0;
+
+    if (!chunk->abuf && chunk->allocated == 1) {
+        /* Evicted again since Mix_PlayChannel() brought it back */
+        Mix_SetError("Chunk was evicted before it could start");
+        return SDL_FALSE;
+    }
+    if (!entry) {
+        return SDL_TRUE;
+    }
+    if (entry->started && entry->min_frames > 0 &&
+        mix_output_frame - entry->last_start < (Uint64)entry->min_frames) {
+        Mix_SetError("Chunk was started too recently");
+        return SDL_FALSE;
+    }
+    if (entry->max_instances > 0) {
+        for (i=0; i<num_channels; ++i) {
+            if (mix_channel(i).chunk == chunk && mix_channel(i).playing > 0) {
+                ++instances;
+            }
+        }
+        if (instances >= entry->max_instances) {
+            Mix_SetError("Too many instances of the chunk playing");
+            return SDL_FALSE;
+        }
+    }
+    return SDL_TRUE;
+}
+
+int Mix_SetVoiceStealing(Mix_StealPolicy policy, int tag)
+{
+    Mix_LockAudio();
+    steal_policy = policy;
+    steal_tag = tag;
+    Mix_UnlockAudio();
+    return(0);
+}
+
+/* How loud a channel currently is, for MIX_STEAL_QUIETEST */
+static float _Mix_channel_loudness(int i)
+{
+    float level = (float)(mix_channel(i).volume * mix_channel(i).chunk->volume);
+
+    if (mix_channel(i).fading != MIX_NO_FADING) {
+        level *= _Mix_channel_fade_gain(i, mix_channel(i).fade_pos);
+    }
+    return level;
+}
+
+/* Whether channel 'i' should be stolen before channel 'victim' */
+static SDL_bool _Mix_better_victim(int i, int victim)
+{
+    switch (steal_policy) {
+    case MIX_STEAL_QUIETEST:
+        return (_Mix_channel_loudness(i) < _Mix_channel_loudness(victim)) ? SDL_TRUE : SDL_FALSE;
+    case MIX_STEAL_LOWEST_PRIORITY:
+        if (mix_channel(i).priority != mix_channel(victim).priority) {
+            return (mix_channel(i).priority < mix_channel(victim).priority) ? SDL_TRUE : SDL_FALSE;
+        }
+        /* Fall through, the oldest of the lowest goes first */
+    case MIX_STEAL_OLDEST:
+    default:
+        return (mix_channel(i).start_time < mix_channel(victim).start_time) ? SDL_TRUE : SDL_FALSE;
+    }
+}
+
+/* Find a free unreserved channel for 'chunk', stealing one if the policy
+   allows it. Channels playing something more important are never stolen.
+   Returns the channel, or -1 if there's none.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static int _Mix_free_channel(Mix_Chunk *chunk)
+{
+    int i, priority, victim = -1;
+
+    for (i=reserved_channels; i<num_channels; ++i) {
+        if (mix_channel(i).playing <= 0)
+            return i;
+    }
+    if (steal_policy == MIX_STEAL_NONE) {
+        return -1;
+    }
+
+    priority = _Mix_chunk_priority(chunk);
+    for (i=reserved_channels; i<num_channels; ++i) {
+        if (steal_tag != -1 && mix_channel(i).tag != steal_tag) {
+            continue;
+        }
+        if (mix_channel(i).priority > priority) {
+            continue;
+        }
+        if (victim < 0 || _Mix_better_victim(i, victim)) {
+            victim = i;
+        }
+    }
+    if (victim >= 0) {
+        _Mix_HaltChannel_locked(victim);
+    }
+    return victim;
+}
+
+/* Repeat a looping chunk shorter than a buffer into the channel's tile, as
+   many times as it takes to cover a buffer from anywhere in the chunk (or
+   as it will play), so it isn't mixed in a piece per repetition.  Without
+   the memory for it the chunk is mixed as it is.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static void _Mix_channel_tile(int which, const Mix_Chunk *chunk, int loops)
+{
+    const Uint32 frame_size = (SDL_AUDIO_BITSIZE(mixer.format) / 8) * mixer.channels;
+    const Uint32 alen = chunk->alen;
+    Uint32 reps, need, n;
+    Uint8 *tile;
+
+    mix_channel(which).tile_len = 0;
+    if (loops == 0 || !chunk->abuf || alen < frame_size || alen >= mixer.size ||
+        chunk->allocated == MIX_CHUNK_ADPCM || chunk->allocated == MIX_CHUNK_STREAMED ||
+        mix_channel(which).rate != MIX_RATE_ONE) {
+        return;
+    }
+
+    reps = (mixer.size + alen - 1) / alen + 1;
+    if (loops > 0 && (Uint32)loops + 1 < reps) {
+        reps = (Uint32)loops + 1;
+    }
+    need = reps * alen;
+    if (mix_channel(which).tile_size < need) {
+        /* Enough for any chunk shorter than a buffer, so it's done once */
+        tile = (Uint8 *)SDL_realloc(mix_channel(which).tile, mixer.size * 3);
+        if (!tile) {
+            return;
+        }
+        mix_channel(which).tile = tile;
+        mix_channel(which).tile_size = mixer.size * 3;
+    }
+    for (n = 0; n < need; n += alen) {
+        SDL_memcpy(mix_channel(which).tile + n, chunk->abuf, alen);
+    }
+    mix_channel(which).tile_len = need;
+}
+
+/* Point a channel at the start of a chunk.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
  */
-int Mix_ReserveChannels(int num)
+static void _Mix_channel_start(int which, Mix_Chunk *chunk, int loops)
 {
-    if (num > num_channels)
-        num = num_channels;
-    reserved_channels = num;
-    return num;
+    Mix_ChunkStream *stream = NULL;
+    chunk_info *info = _Mix_chunk_info(chunk, SDL_FALSE);
+    int i;
+
+    if (chunk->allocated == MIX_CHUNK_STREAMED) {
+        for (stream = chunk_streams; stream; stream = stream->next) {
+            if (stream->chunk == chunk) {
+                break;
+            }
+        }
+    }
+
+    mix_channel(which).samples = chunk->abuf;
+    mix_channel(which).playing = _Mix_chunk_length(chunk);
+    mix_channel(which).rate_pos = 0;
+    mix_channel(which).looping = loops;
+    mix_channel(which).chunk = chunk;
+    mix_channel(which).stream = stream;
+    _Mix_channel_tile(which, chunk, loops);
+    mix_channel(which).priority = info ? info->priority : 0;
+    if (info) {
+        /* For the retrigger interval of Mix_LimitChunk() */
+        info->started = SDL_TRUE;
+        info->last_start = mix_output_frame;
+    }
+
+    if (stream) {
+        /* There's one decoder per chunk, so it plays on one channel at a time */
+        for (i = 0; i < num_channels; ++i) {
+            if (i != which && mix_channel(i).stream == stream && mix_channel(i).playing > 0) {
+                _Mix_HaltChannel_locked(i);
+            }
+        }
+
+        /* The decoder does the looping, and rewinds when told to play */
+        mix_channel(which).looping = 0;
+        if (stream->interface->Play) {
+            stream->interface->Play(stream->context, (loops < 0) ? -1 : (loops + 1));
+        }
+        stream->pos = 0;
+        stream->fill = 0;
+        stream->done = SDL_FALSE;
+    }
 }
 
-static int checkchunkintegral(Mix_Chunk *chunk)
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static int _Mix_PlayChannel_locked(int which, Mix_Chunk *chunk, int loops, int ticks)
 {
-    int frame_width = 1;
+    /* Redundant retriggers are dropped before they take a channel */
+    if (!_Mix_chunk_may_start(chunk)) {
+        return(-1);
+    }
 
-    if ((mixer.format & 0xFF) == 16) frame_width = 2;
-    frame_width *= mixer.channels;
-    while (chunk->alen % frame_width) chunk->alen--;
-    return chunk->alen;
+    /* If which is -1, play on the first free channel */
+    if (which == -1) {
+        which = _Mix_free_channel(chunk);
+        if (which < 0) {
+            /* Commands are played from the audio callback, often in vain */
+            _Mix_SetErrorLater(NULL, "No free channels available", 0);
+        }
+    }
+
+    /* Queue up the audio data for this channel */
+    if (which >= 0 && which < num_channels) {
+        Uint32 sdl_ticks = _Mix_GetTicks();
+        if (Mix_Playing(which))
+            _Mix_channel_done_playing(which);
+        _Mix_channel_start(which, chunk, loops);
+        mix_channel(which).paused = 0;
+        mix_channel(which).fading = MIX_NO_FADING;
+        mix_channel(which).start_time = sdl_ticks;
+        mix_channel(which).expire = (ticks>0) ? (sdl_ticks + ticks) : 0;
+        mix_channel(which).start_frame = 0;
+        _Mix_channel_activate(which);
+    }
+    return(which);
 }
 
 /* Play an audio chunk on a specific channel.
@@ -927,13 +3949,14 @@ static int checkchunkintegral(Mix_Chunk *chunk)
 */
 int Mix_PlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
 {
-    int i;
-
     /* Don't play null pointers :-) */
     if (chunk == NULL) {
         Mix_SetError("Tried to play a NULL chunk");
         return(-1);
     }
+    if (_Mix_PrepareChunk(chunk) < 0) {
+        return(-1);
+    }
     if (!checkchunkintegral(chunk)) {
         Mix_SetError("Tried to play a chunk with a bad frame");
         return(-1);
@@ -941,42 +3964,54 @@ int Mix_PlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
 
     /* Lock the mixer while modifying the playing channels */
     Mix_LockAudio();
-    {
-        /* If which is -1, play on the first free channel */
-        if (which == -1) {
-            for (i=reserved_channels; i<num_channels; ++i) {
-                if (mix_channel[i].playing <= 0)
-                    break;
-            }
-            if (i == num_channels) {
-                Mix_SetError("No free channels available");
-                which = -1;
-            } else {
-                which = i;
-            }
-        }
+    which = _Mix_PlayChannel_locked(which, chunk, loops, ticks);
+    Mix_UnlockAudio();
 
-        /* Queue up the audio data for this channel */
-        if (which >= 0 && which < num_channels) {
-            Uint32 sdl_ticks = SDL_GetTicks();
-            if (Mix_Playing(which))
-                _Mix_channel_done_playing(which);
-            mix_channel[which].samples = chunk->abuf;
-            mix_channel[which].playing = chunk->alen;
-            mix_channel[which].looping = loops;
-            mix_channel[which].chunk = chunk;
-            mix_channel[which].paused = 0;
-            mix_channel[which].fading = MIX_NO_FADING;
-            mix_channel[which].start_time = sdl_ticks;
-            mix_channel[which].expire = (ticks>0) ? (sdl_ticks + ticks) : 0;
-        }
+    /* Return the channel on which the sound is being played */
+    return(which);
+}
+
+/* Play an audio chunk starting exactly at sample frame 'frame' of the
+   output clock (see Mix_GetOutputFrame()). Frames already in the past
+   start at the beginning of the next buffer.
+   Returns which channel was used to play the sound.
+*/
+int Mix_PlayChannelAt(int which, Mix_Chunk *chunk, int loops, Uint64 frame)
+{
+    /* Don't play null pointers :-) */
+    if (chunk == NULL) {
+        Mix_SetError("Tried to play a NULL chunk");
+        return(-1);
+    }
+    if (_Mix_PrepareChunk(chunk) < 0) {
+        return(-1);
+    }
+    if (!checkchunkintegral(chunk)) {
+        Mix_SetError("Tried to play a chunk with a bad frame");
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    which = _Mix_PlayChannel_locked(which, chunk, loops, -1);
+    if (which >= 0) {
+        mix_channel(which).start_frame = frame;
     }
     Mix_UnlockAudio();
 
-    /* Return the channel on which the sound is being played */
     return(which);
 }
 
+Uint64 Mix_GetOutputFrame(void)
+{
+    Uint64 frame;
+
+    /* A 64-bit read isn't atomic everywhere, so take the lock */
+    Mix_LockAudio();
+    frame = mix_output_frame;
+    Mix_UnlockAudio();
+    return(frame);
+}
+
 /* Change the expiration delay for a channel */
 int Mix_ExpireChannel(int which, int ticks)
 {
@@ -989,7 +4024,7 @@ int Mix_ExpireChannel(int which, int ticks)
         }
     } else if (which < num_channels) {
         Mix_LockAudio();
-        mix_channel[which].expire = (ticks>0) ? (SDL_GetTicks() + ticks) : 0;
+        mix_channel(which).expire = (ticks>0) ? (_Mix_GetTicks() + ticks) : 0;
         Mix_UnlockAudio();
         ++ status;
     }
@@ -999,12 +4034,13 @@ int Mix_ExpireChannel(int which, int ticks)
 /* Fade in a sound on a channel, over ms milliseconds */
 int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int ticks)
 {
-    int i;
-
     /* Don't play null pointers :-) */
     if (chunk == NULL) {
         return(-1);
     }
+    if (_Mix_PrepareChunk(chunk) < 0) {
+        return(-1);
+    }
     if (!checkchunkintegral(chunk)) {
         Mix_SetError("Tried to play a chunk with a bad frame");
         return(-1);
@@ -1012,37 +4048,28 @@ int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int t
 
     /* Lock the mixer while modifying the playing channels */
     Mix_LockAudio();
-    {
+    if (!_Mix_chunk_may_start(chunk)) {
+        which = -1;
+    } else {
         /* If which is -1, play on the first free channel */
         if (which == -1) {
-            for (i=reserved_channels; i<num_channels; ++i) {
-                if (mix_channel[i].playing <= 0)
-                    break;
-            }
-            if (i == num_channels) {
-                which = -1;
-            } else {
-                which = i;
-            }
+            which = _Mix_free_channel(chunk);
         }
 
         /* Queue up the audio data for this channel */
         if (which >= 0 && which < num_channels) {
-            Uint32 sdl_ticks = SDL_GetTicks();
+            Uint32 sdl_ticks = _Mix_GetTicks();
             if (Mix_Playing(which))
                 _Mix_channel_done_playing(which);
-            mix_channel[which].samples = chunk->abuf;
-            mix_channel[which].playing = chunk->alen;
-            mix_channel[which].looping = loops;
-            mix_channel[which].chunk = chunk;
-            mix_channel[which].paused = 0;
-            mix_channel[which].fading = MIX_FADING_IN;
-            mix_channel[which].fade_volume = mix_channel[which].volume;
-            mix_channel[which].fade_volume_reset = mix_channel[which].volume;
-            mix_channel[which].volume = 0;
-            mix_channel[which].fade_length = (Uint32)ms;
-            mix_channel[which].start_time = mix_channel[which].ticks_fade = sdl_ticks;
-            mix_channel[which].expire = (ticks > 0) ? (sdl_ticks+ticks) : 0;
+            _Mix_channel_start(which, chunk, loops);
+            mix_channel(which).paused = 0;
+            mix_channel(which).fading = MIX_FADING_IN;
+            mix_channel(which).fade_frames = _Mix_ms_to_frames(ms);
+            mix_channel(which).fade_pos = 0;
+            mix_channel(which).start_time = sdl_ticks;
+            mix_channel(which).expire = (ticks > 0) ? (sdl_ticks+ticks) : 0;
+            mix_channel(which).start_frame = 0;
+            _Mix_channel_activate(which);
         }
     }
     Mix_UnlockAudio();
@@ -1051,6 +4078,59 @@ int Mix_FadeInChannelTimed(int which, Mix_Chunk *chunk, int loops, int ms, int t
     return(which);
 }
 
+/* Play a channel faster or slower, which changes its pitch as well */
+int Mix_SetChannelRate(int which, float rate)
+{
+    Uint32 step;
+    int i;
+
+    if (!(rate >= (float)MIX_RATE_MIN / MIX_RATE_ONE && rate <= (float)MIX_RATE_MAX / MIX_RATE_ONE)) {
+        Mix_SetError("Playback rate out of range");
+        return(-1);
+    }
+    step = (Uint32)(rate * MIX_RATE_ONE + 0.5f);
+
+    Mix_LockAudio();
+    if (which == -1) {
+        for (i = 0; i < num_channels; ++i) {
+            mix_channel(i).rate = step;
+        }
+    } else if (which >= 0 && which < num_channels) {
+        mix_channel(which).rate = step;
+    }
+    Mix_UnlockAudio();
+    return(0);
+}
+
+float Mix_GetChannelRate(int which)
+{
+    if (which < 0 || which >= num_channels) {
+        return(0.0f);
+    }
+    return((float)mix_channel(which).rate / MIX_RATE_ONE);
+}
+
+int Mix_SetChannelResampler(int which, Mix_Resampler resampler)
+{
+    int i;
+
+    if (resampler != MIX_RESAMPLE_LINEAR && resampler != MIX_RESAMPLE_CUBIC) {
+        Mix_SetError("Unknown resampler");
+        return(-1);
+    }
+
+    Mix_LockAudio();
+    if (which == -1) {
+        for (i = 0; i < num_channels; ++i) {
+            mix_channel(i).resampler = resampler;
+        }
+    } else if (which >= 0 && which < num_channels) {
+        mix_channel(which).resampler = resampler;
+    }
+    Mix_UnlockAudio();
+    return(0);
+}
+
 /* Set volume of a particular channel */
 int Mix_Volume(int which, int volume)
 {
@@ -1063,12 +4143,12 @@ int Mix_Volume(int which, int volume)
         }
         prev_volume /= num_channels;
     } else if (which < num_channels) {
-        prev_volume = mix_channel[which].volume;
+        prev_volume = mix_channel(which).volume;
         if (volume >= 0) {
             if (volume > MIX_MAX_VOLUME) {
                 volume = MIX_MAX_VOLUME;
             }
-            mix_channel[which].volume = volume;
+            mix_channel(which).volume = volume;
         }
     }
     return(prev_volume);
@@ -1088,6 +4168,19 @@ int Mix_VolumeChunk(Mix_Chunk *chunk, int volume)
     return(prev_volume);
 }
 
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static void _Mix_HaltChannel_locked(int which)
+{
+    if (mix_channel(which).playing) {
+        _Mix_channel_done_playing(which);
+        mix_channel(which).playing = 0;
+        mix_channel(which).looping = 0;
+    }
+    _Mix_channel_deactivate(which);
+    mix_channel(which).expire = 0;
+    mix_channel(which).fading = MIX_NO_FADING;
+}
+
 /* Halt playing of a particular channel */
 int Mix_HaltChannel(int which)
 {
@@ -1099,79 +4192,273 @@ int Mix_HaltChannel(int which)
         }
     } else if (which < num_channels) {
         Mix_LockAudio();
-        if (mix_channel[which].playing) {
-            _Mix_channel_done_playing(which);
-            mix_channel[which].playing = 0;
-            mix_channel[which].looping = 0;
-        }
-        mix_channel[which].expire = 0;
-        if(mix_channel[which].fading != MIX_NO_FADING) /* Restore volume */
-            mix_channel[which].volume = mix_channel[which].fade_volume_reset;
-        mix_channel[which].fading = MIX_NO_FADING;
+        _Mix_HaltChannel_locked(which);
         Mix_UnlockAudio();
     }
-    return(0);
+    return(0);
+}
+
+/* Halt playing of a particular group of channels */
+int Mix_HaltGroup(int tag)
+{
+    mix_group *group;
+    int i, next;
+
+    Mix_LockAudio();
+    group = _Mix_find_group(tag);
+    for (i = group ? group->first : -1; i >= 0; i = next) {
+        next = mix_channel(i).group_next;
+        _Mix_HaltChannel_locked(i);
+        if (next >= 0 && mix_channel(next).tag != tag) {
+            /* The channel finished callback regrouped it, start over */
+            group = _Mix_find_group(tag);
+            next = group ? group->first : -1;
+        }
+    }
+    Mix_UnlockAudio();
+    return(0);
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+static int _Mix_FadeOutChannel_locked(int which, int ms)
+{
+    if (mix_channel(which).playing &&
+        (mix_channel(which).volume > 0) &&
+        (mix_channel(which).fading != MIX_FADING_OUT)) {
+        Uint32 frames = _Mix_ms_to_frames(ms);
+        float level = 1.0f;
+
+        /* Pick up a fade in from wherever it got to */
+        if (mix_channel(which).fading == MIX_FADING_IN) {
+            level = _Mix_channel_fade_gain(which, mix_channel(which).fade_pos);
+        }
+        mix_channel(which).fading = MIX_FADING_OUT;
+        mix_channel(which).fade_frames = frames;
+        mix_channel(which).fade_pos = (Uint32)((1.0f - level) * frames);
+        return(1);
+    }
+    return(0);
+}
+
+/* Fade out a channel and then stop it automatically */
+int Mix_FadeOutChannel(int which, int ms)
+{
+    int status;
+
+    status = 0;
+    if (audio_opened) {
+        if (which == -1) {
+            int i;
+
+            for (i=0; i<num_channels; ++i) {
+                status += Mix_FadeOutChannel(i, ms);
+            }
+        } else if (which < num_channels) {
+            Mix_LockAudio();
+            status += _Mix_FadeOutChannel_locked(which, ms);
+            Mix_UnlockAudio();
+        }
+    }
+    return(status);
+}
+
+/* Halt playing of a particular group of channels */
+int Mix_FadeOutGroup(int tag, int ms)
+{
+    int i;
+    int status = 0;
+    for (i=0; i<num_channels; ++i) {
+        if(mix_channel(i).tag == tag) {
+            status += Mix_FadeOutChannel(i,ms);
+        }
+    }
+    return(status);
+}
+
+/*
+ * Single producer, single consumer command queue.
+ *  One application thread pushes commands without taking the audio lock,
+ *  and the mixing callback drains them before it mixes anything.
+ */
+typedef enum
+{
+    MIX_COMMAND_PLAY,
+    MIX_COMMAND_VOLUME,
+    MIX_COMMAND_HALT,
+    MIX_COMMAND_FADEOUT
+} Mix_CommandType;
+
+typedef struct
+{
+    Mix_CommandType type;
+    int channel;
+    Mix_Chunk *chunk;
+    int loops;
+    int value;      /* ticks for PLAY, volume for VOLUME, ms for FADEOUT */
+} Mix_Command;
+
+#define MIX_COMMAND_QUEUE_SIZE  256     /* must be a power of two */
+
+static Mix_Command command_queue[MIX_COMMAND_QUEUE_SIZE];
+static SDL_atomic_t command_head;   /* only written by the producer */
+static SDL_atomic_t command_tail;   /* only written by the callback */
+
+static int _Mix_QueueCommand(Mix_CommandType type, int channel, Mix_Chunk *chunk, int loops, int value)
+{
+    int head, tail;
+    Mix_Command *cmd;
+
+    if (!audio_opened) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(-1);
+    }
+    if (channel < -1 || channel >= num_channels) {
+        Mix_SetError("Invalid channel number");
+        return(-1);
+    }
+
+    head = SDL_AtomicGet(&command_head);
+    tail = SDL_AtomicGet(&command_tail);
+    if (head - tail >= MIX_COMMAND_QUEUE_SIZE) {
+        Mix_SetError("Command queue is full");
+        return(-1);
+    }
+
+    cmd = &command_queue[head & (MIX_COMMAND_QUEUE_SIZE - 1)];
+    cmd->type = type;
+    cmd->channel = channel;
+    cmd->chunk = chunk;
+    cmd->loops = loops;
+    cmd->value = value;
+
+    /* Publish the command only once it's completely written */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&command_head, head + 1);
+    _Mix_WakeOutput();
+    return(0);
+}
+
+/* Only ever called from the audio callback */
+static SDL_bool _Mix_CommandsPending(void)
+{
+    return (SDL_AtomicGet(&command_head) != SDL_AtomicGet(&command_tail));
+}
+
+/* Only ever called from the audio callback */
+static void _Mix_DrainCommands(void)
+{
+    int head = SDL_AtomicGet(&command_head);
+    int tail = SDL_AtomicGet(&command_tail);
+    int i;
+
+    SDL_MemoryBarrierAcquire();
+    for (; tail != head; ++tail) {
+        const Mix_Command *cmd = &command_queue[tail & (MIX_COMMAND_QUEUE_SIZE - 1)];
+
+        switch (cmd->type) {
+        case MIX_COMMAND_PLAY:
+            /* The chunk is cleared if it was freed while queued */
+            if (cmd->chunk) {
+                _Mix_PlayChannel_locked(cmd->channel, cmd->chunk, cmd->loops, cmd->value);
+            }
+            break;
+        case MIX_COMMAND_VOLUME:
+            Mix_Volume(cmd->channel, cmd->value);
+            break;
+        case MIX_COMMAND_HALT:
+            if (cmd->channel == -1) {
+                for (i=0; i<num_channels; ++i) {
+                    _Mix_HaltChannel_locked(i);
+                }
+            } else if (cmd->channel < num_channels) {
+                _Mix_HaltChannel_locked(cmd->channel);
+            }
+            break;
+        case MIX_COMMAND_FADEOUT:
+            if (cmd->channel == -1) {
+                for (i=0; i<num_channels; ++i) {
+                    _Mix_FadeOutChannel_locked(i, cmd->value);
+                }
+            } else if (cmd->channel < num_channels) {
+                _Mix_FadeOutChannel_locked(cmd->channel, cmd->value);
+            }
+            break;
+        }
+    }
+
+    /* Let the producer reuse the slots only after we're done reading them */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&command_tail, tail);
+}
+
+/* Forget about a chunk that is about to be freed.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static void _Mix_UnqueueChunk(Mix_Chunk *chunk)
+{
+    int head = SDL_AtomicGet(&command_head);
+    int tail = SDL_AtomicGet(&command_tail);
+
+    for (; tail != head; ++tail) {
+        Mix_Command *cmd = &command_queue[tail & (MIX_COMMAND_QUEUE_SIZE - 1)];
+        if (cmd->chunk == chunk) {
+            cmd->chunk = NULL;
+        }
+    }
+}
+
+/* Whether a channel is playing the chunk, or about to.
+   MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this!
+ */
+static SDL_bool _Mix_chunk_in_use(const Mix_Chunk *chunk)
+{
+    int head = SDL_AtomicGet(&command_head);
+    int tail = SDL_AtomicGet(&command_tail);
+    int i;
+
+    for (i = 0; i < num_channels; ++i) {
+        if (mix_channel(i).chunk == chunk && mix_channel(i).active >= 0) {
+            return SDL_TRUE;
+        }
+    }
+    for (; tail != head; ++tail) {
+        if (command_queue[tail & (MIX_COMMAND_QUEUE_SIZE - 1)].chunk == chunk) {
+            return SDL_TRUE;
+        }
+    }
+    return SDL_FALSE;
+}
+
+int Mix_QueuePlayChannelTimed(int which, Mix_Chunk *chunk, int loops, int ticks)
+{
+    /* Don't play null pointers :-) */
+    if (chunk == NULL) {
+        Mix_SetError("Tried to play a NULL chunk");
+        return(-1);
+    }
+    if (_Mix_PrepareChunk(chunk) < 0) {
+        return(-1);
+    }
+    if (!checkchunkintegral(chunk)) {
+        Mix_SetError("Tried to play a chunk with a bad frame");
+        return(-1);
+    }
+    return _Mix_QueueCommand(MIX_COMMAND_PLAY, which, chunk, loops, ticks);
 }
 
-/* Halt playing of a particular group of channels */
-int Mix_HaltGroup(int tag)
+int Mix_QueueVolume(int which, int volume)
 {
-    int i;
-
-    for (i=0; i<num_channels; ++i) {
-        if(mix_channel[i].tag == tag) {
-            Mix_HaltChannel(i);
-        }
-    }
-    return(0);
+    return _Mix_QueueCommand(MIX_COMMAND_VOLUME, which, NULL, 0, volume);
 }
 
-/* Fade out a channel and then stop it automatically */
-int Mix_FadeOutChannel(int which, int ms)
+int Mix_QueueHaltChannel(int which)
 {
-    int status;
-
-    status = 0;
-    if (audio_opened) {
-        if (which == -1) {
-            int i;
-
-            for (i=0; i<num_channels; ++i) {
-                status += Mix_FadeOutChannel(i, ms);
-            }
-        } else if (which < num_channels) {
-            Mix_LockAudio();
-            if (mix_channel[which].playing &&
-                (mix_channel[which].volume > 0) &&
-                (mix_channel[which].fading != MIX_FADING_OUT)) {
-                mix_channel[which].fade_volume = mix_channel[which].volume;
-                mix_channel[which].fading = MIX_FADING_OUT;
-                mix_channel[which].fade_length = (Uint32)ms;
-                mix_channel[which].ticks_fade = SDL_GetTicks();
-
-                /* only change fade_volume_reset if we're not fading. */
-                if (mix_channel[which].fading == MIX_NO_FADING) {
-                    mix_channel[which].fade_volume_reset = mix_channel[which].volume;
-                }
-                ++status;
-            }
-            Mix_UnlockAudio();
-        }
-    }
-    return(status);
+    return _Mix_QueueCommand(MIX_COMMAND_HALT, which, NULL, 0, 0);
 }
 
-/* Halt playing of a particular group of channels */
-int Mix_FadeOutGroup(int tag, int ms)
+int Mix_QueueFadeOutChannel(int which, int ms)
 {
-    int i;
-    int status = 0;
-    for (i=0; i<num_channels; ++i) {
-        if(mix_channel[i].tag == tag) {
-            status += Mix_FadeOutChannel(i,ms);
-        }
-    }
-    return(status);
+    return _Mix_QueueCommand(MIX_COMMAND_FADEOUT, which, NULL, 0, ms);
 }
 
 Mix_Fading Mix_FadingChannel(int which)
@@ -1179,7 +4466,7 @@ Mix_Fading Mix_FadingChannel(int which)
     if (which < 0 || which >= num_channels) {
         return MIX_NO_FADING;
     }
-    return mix_channel[which].fading;
+    return mix_channel(which).fading;
 }
 
 /* Check the status of a specific channel.
@@ -1191,18 +4478,20 @@ int Mix_Playing(int which)
 
     status = 0;
     if (which == -1) {
-        int i;
+        int n;
 
-        for (i=0; i<num_channels; ++i) {
-            if ((mix_channel[i].playing > 0) ||
-                mix_channel[i].looping)
+        /* Only the active channels can be playing */
+        for (n=0; n<num_active; ++n) {
+            int i = active_channels[n];
+            if ((mix_channel(i).playing > 0) ||
+                mix_channel(i).looping)
             {
                 ++status;
             }
         }
     } else if (which < num_channels) {
-        if ((mix_channel[which].playing > 0) ||
-             mix_channel[which].looping)
+        if ((mix_channel(which).playing > 0) ||
+             mix_channel(which).looping)
         {
             ++status;
         }
@@ -1216,7 +4505,7 @@ Mix_Chunk *Mix_GetChunk(int channel)
     Mix_Chunk *retval = NULL;
 
     if ((channel >= 0) && (channel < num_channels)) {
-        retval = mix_channel[channel].chunk;
+        retval = mix_channel(channel).chunk;
     }
 
     return(retval);
@@ -1229,18 +4518,38 @@ void Mix_CloseAudio(void)
 
     if (audio_opened) {
         if (audio_opened == 1) {
+            _Mix_StopLoaders();
+            _Mix_StopChunkConversion();
             for (i = 0; i < num_channels; i++) {
                 Mix_UnregisterAllEffects(i);
             }
+            for (i = 0; i < num_submixes; i++) {
+                Mix_UnregisterAllEffects(MIX_BUS_CHANNEL(i));
+            }
             Mix_UnregisterAllEffects(MIX_CHANNEL_POST);
+            Mix_LockAudio();
+            _Mix_SetSendEffect_locked(NULL, NULL);
+            Mix_UnlockAudio();
             close_music();
             Mix_SetMusicCMD(NULL);
             Mix_HaltChannel(-1);
             _Mix_DeinitEffects();
-            SDL_CloseAudioDevice(audio_device);
+            if (audio_native) {
+                _Mix_OpenSLES_Close();
+            } else if (!audio_offline) {
+                SDL_CloseAudioDevice(audio_device);
+            }
+            _Mix_StopMixWorkers();
             audio_device = 0;
-            SDL_free(mix_channel);
-            mix_channel = NULL;
+            audio_offline = SDL_FALSE;
+            audio_native = SDL_FALSE;
+            _Mix_StopAnalysis();
+            SDL_AtomicSet(&output_suspended, 0);
+            SDL_AtomicSet(&output_paused, 0);
+            idle_frames = 0;
+            _Mix_free_device_buffers();
+            SDL_AtomicSet(&command_head, 0);
+            SDL_AtomicSet(&command_tail, 0);
 
             /* rcg06042009 report available decoders at runtime. */
             SDL_free((void *)chunk_decoders);
@@ -1254,18 +4563,18 @@ void Mix_CloseAudio(void)
 /* Pause a particular channel (or all) */
 void Mix_Pause(int which)
 {
-    Uint32 sdl_ticks = SDL_GetTicks();
+    Uint32 sdl_ticks = _Mix_GetTicks();
     if (which == -1) {
         int i;
 
         for (i=0; i<num_channels; ++i) {
-            if (mix_channel[i].playing > 0) {
-                mix_channel[i].paused = sdl_ticks;
+            if (mix_channel(i).playing > 0) {
+                mix_channel(i).paused = sdl_ticks;
             }
         }
     } else if (which < num_channels) {
-        if (mix_channel[which].playing > 0) {
-            mix_channel[which].paused = sdl_ticks;
+        if (mix_channel(which).playing > 0) {
+            mix_channel(which).paused = sdl_ticks;
         }
     }
 }
@@ -1273,24 +4582,24 @@ void Mix_Pause(int which)
 /* Resume a paused channel */
 void Mix_Resume(int which)
 {
-    Uint32 sdl_ticks = SDL_GetTicks();
+    Uint32 sdl_ticks = _Mix_GetTicks();
 
     Mix_LockAudio();
     if (which == -1) {
         int i;
 
         for (i=0; i<num_channels; ++i) {
-            if (mix_channel[i].playing > 0) {
-                if(mix_channel[i].expire > 0)
-                    mix_channel[i].expire += sdl_ticks - mix_channel[i].paused;
-                mix_channel[i].paused = 0;
+            if (mix_channel(i).playing > 0) {
+                if(mix_channel(i).expire > 0)
+                    mix_channel(i).expire += sdl_ticks - mix_channel(i).paused;
+                mix_channel(i).paused = 0;
             }
         }
     } else if (which < num_channels) {
-        if (mix_channel[which].playing > 0) {
-            if(mix_channel[which].expire > 0)
-                mix_channel[which].expire += sdl_ticks - mix_channel[which].paused;
-            mix_channel[which].paused = 0;
+        if (mix_channel(which).playing > 0) {
+            if(mix_channel(which).expire > 0)
+                mix_channel(which).expire += sdl_ticks - mix_channel(which).paused;
+            mix_channel(which).paused = 0;
         }
     }
     Mix_UnlockAudio();
@@ -1302,13 +4611,13 @@ int Mix_Paused(int which)
         int status = 0;
         int i;
         for(i=0; i < num_channels; ++i) {
-            if (mix_channel[i].paused) {
+            if (mix_channel(i).paused) {
                 ++ status;
             }
         }
         return(status);
     } else if (which < num_channels) {
-        return(mix_channel[which].paused != 0);
+        return(mix_channel(which).paused != 0);
     } else {
         return(0);
     }
@@ -1317,11 +4626,19 @@ int Mix_Paused(int which)
 /* Change the group of a channel */
 int Mix_GroupChannel(int which, int tag)
 {
-    if (which < 0 || which > num_channels)
+    if (which < 0 || which >= num_channels)
         return(0);
 
     Mix_LockAudio();
-    mix_channel[which].tag = tag;
+    if (mix_channel(which).tag != tag) {
+        if (!_Mix_find_group(tag) && _Mix_reserve_group() < 0) {
+            Mix_UnlockAudio();
+            Mix_SetError("Out of memory");
+            return(0);
+        }
+        _Mix_group_remove(which);
+        _Mix_group_add(which, tag);
+    }
     Mix_UnlockAudio();
     return(1);
 }
@@ -1339,56 +4656,250 @@ int Mix_GroupChannels(int from, int to, int tag)
 /* Finds the first available channel in a group of channels */
 int Mix_GroupAvailable(int tag)
 {
-    int i;
-    for(i=0; i < num_channels; i ++) {
-        if (((tag == -1) || (tag == mix_channel[i].tag)) &&
-                            (mix_channel[i].playing <= 0))
-            return i;
+    mix_group *group;
+    int i, chan = -1;
+
+    Mix_LockAudio();
+    if (tag == -1) {
+        for (i = 0; i < num_channels; ++i) {
+            if (mix_channel(i).playing <= 0) {
+                chan = i;
+                break;
+            }
+        }
+    } else if ((group = _Mix_find_group(tag)) != NULL) {
+        for (i = group->first; i >= 0; i = mix_channel(i).group_next) {
+            if (mix_channel(i).playing <= 0) {
+                chan = i;
+                break;
+            }
+        }
     }
-    return(-1);
+    Mix_UnlockAudio();
+    return(chan);
 }
 
 int Mix_GroupCount(int tag)
 {
-    int count = 0;
-    int i;
-    for(i=0; i < num_channels; i ++) {
-        if (mix_channel[i].tag==tag || tag==-1)
-            ++ count;
+    mix_group *group;
+    int count = num_channels;
+
+    if (tag != -1) {
+        Mix_LockAudio();
+        group = _Mix_find_group(tag);
+        count = group ? group->count : 0;
+        Mix_UnlockAudio();
     }
     return(count);
 }
 
-/* Finds the "oldest" sample playing in a group of channels */
-int Mix_GroupOldest(int tag)
+/* The playing channel of a group that started first, or last if 'newest'.
+   Of those that started at the same time the highest channel wins. */
+static int _Mix_group_pick(int tag, SDL_bool newest)
 {
-    int chan = -1;
-    Uint32 mintime = SDL_GetTicks();
-    int i;
-    for(i=0; i < num_channels; i ++) {
-        if ((mix_channel[i].tag==tag || tag==-1) && mix_channel[i].playing > 0
-             && mix_channel[i].start_time <= mintime) {
-            mintime = mix_channel[i].start_time;
-            chan = i;
+    mix_group *group;
+    Uint32 best = newest ? 0 : _Mix_GetTicks();
+    int n, i, chan = -1;
+
+    Mix_LockAudio();
+    /* -1 is all the channels, of which only the active ones can be playing */
+    group = (tag == -1) ? NULL : _Mix_find_group(tag);
+    n = 0;
+    i = (tag == -1) ? (num_active > 0 ? active_channels[0] : -1) : (group ? group->first : -1);
+    while (i >= 0) {
+        if (mix_channel(i).playing > 0) {
+            Uint32 start = mix_channel(i).start_time;
+            if ((newest ? start > best : start < best) || (start == best && i > chan)) {
+                best = start;
+                chan = i;
+            }
+        }
+        if (tag == -1) {
+            i = (++n < num_active) ? active_channels[n] : -1;
+        } else {
+            i = mix_channel(i).group_next;
         }
     }
+    Mix_UnlockAudio();
     return(chan);
 }
 
+/* Finds the "oldest" sample playing in a group of channels */
+int Mix_GroupOldest(int tag)
+{
+    return _Mix_group_pick(tag, SDL_FALSE);
+}
+
 /* Finds the "most recent" (i.e. last) sample playing in a group of channels */
 int Mix_GroupNewer(int tag)
 {
-    int chan = -1;
-    Uint32 maxtime = 0;
+    return _Mix_group_pick(tag, SDL_TRUE);
+}
+
+/* Submix buses */
+
+int Mix_GetBus(const char *name)
+{
     int i;
-    for(i=0; i < num_channels; i ++) {
-        if ((mix_channel[i].tag==tag || tag==-1) && mix_channel[i].playing > 0
-             && mix_channel[i].start_time >= maxtime) {
-            maxtime = mix_channel[i].start_time;
-            chan = i;
+
+    if (name == NULL) {
+        return(-1);
+    }
+    for (i = 0; i < num_submixes; ++i) {
+        if (SDL_strcmp(submixes[i].name, name) == 0) {
+            return(i);
         }
     }
-    return(chan);
+    return(-1);
+}
+
+int Mix_CreateBus(const char *name)
+{
+    float *buffers[MIX_MAX_MIX_THREADS + 1];
+    const size_t size = (num_submixes + 1) * mix_bus_samples * sizeof(float);
+    mix_submix *list, *prev_list;
+    char *copy;
+    int bus, n, w;
+
+    if (name == NULL) {
+        Mix_SetError("NULL bus name");
+        return(-1);
+    }
+    bus = Mix_GetBus(name);
+    if (bus >= 0) {
+        return(bus);
+    }
+    if (!audio_opened) {
+        Mix_SetError("Audio device hasn't been opened");
+        return(-1);
+    }
+
+    /* Allocate everything up front, so the callback is only held up for
+       the pointers to be swapped. There's a submix buffer per thread. */
+    n = num_mix_workers + 1;
+    list = (mix_submix *)SDL_malloc((num_submixes + 1) * sizeof(mix_submix));
+    copy = SDL_strdup(name);
+    for (w = 0; w < n; ++w) {
+        buffers[w] = (float *)SDL_malloc(size);
+        if (buffers[w] == NULL) {
+            break;
+        }
+    }
+    if (!list || !copy || w < n) {
+        while (w-- > 0) {
+            SDL_free(buffers[w]);
+        }
+        SDL_free(copy);
+        SDL_free(list);
+        Mix_SetError("Out of memory");
+        return(-1);
+    }
+    if (num_submixes > 0) {
+        SDL_memcpy(list, submixes, num_submixes * sizeof(mix_submix));
+    }
+    list[num_submixes].name = copy;
+    list[num_submixes].volume = MIX_MAX_VOLUME;
+    list[num_submixes].gain = 1.0f;
+    list[num_submixes].effects = NULL;
+
+    Mix_LockAudio();
+    prev_list = submixes;
+    submixes = list;
+    list = prev_list;
+    for (w = 0; w < n; ++w) {
+        mix_scratch *scratch = (w == 0) ? &audio_scratch : &mix_workers[w - 1].scratch;
+        float *prev = scratch->submix;
+        scratch->submix = buffers[w];
+        buffers[w] = prev;
+    }
+    bus = num_submixes++;
+    Mix_UnlockAudio();
+
+    /* The old ones, now that nothing mixes into them */
+    SDL_free(list);
+    for (w = 0; w < n; ++w) {
+        SDL_free(buffers[w]);
+    }
+    return(bus);
+}
+
+int Mix_RouteChannel(int which, int bus)
+{
+    int i;
+
+    if (bus < MIX_BUS_MASTER || bus >= num_submixes) {
+        Mix_SetError("Invalid bus number");
+        return(0);
+    }
+    if (which == -1) {
+        Mix_LockAudio();
+        for (i = 0; i < num_channels; ++i) {
+            mix_channel(i).submix = bus;
+        }
+        Mix_UnlockAudio();
+        return(1);
+    }
+    if (which < 0 || which >= num_channels) {
+        Mix_SetError("Invalid channel number");
+        return(0);
+    }
+
+    Mix_LockAudio();
+    mix_channel(which).submix = bus;
+    Mix_UnlockAudio();
+    return(1);
+}
+
+int Mix_RouteGroup(int tag, int bus)
+{
+    int count = 0;
+    int i;
+
+    if (bus < MIX_BUS_MASTER || bus >= num_submixes) {
+        Mix_SetError("Invalid bus number");
+        return(0);
+    }
+
+    Mix_LockAudio();
+    for (i = 0; i < num_channels; ++i) {
+        if (mix_channel(i).tag == tag || tag == -1) {
+            mix_channel(i).submix = bus;
+            ++count;
+        }
+    }
+    Mix_UnlockAudio();
+    return(count);
+}
+
+int Mix_RouteMusic(int bus)
+{
+    if (bus < MIX_BUS_MASTER || bus >= num_submixes) {
+        Mix_SetError("Invalid bus number");
+        return(0);
+    }
+
+    Mix_LockAudio();
+    music_submix = bus;
+    Mix_UnlockAudio();
+    return(1);
+}
+
+int Mix_BusVolume(int bus, int volume)
+{
+    int prev_volume;
+
+    if (bus < 0 || bus >= num_submixes) {
+        Mix_SetError("Invalid bus number");
+        return(-1);
+    }
+    prev_volume = submixes[bus].volume;
+    if (volume >= 0) {
+        if (volume > MIX_MAX_VOLUME) {
+            volume = MIX_MAX_VOLUME;
+        }
+        submixes[bus].volume = volume;
+    }
+    return(prev_volume);
 }
 
 
@@ -1400,8 +4911,8 @@ int Mix_GroupNewer(int tag)
  */
 
 /* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
-static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f,
-                Mix_EffectDone_t d, void *arg)
+static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f, Mix_EffectCopyFunc_t c,
+                Mix_EffectDone_t d, _Mix_EffectGains_t g, _Mix_EffectBus_t b, void *arg)
 {
     effect_info *new_e;
 
@@ -1410,7 +4921,7 @@ static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f,
         return(0);
     }
 
-    if (f == NULL) {
+    if (f == NULL && b == NULL) {
         Mix_SetError("NULL effect callback");
         return(0);
     }
@@ -1423,6 +4934,9 @@ static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f,
 
     new_e->callback = f;
     new_e->done_callback = d;
+    new_e->copy = c;
+    new_e->gains = g;
+    new_e->bus = b;
     new_e->udata = arg;
     new_e->next = NULL;
 
@@ -1445,7 +4959,7 @@ static int _Mix_register_effect(effect_info **e, Mix_EffectFunc_t f,
 
 
 /* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
-static int _Mix_remove_effect(int channel, effect_info **e, Mix_EffectFunc_t f)
+static int _Mix_remove_effect(int channel, effect_info **e, Mix_EffectFunc_t f, _Mix_EffectBus_t b)
 {
     effect_info *cur;
     effect_info *prev = NULL;
@@ -1457,7 +4971,7 @@ static int _Mix_remove_effect(int channel, effect_info **e, Mix_EffectFunc_t f)
     }
 
     for (cur = *e; cur != NULL; cur = cur->next) {
-        if (cur->callback == f) {
+        if ((f != NULL) ? (cur->callback == f) : (cur->bus == b)) {
             next = cur->next;
             if (cur->done_callback != NULL) {
                 cur->done_callback(channel, cur->udata);
@@ -1503,23 +5017,99 @@ static int _Mix_remove_all_effects(int channel, effect_info **e)
 }
 
 
+/* The effect list of a channel, of MIX_CHANNEL_POST or of a submix bus */
+static effect_info **_Mix_effect_list(int channel)
+{
+    if (channel == MIX_CHANNEL_POST) {
+        return &posteffects;
+    }
+    if (channel <= MIX_BUS_CHANNEL(0)) {
+        if (MIX_BUS_CHANNEL(0) - channel >= num_submixes) {
+            Mix_SetError("Invalid bus number");
+            return NULL;
+        }
+        return &submixes[MIX_BUS_CHANNEL(0) - channel].effects;
+    }
+    if ((channel < 0) || (channel >= num_channels)) {
+        Mix_SetError("Invalid channel number");
+        return NULL;
+    }
+    return &mix_channel(channel).effects;
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+int _Mix_RegisterGainEffect_locked(int channel, Mix_EffectFunc_t f,
+            Mix_EffectCopyFunc_t c, Mix_EffectDone_t d, _Mix_EffectGains_t g, void *arg)
+{
+    effect_info **e = _Mix_effect_list(channel);
+
+    if (e == NULL) {
+        return(0);
+    }
+    return _Mix_register_effect(e, f, c, d, g, NULL, arg);
+}
+
 /* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
-int _Mix_RegisterEffect_locked(int channel, Mix_EffectFunc_t f,
+int _Mix_RegisterBusEffect_locked(int channel, _Mix_EffectBus_t f,
             Mix_EffectDone_t d, void *arg)
 {
-    effect_info **e = NULL;
+    effect_info **e = _Mix_effect_list(channel);
 
-    if (channel == MIX_CHANNEL_POST) {
-        e = &posteffects;
-    } else {
-        if ((channel < 0) || (channel >= num_channels)) {
-            Mix_SetError("Invalid channel number");
-            return(0);
-        }
-        e = &mix_channel[channel].effects;
+    if (e == NULL) {
+        return(0);
+    }
+    if (f == NULL) {
+        Mix_SetError("NULL effect callback");
+        return(0);
+    }
+    return _Mix_register_effect(e, NULL, NULL, d, NULL, f, arg);
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+int _Mix_UnregisterBusEffect_locked(int channel, _Mix_EffectBus_t f)
+{
+    effect_info **e = _Mix_effect_list(channel);
+
+    if (e == NULL) {
+        return(0);
+    }
+    return _Mix_remove_effect(channel, e, NULL, f);
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+void _Mix_SetSendEffect_locked(_Mix_EffectSend_t f, void *arg)
+{
+    mix_send_effect = f;
+    mix_send_data = arg;
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+int _Mix_SetChannelSend_locked(int channel, float level)
+{
+    if ((channel < 0) || (channel >= num_channels)) {
+        Mix_SetError("Invalid channel number");
+        return(0);
+    }
+    mix_channel(channel).send = level;
+    return(1);
+}
+
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+int _Mix_SetChannelReverse_locked(int channel, int flip)
+{
+    if ((channel < 0) || (channel >= num_channels)) {
+        Mix_SetError("Invalid channel number");
+        return(0);
     }
+    mix_channel(channel).reverse = flip ? 1 : 0;
+    return(1);
+}
 
-    return _Mix_register_effect(e, f, d, arg);
+/* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
+int _Mix_RegisterEffect_locked(int channel, Mix_EffectFunc_t f,
+            Mix_EffectDone_t d, void *arg)
+{
+    return _Mix_RegisterGainEffect_locked(channel, f, NULL, d, NULL, arg);
 }
 
 int Mix_RegisterEffect(int channel, Mix_EffectFunc_t f,
@@ -1532,23 +5122,30 @@ int Mix_RegisterEffect(int channel, Mix_EffectFunc_t f,
     return retval;
 }
 
+int Mix_RegisterCopyEffect(int channel, Mix_EffectFunc_t f,
+            Mix_EffectCopyFunc_t copy, Mix_EffectDone_t d, void *arg)
+{
+    int retval;
+    Mix_LockAudio();
+    retval = _Mix_RegisterGainEffect_locked(channel, f, copy, d, NULL, arg);
+    Mix_UnlockAudio();
+    return retval;
+}
+
 
 /* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
 int _Mix_UnregisterEffect_locked(int channel, Mix_EffectFunc_t f)
 {
-    effect_info **e = NULL;
+    effect_info **e = _Mix_effect_list(channel);
 
-    if (channel == MIX_CHANNEL_POST) {
-        e = &posteffects;
-    } else {
-        if ((channel < 0) || (channel >= num_channels)) {
-            Mix_SetError("Invalid channel number");
-            return(0);
-        }
-        e = &mix_channel[channel].effects;
+    if (e == NULL) {
+        return(0);
     }
-
-    return _Mix_remove_effect(channel, e, f);
+    if (f == NULL) {
+        Mix_SetError("No such effect registered");
+        return(0);
+    }
+    return _Mix_remove_effect(channel, e, f, NULL);
 }
 
 int Mix_UnregisterEffect(int channel, Mix_EffectFunc_t f)
@@ -1563,18 +5160,15 @@ int Mix_UnregisterEffect(int channel, Mix_EffectFunc_t f)
 /* MAKE SURE you hold the audio lock (Mix_LockAudio()) before calling this! */
 int _Mix_UnregisterAllEffects_locked(int channel)
 {
-    effect_info **e = NULL;
+    effect_info **e = _Mix_effect_list(channel);
 
-    if (channel == MIX_CHANNEL_POST) {
-        e = &posteffects;
-    } else {
-        if ((channel < 0) || (channel >= num_channels)) {
-            Mix_SetError("Invalid channel number");
-            return(0);
-        }
-        e = &mix_channel[channel].effects;
+    if (e == NULL) {
+        return(0);
+    }
+    if (channel >= 0) {
+        /* Still counts as an effect, as it was one */
+        mix_channel(channel).reverse = 0;
     }
-
     return _Mix_remove_all_effects(channel, e);
 }
 
@@ -1587,14 +5181,23 @@ int Mix_UnregisterAllEffects(int channel)
     return(retval);
 }
 
+/* Offline there's no device thread, so the caller's own thread is the lock */
 void Mix_LockAudio(void)
 {
-    SDL_LockAudioDevice(audio_device);
+    if (audio_native) {
+        _Mix_OpenSLES_Lock();
+    } else if (!audio_offline) {
+        SDL_LockAudioDevice(audio_device);
+    }
 }
 
 void Mix_UnlockAudio(void)
 {
-    SDL_UnlockAudioDevice(audio_device);
+    if (audio_native) {
+        _Mix_OpenSLES_Unlock();
+    } else if (!audio_offline) {
+        SDL_UnlockAudioDevice(audio_device);
+    }
 }
 
 /* end of mixer.c ... */
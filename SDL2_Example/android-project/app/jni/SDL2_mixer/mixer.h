@@ -25,4 +25,18 @@ extern void Mix_UnlockAudio(void);
 
 extern void add_chunk_decoder(const char *decoder);
 
+/* Report an error without making its message: the audio and decode
+   threads fail the same way buffer after buffer, mostly with no one there
+   to read it.  'format' sets the error from 'what' and 'code' only once
+   Mix_GetError() asks for it on the same thread, a NULL 'format' makes
+   'what' the message as it is.  'what' must outlive the thread's next
+   error.  Returns -1.
+ */
+typedef void (*Mix_ErrorFormatter)(const char *what, int code);
+extern int _Mix_SetErrorLater(Mix_ErrorFormatter format, const char *what, int code);
+
+/* Resume the output if Mix_SetAutoSuspend() suspended it, for anything
+   that starts making a sound.  Safe with or without the audio lock. */
+extern void _Mix_WakeOutput(void);
+
 /* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,389 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* The callback measures each channel's levels and writes the channels'
+   average into a ring, then wakes a worker.  The worker takes the spectrum
+   of the latest frames in the ring and publishes both for
+   Mix_GetAnalysis(), so the callback never waits on it or on the game.
+ */
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer.h"
+#include "mixer_analysis.h"
+
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
+
+#define ANALYSIS_PI     3.14159265358979323846
+
+/* Frames of the channels' average kept for the spectrum, a power of two */
+#define ANALYSIS_RING   16384
+
+/* What the callback measured of a buffer */
+typedef struct {
+    Uint64 frame;
+    int freq;
+    int channels;
+    float rms[MIX_ANALYSIS_CHANNELS];
+    float peak[MIX_ANALYSIS_CHANNELS];
+} analysis_levels;
+
+typedef struct {
+    int fft_size;
+    SDL_Thread *thread;
+    SDL_sem *wake;
+    SDL_bool quit;
+
+    /* From the callback to the worker */
+    analysis_levels levels[3];
+    int levels_back;
+    int levels_front;
+    SDL_atomic_t levels_middle;
+    float *ring;
+    SDL_atomic_t written;       /* frames written to the ring, wrapping */
+
+    /* The worker's */
+    float *window;
+    float window_scale;
+    float *twiddle_cos;
+    float *twiddle_sin;
+    float *re;
+    float *im;
+
+    /* From the worker to Mix_GetAnalysis() */
+    Mix_Analysis snapshots[3];
+    int snapshot_back;
+    int snapshot_front;
+    SDL_atomic_t snapshot_middle;
+} analysis_state;
+
+static analysis_state *analysis = NULL;     /* the callback's, audio lock */
+static analysis_state *analysis_owner = NULL;   /* the game thread's */
+
+/* In place, radix-2, n a power of two */
+static void analysis_fft(analysis_state *state, int n)
+{
+    float *re = state->re, *im = state->im;
+    int i, j, k, len, half, step;
+
+    for (i = 1, j = 0; i < n; ++i) {
+        int bit = n >> 1;
+        for (; j & bit; bit >>= 1) {
+            j ^= bit;
+        }
+        j |= bit;
+        if (i < j) {
+            float t = re[i];
+            re[i] = re[j];
+            re[j] = t;
+            t = im[i];
+            im[i] = im[j];
+            im[j] = t;
+        }
+    }
+
+    for (len = 2; len <= n; len <<= 1) {
+        half = len >> 1;
+        step = n / len;
+        for (i = 0; i < n; i += len) {
+            for (k = 0; k < half; ++k) {
+                const float wr = state->twiddle_cos[k * step];
+                const float wi = state->twiddle_sin[k * step];
+                float *ar = re + i + k, *ai = im + i + k;
+                float *br = ar + half, *bi = ai + half;
+                const float tr = *br * wr - *bi * wi;
+                const float ti = *br * wi + *bi * wr;
+                *br = *ar - tr;
+                *bi = *ai - ti;
+                *ar += tr;
+                *ai += ti;
+            }
+        }
+    }
+}
+
+/* The latest fft_size frames of the ring into 'out', SDL_FALSE if the
+   callback wrote over them while they were being read */
+static SDL_bool analysis_spectrum(analysis_state *state, Mix_Analysis *out)
+{
+    const int n = state->fft_size;
+    Uint32 end = (Uint32)SDL_AtomicGet(&state->written);
+    Uint32 start = end - (Uint32)n;
+    int i;
+
+    SDL_MemoryBarrierAcquire();
+    for (i = 0; i < n; ++i) {
+        state->re[i] = state->ring[(start + i) & (ANALYSIS_RING - 1)] * state->window[i];
+        state->im[i] = 0.0f;
+    }
+    SDL_MemoryBarrierAcquire();
+    if ((Uint32)SDL_AtomicGet(&state->written) - end > (Uint32)(ANALYSIS_RING - n)) {
+        return SDL_FALSE;
+    }
+
+    analysis_fft(state, n);
+    for (i = 0; i <= n / 2; ++i) {
+        const float mag = state->re[i] * state->re[i] + state->im[i] * state->im[i];
+        out->spectrum[i] = (float)SDL_sqrt(mag) * state->window_scale;
+    }
+    out->fft_size = n;
+    return SDL_TRUE;
+}
+
+static int SDLCALL analysis_thread(void *data)
+{
+    analysis_state *state = (analysis_state *)data;
+    const analysis_levels *levels;
+    Mix_Analysis *out;
+
+    for (;;) {
+        SDL_SemWait(state->wake);
+        if (state->quit) {
+            break;
+        }
+        /* Buffers that came while the last was analyzed only count once */
+        while (SDL_SemTryWait(state->wake) == 0) {
+        }
+        if (!_Eff_slot_acquire(&state->levels_middle, &state->levels_front)) {
+            continue;
+        }
+        levels = &state->levels[state->levels_front];
+
+        out = &state->snapshots[state->snapshot_back];
+        out->frame = levels->frame;
+        out->freq = levels->freq;
+        out->channels = levels->channels;
+        SDL_memcpy(out->rms, levels->rms, sizeof(out->rms));
+        SDL_memcpy(out->peak, levels->peak, sizeof(out->peak));
+        out->fft_size = 0;
+        if (state->fft_size > 0 && !analysis_spectrum(state, out)) {
+            continue;
+        }
+        state->snapshot_back = _Eff_slot_publish(&state->snapshot_middle, state->snapshot_back);
+    }
+    return 0;
+}
+
+SDL_bool _Mix_AnalysisActive(void)
+{
+    return (analysis != NULL);
+}
+
+void _Mix_AnalysisFeed(const float *bus, int channels, int frames, int freq, Uint64 end)
+{
+    analysis_state *state = analysis;
+    analysis_levels *levels;
+    int c, i, measured;
+    Uint32 pos;
+
+    if (!state || frames <= 0) {
+        return;
+    }
+
+    levels = &state->levels[state->levels_back];
+    measured = SDL_min(channels, MIX_ANALYSIS_CHANNELS);
+    levels->frame = end;
+    levels->freq = freq;
+    levels->channels = measured;
+    for (c = 0; c < measured; ++c) {
+        const float *ptr = bus + c;
+        float sum = 0.0f, peak = 0.0f;
+
+        for (i = 0; i < frames; ++i, ptr += channels) {
+            const float x = *ptr;
+            const float a = (x < 0.0f) ? -x : x;
+            sum += x * x;
+            if (a > peak) {
+                peak = a;
+            }
+        }
+        levels->rms[c] = (float)SDL_sqrt(sum / frames);
+        levels->peak[c] = peak;
+    }
+    state->levels_back = _Eff_slot_publish(&state->levels_middle, state->levels_back);
+
+    if (state->fft_size > 0) {
+        const float scale = 1.0f / channels;
+
+        /* Only the last of a buffer longer than the ring is kept */
+        if (frames > ANALYSIS_RING) {
+            bus += (frames - ANALYSIS_RING) * channels;
+            frames = ANALYSIS_RING;
+        }
+        pos = (Uint32)SDL_AtomicGet(&state->written);
+        for (i = 0; i < frames; ++i, bus += channels) {
+            float sum = 0.0f;
+            for (c = 0; c < channels; ++c) {
+                sum += bus[c];
+            }
+            state->ring[(pos + i) & (ANALYSIS_RING - 1)] = sum * scale;
+        }
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicAdd(&state->written, frames);
+    }
+    SDL_SemPost(state->wake);
+}
+
+static void analysis_free(analysis_state *state)
+{
+    if (state->thread) {
+        state->quit = SDL_TRUE;
+        SDL_SemPost(state->wake);
+        SDL_WaitThread(state->thread, NULL);
+    }
+    if (state->wake) {
+        SDL_DestroySemaphore(state->wake);
+    }
+    SDL_free(state->ring);
+    SDL_free(state->window);
+    SDL_free(state->twiddle_cos);
+    SDL_free(state->twiddle_sin);
+    SDL_free(state->re);
+    SDL_free(state->im);
+    SDL_free(state);
+}
+
+static analysis_state *analysis_create(int fft_size)
+{
+    analysis_state *state = (analysis_state *)SDL_calloc(1, sizeof(*state));
+    double sum = 0.0;
+    int i;
+
+    if (!state) {
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+    state->fft_size = fft_size;
+    state->levels_front = 1;
+    SDL_AtomicSet(&state->levels_middle, 2);
+    state->snapshot_front = 1;
+    SDL_AtomicSet(&state->snapshot_middle, 2);
+
+    if (fft_size > 0) {
+        state->ring = (float *)SDL_calloc(ANALYSIS_RING, sizeof(float));
+        state->window = (float *)SDL_malloc(fft_size * sizeof(float));
+        state->twiddle_cos = (float *)SDL_malloc((fft_size / 2) * sizeof(float));
+        state->twiddle_sin = (float *)SDL_malloc((fft_size / 2) * sizeof(float));
+        state->re = (float *)SDL_malloc(fft_size * sizeof(float));
+        state->im = (float *)SDL_malloc(fft_size * sizeof(float));
+        if (!state->ring || !state->window || !state->twiddle_cos ||
+            !state->twiddle_sin || !state->re || !state->im) {
+            analysis_free(state);
+            Mix_SetError("Out of memory");
+            return NULL;
+        }
+
+        /* Hann, scaled for a full scale sine to come out as 1 */
+        for (i = 0; i < fft_size; ++i) {
+            state->window[i] = (float)(0.5 - 0.5 * SDL_cos(2.0 * ANALYSIS_PI * i / fft_size));
+            sum += state->window[i];
+        }
+        state->window_scale = (float)(2.0 / sum);
+        for (i = 0; i < fft_size / 2; ++i) {
+            state->twiddle_cos[i] = (float)SDL_cos(2.0 * ANALYSIS_PI * i / fft_size);
+            state->twiddle_sin[i] = (float)-SDL_sin(2.0 * ANALYSIS_PI * i / fft_size);
+        }
+    }
+
+    state->wake = SDL_CreateSemaphore(0);
+    if (state->wake) {
+        state->thread = SDL_CreateThread(analysis_thread, "SDL_mixer analysis", state);
+    }
+    if (!state->thread) {
+        analysis_free(state);
+        Mix_SetError("Couldn't start the analysis thread");
+        return NULL;
+    }
+    return state;
+}
+
+static void analysis_stop(void)
+{
+    analysis_state *state = analysis_owner;
+
+    if (!state) {
+        return;
+    }
+    Mix_LockAudio();
+    analysis = NULL;
+    Mix_UnlockAudio();
+    analysis_owner = NULL;
+    analysis_free(state);
+}
+
+void _Mix_StopAnalysis(void)
+{
+    analysis_stop();
+}
+
+int Mix_SetAnalysis(SDL_bool enable, int fft_size)
+{
+    analysis_state *state;
+
+    if (enable && fft_size != 0 &&
+        (fft_size < 64 || fft_size > MIX_ANALYSIS_MAX_FFT || (fft_size & (fft_size - 1)) != 0)) {
+        Mix_SetError("FFT size must be 0 or a power of two from 64 to %d", MIX_ANALYSIS_MAX_FFT);
+        return -1;
+    }
+
+    analysis_stop();
+    if (!enable) {
+        return 0;
+    }
+
+    state = analysis_create(fft_size);
+    if (!state) {
+        return -1;
+    }
+    analysis_owner = state;
+    Mix_LockAudio();
+    analysis = state;
+    Mix_UnlockAudio();
+    return 0;
+}
+
+int Mix_GetAnalysis(Mix_Analysis *result)
+{
+    analysis_state *state = analysis_owner;
+    const Mix_Analysis *snapshot;
+
+    if (!result) {
+        Mix_SetError("analysis parameter was NULL");
+        return -1;
+    }
+    if (!state) {
+        Mix_SetError("Analysis is off");
+        return -1;
+    }
+
+    _Eff_slot_acquire(&state->snapshot_middle, &state->snapshot_front);
+    snapshot = &state->snapshots[state->snapshot_front];
+    if (snapshot->freq == 0) {
+        Mix_SetError("Nothing measured yet");
+        return -1;
+    }
+    SDL_memcpy(result, snapshot, sizeof(*result));
+    return 0;
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
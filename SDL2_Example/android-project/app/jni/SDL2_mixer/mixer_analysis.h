@@ -0,0 +1,42 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Levels and spectrum of the output, see Mix_SetAnalysis().  These are
+   called from the audio callback, with the audio lock held, except for
+   _Mix_StopAnalysis() which is called with the device closed.
+ */
+
+#ifndef MIXER_ANALYSIS_H_
+#define MIXER_ANALYSIS_H_
+
+#include "SDL_stdinc.h"
+
+/* Whether the callback has to mix into the float bus even without channels */
+extern SDL_bool _Mix_AnalysisActive(void);
+
+/* Measure 'frames' frames of the master bus, the output up to frame 'end' */
+extern void _Mix_AnalysisFeed(const float *bus, int channels, int frames, int freq, Uint64 end);
+
+extern void _Mix_StopAnalysis(void);
+
+#endif /* MIXER_ANALYSIS_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,1111 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+#include "SDL_cpuinfo.h"
+
+#include "SDL_mixer.h"
+#include "mixer_bus.h"
+
+/* The NEON kernels are built on ARM when the compiler allows it (on
+   armeabi-v7a Android.mk compiles this file with -mfpu=neon), the SSE2
+   kernels on x86. Either is only used if the CPU reports support for it.
+ */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
+static SDL_bool bus_has_neon = SDL_FALSE;
+static SDL_bool bus_has_sse2 = SDL_FALSE;
+
+void _Mix_InitBus(void)
+{
+#ifdef HAVE_NEON_INTRINSICS
+    bus_has_neon = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    bus_has_sse2 = SDL_HasSSE2();
+#endif
+}
+
+/* Each SIMD kernel handles a multiple of 8 samples and returns how many it
+   did, the scalar code below finishes off the rest. Buffers are not
+   assumed to be aligned.
+ */
+#ifdef HAVE_NEON_INTRINSICS
+static int load_s16_neon(float *bus, const Sint16 *src, int samples)
+{
+    const float32x4_t scale = vdupq_n_f32(1.0f / 32768.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        vst1q_f32(bus + i, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), scale));
+        vst1q_f32(bus + i + 4, vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), scale));
+    }
+    return i;
+}
+
+static int mix_s16_neon(float *bus, const Sint16 *src, int samples, float gain)
+{
+    const float g = gain * (1.0f / 32768.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        const float32x4_t lo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(s)));
+        const float32x4_t hi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(s)));
+        vst1q_f32(bus + i, vmlaq_n_f32(vld1q_f32(bus + i), lo, g));
+        vst1q_f32(bus + i + 4, vmlaq_n_f32(vld1q_f32(bus + i + 4), hi, g));
+    }
+    return i;
+}
+
+static int mix_f32_neon(float *bus, const float *src, int samples, float gain)
+{
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        vst1q_f32(bus + i, vmlaq_n_f32(vld1q_f32(bus + i), vld1q_f32(src + i), gain));
+        vst1q_f32(bus + i + 4, vmlaq_n_f32(vld1q_f32(bus + i + 4), vld1q_f32(src + i + 4), gain));
+    }
+    return i;
+}
+
+static int store_s16_neon(Sint16 *dst, const float *bus, int samples)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t minus_one = vdupq_n_f32(-1.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        /* vcvtq truncates and vqmovn saturates +32768 down to 32767 */
+        const float32x4_t lo = vminq_f32(vmaxq_f32(vld1q_f32(bus + i), minus_one), one);
+        const float32x4_t hi = vminq_f32(vmaxq_f32(vld1q_f32(bus + i + 4), minus_one), one);
+        const int16x4_t l = vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(lo, 32768.0f)));
+        const int16x4_t h = vqmovn_s32(vcvtq_s32_f32(vmulq_n_f32(hi, 32768.0f)));
+        vst1q_s16(dst + i, vcombine_s16(l, h));
+    }
+    return i;
+}
+
+static int store_f32_neon(float *dst, const float *bus, int samples)
+{
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t minus_one = vdupq_n_f32(-1.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(vld1q_f32(bus + i), minus_one), one));
+        vst1q_f32(dst + i + 4, vminq_f32(vmaxq_f32(vld1q_f32(bus + i + 4), minus_one), one));
+    }
+    return i;
+}
+
+static int dot_f32_neon(const float *a, const float *b, int samples, float *sum)
+{
+    float32x4_t acc0 = vdupq_n_f32(0.0f);
+    float32x4_t acc1 = vdupq_n_f32(0.0f);
+    float lanes[4];
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        acc0 = vmlaq_f32(acc0, vld1q_f32(a + i), vld1q_f32(b + i));
+        acc1 = vmlaq_f32(acc1, vld1q_f32(a + i + 4), vld1q_f32(b + i + 4));
+    }
+    vst1q_f32(lanes, vaddq_f32(acc0, acc1));
+    *sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return i;
+}
+
+/* (x * volume) / SDL_MIX_MAXVOLUME, rounding towards zero like SDL does */
+static SDL_INLINE int32x4_t scale_s32_neon(int32x4_t x)
+{
+    const int32x4_t bias = vandq_s32(vshrq_n_s32(x, 31), vdupq_n_s32(SDL_MIX_MAXVOLUME - 1));
+    return vshrq_n_s32(vaddq_s32(x, bias), 7);
+}
+
+static int mixaudio_s16_neon(Sint16 *dst, const Sint16 *src, int samples, int volume)
+{
+    const int16x4_t vol = vdup_n_s16((Sint16)volume);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        const int16x8_t s = vld1q_s16(src + i);
+        const int16x4_t lo = vqmovn_s32(scale_s32_neon(vmull_s16(vget_low_s16(s), vol)));
+        const int16x4_t hi = vqmovn_s32(scale_s32_neon(vmull_s16(vget_high_s16(s), vol)));
+        vst1q_s16(dst + i, vqaddq_s16(vld1q_s16(dst + i), vcombine_s16(lo, hi)));
+    }
+    return i;
+}
+
+static int mixaudio_f32_neon(float *dst, const float *src, int samples, int volume)
+{
+    const float gain = (float)volume / SDL_MIX_MAXVOLUME;
+    const float32x4_t one = vdupq_n_f32(1.0f);
+    const float32x4_t minus_one = vdupq_n_f32(-1.0f);
+    int i;
+
+    for (i = 0; i + 4 <= samples; i += 4) {
+        const float32x4_t sum = vmlaq_n_f32(vld1q_f32(dst + i), vld1q_f32(src + i), gain);
+        vst1q_f32(dst + i, vminq_f32(vmaxq_f32(sum, minus_one), one));
+    }
+    return i;
+}
+
+/* The interleave kernels count frames rather than samples */
+static SDL_INLINE int16x8_t narrow_s32_neon(const Sint32 *src, int32x4_t shift)
+{
+    return vcombine_s16(vqmovn_s32(vshlq_s32(vld1q_s32(src), shift)),
+                        vqmovn_s32(vshlq_s32(vld1q_s32(src + 4), shift)));
+}
+
+static int interleave1_s16_neon(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const int32x4_t sh = vdupq_n_s32(-shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        vst1q_s16(dst + i, narrow_s32_neon(src[0] + i, sh));
+    }
+    return i;
+}
+
+static int interleave2_s16_neon(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const int32x4_t sh = vdupq_n_s32(-shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        int16x8x2_t v;
+        v.val[0] = narrow_s32_neon(src[0] + i, sh);
+        v.val[1] = narrow_s32_neon(src[1] + i, sh);
+        vst2q_s16(dst + i * 2, v);
+    }
+    return i;
+}
+
+static int interleave4_s16_neon(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const int32x4_t sh = vdupq_n_s32(-shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        int16x8x4_t v;
+        v.val[0] = narrow_s32_neon(src[0] + i, sh);
+        v.val[1] = narrow_s32_neon(src[1] + i, sh);
+        v.val[2] = narrow_s32_neon(src[2] + i, sh);
+        v.val[3] = narrow_s32_neon(src[3] + i, sh);
+        vst4q_s16(dst + i * 4, v);
+    }
+    return i;
+}
+
+/* Per-speaker gains from 'src' to 'dst', which may be the same buffer.
+   'pattern' holds the gains of the first BUS_GAIN_BLOCK samples and
+   'step' how much each moves on per block. */
+static int gains_s16_neon(Sint16 *dst, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const int16x8_t s = vld1q_s16(src + i + j * 8);
+            const float32x4_t lo = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), g[j * 2]);
+            const float32x4_t hi = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), g[j * 2 + 1]);
+            vst1q_s16(dst + i + j * 8, vcombine_s16(vqmovn_s32(vcvtq_s32_f32(lo)), vqmovn_s32(vcvtq_s32_f32(hi))));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int gains_f32_neon(float *dst, const float *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            vst1q_f32(dst + i + j * 4, vmulq_f32(vld1q_f32(src + i + j * 4), g[j]));
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+/* Like the two above, but adding the scaled samples to the bus */
+static int mix_gains_s16_neon(float *bus, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const int16x8_t s = vld1q_s16(src + i + j * 8);
+            float *b = bus + i + j * 8;
+            vst1q_f32(b, vmlaq_f32(vld1q_f32(b), vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), g[j * 2]));
+            vst1q_f32(b + 4, vmlaq_f32(vld1q_f32(b + 4), vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), g[j * 2 + 1]));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int mix_gains_f32_neon(float *bus, const float *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            float *b = bus + i + j * 4;
+            vst1q_f32(b, vmlaq_f32(vld1q_f32(b), vld1q_f32(src + i + j * 4), g[j]));
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+/* The same as the two above for stereo, adding each side to the other */
+static int mix_swap_s16_neon(float *bus, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const int16x8_t s = vld1q_s16(src + i + j * 8);
+            const float32x4_t lo = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16(s))), g[j * 2]);
+            const float32x4_t hi = vmulq_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(s))), g[j * 2 + 1]);
+            float *b = bus + i + j * 8;
+            vst1q_f32(b, vaddq_f32(vld1q_f32(b), vrev64q_f32(lo)));
+            vst1q_f32(b + 4, vaddq_f32(vld1q_f32(b + 4), vrev64q_f32(hi)));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int mix_swap_f32_neon(float *bus, const float *src, int samples, const float *pattern, const float *step)
+{
+    float32x4_t g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = vld1q_f32(pattern + j * 4);
+        d[j] = vld1q_f32(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            float *b = bus + i + j * 4;
+            vst1q_f32(b, vaddq_f32(vld1q_f32(b), vrev64q_f32(vmulq_f32(vld1q_f32(src + i + j * 4), g[j]))));
+            g[j] = vaddq_f32(g[j], d[j]);
+        }
+    }
+    return i;
+}
+#endif /* HAVE_NEON_INTRINSICS */
+
+#ifdef HAVE_SSE2_INTRINSICS
+/* Sign extend the low or high four Sint16 of 'x' to Sint32 */
+#define SSE2_S16_LO(x) _mm_srai_epi32(_mm_unpacklo_epi16((x), (x)), 16)
+#define SSE2_S16_HI(x) _mm_srai_epi32(_mm_unpackhi_epi16((x), (x)), 16)
+
+static int load_s16_sse2(float *bus, const Sint16 *src, int samples)
+{
+    const __m128 scale = _mm_set1_ps(1.0f / 32768.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        _mm_storeu_ps(bus + i, _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_LO(s)), scale));
+        _mm_storeu_ps(bus + i + 4, _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_HI(s)), scale));
+    }
+    return i;
+}
+
+static int mix_s16_sse2(float *bus, const Sint16 *src, int samples, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain * (1.0f / 32768.0f));
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_LO(s)), g);
+        const __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_HI(s)), g);
+        _mm_storeu_ps(bus + i, _mm_add_ps(_mm_loadu_ps(bus + i), lo));
+        _mm_storeu_ps(bus + i + 4, _mm_add_ps(_mm_loadu_ps(bus + i + 4), hi));
+    }
+    return i;
+}
+
+static int mix_f32_sse2(float *bus, const float *src, int samples, float gain)
+{
+    const __m128 g = _mm_set1_ps(gain);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        _mm_storeu_ps(bus + i, _mm_add_ps(_mm_loadu_ps(bus + i), _mm_mul_ps(_mm_loadu_ps(src + i), g)));
+        _mm_storeu_ps(bus + i + 4, _mm_add_ps(_mm_loadu_ps(bus + i + 4), _mm_mul_ps(_mm_loadu_ps(src + i + 4), g)));
+    }
+    return i;
+}
+
+static int store_s16_sse2(Sint16 *dst, const float *bus, int samples)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    const __m128 scale = _mm_set1_ps(32768.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        /* Clamp first, cvttps returns 0x80000000 for anything out of range */
+        const __m128 lo = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus + i), minus_one), one);
+        const __m128 hi = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus + i + 4), minus_one), one);
+        const __m128i l = _mm_cvttps_epi32(_mm_mul_ps(lo, scale));
+        const __m128i h = _mm_cvttps_epi32(_mm_mul_ps(hi, scale));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_packs_epi32(l, h));
+    }
+    return i;
+}
+
+static int store_f32_sse2(float *dst, const float *bus, int samples)
+{
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus + i), minus_one), one));
+        _mm_storeu_ps(dst + i + 4, _mm_min_ps(_mm_max_ps(_mm_loadu_ps(bus + i + 4), minus_one), one));
+    }
+    return i;
+}
+
+static int dot_f32_sse2(const float *a, const float *b, int samples, float *sum)
+{
+    __m128 acc0 = _mm_setzero_ps();
+    __m128 acc1 = _mm_setzero_ps();
+    float lanes[4];
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        acc0 = _mm_add_ps(acc0, _mm_mul_ps(_mm_loadu_ps(a + i), _mm_loadu_ps(b + i)));
+        acc1 = _mm_add_ps(acc1, _mm_mul_ps(_mm_loadu_ps(a + i + 4), _mm_loadu_ps(b + i + 4)));
+    }
+    _mm_storeu_ps(lanes, _mm_add_ps(acc0, acc1));
+    *sum = (lanes[0] + lanes[1]) + (lanes[2] + lanes[3]);
+    return i;
+}
+
+/* (x * volume) / SDL_MIX_MAXVOLUME, rounding towards zero like SDL does */
+static SDL_INLINE __m128i scale_s32_sse2(__m128i x)
+{
+    const __m128i bias = _mm_and_si128(_mm_srai_epi32(x, 31), _mm_set1_epi32(SDL_MIX_MAXVOLUME - 1));
+    return _mm_srai_epi32(_mm_add_epi32(x, bias), 7);
+}
+
+static int mixaudio_s16_sse2(Sint16 *dst, const Sint16 *src, int samples, int volume)
+{
+    const __m128i vol = _mm_set1_epi32(volume);
+    int i;
+
+    for (i = 0; i + 8 <= samples; i += 8) {
+        /* madd against (volume, 0) pairs gives full 32-bit products */
+        const __m128i s = _mm_loadu_si128((const __m128i *)(src + i));
+        const __m128i lo = scale_s32_sse2(_mm_madd_epi16(SSE2_S16_LO(s), vol));
+        const __m128i hi = scale_s32_sse2(_mm_madd_epi16(SSE2_S16_HI(s), vol));
+        const __m128i d = _mm_loadu_si128((const __m128i *)(dst + i));
+        _mm_storeu_si128((__m128i *)(dst + i), _mm_adds_epi16(d, _mm_packs_epi32(lo, hi)));
+    }
+    return i;
+}
+
+static int mixaudio_f32_sse2(float *dst, const float *src, int samples, int volume)
+{
+    const __m128 gain = _mm_set1_ps((float)volume / SDL_MIX_MAXVOLUME);
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 minus_one = _mm_set1_ps(-1.0f);
+    int i;
+
+    for (i = 0; i + 4 <= samples; i += 4) {
+        const __m128 sum = _mm_add_ps(_mm_loadu_ps(dst + i), _mm_mul_ps(_mm_loadu_ps(src + i), gain));
+        _mm_storeu_ps(dst + i, _mm_min_ps(_mm_max_ps(sum, minus_one), one));
+    }
+    return i;
+}
+
+/* The interleave kernels count frames rather than samples */
+static SDL_INLINE __m128i narrow_s32_sse2(const Sint32 *src, __m128i shift)
+{
+    return _mm_packs_epi32(_mm_sra_epi32(_mm_loadu_si128((const __m128i *)src), shift),
+                           _mm_sra_epi32(_mm_loadu_si128((const __m128i *)(src + 4)), shift));
+}
+
+static int interleave1_s16_sse2(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        _mm_storeu_si128((__m128i *)(dst + i), narrow_s32_sse2(src[0] + i, sh));
+    }
+    return i;
+}
+
+static int interleave2_s16_sse2(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        const __m128i a = narrow_s32_sse2(src[0] + i, sh);
+        const __m128i b = narrow_s32_sse2(src[1] + i, sh);
+        _mm_storeu_si128((__m128i *)(dst + i * 2), _mm_unpacklo_epi16(a, b));
+        _mm_storeu_si128((__m128i *)(dst + i * 2 + 8), _mm_unpackhi_epi16(a, b));
+    }
+    return i;
+}
+
+static int interleave4_s16_sse2(Sint16 *dst, const Sint32 *const *src, int frames, int shift)
+{
+    const __m128i sh = _mm_cvtsi32_si128(shift);
+    int i;
+
+    for (i = 0; i + 8 <= frames; i += 8) {
+        const __m128i a = narrow_s32_sse2(src[0] + i, sh);
+        const __m128i b = narrow_s32_sse2(src[1] + i, sh);
+        const __m128i c = narrow_s32_sse2(src[2] + i, sh);
+        const __m128i d = narrow_s32_sse2(src[3] + i, sh);
+        /* Pair up the samples, then the pairs, to get whole frames */
+        const __m128i ab_lo = _mm_unpacklo_epi16(a, b);
+        const __m128i ab_hi = _mm_unpackhi_epi16(a, b);
+        const __m128i cd_lo = _mm_unpacklo_epi16(c, d);
+        const __m128i cd_hi = _mm_unpackhi_epi16(c, d);
+        _mm_storeu_si128((__m128i *)(dst + i * 4), _mm_unpacklo_epi32(ab_lo, cd_lo));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 8), _mm_unpackhi_epi32(ab_lo, cd_lo));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 16), _mm_unpacklo_epi32(ab_hi, cd_hi));
+        _mm_storeu_si128((__m128i *)(dst + i * 4 + 24), _mm_unpackhi_epi32(ab_hi, cd_hi));
+    }
+    return i;
+}
+
+static int gains_s16_sse2(Sint16 *dst, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + i + j * 8));
+            const __m128i lo = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_LO(s)), g[j * 2]));
+            const __m128i hi = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_HI(s)), g[j * 2 + 1]));
+            _mm_storeu_si128((__m128i *)(dst + i + j * 8), _mm_packs_epi32(lo, hi));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int gains_f32_sse2(float *dst, const float *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            _mm_storeu_ps(dst + i + j * 4, _mm_mul_ps(_mm_loadu_ps(src + i + j * 4), g[j]));
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int mix_gains_s16_sse2(float *bus, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + i + j * 8));
+            float *b = bus + i + j * 8;
+            _mm_storeu_ps(b, _mm_add_ps(_mm_loadu_ps(b), _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_LO(s)), g[j * 2])));
+            _mm_storeu_ps(b + 4, _mm_add_ps(_mm_loadu_ps(b + 4), _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_HI(s)), g[j * 2 + 1])));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int mix_gains_f32_sse2(float *bus, const float *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            float *b = bus + i + j * 4;
+            _mm_storeu_ps(b, _mm_add_ps(_mm_loadu_ps(b), _mm_mul_ps(_mm_loadu_ps(src + i + j * 4), g[j])));
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+/* Swap the left and right samples of the two frames in 'x' */
+#define SSE2_SWAP_SIDES(x) _mm_shuffle_ps((x), (x), _MM_SHUFFLE(2, 3, 0, 1))
+
+static int mix_swap_s16_sse2(float *bus, const Sint16 *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 3; ++j) {
+            const __m128i s = _mm_loadu_si128((const __m128i *)(src + i + j * 8));
+            const __m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_LO(s)), g[j * 2]);
+            const __m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(SSE2_S16_HI(s)), g[j * 2 + 1]);
+            float *b = bus + i + j * 8;
+            _mm_storeu_ps(b, _mm_add_ps(_mm_loadu_ps(b), SSE2_SWAP_SIDES(lo)));
+            _mm_storeu_ps(b + 4, _mm_add_ps(_mm_loadu_ps(b + 4), SSE2_SWAP_SIDES(hi)));
+        }
+        for (j = 0; j < 6; ++j) {
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+
+static int mix_swap_f32_sse2(float *bus, const float *src, int samples, const float *pattern, const float *step)
+{
+    __m128 g[6], d[6];
+    int i, j;
+
+    for (j = 0; j < 6; ++j) {
+        g[j] = _mm_loadu_ps(pattern + j * 4);
+        d[j] = _mm_loadu_ps(step + j * 4);
+    }
+    for (i = 0; i + 24 <= samples; i += 24) {
+        for (j = 0; j < 6; ++j) {
+            float *b = bus + i + j * 4;
+            const __m128 p = _mm_mul_ps(_mm_loadu_ps(src + i + j * 4), g[j]);
+            _mm_storeu_ps(b, _mm_add_ps(_mm_loadu_ps(b), SSE2_SWAP_SIDES(p)));
+            g[j] = _mm_add_ps(g[j], d[j]);
+        }
+    }
+    return i;
+}
+#endif /* HAVE_SSE2_INTRINSICS */
+
+/* Dispatch to a SIMD kernel for native-endian S16 and F32, if there is one */
+#if defined(HAVE_NEON_INTRINSICS) && defined(HAVE_SSE2_INTRINSICS)
+#define BUS_SIMD(neon, sse2, args) \
+    (bus_has_neon ? neon args : bus_has_sse2 ? sse2 args : 0)
+#elif defined(HAVE_NEON_INTRINSICS)
+#define BUS_SIMD(neon, sse2, args) (bus_has_neon ? neon args : 0)
+#elif defined(HAVE_SSE2_INTRINSICS)
+#define BUS_SIMD(neon, sse2, args) (bus_has_sse2 ? sse2 args : 0)
+#else
+#define BUS_SIMD(neon, sse2, args) 0
+#endif
+
+/* Read sample 'i' of 'src' as a float in [-1.0, 1.0) */
+#define READ_U8(src, i)     ((float)((int)((const Uint8 *)(src))[i] - 128) * (1.0f / 128.0f))
+#define READ_S8(src, i)     ((float)((const Sint8 *)(src))[i] * (1.0f / 128.0f))
+#define READ_U16LSB(src, i) ((float)((int)SDL_SwapLE16(((const Uint16 *)(src))[i]) - 32768) * (1.0f / 32768.0f))
+#define READ_U16MSB(src, i) ((float)((int)SDL_SwapBE16(((const Uint16 *)(src))[i]) - 32768) * (1.0f / 32768.0f))
+#define READ_S16LSB(src, i) ((float)(Sint16)SDL_SwapLE16(((const Uint16 *)(src))[i]) * (1.0f / 32768.0f))
+#define READ_S16MSB(src, i) ((float)(Sint16)SDL_SwapBE16(((const Uint16 *)(src))[i]) * (1.0f / 32768.0f))
+#define READ_S32LSB(src, i) ((float)(Sint32)SDL_SwapLE32(((const Uint32 *)(src))[i]) * (1.0f / 2147483648.0f))
+#define READ_S32MSB(src, i) ((float)(Sint32)SDL_SwapBE32(((const Uint32 *)(src))[i]) * (1.0f / 2147483648.0f))
+#define READ_F32LSB(src, i) SDL_SwapFloatLE(((const float *)(src))[i])
+#define READ_F32MSB(src, i) SDL_SwapFloatBE(((const float *)(src))[i])
+
+/* Run 'expr' over every sample, with 's' holding the current sample */
+#define BUS_LOOP(READ, expr)                        \
+    for (i = 0; i < samples; ++i) {                 \
+        const float s = READ(src, i);               \
+        expr;                                       \
+    }
+
+#define BUS_SWITCH(format, expr)                                \
+    switch (format) {                                           \
+    case AUDIO_U8:      BUS_LOOP(READ_U8, expr); break;         \
+    case AUDIO_S8:      BUS_LOOP(READ_S8, expr); break;         \
+    case AUDIO_U16LSB:  BUS_LOOP(READ_U16LSB, expr); break;     \
+    case AUDIO_U16MSB:  BUS_LOOP(READ_U16MSB, expr); break;     \
+    case AUDIO_S16LSB:  BUS_LOOP(READ_S16LSB, expr); break;     \
+    case AUDIO_S16MSB:  BUS_LOOP(READ_S16MSB, expr); break;     \
+    case AUDIO_S32LSB:  BUS_LOOP(READ_S32LSB, expr); break;     \
+    case AUDIO_S32MSB:  BUS_LOOP(READ_S32MSB, expr); break;     \
+    case AUDIO_F32LSB:  BUS_LOOP(READ_F32LSB, expr); break;     \
+    case AUDIO_F32MSB:  BUS_LOOP(READ_F32MSB, expr); break;     \
+    default: break;                                             \
+    }
+
+void _Mix_BusLoad(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples)
+{
+    int i;
+
+    if (format == AUDIO_S16SYS) {
+        i = BUS_SIMD(load_s16_neon, load_s16_sse2, (bus, (const Sint16 *)src, samples));
+        bus += i;
+        src += i * sizeof(Sint16);
+        samples -= i;
+    } else if (format == AUDIO_F32SYS) {
+        SDL_memcpy(bus, src, samples * sizeof(float));
+        return;
+    }
+    BUS_SWITCH(format, bus[i] = s);
+}
+
+void _Mix_BusMix(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, float gain)
+{
+    int i;
+
+    if (gain == 0.0f) {
+        return;
+    }
+    if (format == AUDIO_S16SYS) {
+        i = BUS_SIMD(mix_s16_neon, mix_s16_sse2, (bus, (const Sint16 *)src, samples, gain));
+        bus += i;
+        src += i * sizeof(Sint16);
+        samples -= i;
+    } else if (format == AUDIO_F32SYS) {
+        i = BUS_SIMD(mix_f32_neon, mix_f32_sse2, (bus, (const float *)src, samples, gain));
+        bus += i;
+        src += i * sizeof(float);
+        samples -= i;
+    }
+    BUS_SWITCH(format, bus[i] += s * gain);
+}
+
+void _Mix_BusMixRamp(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, float gain, float step)
+{
+    int i, c = 0;
+
+    BUS_SWITCH(format, {
+        bus[i] += s * gain;
+        if (++c == channels) {
+            c = 0;
+            gain += step;
+        }
+    });
+}
+
+/* Convert a float to an integer sample, saturating to [-max-1, max] */
+static SDL_INLINE Sint32 bus_to_int(float x, float scale, Sint32 max)
+{
+    Sint32 v;
+
+    if (x <= -1.0f) {
+        return -max - 1;
+    }
+    if (x >= 1.0f) {
+        return max;
+    }
+    v = (Sint32)(x * scale);
+    return (v > max) ? max : v;
+}
+
+void _Mix_BusStore(Uint8 *dst, const float *bus, SDL_AudioFormat format, int samples)
+{
+    int i;
+
+    if (format == AUDIO_S16SYS) {
+        i = BUS_SIMD(store_s16_neon, store_s16_sse2, ((Sint16 *)dst, bus, samples));
+        dst += i * sizeof(Sint16);
+        bus += i;
+        samples -= i;
+    } else if (format == AUDIO_F32SYS) {
+        i = BUS_SIMD(store_f32_neon, store_f32_sse2, ((float *)dst, bus, samples));
+        dst += i * sizeof(float);
+        bus += i;
+        samples -= i;
+    }
+
+    switch (format) {
+    case AUDIO_U8:
+        for (i = 0; i < samples; ++i) {
+            dst[i] = (Uint8)(bus_to_int(bus[i], 128.0f, 127) + 128);
+        }
+        break;
+    case AUDIO_S8:
+        for (i = 0; i < samples; ++i) {
+            ((Sint8 *)dst)[i] = (Sint8)bus_to_int(bus[i], 128.0f, 127);
+        }
+        break;
+    case AUDIO_U16LSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint16 *)dst)[i] = SDL_SwapLE16((Uint16)(bus_to_int(bus[i], 32768.0f, 32767) + 32768));
+        }
+        break;
+    case AUDIO_U16MSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint16 *)dst)[i] = SDL_SwapBE16((Uint16)(bus_to_int(bus[i], 32768.0f, 32767) + 32768));
+        }
+        break;
+    case AUDIO_S16LSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint16 *)dst)[i] = SDL_SwapLE16((Uint16)bus_to_int(bus[i], 32768.0f, 32767));
+        }
+        break;
+    case AUDIO_S16MSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint16 *)dst)[i] = SDL_SwapBE16((Uint16)bus_to_int(bus[i], 32768.0f, 32767));
+        }
+        break;
+    case AUDIO_S32LSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint32 *)dst)[i] = SDL_SwapLE32((Uint32)bus_to_int(bus[i], 2147483648.0f, SDL_MAX_SINT32));
+        }
+        break;
+    case AUDIO_S32MSB:
+        for (i = 0; i < samples; ++i) {
+            ((Uint32 *)dst)[i] = SDL_SwapBE32((Uint32)bus_to_int(bus[i], 2147483648.0f, SDL_MAX_SINT32));
+        }
+        break;
+    case AUDIO_F32LSB:
+    case AUDIO_F32MSB:
+        for (i = 0; i < samples; ++i) {
+            float x = bus[i];
+            if (x > 1.0f) {
+                x = 1.0f;
+            } else if (x < -1.0f) {
+                x = -1.0f;
+            }
+            ((float *)dst)[i] = (format == AUDIO_F32LSB) ? SDL_SwapFloatLE(x) : SDL_SwapFloatBE(x);
+        }
+        break;
+    default:
+        break;
+    }
+}
+
+void _Mix_BusResample(float *dst, const float *src, int channels, int frames, Uint32 pos, Uint32 step, SDL_bool cubic)
+{
+    const float *s;
+    float t;
+    int i, c;
+
+    src += channels;
+    if (cubic) {
+        /* Catmull-Rom through the two frames around the position */
+        for (i = 0; i < frames; ++i) {
+            s = src + (pos >> 16) * channels;
+            t = (float)(pos & 0xFFFF) * (1.0f / 65536.0f);
+            for (c = 0; c < channels; ++c) {
+                const float x0 = s[c - channels];
+                const float x1 = s[c];
+                const float x2 = s[c + channels];
+                const float x3 = s[c + 2 * channels];
+                const float a = 0.5f * (x3 - x0) + 1.5f * (x1 - x2);
+                const float b = x0 - 2.5f * x1 + 2.0f * x2 - 0.5f * x3;
+                const float d = 0.5f * (x2 - x0);
+                dst[c] = ((a * t + b) * t + d) * t + x1;
+            }
+            dst += channels;
+            pos += step;
+        }
+    } else {
+        for (i = 0; i < frames; ++i) {
+            s = src + (pos >> 16) * channels;
+            t = (float)(pos & 0xFFFF) * (1.0f / 65536.0f);
+            for (c = 0; c < channels; ++c) {
+                dst[c] = s[c] + (s[c + channels] - s[c]) * t;
+            }
+            dst += channels;
+            pos += step;
+        }
+    }
+}
+
+float _Mix_BusDot(const float *a, const float *b, int samples)
+{
+    float sum = 0.0f;
+    int i;
+
+    i = BUS_SIMD(dot_f32_neon, dot_f32_sse2, (a, b, samples, &sum));
+    for (; i < samples; ++i) {
+        sum += a[i] * b[i];
+    }
+    return sum;
+}
+
+/* Enough for a whole number of frames with 1, 2, 4, 6 or 8 channels */
+#define BUS_RAMP_BLOCK  240
+
+void _Mix_BusRamp(Uint8 *buf, SDL_AudioFormat format, int samples, int channels, float gain, float step)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(format) / 8;
+    float block[BUS_RAMP_BLOCK];
+    int i, c = 0;
+
+    while (samples > 0) {
+        const int n = SDL_min(samples, BUS_RAMP_BLOCK);
+
+        _Mix_BusLoad(block, buf, format, n);
+        for (i = 0; i < n; ++i) {
+            block[i] *= gain;
+            if (++c == channels) {
+                c = 0;
+                gain += step;
+            }
+        }
+        _Mix_BusStore(buf, block, format, n);
+        buf += n * sample_size;
+        samples -= n;
+    }
+}
+
+/* A whole number of frames with 1, 2, 3, 4, 6 or 8 channels, and of SIMD
+   vectors of S16 or F32 */
+#define BUS_GAIN_BLOCK  24
+
+void _Mix_BusGains(Uint8 *buf, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps)
+{
+    _Mix_BusGainsCopy(buf, buf, format, samples, channels, gains, steps);
+}
+
+void _Mix_BusGainsCopy(Uint8 *dst, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps)
+{
+    float pattern[BUS_GAIN_BLOCK], step[BUS_GAIN_BLOCK];
+    int i = 0, c, frame;
+
+    if ((BUS_GAIN_BLOCK % channels) == 0) {
+        for (c = 0; c < BUS_GAIN_BLOCK; ++c) {
+            const float d = steps ? steps[c % channels] : 0.0f;
+            pattern[c] = gains[c % channels] + (float)(c / channels) * d;
+            step[c] = (float)(BUS_GAIN_BLOCK / channels) * d;
+        }
+        if (format == AUDIO_S16SYS) {
+            i = BUS_SIMD(gains_s16_neon, gains_s16_sse2, ((Sint16 *)dst, (const Sint16 *)src, samples, pattern, step));
+        } else if (format == AUDIO_F32SYS) {
+            i = BUS_SIMD(gains_f32_neon, gains_f32_sse2, ((float *)dst, (const float *)src, samples, pattern, step));
+        }
+    }
+
+    /* The kernels stop on a frame boundary, so this starts on channel 0 */
+    for (c = 0, frame = i / channels; i < samples; ++i) {
+        const float g = steps ? gains[c] + (float)frame * steps[c] : gains[c];
+        switch (format) {
+        case AUDIO_S16LSB:
+            ((Uint16 *)dst)[i] = SDL_SwapLE16((Uint16)(Sint16)((float)(Sint16)SDL_SwapLE16(((const Uint16 *)src)[i]) * g));
+            break;
+        case AUDIO_S16MSB:
+            ((Uint16 *)dst)[i] = SDL_SwapBE16((Uint16)(Sint16)((float)(Sint16)SDL_SwapBE16(((const Uint16 *)src)[i]) * g));
+            break;
+        case AUDIO_F32LSB:
+            ((float *)dst)[i] = SDL_SwapFloatLE(SDL_SwapFloatLE(((const float *)src)[i]) * g);
+            break;
+        case AUDIO_F32MSB:
+            ((float *)dst)[i] = SDL_SwapFloatBE(SDL_SwapFloatBE(((const float *)src)[i]) * g);
+            break;
+        default:
+            return;
+        }
+        if (++c == channels) {
+            c = 0;
+            ++frame;
+        }
+    }
+}
+
+void _Mix_BusMixGains(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps)
+{
+    float pattern[BUS_GAIN_BLOCK], step[BUS_GAIN_BLOCK];
+    int i = 0, c, frame;
+
+    if ((BUS_GAIN_BLOCK % channels) == 0) {
+        /* The S16 kernels take the gains already scaled to the bus range */
+        const float scale = (format == AUDIO_S16SYS) ? (1.0f / 32768.0f) : 1.0f;
+        for (c = 0; c < BUS_GAIN_BLOCK; ++c) {
+            pattern[c] = (gains[c % channels] + (float)(c / channels) * steps[c % channels]) * scale;
+            step[c] = (float)(BUS_GAIN_BLOCK / channels) * steps[c % channels] * scale;
+        }
+        if (format == AUDIO_S16SYS) {
+            i = BUS_SIMD(mix_gains_s16_neon, mix_gains_s16_sse2, (bus, (const Sint16 *)src, samples, pattern, step));
+            src += i * sizeof(Sint16);
+        } else if (format == AUDIO_F32SYS) {
+            i = BUS_SIMD(mix_gains_f32_neon, mix_gains_f32_sse2, (bus, (const float *)src, samples, pattern, step));
+            src += i * sizeof(float);
+        }
+        bus += i;
+        samples -= i;
+    }
+
+    /* The kernels stop on a frame boundary, so this starts on channel 0 */
+    frame = i / channels;
+    c = 0;
+    BUS_SWITCH(format, {
+        bus[i] += s * (gains[c] + (float)frame * steps[c]);
+        if (++c == channels) {
+            c = 0;
+            ++frame;
+        }
+    });
+}
+
+void _Mix_BusMixGainsSwapped(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, const float *gains, const float *steps)
+{
+    float pattern[BUS_GAIN_BLOCK], step[BUS_GAIN_BLOCK];
+    const float scale = (format == AUDIO_S16SYS) ? (1.0f / 32768.0f) : 1.0f;
+    int i = 0, c, frame;
+
+    /* The gains are the source sides', as in _Mix_BusMixGains() */
+    for (c = 0; c < BUS_GAIN_BLOCK; ++c) {
+        pattern[c] = (gains[c % 2] + (float)(c / 2) * steps[c % 2]) * scale;
+        step[c] = (float)(BUS_GAIN_BLOCK / 2) * steps[c % 2] * scale;
+    }
+    if (format == AUDIO_S16SYS) {
+        i = BUS_SIMD(mix_swap_s16_neon, mix_swap_s16_sse2, (bus, (const Sint16 *)src, samples, pattern, step));
+        src += i * sizeof(Sint16);
+    } else if (format == AUDIO_F32SYS) {
+        i = BUS_SIMD(mix_swap_f32_neon, mix_swap_f32_sse2, (bus, (const float *)src, samples, pattern, step));
+        src += i * sizeof(float);
+    }
+    bus += i;
+    samples -= i;
+
+    /* The kernels stop on a frame boundary, so this starts on the left */
+    frame = i / 2;
+    c = 0;
+    BUS_SWITCH(format, {
+        bus[i ^ 1] += s * (gains[c] + (float)frame * steps[c]);
+        if (++c == 2) {
+            c = 0;
+            ++frame;
+        }
+    });
+}
+
+void _Mix_BusInterleaveS16(Sint16 *dst, const Sint32 *const *src, int channels, int frames, int shift)
+{
+    int i, c;
+
+    switch (channels) {
+    case 1:
+        i = BUS_SIMD(interleave1_s16_neon, interleave1_s16_sse2, (dst, src, frames, shift));
+        break;
+    case 2:
+        i = BUS_SIMD(interleave2_s16_neon, interleave2_s16_sse2, (dst, src, frames, shift));
+        break;
+    case 4:
+        i = BUS_SIMD(interleave4_s16_neon, interleave4_s16_sse2, (dst, src, frames, shift));
+        break;
+    default:
+        i = 0;
+        break;
+    }
+
+    for (c = 0; c < channels; ++c) {
+        const Sint32 *s = src[c];
+        Sint16 *d = dst + i * channels + c;
+        int j;
+
+        for (j = i; j < frames; ++j) {
+            const Sint32 x = s[j] >> shift;
+            *d = (Sint16)((x > SDL_MAX_SINT16) ? SDL_MAX_SINT16 : (x < SDL_MIN_SINT16) ? SDL_MIN_SINT16 : x);
+            d += channels;
+        }
+    }
+}
+
+void _Mix_MixAudioFormat(Uint8 *dst, const Uint8 *src, SDL_AudioFormat format, Uint32 len, int volume)
+{
+    int samples, done = 0;
+
+    if (volume <= 0) {
+        return;
+    }
+    if (format == AUDIO_S16SYS) {
+        samples = (int)(len / sizeof(Sint16));
+        done = BUS_SIMD(mixaudio_s16_neon, mixaudio_s16_sse2, ((Sint16 *)dst, (const Sint16 *)src, samples, volume));
+        done *= sizeof(Sint16);
+    } else if (format == AUDIO_F32SYS) {
+        samples = (int)(len / sizeof(float));
+        done = BUS_SIMD(mixaudio_f32_neon, mixaudio_f32_sse2, ((float *)dst, (const float *)src, samples, volume));
+        done *= sizeof(float);
+    }
+    if ((Uint32)done < len) {
+        SDL_MixAudioFormat(dst + done, src + done, format, len - done, volume);
+    }
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
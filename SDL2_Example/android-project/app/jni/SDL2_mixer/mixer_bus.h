@@ -0,0 +1,87 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Internal 32-bit float mixing bus.
+
+   Channels are accumulated into the bus at full precision and the result
+   is clipped and converted to the device format exactly once per callback.
+ */
+
+#ifndef MIXER_BUS_H_
+#define MIXER_BUS_H_
+
+#include "SDL_stdinc.h"
+#include "SDL_audio.h"
+
+/* Pick the fastest kernels for this CPU, call before mixing */
+extern void _Mix_InitBus(void);
+
+/* Convert 'samples' samples in 'format' to floats, overwriting the bus */
+extern void _Mix_BusLoad(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples);
+
+/* Scale 'samples' samples in 'format' by 'gain' and add them to the bus */
+extern void _Mix_BusMix(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, float gain);
+
+/* The same as _Mix_BusMix(), but the gain starts at 'gain' and changes by
+   'step' after every frame of 'channels' samples, for sample-exact fades */
+extern void _Mix_BusMixRamp(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, float gain, float step);
+
+/* Apply a gain ramp like the one above to audio in 'format', in place */
+extern void _Mix_BusRamp(Uint8 *buf, SDL_AudioFormat format, int samples, int channels, float gain, float step);
+
+/* Scale S16 or F32 audio in place, each sample by the entry of 'gains'
+   (one per channel) for the channel it is in. If 'steps' isn't NULL each
+   channel's gain moves on by its entry there after every frame. */
+extern void _Mix_BusGains(Uint8 *buf, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps);
+
+/* The same as _Mix_BusGains(), but reading 'src' and writing 'dst' */
+extern void _Mix_BusGainsCopy(Uint8 *dst, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps);
+
+/* Add 'samples' samples of 'format' to the bus, scaled by per-channel
+   gains that ramp like the ones above; 'steps' can't be NULL here */
+extern void _Mix_BusMixGains(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, int channels, const float *gains, const float *steps);
+
+/* The same as _Mix_BusMixGains() for stereo, but adding the left channel
+   of 'src' to the right of the bus and the other way around */
+extern void _Mix_BusMixGainsSwapped(float *bus, const Uint8 *src, SDL_AudioFormat format, int samples, const float *gains, const float *steps);
+
+/* Interpolate 'frames' frames of 'channels' floats from 'src' into 'dst'.
+   'pos' is where the first one falls past src frame 1, and 'step' how far
+   each frame moves on, both in 16.16 fixed point. src frame 0 and the two
+   frames after the last one read have to be there for the cubic. */
+extern void _Mix_BusResample(float *dst, const float *src, int channels, int frames, Uint32 pos, Uint32 step, SDL_bool cubic);
+
+/* The sum of the products of 'samples' floats of 'a' and 'b', for FIR filters */
+extern float _Mix_BusDot(const float *a, const float *b, int samples);
+
+/* Clip the bus to [-1.0, 1.0] and convert it back to 'format' */
+extern void _Mix_BusStore(Uint8 *dst, const float *bus, SDL_AudioFormat format, int samples);
+
+/* Interleave 'frames' frames from the 'channels' planes in 'src' into
+   'dst', shifting every sample right by 'shift' and saturating it to Sint16 */
+extern void _Mix_BusInterleaveS16(Sint16 *dst, const Sint32 *const *src, int channels, int frames, int shift);
+
+/* Equivalent to SDL_MixAudioFormat(), with SIMD paths for S16 and F32 */
+extern void _Mix_MixAudioFormat(Uint8 *dst, const Uint8 *src, SDL_AudioFormat format, Uint32 len, int volume);
+
+#endif /* MIXER_BUS_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,534 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer_bus.h"
+#include "mixer_convert.h"
+
+/* Zero crossings of the sinc either side of the centre, fewer where a
+   low cutoff would stretch it past CVT_MAX_TAPS */
+#define CVT_ZERO_CROSSINGS  8
+#define CVT_MAX_TAPS        128
+/* Rates that don't reduce to this many phases interpolate between rows */
+#define CVT_MAX_PHASES      256
+/* Input frames converted at a time */
+#define CVT_BLOCK           1024
+
+#define CVT_PI  3.14159265358979323846
+
+struct _Mix_Converter {
+    SDL_AudioStream *fallback;  /* for the channel layouts not done here */
+    SDL_AudioFormat src_format;
+    int src_channels;
+    int src_frame;              /* in bytes */
+    SDL_AudioFormat dst_format;
+    int dst_channels;
+    int dst_frame;
+    int channels;               /* resampled, the fewer of the two */
+
+    /* Output frame j comes from input frame j * down / up */
+    SDL_bool resample;
+    int up, down;
+    int phases;
+    int taps;                   /* a multiple of 8 for the kernels */
+    float *coefs;               /* phases + 1 rows of taps */
+    float *row;                 /* two rows blended for the current phase */
+    float *planes;              /* input history, 'cap' frames per channel */
+    int cap;
+    int frames;
+    int pos;                    /* the frame under the first tap */
+    int frac;                   /* and how far past it, in 1/up */
+    int end;                    /* the frame a flush stopped at, or -1 */
+
+    float *in;                  /* a block of input as floats */
+    float *out;                 /* and what came of it */
+    int out_cap;                /* in frames */
+
+    Uint8 *queue;               /* converted, waiting for Get */
+    int queue_head;
+    int queue_len;
+    int queue_cap;
+};
+
+static SDL_bool cvt_format_ok(SDL_AudioFormat format)
+{
+    switch (format) {
+    case AUDIO_U8:
+    case AUDIO_S8:
+    case AUDIO_U16LSB:
+    case AUDIO_U16MSB:
+    case AUDIO_S16LSB:
+    case AUDIO_S16MSB:
+    case AUDIO_S32LSB:
+    case AUDIO_S32MSB:
+    case AUDIO_F32LSB:
+    case AUDIO_F32MSB:
+        return SDL_TRUE;
+    default:
+        return SDL_FALSE;
+    }
+}
+
+static int cvt_gcd(int a, int b)
+{
+    while (b) {
+        int t = a % b;
+        a = b;
+        b = t;
+    }
+    return a;
+}
+
+static double cvt_sinc(double x)
+{
+    return (x == 0.0) ? 1.0 : SDL_sin(CVT_PI * x) / (CVT_PI * x);
+}
+
+/* A Blackman windowed sinc, cut off below the lower of the two Nyquist
+   rates, sampled at 'phases' + 1 offsets between input frames */
+static int cvt_build_filter(Mix_Converter *cvt)
+{
+    const double fc = 0.95 * SDL_min(1.0, (double)cvt->up / cvt->down);
+    int half, p, k;
+
+    half = (int)(CVT_ZERO_CROSSINGS / fc) + 1;
+    cvt->taps = SDL_min((2 * half + 7) & ~7, CVT_MAX_TAPS);
+    half = cvt->taps / 2;
+    cvt->phases = SDL_min(cvt->up, CVT_MAX_PHASES);
+
+    cvt->coefs = (float *)SDL_malloc((cvt->phases + 1) * cvt->taps * sizeof(float));
+    cvt->row = (float *)SDL_malloc(cvt->taps * sizeof(float));
+    if (!cvt->coefs || !cvt->row) {
+        return -1;
+    }
+    for (p = 0; p <= cvt->phases; ++p) {
+        float *h = cvt->coefs + p * cvt->taps;
+        double f = (double)p / cvt->phases;
+        double sum = 0.0;
+
+        for (k = 0; k < cvt->taps; ++k) {
+            double x = (double)(k - (half - 1)) - f;
+            double u = x / half;
+            double w = 0.0;
+            if (u > -1.0 && u < 1.0) {
+                w = 0.42 + 0.5 * SDL_cos(CVT_PI * u) + 0.08 * SDL_cos(2.0 * CVT_PI * u);
+            }
+            h[k] = (float)(fc * cvt_sinc(fc * x) * w);
+            sum += h[k];
+        }
+        /* Unity gain at DC for every phase, or the rows ripple */
+        for (k = 0; k < cvt->taps; ++k) {
+            h[k] = (float)(h[k] / sum);
+        }
+    }
+    return 0;
+}
+
+/* Start over with the history before the first frame silent, so output
+   frame 0 lands right on input frame 0 */
+static void cvt_reset(Mix_Converter *cvt)
+{
+    int c;
+
+    if (!cvt->resample) {
+        return;
+    }
+    cvt->frames = cvt->taps / 2 - 1;
+    for (c = 0; c < cvt->channels; ++c) {
+        SDL_memset(cvt->planes + c * cvt->cap, 0, cvt->frames * sizeof(float));
+    }
+    cvt->pos = 0;
+    cvt->frac = 0;
+    cvt->end = -1;
+}
+
+static int cvt_reserve(Mix_Converter *cvt, int bytes)
+{
+    Uint8 *queue;
+    int cap;
+
+    if (cvt->queue_len + bytes <= cvt->queue_cap) {
+        return 0;
+    }
+    if (cvt->queue_head > 0) {
+        cvt->queue_len -= cvt->queue_head;
+        SDL_memmove(cvt->queue, cvt->queue + cvt->queue_head, cvt->queue_len);
+        cvt->queue_head = 0;
+        if (cvt->queue_len + bytes <= cvt->queue_cap) {
+            return 0;
+        }
+    }
+    cap = SDL_max(cvt->queue_cap * 2, cvt->queue_len + bytes);
+    queue = (Uint8 *)SDL_realloc(cvt->queue, cap);
+    if (!queue) {
+        return SDL_SetError("Out of memory");
+    }
+    cvt->queue = queue;
+    cvt->queue_cap = cap;
+    return 0;
+}
+
+/* Convert 'frames' frames of float samples to the output format and queue them */
+static int cvt_store(Mix_Converter *cvt, const float *src, int frames)
+{
+    if (cvt_reserve(cvt, frames * cvt->dst_frame) < 0) {
+        return -1;
+    }
+    _Mix_BusStore(cvt->queue + cvt->queue_len, src, cvt->dst_format, frames * cvt->dst_channels);
+    cvt->queue_len += frames * cvt->dst_frame;
+    return 0;
+}
+
+/* Filter as many frames into 'out' as the history allows, at most out_cap */
+static int cvt_resample(Mix_Converter *cvt)
+{
+    const int half = cvt->taps / 2;
+    const float *h;
+    float *out = cvt->out;
+    int n, c, k;
+
+    for (n = 0; n < cvt->out_cap; ++n) {
+        if (cvt->pos + cvt->taps > cvt->frames ||
+            (cvt->end >= 0 && cvt->pos + half - 1 >= cvt->end)) {
+            break;
+        }
+        if (cvt->phases == cvt->up) {
+            h = cvt->coefs + cvt->frac * cvt->taps;
+        } else {
+            Uint64 x = (Uint64)cvt->frac * cvt->phases;
+            const float *h0 = cvt->coefs + (int)(x / cvt->up) * cvt->taps;
+            const float *h1 = h0 + cvt->taps;
+            const float t = (float)(x % cvt->up) / (float)cvt->up;
+            for (k = 0; k < cvt->taps; ++k) {
+                cvt->row[k] = h0[k] + (h1[k] - h0[k]) * t;
+            }
+            h = cvt->row;
+        }
+        for (c = 0; c < cvt->channels; ++c) {
+            out[c] = _Mix_BusDot(h, cvt->planes + c * cvt->cap + cvt->pos, cvt->taps);
+        }
+        if (cvt->dst_channels > cvt->channels) {
+            /* Mono to stereo, after the filter for half the work */
+            out[1] = out[0];
+        }
+        out += cvt->dst_channels;
+
+        cvt->frac += cvt->down;
+        cvt->pos += cvt->frac / cvt->up;
+        cvt->frac %= cvt->up;
+    }
+    return n;
+}
+
+/* Run what's in the history through the filter, then drop what it's done with */
+static int cvt_drain(Mix_Converter *cvt)
+{
+    int n, c, shift;
+
+    do {
+        n = cvt_resample(cvt);
+        if (n > 0 && cvt_store(cvt, cvt->out, n) < 0) {
+            return -1;
+        }
+    } while (n == cvt->out_cap);
+
+    shift = SDL_min(cvt->pos, cvt->frames);
+    if (shift > 0) {
+        for (c = 0; c < cvt->channels; ++c) {
+            float *plane = cvt->planes + c * cvt->cap;
+            SDL_memmove(plane, plane + shift, (cvt->frames - shift) * sizeof(float));
+        }
+        cvt->frames -= shift;
+        cvt->pos -= shift;
+        if (cvt->end >= 0) {
+            cvt->end -= shift;
+        }
+    }
+    return 0;
+}
+
+/* Take a block of 'frames' input frames of floats in cvt->in */
+static int cvt_process(Mix_Converter *cvt, int frames)
+{
+    const float *in = cvt->in;
+    int i, c;
+
+    if (!cvt->resample) {
+        if (cvt->src_channels == cvt->dst_channels) {
+            return cvt_store(cvt, in, frames);
+        }
+        if (cvt->dst_channels == 2) {
+            for (i = 0; i < frames; ++i) {
+                cvt->out[2 * i] = cvt->out[2 * i + 1] = in[i];
+            }
+        } else {
+            for (i = 0; i < frames; ++i) {
+                cvt->out[i] = 0.5f * (in[2 * i] + in[2 * i + 1]);
+            }
+        }
+        return cvt_store(cvt, cvt->out, frames);
+    }
+
+    if (cvt->src_channels > cvt->channels) {
+        /* Stereo to mono, before the filter */
+        float *plane = cvt->planes + cvt->frames;
+        for (i = 0; i < frames; ++i) {
+            plane[i] = 0.5f * (in[2 * i] + in[2 * i + 1]);
+        }
+    } else {
+        for (c = 0; c < cvt->channels; ++c) {
+            float *plane = cvt->planes + c * cvt->cap + cvt->frames;
+            for (i = 0; i < frames; ++i) {
+                plane[i] = in[i * cvt->channels + c];
+            }
+        }
+    }
+    cvt->frames += frames;
+    return cvt_drain(cvt);
+}
+
+Mix_Converter *_Mix_NewConverter(SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                                 SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate)
+{
+    Mix_Converter *cvt;
+    int g;
+
+    cvt = (Mix_Converter *)SDL_calloc(1, sizeof(Mix_Converter));
+    if (!cvt) {
+        SDL_SetError("Out of memory");
+        return NULL;
+    }
+
+    if (!cvt_format_ok(src_format) || !cvt_format_ok(dst_format) ||
+        src_rate <= 0 || dst_rate <= 0 || src_channels == 0 ||
+        !(src_channels == dst_channels ||
+          (src_channels == 1 && dst_channels == 2) ||
+          (src_channels == 2 && dst_channels == 1))) {
+        /* SDL knows how to lay out surround sound, or says what's wrong */
+        cvt->fallback = SDL_NewAudioStream(src_format, src_channels, src_rate,
+                                           dst_format, dst_channels, dst_rate);
+        if (!cvt->fallback) {
+            SDL_free(cvt);
+            return NULL;
+        }
+        return cvt;
+    }
+
+    cvt->src_format = src_format;
+    cvt->src_channels = src_channels;
+    cvt->src_frame = (SDL_AUDIO_BITSIZE(src_format) / 8) * src_channels;
+    cvt->dst_format = dst_format;
+    cvt->dst_channels = dst_channels;
+    cvt->dst_frame = (SDL_AUDIO_BITSIZE(dst_format) / 8) * dst_channels;
+    cvt->channels = SDL_min(src_channels, dst_channels);
+    cvt->resample = (src_rate != dst_rate);
+    cvt->out_cap = CVT_BLOCK;
+
+    if (cvt->resample) {
+        g = cvt_gcd(src_rate, dst_rate);
+        cvt->up = dst_rate / g;
+        cvt->down = src_rate / g;
+        if (cvt_build_filter(cvt) < 0) {
+            goto nomem;
+        }
+        /* History left over is always shorter than the filter, and a
+           flush pads it with as much again */
+        cvt->cap = CVT_BLOCK + 2 * cvt->taps;
+        cvt->planes = (float *)SDL_malloc(cvt->channels * cvt->cap * sizeof(float));
+        cvt->out_cap = (int)((Sint64)(CVT_BLOCK + cvt->taps) * cvt->up / cvt->down) + 2;
+        if (!cvt->planes) {
+            goto nomem;
+        }
+    }
+    cvt->in = (float *)SDL_malloc(CVT_BLOCK * src_channels * sizeof(float));
+    cvt->out = (float *)SDL_malloc(cvt->out_cap * dst_channels * sizeof(float));
+    if (!cvt->in || !cvt->out) {
+        goto nomem;
+    }
+    cvt_reset(cvt);
+    return cvt;
+
+nomem:
+    _Mix_FreeConverter(cvt);
+    SDL_SetError("Out of memory");
+    return NULL;
+}
+
+int _Mix_ConverterPut(Mix_Converter *cvt, const void *buf, int len)
+{
+    const Uint8 *src = (const Uint8 *)buf;
+    int frames, n;
+
+    if (cvt->fallback) {
+        return SDL_AudioStreamPut(cvt->fallback, buf, len);
+    }
+    if (len % cvt->src_frame) {
+        return SDL_SetError("Can't add partial sample frames");
+    }
+    for (frames = len / cvt->src_frame; frames > 0; frames -= n) {
+        n = SDL_min(frames, CVT_BLOCK);
+        _Mix_BusLoad(cvt->in, src, cvt->src_format, n * cvt->src_channels);
+        if (cvt_process(cvt, n) < 0) {
+            return -1;
+        }
+        src += n * cvt->src_frame;
+    }
+    return 0;
+}
+
+int _Mix_ConverterGet(Mix_Converter *cvt, void *buf, int len)
+{
+    int n;
+
+    if (cvt->fallback) {
+        return SDL_AudioStreamGet(cvt->fallback, buf, len);
+    }
+    n = cvt->queue_len - cvt->queue_head;
+    len -= len % cvt->dst_frame;
+    if (n > len) {
+        n = len;
+    }
+    if (n > 0) {
+        SDL_memcpy(buf, cvt->queue + cvt->queue_head, n);
+        cvt->queue_head += n;
+        if (cvt->queue_head == cvt->queue_len) {
+            cvt->queue_head = cvt->queue_len = 0;
+        }
+    }
+    return n;
+}
+
+int _Mix_ConverterAvailable(Mix_Converter *cvt)
+{
+    if (cvt->fallback) {
+        return SDL_AudioStreamAvailable(cvt->fallback);
+    }
+    return cvt->queue_len - cvt->queue_head;
+}
+
+int _Mix_ConverterFlush(Mix_Converter *cvt)
+{
+    int c;
+
+    if (cvt->fallback) {
+        return SDL_AudioStreamFlush(cvt->fallback);
+    }
+    if (!cvt->resample) {
+        return 0;
+    }
+    /* Silence past the end, enough for the filter to get to it */
+    cvt->end = cvt->frames;
+    for (c = 0; c < cvt->channels; ++c) {
+        SDL_memset(cvt->planes + c * cvt->cap + cvt->frames, 0, cvt->taps * sizeof(float));
+    }
+    cvt->frames += cvt->taps;
+    if (cvt_drain(cvt) < 0) {
+        return -1;
+    }
+    cvt_reset(cvt);
+    return 0;
+}
+
+void _Mix_ConverterClear(Mix_Converter *cvt)
+{
+    if (cvt->fallback) {
+        SDL_AudioStreamClear(cvt->fallback);
+        return;
+    }
+    cvt->queue_head = cvt->queue_len = 0;
+    cvt_reset(cvt);
+}
+
+void _Mix_FreeConverter(Mix_Converter *cvt)
+{
+    if (!cvt) {
+        return;
+    }
+    if (cvt->fallback) {
+        SDL_FreeAudioStream(cvt->fallback);
+    }
+    SDL_free(cvt->coefs);
+    SDL_free(cvt->row);
+    SDL_free(cvt->planes);
+    SDL_free(cvt->in);
+    SDL_free(cvt->out);
+    SDL_free(cvt->queue);
+    SDL_free(cvt);
+}
+
+Uint8 *_Mix_ConvertAudio(const Uint8 *src, Uint32 len,
+                         SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                         SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate,
+                         Uint32 *dst_len)
+{
+    Mix_Converter *cvt;
+    Uint8 *dst = NULL;
+    int src_frame = (SDL_AUDIO_BITSIZE(src_format) / 8) * src_channels;
+    int n;
+
+    cvt = _Mix_NewConverter(src_format, src_channels, src_rate, dst_format, dst_channels, dst_rate);
+    if (!cvt) {
+        return NULL;
+    }
+    if (src_frame > 0) {
+        len -= len % src_frame;
+    }
+    if (!cvt->fallback) {
+        /* All of it in one allocation, with a frame over for rounding */
+        Sint64 frames = (Sint64)(len / src_frame) * dst_rate / src_rate + 2;
+        if (cvt_reserve(cvt, (int)(frames * cvt->dst_frame)) < 0) {
+            goto done;
+        }
+    }
+    if (_Mix_ConverterPut(cvt, src, (int)len) < 0 || _Mix_ConverterFlush(cvt) < 0) {
+        goto done;
+    }
+
+    if (cvt->fallback) {
+        n = SDL_AudioStreamAvailable(cvt->fallback);
+        dst = (Uint8 *)SDL_malloc(n ? n : 1);
+        if (!dst) {
+            SDL_SetError("Out of memory");
+            goto done;
+        }
+        n = SDL_AudioStreamGet(cvt->fallback, dst, n);
+        if (n < 0) {
+            SDL_free(dst);
+            dst = NULL;
+            goto done;
+        }
+    } else {
+        /* Hand over the queue, it's already the right size */
+        n = cvt->queue_len - cvt->queue_head;
+        SDL_memmove(cvt->queue, cvt->queue + cvt->queue_head, n);
+        dst = cvt->queue;
+        cvt->queue = NULL;
+    }
+    *dst_len = (Uint32)n;
+
+done:
+    _Mix_FreeConverter(cvt);
+    return dst;
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,61 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Sample format, channel and rate conversion for chunks and music.
+
+   A drop-in for SDL_AudioStream: samples go through the float bus
+   kernels of mixer_bus.c, and rates are changed in one pass by a
+   windowed sinc polyphase filter. Channel layouts other than the same
+   count, mono to stereo and stereo to mono are handed to an
+   SDL_AudioStream. A converter holds no global state, any number can run
+   on different threads at once.
+ */
+
+#ifndef MIXER_CONVERT_H_
+#define MIXER_CONVERT_H_
+
+#include "SDL_stdinc.h"
+#include "SDL_audio.h"
+
+typedef struct _Mix_Converter Mix_Converter;
+
+/* The same as SDL_NewAudioStream() and the rest.  Put and Get take whole
+   frames only, Flush pads the end of the input so the last of it comes
+   out, and the next Put starts afresh. */
+extern Mix_Converter *_Mix_NewConverter(SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                                        SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate);
+extern int _Mix_ConverterPut(Mix_Converter *cvt, const void *buf, int len);
+extern int _Mix_ConverterGet(Mix_Converter *cvt, void *buf, int len);
+extern int _Mix_ConverterAvailable(Mix_Converter *cvt);
+extern int _Mix_ConverterFlush(Mix_Converter *cvt);
+extern void _Mix_ConverterClear(Mix_Converter *cvt);
+extern void _Mix_FreeConverter(Mix_Converter *cvt);
+
+/* Convert all of 'len' bytes of 'src' in one go.  Returns a buffer to be
+   freed with SDL_free() and its length in 'dst_len', or NULL. */
+extern Uint8 *_Mix_ConvertAudio(const Uint8 *src, Uint32 len,
+                                SDL_AudioFormat src_format, Uint8 src_channels, int src_rate,
+                                SDL_AudioFormat dst_format, Uint8 dst_channels, int dst_rate,
+                                Uint32 *dst_len);
+
+#endif /* MIXER_CONVERT_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
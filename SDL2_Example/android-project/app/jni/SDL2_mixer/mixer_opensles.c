@@ -0,0 +1,363 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer_opensles.h"
+
+#ifdef __ANDROID__
+
+#include <jni.h>
+#include <SLES/OpenSLES.h>
+#include <SLES/OpenSLES_Android.h>
+
+/* One buffer plays while the other is mixed */
+#define NUM_BUFFERS     2
+
+static SLObjectItf engine_object = NULL;
+static SLObjectItf output_mix = NULL;
+static SLObjectItf player_object = NULL;
+static SLPlayItf player = NULL;
+static SLAndroidSimpleBufferQueueItf buffer_queue = NULL;
+static SDL_mutex *output_lock = NULL;
+static SDL_AudioSpec output;
+static Uint8 *buffers = NULL;
+static int next_buffer = 0;
+static SDL_bool suspended = SDL_FALSE;
+
+/* Ask SDLAudioManager what the device prefers, 0 if it can't tell */
+static int get_output_property(const char *method)
+{
+    JNIEnv *env = (JNIEnv *)SDL_AndroidGetJNIEnv();
+    jclass manager;
+    jmethodID mid;
+    int value = 0;
+
+    if (env == NULL) {
+        return 0;
+    }
+    manager = (*env)->FindClass(env, "org/libsdl/app/SDLAudioManager");
+    if (manager != NULL) {
+        mid = (*env)->GetStaticMethodID(env, manager, method, "()I");
+        if (mid != NULL) {
+            value = (*env)->CallStaticIntMethod(env, manager, mid);
+        }
+        (*env)->DeleteLocalRef(env, manager);
+    }
+    if ((*env)->ExceptionCheck(env)) {
+        (*env)->ExceptionClear(env);
+        value = 0;
+    }
+    return value;
+}
+
+static void SLAPIENTRY buffer_done(SLAndroidSimpleBufferQueueItf queue, void *context)
+{
+    Uint8 *buffer = buffers + next_buffer * output.size;
+
+    (void)context;
+    SDL_LockMutex(output_lock);
+    next_buffer = (next_buffer + 1) % NUM_BUFFERS;
+    /* A suspended queue just runs dry, _Mix_OpenSLES_Resume() refills it */
+    if (!suspended) {
+        output.callback(output.userdata, buffer, (int)output.size);
+        (*queue)->Enqueue(queue, buffer, output.size);
+    }
+    SDL_UnlockMutex(output_lock);
+}
+
+static int check(SLresult result, const char *what)
+{
+    if (result != SL_RESULT_SUCCESS) {
+        Mix_SetError("OpenSL ES %s failed (%u)", what, (unsigned)result);
+        return -1;
+    }
+    return 0;
+}
+
+/* Make the player, in float if 'is_float' and 16-bit otherwise */
+static int create_player(SLEngineItf engine, int freq, int channels, SDL_bool is_float)
+{
+    SLDataLocator_AndroidSimpleBufferQueue queue_locator;
+    SLDataFormat_PCM format;
+#ifdef SL_ANDROID_DATAFORMAT_PCM_EX
+    SLAndroidDataFormat_PCM_EX format_ex;
+#endif
+    SLDataSource source;
+    SLDataLocator_OutputMix mix_locator;
+    SLDataSink sink;
+    const SLInterfaceID ids[1] = { SL_IID_ANDROIDSIMPLEBUFFERQUEUE };
+    const SLboolean required[1] = { SL_BOOLEAN_TRUE };
+
+    queue_locator.locatorType = SL_DATALOCATOR_ANDROIDSIMPLEBUFFERQUEUE;
+    queue_locator.numBuffers = NUM_BUFFERS;
+    format.formatType = SL_DATAFORMAT_PCM;
+    format.numChannels = (SLuint32)channels;
+    format.samplesPerSec = (SLuint32)freq * 1000;  /* in milliHertz */
+    format.bitsPerSample = SL_PCMSAMPLEFORMAT_FIXED_16;
+    format.containerSize = SL_PCMSAMPLEFORMAT_FIXED_16;
+    format.channelMask = channels == 2 ? (SL_SPEAKER_FRONT_LEFT | SL_SPEAKER_FRONT_RIGHT) : SL_SPEAKER_FRONT_CENTER;
+    format.endianness = SL_BYTEORDER_LITTLEENDIAN;
+    source.pLocator = &queue_locator;
+    source.pFormat = &format;
+#ifdef SL_ANDROID_DATAFORMAT_PCM_EX
+    /* Float buffers need API level 21, older devices fail to make them */
+    if (is_float) {
+        format_ex.formatType = SL_ANDROID_DATAFORMAT_PCM_EX;
+        format_ex.numChannels = format.numChannels;
+        format_ex.sampleRate = format.samplesPerSec;
+        format_ex.bitsPerSample = SL_PCMSAMPLEFORMAT_FIXED_32;
+        format_ex.containerSize = SL_PCMSAMPLEFORMAT_FIXED_32;
+        format_ex.channelMask = format.channelMask;
+        format_ex.endianness = format.endianness;
+        format_ex.representation = SL_ANDROID_PCM_REPRESENTATION_FLOAT;
+        source.pFormat = &format_ex;
+    }
+#else
+    if (is_float) {
+        Mix_SetError("OpenSL ES float output isn't supported by this build");
+        return -1;
+    }
+#endif
+    mix_locator.locatorType = SL_DATALOCATOR_OUTPUTMIX;
+    mix_locator.outputMix = output_mix;
+    sink.pLocator = &mix_locator;
+    sink.pFormat = NULL;
+
+    if (check((*engine)->CreateAudioPlayer(engine, &player_object, &source, &sink, 1, ids, required), "player") < 0) {
+        player_object = NULL;
+        return -1;
+    }
+    if (check((*player_object)->Realize(player_object, SL_BOOLEAN_FALSE), "player") < 0) {
+        (*player_object)->Destroy(player_object);
+        player_object = NULL;
+        return -1;
+    }
+    return 0;
+}
+
+int _Mix_OpenSLES_GetNativeRate(void)
+{
+    return get_output_property("getOutputSampleRate");
+}
+
+int _Mix_OpenSLES_GetBurstSize(void)
+{
+    return get_output_property("getOutputFramesPerBuffer");
+}
+
+int _Mix_OpenSLES_Open(const SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
+{
+    SLEngineItf engine;
+    SDL_bool is_float;
+    int freq, frames, burst, channels;
+
+    if (desired->format != AUDIO_S16SYS && desired->format != AUDIO_F32SYS) {
+        Mix_SetError("OpenSL ES output is 16-bit or float only");
+        return -1;
+    }
+
+    /* Only a buffer queue at the device's rate, in multiples of its burst,
+       gets the fast mixer path with no resampling on the way.  The buffers
+       are the chunk size asked for, counted at that rate and rounded up
+       to whole bursts. */
+    freq = _Mix_OpenSLES_GetNativeRate();
+    if (freq <= 0) {
+        freq = desired->freq;
+    }
+    frames = desired->samples;
+    if (freq != desired->freq && desired->freq > 0) {
+        frames = SDL_max(1, (int)((Sint64)frames * freq / desired->freq));
+    }
+    burst = _Mix_OpenSLES_GetBurstSize();
+    if (burst > 0) {
+        frames = ((frames + burst - 1) / burst) * burst;
+        while (frames > 0xFFFF) {
+            frames -= burst;
+        }
+        frames = SDL_max(frames, burst);
+    }
+    channels = desired->channels >= 2 ? 2 : 1;
+
+    if (check(slCreateEngine(&engine_object, 0, NULL, 0, NULL, NULL), "engine") < 0 ||
+        check((*engine_object)->Realize(engine_object, SL_BOOLEAN_FALSE), "engine") < 0 ||
+        check((*engine_object)->GetInterface(engine_object, SL_IID_ENGINE, &engine), "engine") < 0 ||
+        check((*engine)->CreateOutputMix(engine, &output_mix, 0, NULL, NULL), "output mix") < 0 ||
+        check((*output_mix)->Realize(output_mix, SL_BOOLEAN_FALSE), "output mix") < 0) {
+        _Mix_OpenSLES_Close();
+        return -1;
+    }
+
+    /* The mixer works in float, so float output skips its last conversion */
+    is_float = (desired->format == AUDIO_F32SYS);
+    if (is_float && create_player(engine, freq, channels, SDL_TRUE) < 0) {
+        is_float = SDL_FALSE;
+    }
+    if ((!is_float && create_player(engine, freq, channels, SDL_FALSE) < 0) ||
+        check((*player_object)->GetInterface(player_object, SL_IID_PLAY, &player), "player") < 0 ||
+        check((*player_object)->GetInterface(player_object, SL_IID_ANDROIDSIMPLEBUFFERQUEUE, &buffer_queue), "buffer queue") < 0 ||
+        check((*buffer_queue)->RegisterCallback(buffer_queue, buffer_done, NULL), "buffer queue") < 0) {
+        _Mix_OpenSLES_Close();
+        return -1;
+    }
+
+    SDL_zerop(obtained);
+    obtained->freq = freq;
+    obtained->format = is_float ? AUDIO_F32SYS : AUDIO_S16SYS;
+    obtained->channels = (Uint8)channels;
+    obtained->samples = (Uint16)frames;
+    obtained->silence = 0;
+    obtained->size = (Uint32)frames * channels * (SDL_AUDIO_BITSIZE(obtained->format) / 8);
+    obtained->callback = desired->callback;
+    obtained->userdata = desired->userdata;
+    output = *obtained;
+
+    output_lock = SDL_CreateMutex();
+    buffers = (Uint8 *)SDL_calloc(NUM_BUFFERS, output.size);
+    if (output_lock == NULL || buffers == NULL) {
+        _Mix_OpenSLES_Close();
+        Mix_SetError("Out of memory");
+        return -1;
+    }
+    return 0;
+}
+void _Mix_OpenSLES_Start(void)
+{
+    int i;
+
+    /* Start on silence, each buffer that finishes is mixed and queued again */
+    next_buffer = 0;
+    suspended = SDL_FALSE;
+    for (i = 0; i < NUM_BUFFERS; ++i) {
+        (*buffer_queue)->Enqueue(buffer_queue, buffers + i * output.size, output.size);
+    }
+    (*player)->SetPlayState(player, SL_PLAYSTATE_PLAYING);
+}
+
+void _Mix_OpenSLES_Close(void)
+{
+    /* Destroying the player waits for a callback in progress */
+    if (player_object != NULL) {
+        if (player != NULL) {
+            (*player)->SetPlayState(player, SL_PLAYSTATE_STOPPED);
+        }
+        (*player_object)->Destroy(player_object);
+        player_object = NULL;
+        player = NULL;
+        buffer_queue = NULL;
+    }
+    if (output_mix != NULL) {
+        (*output_mix)->Destroy(output_mix);
+        output_mix = NULL;
+    }
+    if (engine_object != NULL) {
+        (*engine_object)->Destroy(engine_object);
+        engine_object = NULL;
+    }
+    SDL_free(buffers);
+    buffers = NULL;
+    if (output_lock != NULL) {
+        SDL_DestroyMutex(output_lock);
+        output_lock = NULL;
+    }
+}
+
+void _Mix_OpenSLES_Suspend(void)
+{
+    suspended = SDL_TRUE;
+}
+
+void _Mix_OpenSLES_Resume(void)
+{
+    SLAndroidSimpleBufferQueueState state;
+    Uint32 i;
+
+    SDL_LockMutex(output_lock);
+    if (suspended && (*buffer_queue)->GetState(buffer_queue, &state) == SL_RESULT_SUCCESS) {
+        /* The buffers still queued finish first, in order from next_buffer */
+        for (i = state.count; i < NUM_BUFFERS; ++i) {
+            Uint8 *buffer = buffers + ((next_buffer + i) % NUM_BUFFERS) * output.size;
+            SDL_memset(buffer, output.silence, output.size);
+            (*buffer_queue)->Enqueue(buffer_queue, buffer, output.size);
+        }
+        suspended = SDL_FALSE;
+    }
+    SDL_UnlockMutex(output_lock);
+}
+
+void _Mix_OpenSLES_Lock(void)
+{
+    SDL_LockMutex(output_lock);
+}
+
+void _Mix_OpenSLES_Unlock(void)
+{
+    SDL_UnlockMutex(output_lock);
+}
+
+#else
+
+int _Mix_OpenSLES_GetNativeRate(void)
+{
+    return 0;
+}
+
+int _Mix_OpenSLES_GetBurstSize(void)
+{
+    return 0;
+}
+
+int _Mix_OpenSLES_Open(const SDL_AudioSpec *desired, SDL_AudioSpec *obtained)
+{
+    (void)desired;
+    (void)obtained;
+    Mix_SetError("OpenSL ES output is only available on Android");
+    return -1;
+}
+
+void _Mix_OpenSLES_Start(void)
+{
+}
+
+void _Mix_OpenSLES_Close(void)
+{
+}
+
+void _Mix_OpenSLES_Suspend(void)
+{
+}
+
+void _Mix_OpenSLES_Resume(void)
+{
+}
+
+void _Mix_OpenSLES_Lock(void)
+{
+}
+
+void _Mix_OpenSLES_Unlock(void)
+{
+}
+
+#endif /* __ANDROID__ */
+
+/* vi: set ts=4 sw=4 expandtab: */
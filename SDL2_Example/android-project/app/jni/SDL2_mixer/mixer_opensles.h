@@ -0,0 +1,59 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Output through an OpenSL ES buffer queue on Android.  The queue's own
+   callback, on the audio server's fast thread, runs the mixer callback
+   straight into the buffer being enqueued, one device burst at a time,
+   instead of SDL's AudioTrack thread handing each buffer to Java.
+ */
+
+#ifndef MIXER_OPENSLES_H_
+#define MIXER_OPENSLES_H_
+
+#include "SDL_audio.h"
+
+/* The sample rate the device mixes its output at, and the frames it
+   mixes at a time at that rate, 0 if it doesn't say */
+extern int _Mix_OpenSLES_GetNativeRate(void);
+extern int _Mix_OpenSLES_GetBurstSize(void);
+
+/* Open the output for 'desired', taking the device's own sample rate and
+   burst size where it reports them, and fill in 'obtained'.  Nothing is
+   mixed until _Mix_OpenSLES_Start().  AUDIO_F32SYS falls back to
+   AUDIO_S16SYS on devices without float output.  Returns -1 with the
+   error set if there's no OpenSL ES output, as anywhere but Android.
+ */
+extern int _Mix_OpenSLES_Open(const SDL_AudioSpec *desired, SDL_AudioSpec *obtained);
+extern void _Mix_OpenSLES_Start(void);
+extern void _Mix_OpenSLES_Close(void);
+
+/* Stop mixing once the buffers queued now have played, from within the
+   mixer callback, and start again from silence */
+extern void _Mix_OpenSLES_Suspend(void);
+extern void _Mix_OpenSLES_Resume(void);
+
+/* Held around every call to the mixer callback */
+extern void _Mix_OpenSLES_Lock(void);
+extern void _Mix_OpenSLES_Unlock(void);
+
+#endif /* MIXER_OPENSLES_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
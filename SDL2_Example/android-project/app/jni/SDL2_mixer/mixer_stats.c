@@ -0,0 +1,195 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer.h"
+#include "mixer_stats.h"
+#include "mixer_thread.h"
+
+/* Callback times are kept in a histogram for the percentile */
+#define STATS_BUCKET_US     20
+#define STATS_BUCKETS       1000    /* the last one takes anything longer */
+
+static Uint32 callbacks;
+static Uint64 callback_total_us;
+static Uint32 callback_min_us;
+static Uint32 callback_max_us;
+static Uint32 histogram[STATS_BUCKETS];
+static int active_channels;
+static int max_active_channels;
+static Uint64 effects_us;
+static SDL_SpinLock effects_lock;   /* also added to by the mixing workers */
+static Uint64 decode_us[MIX_MUSIC_TYPES];
+static SDL_SpinLock decode_lock;    /* also added to by the music decode thread */
+static Uint32 underruns;
+static Uint32 suspends;
+static Uint64 last_start;
+static Uint32 callback_cpus[MIX_STATS_CPUS];
+static Mix_ThreadPriority thread_priority = MIX_THREAD_DEFAULT;
+
+static Uint32 elapsed_us(Uint64 start)
+{
+    Uint64 ticks = SDL_GetPerformanceCounter() - start;
+    return (Uint32)((ticks * 1000000) / SDL_GetPerformanceFrequency());
+}
+
+Uint64 _Mix_StatsBeginCallback(void)
+{
+    return SDL_GetPerformanceCounter();
+}
+
+void _Mix_StatsEndCallback(Uint64 start, int active, int frames, int freq)
+{
+    Uint32 us = elapsed_us(start);
+    Uint32 bucket = us / STATS_BUCKET_US;
+    int cpu = _Mix_CurrentCPU();
+
+    /* SDL doesn't tell, but a callback coming well after the previous
+       buffer should have run out most likely means the device starved,
+       unless the output was suspended in between */
+    if (callbacks > 0 && freq > 0 && last_start != 0) {
+        Uint64 gap = ((start - last_start) * 1000000) / SDL_GetPerformanceFrequency();
+        if (gap > ((Uint64)frames * 1500000) / freq) {
+            ++underruns;
+        }
+    }
+    last_start = start;
+
+    if (callbacks == 0 || us < callback_min_us) {
+        callback_min_us = us;
+    }
+    if (us > callback_max_us) {
+        callback_max_us = us;
+    }
+    ++callbacks;
+    callback_total_us += us;
+    ++histogram[SDL_min(bucket, STATS_BUCKETS - 1)];
+    if (cpu >= 0) {
+        ++callback_cpus[SDL_min(cpu, MIX_STATS_CPUS - 1)];
+    }
+
+    active_channels = active;
+    if (active > max_active_channels) {
+        max_active_channels = active;
+    }
+}
+
+void _Mix_StatsAddEffects(Uint64 start)
+{
+    Uint32 us = elapsed_us(start);
+
+    SDL_AtomicLock(&effects_lock);
+    effects_us += us;
+    SDL_AtomicUnlock(&effects_lock);
+}
+
+void _Mix_StatsSuspended(void)
+{
+    ++suspends;
+    last_start = 0;
+}
+
+void _Mix_StatsSetThreadPriority(Mix_ThreadPriority priority)
+{
+    thread_priority = priority;
+}
+
+void _Mix_StatsAddDecode(Mix_MusicType type, Uint64 start)
+{
+    if ((int)type >= 0 && (int)type < MIX_MUSIC_TYPES) {
+        Uint32 us = elapsed_us(start);
+
+        SDL_AtomicLock(&decode_lock);
+        decode_us[type] += us;
+        SDL_AtomicUnlock(&decode_lock);
+    }
+}
+
+int Mix_GetMixerStats(Mix_MixerStats *stats)
+{
+    Uint32 count = 0, target;
+    int i;
+
+    if (!stats) {
+        Mix_SetError("stats parameter was NULL");
+        return -1;
+    }
+
+    Mix_LockAudio();
+    SDL_zerop(stats);
+    stats->callbacks = callbacks;
+    if (callbacks > 0) {
+        stats->callback_min_us = callback_min_us;
+        stats->callback_avg_us = (Uint32)(callback_total_us / callbacks);
+        stats->callback_max_us = callback_max_us;
+
+        /* Upper edge of the bucket holding the 99th percentile */
+        target = callbacks - callbacks / 100;
+        for (i = 0; i < STATS_BUCKETS; ++i) {
+            count += histogram[i];
+            if (count >= target) {
+                break;
+            }
+        }
+        stats->callback_p99_us = SDL_min((Uint32)(i + 1) * STATS_BUCKET_US, callback_max_us);
+    }
+    stats->active_channels = active_channels;
+    stats->max_active_channels = max_active_channels;
+    stats->effects_us = effects_us;
+    SDL_AtomicLock(&decode_lock);
+    for (i = 0; i < MIX_MUSIC_TYPES; ++i) {
+        stats->decode_us[i] = decode_us[i];
+    }
+    SDL_AtomicUnlock(&decode_lock);
+    stats->underruns = underruns;
+    stats->suspends = suspends;
+    for (i = 0; i < MIX_STATS_CPUS; ++i) {
+        stats->callback_cpus[i] = callback_cpus[i];
+    }
+    stats->thread_priority = thread_priority;
+    Mix_UnlockAudio();
+
+    return 0;
+}
+
+void Mix_ResetMixerStats(void)
+{
+    Mix_LockAudio();
+    callbacks = 0;
+    callback_total_us = 0;
+    callback_min_us = 0;
+    callback_max_us = 0;
+    SDL_zero(histogram);
+    active_channels = 0;
+    max_active_channels = 0;
+    effects_us = 0;
+    SDL_AtomicLock(&decode_lock);
+    SDL_zero(decode_us);
+    SDL_AtomicUnlock(&decode_lock);
+    underruns = 0;
+    suspends = 0;
+    SDL_zero(callback_cpus);
+    Mix_UnlockAudio();
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
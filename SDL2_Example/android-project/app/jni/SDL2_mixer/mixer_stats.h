@@ -0,0 +1,48 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Profiling counters of the mixing callback, see Mix_GetMixerStats().
+   These are only called from the audio callback, with the audio lock held,
+   except for _Mix_StatsAddEffects() which the mixing workers use as well,
+   and _Mix_StatsAddDecode() which the music decode thread uses.
+ */
+
+#ifndef MIXER_STATS_H_
+#define MIXER_STATS_H_
+
+#include "SDL_stdinc.h"
+
+/* Returns a timestamp to pass to _Mix_StatsEndCallback() */
+extern Uint64 _Mix_StatsBeginCallback(void);
+extern void _Mix_StatsEndCallback(Uint64 start, int active_channels, int frames, int freq);
+
+extern void _Mix_StatsAddEffects(Uint64 start);
+extern void _Mix_StatsAddDecode(Mix_MusicType type, Uint64 start);
+
+/* The callback suspended the output, see Mix_SetAutoSuspend() */
+extern void _Mix_StatsSuspended(void);
+
+/* What _Mix_ApplyThreadPolicy() got the callback's thread */
+extern void _Mix_StatsSetThreadPriority(Mix_ThreadPriority priority);
+
+#endif /* MIXER_STATS_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,94 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* For sched_getcpu() and the CPU_SET() macros */
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+
+#include "SDL.h"
+
+#include "SDL_mixer.h"
+#include "mixer_thread.h"
+
+#ifdef __linux__
+#include <sched.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+
+/* What Android gives its own audio threads, which apps are allowed too */
+#define AUDIO_THREAD_NICE   -16
+#endif
+
+Mix_ThreadPriority _Mix_ApplyThreadPolicy(Mix_ThreadPriority priority, Uint32 cpu_mask)
+{
+    Mix_ThreadPriority got = MIX_THREAD_DEFAULT;
+
+#ifdef __linux__
+    if (cpu_mask != 0) {
+        cpu_set_t cpus;
+        int i;
+
+        CPU_ZERO(&cpus);
+        for (i = 0; i < 32; ++i) {
+            if (cpu_mask & (1u << i)) {
+                CPU_SET(i, &cpus);
+            }
+        }
+        /* Pid 0 is the calling thread */
+        sched_setaffinity(0, sizeof(cpus), &cpus);
+    }
+
+    if (priority == MIX_THREAD_REALTIME) {
+        struct sched_param param;
+
+        /* Needs a privilege most apps don't have, they get high instead */
+        SDL_zero(param);
+        param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+        if (sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+            return MIX_THREAD_REALTIME;
+        }
+        priority = MIX_THREAD_HIGH;
+    }
+    if (priority == MIX_THREAD_HIGH &&
+        setpriority(PRIO_PROCESS, (id_t)syscall(SYS_gettid), AUDIO_THREAD_NICE) == 0) {
+        got = MIX_THREAD_HIGH;
+    }
+#else
+    (void)cpu_mask;     /* no portable way to pin a thread */
+    if (priority != MIX_THREAD_DEFAULT && SDL_SetThreadPriority(SDL_THREAD_PRIORITY_HIGH) == 0) {
+        got = MIX_THREAD_HIGH;
+    }
+#endif
+    return got;
+}
+
+int _Mix_CurrentCPU(void)
+{
+#ifdef __linux__
+    return sched_getcpu();
+#else
+    return -1;
+#endif
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
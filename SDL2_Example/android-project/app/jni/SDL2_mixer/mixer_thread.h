@@ -0,0 +1,41 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Scheduling of the thread running the audio callback, see
+   Mix_SetAudioThreadPolicy().  Everything here acts on the calling thread.
+ */
+
+#ifndef MIXER_THREAD_H_
+#define MIXER_THREAD_H_
+
+#include "SDL_mixer.h"
+
+/* Give the calling thread 'priority', or as close to it as the system
+   allows, and keep it on the cores in 'cpu_mask' unless that's 0.
+   Returns the priority it got. */
+extern Mix_ThreadPriority _Mix_ApplyThreadPolicy(Mix_ThreadPriority priority, Uint32 cpu_mask);
+
+/* The core the calling thread is running on, or -1 if there's no telling */
+extern int _Mix_CurrentCPU(void);
+
+#endif /* MIXER_THREAD_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -0,0 +1,111 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+#include "SDL.h"
+
+#include "mixer_trace.h"
+
+#ifdef MIX_USE_ATRACE
+
+#ifdef __ANDROID__
+#include <dlfcn.h>
+
+/* The NDK only has these from API level 23, so they're looked up */
+static void (*trace_begin)(const char *name) = NULL;
+static void (*trace_end)(void) = NULL;
+static SDL_atomic_t trace_loaded;
+static SDL_SpinLock trace_lock = 0;
+
+static void _Mix_TraceLoad(void)
+{
+    SDL_AtomicLock(&trace_lock);
+    if (!SDL_AtomicGet(&trace_loaded)) {
+        void *android = dlopen("libandroid.so", RTLD_NOW | RTLD_LOCAL);
+        if (android) {
+            trace_begin = (void (*)(const char *))dlsym(android, "ATrace_beginSection");
+            trace_end = (void (*)(void))dlsym(android, "ATrace_endSection");
+            if (!trace_begin || !trace_end) {
+                trace_begin = NULL;
+                trace_end = NULL;
+            }
+        }
+        SDL_AtomicSet(&trace_loaded, 1);
+    }
+    SDL_AtomicUnlock(&trace_lock);
+}
+
+void _Mix_TraceBegin(const char *name)
+{
+    if (!SDL_AtomicGet(&trace_loaded)) {
+        _Mix_TraceLoad();
+    }
+    if (trace_begin) {
+        trace_begin(name);
+    }
+}
+
+void _Mix_TraceEnd(void)
+{
+    /* Nothing began a section before the functions were looked up */
+    if (trace_end) {
+        trace_end();
+    }
+}
+
+#else
+
+/* Nowhere to send them elsewhere */
+void _Mix_TraceBegin(const char *name)
+{
+    (void)name;
+}
+
+void _Mix_TraceEnd(void)
+{
+}
+
+#endif /* __ANDROID__ */
+
+const char *_Mix_TraceDecodeName(Mix_MusicType type)
+{
+    switch (type) {
+    case MUS_CMD:
+        return "GetAudio CMD";
+    case MUS_WAV:
+        return "GetAudio WAV";
+    case MUS_MOD:
+        return "GetAudio MOD";
+    case MUS_MID:
+        return "GetAudio MID";
+    case MUS_OGG:
+        return "GetAudio OGG";
+    case MUS_MP3:
+        return "GetAudio MP3";
+    case MUS_FLAC:
+        return "GetAudio FLAC";
+    default:
+        return "GetAudio";
+    }
+}
+
+#endif /* MIX_USE_ATRACE */
+
+/* vi: set ts=4 sw=4 expandtab: */
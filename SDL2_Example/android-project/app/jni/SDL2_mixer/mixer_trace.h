@@ -0,0 +1,54 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Trace sections for Android's systrace and Perfetto, built in when
+   MIX_USE_ATRACE is defined and compiled out otherwise.  Sections nest,
+   and each one ends on the thread it began on.
+ */
+
+#ifndef MIXER_TRACE_H_
+#define MIXER_TRACE_H_
+
+#include "SDL_mixer.h"
+
+#ifdef MIX_USE_ATRACE
+
+extern void _Mix_TraceBegin(const char *name);
+extern void _Mix_TraceEnd(void);
+
+/* "GetAudio <format>", for the decoder of each music type */
+extern const char *_Mix_TraceDecodeName(Mix_MusicType type);
+
+#define MIX_TRACE_BEGIN(name)   _Mix_TraceBegin(name)
+#define MIX_TRACE_DECODE(type)  _Mix_TraceBegin(_Mix_TraceDecodeName(type))
+#define MIX_TRACE_END()         _Mix_TraceEnd()
+
+#else
+
+#define MIX_TRACE_BEGIN(name)
+#define MIX_TRACE_DECODE(type)
+#define MIX_TRACE_END()
+
+#endif /* MIX_USE_ATRACE */
+
+#endif /* MIXER_TRACE_H_ */
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -26,6 +26,9 @@
 
 #include "SDL_mixer.h"
 #include "mixer.h"
+#include "mixer_bus.h"
+#include "mixer_stats.h"
+#include "mixer_trace.h"
 #include "music.h"
 
 #include "music_cmd.h"
@@ -40,7 +43,13 @@
 #include "music_mad.h"
 #include "music_smpeg.h"
 #include "music_flac.h"
+#include "music_layers.h"
+#include "music_decoded.h"
+#define __MIX_INTERNAL_EFFECT__
+#include "effects_internal.h"
 #include "native_midi/native_midi.h"
+#include "load_mmap.h"
+#include "load_buffered.h"
 
 /* Check to make sure we are building with a new enough SDL */
 #if SDL_COMPILEDVERSION < SDL_VERSIONNUM(2, 0, 7)
@@ -55,21 +64,386 @@ char *music_cmd = NULL;
 static SDL_bool music_active = SDL_TRUE;
 static int music_volume = MIX_MAX_VOLUME;
 static Mix_Music * volatile music_playing = NULL;
+static Mix_Music * volatile music_outgoing = NULL;  /* fading out under a crossfade */
+static Uint8 *music_crossfade_buf = NULL;
 SDL_AudioSpec music_spec;
 
+/* How far ahead music is decoded on its own thread, 0 to decode in the
+   audio callback */
+static int music_decode_ahead_ms = 0;
+
+/* Music up to this long is decoded whole when it's loaded, 0 for none */
+static int music_decode_whole_ms = 0;
+
+/* Mix_Music objects not freed yet, see Mix_GetMemoryStats() */
+static SDL_atomic_t music_objects;
+
+/* The PCM decoded ahead for a playing music, a single producer single
+   consumer ring: the decode thread only moves 'head' and music_mixer()
+   only moves 'tail'.  While the ring is there the decode thread is the
+   only one to touch the decoder, so a seek or a stop is handed to it
+   rather than waiting out a decode, which could hold up the callback.
+   Where the decoder is at is published with the ring, for the position
+   and duration to be read without it.
+ */
+typedef struct
+{
+    double tell;            /* Tell() after the decode, -1 if unknown */
+    double duration;        /* Duration(), -1 if unknown */
+    Uint32 head;            /* 'head' once the decode was written */
+} music_ring_state;
+
+typedef struct
+{
+    SDL_Thread *thread;
+    SDL_sem *wake;          /* posted when music_mixer() frees some room */
+    SDL_atomic_t head;      /* bytes written so far */
+    SDL_atomic_t tail;      /* bytes read so far */
+    SDL_atomic_t done;      /* the decoder stopped, nothing follows 'head' */
+    SDL_atomic_t quit;
+    SDL_atomic_t stop;      /* Stop() the decoder on the way out */
+    SDL_atomic_t seek;      /* 1 + the ms to seek to, 0 for none */
+    SDL_atomic_t skip;      /* 'tail' moves up to this, past what a seek dropped */
+    Uint8 *data;
+    Uint32 size;            /* a power of two */
+    Uint8 *fragment;
+    int fragment_size;
+    music_ring_state states[3];
+    int back;               /* the decode thread's state */
+    int front;              /* the state read under the audio lock */
+    SDL_atomic_t middle;
+} music_ring;
+
 struct _Mix_Music {
     Mix_MusicInterface *interface;
     void *context;
+    music_ring *ring;
 
     SDL_bool playing;
+    SDL_bool prepared;  /* Mix_PrepareMusic() already started it */
+    int prepared_loops;
     Mix_Fading fading;
-    int fade_step;
-    int fade_steps;
+    int fade_step;      /* sample frames of the fade already played */
+    int fade_steps;     /* length of the fade in sample frames */
+
+    /* The first buffer, decoded by Mix_PreloadMUS() */
+    Uint8 *primed;
+    int primed_pos;
+    int primed_len;
+    SDL_bool primed_end;    /* the music ends with it */
+};
+
+struct _Mix_MusicPreload {
+    SDL_Thread *thread;
+    SDL_atomic_t done;
+    char *file;
+    int loops;
+    Mix_Music *music;       /* only read after joining the thread */
+    char error[256];        /* the SDL error is per thread */
 };
 
 /* Used to calculate fading steps */
 static int ms_per_step;
 
+/* Convert a fade length to sample frames */
+static int music_fade_frames(int ms)
+{
+    return (int)(((Sint64)ms * music_spec.freq) / 1000);
+}
+
+/* The fade level after 'step' frames of the current fade */
+static float music_fade_level(Mix_Music *music, int step)
+{
+    float level = 1.0f;
+
+    if (step < music->fade_steps) {
+        level = (float)step / music->fade_steps;
+    }
+    if (music->fading == MIX_FADING_OUT) {
+        level = 1.0f - level;
+    }
+    return level;
+}
+
+/* Fade the 'len' bytes of 'music' that were just written to 'stream' */
+static void music_apply_fade(Mix_Music *music, Uint8 *stream, int len)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(music_spec.format) / 8;
+    const int frame_size = sample_size * music_spec.channels;
+    int frames = len / frame_size;
+    int ramp = music->fade_steps - music->fade_step;
+    float level0, level1;
+
+    if (ramp > frames) {
+        ramp = frames;
+    }
+    if (ramp > 0) {
+        level0 = music_fade_level(music, music->fade_step);
+        level1 = music_fade_level(music, music->fade_step + ramp);
+        _Mix_BusRamp(stream, music_spec.format, ramp * music_spec.channels,
+                     music_spec.channels, level0, (level1 - level0) / ramp);
+        music->fade_step += ramp;
+    }
+
+    /* Anything past the end of a fade out is silent */
+    if (ramp < frames && music->fading == MIX_FADING_OUT) {
+        SDL_memset(stream + ramp * frame_size, music_spec.silence, (frames - ramp) * frame_size);
+    }
+}
+
+/* Whether 'interface' can decode on another thread than the audio callback,
+   as long as only one thread at a time uses each music object */
+SDL_bool music_interface_thread_safe(Mix_MusicInterface *interface)
+{
+    switch (interface->api) {
+    case MIX_MUSIC_WAVE:
+    case MIX_MUSIC_OGG:
+    case MIX_MUSIC_MPG123:
+    case MIX_MUSIC_MAD:
+    case MIX_MUSIC_FLAC:
+        return SDL_TRUE;
+    default:
+        return SDL_FALSE;
+    }
+}
+
+/* Append 'len' bytes, the caller made sure they fit */
+static void music_ring_write(music_ring *ring, const Uint8 *src, Uint32 len)
+{
+    Uint32 head = (Uint32)SDL_AtomicGet(&ring->head);
+    Uint32 offset = head & (ring->size - 1);
+    Uint32 first = SDL_min(len, ring->size - offset);
+
+    SDL_memcpy(ring->data + offset, src, first);
+    SDL_memcpy(ring->data, src + first, len - first);
+    /* Publish the bytes only once they're written */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->head, (int)(head + len));
+}
+
+/* Take up to 'len' bytes, returns how many there were */
+static Uint32 music_ring_read(music_ring *ring, Uint8 *dst, Uint32 len)
+{
+    Uint32 tail = (Uint32)SDL_AtomicGet(&ring->tail);
+    Uint32 head = (Uint32)SDL_AtomicGet(&ring->head);
+    Uint32 skip = (Uint32)SDL_AtomicGet(&ring->skip);
+    Uint32 offset, first;
+
+    SDL_MemoryBarrierAcquire();
+    if ((Sint32)(skip - tail) > 0) {
+        tail = skip;
+    }
+    if (len > head - tail) {
+        len = head - tail;
+    }
+    offset = tail & (ring->size - 1);
+    first = SDL_min(len, ring->size - offset);
+    SDL_memcpy(dst, ring->data + offset, first);
+    SDL_memcpy(dst + first, ring->data, len - first);
+    /* Give the room back only once the bytes are copied out */
+    SDL_MemoryBarrierRelease();
+    SDL_AtomicSet(&ring->tail, (int)(tail + len));
+
+    if (SDL_SemValue(ring->wake) == 0) {
+        SDL_SemPost(ring->wake);
+    }
+    return len;
+}
+
+/* Publish where the decoder of 'music' is at, once 'head' is written */
+static void music_ring_publish(Mix_Music *music, Uint32 head)
+{
+    music_ring *ring = music->ring;
+    music_ring_state *state = &ring->states[ring->back];
+
+    state->tell = music->interface->Tell ? music->interface->Tell(music->context) : -1.0;
+    state->duration = music->interface->Duration ? music->interface->Duration(music->context) : -1.0;
+    state->head = head;
+    ring->back = _Eff_slot_publish(&ring->middle, ring->back);
+}
+
+static int SDLCALL music_ring_thread(void *data)
+{
+    Mix_Music *music = (Mix_Music *)data;
+    music_ring *ring = music->ring;
+
+    while (!SDL_AtomicGet(&ring->quit)) {
+        Uint32 used;
+        Uint64 start;
+        int seek, left, len;
+
+        /* What was decoded before the seek is skipped, the ring plays
+           silence until it's done.  Another seek asked for meanwhile
+           keeps 'seek' set and goes round again. */
+        seek = SDL_AtomicGet(&ring->seek);
+        if (seek) {
+            music->interface->Seek(music->context, (seek - 1) / 1000.0);
+            music_ring_publish(music, (Uint32)SDL_AtomicGet(&ring->head));
+            SDL_AtomicSet(&ring->skip, SDL_AtomicGet(&ring->head));
+            SDL_AtomicSet(&ring->done, 0);
+            SDL_MemoryBarrierRelease();
+            SDL_AtomicCAS(&ring->seek, seek, 0);
+            continue;
+        }
+
+        /* A seek can clear 'done', so wait around rather than exit */
+        used = (Uint32)SDL_AtomicGet(&ring->head) - (Uint32)SDL_AtomicGet(&ring->tail);
+        SDL_MemoryBarrierAcquire();
+        if (SDL_AtomicGet(&ring->done) || ring->size - used < (Uint32)ring->fragment_size) {
+            SDL_SemWaitTimeout(ring->wake, 10);
+            continue;
+        }
+
+        start = _Mix_StatsBeginCallback();
+        MIX_TRACE_DECODE(music->interface->type);
+        left = music->interface->GetAudio(music->context, ring->fragment, ring->fragment_size);
+        MIX_TRACE_END();
+        _Mix_StatsAddDecode(music->interface->type, start);
+
+        len = ring->fragment_size;
+        if (left != 0) {
+            /* Either an error or finished playing with data left */
+            len = (left > 0) ? (len - left) : 0;
+        }
+        music_ring_write(ring, ring->fragment, (Uint32)len);
+        music_ring_publish(music, (Uint32)SDL_AtomicGet(&ring->head));
+        if (left != 0) {
+            SDL_AtomicSet(&ring->done, 1);
+        }
+    }
+
+    SDL_MemoryBarrierAcquire();
+    if (SDL_AtomicGet(&ring->stop) && music->interface->Stop) {
+        music->interface->Stop(music->context);
+    }
+    return 0;
+}
+
+/* Stop the decode thread of 'music' without waiting for it, this is safe
+   to call from the audio callback */
+static void music_ring_stop(Mix_Music *music)
+{
+    if (music->ring) {
+        SDL_MemoryBarrierRelease();
+        SDL_AtomicSet(&music->ring->quit, 1);
+        SDL_SemPost(music->ring->wake);
+    }
+}
+
+/* Wait for the decode thread of 'music' and free its ring */
+static void music_ring_free(Mix_Music *music)
+{
+    music_ring *ring = music->ring;
+
+    if (ring) {
+        music_ring_stop(music);
+        if (ring->thread) {
+            SDL_WaitThread(ring->thread, NULL);
+        }
+        if (ring->wake) {
+            SDL_DestroySemaphore(ring->wake);
+        }
+        SDL_free(ring->data);
+        SDL_free(ring->fragment);
+        SDL_free(ring);
+        music->ring = NULL;
+    }
+}
+
+/* Start decoding 'music' ahead, from wherever it was set up to play.
+   On failure the music simply keeps decoding in the audio callback.
+ */
+static void music_ring_start(Mix_Music *music)
+{
+    const int frame_size = (SDL_AUDIO_BITSIZE(music_spec.format) / 8) * music_spec.channels;
+    Uint32 want = (Uint32)(((Sint64)music_decode_ahead_ms * music_spec.freq / 1000) * frame_size);
+    music_ring *ring;
+
+    ring = (music_ring *)SDL_calloc(1, sizeof(*ring));
+    if (ring == NULL) {
+        return;
+    }
+    ring->fragment_size = music_spec.size;
+    if (want < 2 * music_spec.size) {
+        want = 2 * music_spec.size;
+    }
+    for (ring->size = 1; ring->size < want; ring->size <<= 1) {
+    }
+    ring->data = (Uint8 *)SDL_malloc(ring->size);
+    ring->fragment = (Uint8 *)SDL_malloc(ring->fragment_size);
+    ring->wake = SDL_CreateSemaphore(0);
+    music->ring = ring;
+    if (!ring->data || !ring->fragment || !ring->wake) {
+        music_ring_free(music);
+        return;
+    }
+
+    /* The volume is applied as the ring is read, so changes aren't late */
+    if (music->interface->SetVolume) {
+        music->interface->SetVolume(music->context, MIX_MAX_VOLUME);
+    }
+    ring->back = 0;
+    ring->front = 1;
+    SDL_AtomicSet(&ring->middle, 2);
+    ring->states[ring->front].tell = music->interface->Tell ? music->interface->Tell(music->context) : -1.0;
+    ring->states[ring->front].duration = music->interface->Duration ? music->interface->Duration(music->context) : -1.0;
+    ring->thread = SDL_CreateThread(music_ring_thread, "SDL_mixer music", music);
+    if (ring->thread == NULL) {
+        music_ring_free(music);
+        if (music->interface->SetVolume) {
+            music->interface->SetVolume(music->context, music_volume);
+        }
+    }
+}
+
+/* Drop the first buffer decoded by Mix_PreloadMUS(), if it's still there */
+static void music_primed_free(Mix_Music *music)
+{
+    if (music->primed) {
+        SDL_free(music->primed);
+        music->primed = NULL;
+    }
+    music->primed_pos = music->primed_len = 0;
+    music->primed_end = SDL_FALSE;
+}
+
+/* Copy out what is left of the primed buffer, returns the number of bytes
+   copied. The buffer itself is only freed outside the audio callback. */
+static int music_primed_getaudio(Mix_Music *music, Uint8 *stream, int len)
+{
+    int got = SDL_min(len, music->primed_len - music->primed_pos);
+
+    SDL_memcpy(stream, music->primed + music->primed_pos, got);
+    music_pcm_volume(stream, got, music_volume);
+    music->primed_pos += got;
+    if (music->primed_pos == music->primed_len && music->primed_end) {
+        music->playing = SDL_FALSE;
+    }
+    return got;
+}
+
+/* Copy the music decoded ahead into 'stream', returns the number of bytes
+   left like GetAudio() */
+static int music_ring_getaudio(music_ring *ring, Uint8 *stream, int len)
+{
+    SDL_bool done;
+    int got;
+
+    if (SDL_AtomicGet(&ring->seek)) {
+        /* Waiting for the decode thread to seek, this buffer stays silent */
+        return 0;
+    }
+    done = SDL_AtomicGet(&ring->done) ? SDL_TRUE : SDL_FALSE;
+    got = (int)music_ring_read(ring, stream, (Uint32)len);
+
+    music_pcm_volume(stream, got, music_volume);
+    if (got < len && !done) {
+        /* The decoder fell behind, the rest of this buffer stays silent */
+        return 0;
+    }
+    return len - got;
+}
+
 /* rcg06042009 report available decoders at runtime. */
 static const char **music_decoders = NULL;
 static int num_decoders = 0;
@@ -77,6 +451,30 @@ static int num_decoders = 0;
 /* Semicolon-separated SoundFont paths */
 static char* soundfont_paths = NULL;
 
+/* MIDI polyphony limit, 0 for the player's default */
+static int midi_voices = 0;
+static Mix_Resampler midi_resampler = MIX_RESAMPLE_LINEAR;
+
+/* Where parsed MIDI events are cached, or NULL */
+static char *midi_cache_dir = NULL;
+
+static const Mix_ModSettings mod_default_settings = {
+    MIX_MOD_RESAMPLE_FIR, 1, 0, 0, 0, 0
+};
+/* Whether mpg123 synthesizes at music_spec.freq */
+static SDL_bool mp3_device_rate = SDL_FALSE;
+
+static Mix_ModSettings mod_settings = {
+    MIX_MOD_RESAMPLE_FIR, 1, 0, 0, 0, 0
+};
+
+static const Mix_FluidSynthSettings fluid_default_settings = {
+    0, MIX_FLUID_INTERP_4THORDER, 1, 1
+};
+static Mix_FluidSynthSettings fluid_settings = {
+    0, MIX_FLUID_INTERP_4THORDER, 1, 1
+};
+
 /* Interfaces for the various music interfaces, ordered by priority */
 static Mix_MusicInterface *s_music_interfaces[] =
 {
@@ -164,10 +562,14 @@ static void add_music_decoder(const char *decoder)
 /* Local low-level functions prototypes */
 static void music_internal_initialize_volume(void);
 static void music_internal_volume(int volume);
+static void music_internal_set_volume(Mix_Music *music, int volume);
 static int  music_internal_play(Mix_Music *music, int play_count, double position);
 static int  music_internal_position(double position);
 static SDL_bool music_internal_playing(void);
+static void music_internal_stop(Mix_Music *music);
 static void music_internal_halt(void);
+static void music_internal_halt_outgoing(void);
+static void music_internal_fade_out(Mix_Music *music, int ms);
 
 
 /* Support for hooking when the music has finished */
@@ -180,73 +582,138 @@ void Mix_HookMusicFinished(void (SDLCALL *music_finished)(void))
     Mix_UnlockAudio();
 }
 
-/* Convenience function to fill audio and mix at the specified volume
+/* Convenience function to fill audio from a GetSome() callback, which
+   writes music_spec audio with its volume already applied.
    This is called from many music player's GetAudio callback.
  */
-int music_pcm_getaudio(void *context, void *data, int bytes, int volume,
+int music_pcm_getaudio(void *context, void *data, int bytes,
                        int (*GetSome)(void *context, void *data, int bytes, SDL_bool *done))
 {
-    Uint8 *snd = (Uint8 *)data;
-    Uint8 *dst;
+    Uint8 *dst = (Uint8 *)data;
     int len = bytes;
     SDL_bool done = SDL_FALSE;
 
-    if (volume == MIX_MAX_VOLUME) {
-        dst = snd;
-    } else {
-        dst = SDL_stack_alloc(Uint8, bytes);
-    }
     while (len > 0 && !done) {
         int consumed = GetSome(context, dst, len, &done);
         if (consumed < 0) {
             break;
         }
+        dst += consumed;
+        len -= consumed;
+    }
+    return len;
+}
+
+/* Whether audio in this format can go to the output without converting */
+SDL_bool music_spec_matches(SDL_AudioFormat format, int channels, int freq)
+{
+    return (format == music_spec.format &&
+            channels == music_spec.channels &&
+            freq == music_spec.freq) ? SDL_TRUE : SDL_FALSE;
+}
+
+/* Scale 'bytes' of music_spec audio in place, for GetSome() callbacks to
+   apply their volume to what they just converted
+ */
+void music_pcm_volume(void *data, int bytes, int volume)
+{
+    const int sample_size = SDL_AUDIO_BITSIZE(music_spec.format) / 8;
 
-        if (volume == MIX_MAX_VOLUME) {
-            dst += consumed;
+    if (volume != MIX_MAX_VOLUME && bytes > 0) {
+        _Mix_BusRamp((Uint8 *)data, music_spec.format, bytes / sample_size, music_spec.channels,
+                     (float)volume / MIX_MAX_VOLUME, 0.0f);
+    }
+}
+
+/* Add the music fading out under a crossfade to 'stream' */
+static void music_mix_outgoing(Uint8 *stream, int len)
+{
+    while (music_outgoing && len > 0) {
+        Mix_Music *music = music_outgoing;
+        int size = SDL_min(len, (int)music_spec.size);
+        int left;
+
+        if (music->fade_step >= music->fade_steps) {
+            music_internal_halt_outgoing();
+            break;
+        }
+
+        SDL_memset(music_crossfade_buf, music_spec.silence, size);
+        if (music->primed_pos < music->primed_len) {
+            size = music_primed_getaudio(music, music_crossfade_buf, size);
+            left = (music->primed_end && music->primed_pos == music->primed_len) ? -1 : 0;
+        } else if (music->ring) {
+            left = music_ring_getaudio(music->ring, music_crossfade_buf, size);
+        } else if (music->interface->GetAudio) {
+            Uint64 start = _Mix_StatsBeginCallback();
+            MIX_TRACE_DECODE(music->interface->type);
+            left = music->interface->GetAudio(music->context, music_crossfade_buf, size);
+            MIX_TRACE_END();
+            _Mix_StatsAddDecode(music->interface->type, start);
         } else {
-            SDL_MixAudioFormat(snd, dst, music_spec.format, (Uint32)consumed, volume);
-            snd += consumed;
+            left = -1;
         }
-        len -= consumed;
-    }
-    if (volume != MIX_MAX_VOLUME) {
-        SDL_stack_free(dst);
+        music_apply_fade(music, music_crossfade_buf, (left > 0) ? (size - left) : size);
+        _Mix_MixAudioFormat(stream, music_crossfade_buf, music_spec.format, (Uint32)size, MIX_MAX_VOLUME);
+
+        /* Running out before the end of the fade just ends it early */
+        if (left != 0) {
+            music_internal_halt_outgoing();
+        }
+        stream += size;
+        len -= size;
     }
-    return len;
+}
+
+/* No music for the mixer to play, see Mix_SetAutoSuspend() */
+SDL_bool music_idle(void)
+{
+    return (music_playing == NULL && music_outgoing == NULL);
 }
 
 /* Mixing function */
 void SDLCALL music_mixer(void *udata, Uint8 *stream, int len)
 {
+    Uint8 *mix_stream = stream;
+    int mix_len = len;
+
+    MIX_TRACE_BEGIN("music_mixer");
     while (music_playing && music_active && len > 0) {
-        /* Handle fading */
-        if (music_playing->fading != MIX_NO_FADING) {
-            if (music_playing->fade_step++ < music_playing->fade_steps) {
-                int volume;
-                int fade_step = music_playing->fade_step;
-                int fade_steps = music_playing->fade_steps;
-
-                if (music_playing->fading == MIX_FADING_OUT) {
-                    volume = (music_volume * (fade_steps-fade_step)) / fade_steps;
-                } else { /* Fading in */
-                    volume = (music_volume * fade_step) / fade_steps;
-                }
-                music_internal_volume(volume);
-            } else {
-                if (music_playing->fading == MIX_FADING_OUT) {
-                    music_internal_halt();
-                    if (music_finished_hook) {
-                        music_finished_hook();
-                    }
-                    return;
+        /* Handle the end of a fade */
+        if (music_playing->fading != MIX_NO_FADING &&
+            music_playing->fade_step >= music_playing->fade_steps) {
+            if (music_playing->fading == MIX_FADING_OUT) {
+                music_internal_halt();
+                if (music_finished_hook) {
+                    music_finished_hook();
                 }
-                music_playing->fading = MIX_NO_FADING;
+                break;
             }
+            music_playing->fading = MIX_NO_FADING;
         }
 
-        if (music_playing->interface->GetAudio) {
-            int left = music_playing->interface->GetAudio(music_playing->context, stream, len);
+        if (music_playing->primed_pos < music_playing->primed_len) {
+            int got = music_primed_getaudio(music_playing, stream, len);
+            if (music_playing->fading != MIX_NO_FADING) {
+                music_apply_fade(music_playing, stream, got);
+            }
+            stream += got;
+            len -= got;
+        } else if (music_playing->ring || music_playing->interface->GetAudio) {
+            int left;
+            if (music_playing->ring) {
+                left = music_ring_getaudio(music_playing->ring, stream, len);
+            } else {
+                Uint64 start = _Mix_StatsBeginCallback();
+                MIX_TRACE_DECODE(music_playing->interface->type);
+                left = music_playing->interface->GetAudio(music_playing->context, stream, len);
+                MIX_TRACE_END();
+                _Mix_StatsAddDecode(music_playing->interface->type, start);
+            }
+            if (music_playing->fading != MIX_NO_FADING) {
+                /* The fade is a ramp over the frames the music produced */
+                music_apply_fade(music_playing, stream, (left > 0) ? (len - left) : len);
+            }
             if (left != 0) {
                 /* Either an error or finished playing with data left */
                 music_playing->playing = SDL_FALSE;
@@ -268,6 +735,12 @@ void SDLCALL music_mixer(void *udata, Uint8 *stream, int len)
             }
         }
     }
+
+    /* The music fading out goes on top of whatever replaced it */
+    if (music_outgoing && music_active) {
+        music_mix_outgoing(mix_stream, mix_len);
+    }
+    MIX_TRACE_END();
 }
 
 /* Load the music interface libraries for a given music type */
@@ -383,6 +856,9 @@ void open_music(const SDL_AudioSpec *spec)
     music_spec = *spec;
     open_music_type(MUS_NONE);
 
+    /* Crossfades need somewhere to decode the music going out */
+    music_crossfade_buf = (Uint8 *)SDL_malloc(music_spec.size);
+
     Mix_VolumeMusic(MIX_MAX_VOLUME);
 
     /* Calculate the number of ms for each callback */
@@ -455,15 +931,81 @@ static Mix_MusicType detect_music_type(SDL_RWops *src)
     return detect_music_type_from_magic(magic);
 }
 
+/* Swap the decoder of music just loaded for all of it decoded, if it's
+   short enough, see Mix_SetMusicDecodeWhole() */
+static void music_decode_whole(Mix_Music *music)
+{
+    if (music_decode_whole_ms > 0 && ms_per_step != 0) {
+        DECODED_Create(&music->interface, &music->context, music_decode_whole_ms);
+    }
+}
+
+/* The type a file name's extension stands for, MUS_NONE to look inside */
+static const struct {
+    const char *ext;
+    Mix_MusicType type;
+} music_extensions[] = {
+    { "WAV",  MUS_WAV },
+    { "OGG",  MUS_OGG },
+    { "MP3",  MUS_MP3 },
+    { "FLAC", MUS_FLAC },
+    { "MID",  MUS_MID },
+    { "MIDI", MUS_MID },
+    { "KAR",  MUS_MID },
+    { "MPG",  MUS_MP3 },
+    { "MPEG", MUS_MP3 },
+    { "MAD",  MUS_MP3 },
+    { "669",  MUS_MOD },
+    { "AMF",  MUS_MOD },
+    { "AMS",  MUS_MOD },
+    { "DBM",  MUS_MOD },
+    { "DSM",  MUS_MOD },
+    { "FAR",  MUS_MOD },
+    { "IT",   MUS_MOD },
+    { "MED",  MUS_MOD },
+    { "MDL",  MUS_MOD },
+    { "MOD",  MUS_MOD },
+    { "MOL",  MUS_MOD },
+    { "MTM",  MUS_MOD },
+    { "NST",  MUS_MOD },
+    { "OKT",  MUS_MOD },
+    { "PTM",  MUS_MOD },
+    { "S3M",  MUS_MOD },
+    { "STM",  MUS_MOD },
+    { "ULT",  MUS_MOD },
+    { "UMX",  MUS_MOD },
+    { "WOW",  MUS_MOD },
+    { "XM",   MUS_MOD }
+};
+
+static Mix_MusicType music_type_from_extension(const char *file)
+{
+    const char *ext = SDL_strrchr(file, '.');
+    int i;
+
+    if (!ext || SDL_strlen(++ext) > 4) {
+        return MUS_NONE;
+    }
+    for (i = 0; i < SDL_arraysize(music_extensions); ++i) {
+        if (SDL_strcasecmp(ext, music_extensions[i].ext) == 0) {
+            return music_extensions[i].type;
+        }
+    }
+    return MUS_NONE;
+}
+
 /* Load a music file */
 Mix_Music *Mix_LoadMUS(const char *file)
 {
     int i;
     void *context;
-    char *ext;
-    Mix_MusicType type;
-    SDL_RWops *src;
 
+    if (file == NULL) {
+        Mix_SetError("Mix_LoadMUS with NULL file");
+        return NULL;
+    }
+
+    /* Only the external player takes a file name, and then it takes any */
     for (i = 0; i < SDL_arraysize(s_music_interfaces); ++i) {
         Mix_MusicInterface *interface = s_music_interfaces[i];
         if (!interface->opened || !interface->CreateFromFile) {
@@ -480,61 +1022,87 @@ Mix_Music *Mix_LoadMUS(const char *file)
             }
             music->interface = interface;
             music->context = context;
+            music_decode_whole(music);
+            SDL_AtomicAdd(&music_objects, 1);
             return music;
         }
     }
 
+    /* Use the extension as a first guess on the file type, the header
+       of the file is only read for the ones it doesn't tell */
+    return Mix_LoadMUSType(file, music_type_from_extension(file));
+}
+
+Mix_Music *Mix_LoadMUSType(const char *file, Mix_MusicType type)
+{
+    SDL_RWops *src;
+
+    if (file == NULL) {
+        Mix_SetError("Mix_LoadMUSType with NULL file");
+        return NULL;
+    }
     src = SDL_RWFromFile(file, "rb");
     if (src == NULL) {
         Mix_SetError("Couldn't open '%s'", file);
         return NULL;
     }
+    src = _Mix_RWFromMapped(src);
+    return Mix_LoadMUSType_RW(src, type, SDL_TRUE);
+}
+
+Mix_Music *Mix_LoadMUSStream(const char *url, int buffer_ms)
+{
+#ifdef MUSIC_MP3_MPG123
+    Mix_MusicInterface *interface = &Mix_MusicInterface_MPG123;
+    Mix_Music *music;
+    void *context;
 
-    /* Use the extension as a first guess on the file type */
-    type = MUS_NONE;
-    ext = strrchr(file, '.');
-    if (ext) {
-        ++ext; /* skip the dot in the extension */
-        if (SDL_strcasecmp(ext, "WAV") == 0) {
-            type = MUS_WAV;
-        } else if (SDL_strcasecmp(ext, "MID") == 0 ||
-                    SDL_strcasecmp(ext, "MIDI") == 0 ||
-                    SDL_strcasecmp(ext, "KAR") == 0) {
-            type = MUS_MID;
-        } else if (SDL_strcasecmp(ext, "OGG") == 0) {
-            type = MUS_OGG;
-        } else if (SDL_strcasecmp(ext, "FLAC") == 0) {
-            type = MUS_FLAC;
-        } else  if (SDL_strcasecmp(ext, "MPG") == 0 ||
-                     SDL_strcasecmp(ext, "MPEG") == 0 ||
-                     SDL_strcasecmp(ext, "MP3") == 0 ||
-                     SDL_strcasecmp(ext, "MAD") == 0) {
-            type = MUS_MP3;
-        } else if (SDL_strcasecmp(ext, "669") == 0 ||
-                    SDL_strcasecmp(ext, "AMF") == 0 ||
-                    SDL_strcasecmp(ext, "AMS") == 0 ||
-                    SDL_strcasecmp(ext, "DBM") == 0 ||
-                    SDL_strcasecmp(ext, "DSM") == 0 ||
-                    SDL_strcasecmp(ext, "FAR") == 0 ||
-                    SDL_strcasecmp(ext, "IT") == 0 ||
-                    SDL_strcasecmp(ext, "MED") == 0 ||
-                    SDL_strcasecmp(ext, "MDL") == 0 ||
-                    SDL_strcasecmp(ext, "MOD") == 0 ||
-                    SDL_strcasecmp(ext, "MOL") == 0 ||
-                    SDL_strcasecmp(ext, "MTM") == 0 ||
-                    SDL_strcasecmp(ext, "NST") == 0 ||
-                    SDL_strcasecmp(ext, "OKT") == 0 ||
-                    SDL_strcasecmp(ext, "PTM") == 0 ||
-                    SDL_strcasecmp(ext, "S3M") == 0 ||
-                    SDL_strcasecmp(ext, "STM") == 0 ||
-                    SDL_strcasecmp(ext, "ULT") == 0 ||
-                    SDL_strcasecmp(ext, "UMX") == 0 ||
-                    SDL_strcasecmp(ext, "WOW") == 0 ||
-                    SDL_strcasecmp(ext, "XM") == 0) {
-            type = MUS_MOD;
+    if (url == NULL) {
+        Mix_SetError("Mix_LoadMUSStream with NULL url");
+        return NULL;
+    }
+    Mix_ClearError();
+    if (!load_music_type(MUS_MP3) || !open_music_type(MUS_MP3) || !interface->opened) {
+        if (!*Mix_GetError()) {
+            Mix_SetError("Network streams are played with mpg123, which isn't available");
         }
+        return NULL;
     }
-    return Mix_LoadMUSType_RW(src, type, SDL_TRUE);
+
+    /* Not decoded whole, there's no end to wait for */
+    context = MPG123_CreateFromStream(url, buffer_ms);
+    if (!context) {
+        return NULL;
+    }
+    music = (Mix_Music *)SDL_calloc(1, sizeof(Mix_Music));
+    if (music == NULL) {
+        interface->Delete(context);
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+    music->interface = interface;
+    music->context = context;
+    SDL_AtomicAdd(&music_objects, 1);
+    return music;
+#else
+    (void)url;
+    (void)buffer_ms;
+    Mix_SetError("Network streams need mpg123, which SDL_mixer wasn't built with");
+    return NULL;
+#endif
+}
+
+int Mix_GetMusicStreamStatus(Mix_Music *music, Mix_StreamStatus *status)
+{
+    if (music == NULL || status == NULL) {
+        return Mix_SetError("Mix_GetMusicStreamStatus with NULL music or status");
+    }
+#ifdef MUSIC_MP3_MPG123
+    if (music->interface == &Mix_MusicInterface_MPG123) {
+        return MPG123_StreamStatus(music->context, status);
+    }
+#endif
+    return Mix_SetError("Not a network stream");
 }
 
 Mix_Music *Mix_LoadMUS_RW(SDL_RWops *src, int freesrc)
@@ -552,6 +1120,9 @@ Mix_Music *Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int freesrc)
         Mix_SetError("RWops pointer is NULL");
         return NULL;
     }
+    if (freesrc) {
+        src = _Mix_RWFromBuffered(src, freesrc);
+    }
     start = SDL_RWtell(src);
 
     /* If the caller wants auto-detection, figure out what kind of file
@@ -586,27 +1157,222 @@ Mix_Music *Mix_LoadMUSType_RW(SDL_RWops *src, Mix_MusicType type, int freesrc)
                 }
                 music->interface = interface;
                 music->context = context;
+                SDL_AtomicAdd(&music_objects, 1);
 
                 if (SDL_GetHintBoolean(SDL_MIXER_HINT_DEBUG_MUSIC_INTERFACES, SDL_FALSE)) {
                     SDL_Log("Loaded music with %s\n", interface->tag);
                 }
+                music_decode_whole(music);
                 return music;
             }
 
-            /* Reset the stream for the next decoder */
-            SDL_RWseek(src, start, RW_SEEK_SET);
-        }
+            /* Reset the stream for the next decoder */
+            SDL_RWseek(src, start, RW_SEEK_SET);
+        }
+    }
+
+    if (!*Mix_GetError()) {
+        Mix_SetError("Unrecognized audio format");
+    }
+    if (freesrc) {
+        SDL_RWclose(src);
+    } else {
+        SDL_RWseek(src, start, RW_SEEK_SET);
+    }
+    return NULL;
+}
+
+Mix_Music *Mix_LoadLayeredMUS(Mix_Music **stems, int count, int skip_muted)
+{
+    Mix_MusicInterface *interfaces[MIX_MAX_MUSIC_LAYERS];
+    void *contexts[MIX_MAX_MUSIC_LAYERS];
+    Mix_Music *music;
+    void *context;
+    int i, j;
+
+    if (stems == NULL || count < 1 || count > MIX_MAX_MUSIC_LAYERS) {
+        Mix_SetError("Layered music takes 1 to %d stems", MIX_MAX_MUSIC_LAYERS);
+        return NULL;
+    }
+    for (i = 0; i < count; ++i) {
+        if (stems[i] == NULL) {
+            Mix_SetError("Stem %d is NULL", i);
+            return NULL;
+        }
+        if (!stems[i]->interface->GetAudio) {
+            Mix_SetError("Stem %d can't be mixed with others", i);
+            return NULL;
+        }
+        for (j = 0; j < i; ++j) {
+            if (stems[j] == stems[i]) {
+                Mix_SetError("Stem %d is also stem %d", i, j);
+                return NULL;
+            }
+        }
+    }
+
+    Mix_LockAudio();
+    for (i = 0; i < count; ++i) {
+        if (stems[i] == music_playing || stems[i] == music_outgoing) {
+            Mix_UnlockAudio();
+            Mix_SetError("Stem %d is playing", i);
+            return NULL;
+        }
+    }
+    Mix_UnlockAudio();
+
+    music = (Mix_Music *)SDL_calloc(1, sizeof(Mix_Music));
+    if (music == NULL) {
+        Mix_SetError("Out of memory");
+        return NULL;
+    }
+    for (i = 0; i < count; ++i) {
+        interfaces[i] = stems[i]->interface;
+        contexts[i] = stems[i]->context;
+    }
+    context = LAYERS_Create(interfaces, contexts, count, skip_muted ? SDL_TRUE : SDL_FALSE);
+    if (context == NULL) {
+        SDL_free(music);
+        return NULL;
+    }
+
+    /* The decoders live on in the layers, anything a stem had prepared
+       on its own goes */
+    for (i = 0; i < count; ++i) {
+        music_ring_free(stems[i]);
+        music_primed_free(stems[i]);
+        SDL_free(stems[i]);
+    }
+    music->interface = &Mix_MusicInterface_LAYERS;
+    music->context = context;
+    /* The stems became this one */
+    SDL_AtomicAdd(&music_objects, 1 - count);
+    return music;
+}
+
+int Mix_FadeMusicLayer(Mix_Music *music, int layer, int volume, int ms)
+{
+    int retval;
+
+    if (music == NULL) {
+        Mix_SetError("music parameter was NULL");
+        return -1;
+    }
+    if (music->interface != &Mix_MusicInterface_LAYERS) {
+        Mix_SetError("Music isn't layered");
+        return -1;
+    }
+    volume = SDL_max(0, SDL_min(volume, MIX_MAX_VOLUME));
+
+    Mix_LockAudio();
+    retval = LAYERS_Fade(music->context, layer, volume, SDL_max(ms, 0));
+    Mix_UnlockAudio();
+
+    return retval;
+}
+
+/* Decode the first buffer of 'music', just prepared to play, up front. It
+   isn't handed out yet, so nothing else is using it in the meantime. */
+static void music_prime(Mix_Music *music)
+{
+    int left;
+
+    if (music->ring || !music->interface->GetAudio ||
+        !music_interface_thread_safe(music->interface)) {
+        return;
+    }
+    music->primed = (Uint8 *)SDL_malloc(music_spec.size);
+    if (music->primed == NULL) {
+        return;
+    }
+
+    /* Like the ring, the volume is applied as the buffer is played */
+    SDL_memset(music->primed, music_spec.silence, music_spec.size);
+    if (music->interface->SetVolume) {
+        music->interface->SetVolume(music->context, MIX_MAX_VOLUME);
+    }
+    MIX_TRACE_DECODE(music->interface->type);
+    left = music->interface->GetAudio(music->context, music->primed, (int)music_spec.size);
+    MIX_TRACE_END();
+    music_internal_set_volume(music, music_volume);
+    if (left < 0) {
+        music_primed_free(music);
+        return;
+    }
+    music->primed_len = (int)music_spec.size - left;
+    music->primed_end = (left != 0);
+}
+
+static int SDLCALL music_preload_thread(void *data)
+{
+    Mix_MusicPreload *preload = (Mix_MusicPreload *)data;
+    Mix_Music *music = Mix_LoadMUS(preload->file);
+
+    if (music == NULL) {
+        SDL_strlcpy(preload->error, Mix_GetError(), sizeof(preload->error));
+    } else if (Mix_PrepareMusic(music, preload->loops) == 0) {
+        music_prime(music);
+    }
+    preload->music = music;
+    SDL_AtomicSet(&preload->done, 1);
+    return 0;
+}
+
+Mix_MusicPreload *Mix_PreloadMUS(const char *file, int loops)
+{
+    Mix_MusicPreload *preload;
+
+    if (ms_per_step == 0) {
+        SDL_SetError("Audio device hasn't been opened");
+        return NULL;
+    }
+    if (file == NULL) {
+        Mix_SetError("file parameter was NULL");
+        return NULL;
     }
 
-    if (!*Mix_GetError()) {
-        Mix_SetError("Unrecognized audio format");
+    preload = (Mix_MusicPreload *)SDL_calloc(1, sizeof(*preload));
+    if (preload == NULL) {
+        Mix_SetError("Out of memory");
+        return NULL;
     }
-    if (freesrc) {
-        SDL_RWclose(src);
-    } else {
-        SDL_RWseek(src, start, RW_SEEK_SET);
+    preload->file = SDL_strdup(file);
+    preload->loops = loops;
+    if (preload->file == NULL) {
+        Mix_SetError("Out of memory");
+        SDL_free(preload);
+        return NULL;
     }
-    return NULL;
+    preload->thread = SDL_CreateThread(music_preload_thread, "SDL_mixer preload", preload);
+    if (preload->thread == NULL) {
+        SDL_free(preload->file);
+        SDL_free(preload);
+        return NULL;
+    }
+    return preload;
+}
+
+int Mix_PreloadedMUSReady(Mix_MusicPreload *preload)
+{
+    return (preload && SDL_AtomicGet(&preload->done)) ? 1 : 0;
+}
+
+Mix_Music *Mix_GetPreloadedMUS(Mix_MusicPreload *preload)
+{
+    Mix_Music *music;
+
+    if (preload == NULL) {
+        Mix_SetError("preload parameter was NULL");
+        return NULL;
+    }
+    SDL_WaitThread(preload->thread, NULL);
+    music = preload->music;
+    if (music == NULL) {
+        Mix_SetError("%s", preload->error);
+    }
+    SDL_free(preload->file);
+    SDL_free(preload);
+    return music;
 }
 
 /* Free a music chunk previously loaded */
@@ -626,13 +1392,25 @@ void Mix_FreeMusic(Mix_Music *music)
                 music_internal_halt();
             }
         }
+        if (music == music_outgoing) {
+            music_internal_halt_outgoing();
+        }
         Mix_UnlockAudio();
 
+        music_ring_free(music);
+        music_primed_free(music);
         music->interface->Delete(music->context);
         SDL_free(music);
+        SDL_AtomicAdd(&music_objects, -1);
     }
 }
 
+void music_memory(int *musics, Uint64 *decoded_bytes)
+{
+    *musics = SDL_AtomicGet(&music_objects);
+    *decoded_bytes = (Uint64)DECODED_Bytes();
+}
+
 /* Find out the music format of a mixer music, or the currently playing
    music, if 'music' is NULL.
 */
@@ -652,11 +1430,21 @@ Mix_MusicType Mix_GetMusicType(const Mix_Music *music)
     return(type);
 }
 
+/* Start decoding 'music' on its own thread, if it's wanted and possible */
+static void music_internal_decode_ahead(Mix_Music *music)
+{
+    if (music_decode_ahead_ms > 0 && !music->ring &&
+        music->interface->GetAudio && music_interface_thread_safe(music->interface)) {
+        music_ring_start(music);
+    }
+}
+
 /* Play a music chunk.  Returns 0, or -1 if there was an error.
  */
 static int music_internal_play(Mix_Music *music, int play_count, double position)
 {
     int retval = 0;
+    SDL_bool prepared;
 
 #if defined(__MACOSX__) && defined(MID_MUSIC_NATIVE)
     /* This fixes a bug with native MIDI on Mac OS X, where you
@@ -673,11 +1461,27 @@ static int music_internal_play(Mix_Music *music, int play_count, double position
     if (music_playing) {
         music_internal_halt();
     }
+    if (music == music_outgoing) {
+        music_internal_halt_outgoing();
+    }
+
+    /* Music that Mix_PrepareMusic() set up the same way just goes on */
+    prepared = (music->prepared && play_count == music->prepared_loops && position <= 0.0);
+    music->prepared = SDL_FALSE;
+    if (!prepared) {
+        /* The decode thread of a previous play may still be winding down */
+        music_ring_free(music);
+        music_primed_free(music);
+    }
     music_playing = music;
     music_playing->playing = SDL_TRUE;
 
     /* Set the initial volume */
     music_internal_initialize_volume();
+    if (prepared) {
+        _Mix_WakeOutput();
+        return 0;
+    }
 
     /* Set up for playback */
     retval = music->interface->Play(music->context, play_count);
@@ -694,10 +1498,16 @@ static int music_internal_play(Mix_Music *music, int play_count, double position
         }
     }
 
+    if (retval == 0) {
+        music_internal_decode_ahead(music);
+    }
+
     /* If the setup failed, we're not playing any music anymore */
     if (retval < 0) {
         music->playing = SDL_FALSE;
         music_playing = NULL;
+    } else {
+        _Mix_WakeOutput();
     }
     return(retval);
 }
@@ -724,7 +1534,7 @@ int Mix_FadeInMusicPos(Mix_Music *music, int loops, int ms, double position)
         music->fading = MIX_NO_FADING;
     }
     music->fade_step = 0;
-    music->fade_steps = ms/ms_per_step;
+    music->fade_steps = music_fade_frames(ms);
 
     /* Play the puppy */
     Mix_LockAudio();
@@ -752,14 +1562,107 @@ int Mix_PlayMusic(Mix_Music *music, int loops)
     return Mix_FadeInMusicPos(music, loops, 0, 0.0);
 }
 
+int Mix_PrepareMusic(Mix_Music *music, int loops)
+{
+    int retval;
+
+    if (ms_per_step == 0) {
+        SDL_SetError("Audio device hasn't been opened");
+        return(-1);
+    }
+    if (music == NULL) {
+        Mix_SetError("music parameter was NULL");
+        return(-1);
+    }
+    if (loops == 0) {
+        loops = 1;
+    }
+
+    Mix_LockAudio();
+    if (music == music_playing || music == music_outgoing) {
+        Mix_SetError("Music is already playing");
+        retval = -1;
+    } else {
+        music_ring_free(music);
+        music_primed_free(music);
+        music->prepared = SDL_FALSE;
+        music_internal_set_volume(music, music_volume);
+        retval = music->interface->Play(music->context, loops);
+        if (retval == 0) {
+            if (music->interface->Seek) {
+                music->interface->Seek(music->context, 0.0);
+            }
+            music->prepared = SDL_TRUE;
+            music->prepared_loops = loops;
+            music_internal_decode_ahead(music);
+        }
+    }
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
+int Mix_CrossFadeMusic(Mix_Music *music, int loops, int ms)
+{
+    int retval;
+
+    if (ms_per_step == 0) {
+        SDL_SetError("Audio device hasn't been opened");
+        return(-1);
+    }
+    if (music == NULL) {
+        Mix_SetError("music parameter was NULL");
+        return(-1);
+    }
+    if (loops == 0) {
+        loops = 1;
+    }
+
+    Mix_LockAudio();
+    /* Only two musics mix at once, a crossfade in progress is cut short */
+    if (music_outgoing) {
+        music_internal_halt_outgoing();
+    }
+    if (music_playing && music_playing != music && ms > 0 && music_crossfade_buf) {
+        music_internal_fade_out(music_playing, ms);
+        music_outgoing = music_playing;
+        music_playing = NULL;
+    }
+
+    if (ms > 0) {
+        music->fading = MIX_FADING_IN;
+    } else {
+        music->fading = MIX_NO_FADING;
+    }
+    music->fade_step = 0;
+    music->fade_steps = music_fade_frames(ms);
+    retval = music_internal_play(music, loops, 0.0);
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
 /* Set the playing music position */
 int music_internal_position(double position)
 {
-    if (music_playing->interface->Seek) {
+    music_ring *ring = music_playing->ring;
+    double ms;
+
+    if (!music_playing->interface->Seek) {
+        return -1;
+    }
+    music_primed_free(music_playing);
+    if (!ring) {
         return music_playing->interface->Seek(music_playing->context, position);
     }
-    return -1;
+
+    /* The decode thread seeks, so an error there can't be told here */
+    ms = SDL_max(position, 0.0) * 1000.0;
+    SDL_AtomicSet(&ring->seek, (int)SDL_min(ms, (double)(SDL_MAX_SINT32 - 1)) + 1);
+    SDL_SemPost(ring->wake);
+    return 0;
 }
+
 int Mix_SetMusicPosition(double position)
 {
     int retval;
@@ -779,23 +1682,115 @@ int Mix_SetMusicPosition(double position)
     return(retval);
 }
 
-/* Set the music's initial volume */
-static void music_internal_initialize_volume(void)
+/* What the decode thread of 'music' last published, under the audio lock */
+static const music_ring_state *music_ring_state_get(Mix_Music *music)
+{
+    music_ring *ring = music->ring;
+
+    _Eff_slot_acquire(&ring->middle, &ring->front);
+    return &ring->states[ring->front];
+}
+
+/* Get the play position of 'music', less what is still decoded ahead */
+static double music_internal_tell(Mix_Music *music)
 {
-    if (music_playing->fading == MIX_FADING_IN) {
-        music_internal_volume(0);
+    music_ring *ring = music->ring;
+    const music_ring_state *state;
+    double retval;
+    Uint32 ahead = (Uint32)(music->primed_len - music->primed_pos);
+    Uint32 tail, skip;
+    int seek;
+
+    if (!ring) {
+        retval = music->interface->Tell(music->context);
+    } else if ((seek = SDL_AtomicGet(&ring->seek)) != 0) {
+        /* The decode thread hasn't got there yet, but that's where it plays from */
+        return (seek - 1) / 1000.0;
     } else {
-        music_internal_volume(music_volume);
+        state = music_ring_state_get(music);
+        retval = state->tell;
+        tail = (Uint32)SDL_AtomicGet(&ring->tail);
+        skip = (Uint32)SDL_AtomicGet(&ring->skip);
+        if ((Sint32)(skip - tail) > 0) {
+            tail = skip;
+        }
+        /* What was read since it was published isn't ahead any more */
+        if ((Sint32)(state->head - tail) > 0) {
+            ahead += state->head - tail;
+        }
+    }
+
+    if (retval >= 0.0) {
+        const int frame_size = (SDL_AUDIO_BITSIZE(music_spec.format) / 8) * music_spec.channels;
+        retval -= (double)(ahead / frame_size) / music_spec.freq;
+        if (retval < 0.0) {
+            retval = 0.0;
+        }
+    }
+    return retval;
+}
+
+double Mix_GetMusicPosition(Mix_Music *music)
+{
+    double retval = -1.0;
+
+    Mix_LockAudio();
+    if (!music) {
+        music = music_playing;
+    }
+    if (!music) {
+        Mix_SetError("Music isn't playing");
+    } else if (!music->interface->Tell) {
+        Mix_SetError("Position not implemented for music type");
+    } else {
+        retval = music_internal_tell(music);
+    }
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
+double Mix_MusicDuration(Mix_Music *music)
+{
+    double retval = -1.0;
+
+    Mix_LockAudio();
+    if (!music) {
+        music = music_playing;
+    }
+    if (!music) {
+        Mix_SetError("Music isn't playing");
+    } else if (!music->interface->Duration) {
+        Mix_SetError("Duration not implemented for music type");
+    } else if (music->ring) {
+        retval = music_ring_state_get(music)->duration;
+    } else {
+        retval = music->interface->Duration(music->context);
     }
+    Mix_UnlockAudio();
+
+    return(retval);
+}
+
+/* Set the music's initial volume */
+static void music_internal_initialize_volume(void)
+{
+    /* Fades are applied on top of this by music_mixer() */
+    music_internal_volume(music_volume);
 }
 
 /* Set the music volume */
-static void music_internal_volume(int volume)
+static void music_internal_set_volume(Mix_Music *music, int volume)
 {
-    if (music_playing->interface->SetVolume) {
-        music_playing->interface->SetVolume(music_playing->context, volume);
+    /* Music decoded ahead gets music_volume as it's read from the ring */
+    if (music->interface->SetVolume && !music->ring) {
+        music->interface->SetVolume(music->context, volume);
     }
 }
+static void music_internal_volume(int volume)
+{
+    music_internal_set_volume(music_playing, volume);
+}
 int Mix_VolumeMusic(int volume)
 {
     int prev_volume;
@@ -812,24 +1807,45 @@ int Mix_VolumeMusic(int volume)
     if (music_playing) {
         music_internal_volume(music_volume);
     }
+    if (music_outgoing) {
+        music_internal_set_volume(music_outgoing, music_volume);
+    }
     Mix_UnlockAudio();
     return(prev_volume);
 }
 
 /* Halt playing of music */
+static void music_internal_stop(Mix_Music *music)
+{
+    /* Music decoded ahead is stopped by its decode thread once it's done
+       with the fragment it's on, this may be the audio callback */
+    if (music->ring) {
+        SDL_AtomicSet(&music->ring->stop, 1);
+    } else if (music->interface->Stop) {
+        music->interface->Stop(music->context);
+    }
+    music_ring_stop(music);
+
+    music->playing = SDL_FALSE;
+    music->prepared = SDL_FALSE;
+    music->fading = MIX_NO_FADING;
+}
 static void music_internal_halt(void)
 {
-    if (music_playing->interface->Stop) {
-        music_playing->interface->Stop(music_playing->context);
-    }
-
-    music_playing->playing = SDL_FALSE;
-    music_playing->fading = MIX_NO_FADING;
+    music_internal_stop(music_playing);
     music_playing = NULL;
 }
+static void music_internal_halt_outgoing(void)
+{
+    music_internal_stop(music_outgoing);
+    music_outgoing = NULL;
+}
 int Mix_HaltMusic(void)
 {
     Mix_LockAudio();
+    if (music_outgoing) {
+        music_internal_halt_outgoing();
+    }
     if (music_playing) {
         music_internal_halt();
         if (music_finished_hook) {
@@ -841,6 +1857,27 @@ int Mix_HaltMusic(void)
     return(0);
 }
 
+/* Start fading out 'music' from wherever its current fade is at */
+static void music_internal_fade_out(Mix_Music *music, int ms)
+{
+    int fade_steps = music_fade_frames(ms);
+
+    if (music->fading == MIX_NO_FADING || music->fade_steps <= 0) {
+        music->fade_step = 0;
+    } else {
+        Sint64 step;
+        int old_fade_steps = music->fade_steps;
+        if (music->fading == MIX_FADING_OUT) {
+            step = music->fade_step;
+        } else {
+            step = old_fade_steps - music->fade_step;
+        }
+        music->fade_step = (int)((step * fade_steps) / old_fade_steps);
+    }
+    music->fading = MIX_FADING_OUT;
+    music->fade_steps = fade_steps;
+}
+
 /* Progressively stop the music */
 int Mix_FadeOutMusic(int ms)
 {
@@ -858,21 +1895,7 @@ int Mix_FadeOutMusic(int ms)
 
     Mix_LockAudio();
     if (music_playing) {
-        int fade_steps = (ms + ms_per_step - 1) / ms_per_step;
-        if (music_playing->fading == MIX_NO_FADING) {
-            music_playing->fade_step = 0;
-        } else {
-            int step;
-            int old_fade_steps = music_playing->fade_steps;
-            if (music_playing->fading == MIX_FADING_OUT) {
-                step = music_playing->fade_step;
-            } else {
-                step = old_fade_steps - music_playing->fade_step + 1;
-            }
-            music_playing->fade_step = (step * fade_steps) / old_fade_steps;
-        }
-        music_playing->fading = MIX_FADING_OUT;
-        music_playing->fade_steps = fade_steps;
+        music_internal_fade_out(music_playing, ms);
         retval = 1;
     }
     Mix_UnlockAudio();
@@ -902,6 +1925,11 @@ void Mix_PauseMusic(void)
             music_playing->interface->Pause(music_playing->context);
         }
     }
+    if (music_outgoing) {
+        if (music_outgoing->interface->Pause) {
+            music_outgoing->interface->Pause(music_outgoing->context);
+        }
+    }
     music_active = SDL_FALSE;
     Mix_UnlockAudio();
 }
@@ -914,6 +1942,11 @@ void Mix_ResumeMusic(void)
             music_playing->interface->Resume(music_playing->context);
         }
     }
+    if (music_outgoing) {
+        if (music_outgoing->interface->Resume) {
+            music_outgoing->interface->Resume(music_outgoing->context);
+        }
+    }
     music_active = SDL_TRUE;
     Mix_UnlockAudio();
 }
@@ -928,6 +1961,28 @@ int Mix_PausedMusic(void)
     return (music_active == SDL_FALSE);
 }
 
+int Mix_SetMusicDecodeAhead(int ms)
+{
+    if (ms < 0) {
+        Mix_SetError("Invalid decode ahead time %d", ms);
+        return -1;
+    }
+    Mix_LockAudio();
+    music_decode_ahead_ms = ms;
+    Mix_UnlockAudio();
+    return 0;
+}
+
+int Mix_SetMusicDecodeWhole(int ms)
+{
+    if (ms < 0) {
+        Mix_SetError("Invalid decode length %d", ms);
+        return -1;
+    }
+    music_decode_whole_ms = ms;
+    return 0;
+}
+
 /* Check the status of the music */
 static SDL_bool music_internal_playing(void)
 {
@@ -935,7 +1990,8 @@ static SDL_bool music_internal_playing(void)
         return SDL_FALSE;
     }
 
-    if (music_playing->interface->IsPlaying) {
+    /* Music decoded ahead keeps playing until the ring runs dry */
+    if (music_playing->interface->IsPlaying && !music_playing->ring) {
         music_playing->playing = music_playing->interface->IsPlaying(music_playing->context);
     }
     return music_playing->playing;
@@ -990,6 +2046,11 @@ void close_music(void)
 
     Mix_HaltMusic();
 
+    if (music_crossfade_buf) {
+        SDL_free(music_crossfade_buf);
+        music_crossfade_buf = NULL;
+    }
+
     for (i = 0; i < SDL_arraysize(s_music_interfaces); ++i) {
         Mix_MusicInterface *interface = s_music_interfaces[i];
         if (!interface || !interface->opened) {
@@ -1006,6 +2067,10 @@ void close_music(void)
         SDL_free(soundfont_paths);
         soundfont_paths = NULL;
     }
+    if (midi_cache_dir) {
+        SDL_free(midi_cache_dir);
+        midi_cache_dir = NULL;
+    }
 
     /* rcg06042009 report available decoders at runtime. */
     if (music_decoders) {
@@ -1121,4 +2186,124 @@ int Mix_EachSoundFont(int (SDLCALL *function)(const char*, void*), void *data)
         return 0;
 }
 
+void Mix_SetMIDIVoices(int voices)
+{
+    midi_voices = SDL_max(voices, 0);
+}
+
+int Mix_GetMIDIVoices(void)
+{
+    return midi_voices;
+}
+
+int Mix_SetMIDIResampler(Mix_Resampler resampler)
+{
+    if (resampler != MIX_RESAMPLE_LINEAR &&
+        resampler != MIX_RESAMPLE_CUBIC &&
+        resampler != MIX_RESAMPLE_NEAREST) {
+        Mix_SetError("Unknown resampler");
+        return -1;
+    }
+    midi_resampler = resampler;
+    return 0;
+}
+
+Mix_Resampler Mix_GetMIDIResampler(void)
+{
+    return midi_resampler;
+}
+
+int Mix_SetMIDIThreads(int threads, int min_voices)
+{
+    if (threads < 0 || threads > 7) {
+        Mix_SetError("MIDI threads must be between 0 and 7");
+        return -1;
+    }
+#ifdef MUSIC_MID_TIMIDITY
+    return TIMIDITY_SetThreads(threads, min_voices);
+#else
+    (void)min_voices;
+    return 0;
+#endif
+}
+
+int Mix_SetMIDICacheDir(const char *dir)
+{
+    if (midi_cache_dir) {
+        SDL_free(midi_cache_dir);
+        midi_cache_dir = NULL;
+    }
+
+    if (dir) {
+        if (!(midi_cache_dir = SDL_strdup(dir))) {
+            Mix_SetError("Insufficient memory to set the MIDI cache directory");
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const char *Mix_GetMIDICacheDir(void)
+{
+    return midi_cache_dir;
+}
+
+void Mix_SetModSettings(const Mix_ModSettings *settings)
+{
+    Mix_ModSettings s = settings ? *settings : mod_default_settings;
+
+    if (s.resampler < MIX_MOD_RESAMPLE_NEAREST || s.resampler > MIX_MOD_RESAMPLE_FIR) {
+        s.resampler = MIX_MOD_RESAMPLE_FIR;
+    }
+    s.oversampling = (s.oversampling != 0);
+    s.reverb = SDL_max(0, SDL_min(s.reverb, 100));
+    s.megabass = SDL_max(0, SDL_min(s.megabass, 100));
+    s.surround = SDL_max(0, SDL_min(s.surround, 100));
+    if (s.max_mix_channels != 0) {
+        s.max_mix_channels = SDL_max(32, SDL_min(s.max_mix_channels, 256));
+    }
+
+    /* The backend reads them from the audio callback */
+    Mix_LockAudio();
+    mod_settings = s;
+    Mix_UnlockAudio();
+}
+
+void Mix_GetModSettings(Mix_ModSettings *settings)
+{
+    *settings = mod_settings;
+}
+
+void Mix_SetFluidSynthSettings(const Mix_FluidSynthSettings *settings)
+{
+    Mix_FluidSynthSettings s = settings ? *settings : fluid_default_settings;
+
+    s.polyphony = SDL_max(0, SDL_min(s.polyphony, 65535));
+    if (s.interpolation < MIX_FLUID_INTERP_NONE || s.interpolation > MIX_FLUID_INTERP_7THORDER) {
+        s.interpolation = MIX_FLUID_INTERP_4THORDER;
+    }
+    s.reverb = (s.reverb != 0);
+    s.chorus = (s.chorus != 0);
+
+    /* The backend reads them from the audio callback */
+    Mix_LockAudio();
+    fluid_settings = s;
+    Mix_UnlockAudio();
+}
+
+void Mix_GetFluidSynthSettings(Mix_FluidSynthSettings *settings)
+{
+    *settings = fluid_settings;
+}
+
+void Mix_SetMP3DeviceRate(int enable)
+{
+    mp3_device_rate = enable ? SDL_TRUE : SDL_FALSE;
+}
+
+int Mix_GetMP3DeviceRate(void)
+{
+    return mp3_device_rate;
+}
+
 /* vi: set ts=4 sw=4 expandtab: */
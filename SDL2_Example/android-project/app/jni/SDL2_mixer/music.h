@@ -39,6 +39,8 @@ typedef enum
     MIX_MUSIC_MAD,
     MIX_MUSIC_SMPEG,
     MIX_MUSIC_FLAC,
+    MIX_MUSIC_LAYERS,
+    MIX_MUSIC_DECODED,
     MIX_MUSIC_LAST
 } Mix_MusicAPI;
 
@@ -82,6 +84,18 @@ typedef struct
     /* Seek to a play position (in seconds) */
     int (*Seek)(void *music, double position);
 
+    /* Tell the play position (in seconds), or -1.0 if unknown */
+    double (*Tell)(void *music);
+
+    /* Get the music duration (in seconds), or -1.0 if unknown */
+    double (*Duration)(void *music);
+
+    /* Get the loop the music repeats forever once it gets to 'end', both in
+       seconds. Returns 1 if it has one, 0 if it plays straight through, -1
+       if it loops some other way. NULL if it always plays straight through.
+     */
+    int (*Loop)(void *music, double *start, double *end);
+
     /* Pause playing music */
     void (*Pause)(void *music);
 
@@ -106,13 +120,19 @@ typedef struct
 extern int get_num_music_interfaces(void);
 extern Mix_MusicInterface *get_music_interface(int index);
 extern Mix_MusicType detect_music_type_from_magic(const Uint8 *magic);
+extern SDL_bool music_interface_thread_safe(Mix_MusicInterface *interface);
 extern SDL_bool load_music_type(Mix_MusicType type);
 extern SDL_bool open_music_type(Mix_MusicType type);
 extern SDL_bool has_music(Mix_MusicType type);
 extern void open_music(const SDL_AudioSpec *spec);
-extern int music_pcm_getaudio(void *context, void *data, int bytes, int volume,
+extern int music_pcm_getaudio(void *context, void *data, int bytes,
                               int (*GetSome)(void *context, void *data, int bytes, SDL_bool *done));
+extern void music_pcm_volume(void *data, int bytes, int volume);
+extern SDL_bool music_spec_matches(SDL_AudioFormat format, int channels, int freq);
 extern void SDLCALL music_mixer(void *udata, Uint8 *stream, int len);
+extern SDL_bool music_idle(void);
+/* For Mix_GetMemoryStats() */
+extern void music_memory(int *musics, Uint64 *decoded_bytes);
 extern void close_music(void);
 extern void unload_music(void);
 
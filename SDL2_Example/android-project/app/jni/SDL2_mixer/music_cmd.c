@@ -279,6 +279,9 @@ Mix_MusicInterface Mix_MusicInterface_CMD =
     MusicCMD_IsPlaying,
     NULL,   /* GetAudio */
     NULL,   /* Seek */
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     MusicCMD_Pause,
     MusicCMD_Resume,
     MusicCMD_Stop,
@@ -0,0 +1,330 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file plays music that was decoded whole at load time: a short
+   looping track costs a memcpy() per callback, and seeking it is free.
+   Loops keep to what the decoder does, either the whole track 'play_count'
+   times or a loop it has that repeats forever. */
+
+#include "music_decoded.h"
+
+typedef struct {
+    Mix_MusicInterface interface;   /* the type of 'source', this player */
+    Mix_MusicInterface *source;
+    void *source_context;
+    SDL_AudioFormat format;         /* music_spec when decoded */
+    int channels;
+    int freq;
+    Uint8 *pcm;
+    Sint64 size;
+    Sint64 loop_start;  /* where it goes back to at 'size', or -1 to end */
+    Sint64 pos;
+    int play_count;
+    int volume;
+    SDL_bool streaming; /* the output changed since, the source plays */
+    SDL_bool ended;     /* the source ran out while streaming */
+} DECODED_Music;
+
+static Mix_MusicInterface Mix_MusicInterface_DECODED;
+
+static SDL_atomic_t decoded_bytes;
+
+/* Decode up to 'limit' bytes into music->pcm, returns 0 if it ended by
+   then or -1 otherwise */
+static int DECODED_Fill(DECODED_Music *music, Sint64 limit, SDL_bool to_end)
+{
+    Mix_MusicInterface *source = music->source;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music->format) / 8) * music->channels;
+    const int chunk = ((int)music_spec.size / frame_size) * frame_size;
+
+    music->pcm = (Uint8 *)SDL_malloc((size_t)limit);
+    if (music->pcm == NULL || chunk <= 0) {
+        return -1;
+    }
+    while (music->size < limit) {
+        int len = (int)SDL_min((Sint64)chunk, limit - music->size);
+        int left = source->GetAudio(music->source_context, music->pcm + music->size, len);
+        if (left < 0) {
+            return -1;
+        }
+        music->size += len - left;
+        if (left > 0) {
+            return 0;
+        }
+    }
+    /* Running into the limit is only the end when it was set there */
+    return to_end ? 0 : -1;
+}
+
+int DECODED_Create(Mix_MusicInterface **interface, void **context, int max_ms)
+{
+    Mix_MusicInterface *source = *interface;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music_spec.format) / 8) * music_spec.channels;
+    DECODED_Music *music;
+    double duration, start = 0.0, end = 0.0;
+    int loop = 0;
+    Sint64 limit;
+
+    if (!source->GetAudio || !source->Duration || !source->Play) {
+        return -1;
+    }
+    duration = source->Duration(*context);
+    if (duration <= 0.0 || duration * 1000.0 > max_ms) {
+        return -1;
+    }
+    if (source->Loop) {
+        loop = source->Loop(*context, &start, &end);
+        if (loop < 0) {
+            return -1;
+        }
+    }
+
+    music = (DECODED_Music *)SDL_calloc(1, sizeof(*music));
+    if (music == NULL) {
+        return -1;
+    }
+    music->interface = Mix_MusicInterface_DECODED;
+    music->interface.type = source->type;
+    music->source = source;
+    music->source_context = *context;
+    music->format = music_spec.format;
+    music->channels = music_spec.channels;
+    music->freq = music_spec.freq;
+    music->loop_start = -1;
+    music->volume = MIX_MAX_VOLUME;
+
+    /* A loop is only decoded up to its end, past that it never plays. The
+       duration is only a guide otherwise, give it a tenth of a second. */
+    if (loop) {
+        limit = (Sint64)(end * music->freq + 0.5) * frame_size;
+    } else {
+        limit = ((Sint64)(duration * music->freq + 0.5) + music->freq / 10) * frame_size;
+    }
+    if (source->SetVolume) {
+        source->SetVolume(*context, MIX_MAX_VOLUME);
+    }
+    if (limit <= 0 || source->Play(*context, 1) < 0 ||
+        DECODED_Fill(music, limit, loop ? SDL_TRUE : SDL_FALSE) < 0 ||
+        music->size == 0 || (loop && music->size < limit)) {
+        if (source->Stop) {
+            source->Stop(*context);
+        }
+        SDL_free(music->pcm);
+        SDL_free(music);
+        return -1;
+    }
+    if (source->Stop) {
+        source->Stop(*context);
+    }
+    if (loop) {
+        music->loop_start = SDL_min((Sint64)(start * music->freq + 0.5) * frame_size, music->size - frame_size);
+    }
+    if (music->size < limit) {
+        Uint8 *pcm = (Uint8 *)SDL_realloc(music->pcm, (size_t)music->size);
+        if (pcm) {
+            music->pcm = pcm;
+        }
+    }
+
+    SDL_AtomicAdd(&decoded_bytes, (int)music->size);
+    *interface = &music->interface;
+    *context = music;
+    return 0;
+}
+
+int DECODED_Bytes(void)
+{
+    return SDL_AtomicGet(&decoded_bytes);
+}
+
+static void DECODED_SetVolume(void *context, int volume)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    music->volume = volume;
+    if (music->source->SetVolume) {
+        music->source->SetVolume(music->source_context, volume);
+    }
+}
+
+static int DECODED_Play(void *context, int play_count)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    music->streaming = !music_spec_matches(music->format, music->channels, music->freq);
+    if (music->streaming) {
+        music->ended = SDL_FALSE;
+        return music->source->Play(music->source_context, play_count);
+    }
+    music->pos = 0;
+    music->play_count = play_count;
+    return 0;
+}
+
+static SDL_bool DECODED_IsPlaying(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    if (!music->streaming) {
+        return (music->play_count != 0) ? SDL_TRUE : SDL_FALSE;
+    }
+    if (music->source->IsPlaying) {
+        return music->source->IsPlaying(music->source_context);
+    }
+    return !music->ended;
+}
+
+static int DECODED_GetAudio(void *context, void *data, int bytes)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+    Uint8 *dst = (Uint8 *)data;
+    int filled = 0;
+
+    if (music->streaming) {
+        int left = music->source->GetAudio(music->source_context, data, bytes);
+        if (left != 0) {
+            music->ended = SDL_TRUE;
+        }
+        return left;
+    }
+
+    while (filled < bytes && music->play_count != 0) {
+        int amount = (int)SDL_min((Sint64)(bytes - filled), music->size - music->pos);
+        SDL_memcpy(dst + filled, music->pcm + music->pos, amount);
+        music->pos += amount;
+        filled += amount;
+        if (music->pos == music->size) {
+            if (music->loop_start >= 0) {
+                music->pos = music->loop_start;
+            } else {
+                if (music->play_count > 0) {
+                    --music->play_count;
+                }
+                music->pos = 0;
+            }
+        }
+    }
+    music_pcm_volume(data, filled, music->volume);
+    return bytes - filled;
+}
+
+static int DECODED_Seek(void *context, double position)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music->format) / 8) * music->channels;
+    Sint64 pos;
+
+    if (music->streaming) {
+        if (!music->source->Seek) {
+            return -1;
+        }
+        return music->source->Seek(music->source_context, position);
+    }
+    pos = (Sint64)(position * music->freq) * frame_size;
+    music->pos = SDL_max(0, SDL_min(pos, music->size - frame_size));
+    return 0;
+}
+
+static double DECODED_Tell(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music->format) / 8) * music->channels;
+
+    if (music->streaming) {
+        return music->source->Tell ? music->source->Tell(music->source_context) : -1.0;
+    }
+    return (double)(music->pos / frame_size) / music->freq;
+}
+
+/* The source knows of whatever follows the end of a loop */
+static double DECODED_Duration(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+    return music->source->Duration(music->source_context);
+}
+
+static void DECODED_Pause(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    if (music->streaming && music->source->Pause) {
+        music->source->Pause(music->source_context);
+    }
+}
+
+static void DECODED_Resume(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    if (music->streaming && music->source->Resume) {
+        music->source->Resume(music->source_context);
+    }
+}
+
+static void DECODED_Stop(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    if (music->streaming && music->source->Stop) {
+        music->source->Stop(music->source_context);
+    }
+}
+
+static void DECODED_Delete(void *context)
+{
+    DECODED_Music *music = (DECODED_Music *)context;
+
+    music->source->Delete(music->source_context);
+    SDL_AtomicAdd(&decoded_bytes, -(int)music->size);
+    SDL_free(music->pcm);
+    SDL_free(music);
+}
+
+/* Copied into each music, so it reports the type of what it decoded */
+static Mix_MusicInterface Mix_MusicInterface_DECODED =
+{
+    "DECODED",
+    MIX_MUSIC_DECODED,
+    MUS_NONE,
+    SDL_TRUE,
+    SDL_TRUE,
+
+    NULL,   /* Load */
+    NULL,   /* Open */
+    NULL,   /* CreateFromRW */
+    NULL,   /* CreateFromFile */
+    DECODED_SetVolume,
+    DECODED_Play,
+    DECODED_IsPlaying,
+    DECODED_GetAudio,
+    DECODED_Seek,
+    DECODED_Tell,
+    DECODED_Duration,
+    NULL,   /* Loop */
+    DECODED_Pause,
+    DECODED_Resume,
+    DECODED_Stop,
+    DECODED_Delete,
+    NULL,   /* Close */
+    NULL,   /* Unload */
+};
+
+/* vi: set ts=4 sw=4 expandtab: */
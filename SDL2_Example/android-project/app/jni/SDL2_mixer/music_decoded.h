@@ -0,0 +1,36 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file plays music decoded whole into memory when it was loaded */
+
+#include "music.h"
+
+/* Decode all of the music of 'interface' and 'context', if it's no longer
+   than 'max_ms' milliseconds, and replace them with a player of the result
+   in the music_spec format, which keeps the original to stream from if
+   that format changes. Returns 0, or -1 if the music wasn't decoded and
+   'interface' and 'context' are the same as before. */
+extern int DECODED_Create(Mix_MusicInterface **interface, void **context, int max_ms);
+
+/* Bytes of samples held by all the music decoded this way */
+extern int DECODED_Bytes(void);
+
+/* vi: set ts=4 sw=4 expandtab: */
@@ -28,6 +28,8 @@
 #include "SDL_loadso.h"
 
 #include "music_flac.h"
+#include "mixer_convert.h"
+#include "mixer_bus.h"
 
 #include <FLAC/stream_decoder.h>
 
@@ -141,9 +143,16 @@ typedef struct {
     unsigned sample_rate;
     unsigned channels;
     unsigned bits_per_sample;
+    FLAC__uint64 total_samples; /* from STREAMINFO, 0 if unknown */
+    FLAC__uint64 position;      /* sample after the last decoded frame */
     SDL_RWops *src;
     int freesrc;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;
+    SDL_bool passthrough;   /* frames are already music_spec, queued in 'pcm' */
+    Uint8 *pcm;             /* otherwise only scratch space for one frame */
+    int pcm_size;
+    int pcm_pos;
+    int pcm_len;
 } FLAC_Music;
 
 
@@ -250,10 +259,11 @@ static FLAC__StreamDecoderWriteStatus flac_write_music_cb(
 {
     FLAC_Music *music = (FLAC_Music *)client_data;
     Sint16 *data;
-    unsigned int i, j, channels;
+    unsigned int i, channels;
     int shift_amount = 0;
+    int size;
 
-    if (!music->stream) {
+    if (!music->stream && !music->passthrough) {
         return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
 
@@ -279,50 +289,49 @@ static FLAC__StreamDecoderWriteStatus flac_write_music_cb(
         channels = music->channels;
     }
 
-    data = SDL_stack_alloc(Sint16, (frame->header.blocksize * channels));
-    if (!data) {
-        SDL_SetError("Couldn't allocate %d bytes stack memory", (int)(frame->header.blocksize * channels * sizeof(*data)));
-        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+    music->position = frame->header.number.sample_number + frame->header.blocksize;
+
+    size = (int)(frame->header.blocksize * channels * sizeof(*data));
+
+    /* Interleave into 'pcm', kept across frames.  When passing through it
+       queues what FLAC_GetSome() hasn't copied out yet, otherwise it's
+       empty and the frame goes right on into the audio stream. */
+    if (music->pcm_pos > 0) {
+        SDL_memmove(music->pcm, music->pcm + music->pcm_pos, music->pcm_len - music->pcm_pos);
+        music->pcm_len -= music->pcm_pos;
+        music->pcm_pos = 0;
     }
+    if (music->pcm_len + size > music->pcm_size) {
+        Uint8 *pcm = (Uint8 *)SDL_realloc(music->pcm, music->pcm_len + size);
+        if (!pcm) {
+            SDL_OutOfMemory();
+            return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
+        }
+        music->pcm = pcm;
+        music->pcm_size = music->pcm_len + size;
+    }
+    data = (Sint16 *)(music->pcm + music->pcm_len);
+
     if (music->channels == 3) {
         Sint16 *dst = data;
         for (i = 0; i < frame->header.blocksize; ++i) {
-            Sint16 FL = (buffer[0][i] >> shift_amount);
-            Sint16 FR = (buffer[1][i] >> shift_amount);
-            Sint16 FCmix = (Sint16)((buffer[2][i] >> shift_amount) * 0.5f);
+            const int FCmix = (buffer[2][i] >> shift_amount) / 2;
             int sample;
 
-            sample = (FL + FCmix);
-            if (sample > SDL_MAX_SINT16) {
-                *dst = SDL_MAX_SINT16;
-            } else if (sample < SDL_MIN_SINT16) {
-                *dst = SDL_MIN_SINT16;
-            } else {
-                *dst = sample;
-            }
-            ++dst;
-
-            sample = (FR + FCmix);
-            if (sample > SDL_MAX_SINT16) {
-                *dst = SDL_MAX_SINT16;
-            } else if (sample < SDL_MIN_SINT16) {
-                *dst = SDL_MIN_SINT16;
-            } else {
-                *dst = sample;
-            }
-            ++dst;
+            sample = (buffer[0][i] >> shift_amount) + FCmix;
+            *dst++ = (Sint16)SDL_max(SDL_MIN_SINT16, SDL_min(sample, SDL_MAX_SINT16));
+            sample = (buffer[1][i] >> shift_amount) + FCmix;
+            *dst++ = (Sint16)SDL_max(SDL_MIN_SINT16, SDL_min(sample, SDL_MAX_SINT16));
         }
     } else {
-        for (i = 0; i < channels; ++i) {
-            Sint16 *dst = data + i;
-            for (j = 0; j < frame->header.blocksize; ++j) {
-                *dst = (buffer[i][j] >> shift_amount);
-                dst += channels;
-            }
-        }
+        _Mix_BusInterleaveS16(data, (const Sint32 *const *)buffer, channels, frame->header.blocksize, shift_amount);
+    }
+
+    if (music->passthrough) {
+        music->pcm_len += size;
+    } else if (_Mix_ConverterPut(music->stream, data, size) < 0) {
+        return FLAC__STREAM_DECODER_WRITE_STATUS_ABORT;
     }
-    SDL_AudioStreamPut(music->stream, data, (frame->header.blocksize * channels * sizeof(*data)));
-    SDL_stack_free(data);
 
     return FLAC__STREAM_DECODER_WRITE_STATUS_CONTINUE;
 }
@@ -342,6 +351,7 @@ static void flac_metadata_music_cb(
     music->sample_rate = metadata->data.stream_info.sample_rate;
     music->channels = metadata->data.stream_info.channels;
     music->bits_per_sample = metadata->data.stream_info.bits_per_sample;
+    music->total_samples = metadata->data.stream_info.total_samples;
 /*printf("FLAC: Sample rate = %d, channels = %d, bits_per_sample = %d\n", music->sample_rate, music->channels, music->bits_per_sample);*/
 
     /* SDL's channel mapping and FLAC channel mapping are the same,
@@ -352,9 +362,24 @@ static void flac_metadata_music_cb(
     } else {
         channels = music->channels;
     }
+
+    /* Room for the largest frame, so decoding doesn't allocate */
+    if (!music->pcm && metadata->data.stream_info.max_blocksize > 0) {
+        music->pcm_size = (int)(metadata->data.stream_info.max_blocksize * channels * sizeof(Sint16));
+        music->pcm = (Uint8 *)SDL_malloc(music->pcm_size);
+        if (!music->pcm) {
+            music->pcm_size = 0;
+        }
+    }
+
+    if (music_spec_matches(AUDIO_S16SYS, channels, music->sample_rate)) {
+        music->passthrough = SDL_TRUE;
+        return;
+    }
+
     /* We check for NULL stream later when we get data */
     SDL_assert(!music->stream);
-    music->stream = SDL_NewAudioStream(AUDIO_S16SYS, channels, music->sample_rate,
+    music->stream = _Mix_NewConverter(AUDIO_S16SYS, channels, music->sample_rate,
                                       music_spec.format, music_spec.channels, music_spec.freq);
 }
 
@@ -461,8 +486,15 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     FLAC_Music *music = (FLAC_Music *)context;
     int filled;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    if (music->passthrough) {
+        filled = SDL_min(bytes, music->pcm_len - music->pcm_pos);
+        SDL_memcpy(data, music->pcm + music->pcm_pos, filled);
+        music->pcm_pos += filled;
+    } else {
+        filled = _Mix_ConverterGet(music->stream, data, bytes);
+    }
     if (filled != 0) {
+        music_pcm_volume(data, filled, music->volume);
         return filled;
     }
 
@@ -480,7 +512,9 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     if (flac.FLAC__stream_decoder_get_state(music->flac_decoder) == FLAC__STREAM_DECODER_END_OF_STREAM) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            if (music->stream) {
+                _Mix_ConverterFlush(music->stream);
+            }
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -497,8 +531,7 @@ static int FLAC_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 /* Play some of a stream previously started with FLAC_play() */
 static int FLAC_GetAudio(void *context, void *data, int bytes)
 {
-    FLAC_Music *music = (FLAC_Music *)context;
-    return music_pcm_getaudio(context, data, bytes, music->volume, FLAC_GetSome);
+    return music_pcm_getaudio(context, data, bytes, FLAC_GetSome);
 }
 
 /* Jump (seek) to a given position (position is in seconds) */
@@ -507,6 +540,9 @@ static int FLAC_Seek(void *context, double position)
     FLAC_Music *music = (FLAC_Music *)context;
     double seek_sample = music->sample_rate * position;
 
+    /* Whatever is still queued is from before the seek */
+    music->pcm_pos = music->pcm_len = 0;
+
     if (!flac.FLAC__stream_decoder_seek_absolute(music->flac_decoder, (FLAC__uint64)seek_sample)) {
         if (flac.FLAC__stream_decoder_get_state(music->flac_decoder) == FLAC__STREAM_DECODER_SEEK_ERROR) {
             flac.FLAC__stream_decoder_flush(music->flac_decoder);
@@ -518,6 +554,28 @@ static int FLAC_Seek(void *context, double position)
     return 0;
 }
 
+/* Return the current position in seconds */
+static double FLAC_Tell(void *context)
+{
+    FLAC_Music *music = (FLAC_Music *)context;
+
+    if (music->sample_rate == 0) {
+        return -1.0;
+    }
+    return (double)music->position / music->sample_rate;
+}
+
+/* Return the length of the stream in seconds, if STREAMINFO knows it */
+static double FLAC_Duration(void *context)
+{
+    FLAC_Music *music = (FLAC_Music *)context;
+
+    if (music->sample_rate == 0 || music->total_samples == 0) {
+        return -1.0;
+    }
+    return (double)music->total_samples / music->sample_rate;
+}
+
 /* Close the given FLAC_Music object */
 static void FLAC_Delete(void *context)
 {
@@ -528,7 +586,10 @@ static void FLAC_Delete(void *context)
             flac.FLAC__stream_decoder_delete(music->flac_decoder);
         }
         if (music->stream) {
-            SDL_FreeAudioStream(music->stream);
+            _Mix_FreeConverter(music->stream);
+        }
+        if (music->pcm) {
+            SDL_free(music->pcm);
         }
         if (music->freesrc) {
             SDL_RWclose(music->src);
@@ -554,6 +615,9 @@ Mix_MusicInterface Mix_MusicInterface_FLAC =
     NULL,   /* IsPlaying */
     FLAC_GetAudio,
     FLAC_Seek,
+    FLAC_Tell,
+    FLAC_Duration,
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
@@ -29,9 +29,24 @@
 #include "SDL_loadso.h"
 
 #include "music_fluidsynth.h"
+#include "mixer_convert.h"
+#include "load_mmap.h"
 
 #include <fluidsynth.h>
 
+/* FluidSynth 2 reads SoundFonts through callbacks, which take 64-bit
+   offsets from 2.2 on */
+#if FLUIDSYNTH_VERSION_MAJOR >= 2
+#define FLUIDSYNTH_SFLOADER
+#if FLUIDSYNTH_VERSION_MAJOR > 2 || FLUIDSYNTH_VERSION_MINOR >= 2
+typedef fluid_long_long_t fluidsynth_offset;
+typedef fluid_long_long_t fluidsynth_count;
+#else
+typedef long fluidsynth_offset;
+typedef int fluidsynth_count;
+#endif
+#endif
+
 
 typedef struct {
     int loaded;
@@ -46,14 +61,35 @@ typedef struct {
     int (*fluid_player_play)(fluid_player_t*);
     int (*fluid_player_set_loop)(fluid_player_t*, int);
     int (*fluid_player_stop)(fluid_player_t*);
+    int (*fluid_settings_setint)(fluid_settings_t*, const char*, int);
     int (*fluid_settings_setnum)(fluid_settings_t*, const char*, double);
+    int (*fluid_synth_add_sfont)(fluid_synth_t*, fluid_sfont_t*);
+    int (*fluid_synth_all_sounds_off)(fluid_synth_t*, int);
     fluid_settings_t* (*fluid_synth_get_settings)(fluid_synth_t*);
+    fluid_sfont_t* (*fluid_synth_get_sfont)(fluid_synth_t*, unsigned int);
+    int (*fluid_synth_program_reset)(fluid_synth_t*);
+    int (*fluid_synth_remove_sfont)(fluid_synth_t*, fluid_sfont_t*);
+    void (*fluid_synth_set_chorus_on)(fluid_synth_t*, int);
     void (*fluid_synth_set_gain)(fluid_synth_t*, float);
+    int (*fluid_synth_set_interp_method)(fluid_synth_t*, int, int);
+    int (*fluid_synth_set_polyphony)(fluid_synth_t*, int);
+    void (*fluid_synth_set_reverb_on)(fluid_synth_t*, int);
+    int (*fluid_synth_sfcount)(fluid_synth_t*);
     int (*fluid_synth_sfload)(fluid_synth_t*, const char*, int);
     int (*fluid_synth_write_s16)(fluid_synth_t*, int, void*, int, int, void*, int, int);
     fluid_player_t* (*new_fluid_player)(fluid_synth_t*);
     fluid_settings_t* (*new_fluid_settings)(void);
     fluid_synth_t* (*new_fluid_synth)(fluid_settings_t*);
+#ifdef FLUIDSYNTH_SFLOADER
+    int (*fluid_sfloader_set_callbacks)(fluid_sfloader_t*,
+                                        fluid_sfloader_callback_open_t,
+                                        fluid_sfloader_callback_read_t,
+                                        fluid_sfloader_callback_seek_t,
+                                        fluid_sfloader_callback_tell_t,
+                                        fluid_sfloader_callback_close_t);
+    void (*fluid_synth_add_sfloader)(fluid_synth_t*, fluid_sfloader_t*);
+    fluid_sfloader_t* (*new_fluid_defsfloader)(fluid_settings_t*);
+#endif
 } fluidsynth_loader;
 
 static fluidsynth_loader fluidsynth = {
@@ -87,14 +123,35 @@ static int FLUIDSYNTH_Load()
         FUNCTION_LOADER(fluid_player_play, int (*)(fluid_player_t*))
         FUNCTION_LOADER(fluid_player_set_loop, int (*)(fluid_player_t*, int))
         FUNCTION_LOADER(fluid_player_stop, int (*)(fluid_player_t*))
+        FUNCTION_LOADER(fluid_settings_setint, int (*)(fluid_settings_t*, const char*, int))
         FUNCTION_LOADER(fluid_settings_setnum, int (*)(fluid_settings_t*, const char*, double))
+        FUNCTION_LOADER(fluid_synth_add_sfont, int (*)(fluid_synth_t*, fluid_sfont_t*))
+        FUNCTION_LOADER(fluid_synth_all_sounds_off, int (*)(fluid_synth_t*, int))
         FUNCTION_LOADER(fluid_synth_get_settings, fluid_settings_t* (*)(fluid_synth_t*))
+        FUNCTION_LOADER(fluid_synth_get_sfont, fluid_sfont_t* (*)(fluid_synth_t*, unsigned int))
+        FUNCTION_LOADER(fluid_synth_program_reset, int (*)(fluid_synth_t*))
+        FUNCTION_LOADER(fluid_synth_remove_sfont, int (*)(fluid_synth_t*, fluid_sfont_t*))
+        FUNCTION_LOADER(fluid_synth_set_chorus_on, void (*)(fluid_synth_t*, int))
         FUNCTION_LOADER(fluid_synth_set_gain, void (*)(fluid_synth_t*, float))
+        FUNCTION_LOADER(fluid_synth_set_interp_method, int (*)(fluid_synth_t*, int, int))
+        FUNCTION_LOADER(fluid_synth_set_polyphony, int (*)(fluid_synth_t*, int))
+        FUNCTION_LOADER(fluid_synth_set_reverb_on, void (*)(fluid_synth_t*, int))
+        FUNCTION_LOADER(fluid_synth_sfcount, int (*)(fluid_synth_t*))
         FUNCTION_LOADER(fluid_synth_sfload, int(*)(fluid_synth_t*, const char*, int))
         FUNCTION_LOADER(fluid_synth_write_s16, int(*)(fluid_synth_t*, int, void*, int, int, void*, int, int))
         FUNCTION_LOADER(new_fluid_player, fluid_player_t* (*)(fluid_synth_t*))
         FUNCTION_LOADER(new_fluid_settings, fluid_settings_t* (*)(void))
         FUNCTION_LOADER(new_fluid_synth, fluid_synth_t* (*)(fluid_settings_t*))
+#ifdef FLUIDSYNTH_SFLOADER
+        FUNCTION_LOADER(fluid_sfloader_set_callbacks, int (*)(fluid_sfloader_t*,
+                                                              fluid_sfloader_callback_open_t,
+                                                              fluid_sfloader_callback_read_t,
+                                                              fluid_sfloader_callback_seek_t,
+                                                              fluid_sfloader_callback_tell_t,
+                                                              fluid_sfloader_callback_close_t))
+        FUNCTION_LOADER(fluid_synth_add_sfloader, void (*)(fluid_synth_t*, fluid_sfloader_t*))
+        FUNCTION_LOADER(new_fluid_defsfloader, fluid_sfloader_t* (*)(fluid_settings_t*))
+#endif
     }
     ++fluidsynth.loaded;
 
@@ -115,26 +172,82 @@ static void FLUIDSYNTH_Unload()
 }
 
 
+/* The SoundFonts, loaded once into a synth that only holds them and lent
+   to the synth of every song. The current bank is kept between songs. */
+typedef struct {
+    fluid_synth_t *synth;
+    char *paths;            /* the Mix_GetSoundFonts() it was loaded from */
+    SDL_atomic_t refcount;
+} FLUIDSYNTH_Bank;
+
+static FLUIDSYNTH_Bank *current_bank = NULL;
+static SDL_SpinLock bank_lock = 0;
+
 typedef struct {
     fluid_synth_t *synth;
     fluid_player_t *player;
-    SDL_AudioStream *stream;
+    FLUIDSYNTH_Bank *bank;
+    Mix_FluidSynthSettings applied_settings;
+    Mix_Converter *stream;
     void *buffer;
     int buffer_size;
 } FLUIDSYNTH_Music;
 
 
+#ifdef FLUIDSYNTH_SFLOADER
+/* SoundFonts are read through SDL, so they can be APK assets, and from a
+   mapping of the file where it can be mapped instead of a read per chunk */
+static void *fluidsynth_sf_open(const char *path)
+{
+    SDL_RWops *src = SDL_RWFromFile(path, "rb");
+
+    if (!src) {
+        return NULL;
+    }
+    return _Mix_RWFromMapped(src);
+}
+
+static int fluidsynth_sf_read(void *buf, fluidsynth_count count, void *handle)
+{
+    return SDL_RWread((SDL_RWops *)handle, buf, 1, (size_t)count) == (size_t)count ? FLUID_OK : FLUID_FAILED;
+}
+
+static int fluidsynth_sf_seek(void *handle, fluidsynth_offset offset, int origin)
+{
+    int whence = (origin == SEEK_CUR) ? RW_SEEK_CUR : (origin == SEEK_END) ? RW_SEEK_END : RW_SEEK_SET;
+    return SDL_RWseek((SDL_RWops *)handle, offset, whence) < 0 ? FLUID_FAILED : FLUID_OK;
+}
+
+static fluidsynth_offset fluidsynth_sf_tell(void *handle)
+{
+    return (fluidsynth_offset)SDL_RWtell((SDL_RWops *)handle);
+}
+
+static int fluidsynth_sf_close(void *handle)
+{
+    return SDL_RWclose((SDL_RWops *)handle) < 0 ? FLUID_FAILED : FLUID_OK;
+}
+#endif /* FLUIDSYNTH_SFLOADER */
+
 static int SDLCALL fluidsynth_check_soundfont(const char *path, void *data)
 {
+#ifdef FLUIDSYNTH_SFLOADER
+    SDL_RWops *file = SDL_RWFromFile(path, "rb");
+
+    if (file) {
+        SDL_RWclose(file);
+        return 1;
+    }
+#else
     FILE *file = fopen(path, "r");
 
     if (file) {
         fclose(file);
         return 1;
-    } else {
-        Mix_SetError("Failed to access the SoundFont %s", path);
-        return 0;
     }
+#endif
+    Mix_SetError("Failed to access the SoundFont %s", path);
+    return 0;
 }
 
 static int SDLCALL fluidsynth_load_soundfont(const char *path, void *data)
@@ -144,6 +257,107 @@ static int SDLCALL fluidsynth_load_soundfont(const char *path, void *data)
     return 1;
 }
 
+static void FLUIDSYNTH_ReleaseBank(FLUIDSYNTH_Bank *bank)
+{
+    if (SDL_AtomicAdd(&bank->refcount, -1) == 1) {
+        fluid_settings_t *settings = fluidsynth.fluid_synth_get_settings(bank->synth);
+        fluidsynth.delete_fluid_synth(bank->synth);
+        fluidsynth.delete_fluid_settings(settings);
+        SDL_free(bank->paths);
+        SDL_free(bank);
+    }
+}
+
+static FLUIDSYNTH_Bank *FLUIDSYNTH_LoadBank(const char *paths)
+{
+    FLUIDSYNTH_Bank *bank;
+    fluid_settings_t *settings;
+
+    if (!(bank = SDL_calloc(1, sizeof(FLUIDSYNTH_Bank))) || !(bank->paths = SDL_strdup(paths))) {
+        SDL_free(bank);
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    if (!(settings = fluidsynth.new_fluid_settings())) {
+        Mix_SetError("Failed to create FluidSynth settings");
+        SDL_free(bank->paths);
+        SDL_free(bank);
+        return NULL;
+    }
+
+    /* It never plays, so it gets as little as it can of what playing takes */
+    fluidsynth.fluid_settings_setint(settings, "synth.polyphony", 1);
+    fluidsynth.fluid_settings_setint(settings, "synth.reverb.active", 0);
+    fluidsynth.fluid_settings_setint(settings, "synth.chorus.active", 0);
+    if (!(bank->synth = fluidsynth.new_fluid_synth(settings))) {
+        Mix_SetError("Failed to create FluidSynth synthesizer");
+        fluidsynth.delete_fluid_settings(settings);
+        SDL_free(bank->paths);
+        SDL_free(bank);
+        return NULL;
+    }
+
+#ifdef FLUIDSYNTH_SFLOADER
+    {
+        fluid_sfloader_t *loader = fluidsynth.new_fluid_defsfloader(settings);
+        if (loader) {
+            fluidsynth.fluid_sfloader_set_callbacks(loader, fluidsynth_sf_open, fluidsynth_sf_read,
+                                                    fluidsynth_sf_seek, fluidsynth_sf_tell, fluidsynth_sf_close);
+            fluidsynth.fluid_synth_add_sfloader(bank->synth, loader);
+        }
+    }
+#endif
+
+    SDL_AtomicSet(&bank->refcount, 1);
+    if (!Mix_EachSoundFont(fluidsynth_load_soundfont, (void*) bank->synth)) {
+        FLUIDSYNTH_ReleaseBank(bank);
+        return NULL;
+    }
+    if (fluidsynth.fluid_synth_sfcount(bank->synth) == 0) {
+        Mix_SetError("FluidSynth failed to load the SoundFonts %s", paths);
+        FLUIDSYNTH_ReleaseBank(bank);
+        return NULL;
+    }
+    return bank;
+}
+
+/* The bank for the SoundFonts set now, loaded if they aren't already */
+static FLUIDSYNTH_Bank *FLUIDSYNTH_AcquireBank(void)
+{
+    const char *paths = Mix_GetSoundFonts();
+    FLUIDSYNTH_Bank *bank = NULL, *stale;
+
+    if (!paths) {
+        Mix_SetError("No SoundFonts have been requested");
+        return NULL;
+    }
+
+    SDL_AtomicLock(&bank_lock);
+    if (current_bank && SDL_strcmp(current_bank->paths, paths) == 0) {
+        bank = current_bank;
+        SDL_AtomicIncRef(&bank->refcount);
+    }
+    SDL_AtomicUnlock(&bank_lock);
+    if (bank) {
+        return bank;
+    }
+
+    /* Loaded without the lock held, a song loading at the same time on
+       another thread just loads them too */
+    if (!(bank = FLUIDSYNTH_LoadBank(paths))) {
+        return NULL;
+    }
+    SDL_AtomicIncRef(&bank->refcount);
+    SDL_AtomicLock(&bank_lock);
+    stale = current_bank;
+    current_bank = bank;
+    SDL_AtomicUnlock(&bank_lock);
+    if (stale) {
+        FLUIDSYNTH_ReleaseBank(stale);
+    }
+    return bank;
+}
+
 static int FLUIDSYNTH_Open(const SDL_AudioSpec *spec)
 {
     if (!Mix_EachSoundFont(fluidsynth_check_soundfont, NULL)) {
@@ -152,6 +366,54 @@ static int FLUIDSYNTH_Open(const SDL_AudioSpec *spec)
     return 0;
 }
 
+static void FLUIDSYNTH_Close(void)
+{
+    FLUIDSYNTH_Bank *bank;
+
+    SDL_AtomicLock(&bank_lock);
+    bank = current_bank;
+    current_bank = NULL;
+    SDL_AtomicUnlock(&bank_lock);
+    if (bank) {
+        FLUIDSYNTH_ReleaseBank(bank);
+    }
+}
+
+/* Hand a Mix_SetFluidSynthSettings() change over to the song's synth */
+static void FLUIDSYNTH_ApplySettings(FLUIDSYNTH_Music *music)
+{
+    static const int interp_methods[] = {
+        FLUID_INTERP_NONE, FLUID_INTERP_LINEAR, FLUID_INTERP_4THORDER, FLUID_INTERP_7THORDER
+    };
+    Mix_FluidSynthSettings *s = &music->applied_settings;
+
+    Mix_GetFluidSynthSettings(s);
+    fluidsynth.fluid_synth_set_polyphony(music->synth, s->polyphony ? s->polyphony : 256);
+    fluidsynth.fluid_synth_set_interp_method(music->synth, -1, interp_methods[s->interpolation]);
+    fluidsynth.fluid_synth_set_reverb_on(music->synth, s->reverb);
+    fluidsynth.fluid_synth_set_chorus_on(music->synth, s->chorus);
+}
+
+/* Lend the bank's SoundFonts to the song's synth, in the same order */
+static void FLUIDSYNTH_BorrowSoundFonts(FLUIDSYNTH_Music *music)
+{
+    int i;
+
+    for (i = fluidsynth.fluid_synth_sfcount(music->bank->synth) - 1; i >= 0; --i) {
+        fluidsynth.fluid_synth_add_sfont(music->synth, fluidsynth.fluid_synth_get_sfont(music->bank->synth, i));
+    }
+    fluidsynth.fluid_synth_program_reset(music->synth);
+}
+
+/* Give them back before the synth goes, which would free them otherwise */
+static void FLUIDSYNTH_ReturnSoundFonts(FLUIDSYNTH_Music *music)
+{
+    fluidsynth.fluid_synth_all_sounds_off(music->synth, -1);
+    while (fluidsynth.fluid_synth_sfcount(music->synth) > 0) {
+        fluidsynth.fluid_synth_remove_sfont(music->synth, fluidsynth.fluid_synth_get_sfont(music->synth, 0));
+    }
+}
+
 static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusic(void *data)
 {
     SDL_RWops *src = (SDL_RWops *)data;
@@ -160,14 +422,16 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusic(void *data)
 
     if ((music = SDL_calloc(1, sizeof(FLUIDSYNTH_Music)))) {
         int channels = 2;
-        if ((music->stream = SDL_NewAudioStream(AUDIO_S16SYS, channels, music_spec.freq, music_spec.format, music_spec.channels, music_spec.freq))) {
+        if ((music->stream = _Mix_NewConverter(AUDIO_S16SYS, channels, music_spec.freq, music_spec.format, music_spec.channels, music_spec.freq))) {
             music->buffer_size = music_spec.samples * sizeof(Sint16) * channels;
             if ((music->buffer = SDL_malloc(music->buffer_size))) {
                 if ((settings = fluidsynth.new_fluid_settings())) {
                     fluidsynth.fluid_settings_setnum(settings, "synth.sample-rate", (double) music_spec.freq);
 
                     if ((music->synth = fluidsynth.new_fluid_synth(settings))) {
-                        if (Mix_EachSoundFont(fluidsynth_load_soundfont, (void*) music->synth)) {
+                        if ((music->bank = FLUIDSYNTH_AcquireBank())) {
+                            FLUIDSYNTH_BorrowSoundFonts(music);
+                            FLUIDSYNTH_ApplySettings(music);
                             if ((music->player = fluidsynth.new_fluid_player(music->synth))) {
                                 void *buffer;
                                 size_t size;
@@ -188,6 +452,8 @@ static FLUIDSYNTH_Music *FLUIDSYNTH_LoadMusic(void *data)
                             } else {
                                 Mix_SetError("Failed to create FluidSynth player");
                             }
+                            FLUIDSYNTH_ReturnSoundFonts(music);
+                            FLUIDSYNTH_ReleaseBank(music->bank);
                         }
                         fluidsynth.delete_fluid_synth(music->synth);
                     } else {
@@ -243,9 +509,15 @@ static SDL_bool FLUIDSYNTH_IsPlaying(void *context)
 static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 {
     FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music *)context;
+    Mix_FluidSynthSettings current;
     int filled;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    Mix_GetFluidSynthSettings(&current);
+    if (SDL_memcmp(&current, &music->applied_settings, sizeof(current)) != 0) {
+        FLUIDSYNTH_ApplySettings(music);
+    }
+
+    filled = _Mix_ConverterGet(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -254,14 +526,14 @@ static int FLUIDSYNTH_GetSome(void *context, void *data, int bytes, SDL_bool *do
         Mix_SetError("Error generating FluidSynth audio");
         return -1;
     }
-    if (SDL_AudioStreamPut(music->stream, music->buffer, music->buffer_size) < 0) {
+    if (_Mix_ConverterPut(music->stream, music->buffer, music->buffer_size) < 0) {
         return -1;
     }
     return 0;
 }
 static int FLUIDSYNTH_GetAudio(void *context, void *data, int bytes)
 {
-    return music_pcm_getaudio(context, data, bytes, MIX_MAX_VOLUME, FLUIDSYNTH_GetSome);
+    return music_pcm_getaudio(context, data, bytes, FLUIDSYNTH_GetSome);
 }
 
 static void FLUIDSYNTH_Stop(void *context)
@@ -273,9 +545,15 @@ static void FLUIDSYNTH_Stop(void *context)
 static void FLUIDSYNTH_Delete(void *context)
 {
     FLUIDSYNTH_Music *music = (FLUIDSYNTH_Music *)context;
+    fluid_settings_t *settings = fluidsynth.fluid_synth_get_settings(music->synth);
+
     fluidsynth.delete_fluid_player(music->player);
-    fluidsynth.delete_fluid_settings(fluidsynth.fluid_synth_get_settings(music->synth));
+    FLUIDSYNTH_ReturnSoundFonts(music);
     fluidsynth.delete_fluid_synth(music->synth);
+    fluidsynth.delete_fluid_settings(settings);
+    FLUIDSYNTH_ReleaseBank(music->bank);
+    _Mix_FreeConverter(music->stream);
+    SDL_free(music->buffer);
     SDL_free(music);
 }
 
@@ -296,11 +574,14 @@ Mix_MusicInterface Mix_MusicInterface_FLUIDSYNTH =
     FLUIDSYNTH_IsPlaying,
     FLUIDSYNTH_GetAudio,
     NULL,   /* Seek */
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     FLUIDSYNTH_Stop,
     FLUIDSYNTH_Delete,
-    NULL,   /* Close */
+    FLUIDSYNTH_Close,
     FLUIDSYNTH_Unload,
 };
 
@@ -0,0 +1,353 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file mixes the stems of a piece in lockstep: every stem is decoded
+   for the same frames, the first one decides where the piece is and when
+   it ends, and each has a gain of its own that can ramp at any time. */
+
+#include "mixer_bus.h"
+#include "music_layers.h"
+
+/* Stems are mixed this many samples at a time */
+#define LAYERS_CHUNK_SAMPLES    2048
+
+typedef struct {
+    Mix_MusicInterface *interface;
+    void *context;
+    float gain;
+    float target;
+    float step;         /* gain change per frame while ramping */
+    int ramp;           /* frames left to ramp */
+    SDL_bool stale;     /* skipped while silent, behind the first stem */
+    SDL_bool done;      /* ran out or failed, silent until the next seek */
+} LAYERS_Stem;
+
+typedef struct {
+    LAYERS_Stem stems[MIX_MAX_MUSIC_LAYERS];
+    int count;
+    SDL_bool skip_muted;
+    Uint8 buffer[LAYERS_CHUNK_SAMPLES * sizeof(float)];
+    float bus[LAYERS_CHUNK_SAMPLES];
+} LAYERS_Music;
+
+
+void *LAYERS_Create(Mix_MusicInterface **interfaces, void **contexts, int count, SDL_bool skip_muted)
+{
+    LAYERS_Music *music;
+    int i;
+
+    music = (LAYERS_Music *)SDL_calloc(1, sizeof(*music));
+    if (music == NULL) {
+        SDL_OutOfMemory();
+        return NULL;
+    }
+    for (i = 0; i < count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        stem->interface = interfaces[i];
+        stem->context = contexts[i];
+        stem->gain = 1.0f;
+        stem->target = 1.0f;
+    }
+    music->count = count;
+    music->skip_muted = skip_muted;
+    return music;
+}
+
+int LAYERS_Fade(void *context, int layer, int volume, int ms)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    LAYERS_Stem *stem;
+    int frames = (int)(((Sint64)ms * music_spec.freq) / 1000);
+
+    if (layer < 0 || layer >= music->count) {
+        Mix_SetError("Invalid layer %d", layer);
+        return -1;
+    }
+    stem = &music->stems[layer];
+    stem->target = (float)volume / MIX_MAX_VOLUME;
+    if (frames > 0) {
+        stem->step = (stem->target - stem->gain) / frames;
+        stem->ramp = frames;
+    } else {
+        stem->gain = stem->target;
+        stem->ramp = 0;
+    }
+    return 0;
+}
+
+/* Whether 'stem' can sit out while it's silent and seek back in line */
+static SDL_bool LAYERS_CanSkip(LAYERS_Music *music, LAYERS_Stem *stem)
+{
+    return (music->skip_muted && stem != &music->stems[0] &&
+            stem->gain == 0.0f && stem->ramp == 0 &&
+            stem->interface->Seek && music->stems[0].interface->Tell) ? SDL_TRUE : SDL_FALSE;
+}
+
+static void LAYERS_SetVolume(void *context, int volume)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->interface->SetVolume) {
+            stem->interface->SetVolume(stem->context, volume);
+        }
+    }
+}
+
+static int LAYERS_Play(void *context, int play_count)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->interface->Play(stem->context, play_count) < 0) {
+            return -1;
+        }
+        stem->stale = SDL_FALSE;
+        stem->done = SDL_FALSE;
+    }
+    return 0;
+}
+
+static SDL_bool LAYERS_IsPlaying(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    LAYERS_Stem *stem = &music->stems[0];
+
+    if (stem->done) {
+        return SDL_FALSE;
+    }
+    if (stem->interface->IsPlaying) {
+        return stem->interface->IsPlaying(stem->context);
+    }
+    return SDL_TRUE;
+}
+
+/* Add 'frames' frames of 'stem' in the buffer to the bus at its gain */
+static void LAYERS_Mix(LAYERS_Music *music, LAYERS_Stem *stem, int frames)
+{
+    const int channels = music_spec.channels;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music_spec.format) / 8) * channels;
+    int ramp = SDL_min(stem->ramp, frames);
+
+    if (ramp > 0) {
+        _Mix_BusMixRamp(music->bus, music->buffer, music_spec.format, ramp * channels,
+                        channels, stem->gain, stem->step);
+        stem->ramp -= ramp;
+        stem->gain = (stem->ramp > 0) ? (stem->gain + stem->step * ramp) : stem->target;
+    }
+    if (ramp < frames && stem->gain != 0.0f) {
+        _Mix_BusMix(music->bus + ramp * channels, music->buffer + ramp * frame_size,
+                    music_spec.format, (frames - ramp) * channels, stem->gain);
+    }
+}
+
+static int LAYERS_GetAudio(void *context, void *data, int bytes)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    LAYERS_Stem *clock = &music->stems[0];
+    const int channels = music_spec.channels;
+    const int frame_size = (SDL_AUDIO_BITSIZE(music_spec.format) / 8) * channels;
+    Uint8 *dst = (Uint8 *)data;
+    int i;
+
+    /* Stems that are heard again pick up where the first one is */
+    for (i = 1; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->stale && !LAYERS_CanSkip(music, stem)) {
+            double position = clock->interface->Tell(clock->context);
+            stem->done = (position < 0.0 ||
+                          stem->interface->Seek(stem->context, position) < 0) ? SDL_TRUE : SDL_FALSE;
+            stem->stale = SDL_FALSE;
+        }
+    }
+
+    while (bytes >= frame_size && !clock->done) {
+        int frames = SDL_min(bytes / frame_size, LAYERS_CHUNK_SAMPLES / channels);
+        int len = frames * frame_size;
+        int played = len;
+
+        SDL_memset(music->bus, 0, frames * channels * sizeof(float));
+        for (i = 0; i < music->count; ++i) {
+            LAYERS_Stem *stem = &music->stems[i];
+            int left;
+
+            if (stem->done) {
+                continue;
+            }
+            if (LAYERS_CanSkip(music, stem)) {
+                stem->stale = SDL_TRUE;
+                continue;
+            }
+
+            SDL_memset(music->buffer, music_spec.silence, len);
+            left = stem->interface->GetAudio(stem->context, music->buffer, len);
+            if (left != 0) {
+                /* Whatever it left unwritten is silence */
+                stem->done = SDL_TRUE;
+                if (stem == clock) {
+                    played = (left > 0) ? (len - left) : 0;
+                }
+            }
+            LAYERS_Mix(music, stem, frames);
+        }
+        _Mix_BusStore(dst, music->bus, music_spec.format, (played / frame_size) * channels);
+        dst += played;
+        bytes -= played;
+    }
+    return clock->done ? bytes : 0;
+}
+
+/* Stems sitting out get their seek when they're heard again */
+static int LAYERS_Seek(void *context, double position)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->stale) {
+            continue;
+        }
+        if (!stem->interface->Seek) {
+            if (i == 0) {
+                return -1;
+            }
+            continue;
+        }
+        if (stem->interface->Seek(stem->context, position) < 0) {
+            if (i == 0) {
+                return -1;
+            }
+            stem->done = SDL_TRUE;
+        } else {
+            stem->done = SDL_FALSE;
+        }
+    }
+    return 0;
+}
+
+static double LAYERS_Tell(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    LAYERS_Stem *stem = &music->stems[0];
+
+    if (stem->interface->Tell) {
+        return stem->interface->Tell(stem->context);
+    }
+    return -1.0;
+}
+
+static double LAYERS_Duration(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    LAYERS_Stem *stem = &music->stems[0];
+
+    if (stem->interface->Duration) {
+        return stem->interface->Duration(stem->context);
+    }
+    return -1.0;
+}
+
+static void LAYERS_Pause(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->interface->Pause) {
+            stem->interface->Pause(stem->context);
+        }
+    }
+}
+
+static void LAYERS_Resume(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->interface->Resume) {
+            stem->interface->Resume(stem->context);
+        }
+    }
+}
+
+static void LAYERS_Stop(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        if (stem->interface->Stop) {
+            stem->interface->Stop(stem->context);
+        }
+    }
+}
+
+static void LAYERS_Delete(void *context)
+{
+    LAYERS_Music *music = (LAYERS_Music *)context;
+    int i;
+
+    for (i = 0; i < music->count; ++i) {
+        LAYERS_Stem *stem = &music->stems[i];
+        stem->interface->Delete(stem->context);
+    }
+    SDL_free(music);
+}
+
+/* Only made by Mix_LoadLayeredMUS(), never picked to load a file */
+Mix_MusicInterface Mix_MusicInterface_LAYERS =
+{
+    "LAYERS",
+    MIX_MUSIC_LAYERS,
+    MUS_NONE,
+    SDL_TRUE,
+    SDL_TRUE,
+
+    NULL,   /* Load */
+    NULL,   /* Open */
+    NULL,   /* CreateFromRW */
+    NULL,   /* CreateFromFile */
+    LAYERS_SetVolume,
+    LAYERS_Play,
+    LAYERS_IsPlaying,
+    LAYERS_GetAudio,
+    LAYERS_Seek,
+    LAYERS_Tell,
+    LAYERS_Duration,
+    NULL,   /* Loop */
+    LAYERS_Pause,
+    LAYERS_Resume,
+    LAYERS_Stop,
+    LAYERS_Delete,
+    NULL,   /* Close */
+    NULL,   /* Unload */
+};
+
+/* vi: set ts=4 sw=4 expandtab: */
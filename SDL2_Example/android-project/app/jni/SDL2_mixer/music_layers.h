@@ -0,0 +1,41 @@
+/*
+  SDL_mixer:  An audio mixer library based on the SDL library
+  Copyright (C) 1997-2018 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* This file mixes the stems of a piece, each with a music interface of its
+   own, into one music */
+
+#include "music.h"
+
+/* The most stems a layered music can have */
+#define MIX_MAX_MUSIC_LAYERS    8
+
+extern Mix_MusicInterface Mix_MusicInterface_LAYERS;
+
+/* Takes over the 'count' decoders in 'interfaces' and 'contexts', the first
+   of which keeps the time for all of them. With 'skip_muted' the others
+   aren't decoded while their layer is silent, and catch up with a seek. */
+extern void *LAYERS_Create(Mix_MusicInterface **interfaces, void **contexts, int count, SDL_bool skip_muted);
+
+/* Move the gain of stem 'layer' to 'volume' over 'ms' milliseconds,
+   returns 0, or -1 if there's no such stem */
+extern int LAYERS_Fade(void *context, int layer, int volume, int ms);
+
+/* vi: set ts=4 sw=4 expandtab: */
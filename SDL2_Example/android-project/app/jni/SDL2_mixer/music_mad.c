@@ -22,6 +22,7 @@
 #ifdef MUSIC_MP3_MAD
 
 #include "music_mad.h"
+#include "mixer_convert.h"
 
 #include "mad.h"
 
@@ -145,7 +146,7 @@ typedef struct {
     mad_timer_t next_frame_start;
     int volume;
     int status;
-    SDL_AudioStream *audiostream;
+    Mix_Converter *audiostream;
 
     unsigned char input_buffer[MAD_INPUT_BUFFER_SIZE + MAD_BUFFER_GUARD];
 } MAD_Music;
@@ -291,7 +292,7 @@ static SDL_bool decode_frame(MAD_Music *music)
     pcm = &music->synth.pcm;
 
     if (!music->audiostream) {
-        music->audiostream = SDL_NewAudioStream(AUDIO_S16, pcm->channels, pcm->samplerate, music_spec.format, music_spec.channels, music_spec.freq);
+        music->audiostream = _Mix_NewConverter(AUDIO_S16, pcm->channels, pcm->samplerate, music_spec.format, music_spec.channels, music_spec.freq);
         if (!music->audiostream) {
             return SDL_FALSE;
         }
@@ -319,7 +320,7 @@ static SDL_bool decode_frame(MAD_Music *music)
         }
     }
 
-    result = SDL_AudioStreamPut(music->audiostream, buffer, (nsamples * nchannels * sizeof(Sint16)));
+    result = _Mix_ConverterPut(music->audiostream, buffer, (nsamples * nchannels * sizeof(Sint16)));
     SDL_stack_free(buffer);
 
     if (result < 0) {
@@ -334,8 +335,9 @@ static int MAD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int filled;
 
     if (music->audiostream) {
-        filled = SDL_AudioStreamGet(music->audiostream, data, bytes);
+        filled = _Mix_ConverterGet(music->audiostream, data, bytes);
         if (filled != 0) {
+            music_pcm_volume(data, filled, music->volume);
             return filled;
         }
     }
@@ -365,8 +367,7 @@ static int MAD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 }
 static int MAD_GetAudio(void *context, void *data, int bytes)
 {
-    MAD_Music *music = (MAD_Music *)context;
-    return music_pcm_getaudio(context, data, bytes, music->volume, MAD_GetSome);
+    return music_pcm_getaudio(context, data, bytes, MAD_GetSome);
 }
 
 static int MAD_Seek(void *context, double position)
@@ -419,7 +420,7 @@ static void MAD_Delete(void *context)
     mad_synth_finish(&music->synth);
 
     if (music->audiostream) {
-        SDL_FreeAudioStream(music->audiostream);
+        _Mix_FreeConverter(music->audiostream);
     }
     if (music->freesrc) {
         SDL_RWclose(music->src);
@@ -444,6 +445,9 @@ Mix_MusicInterface Mix_MusicInterface_MAD =
     NULL,   /* IsPlaying */
     MAD_GetAudio,
     MAD_Seek,
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
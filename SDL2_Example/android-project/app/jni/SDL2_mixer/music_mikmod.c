@@ -26,6 +26,7 @@
 #include "SDL_loadso.h"
 
 #include "music_mikmod.h"
+#include "mixer_convert.h"
 
 #include "mikmod.h"
 
@@ -167,7 +168,7 @@ typedef struct
     int play_count;
     int volume;
     MODULE *module;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;
     SBYTE *buffer;
     ULONG buffer_size;
 } MIKMOD_Music;
@@ -336,8 +337,8 @@ void *MIKMOD_CreateFromRW(SDL_RWops *src, int freesrc)
     } else {
         channels = 1;
     }
-    music->stream = SDL_NewAudioStream(format, channels, *mikmod.md_mixfreq,
-                                       music_spec.format, music_spec.channels, music_spec.freq);
+    music->stream = _Mix_NewConverter(format, channels, *mikmod.md_mixfreq,
+                                      music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         MIKMOD_Delete(music);
         return NULL;
@@ -387,7 +388,7 @@ static int MIKMOD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     MIKMOD_Music *music = (MIKMOD_Music *)context;
     int filled;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    filled = _Mix_ConverterGet(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -401,7 +402,7 @@ static int MIKMOD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     /* This never fails, and always writes a full buffer */
     mikmod.VC_WriteBytes(music->buffer, music->buffer_size);
 
-    if (SDL_AudioStreamPut(music->stream, music->buffer, music->buffer_size) < 0) {
+    if (_Mix_ConverterPut(music->stream, music->buffer, music->buffer_size) < 0) {
         return -1;
     }
 
@@ -409,7 +410,7 @@ static int MIKMOD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     if (!mikmod.Player_Active()) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            _Mix_ConverterFlush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -424,7 +425,7 @@ static int MIKMOD_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 }
 static int MIKMOD_GetAudio(void *context, void *data, int bytes)
 {
-    return music_pcm_getaudio(context, data, bytes, MIX_MAX_VOLUME, MIKMOD_GetSome);
+    return music_pcm_getaudio(context, data, bytes, MIKMOD_GetSome);
 }
 
 /* Jump (seek) to a given position (time is in seconds) */
@@ -449,7 +450,7 @@ static void MIKMOD_Delete(void *context)
         mikmod.Player_Free(music->module);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -474,6 +475,9 @@ Mix_MusicInterface Mix_MusicInterface_MIKMOD =
     MIKMOD_IsPlaying,
     MIKMOD_GetAudio,
     MIKMOD_Seek,
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     MIKMOD_Stop,
@@ -24,6 +24,8 @@
 #include "SDL_loadso.h"
 
 #include "music_modplug.h"
+#include "mixer_convert.h"
+#include "load_mmap.h"
 
 #ifdef MODPLUG_HEADER
 #include MODPLUG_HEADER
@@ -50,6 +52,7 @@ static modplug_loader modplug = {
 
 
 static ModPlug_Settings settings;
+static Mix_ModSettings applied_settings;
 
 #ifdef MODPLUG_DYNAMIC
 #define FUNCTION_LOADER(FUNC, SIG) \
@@ -108,7 +111,7 @@ typedef struct
 {
     int play_count;
     ModPlugFile *file;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;
     void *buffer;
     int buffer_size;
 } MODPLUG_Music;
@@ -117,11 +120,44 @@ typedef struct
 static int MODPLUG_Seek(void *context, double position);
 static void MODPLUG_Delete(void *context);
 
+/* Hand a Mix_SetModSettings() change over to libmodplug. It applies all of
+   them but the channel count globally right away. */
+static void MODPLUG_ApplySettings(void)
+{
+    static const int resampling_modes[] = {
+        MODPLUG_RESAMPLE_NEAREST, MODPLUG_RESAMPLE_LINEAR,
+        MODPLUG_RESAMPLE_SPLINE, MODPLUG_RESAMPLE_FIR
+    };
+    Mix_ModSettings *s = &applied_settings;
+
+    Mix_GetModSettings(s);
+    settings.mResamplingMode = resampling_modes[s->resampler];
+    settings.mFlags = 0;
+    if (s->oversampling) {
+        settings.mFlags |= MODPLUG_ENABLE_OVERSAMPLING;
+    }
+    if (s->reverb) {
+        settings.mFlags |= MODPLUG_ENABLE_REVERB;
+    }
+    if (s->megabass) {
+        settings.mFlags |= MODPLUG_ENABLE_MEGABASS;
+    }
+    if (s->surround) {
+        settings.mFlags |= MODPLUG_ENABLE_SURROUND;
+    }
+    settings.mReverbDepth = s->reverb;
+    settings.mBassAmount = s->megabass;
+    settings.mSurroundDepth = s->surround;
+    if (s->max_mix_channels) {
+        settings.mMaxMixChannels = s->max_mix_channels;
+    }
+    modplug.ModPlug_SetSettings(&settings);
+}
+
 static int MODPLUG_Open(const SDL_AudioSpec *spec)
 {
     /* ModPlug supports U8 or S16 audio output */
     modplug.ModPlug_GetSettings(&settings);
-    settings.mFlags = MODPLUG_ENABLE_OVERSAMPLING;
     if (spec->channels == 1) {
         settings.mChannels = 1;
     } else {
@@ -139,15 +175,11 @@ static int MODPLUG_Open(const SDL_AudioSpec *spec)
     } else {
         settings.mFrequency = 11025;
     }
-    settings.mResamplingMode = MODPLUG_RESAMPLE_FIR;
-    settings.mReverbDepth = 0;
     settings.mReverbDelay = 100;
-    settings.mBassAmount = 0;
     settings.mBassRange = 50;
-    settings.mSurroundDepth = 0;
     settings.mSurroundDelay = 10;
     settings.mLoopCount = 0;
-    modplug.ModPlug_SetSettings(&settings);
+    MODPLUG_ApplySettings();
     return 0;
 }
 
@@ -155,6 +187,7 @@ static int MODPLUG_Open(const SDL_AudioSpec *spec)
 void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
 {
     MODPLUG_Music *music;
+    const void *data;
     void *buffer;
     size_t size;
 
@@ -164,8 +197,8 @@ void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    music->stream = SDL_NewAudioStream((settings.mBits == 8) ? AUDIO_U8 : AUDIO_S16SYS, settings.mChannels, settings.mFrequency,
-                                       music_spec.format, music_spec.channels, music_spec.freq);
+    music->stream = _Mix_NewConverter((settings.mBits == 8) ? AUDIO_U8 : AUDIO_S16SYS, settings.mChannels, settings.mFrequency,
+                                      music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         MODPLUG_Delete(music);
         return NULL;
@@ -178,13 +211,23 @@ void *MODPLUG_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    buffer = SDL_LoadFile_RW(src, &size, SDL_FALSE);
-    if (buffer) {
-        music->file = modplug.ModPlug_Load(buffer, (int)size);
+    /* A mapped file or other memory stream is handed to libmodplug as is,
+       it copies out the samples and patterns it needs while loading. */
+    data = _Mix_RWMemory(src, &size);
+    if (data && size > 0 && size <= SDL_MAX_SINT32) {
+        music->file = modplug.ModPlug_Load(data, (int)size);
         if (!music->file) {
             Mix_SetError("ModPlug_Load failed");
         }
-        SDL_free(buffer);
+    } else {
+        buffer = SDL_LoadFile_RW(src, &size, SDL_FALSE);
+        if (buffer) {
+            music->file = modplug.ModPlug_Load(buffer, (int)size);
+            if (!music->file) {
+                Mix_SetError("ModPlug_Load failed");
+            }
+            SDL_free(buffer);
+        }
     }
 
     if (!music->file) {
@@ -217,9 +260,15 @@ static int MODPLUG_Play(void *context, int play_count)
 static int MODPLUG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 {
     MODPLUG_Music *music = (MODPLUG_Music *)context;
+    Mix_ModSettings current;
     int filled, amount;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
+    Mix_GetModSettings(&current);
+    if (SDL_memcmp(&current, &applied_settings, sizeof(current)) != 0) {
+        MODPLUG_ApplySettings();
+    }
+
+    filled = _Mix_ConverterGet(music->stream, data, bytes);
     if (filled != 0) {
         return filled;
     }
@@ -232,13 +281,13 @@ static int MODPLUG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 
     amount = modplug.ModPlug_Read(music->file, music->buffer, music->buffer_size);
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (_Mix_ConverterPut(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            _Mix_ConverterFlush(music->stream);
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -253,7 +302,7 @@ static int MODPLUG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 }
 static int MODPLUG_GetAudio(void *context, void *data, int bytes)
 {
-    return music_pcm_getaudio(context, data, bytes, MIX_MAX_VOLUME, MODPLUG_GetSome);
+    return music_pcm_getaudio(context, data, bytes, MODPLUG_GetSome);
 }
 
 /* Jump (seek) to a given position */
@@ -272,7 +321,7 @@ static void MODPLUG_Delete(void *context)
         modplug.ModPlug_Unload(music->file);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -297,6 +346,9 @@ Mix_MusicInterface Mix_MusicInterface_MODPLUG =
     NULL,   /* IsPlaying */
     MODPLUG_GetAudio,
     MODPLUG_Seek,
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
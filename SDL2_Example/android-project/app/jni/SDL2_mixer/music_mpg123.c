@@ -24,14 +24,26 @@
 #ifdef MUSIC_MP3_MPG123
 
 #include <stdio.h>      // For SEEK_SET
+#include <stdlib.h>     // For free(), mpg123_icy2utf8() mallocs
 
 #include "SDL_assert.h"
 #include "SDL_loadso.h"
 
 #include "music_mpg123.h"
+#include "mixer_convert.h"
+#include "chunk_cache.h"
+#include "load_network.h"
 
 #include <mpg123.h>
 
+/* Seek index files: a header followed by the frame offsets, in little endian */
+#define INDEX_MAGIC         0x4958494d  /* "MIXI" */
+#define INDEX_VERSION       1
+#define INDEX_HASH_BYTES    65536       /* how much of the file identifies it */
+
+/* Most of a network stream's buffer fed to mpg123 at a time */
+#define FEED_BYTES          4096
+
 
 typedef struct {
     int loaded;
@@ -42,16 +54,27 @@ typedef struct {
     void (*mpg123_exit)(void);
     int (*mpg123_format)( mpg123_handle *mh, long rate, int channels, int encodings );
     int (*mpg123_format_none)(mpg123_handle *mh);
+    int (*mpg123_format_support)( mpg123_handle *mh, long rate, int encoding );
     int (*mpg123_getformat)( mpg123_handle *mh, long *rate, int *channels, int *encoding );
+    int (*mpg123_index)( mpg123_handle *mh, off_t **offsets, off_t *step, size_t *fill );
+    char* (*mpg123_icy2utf8)(const char* icy_text);
+    int (*mpg123_info)(mpg123_handle *mh, struct mpg123_frameinfo *mi);
     int (*mpg123_init)(void);
+    off_t (*mpg123_length)(mpg123_handle *mh);
     mpg123_handle *(*mpg123_new)(const char* decoder, int *error);
+    int (*mpg123_feed)(mpg123_handle *mh, const unsigned char *in, size_t size);
+    int (*mpg123_open_feed)(mpg123_handle *mh);
     int (*mpg123_open_handle)(mpg123_handle *mh, void *iohandle);
+    int (*mpg123_param)( mpg123_handle *mh, enum mpg123_parms type, long value, double fvalue );
     const char* (*mpg123_plain_strerror)(int errcode);
     void (*mpg123_rates)(const long **list, size_t *number);
     int (*mpg123_read)(mpg123_handle *mh, unsigned char *outmemory, size_t outmemsize, size_t *done );
     int (*mpg123_replace_reader_handle)( mpg123_handle *mh, ssize_t (*r_read) (void *, void *, size_t), off_t (*r_lseek)(void *, off_t, int), void (*cleanup)(void*) );
+    int (*mpg123_scan)(mpg123_handle *mh);
     off_t (*mpg123_seek)( mpg123_handle *mh, off_t sampleoff, int whence );
+    int (*mpg123_set_index)( mpg123_handle *mh, off_t *offsets, off_t step, size_t fill );
     const char* (*mpg123_strerror)(mpg123_handle *mh);
+    off_t (*mpg123_tell)(mpg123_handle *mh);
 } mpg123_loader;
 
 static mpg123_loader mpg123 = {
@@ -89,16 +112,27 @@ static int MPG123_Load(void)
         FUNCTION_LOADER(mpg123_exit, void (*)(void))
         FUNCTION_LOADER(mpg123_format, int (*)( mpg123_handle *mh, long rate, int channels, int encodings ))
         FUNCTION_LOADER(mpg123_format_none, int (*)(mpg123_handle *mh))
+        FUNCTION_LOADER(mpg123_format_support, int (*)( mpg123_handle *mh, long rate, int encoding ))
         FUNCTION_LOADER(mpg123_getformat, int (*)( mpg123_handle *mh, long *rate, int *channels, int *encoding ))
+        FUNCTION_LOADER(mpg123_index, int (*)( mpg123_handle *mh, off_t **offsets, off_t *step, size_t *fill ))
+        FUNCTION_LOADER(mpg123_icy2utf8, char* (*)(const char* icy_text))
+        FUNCTION_LOADER(mpg123_info, int (*)(mpg123_handle *mh, struct mpg123_frameinfo *mi))
         FUNCTION_LOADER(mpg123_init, int (*)(void))
+        FUNCTION_LOADER(mpg123_length, off_t (*)(mpg123_handle *mh))
         FUNCTION_LOADER(mpg123_new, mpg123_handle *(*)(const char* decoder, int *error))
+        FUNCTION_LOADER(mpg123_feed, int (*)(mpg123_handle *mh, const unsigned char *in, size_t size))
+        FUNCTION_LOADER(mpg123_open_feed, int (*)(mpg123_handle *mh))
         FUNCTION_LOADER(mpg123_open_handle, int (*)(mpg123_handle *mh, void *iohandle))
+        FUNCTION_LOADER(mpg123_param, int (*)( mpg123_handle *mh, enum mpg123_parms type, long value, double fvalue ))
         FUNCTION_LOADER(mpg123_plain_strerror, const char* (*)(int errcode))
         FUNCTION_LOADER(mpg123_rates, void (*)(const long **list, size_t *number));
         FUNCTION_LOADER(mpg123_read, int (*)(mpg123_handle *mh, unsigned char *outmemory, size_t outmemsize, size_t *done ))
         FUNCTION_LOADER(mpg123_replace_reader_handle, int (*)( mpg123_handle *mh, ssize_t (*r_read) (void *, void *, size_t), off_t (*r_lseek)(void *, off_t, int), void (*cleanup)(void*) ))
+        FUNCTION_LOADER(mpg123_scan, int (*)(mpg123_handle *mh))
         FUNCTION_LOADER(mpg123_seek, off_t (*)( mpg123_handle *mh, off_t sampleoff, int whence ))
+        FUNCTION_LOADER(mpg123_set_index, int (*)( mpg123_handle *mh, off_t *offsets, off_t step, size_t fill ))
         FUNCTION_LOADER(mpg123_strerror, const char* (*)(mpg123_handle *mh))
+        FUNCTION_LOADER(mpg123_tell, off_t (*)(mpg123_handle *mh))
     }
     ++mpg123.loaded;
 
@@ -124,10 +158,13 @@ typedef struct
     int play_count;
     SDL_RWops* src;
     int freesrc;
+    Mix_NetStream *net;     /* fed from instead of 'src' */
     int volume;
 
     mpg123_handle* handle;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;
+    SDL_bool passthrough;   /* the decoded format is already music_spec */
+    long rate;              /* of the decoded audio */
     unsigned char *buffer;
     size_t buffer_size;
 } MPG123_Music;
@@ -135,6 +172,7 @@ typedef struct
 
 static int MPG123_Seek(void *context, double secs);
 static void MPG123_Delete(void *context);
+static int MPG123_UpdateFormat(MPG123_Music *music);
 
 static int mpg123_format_to_sdl(int fmt)
 {
@@ -150,6 +188,20 @@ static int mpg123_format_to_sdl(int fmt)
     }
 }
 
+static int sdl_format_to_mpg123(SDL_AudioFormat fmt)
+{
+    switch (fmt)
+    {
+        case AUDIO_S8:                  return MPG123_ENC_SIGNED_8;
+        case AUDIO_U8:                  return MPG123_ENC_UNSIGNED_8;
+        case AUDIO_S16SYS:              return MPG123_ENC_SIGNED_16;
+        case AUDIO_U16SYS:              return MPG123_ENC_UNSIGNED_16;
+        case AUDIO_S32SYS:              return MPG123_ENC_SIGNED_32;
+        case AUDIO_F32SYS:              return MPG123_ENC_FLOAT_32;
+        default:                        return 0;
+    }
+}
+
 /*
 static const char *mpg123_format_str(int fmt)
 {
@@ -197,6 +249,131 @@ static void rwops_cleanup(void* p)
     /* do nothing, we will free the file later */
 }
 
+/* There's no file name to go by, so the stream is known by its size and a
+   hash of its first bytes. Returns SDL_FALSE if it can't be identified. */
+static SDL_bool MPG123_StreamKey(SDL_RWops *src, Sint64 *size, Uint32 *hash)
+{
+    Uint8 buf[4096];
+    Sint64 start = SDL_RWtell(src);
+    size_t i, n, total = 0;
+    Uint32 h = 2166136261u;
+
+    *size = SDL_RWsize(src);
+    if (start < 0 || *size <= 0) {
+        return SDL_FALSE;
+    }
+    while (total < INDEX_HASH_BYTES && (n = SDL_RWread(src, buf, 1, sizeof(buf))) > 0) {
+        for (i = 0; i < n; ++i) {
+            h = (h ^ buf[i]) * 16777619u;
+        }
+        total += n;
+    }
+    SDL_RWseek(src, start, RW_SEEK_SET);
+    *hash = h;
+    return SDL_TRUE;
+}
+
+static char *MPG123_IndexPath(Sint64 size, Uint32 hash)
+{
+    char name[32];
+
+    SDL_snprintf(name, sizeof(name), "mp3_%08x%08x_%08x",
+                 (Uint32)((Uint64)size >> 32), (Uint32)size, hash);
+    return _Mix_CacheFilePath(name, ".idx");
+}
+
+/* Give mpg123 the index saved by MPG123_SaveIndex(), if it's for this stream */
+static SDL_bool MPG123_LoadIndex(MPG123_Music *music, const char *path, Sint64 size, Uint32 hash)
+{
+    SDL_RWops *rw;
+    off_t *offsets = NULL;
+    off_t step;
+    Uint32 i, fill = 0;
+    SDL_bool ok;
+
+    rw = SDL_RWFromFile(path, "rb");
+    if (!rw) {
+        return SDL_FALSE;
+    }
+    ok = (SDL_ReadLE32(rw) == INDEX_MAGIC &&
+          SDL_ReadLE32(rw) == INDEX_VERSION &&
+          (Sint64)SDL_ReadLE64(rw) == size &&
+          SDL_ReadLE32(rw) == hash);
+    if (ok) {
+        step = (off_t)SDL_ReadLE64(rw);
+        fill = SDL_ReadLE32(rw);
+        ok = (step > 0 && fill > 0 && (Sint64)fill * 8 <= size);
+    }
+    if (ok) {
+        offsets = (off_t *)SDL_malloc(fill * sizeof(*offsets));
+        ok = (offsets != NULL);
+    }
+    for (i = 0; ok && i < fill; ++i) {
+        offsets[i] = (off_t)SDL_ReadLE64(rw);
+    }
+    SDL_RWclose(rw);
+
+    /* A short file reads as zeroes, which can't follow the first offset */
+    if (ok && fill > 1 && offsets[fill - 1] == 0) {
+        ok = SDL_FALSE;
+    }
+    if (ok) {
+        ok = (mpg123.mpg123_set_index(music->handle, offsets, step, fill) == MPG123_OK);
+    }
+    SDL_free(offsets);
+    return ok;
+}
+
+static void MPG123_SaveIndex(MPG123_Music *music, const char *path, Sint64 size, Uint32 hash)
+{
+    SDL_RWops *rw;
+    off_t *offsets;
+    off_t step;
+    size_t i, fill;
+
+    if (mpg123.mpg123_index(music->handle, &offsets, &step, &fill) != MPG123_OK || fill == 0) {
+        return;
+    }
+    rw = SDL_RWFromFile(path, "wb");
+    if (!rw) {
+        return;
+    }
+    SDL_WriteLE32(rw, INDEX_MAGIC);
+    SDL_WriteLE32(rw, INDEX_VERSION);
+    SDL_WriteLE64(rw, (Uint64)size);
+    SDL_WriteLE32(rw, hash);
+    SDL_WriteLE64(rw, (Uint64)step);
+    SDL_WriteLE32(rw, (Uint32)fill);
+    for (i = 0; i < fill; ++i) {
+        SDL_WriteLE64(rw, (Uint64)offsets[i]);
+    }
+    SDL_RWclose(rw);
+}
+
+/* Index every frame up front so seeks jump straight to the right frame
+   instead of scanning from the start, reusing the index from the chunk
+   cache directory when there is one */
+static void MPG123_BuildIndex(MPG123_Music *music)
+{
+    Sint64 size;
+    Uint32 hash;
+    char *path = NULL;
+
+    if (!MPG123_StreamKey(music->src, &size, &hash)) {
+        /* Not seekable, mpg123_scan() wouldn't work either */
+        return;
+    }
+    path = MPG123_IndexPath(size, hash);
+    if (path && MPG123_LoadIndex(music, path, size, hash)) {
+        SDL_free(path);
+        return;
+    }
+    if (mpg123.mpg123_scan(music->handle) == MPG123_OK && path) {
+        MPG123_SaveIndex(music, path, size, hash);
+    }
+    SDL_free(path);
+}
+
 
 static int MPG123_Open(const SDL_AudioSpec *spec)
 {
@@ -207,22 +384,24 @@ static int MPG123_Open(const SDL_AudioSpec *spec)
     return 0;
 }
 
-static void *MPG123_CreateFromRW(SDL_RWops *src, int freesrc)
+/* A player without a source yet, set up to decode to what suits the device */
+static MPG123_Music *MPG123_NewMusic(void)
 {
     MPG123_Music *music;
     int result;
     const long *rates;
     size_t i, num_rates;
+    long music_spec_rate = music_spec.freq;
+    int native;
 
     music = (MPG123_Music*)SDL_calloc(1, sizeof(*music));
     if (!music) {
         return NULL;
     }
-    music->src = src;
     music->volume = MIX_MAX_VOLUME;
 
-    /* Just assume 16-bit 2 channel audio for now */
-    music->buffer_size = music_spec.samples * sizeof(Sint16) * 2;
+    /* Room for up to 32-bit 2 channel audio, the widest mpg123 decodes to */
+    music->buffer_size = music_spec.samples * sizeof(Sint32) * 2;
     music->buffer = (unsigned char *)SDL_malloc(music->buffer_size);
     if (!music->buffer) {
         MPG123_Delete(music);
@@ -237,6 +416,62 @@ static void *MPG123_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
+    result = mpg123.mpg123_format_none(music->handle);
+    if (result != MPG123_OK) {
+        MPG123_Delete(music);
+        Mix_SetError("mpg123_format_none: %s", mpg_err(music->handle, result));
+        return NULL;
+    }
+
+    /* Let the synth resample to the device rate itself, the only rate it
+       may then write, so there's no rate conversion left for the stream */
+    if (Mix_GetMP3DeviceRate() &&
+        mpg123.mpg123_param(music->handle, MPG123_FORCE_RATE, music_spec.freq, 0.0) == MPG123_OK) {
+        rates = &music_spec_rate;
+        num_rates = 1;
+    } else {
+        mpg123.mpg123_rates(&rates, &num_rates);
+    }
+
+    /* Have the synth write the device's own encoding if it was built with
+       it (e.g. float with REAL_IS_FLOAT), so there's no int to float hop in
+       the audio stream.  Otherwise mpg123 picks whatever it does best. */
+    native = sdl_format_to_mpg123(music_spec.format);
+    if (native && num_rates > 0) {
+        for (i = 0; i < num_rates; ++i) {
+            mpg123.mpg123_format(music->handle, rates[i], MPG123_MONO|MPG123_STEREO, native);
+        }
+        if (!mpg123.mpg123_format_support(music->handle, rates[0], native)) {
+            native = 0;
+        }
+    }
+    if (!native) {
+        for (i = 0; i < num_rates; ++i) {
+            const int channels = (MPG123_MONO|MPG123_STEREO);
+            const int formats = (MPG123_ENC_SIGNED_8 |
+                                 MPG123_ENC_UNSIGNED_8 |
+                                 MPG123_ENC_SIGNED_16 |
+                                 MPG123_ENC_UNSIGNED_16 |
+                                 MPG123_ENC_SIGNED_32 |
+                                 MPG123_ENC_FLOAT_32);
+
+            mpg123.mpg123_format(music->handle, rates[i], channels, formats);
+        }
+    }
+    return music;
+}
+
+static void *MPG123_CreateFromRW(SDL_RWops *src, int freesrc)
+{
+    MPG123_Music *music;
+    int result;
+
+    music = MPG123_NewMusic();
+    if (!music) {
+        return NULL;
+    }
+    music->src = src;
+
     result = mpg123.mpg123_replace_reader_handle(
         music->handle,
         rwops_read, rwops_seek, rwops_cleanup
@@ -247,37 +482,128 @@ static void *MPG123_CreateFromRW(SDL_RWops *src, int freesrc)
         return NULL;
     }
 
-    result = mpg123.mpg123_format_none(music->handle);
+    /* Let the index hold every frame rather than thin it out */
+    mpg123.mpg123_param(music->handle, MPG123_INDEX_SIZE, -1000, 0.0);
+
+    result = mpg123.mpg123_open_handle(music->handle, music->src);
     if (result != MPG123_OK) {
         MPG123_Delete(music);
-        Mix_SetError("mpg123_format_none: %s", mpg_err(music->handle, result));
+        Mix_SetError("mpg123_open_handle: %s", mpg_err(music->handle, result));
         return NULL;
     }
+    MPG123_BuildIndex(music);
 
-    mpg123.mpg123_rates(&rates, &num_rates);
-    for (i = 0; i < num_rates; ++i) {
-        const int channels = (MPG123_MONO|MPG123_STEREO);
-        const int formats = (MPG123_ENC_SIGNED_8 |
-                             MPG123_ENC_UNSIGNED_8 |
-                             MPG123_ENC_SIGNED_16 |
-                             MPG123_ENC_UNSIGNED_16 |
-                             MPG123_ENC_SIGNED_32 |
-                             MPG123_ENC_FLOAT_32);
+    /* Knowing the rate up front lets seeks before the first read be exact */
+    if (MPG123_UpdateFormat(music) < 0) {
+        MPG123_Delete(music);
+        return NULL;
+    }
+
+    music->freesrc = freesrc;
+    return music;
+}
 
-        mpg123.mpg123_format(music->handle, rates[i], channels, formats);
+void *MPG123_CreateFromStream(const char *url, int buffer_ms)
+{
+    MPG123_Music *music;
+    int result;
+
+    music = MPG123_NewMusic();
+    if (!music) {
+        return NULL;
     }
 
-    result = mpg123.mpg123_open_handle(music->handle, music->src);
+    /* The format isn't known until the first frames arrive */
+    result = mpg123.mpg123_open_feed(music->handle);
     if (result != MPG123_OK) {
         MPG123_Delete(music);
-        Mix_SetError("mpg123_open_handle: %s", mpg_err(music->handle, result));
+        Mix_SetError("mpg123_open_feed: %s", mpg_err(music->handle, result));
+        return NULL;
+    }
+    music->net = _Mix_NetStreamOpen(url, buffer_ms);
+    if (!music->net) {
+        MPG123_Delete(music);
         return NULL;
     }
-
-    music->freesrc = freesrc;
     return music;
 }
 
+/* Convert ICY text, which is often Latin-1, into the UTF-8 it's kept as */
+static void MPG123_ToUTF8(char *text, size_t maxlen)
+{
+    char *utf8;
+    size_t len;
+
+    if (!*text || !(utf8 = mpg123.mpg123_icy2utf8(text))) {
+        return;
+    }
+    len = SDL_strlcpy(text, utf8, maxlen);
+    free(utf8);
+
+    /* Don't leave half a character at the end of a cut off title */
+    if (len >= maxlen) {
+        size_t end = maxlen - 1, start = end;
+        Uint8 lead;
+
+        while (start > 0 && ((Uint8)text[start - 1] & 0xC0) == 0x80) {
+            --start;
+        }
+        if (start > 0) {
+            lead = (Uint8)text[start - 1];
+            if (start - 1 + (lead >= 0xF0 ? 4 : lead >= 0xE0 ? 3 : lead >= 0xC0 ? 2 : 1) > end) {
+                text[start - 1] = '\0';
+            }
+        }
+    }
+}
+
+int MPG123_StreamStatus(void *context, Mix_StreamStatus *status)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+
+    if (!music->net) {
+        return Mix_SetError("Not a network stream");
+    }
+    _Mix_NetStreamStatus(music->net, status);
+    MPG123_ToUTF8(status->name, sizeof(status->name));
+    MPG123_ToUTF8(status->title, sizeof(status->title));
+    return 0;
+}
+
+/* Set up the conversion for the format mpg123 decodes to now */
+static int MPG123_UpdateFormat(MPG123_Music *music)
+{
+    long rate;
+    int channels, encoding, format;
+    int result;
+
+    result = mpg123.mpg123_getformat(music->handle, &rate, &channels, &encoding);
+    if (result != MPG123_OK) {
+        Mix_SetError("mpg123_getformat: %s", mpg_err(music->handle, result));
+        return -1;
+    }
+/*printf("MPG123 format: %s, channels = %d, rate = %ld\n", mpg123_format_str(encoding), channels, rate);*/
+
+    format = mpg123_format_to_sdl(encoding);
+    SDL_assert(format != -1);
+
+    music->rate = rate;
+    if (music->stream) {
+        _Mix_FreeConverter(music->stream);
+        music->stream = NULL;
+    }
+    music->passthrough = music_spec_matches((SDL_AudioFormat)format, channels, (int)rate);
+    if (music->passthrough) {
+        return 0;
+    }
+    music->stream = _Mix_NewConverter(format, channels, (int)rate,
+                                      music_spec.format, music_spec.channels, music_spec.freq);
+    if (!music->stream) {
+        return -1;
+    }
+    return 0;
+}
+
 static void MPG123_SetVolume(void *context, int volume)
 {
     MPG123_Music *music = (MPG123_Music *)context;
@@ -288,21 +614,53 @@ static int MPG123_Play(void *context, int play_count)
 {
     MPG123_Music *music = (MPG123_Music *)context;
     music->play_count = play_count;
+    if (music->net) {
+        /* Live, it plays on from wherever it is */
+        return 0;
+    }
     return MPG123_Seek(music, 0.0);
 }
 
+/* Hand on 'amount' bytes that mpg123 decoded into 'dst', returns how many
+   of them are in 'data' now */
+static int MPG123_Output(MPG123_Music *music, void *data, unsigned char *dst, size_t amount)
+{
+    if (music->passthrough) {
+        music_pcm_volume(data, (int)amount, music->volume);
+        return (int)amount;
+    }
+    if (music->stream && _Mix_ConverterPut(music->stream, dst, (int)amount) < 0) {
+        return -1;
+    }
+    return 0;
+}
+
+/* Give mpg123 more of a network stream, without waiting for it. Returns
+   SDL_FALSE if the buffer had none to give. */
+static SDL_bool MPG123_Feed(MPG123_Music *music)
+{
+    size_t got = _Mix_NetStreamRead(music->net, music->buffer, SDL_min(music->buffer_size, FEED_BYTES));
+
+    if (got == 0) {
+        return SDL_FALSE;
+    }
+    mpg123.mpg123_feed(music->handle, music->buffer, got);
+    return SDL_TRUE;
+}
+
 /* read some mp3 stream data and convert it for output */
 static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 {
     MPG123_Music *music = (MPG123_Music *)context;
-    int filled, result;
+    int filled = 0, result;
     size_t amount;
-    long rate;
-    int channels, encoding, format;
+    unsigned char *dst = music->buffer;
+    size_t len = music->buffer_size;
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = _Mix_ConverterGet(music->stream, data, bytes);
         if (filled != 0) {
+            music_pcm_volume(data, filled, music->volume);
             return filled;
         }
     }
@@ -313,36 +671,55 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    result = mpg123.mpg123_read(music->handle, music->buffer, music->buffer_size, &amount);
+    if (music->passthrough) {
+        /* Already in the output format, decode straight into the caller */
+        dst = (unsigned char *)data;
+        len = (size_t)bytes;
+    }
+    result = mpg123.mpg123_read(music->handle, dst, len, &amount);
     switch (result) {
     case MPG123_OK:
-        if (SDL_AudioStreamPut(music->stream, music->buffer, (int)amount) < 0) {
+        filled = MPG123_Output(music, data, dst, amount);
+        break;
+
+    case MPG123_NEED_MORE:
+        /* Only a network stream runs out, maybe with some audio decoded */
+        if (amount > 0 && (filled = MPG123_Output(music, data, dst, amount)) < 0) {
             return -1;
         }
+        if (filled > 0 || MPG123_Feed(music)) {
+            break;
+        }
+        if (_Mix_NetStreamEnded(music->net)) {
+            music->play_count = 0;
+            if (music->stream) {
+                _Mix_ConverterFlush(music->stream);
+            }
+            break;
+        }
+        /* The buffer is filling, play silence rather than wait for it */
+        SDL_memset(data, music_spec.silence, bytes);
+        filled = bytes;
         break;
 
     case MPG123_NEW_FORMAT:
-        result = mpg123.mpg123_getformat(music->handle, &rate, &channels, &encoding);
-        if (result != MPG123_OK) {
-            Mix_SetError("mpg123_getformat: %s", mpg_err(music->handle, result));
+        if (MPG123_UpdateFormat(music) < 0) {
             return -1;
         }
-/*printf("MPG123 format: %s, channels = %d, rate = %ld\n", mpg123_format_str(encoding), channels, rate);*/
-
-        format = mpg123_format_to_sdl(encoding);
-        SDL_assert(format != -1);
-
-        music->stream = SDL_NewAudioStream(format, channels, (int)rate,
-                                           music_spec.format, music_spec.channels, music_spec.freq);
-        if (!music->stream) {
-            return -1;
+        if (music->net) {
+            struct mpg123_frameinfo info;
+            if (mpg123.mpg123_info(music->handle, &info) == MPG123_OK) {
+                _Mix_NetStreamSetBitrate(music->net, info.vbr == MPG123_ABR ? info.abr_rate : info.bitrate);
+            }
         }
         break;
 
     case MPG123_DONE:
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            if (music->stream) {
+                _Mix_ConverterFlush(music->stream);
+            }
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -357,18 +734,22 @@ static int MPG123_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         Mix_SetError("mpg123_read: %s", mpg_err(music->handle, result));
         return -1;
     }
-    return 0;
+    return filled;
 }
 static int MPG123_GetAudio(void *context, void *data, int bytes)
 {
-    MPG123_Music *music = (MPG123_Music *)context;
-    return music_pcm_getaudio(context, data, bytes, music->volume, MPG123_GetSome);
+    return music_pcm_getaudio(context, data, bytes, MPG123_GetSome);
 }
 
 static int MPG123_Seek(void *context, double secs)
 {
     MPG123_Music *music = (MPG123_Music *)context;
-    off_t offset = (off_t)(music_spec.freq * secs);
+    /* mpg123 counts samples at the rate it decodes to, music->rate */
+    off_t offset = (off_t)(music->rate * secs);
+
+    if (music->net) {
+        return Mix_SetError("Network streams can't seek");
+    }
 
     if ((offset = mpg123.mpg123_seek(music->handle, offset, SEEK_SET)) < 0) {
         return Mix_SetError("mpg123_seek: %s", mpg_err(music->handle, (int)-offset));
@@ -376,16 +757,51 @@ static int MPG123_Seek(void *context, double secs)
     return 0;
 }
 
+static double MPG123_Tell(void *context)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+    off_t offset;
+
+    if (music->rate <= 0) {
+        return -1.0;
+    }
+    offset = mpg123.mpg123_tell(music->handle);
+    if (offset < 0) {
+        return -1.0;
+    }
+    return (double)offset / music->rate;
+}
+
+/* Exact after a full scan or with a Xing/Info header, otherwise mpg123
+   estimates it from the stream size */
+static double MPG123_Duration(void *context)
+{
+    MPG123_Music *music = (MPG123_Music *)context;
+    off_t length;
+
+    if (music->rate <= 0 || music->net) {
+        return -1.0;
+    }
+    length = mpg123.mpg123_length(music->handle);
+    if (length < 0) {
+        return -1.0;
+    }
+    return (double)length / music->rate;
+}
+
 static void MPG123_Delete(void *context)
 {
     MPG123_Music *music = (MPG123_Music *)context;
 
+    if (music->net) {
+        _Mix_NetStreamClose(music->net);
+    }
     if (music->handle) {
         mpg123.mpg123_close(music->handle);
         mpg123.mpg123_delete(music->handle);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -418,6 +834,9 @@ Mix_MusicInterface Mix_MusicInterface_MPG123 =
     NULL,   /* IsPlaying */
     MPG123_GetAudio,
     MPG123_Seek,
+    MPG123_Tell,
+    MPG123_Duration,
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
@@ -25,4 +25,11 @@
 
 extern Mix_MusicInterface Mix_MusicInterface_MPG123;
 
+/* A context for Mix_MusicInterface_MPG123 playing a network stream, see
+   Mix_LoadMUSStream() */
+extern void *MPG123_CreateFromStream(const char *url, int buffer_ms);
+
+/* See Mix_GetMusicStreamStatus(), -1 for music that isn't a stream */
+extern int MPG123_StreamStatus(void *context, Mix_StreamStatus *status);
+
 /* vi: set ts=4 sw=4 expandtab: */
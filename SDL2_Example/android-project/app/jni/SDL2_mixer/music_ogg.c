@@ -25,7 +25,10 @@
 
 #include "SDL_loadso.h"
 
+#include "mixer.h"
 #include "music_ogg.h"
+#include "mixer_convert.h"
+#include "load_mmap.h"
 
 #if defined(OGG_HEADER)
 #include OGG_HEADER
@@ -42,11 +45,13 @@ typedef struct {
     vorbis_info *(*ov_info)(OggVorbis_File *vf,int link);
     vorbis_comment *(*ov_comment)(OggVorbis_File *vf,int link);
     int (*ov_open_callbacks)(void *datasource, OggVorbis_File *vf, const char *initial, long ibytes, ov_callbacks callbacks);
+    int (*ov_open_memory)(void *datasource, OggVorbis_File *vf, const void *data, ogg_int64_t size, ov_callbacks callbacks);
     ogg_int64_t (*ov_pcm_total)(OggVorbis_File *vf,int i);
 #ifdef OGG_USE_TREMOR
     long (*ov_read)(OggVorbis_File *vf,char *buffer,int length, int *bitstream);
 #else
     long (*ov_read)(OggVorbis_File *vf,char *buffer,int length, int bigendianp,int word,int sgned,int *bitstream);
+    long (*ov_read_float)(OggVorbis_File *vf,float ***pcm_channels,int samples,int *bitstream);
 #endif
 #ifdef OGG_USE_TREMOR
     int (*ov_time_seek)(OggVorbis_File *vf,ogg_int64_t pos);
@@ -54,6 +59,7 @@ typedef struct {
     int (*ov_time_seek)(OggVorbis_File *vf,double pos);
 #endif
     int (*ov_pcm_seek)(OggVorbis_File *vf, ogg_int64_t pos);
+    int (*ov_raw_seek)(OggVorbis_File *vf, ogg_int64_t pos);
     ogg_int64_t (*ov_pcm_tell)(OggVorbis_File *vf);
 } vorbis_loader;
 
@@ -97,10 +103,21 @@ static int OGG_Load(void)
         FUNCTION_LOADER(ov_time_seek, long (*)(OggVorbis_File *,ogg_int64_t))
 #else
         FUNCTION_LOADER(ov_read, long (*)(OggVorbis_File *,char *,int,int,int,int,int *))
+        FUNCTION_LOADER(ov_read_float, long (*)(OggVorbis_File *,float ***,int,int *))
         FUNCTION_LOADER(ov_time_seek, int (*)(OggVorbis_File *,double))
 #endif
         FUNCTION_LOADER(ov_pcm_seek, int (*)(OggVorbis_File *,ogg_int64_t))
+        FUNCTION_LOADER(ov_raw_seek, int (*)(OggVorbis_File *,ogg_int64_t))
         FUNCTION_LOADER(ov_pcm_tell, ogg_int64_t (*)(OggVorbis_File *))
+        /* Only the bundled Tremor has it, and it's fine without */
+#ifdef OV_HAVE_OPEN_MEMORY
+#ifdef OGG_DYNAMIC
+        vorbis.ov_open_memory = (int (*)(void *, OggVorbis_File *, const void *, ogg_int64_t, ov_callbacks))
+            SDL_LoadFunction(vorbis.handle, "ov_open_memory");
+#else
+        vorbis.ov_open_memory = ov_open_memory;
+#endif
+#endif
     }
     ++vorbis.loaded;
 
@@ -121,6 +138,13 @@ static void OGG_Unload(void)
 }
 
 
+/* Where an Ogg page starts in the file, and the PCM position its
+   granulepos ends at */
+typedef struct {
+    ogg_int64_t offset;
+    ogg_int64_t pcm;
+} OGG_page;
+
 typedef struct {
     SDL_RWops *src;
     int freesrc;
@@ -129,18 +153,24 @@ typedef struct {
     OggVorbis_File vf;
     vorbis_info vi;
     int section;
-    SDL_AudioStream *stream;
+    SDL_AudioFormat format;     /* what OGG_Read() decodes to */
+    Mix_Converter *stream;      /* NULL while the sections are already in music_spec */
     char *buffer;
     int buffer_size;
     int loop;
     ogg_int64_t loop_start;
     ogg_int64_t loop_end;
     ogg_int64_t loop_len;
-    ogg_int64_t channels;
+    OGG_page *pages;            /* NULL if the stream couldn't be indexed */
+    int num_pages;
+    char *lead_in;              /* decoded audio from loop_start on, or NULL */
+    int lead_in_size;
+    int lead_in_pos;            /* lead_in_size when not playing from it */
+    ogg_int64_t lead_in_resume; /* page the decoder picks up from after it */
 } OGG_music;
 
 
-static int set_ov_error(const char *function, int error)
+static void format_ov_error(const char *function, int error)
 {
 #define HANDLE_ERROR_CASE(X)    case X: Mix_SetError("%s: %s", function, #X); break;
     switch (error) {
@@ -162,9 +192,20 @@ static int set_ov_error(const char *function, int error)
         Mix_SetError("%s: unknown error %d\n", function, error);
         break;
     }
+}
+
+static int set_ov_error(const char *function, int error)
+{
+    format_ov_error(function, error);
     return -1;
 }
 
+/* For the audio and decode threads, see _Mix_SetErrorLater() */
+static int defer_ov_error(const char *function, int error)
+{
+    return _Mix_SetErrorLater(format_ov_error, function, error);
+}
+
 static size_t sdl_read_func(void *ptr, size_t size, size_t nmemb, void *datasource)
 {
     return SDL_RWread((SDL_RWops*)datasource, ptr, size, nmemb);
@@ -186,6 +227,7 @@ static void OGG_Delete(void *context);
 static int OGG_UpdateSection(OGG_music *music)
 {
     vorbis_info *vi;
+    SDL_bool converting;
 
     vi = vorbis.ov_info(&music->vf, -1);
     if (!vi) {
@@ -198,23 +240,30 @@ static int OGG_UpdateSection(OGG_music *music)
     }
     SDL_memcpy(&music->vi, vi, sizeof(*vi));
 
+    /* Once a section needed converting all the ones after it do, so that
+       audio read while switching is never in the wrong buffer */
+    converting = (music->stream || !music_spec_matches(music->format, vi->channels, (int)vi->rate));
+
     if (music->buffer) {
         SDL_free(music->buffer);
         music->buffer = NULL;
     }
 
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
         music->stream = NULL;
     }
 
-    music->stream = SDL_NewAudioStream(AUDIO_S16, vi->channels, (int)vi->rate,
-                                       music_spec.format, music_spec.channels, music_spec.freq);
+    if (!converting) {
+        return 0;
+    }
+    music->stream = _Mix_NewConverter(music->format, vi->channels, (int)vi->rate,
+                                      music_spec.format, music_spec.channels, music_spec.freq);
     if (!music->stream) {
         return -1;
     }
 
-    music->buffer_size = music_spec.samples * sizeof(Sint16) * vi->channels;
+    music->buffer_size = music_spec.samples * (SDL_AUDIO_BITSIZE(music->format) / 8) * vi->channels;
     music->buffer = (char *)SDL_malloc(music->buffer_size);
     if (!music->buffer) {
         return -1;
@@ -222,11 +271,222 @@ static int OGG_UpdateSection(OGG_music *music)
     return 0;
 }
 
+/* Decode up to 'len' bytes of interleaved music->format audio into 'dst',
+   returns the number of bytes decoded or a libvorbis error code */
+static int OGG_Read(OGG_music *music, char *dst, int len, int *section)
+{
+#ifdef OGG_USE_TREMOR
+    return (int)vorbis.ov_read(&music->vf, dst, len, section);
+#else
+    float **pcm;
+    float *out;
+    vorbis_info *vi;
+    long frames, i;
+    int c, channels;
+
+    if (music->format != AUDIO_F32SYS) {
+        return (int)vorbis.ov_read(&music->vf, dst, len, 0, 2, 1, section);
+    }
+
+    channels = music->vi.channels;
+    frames = vorbis.ov_read_float(&music->vf, &pcm, len / (channels * (int)sizeof(float)), section);
+    if (frames <= 0) {
+        return (int)frames;
+    }
+
+    /* A new chained section can come with more channels than this buffer
+       was sized for, drop what doesn't fit rather than overrun it */
+    vi = vorbis.ov_info(&music->vf, -1);
+    if (vi && vi->channels != channels) {
+        channels = vi->channels;
+        if (frames > len / (channels * (int)sizeof(float))) {
+            frames = len / (channels * (int)sizeof(float));
+        }
+    }
+
+    out = (float *)dst;
+    for (c = 0; c < channels; ++c) {
+        const float *src = pcm[c];
+        float *o = out + c;
+        for (i = 0; i < frames; ++i) {
+            *o = src[i];
+            o += channels;
+        }
+    }
+    return (int)(frames * channels * sizeof(float));
+#endif
+}
+
+/* A little-endian field of an Ogg page header */
+static Uint64 OGG_PageField(const Uint8 *field, int size)
+{
+    Uint64 value = 0;
+    while (size--) {
+        value = (value << 8) | field[size];
+    }
+    return value;
+}
+
+/* Index the pages of a plain single-section stream by reading just their
+   headers, so seeking is a binary search and one ov_raw_seek() rather
+   than the page-by-page bisection ov_pcm_seek() does every time */
+static void OGG_BuildSeekTable(OGG_music *music)
+{
+    OggVorbis_File *vf = &music->vf;
+    Uint8 header[27];
+    Uint8 lacing[255];
+    ogg_int64_t offset, granule;
+    Sint64 resume;
+    OGG_page *pages;
+    int capacity = 0, body, i;
+
+    if (!vf->seekable || vf->links != 1) {
+        return;
+    }
+
+    /* vorbisfile reads on from where it left the RWops */
+    resume = SDL_RWtell(music->src);
+    if (resume < 0) {
+        return;
+    }
+
+    offset = vf->offsets[0];
+    while (offset < vf->offsets[1]) {
+        if (SDL_RWseek(music->src, offset, RW_SEEK_SET) < 0 ||
+            SDL_RWread(music->src, header, sizeof(header), 1) != 1 ||
+            SDL_memcmp(header, "OggS", 4) != 0 ||
+            (ogg_uint32_t)OGG_PageField(header + 14, 4) != vf->serialnos[0] ||
+            SDL_RWread(music->src, lacing, 1, header[26]) != header[26]) {
+            break;
+        }
+        body = 0;
+        for (i = 0; i < header[26]; ++i) {
+            body += lacing[i];
+        }
+
+        granule = (ogg_int64_t)OGG_PageField(header + 6, 8);
+        if (granule > 0) {
+            if (music->num_pages == capacity) {
+                capacity = capacity ? capacity * 2 : 256;
+                pages = (OGG_page *)SDL_realloc(music->pages, capacity * sizeof(*pages));
+                if (!pages) {
+                    break;
+                }
+                music->pages = pages;
+            }
+            music->pages[music->num_pages].offset = offset;
+            music->pages[music->num_pages].pcm = granule - vf->pcmlengths[0];
+            ++music->num_pages;
+        }
+        offset += sizeof(header) + header[26] + body;
+    }
+
+    if (offset < vf->offsets[1]) {
+        /* A damaged or unusual file, leave it to vorbisfile */
+        SDL_free(music->pages);
+        music->pages = NULL;
+        music->num_pages = 0;
+    }
+    SDL_RWseek(music->src, resume, RW_SEEK_SET);
+}
+
+/* Seek to the sample 'pos', through the page index when there is one */
+static int OGG_SeekPCM(OGG_music *music, ogg_int64_t pos)
+{
+    char scratch[4096];
+    int lo = 0, hi = music->num_pages - 1, mid, frame, len, amount, section;
+    ogg_int64_t at;
+
+    /* The last page ending at or before 'pos': decoding from its start
+       resumes at or before 'pos', never after it */
+    while (lo <= hi) {
+        mid = lo + (hi - lo) / 2;
+        if (music->pages[mid].pcm <= pos) {
+            lo = mid + 1;
+        } else {
+            hi = mid - 1;
+        }
+    }
+    if (hi < 0 || vorbis.ov_raw_seek(&music->vf, music->pages[hi].offset) < 0) {
+        return vorbis.ov_pcm_seek(&music->vf, pos);
+    }
+    at = vorbis.ov_pcm_tell(&music->vf);
+    if (at < 0 || at > pos) {
+        return vorbis.ov_pcm_seek(&music->vf, pos);
+    }
+
+    /* Decode away the rest of the page up to 'pos' */
+    frame = music->vi.channels * (SDL_AUDIO_BITSIZE(music->format) / 8);
+    section = music->section;
+    while (at < pos) {
+        len = (int)SDL_min(pos - at, (ogg_int64_t)(sizeof(scratch) / frame)) * frame;
+        amount = OGG_Read(music, scratch, len, &section);
+        if (amount <= 0) {
+            return amount < 0 ? amount : vorbis.ov_pcm_seek(&music->vf, pos);
+        }
+        at = vorbis.ov_pcm_tell(&music->vf);
+    }
+    return 0;
+}
+
+/* Decode the start of the loop up to where a raw seek to a page picks the
+   stream up again, so wrapping around plays from memory while the decoder
+   jumps straight to the page after it, no bisection or decoding to skip */
+static void OGG_CaptureLeadIn(OGG_music *music)
+{
+    ogg_int64_t resume;
+    int frame, filled, amount, section, i;
+
+    for (i = 0; i < music->num_pages; ++i) {
+        if (music->pages[i].pcm >= music->loop_start) {
+            break;
+        }
+    }
+    if (i + 1 >= music->num_pages ||
+        vorbis.ov_raw_seek(&music->vf, music->pages[i + 1].offset) < 0) {
+        return;
+    }
+    resume = vorbis.ov_pcm_tell(&music->vf);
+    /* Keep it to a second or two of audio, a page or so */
+    if (resume <= music->loop_start || resume >= music->loop_end ||
+        resume - music->loop_start > 2 * music->vi.rate) {
+        return;
+    }
+
+    frame = music->vi.channels * (SDL_AUDIO_BITSIZE(music->format) / 8);
+    music->lead_in_size = (int)(resume - music->loop_start) * frame;
+    music->lead_in = (char *)SDL_malloc(music->lead_in_size);
+    if (!music->lead_in || OGG_SeekPCM(music, music->loop_start) < 0) {
+        goto fail;
+    }
+    section = music->section;
+    for (filled = 0; filled < music->lead_in_size; filled += amount) {
+        amount = OGG_Read(music, music->lead_in + filled, music->lead_in_size - filled, &section);
+        if (amount <= 0) {
+            goto fail;
+        }
+    }
+    if (vorbis.ov_pcm_tell(&music->vf) != resume) {
+        goto fail;
+    }
+    music->lead_in_resume = music->pages[i + 1].offset;
+    music->lead_in_pos = music->lead_in_size;
+    return;
+
+fail:
+    SDL_free(music->lead_in);
+    music->lead_in = NULL;
+    music->lead_in_size = 0;
+}
+
 /* Load an OGG stream from an SDL_RWops object */
 static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
 {
     OGG_music *music;
     ov_callbacks callbacks;
+    const void *data;
+    size_t size;
+    int result;
     vorbis_comment *vc;
     int isLoopLength = 0, i;
     ogg_int64_t fullLength;
@@ -243,13 +503,27 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
     music->loop_start = -1;
     music->loop_end = 0;
     music->loop_len = 0;
+#ifdef OGG_USE_TREMOR
+    music->format = AUDIO_S16;
+#else
+    /* libvorbis synthesizes float, hand it over as is to a float device */
+    music->format = (music_spec.format == AUDIO_F32SYS) ? AUDIO_F32SYS : AUDIO_S16;
+#endif
 
     SDL_zero(callbacks);
     callbacks.read_func = sdl_read_func;
     callbacks.seek_func = sdl_seek_func;
     callbacks.tell_func = sdl_tell_func;
 
-    if (vorbis.ov_open_callbacks(src, &music->vf, NULL, 0, callbacks) < 0) {
+    /* A mapped file, or any memory stream, is parsed in place rather than
+       copied a piece at a time into the Ogg framer */
+    data = _Mix_RWMemory(src, &size);
+    if (data && vorbis.ov_open_memory && SDL_RWtell(src) == 0) {
+        result = vorbis.ov_open_memory(src, &music->vf, data, (ogg_int64_t)size, callbacks);
+    } else {
+        result = vorbis.ov_open_callbacks(src, &music->vf, NULL, 0, callbacks);
+    }
+    if (result < 0) {
         SDL_SetError("Not an Ogg Vorbis audio stream");
         SDL_free(music);
         return NULL;
@@ -299,6 +573,11 @@ static void *OGG_CreateFromRW(SDL_RWops *src, int freesrc)
         music->loop = 1;
     }
 
+    OGG_BuildSeekTable(music);
+    if (music->loop == 1 && music->pages) {
+        OGG_CaptureLeadIn(music);
+    }
+
     music->freesrc = freesrc;
     return music;
 }
@@ -323,13 +602,24 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 {
     OGG_music *music = (OGG_music *)context;
     SDL_bool looped = SDL_FALSE;
-    int filled, amount, result;
+    int filled = 0, amount, result;
     int section;
     ogg_int64_t pcmPos;
+    char *dst;
+    int len;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
-    if (filled != 0) {
-        return filled;
+    if (music->stream) {
+        filled = _Mix_ConverterGet(music->stream, data, bytes);
+        if (filled != 0) {
+            music_pcm_volume(data, filled, music->volume);
+            return filled;
+        }
+        dst = music->buffer;
+        len = music->buffer_size;
+    } else {
+        /* Already in the output format, decode straight into the caller */
+        dst = (char *)data;
+        len = bytes;
     }
 
     if (!music->play_count) {
@@ -338,43 +628,60 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    section = music->section;
-#ifdef OGG_USE_TREMOR
-    amount = vorbis.ov_read(&music->vf, music->buffer, music->buffer_size, &section);
-#else
-    amount = (int)vorbis.ov_read(&music->vf, music->buffer, music->buffer_size, 0, 2, 1, &section);
-#endif
-    if (amount < 0) {
-        set_ov_error("ov_read", amount);
-        return -1;
-    }
-
-    if (section != music->section) {
-        music->section = section;
-        if (OGG_UpdateSection(music) < 0) {
+    if (music->lead_in_pos < music->lead_in_size) {
+        /* Just looped, the decoder is already past what this holds */
+        amount = SDL_min(len, music->lead_in_size - music->lead_in_pos);
+        SDL_memcpy(dst, music->lead_in + music->lead_in_pos, amount);
+        music->lead_in_pos += amount;
+    } else {
+        section = music->section;
+        amount = OGG_Read(music, dst, len, &section);
+        if (amount < 0) {
+            defer_ov_error("ov_read", amount);
             return -1;
         }
-    }
 
-    pcmPos = vorbis.ov_pcm_tell(&music->vf);
-    if ((music->loop == 1) && (pcmPos >= music->loop_end)) {
-        amount -= (int)((pcmPos - music->loop_end) * music->channels) * sizeof(Sint16);
-        result = vorbis.ov_pcm_seek(&music->vf, music->loop_start);
-        if (result < 0) {
-            set_ov_error("ov_pcm_seek", result);
-            return -1;
+        if (section != music->section) {
+            music->section = section;
+            if (OGG_UpdateSection(music) < 0) {
+                return -1;
+            }
+        }
+
+        pcmPos = vorbis.ov_pcm_tell(&music->vf);
+        if ((music->loop == 1) && (pcmPos >= music->loop_end)) {
+            amount -= (int)((pcmPos - music->loop_end) * music->vi.channels) * (SDL_AUDIO_BITSIZE(music->format) / 8);
+            if (music->lead_in) {
+                result = vorbis.ov_raw_seek(&music->vf, music->lead_in_resume);
+                if (result < 0) {
+                    defer_ov_error("ov_raw_seek", result);
+                    return -1;
+                }
+                music->lead_in_pos = 0;
+            } else {
+                result = OGG_SeekPCM(music, music->loop_start);
+                if (result < 0) {
+                    defer_ov_error("ov_pcm_seek", result);
+                    return -1;
+                }
+            }
+            looped = SDL_TRUE;
         }
-        looped = SDL_TRUE;
     }
 
     if (amount > 0) {
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (!music->stream) {
+            music_pcm_volume(data, amount, music->volume);
+            filled = amount;
+        } else if (_Mix_ConverterPut(music->stream, dst, amount) < 0) {
             return -1;
         }
     } else if (!looped) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            if (music->stream) {
+                _Mix_ConverterFlush(music->stream);
+            }
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -385,12 +692,11 @@ static int OGG_GetSome(void *context, void *data, int bytes, SDL_bool *done)
             }
         }
     }
-    return 0;
+    return filled;
 }
 static int OGG_GetAudio(void *context, void *data, int bytes)
 {
-    OGG_music *music = (OGG_music *)context;
-    return music_pcm_getaudio(context, data, bytes, music->volume, OGG_GetSome);
+    return music_pcm_getaudio(context, data, bytes, OGG_GetSome);
 }
 
 /* Jump (seek) to a given position (time is in seconds) */
@@ -398,6 +704,15 @@ static int OGG_Seek(void *context, double time)
 {
     OGG_music *music = (OGG_music *)context;
     int result;
+
+    music->lead_in_pos = music->lead_in_size;
+    if (music->pages) {
+        result = OGG_SeekPCM(music, (ogg_int64_t)(time * music->vi.rate));
+        if (result < 0) {
+            return set_ov_error("ov_pcm_seek", result);
+        }
+        return 0;
+    }
 #ifdef OGG_USE_TREMOR
     result = vorbis.ov_time_seek(&music->vf, (ogg_int64_t)(time * 1000.0));
 #else
@@ -409,17 +724,72 @@ static int OGG_Seek(void *context, double time)
     return 0;
 }
 
+/* Return the current position in seconds */
+static double OGG_Tell(void *context)
+{
+    OGG_music *music = (OGG_music *)context;
+    ogg_int64_t pos;
+
+    if (music->vi.rate <= 0) {
+        return -1.0;
+    }
+    if (music->lead_in_pos < music->lead_in_size) {
+        pos = music->loop_start + music->lead_in_pos / (music->vi.channels * (SDL_AUDIO_BITSIZE(music->format) / 8));
+        return (double)pos / music->vi.rate;
+    }
+    pos = vorbis.ov_pcm_tell(&music->vf);
+    if (pos < 0) {
+        return -1.0;
+    }
+    return (double)pos / music->vi.rate;
+}
+
+/* Return the length of the whole stream in seconds */
+static double OGG_Duration(void *context)
+{
+    OGG_music *music = (OGG_music *)context;
+    ogg_int64_t total;
+
+    if (music->vi.rate <= 0) {
+        return -1.0;
+    }
+    total = vorbis.ov_pcm_total(&music->vf, -1);
+    if (total < 0) {
+        return -1.0;
+    }
+    return (double)total / music->vi.rate;
+}
+
+/* LOOPSTART and LOOPEND, which loop forever whatever the play count */
+static int OGG_Loop(void *context, double *start, double *end)
+{
+    OGG_music *music = (OGG_music *)context;
+
+    if (music->loop != 1 || music->vi.rate <= 0) {
+        return 0;
+    }
+    *start = (double)music->loop_start / music->vi.rate;
+    *end = (double)music->loop_end / music->vi.rate;
+    return 1;
+}
+
 /* Close the given OGG stream */
 static void OGG_Delete(void *context)
 {
     OGG_music *music = (OGG_music *)context;
     vorbis.ov_clear(&music->vf);
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
     }
+    if (music->pages) {
+        SDL_free(music->pages);
+    }
+    if (music->lead_in) {
+        SDL_free(music->lead_in);
+    }
     if (music->freesrc) {
         SDL_RWclose(music->src);
     }
@@ -443,6 +813,9 @@ Mix_MusicInterface Mix_MusicInterface_OGG =
     NULL,   /* IsPlaying */
     OGG_GetAudio,
     OGG_Seek,
+    OGG_Tell,
+    OGG_Duration,
+    OGG_Loop,
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
@@ -223,6 +223,9 @@ Mix_MusicInterface Mix_MusicInterface_SMPEG =
     SMPEG_IsPlaying,
     SMPEG_GetAudio,
     SMPEG_Seek,
+    NULL,   /* Tell */
+    NULL,   /* Duration */
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     SMPEG_Stop,
@@ -24,6 +24,7 @@
 #ifdef MUSIC_MID_TIMIDITY
 
 #include "music_timidity.h"
+#include "mixer_convert.h"
 
 #include "timidity/timidity.h"
 
@@ -32,21 +33,77 @@ typedef struct
 {
     int play_count;
     MidiSong *song;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;
     void *buffer;
     Sint32 buffer_size;
+    int voices;
+    Mix_Resampler resampler;
 } TIMIDITY_Music;
 
 
 static int TIMIDITY_Seek(void *context, double position);
 static void TIMIDITY_Delete(void *context);
 
+/* The event cache for the MIDI data from the current position of src on,
+   named after its FNV-1a hash, its size and the output rate */
+static char *TIMIDITY_CachePath(SDL_RWops *src, int freq)
+{
+    const char *dir = Mix_GetMIDICacheDir();
+    Uint8 data[4096];
+    Uint32 hash = 2166136261u;
+    Sint64 start, size = 0;
+    size_t i, amount;
+    char *path;
+
+    if (!dir || (start = SDL_RWtell(src)) < 0) {
+        return NULL;
+    }
+    while ((amount = SDL_RWread(src, data, 1, sizeof(data))) > 0) {
+        for (i = 0; i < amount; ++i) {
+            hash = (hash ^ data[i]) * 16777619u;
+        }
+        size += amount;
+    }
+    if (SDL_RWseek(src, start, RW_SEEK_SET) != start) {
+        return NULL;
+    }
+
+    amount = SDL_strlen(dir) + 40;
+    path = (char *)SDL_malloc(amount);
+    if (path) {
+        SDL_snprintf(path, amount, "%s/%08x%08x-%d.tmev",
+                     dir, hash, (Uint32)size, freq);
+    }
+    return path;
+}
+
+static void TIMIDITY_SetResampler(MidiSong *song, Mix_Resampler resampler)
+{
+    switch (resampler) {
+    case MIX_RESAMPLE_NEAREST:
+        Timidity_SetResampleMode(song, RESAMPLE_NEAREST);
+        break;
+    case MIX_RESAMPLE_CUBIC:
+        Timidity_SetResampleMode(song, RESAMPLE_CUBIC);
+        break;
+    default:
+        Timidity_SetResampleMode(song, RESAMPLE_LINEAR);
+        break;
+    }
+}
+
 static int TIMIDITY_Open(const SDL_AudioSpec *spec)
 {
     return Timidity_Init();
 }
 
+/* The config, and where the patches are, stay for the next open */
 static void TIMIDITY_Close(void)
+{
+    Timidity_Close();
+}
+
+static void TIMIDITY_Unload(void)
 {
     Timidity_Exit();
 }
@@ -56,6 +113,8 @@ void *TIMIDITY_CreateFromRW(SDL_RWops *src, int freesrc)
     TIMIDITY_Music *music;
     SDL_AudioSpec spec;
     SDL_bool need_stream = SDL_FALSE;
+    SDL_RWops *cache = NULL;
+    char *path;
 
     music = (TIMIDITY_Music *)SDL_calloc(1, sizeof(*music));
     if (!music) {
@@ -68,15 +127,31 @@ void *TIMIDITY_CreateFromRW(SDL_RWops *src, int freesrc)
         need_stream = SDL_TRUE;
         spec.channels = 2;
     }
-    music->song = Timidity_LoadSong(src, &spec);
+    path = TIMIDITY_CachePath(src, spec.freq);
+    if (path && (cache = SDL_RWFromFile(path, "rb")) != NULL) {
+        music->song = Timidity_LoadSongCache(cache, &spec);
+        SDL_RWclose(cache);
+    }
+    if (!music->song) {
+        music->song = Timidity_LoadSong(src, &spec);
+        if (music->song && path && (cache = SDL_RWFromFile(path, "wb")) != NULL) {
+            Timidity_SaveSongCache(music->song, cache);
+            SDL_RWclose(cache);
+        }
+    }
+    SDL_free(path);
     if (!music->song) {
         TIMIDITY_Delete(music);
         return NULL;
     }
+    music->voices = Mix_GetMIDIVoices();
+    Timidity_SetMaxVoices(music->song, music->voices);
+    music->resampler = Mix_GetMIDIResampler();
+    TIMIDITY_SetResampler(music->song, music->resampler);
 
     if (need_stream) {
-        music->stream = SDL_NewAudioStream(spec.format, spec.channels, spec.freq,
-                                           music_spec.format, music_spec.channels, music_spec.freq);
+        music->stream = _Mix_NewConverter(spec.format, spec.channels, spec.freq,
+                                          music_spec.format, music_spec.channels, music_spec.freq);
         if (!music->stream) {
             TIMIDITY_Delete(music);
             return NULL;
@@ -114,10 +189,24 @@ static int TIMIDITY_Play(void *context, int play_count)
 static int TIMIDITY_GetSome(void *context, void *data, int bytes, SDL_bool *done)
 {
     TIMIDITY_Music *music = (TIMIDITY_Music *)context;
-    int filled, amount, expected;
+    int filled, amount, expected, voices;
+    Mix_Resampler resampler;
+
+    /* Pick up Mix_SetMIDIVoices() and Mix_SetMIDIResampler() here, where
+       nothing is being mixed */
+    voices = Mix_GetMIDIVoices();
+    if (voices != music->voices) {
+        Timidity_SetMaxVoices(music->song, voices);
+        music->voices = voices;
+    }
+    resampler = Mix_GetMIDIResampler();
+    if (resampler != music->resampler) {
+        TIMIDITY_SetResampler(music->song, resampler);
+        music->resampler = resampler;
+    }
 
     if (music->stream) {
-        filled = SDL_AudioStreamGet(music->stream, data, bytes);
+        filled = _Mix_ConverterGet(music->stream, data, bytes);
         if (filled != 0) {
             return filled;
         }
@@ -132,7 +221,7 @@ static int TIMIDITY_GetSome(void *context, void *data, int bytes, SDL_bool *done
     if (music->stream) {
         expected = music->buffer_size;
         amount = Timidity_PlaySome(music->song, music->buffer, music->buffer_size);
-        if (SDL_AudioStreamPut(music->stream, music->buffer, amount) < 0) {
+        if (_Mix_ConverterPut(music->stream, music->buffer, amount) < 0) {
             return -1;
         }
     } else {
@@ -164,7 +253,7 @@ static int TIMIDITY_GetSome(void *context, void *data, int bytes, SDL_bool *done
 }
 static int TIMIDITY_GetAudio(void *context, void *data, int bytes)
 {
-    return music_pcm_getaudio(context, data, bytes, MIX_MAX_VOLUME, TIMIDITY_GetSome);
+    return music_pcm_getaudio(context, data, bytes, TIMIDITY_GetSome);
 }
 
 static int TIMIDITY_Seek(void *context, double position)
@@ -174,6 +263,18 @@ static int TIMIDITY_Seek(void *context, double position)
     return 0;
 }
 
+static double TIMIDITY_Tell(void *context)
+{
+    TIMIDITY_Music *music = (TIMIDITY_Music *)context;
+    return Timidity_GetSongTime(music->song) / 1000.0;
+}
+
+static double TIMIDITY_Duration(void *context)
+{
+    TIMIDITY_Music *music = (TIMIDITY_Music *)context;
+    return Timidity_GetSongLength(music->song) / 1000.0;
+}
+
 static void TIMIDITY_Delete(void *context)
 {
     TIMIDITY_Music *music = (TIMIDITY_Music *)context;
@@ -182,7 +283,7 @@ static void TIMIDITY_Delete(void *context)
         Timidity_FreeSong(music->song);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -190,6 +291,15 @@ static void TIMIDITY_Delete(void *context)
     SDL_free(music);
 }
 
+int TIMIDITY_SetThreads(int threads, int min_voices)
+{
+    if (Timidity_SetThreads(threads, min_voices) < 0) {
+        Mix_SetError("Couldn't start the MIDI threads");
+        return -1;
+    }
+    return 0;
+}
+
 Mix_MusicInterface Mix_MusicInterface_TIMIDITY =
 {
     "TIMIDITY",
@@ -207,12 +317,15 @@ Mix_MusicInterface Mix_MusicInterface_TIMIDITY =
     NULL,   /* IsPlaying */
     TIMIDITY_GetAudio,
     TIMIDITY_Seek,
+    TIMIDITY_Tell,
+    TIMIDITY_Duration,
+    NULL,   /* Loop */
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
     TIMIDITY_Delete,
     TIMIDITY_Close,
-    NULL,   /* Unload */
+    TIMIDITY_Unload,
 };
 
 #endif /* MUSIC_MID_TIMIDITY */
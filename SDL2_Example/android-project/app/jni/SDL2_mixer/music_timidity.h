@@ -25,4 +25,7 @@
 
 extern Mix_MusicInterface Mix_MusicInterface_TIMIDITY;
 
+/* See Mix_SetMIDIThreads() */
+extern int TIMIDITY_SetThreads(int threads, int min_voices);
+
 /* vi: set ts=4 sw=4 expandtab: */
@@ -24,6 +24,32 @@
 /* This file supports streaming WAV files */
 
 #include "music_wav.h"
+#include "mixer_convert.h"
+#include "load_mmap.h"
+
+
+/* The data chunk is read in blocks of WAV_READAHEAD_SIZE at file offsets
+   aligned to that size, by a worker thread that stays WAV_READAHEAD_DEPTH
+   blocks ahead of playback.  The first block after the start of the data
+   and after each loop start is read once and kept, so jumping back there
+   never waits on the file. */
+#define WAV_READAHEAD_SIZE      65536
+#define WAV_READAHEAD_BLOCKS    4
+#define WAV_READAHEAD_DEPTH     3
+
+#define WAV_BLOCK_FREE      0
+#define WAV_BLOCK_WANTED    1   /* Queued for the worker */
+#define WAV_BLOCK_LOADING   2   /* Being read, by the worker or on a miss */
+#define WAV_BLOCK_READY     3
+
+typedef struct {
+    SDL_atomic_t state;
+    Sint64 offset;      /* File offset of data[0] */
+    int len;            /* Bytes in data, once ready */
+    SDL_bool resident;  /* Holds a loop start, never reused */
+    Uint32 used;        /* When playback last wanted it, for reuse */
+    Uint8 *data;
+} WAVBlock;
 
 
 typedef struct {
@@ -43,9 +69,17 @@ typedef struct {
     Sint64 start;
     Sint64 stop;
     Uint8 *buffer;
-    SDL_AudioStream *stream;
+    Mix_Converter *stream;      /* NULL if the file is already in music_spec */
     int numloops;
     WAVLoopPoint *loops;
+    Sint64 pos;                 /* Playback position in the file */
+    WAVBlock *blocks;           /* NULL if src is already in memory */
+    int numblocks;
+    Uint32 clock;
+    SDL_mutex *io_lock;         /* Held around each seek and read of src */
+    SDL_sem *io_wake;
+    SDL_Thread *io_thread;
+    SDL_atomic_t io_quit;
 } WAV_Music;
 
 /*
@@ -123,6 +157,274 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave);
 
 static void WAV_Delete(void *context);
 
+/* Read from 'offset' in the data chunk, returns the number of bytes read */
+static int WAV_ReadAt(WAV_Music *music, Sint64 offset, Uint8 *dst, int len)
+{
+    int amount = 0;
+
+    if (offset >= music->stop) {
+        return 0;
+    }
+    if (len > music->stop - offset) {
+        len = (int)(music->stop - offset);
+    }
+    if (music->io_lock) {
+        SDL_LockMutex(music->io_lock);
+    }
+    if (SDL_RWseek(music->src, offset, RW_SEEK_SET) >= 0) {
+        amount = (int)SDL_RWread(music->src, dst, 1, len);
+    }
+    if (music->io_lock) {
+        SDL_UnlockMutex(music->io_lock);
+    }
+    return amount;
+}
+
+static void WAV_LoadBlock(WAV_Music *music, WAVBlock *block)
+{
+    block->len = WAV_ReadAt(music, block->offset, block->data, WAV_READAHEAD_SIZE);
+    SDL_AtomicSet(&block->state, WAV_BLOCK_READY);
+}
+
+static int SDLCALL WAV_ReadAheadThread(void *data)
+{
+    WAV_Music *music = (WAV_Music *)data;
+    int i;
+
+    while (!SDL_AtomicGet(&music->io_quit)) {
+        SDL_bool loaded = SDL_FALSE;
+        for (i = 0; i < music->numblocks; ++i) {
+            WAVBlock *block = &music->blocks[i];
+            if (SDL_AtomicCAS(&block->state, WAV_BLOCK_WANTED, WAV_BLOCK_LOADING)) {
+                WAV_LoadBlock(music, block);
+                loaded = SDL_TRUE;
+            }
+        }
+        if (!loaded) {
+            SDL_SemWait(music->io_wake);
+        }
+    }
+    return 0;
+}
+
+/* The block holding or about to hold 'pos', or NULL */
+static WAVBlock *WAV_FindBlock(WAV_Music *music, Sint64 pos)
+{
+    const Sint64 aligned = pos & ~(Sint64)(WAV_READAHEAD_SIZE - 1);
+    int i;
+
+    for (i = 0; i < music->numblocks; ++i) {
+        WAVBlock *block = &music->blocks[i];
+        int state = SDL_AtomicGet(&block->state);
+        if (state == WAV_BLOCK_READY) {
+            if (pos >= block->offset && pos < block->offset + block->len) {
+                return block;
+            }
+        } else if (state != WAV_BLOCK_FREE && block->offset == aligned) {
+            return block;
+        }
+    }
+    return NULL;
+}
+
+/* Queue the block holding 'pos' for the worker, reusing the block that
+   playback wanted longest ago. Returns NULL if they're all in flight. */
+static WAVBlock *WAV_RequestBlock(WAV_Music *music, Sint64 pos)
+{
+    WAVBlock *victim = NULL;
+    int i;
+
+    for (i = 0; i < music->numblocks; ++i) {
+        WAVBlock *block = &music->blocks[i];
+        int state = SDL_AtomicGet(&block->state);
+        if (block->resident || (state != WAV_BLOCK_FREE && state != WAV_BLOCK_READY)) {
+            continue;
+        }
+        if (state == WAV_BLOCK_READY && block->used == music->clock) {
+            /* Wanted again by this same pass */
+            continue;
+        }
+        if (!victim || (Sint32)(block->used - victim->used) < 0) {
+            victim = block;
+        }
+    }
+    if (victim) {
+        victim->offset = pos & ~(Sint64)(WAV_READAHEAD_SIZE - 1);
+        victim->len = 0;
+        victim->used = music->clock;
+        SDL_AtomicSet(&victim->state, WAV_BLOCK_WANTED);
+        if (music->io_wake) {
+            SDL_SemPost(music->io_wake);
+        }
+    }
+    return victim;
+}
+
+/* Where playback goes once it has played up to 'end', or -1 if it stops */
+static Sint64 WAV_NextPos(WAV_Music *music, Sint64 end)
+{
+    const int bytes_per_sample = (SDL_AUDIO_BITSIZE(music->spec.format) / 8) * music->spec.channels;
+    int i;
+
+    for (i = 0; i < music->numloops; ++i) {
+        WAVLoopPoint *loop = &music->loops[i];
+        if (loop->active && loop->current_play_count != 1) {
+            Sint64 loop_start = music->start + loop->start * bytes_per_sample;
+            Sint64 loop_stop = music->start + (loop->stop + 1) * bytes_per_sample;
+            if (music->pos >= loop_start && music->pos < loop_stop) {
+                return (end >= loop_stop) ? loop_start : end;
+            }
+        }
+    }
+    if (end >= music->stop) {
+        return (music->play_count == 1) ? -1 : music->start;
+    }
+    return end;
+}
+
+/* Make sure the next few blocks playback will need are on their way */
+static void WAV_ReadAhead(WAV_Music *music)
+{
+    Sint64 pos = music->pos;
+    int i;
+
+    ++music->clock;
+    for (i = 0; i < WAV_READAHEAD_DEPTH && pos >= 0; ++i) {
+        WAVBlock *block = WAV_FindBlock(music, pos);
+        Sint64 end;
+
+        if (!block) {
+            block = WAV_RequestBlock(music, pos);
+            if (!block) {
+                return;
+            }
+        }
+        block->used = music->clock;
+        if (block->resident) {
+            end = block->offset + block->len;
+        } else {
+            end = block->offset + WAV_READAHEAD_SIZE;
+        }
+        pos = WAV_NextPos(music, end);
+    }
+}
+
+/* Read from the playback position, returns the number of bytes read */
+static int WAV_Read(WAV_Music *music, Uint8 *dst, int len)
+{
+    int total = 0;
+
+    if (!music->blocks) {
+        total = WAV_ReadAt(music, music->pos, dst, len);
+        music->pos += total;
+        return total;
+    }
+
+    while (total < len && music->pos < music->stop) {
+        WAVBlock *block = WAV_FindBlock(music, music->pos);
+        int amount;
+
+        if (!block) {
+            ++music->clock;
+            block = WAV_RequestBlock(music, music->pos);
+            if (!block) {
+                break;
+            }
+        }
+
+        /* A miss: load it here, or wait for the worker to finish it */
+        while (SDL_AtomicGet(&block->state) != WAV_BLOCK_READY) {
+            if (SDL_AtomicCAS(&block->state, WAV_BLOCK_WANTED, WAV_BLOCK_LOADING)) {
+                WAV_LoadBlock(music, block);
+            } else {
+                SDL_LockMutex(music->io_lock);
+                SDL_UnlockMutex(music->io_lock);
+            }
+        }
+        if (music->pos < block->offset || music->pos >= block->offset + block->len) {
+            /* Read error or the file is shorter than its data chunk */
+            break;
+        }
+
+        amount = (int)SDL_min((Sint64)(len - total), block->offset + block->len - music->pos);
+        SDL_memcpy(dst + total, block->data + (music->pos - block->offset), amount);
+        music->pos += amount;
+        total += amount;
+    }
+    WAV_ReadAhead(music);
+    return total;
+}
+
+/* Add a block that holds the data from 'offset' for the life of the music */
+static SDL_bool WAV_AddResidentBlock(WAV_Music *music, Sint64 offset)
+{
+    WAVBlock *block;
+    int i;
+
+    for (i = WAV_READAHEAD_BLOCKS; i < music->numblocks; ++i) {
+        if (music->blocks[i].offset == offset) {
+            return SDL_TRUE;
+        }
+    }
+    block = &music->blocks[music->numblocks];
+    block->data = (Uint8 *)SDL_malloc(WAV_READAHEAD_SIZE);
+    if (!block->data) {
+        return SDL_FALSE;
+    }
+    block->offset = offset;
+    block->resident = SDL_TRUE;
+    ++music->numblocks;
+    WAV_LoadBlock(music, block);
+    return SDL_TRUE;
+}
+
+static SDL_bool WAV_StartReadAhead(WAV_Music *music)
+{
+    const int bytes_per_sample = (SDL_AUDIO_BITSIZE(music->spec.format) / 8) * music->spec.channels;
+    size_t size;
+    int i;
+
+    if (_Mix_RWMemory(music->src, &size)) {
+        /* Nothing to gain, reads are a copy already */
+        return SDL_TRUE;
+    }
+
+    music->blocks = (WAVBlock *)SDL_calloc(WAV_READAHEAD_BLOCKS + 1 + music->numloops, sizeof(*music->blocks));
+    if (!music->blocks) {
+        SDL_OutOfMemory();
+        return SDL_FALSE;
+    }
+    for (i = 0; i < WAV_READAHEAD_BLOCKS; ++i) {
+        music->blocks[i].data = (Uint8 *)SDL_malloc(WAV_READAHEAD_SIZE);
+        if (!music->blocks[i].data) {
+            SDL_OutOfMemory();
+            return SDL_FALSE;
+        }
+    }
+    music->numblocks = WAV_READAHEAD_BLOCKS;
+
+    if (!WAV_AddResidentBlock(music, music->start)) {
+        SDL_OutOfMemory();
+        return SDL_FALSE;
+    }
+    for (i = 0; i < music->numloops; ++i) {
+        Sint64 loop_start = music->start + music->loops[i].start * bytes_per_sample;
+        if (loop_start < music->stop && !WAV_AddResidentBlock(music, loop_start)) {
+            SDL_OutOfMemory();
+            return SDL_FALSE;
+        }
+    }
+
+    /* Without a worker the blocks are still used, just read on a miss */
+    music->io_lock = SDL_CreateMutex();
+    music->io_wake = SDL_CreateSemaphore(0);
+    if (!music->io_lock || !music->io_wake) {
+        return SDL_FALSE;
+    }
+    music->io_thread = SDL_CreateThread(WAV_ReadAheadThread, "SDL_mixer WAV", music);
+    return SDL_TRUE;
+}
+
 /* Load a WAV stream from the given RWops object */
 static void *WAV_CreateFromRW(SDL_RWops *src, int freesrc)
 {
@@ -147,20 +449,27 @@ static void *WAV_CreateFromRW(SDL_RWops *src, int freesrc)
         Mix_SetError("Unknown WAVE format");
     }
     if (!loaded) {
+        SDL_free(music->loops);
         SDL_free(music);
         return NULL;
     }
-    music->buffer = (Uint8*)SDL_malloc(music->spec.size);
-    if (!music->buffer) {
+    if (!WAV_StartReadAhead(music)) {
         WAV_Delete(music);
         return NULL;
     }
-    music->stream = SDL_NewAudioStream(
-        music->spec.format, music->spec.channels, music->spec.freq,
-        music_spec.format, music_spec.channels, music_spec.freq);
-    if (!music->stream) {
-        WAV_Delete(music);
-        return NULL;
+    if (!music_spec_matches(music->spec.format, music->spec.channels, music->spec.freq)) {
+        music->buffer = (Uint8*)SDL_malloc(music->spec.size);
+        if (!music->buffer) {
+            WAV_Delete(music);
+            return NULL;
+        }
+        music->stream = _Mix_NewConverter(
+            music->spec.format, music->spec.channels, music->spec.freq,
+            music_spec.format, music_spec.channels, music_spec.freq);
+        if (!music->stream) {
+            WAV_Delete(music);
+            return NULL;
+        }
     }
 
     music->freesrc = freesrc;
@@ -184,9 +493,7 @@ static int WAV_Play(void *context, int play_count)
         loop->current_play_count = loop->initial_play_count;
     }
     music->play_count = play_count;
-    if (SDL_RWseek(music->src, music->start, RW_SEEK_SET) < 0) {
-        return -1;
-    }
+    music->pos = music->start;
     return 0;
 }
 
@@ -202,9 +509,12 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     int i;
     int filled, amount, result;
 
-    filled = SDL_AudioStreamGet(music->stream, data, bytes);
-    if (filled != 0) {
-        return filled;
+    if (music->stream) {
+        filled = _Mix_ConverterGet(music->stream, data, bytes);
+        if (filled != 0) {
+            music_pcm_volume(data, filled, music->volume);
+            return filled;
+        }
     }
 
     if (!music->play_count) {
@@ -213,7 +523,7 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         return 0;
     }
 
-    pos = SDL_RWtell(music->src);
+    pos = music->pos;
     stop = music->stop;
     loop = NULL;
     for (i = 0; i < music->numloops; ++i) {
@@ -231,36 +541,48 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
         loop = NULL;
     }
 
-    amount = music->spec.size;
+    if (music->stream) {
+        amount = music->spec.size;
+    } else {
+        /* Already in the output format, read straight into the caller */
+        amount = bytes;
+    }
     if ((stop - pos) < amount) {
         amount = (int)(stop - pos);
     }
-    amount = (int)SDL_RWread(music->src, music->buffer, 1, amount);
+    amount = WAV_Read(music, music->stream ? music->buffer : data, amount);
     if (amount > 0) {
-        result = SDL_AudioStreamPut(music->stream, music->buffer, amount);
-        if (result < 0) {
-            return -1;
+        if (music->stream) {
+            result = _Mix_ConverterPut(music->stream, music->buffer, amount);
+            if (result < 0) {
+                return -1;
+            }
+        } else {
+            music_pcm_volume(data, amount, music->volume);
         }
     } else {
         /* We might be looping, continue */
+        amount = 0;
     }
 
-    if (loop && SDL_RWtell(music->src) >= stop) {
+    if (loop && music->pos >= stop) {
         if (loop->current_play_count == 1) {
             loop->active = SDL_FALSE;
         } else {
             if (loop->current_play_count > 0) {
                 --loop->current_play_count;
             }
-            SDL_RWseek(music->src, loop_start, RW_SEEK_SET);
+            music->pos = loop_start;
             looped = SDL_TRUE;
         }
     }
 
-    if (!looped && SDL_RWtell(music->src) >= music->stop) {
+    if (!looped && music->pos >= music->stop) {
         if (music->play_count == 1) {
             music->play_count = 0;
-            SDL_AudioStreamFlush(music->stream);
+            if (music->stream) {
+                _Mix_ConverterFlush(music->stream);
+            }
         } else {
             int play_count = -1;
             if (music->play_count > 0) {
@@ -273,26 +595,78 @@ static int WAV_GetSome(void *context, void *data, int bytes, SDL_bool *done)
     }
 
     /* We'll get called again in the case where we looped or have more data */
-    return 0;
+    return music->stream ? 0 : amount;
 }
 
 static int WAV_GetAudio(void *context, void *data, int bytes)
+{
+    return music_pcm_getaudio(context, data, bytes, WAV_GetSome);
+}
+
+static double WAV_BytesToSeconds(WAV_Music *music, Sint64 bytes)
+{
+    const int frame_size = (SDL_AUDIO_BITSIZE(music->spec.format) / 8) * music->spec.channels;
+
+    if (frame_size <= 0 || music->spec.freq <= 0) {
+        return -1.0;
+    }
+    return (double)(bytes / frame_size) / music->spec.freq;
+}
+
+static double WAV_Tell(void *context)
 {
     WAV_Music *music = (WAV_Music *)context;
-    return music_pcm_getaudio(context, data, bytes, music->volume, WAV_GetSome);
+    Sint64 pos = music->pos;
+
+    if (pos < music->start) {
+        return 0.0;
+    }
+    return WAV_BytesToSeconds(music, pos - music->start);
+}
+
+static double WAV_Duration(void *context)
+{
+    WAV_Music *music = (WAV_Music *)context;
+    return WAV_BytesToSeconds(music, music->stop - music->start);
+}
+
+/* The loop points of a sampler chunk play a set number of times each */
+static int WAV_Loop(void *context, double *start, double *end)
+{
+    WAV_Music *music = (WAV_Music *)context;
+    return (music->numloops > 0) ? -1 : 0;
 }
 
 /* Close the given WAV stream */
 static void WAV_Delete(void *context)
 {
     WAV_Music *music = (WAV_Music *)context;
+    int i;
+
+    if (music->io_thread) {
+        SDL_AtomicSet(&music->io_quit, 1);
+        SDL_SemPost(music->io_wake);
+        SDL_WaitThread(music->io_thread, NULL);
+    }
+    if (music->io_wake) {
+        SDL_DestroySemaphore(music->io_wake);
+    }
+    if (music->io_lock) {
+        SDL_DestroyMutex(music->io_lock);
+    }
+    if (music->blocks) {
+        for (i = 0; i < WAV_READAHEAD_BLOCKS + 1 + music->numloops; ++i) {
+            SDL_free(music->blocks[i].data);
+        }
+        SDL_free(music->blocks);
+    }
 
     /* Clean up associated data */
     if (music->loops) {
         SDL_free(music->loops);
     }
     if (music->stream) {
-        SDL_FreeAudioStream(music->stream);
+        _Mix_FreeConverter(music->stream);
     }
     if (music->buffer) {
         SDL_free(music->buffer);
@@ -604,6 +978,10 @@ static SDL_bool LoadAIFFMusic(WAV_Music *wave)
     }
     spec->channels = (Uint8) channels;
     spec->samples = 4096;       /* Good default buffer size */
+    /* SDL_CalculateAudioSpec */
+    spec->size = SDL_AUDIO_BITSIZE(spec->format) / 8;
+    spec->size *= spec->channels;
+    spec->size *= spec->samples;
 
     return SDL_TRUE;
 }
@@ -625,6 +1003,9 @@ Mix_MusicInterface Mix_MusicInterface_WAV =
     NULL,   /* IsPlaying */
     WAV_GetAudio,
     NULL,   /* Seek */
+    WAV_Tell,
+    WAV_Duration,
+    WAV_Loop,
     NULL,   /* Pause */
     NULL,   /* Resume */
     NULL,   /* Stop */
@@ -64,7 +64,7 @@ void CleanUp(int exitcode)
 
 void Usage(char *argv0)
 {
-    SDL_Log("Usage: %s [-i] [-l] [-8] [-f32] [-r rate] [-c channels] [-b buffers] [-v N] [-rwops] <musicfile>\n", argv0);
+    SDL_Log("Usage: %s [-i] [-l] [-8] [-f32] [-r rate] [-c channels] [-b buffers] [-v N] [-rwops] <musicfile or http:// stream>\n", argv0);
 }
 
 void Menu(void)
@@ -117,6 +117,7 @@ int main(int argc, char *argv[])
     int interactive = 0;
     int rwops = 0;
     int i;
+    char title[256];
 
     /* Initialize variables */
     audio_rate = 22050;
@@ -202,9 +203,12 @@ int main(int argc, char *argv[])
 
     while (argv[i]) {
         next_track = 0;
+        title[0] = '\0';
 
-        /* Load the requested music file */
-        if (rwops) {
+        /* Load the requested music file, or stream it */
+        if (SDL_strncmp(argv[i], "http://", 7) == 0) {
+            music = Mix_LoadMUSStream(argv[i], 0);
+        } else if (rwops) {
             music = Mix_LoadMUS_RW(SDL_RWFromFile(argv[i], "rb"), SDL_TRUE);
         } else {
             music = Mix_LoadMUS(argv[i]);
@@ -219,10 +223,15 @@ int main(int argc, char *argv[])
         SDL_Log("Playing %s\n", argv[i]);
         Mix_FadeInMusic(music,looping,2000);
         while (!next_track && (Mix_PlayingMusic() || Mix_PausedMusic())) {
+            Mix_StreamStatus status;
             if(interactive)
                 Menu();
             else
                 SDL_Delay(100);
+            if (Mix_GetMusicStreamStatus(music, &status) == 0 && SDL_strcmp(status.title, title) != 0) {
+                SDL_strlcpy(title, status.title, sizeof(title));
+                SDL_Log("Now playing: %s\n", title);
+            }
         }
         Mix_FreeMusic(music);
         music = NULL;
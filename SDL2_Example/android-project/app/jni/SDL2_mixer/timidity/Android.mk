@@ -11,14 +11,19 @@ LOCAL_CFLAGS :=
 LOCAL_SRC_FILES += \
     common.c \
     instrum.c \
-    mix.c \
-    output.c \
     playmidi.c \
     readmidi.c \
-    resample.c \
     tables.c \
     timidity.c
 
+# The mixing, resampling and output loops pick NEON at runtime, so only
+# they get built with it
+ifeq ($(TARGET_ARCH_ABI),armeabi-v7a)
+    LOCAL_SRC_FILES += mix.c.neon output.c.neon resample.c.neon
+else
+    LOCAL_SRC_FILES += mix.c output.c resample.c
+endif
+
 LOCAL_SHARED_LIBRARIES := SDL2
 
 include $(BUILD_STATIC_LIBRARY)
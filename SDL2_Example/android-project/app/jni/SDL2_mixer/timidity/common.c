@@ -22,9 +22,147 @@
 #include "options.h"
 #include "common.h"
 
+/* Directories are listed where the system can, so a name that isn't
+   there is known without trying to open it */
+#if !defined(__WIN32__) && !defined(__OS2__)
+#  define LIST_DIRECTORIES
+#  include <dirent.h>
+#endif
+
 /* The paths in this list will be tried whenever we're reading a file */
 static PathList *pathlist = NULL; /* This is a linked list */
 
+/* The names in each directory looked in so far, kept until
+   free_file_index(). Songs load on any thread, so it's locked. */
+typedef struct _DirIndex {
+  char *dir;		/* up to and with the separator, "" for the current one */
+  int listed;		/* 0 if it couldn't be listed, every name is tried then */
+  char **names;		/* sorted */
+  int count;
+  struct _DirIndex *next;
+} DirIndex;
+
+static DirIndex *dir_index = NULL;
+static SDL_SpinLock dir_index_lock = 0;
+
+static int compare_names(const void *a, const void *b)
+{
+  return strcmp(*(char * const *)a, *(char * const *)b);
+}
+
+static void free_dir(DirIndex *index)
+{
+  int i;
+
+  for (i = 0; i < index->count; i++)
+    free(index->names[i]);
+  free(index->names);
+  free(index->dir);
+  free(index);
+}
+
+static DirIndex *list_dir(const char *dir, size_t len)
+{
+  DirIndex *index = safe_malloc(sizeof(DirIndex));
+
+  if (index == NULL)
+    return NULL;
+  memset(index, 0, sizeof(DirIndex));
+  if ((index->dir = safe_malloc(len + 1)) == NULL)
+  {
+    free(index);
+    return NULL;
+  }
+  memcpy(index->dir, dir, len);
+  index->dir[len] = '\0';
+
+#ifdef LIST_DIRECTORIES
+  {
+    DIR *d = opendir(len ? index->dir : ".");
+    struct dirent *entry;
+    int allocated = 0;
+
+    if (d == NULL)
+      return index;
+    while ((entry = readdir(d)) != NULL)
+    {
+      char *name;
+      if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, ".."))
+	continue;
+      if (index->count == allocated)
+      {
+	int size = allocated ? allocated * 2 : 64;
+	char **names = realloc(index->names, size * sizeof(char *));
+	if (names == NULL)
+	  break;
+	index->names = names;
+	allocated = size;
+      }
+      if ((name = safe_malloc(strlen(entry->d_name) + 1)) == NULL)
+	break;
+      strcpy(name, entry->d_name);
+      index->names[index->count++] = name;
+    }
+    closedir(d);
+
+    /* A listing cut short would hide names that are there */
+    if (entry != NULL)
+    {
+      free_dir(index);
+      return NULL;
+    }
+    qsort(index->names, index->count, sizeof(char *), compare_names);
+    index->listed = 1;
+  }
+#endif
+  return index;
+}
+
+static DirIndex *find_dir(const char *dir, size_t len)
+{
+  DirIndex *index, *listed;
+
+  SDL_AtomicLock(&dir_index_lock);
+  for (index = dir_index; index; index = index->next)
+    if (strlen(index->dir) == len && !strncmp(index->dir, dir, len))
+      break;
+  SDL_AtomicUnlock(&dir_index_lock);
+  if (index)
+    return index;
+
+  /* Listed without the lock, another thread may have listed it meanwhile */
+  if ((listed = list_dir(dir, len)) == NULL)
+    return NULL;
+  SDL_AtomicLock(&dir_index_lock);
+  for (index = dir_index; index; index = index->next)
+    if (strlen(index->dir) == len && !strncmp(index->dir, dir, len))
+      break;
+  if (index == NULL)
+  {
+    listed->next = dir_index;
+    dir_index = index = listed;
+    listed = NULL;
+  }
+  SDL_AtomicUnlock(&dir_index_lock);
+  if (listed)
+    free_dir(listed);
+  return index;
+}
+
+/* Only opens files that the index doesn't rule out */
+static SDL_RWops *open_indexed(const char *path)
+{
+  const char *base = strrchr(path, PATH_SEP);
+  size_t len = base ? (size_t)(base - path) + 1 : 0;
+  DirIndex *index = find_dir(path, len);
+
+  base = path + len;
+  if (index && index->listed &&
+      !bsearch(&base, index->names, index->count, sizeof(char *), compare_names))
+    return NULL;
+  return SDL_RWFromFile(path, "rb");
+}
+
 /* This is meant to find and open files for reading */
 SDL_RWops *open_file(const char *name)
 {
@@ -39,7 +177,7 @@ SDL_RWops *open_file(const char *name)
   /* First try the given name */
 
   SNDDBG(("Trying to open %s\n", name));
-  if ((rw = SDL_RWFromFile(name, "rb")))
+  if ((rw = open_indexed(name)))
     return rw;
 
   if (name[0] != PATH_SEP)
@@ -63,7 +201,7 @@ SDL_RWops *open_file(const char *name)
 	  }
 	strcat(current_filename, name);
 	SNDDBG(("Trying to open %s\n", current_filename));
-	if ((rw = SDL_RWFromFile(current_filename, "rb")))
+	if ((rw = open_indexed(current_filename)))
 	  return rw;
 	plp = plp->next;
       }
@@ -121,3 +259,17 @@ void free_pathlist(void)
     }
     pathlist = NULL;
 }
+
+void free_file_index(void)
+{
+    DirIndex *index = dir_index;
+    DirIndex *next;
+
+    while (index)
+    {
+	next = index->next;
+	free_dir(index);
+	index = next;
+    }
+    dir_index = NULL;
+}
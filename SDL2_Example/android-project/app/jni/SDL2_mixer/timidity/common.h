@@ -18,3 +18,6 @@ extern SDL_RWops *open_file(const char *name);
 extern void add_to_pathlist(const char *s);
 extern void *safe_malloc(size_t count);
 extern void free_pathlist(void);
+/* Forget the directory listings open_file() goes by, so files added
+   since are found */
+extern void free_file_index(void);
@@ -43,6 +43,38 @@ static void free_instrument(Instrument *ip)
   free(ip);
 }
 
+/* Loaded instruments are kept around for the songs after, as reading and
+   resampling the patches is most of the work Timidity_LoadSong() does.
+   What load_instrument() makes of a patch depends on all of its arguments
+   and on the output rate of the song, so together they are the key. */
+typedef struct _InstrumentCache {
+  char *name;
+  int percussion, panning, amp, note_to_use,
+    strip_loop, strip_envelope, strip_tail;
+  Sint32 rate;
+  Instrument *ip;
+  int refcount;
+  struct _InstrumentCache *next;
+} InstrumentCache;
+
+static InstrumentCache *instrument_cache = NULL;
+static SDL_SpinLock instrument_cache_lock = 0;
+
+static void release_instrument(Instrument *ip)
+{
+  InstrumentCache *entry;
+  SDL_AtomicLock(&instrument_cache_lock);
+  for (entry=instrument_cache; entry; entry=entry->next)
+    if (entry->ip == ip)
+      {
+	entry->refcount--;
+	break;
+      }
+  SDL_AtomicUnlock(&instrument_cache_lock);
+  if (!entry)
+    free_instrument(ip);
+}
+
 static void free_bank(MidiSong *song, int dr, int b)
 {
   int i;
@@ -52,7 +84,7 @@ static void free_bank(MidiSong *song, int dr, int b)
       {
 	/* Not that this could ever happen, of course */
 	if (bank->instrument[i] != MAGIC_LOAD_INSTRUMENT)
-	  free_instrument(bank->instrument[i]);
+	  release_instrument(bank->instrument[i]);
 	bank->instrument[i]=0;
       }
 }
@@ -507,6 +539,94 @@ static Instrument *load_instrument(MidiSong *song, char *name, int percussion,
   return ip;
 }
 
+/* Must be called with instrument_cache_lock held */
+static InstrumentCache *find_instrument(Sint32 rate, char *name, int percussion,
+					int panning, int amp, int note_to_use,
+					int strip_loop, int strip_envelope,
+					int strip_tail)
+{
+  InstrumentCache *entry;
+  for (entry=instrument_cache; entry; entry=entry->next)
+    if (entry->rate == rate && entry->percussion == percussion &&
+	entry->panning == panning && entry->amp == amp &&
+	entry->note_to_use == note_to_use &&
+	entry->strip_loop == strip_loop &&
+	entry->strip_envelope == strip_envelope &&
+	entry->strip_tail == strip_tail && !strcmp(entry->name, name))
+      return entry;
+  return 0;
+}
+
+/* load_instrument(), but through the cache. The patch is read without the
+   lock held, so if another song got to it first meanwhile, theirs wins. */
+static Instrument *get_instrument(MidiSong *song, char *name, int percussion,
+				  int panning, int amp, int note_to_use,
+				  int strip_loop, int strip_envelope,
+				  int strip_tail)
+{
+  InstrumentCache *entry;
+  Instrument *ip;
+
+  if (!name) return 0;
+
+  SDL_AtomicLock(&instrument_cache_lock);
+  entry = find_instrument(song->rate, name, percussion, panning, amp,
+			  note_to_use, strip_loop, strip_envelope, strip_tail);
+  if (entry)
+    {
+      entry->refcount++;
+      ip = entry->ip;
+      SDL_AtomicUnlock(&instrument_cache_lock);
+      return ip;
+    }
+  SDL_AtomicUnlock(&instrument_cache_lock);
+
+  ip = load_instrument(song, name, percussion, panning, amp, note_to_use,
+		       strip_loop, strip_envelope, strip_tail);
+  if (!ip) return 0;
+
+  entry = malloc(sizeof(InstrumentCache));
+  if (entry && (entry->name = malloc(strlen(name)+1)) != NULL)
+    strcpy(entry->name, name);
+  if (!entry || !entry->name)
+    {
+      /* Just don't share it then, release_instrument() frees it */
+      free(entry);
+      return ip;
+    }
+  entry->percussion = percussion;
+  entry->panning = panning;
+  entry->amp = amp;
+  entry->note_to_use = note_to_use;
+  entry->strip_loop = strip_loop;
+  entry->strip_envelope = strip_envelope;
+  entry->strip_tail = strip_tail;
+  entry->rate = song->rate;
+  entry->ip = ip;
+  entry->refcount = 1;
+
+  SDL_AtomicLock(&instrument_cache_lock);
+  {
+    InstrumentCache *other = find_instrument(song->rate, name, percussion,
+					     panning, amp, note_to_use,
+					     strip_loop, strip_envelope,
+					     strip_tail);
+    if (other)
+      {
+	other->refcount++;
+	SDL_AtomicUnlock(&instrument_cache_lock);
+	free_instrument(ip);
+	free(entry->name);
+	free(entry);
+	return other->ip;
+      }
+  }
+  entry->next = instrument_cache;
+  instrument_cache = entry;
+  SDL_AtomicUnlock(&instrument_cache_lock);
+  return ip;
+}
+
 static int fill_bank(MidiSong *song, int dr, int b)
 {
   int i, errors=0;
@@ -547,7 +667,7 @@ static int fill_bank(MidiSong *song, int dr, int b)
 	      errors++;
 	    }
 	  else if (!(bank->instrument[i] =
-		     load_instrument(song,
+		     get_instrument(song,
 				     bank->tone[i].name, 
 				     (dr) ? 1 : 0,
 				     bank->tone[i].pan,
@@ -596,12 +716,37 @@ void free_instruments(MidiSong *song)
       if (song->drumset[i])
 	free_bank(song, 1, i);
     }
+  if (song->default_instrument)
+    {
+      release_instrument(song->default_instrument);
+      song->default_instrument = 0;
+    }
+}
+
+/* Drop the instruments no song is using any more */
+void free_instrument_cache(void)
+{
+  InstrumentCache **link = &instrument_cache, *entry;
+  SDL_AtomicLock(&instrument_cache_lock);
+  while ((entry = *link) != NULL)
+    {
+      if (entry->refcount > 0)
+	{
+	  link = &entry->next;
+	  continue;
+	}
+      *link = entry->next;
+      free_instrument(entry->ip);
+      free(entry->name);
+      free(entry);
+    }
+  SDL_AtomicUnlock(&instrument_cache_lock);
 }
 
 int set_default_instrument(MidiSong *song, char *name)
 {
   Instrument *ip;
-  if (!(ip=load_instrument(song, name, 0, -1, -1, -1, 0, 0, 0)))
+  if (!(ip=get_instrument(song, name, 0, -1, -1, -1, 0, 0, 0)))
     return -1;
   song->default_instrument = ip;
   song->default_program = SPECIAL_PROGRAM;
@@ -27,4 +27,5 @@
 
 extern int load_missing_instruments(MidiSong *song);
 extern void free_instruments(MidiSong *song);
+extern void free_instrument_cache(void);
 extern int set_default_instrument(MidiSong *song, char *name);
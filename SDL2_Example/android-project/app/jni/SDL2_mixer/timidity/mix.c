@@ -27,6 +27,31 @@
 #include "resample.h"
 #include "mix.h"
 
+/* The NEON kernels are built on ARM when the compiler allows it (on
+   armeabi-v7a Android.mk compiles this file with -mfpu=neon), the SSE2
+   kernels on x86, and either is only used if the CPU has it. */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
+static SDL_bool mix_has_neon = SDL_FALSE;
+static SDL_bool mix_has_sse2 = SDL_FALSE;
+
+void init_mix(void)
+{
+#ifdef HAVE_NEON_INTRINSICS
+  mix_has_neon = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  mix_has_sse2 = SDL_HasSSE2();
+#endif
+}
+
 /* Returns 1 if envelope runs out */
 int recompute_envelope(MidiSong *song, int v)
 {
@@ -176,50 +201,146 @@ static int update_signal(MidiSong *song, int v)
 
 #define MIXATION(a)	*lp++ += (a)*s;
 
+/* The amplitudes are clamped to MAX_AMP_VALUE, so they fit in 16 bits and
+   16x16 bit multiplies give the exact products. Each kernel returns how
+   many samples it did, the scalar loops finish off the rest. */
+#ifdef HAVE_NEON_INTRINSICS
+static int mix_stereo_neon(Sint32 *lp, const sample_t *sp,
+			   Sint32 left, Sint32 right, int count)
+{
+  int i;
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      const int16x4_t s = vld1_s16(sp + i);
+      int32x4x2_t d = vld2q_s32(lp + 2*i);
+      d.val[0] = vaddq_s32(d.val[0], vmull_n_s16(s, (Sint16)left));
+      d.val[1] = vaddq_s32(d.val[1], vmull_n_s16(s, (Sint16)right));
+      vst2q_s32(lp + 2*i, d);
+    }
+  return i;
+}
+
+static int mix_mono_neon(Sint32 *lp, const sample_t *sp, Sint32 amp, int count)
+{
+  int i;
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      const int16x8_t s = vld1q_s16(sp + i);
+      vst1q_s32(lp + i, vaddq_s32(vld1q_s32(lp + i),
+				  vmull_n_s16(vget_low_s16(s), (Sint16)amp)));
+      vst1q_s32(lp + i + 4, vaddq_s32(vld1q_s32(lp + i + 4),
+				      vmull_n_s16(vget_high_s16(s), (Sint16)amp)));
+    }
+  return i;
+}
+#endif /* HAVE_NEON_INTRINSICS */
+
+#ifdef HAVE_SSE2_INTRINSICS
+static int mix_stereo_sse2(Sint32 *lp, const sample_t *sp,
+			   Sint32 left, Sint32 right, int count)
+{
+  const __m128i g = _mm_set_epi16((short)right, (short)left, (short)right, (short)left,
+				  (short)right, (short)left, (short)right, (short)left);
+  int i;
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      /* s0 s0 s1 s1 s2 s2 s3 s3 against l r l r l r l r */
+      const __m128i s = _mm_loadl_epi64((const __m128i *)(sp + i));
+      const __m128i ss = _mm_unpacklo_epi16(s, s);
+      const __m128i lo = _mm_mullo_epi16(ss, g);
+      const __m128i hi = _mm_mulhi_epi16(ss, g);
+      __m128i *d = (__m128i *)(lp + 2*i);
+      _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi16(lo, hi)));
+      _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi16(lo, hi)));
+    }
+  return i;
+}
+
+static int mix_mono_sse2(Sint32 *lp, const sample_t *sp, Sint32 amp, int count)
+{
+  const __m128i g = _mm_set1_epi16((short)amp);
+  int i;
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      const __m128i s = _mm_loadu_si128((const __m128i *)(sp + i));
+      const __m128i lo = _mm_mullo_epi16(s, g);
+      const __m128i hi = _mm_mulhi_epi16(s, g);
+      __m128i *d = (__m128i *)(lp + i);
+      _mm_storeu_si128(d, _mm_add_epi32(_mm_loadu_si128(d), _mm_unpacklo_epi16(lo, hi)));
+      _mm_storeu_si128(d + 1, _mm_add_epi32(_mm_loadu_si128(d + 1), _mm_unpackhi_epi16(lo, hi)));
+    }
+  return i;
+}
+#endif /* HAVE_SSE2_INTRINSICS */
+
+/* Mix 'count' samples at a constant amplitude into interleaved stereo */
+static void mix_block_stereo(Sint32 *lp, const sample_t *sp,
+			     Sint32 left, Sint32 right, int count)
+{
+  int i = 0;
+#ifdef HAVE_NEON_INTRINSICS
+  if (mix_has_neon)
+    i = mix_stereo_neon(lp, sp, left, right, count);
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  if (mix_has_sse2)
+    i = mix_stereo_sse2(lp, sp, left, right, count);
+#endif
+  for (lp += 2*i; i < count; i++)
+    {
+      sample_t s = sp[i];
+      MIXATION(left);
+      MIXATION(right);
+    }
+}
+
+/* The same for mono output */
+static void mix_block_mono(Sint32 *lp, const sample_t *sp, Sint32 amp, int count)
+{
+  int i = 0;
+#ifdef HAVE_NEON_INTRINSICS
+  if (mix_has_neon)
+    i = mix_mono_neon(lp, sp, amp, count);
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  if (mix_has_sse2)
+    i = mix_mono_sse2(lp, sp, amp, count);
+#endif
+  for (lp += i; i < count; i++)
+    {
+      sample_t s = sp[i];
+      MIXATION(amp);
+    }
+}
+
 static void mix_mystery_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
 			       int count)
 {
   Voice *vp = song->voice + v;
-  final_volume_t 
-    left=vp->left_mix, 
-    right=vp->right_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
       cc = song->control_ratio;
       if (update_signal(song, v))
 	return;	/* Envelope ran out */
-      left = vp->left_mix;
-      right = vp->right_mix;
     }
   
   while (count)
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(right);
-	  }
+	mix_block_stereo(lp, sp, vp->left_mix, vp->right_mix, cc);
+	lp += 2*cc;
+	sp += cc;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
-	left = vp->left_mix;
-	right = vp->right_mix;
       }
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(right);
-	  }
+	mix_block_stereo(lp, sp, vp->left_mix, vp->right_mix, count);
 	return;
       }
 }
@@ -228,88 +349,66 @@ static void mix_center_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
 			      int count)
 {
   Voice *vp = song->voice + v;
-  final_volume_t 
-    left=vp->left_mix;
   int cc;
-  sample_t s;
 
   if (!(cc = vp->control_counter))
     {
       cc = song->control_ratio;
       if (update_signal(song, v))
 	return;	/* Envelope ran out */
-      left = vp->left_mix;
     }
   
   while (count)
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(left);
-	  }
+	mix_block_stereo(lp, sp, vp->left_mix, vp->left_mix, cc);
+	lp += 2*cc;
+	sp += cc;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
-	left = vp->left_mix;
       }
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    MIXATION(left);
-	  }
+	mix_block_stereo(lp, sp, vp->left_mix, vp->left_mix, count);
 	return;
       }
 }
 
+/* Full left or full right: every other output sample gets a zero gain */
+#define SINGLE_LEFT(vp)		((vp)->panned == PANNED_RIGHT ? 0 : (vp)->left_mix)
+#define SINGLE_RIGHT(vp)	((vp)->panned == PANNED_RIGHT ? (vp)->left_mix : 0)
+
 static void mix_single_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
 			      int count)
 {
   Voice *vp = song->voice + v;
-  final_volume_t 
-    left=vp->left_mix;
   int cc;
-  sample_t s;
   
   if (!(cc = vp->control_counter))
     {
       cc = song->control_ratio;
       if (update_signal(song, v))
 	return;	/* Envelope ran out */
-      left = vp->left_mix;
     }
   
   while (count)
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    lp++;
-	  }
+	mix_block_stereo(lp, sp, SINGLE_LEFT(vp), SINGLE_RIGHT(vp), cc);
+	lp += 2*cc;
+	sp += cc;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
-	left = vp->left_mix;
       }
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	    lp++;
-	  }
+	mix_block_stereo(lp, sp, SINGLE_LEFT(vp), SINGLE_RIGHT(vp), count);
 	return;
       }
 }
@@ -318,99 +417,56 @@ static void mix_mono_signal(MidiSong *song, sample_t *sp, Sint32 *lp, int v,
 			    int count)
 {
   Voice *vp = song->voice + v;
-  final_volume_t 
-    left=vp->left_mix;
   int cc;
-  sample_t s;
   
   if (!(cc = vp->control_counter))
     {
       cc = song->control_ratio;
       if (update_signal(song, v))
 	return;	/* Envelope ran out */
-      left = vp->left_mix;
     }
   
   while (count)
     if (cc < count)
       {
 	count -= cc;
-	while (cc--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	  }
+	mix_block_mono(lp, sp, vp->left_mix, cc);
+	lp += cc;
+	sp += cc;
 	cc = song->control_ratio;
 	if (update_signal(song, v))
 	  return;	/* Envelope ran out */
-	left = vp->left_mix;
       }
     else
       {
 	vp->control_counter = cc - count;
-	while (count--)
-	  {
-	    s = *sp++;
-	    MIXATION(left);
-	  }
+	mix_block_mono(lp, sp, vp->left_mix, count);
 	return;
       }
 }
 
 static void mix_mystery(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix, 
-    right = song->voice[v].right_mix;
-  sample_t s;
-  
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      MIXATION(right);
-    }
+  Voice *vp = song->voice + v;
+  mix_block_stereo(lp, sp, vp->left_mix, vp->right_mix, count);
 }
 
 static void mix_center(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-  
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      MIXATION(left);
-    }
+  Voice *vp = song->voice + v;
+  mix_block_stereo(lp, sp, vp->left_mix, vp->left_mix, count);
 }
 
 static void mix_single(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-  
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-      lp++;
-    }
+  Voice *vp = song->voice + v;
+  mix_block_stereo(lp, sp, SINGLE_LEFT(vp), SINGLE_RIGHT(vp), count);
 }
 
 static void mix_mono(MidiSong *song, sample_t *sp, Sint32 *lp, int v, int count)
 {
-  final_volume_t 
-    left = song->voice[v].left_mix;
-  sample_t s;
-  
-  while (count--)
-    {
-      s = *sp++;
-      MIXATION(left);
-    }
+  Voice *vp = song->voice + v;
+  mix_block_mono(lp, sp, vp->left_mix, count);
 }
 
 /* Ramp a note out in c samples */
@@ -501,7 +557,8 @@ static void ramp_out(MidiSong *song, sample_t *sp, Sint32 *lp, int v, Sint32 c)
 
 /**************** interface function ******************/
 
-void mix_voice(MidiSong *song, Sint32 *buf, int v, Sint32 c)
+void mix_voice(MidiSong *song, Sint32 *buf, sample_t *resample_buffer,
+	       int v, Sint32 c)
 {
   Voice *vp = song->voice + v;
   sample_t *sp;
@@ -509,14 +566,14 @@ void mix_voice(MidiSong *song, Sint32 *buf, int v, Sint32 c)
     {
       if (c>=MAX_DIE_TIME)
 	c=MAX_DIE_TIME;
-      sp=resample_voice(song, v, &c);
+      sp=resample_voice(song, v, &c, resample_buffer);
       if(c > 0)
 	ramp_out(song, sp, buf, v, c);
       vp->status=VOICE_FREE;
     }
   else
     {
-      sp=resample_voice(song, v, &c);
+      sp=resample_voice(song, v, &c, resample_buffer);
       if (song->encoding & PE_MONO)
 	{
 	  /* Mono output. */
@@ -543,10 +600,8 @@ void mix_voice(MidiSong *song, Sint32 *buf, int v, Sint32 c)
 	    }
 	  else
 	    { 
-	      /* It's either full left or full right. In either case,
-		 every other sample is 0. Just get the offset right: */
-	      if (vp->panned == PANNED_RIGHT) buf++;
-	      
+	      /* It's either full left or full right, mix_single*()
+		 pick the side from vp->panned. */
 	      if (vp->envelope_increment || vp->tremolo_phase_increment)
 		mix_single_signal(song, sp, buf, v, c);
 	      else 
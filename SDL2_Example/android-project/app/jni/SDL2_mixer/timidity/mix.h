@@ -10,6 +10,10 @@
 
 */
 
-extern void mix_voice(MidiSong *song, Sint32 *buf, int v, Sint32 c);
+extern void init_mix(void);
+/* Touches only the voice itself, so voices can be mixed on separate
+   threads into separate buffers */
+extern void mix_voice(MidiSong *song, Sint32 *buf, sample_t *resample_buffer,
+		      int v, Sint32 c);
 extern int recompute_envelope(MidiSong *song, int v);
 extern void apply_envelope_to_amp(MidiSong *song, int v);
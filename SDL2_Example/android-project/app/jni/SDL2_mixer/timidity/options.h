@@ -38,6 +38,12 @@
    option to toggle this as well. */
 #define FAST_DECAY
 
+/* Released notes whose volume falls below this (out of MAX_AMP_VALUE)
+   are ramped out right away rather than mixed to the end of their
+   decay. 4 is about 66 dB down and saves mixing the long, inaudible
+   tails of piano and string patches. 0 turns it off. */
+#define CULL_AMP_VALUE 4
+
 /* How many bits to use for the fractional part of sample positions.
    This affects tonal accuracy. The entire position counter must fit
    in 32 bits, so with FRACTION_BITS equal to 12, the maximum size of
@@ -20,6 +20,65 @@
 #include "options.h"
 #include "output.h"
 
+/* See mix.c, the same goes for the 16-bit and float converters here */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
+static SDL_bool output_has_neon = SDL_FALSE;
+static SDL_bool output_has_sse2 = SDL_FALSE;
+
+void init_output(void)
+{
+#ifdef HAVE_NEON_INTRINSICS
+  output_has_neon = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  output_has_sse2 = SDL_HasSSE2();
+#endif
+}
+
+/* The mixed data has GUARD_BITS of headroom above the full output range */
+#define FULL_SCALE (1 << (32-1-GUARD_BITS))
+
+/* Shift down to 16 bits with saturation, then XOR with 'flip' (0x8000
+   for unsigned output). Returns how many were converted, the callers do
+   the rest. */
+static Sint32 s32tos16_simd(Sint16 *sp, const Sint32 *lp, Sint32 c, Uint16 flip)
+{
+  Sint32 i = 0;
+#ifdef HAVE_NEON_INTRINSICS
+  if (output_has_neon)
+    {
+      const int16x8_t f = vdupq_n_s16((Sint16)flip);
+      for (; i + 8 <= c; i += 8)
+	{
+	  int16x8_t v = vcombine_s16(vqshrn_n_s32(vld1q_s32(lp + i), 32-16-GUARD_BITS),
+				     vqshrn_n_s32(vld1q_s32(lp + i + 4), 32-16-GUARD_BITS));
+	  vst1q_s16(sp + i, veorq_s16(v, f));
+	}
+    }
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  if (output_has_sse2)
+    {
+      const __m128i f = _mm_set1_epi16((short)flip);
+      for (; i + 8 <= c; i += 8)
+	{
+	  __m128i lo = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(lp + i)), 32-16-GUARD_BITS);
+	  __m128i hi = _mm_srai_epi32(_mm_loadu_si128((const __m128i *)(lp + i + 4)), 32-16-GUARD_BITS);
+	  _mm_storeu_si128((__m128i *)(sp + i), _mm_xor_si128(_mm_packs_epi32(lo, hi), f));
+	}
+    }
+#endif
+  return i;
+}
+
 /*****************************************************************/
 /* Some functions to convert signed 32-bit data to other formats */
 
@@ -52,7 +111,8 @@ void s32tou8(void *dp, Sint32 *lp, Sint32 c)
 void s32tos16(void *dp, Sint32 *lp, Sint32 c)
 {
   Sint16 *sp=(Sint16 *)(dp);
-  Sint32 l;
+  Sint32 l, i=s32tos16_simd(sp, lp, c, 0);
+  sp += i; lp += i; c -= i;
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -65,7 +125,8 @@ void s32tos16(void *dp, Sint32 *lp, Sint32 c)
 void s32tou16(void *dp, Sint32 *lp, Sint32 c)
 {
   Uint16 *sp=(Uint16 *)(dp);
-  Sint32 l;
+  Sint32 l, i=s32tos16_simd((Sint16 *)sp, lp, c, 0x8000);
+  sp += i; lp += i; c -= i;
   while (c--)
     {
       l=(*lp++)>>(32-16-GUARD_BITS);
@@ -101,13 +162,33 @@ void s32tou16x(void *dp, Sint32 *lp, Sint32 c)
     }
 }
 
+/* Scaled to the same level as the integer formats, the float is left
+   unclamped for the mixer to deal with */
 void s32tof32(void *dp, Sint32 *lp, Sint32 c)
 {
   float *sp=(float *)(dp);
-  while (c--)
-    {
-      *sp++ = (float)(*lp++) / 2147483647.0f;
-    }
+  const float scale = 1.0f / FULL_SCALE;
+  Sint32 i = 0;
+#ifdef HAVE_NEON_INTRINSICS
+  if (output_has_neon)
+    for (; i + 4 <= c; i += 4)
+      vst1q_f32(sp + i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(lp + i)), scale));
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  if (output_has_sse2)
+    for (; i + 4 <= c; i += 4)
+      _mm_storeu_ps(sp + i, _mm_mul_ps(_mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(lp + i))),
+				       _mm_set1_ps(scale)));
+#endif
+  for (; i < c; i++)
+    sp[i] = (float)lp[i] * scale;
+}
+
+static Sint32 s32tos32_one(Sint32 l)
+{
+  if (l >= FULL_SCALE) l=FULL_SCALE-1;
+  else if (l < -FULL_SCALE) l=-FULL_SCALE;
+  return (Sint32)((Uint32)l << GUARD_BITS);
 }
 
 void s32tos32(void *dp, Sint32 *lp, Sint32 c)
@@ -115,7 +196,7 @@ void s32tos32(void *dp, Sint32 *lp, Sint32 c)
   Sint32 *sp=(Sint32 *)(dp);
   while (c--)
     {
-      *sp++ = (*lp++);
+      *sp++ = s32tos32_one(*lp++);
     }
 }
 
@@ -124,6 +205,6 @@ void s32tos32x(void *dp, Sint32 *lp, Sint32 c)
   Sint32 *sp=(Sint32 *)(dp);
   while (c--)
     {
-      *sp++ = SDL_Swap32(*lp++);
+      *sp++ = SDL_Swap32(s32tos32_one(*lp++));
     }
 }
@@ -20,6 +20,8 @@
 /* Conversion functions -- These overwrite the Sint32 data in *lp with
    data in another format */
 
+extern void init_output(void); /* picks the SIMD versions, if any */
+
 /* 8-bit signed and unsigned*/
 extern void s32tos8(void *dp, Sint32 *lp, Sint32 c);
 extern void s32tou8(void *dp, Sint32 *lp, Sint32 c);
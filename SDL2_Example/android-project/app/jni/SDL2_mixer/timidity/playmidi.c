@@ -22,6 +22,7 @@
 
 #include "timidity.h"
 #include "options.h"
+#include "common.h"
 #include "instrum.h"
 #include "playmidi.h"
 #include "output.h"
@@ -318,6 +319,16 @@ static void kill_note(MidiSong *song, int i)
   song->voice[i].status = VOICE_DIE;
 }
 
+/* The louder side of a voice, out of MAX_AMP_VALUE */
+static Sint32 voice_amplitude(MidiSong *song, int i)
+{
+  Sint32 v = song->voice[i].left_mix;
+  if ((song->voice[i].panned == PANNED_MYSTERY)
+      && (song->voice[i].right_mix > v))
+    v = song->voice[i].right_mix;
+  return v;
+}
+
 /* Only one instance of a note can be playing on a single channel. */
 static void note_on(MidiSong *song)
 {
@@ -348,10 +359,7 @@ static void note_on(MidiSong *song)
       if ((song->voice[i].status != VOICE_ON) &&
 	  (song->voice[i].status != VOICE_DIE))
 	{
-	  v = song->voice[i].left_mix;
-	  if ((song->voice[i].panned == PANNED_MYSTERY)
-	      && (song->voice[i].right_mix > v))
-	    v = song->voice[i].right_mix;
+	  v = voice_amplitude(song, i);
 	  if (v<lv)
 	    {
 	      lv=v;
@@ -500,67 +508,119 @@ static void adjust_volume(MidiSong *song)
       }
 }
 
+/* Seeks start from the last of these before the target.  It's the
+   channel state that has to be replayed, the event times are in samples
+   already so tempo changes don't. */
+#define SEEK_CHECKPOINT_SECONDS 5
+
+/* Apply the parameter changes of an event passed over while seeking,
+   0 at the end of the song */
+static int seek_event(MidiSong *song, MidiEvent *e)
+{
+  switch(e->type)
+    {
+      /* All notes stay off. Just handle the parameter changes. */
+
+    case ME_PITCH_SENS:
+      song->channel[e->channel].pitchsens = e->a;
+      song->channel[e->channel].pitchfactor = 0;
+      break;
+
+    case ME_PITCHWHEEL:
+      song->channel[e->channel].pitchbend = e->a + e->b * 128;
+      song->channel[e->channel].pitchfactor = 0;
+      break;
+
+    case ME_MAINVOLUME:
+      song->channel[e->channel].volume = e->a;
+      break;
+
+    case ME_PAN:
+      song->channel[e->channel].panning = e->a;
+      break;
+
+    case ME_EXPRESSION:
+      song->channel[e->channel].expression = e->a;
+      break;
+
+    case ME_PROGRAM:
+      if (ISDRUMCHANNEL(song, e->channel))
+        /* Change drum set */
+        song->channel[e->channel].bank = e->a;
+      else
+        song->channel[e->channel].program = e->a;
+      break;
+
+    case ME_SUSTAIN:
+      song->channel[e->channel].sustain = e->a;
+      break;
+
+    case ME_RESET_CONTROLLERS:
+      reset_controllers(song, e->channel);
+      break;
+
+    case ME_TONE_BANK:
+      song->channel[e->channel].bank = e->a;
+      break;
+
+    case ME_EOT:
+      return 0;
+    }
+  return 1;
+}
+
+/* Replay the parameter changes of the whole song once, keeping the
+   channels every SEEK_CHECKPOINT_SECONDS.  Called right after reset_midi(),
+   and leaves the channels as they were. */
+static void build_checkpoints(MidiSong *song)
+{
+  Sint32 interval = song->rate * SEEK_CHECKPOINT_SECONDS;
+  Sint32 length = song->events[song->groomed_event_count - 1].time;
+  int count = length / interval + 1, n = 0;
+  Channel saved[MAXCHAN];
+  MidiEvent *e;
+
+  song->checkpoints = safe_malloc(count * sizeof(SeekCheckpoint));
+  if (!song->checkpoints)
+    return;
+  memcpy(saved, song->channel, sizeof(saved));
+  for (e = song->events; ; e++)
+    {
+      while (n < count && e->time >= n * interval)
+	{
+	  song->checkpoints[n].event = (Sint32)(e - song->events);
+	  memcpy(song->checkpoints[n].channel, song->channel, sizeof(song->channel));
+	  n++;
+	}
+      if (!seek_event(song, e))
+	break;
+    }
+  song->checkpoint_count = n;
+  memcpy(song->channel, saved, sizeof(saved));
+}
+
 static void seek_forward(MidiSong *song, Sint32 until_time)
 {
+  Sint32 interval = song->rate * SEEK_CHECKPOINT_SECONDS;
+  int k;
+
   reset_voices(song);
+  if (interval > 0 && until_time >= interval)
+    {
+      /* Everything before the checkpoint is before until_time too */
+      if (!song->checkpoints)
+	build_checkpoints(song);
+      k = SDL_min(until_time / interval, song->checkpoint_count - 1);
+      if (k > 0)
+	{
+	  memcpy(song->channel, song->checkpoints[k].channel, sizeof(song->channel));
+	  song->current_event = song->events + song->checkpoints[k].event;
+	}
+    }
   while (song->current_event->time < until_time)
     {
-      switch(song->current_event->type)
+      if (!seek_event(song, song->current_event))
 	{
-	  /* All notes stay off. Just handle the parameter changes. */
-
-	case ME_PITCH_SENS:
-	  song->channel[song->current_event->channel].pitchsens =
-	    song->current_event->a;
-	  song->channel[song->current_event->channel].pitchfactor = 0;
-	  break;
-	  
-	case ME_PITCHWHEEL:
-	  song->channel[song->current_event->channel].pitchbend =
-	    song->current_event->a + song->current_event->b * 128;
-	  song->channel[song->current_event->channel].pitchfactor = 0;
-	  break;
-	  
-	case ME_MAINVOLUME:
-	  song->channel[song->current_event->channel].volume =
-	    song->current_event->a;
-	  break;
-	  
-	case ME_PAN:
-	  song->channel[song->current_event->channel].panning =
-	    song->current_event->a;
-	  break;
-	      
-	case ME_EXPRESSION:
-	  song->channel[song->current_event->channel].expression =
-	    song->current_event->a;
-	  break;
-	  
-	case ME_PROGRAM:
-	  if (ISDRUMCHANNEL(song, song->current_event->channel))
-	    /* Change drum set */
-	    song->channel[song->current_event->channel].bank =
-	      song->current_event->a;
-	  else
-	    song->channel[song->current_event->channel].program =
-	      song->current_event->a;
-	  break;
-
-	case ME_SUSTAIN:
-	  song->channel[song->current_event->channel].sustain =
-	    song->current_event->a;
-	  break;
-
-	case ME_RESET_CONTROLLERS:
-	  reset_controllers(song, song->current_event->channel);
-	  break;
-	      
-	case ME_TONE_BANK:
-	  song->channel[song->current_event->channel].bank =
-	    song->current_event->a;
-	  break;
-	  
-	case ME_EOT:
 	  song->current_sample = song->current_event->time;
 	  return;
 	}
@@ -586,6 +646,223 @@ static void skip_to(MidiSong *song, Sint32 until_time)
     seek_forward(song, until_time);
 }
 
+/* Voices mixed on other threads, each into its own buffers.  The calling
+   thread takes every (num_voice_workers + 1)th sounding voice starting
+   with the first, worker w those starting with w + 1, and the workers'
+   buffers are added in afterwards.  The mix is integer, so the sum comes
+   out the same as mixing the voices one after the other. */
+typedef struct {
+  SDL_Thread *thread;
+  SDL_sem *go;
+  Sint32 *buffer;
+  sample_t *resample_buffer;
+  Sint32 size; /* samples per channel both have room for */
+  int first;
+} VoiceWorker;
+
+static VoiceWorker voice_workers[MAX_VOICE_THREADS];
+static int num_voice_workers = 0;
+static int voice_threads_wanted = 0;
+static int voice_threads_min_voices = 1;
+static SDL_bool voice_workers_quit = SDL_FALSE;
+static SDL_sem *voice_workers_done = NULL;
+/* Held while the workers mix a buffer or are started or stopped.  A
+   second song rendering at the same time mixes on its own thread.  It's
+   a mutex, as the thread mixing a buffer waits for the workers with it
+   held. */
+static SDL_mutex *voice_workers_lock = NULL;
+
+/* The buffer being mixed */
+static MidiSong *job_song;
+static Sint32 job_count;
+static int job_voices[MAX_VOICES];
+static int num_job_voices;
+
+static int SDLCALL voice_worker_thread(void *data)
+{
+  VoiceWorker *worker = (VoiceWorker *) data;
+  int j, stride;
+
+  for (;;)
+    {
+      SDL_SemWait(worker->go);
+      if (voice_workers_quit)
+	break;
+      stride = num_voice_workers + 1;
+      memset(worker->buffer, 0,
+	     (job_song->encoding & PE_MONO) ? (job_count * 4) : (job_count * 8));
+      for (j = worker->first; j < num_job_voices; j += stride)
+	mix_voice(job_song, worker->buffer, worker->resample_buffer,
+		  job_voices[j], job_count);
+      SDL_SemPost(voice_workers_done);
+    }
+  return 0;
+}
+
+/* With voice_workers_lock held */
+static void stop_workers(void)
+{
+  int w;
+
+  voice_workers_quit = SDL_TRUE;
+  for (w = 0; w < num_voice_workers; w++)
+    SDL_SemPost(voice_workers[w].go);
+  for (w = 0; w < num_voice_workers; w++)
+    {
+      SDL_WaitThread(voice_workers[w].thread, NULL);
+      SDL_DestroySemaphore(voice_workers[w].go);
+      free(voice_workers[w].buffer);
+      free(voice_workers[w].resample_buffer);
+    }
+  num_voice_workers = 0;
+  voice_workers_quit = SDL_FALSE;
+  if (voice_workers_done)
+    {
+      SDL_DestroySemaphore(voice_workers_done);
+      voice_workers_done = NULL;
+    }
+}
+
+/* With voice_workers_lock held.  The buffers come with the first song
+   that needs them. */
+static int start_workers(void)
+{
+  VoiceWorker *worker;
+
+  if (num_voice_workers > 0 || voice_threads_wanted == 0)
+    return 0;
+  if (!(voice_workers_done = SDL_CreateSemaphore(0)))
+    return -1;
+  while (num_voice_workers < voice_threads_wanted)
+    {
+      worker = &voice_workers[num_voice_workers];
+      memset(worker, 0, sizeof(*worker));
+      worker->first = num_voice_workers + 1;
+      if ((worker->go = SDL_CreateSemaphore(0)) != NULL)
+	worker->thread = SDL_CreateThread(voice_worker_thread, "TiMidity voices", worker);
+      if (!worker->thread)
+	{
+	  SNDDBG(("Couldn't start a voice thread: %s\n", SDL_GetError()));
+	  if (worker->go)
+	    SDL_DestroySemaphore(worker->go);
+	  stop_workers();
+	  return -1;
+	}
+      num_voice_workers++;
+    }
+  return 0;
+}
+
+/* Take voice_workers_lock, made the first time it's needed */
+static int lock_workers(void)
+{
+  if (!voice_workers_lock && !(voice_workers_lock = SDL_CreateMutex()))
+    return -1;
+  SDL_LockMutex(voice_workers_lock);
+  return 0;
+}
+
+void start_voice_workers(void)
+{
+  if (lock_workers() < 0)
+    return;
+  start_workers();
+  SDL_UnlockMutex(voice_workers_lock);
+}
+
+void stop_voice_workers(void)
+{
+  if (!voice_workers_lock)
+    return;
+  SDL_LockMutex(voice_workers_lock);
+  stop_workers();
+  SDL_UnlockMutex(voice_workers_lock);
+  SDL_DestroyMutex(voice_workers_lock);
+  voice_workers_lock = NULL;
+}
+
+int Timidity_SetThreads(int threads, int min_voices)
+{
+  int retval;
+
+  if (threads < 0 || threads > MAX_VOICE_THREADS)
+    return -1;
+
+  if (lock_workers() < 0)
+    return -1;
+  stop_workers();
+  voice_threads_wanted = threads;
+  voice_threads_min_voices = (min_voices > 1) ? min_voices : 1;
+  retval = start_workers();
+  SDL_UnlockMutex(voice_workers_lock);
+  return retval;
+}
+
+/* Mix the sounding voices with the workers' help, 0 if they're busy or
+   there are too few voices to be worth it */
+static int mix_voices_threaded(MidiSong *song, Sint32 count)
+{
+  int i, j, w, channels, stride;
+  VoiceWorker *worker;
+  Sint32 *lp, *wp;
+
+  if (!voice_workers_lock || SDL_TryLockMutex(voice_workers_lock) != 0)
+    return 0;
+  if (num_voice_workers == 0)
+    {
+      SDL_UnlockMutex(voice_workers_lock);
+      return 0;
+    }
+
+  num_job_voices = 0;
+  for (i = 0; i < song->voices; i++)
+    if (song->voice[i].status != VOICE_FREE)
+      job_voices[num_job_voices++] = i;
+  if (num_job_voices < voice_threads_min_voices || num_job_voices < 2)
+    {
+      SDL_UnlockMutex(voice_workers_lock);
+      return 0;
+    }
+
+  channels = (song->encoding & PE_MONO) ? 1 : 2;
+  for (w = 0; w < num_voice_workers; w++)
+    {
+      worker = &voice_workers[w];
+      if (worker->size >= song->buffer_size)
+	continue;
+      free(worker->buffer);
+      free(worker->resample_buffer);
+      worker->buffer = safe_malloc(song->buffer_size * 2 * sizeof(Sint32));
+      worker->resample_buffer = safe_malloc(song->buffer_size * sizeof(sample_t));
+      worker->size = (worker->buffer && worker->resample_buffer) ? song->buffer_size : 0;
+      if (worker->size == 0)
+	{
+	  SDL_UnlockMutex(voice_workers_lock);
+	  return 0;
+	}
+    }
+
+  job_song = song;
+  job_count = count;
+  for (w = 0; w < num_voice_workers; w++)
+    SDL_SemPost(voice_workers[w].go);
+  stride = num_voice_workers + 1;
+  for (j = 0; j < num_job_voices; j += stride)
+    mix_voice(song, song->buffer_pointer, song->resample_buffer, job_voices[j], count);
+  for (w = 0; w < num_voice_workers; w++)
+    SDL_SemWait(voice_workers_done);
+
+  for (w = 0; w < num_voice_workers; w++)
+    {
+      lp = song->buffer_pointer;
+      wp = voice_workers[w].buffer;
+      for (i = count * channels; i > 0; i--)
+	*lp++ += *wp++;
+    }
+  SDL_UnlockMutex(voice_workers_lock);
+  return 1;
+}
+
 static void do_compute_data(MidiSong *song, Sint32 count)
 {
   int i;
@@ -593,8 +870,15 @@ static void do_compute_data(MidiSong *song, Sint32 count)
 	 (song->encoding & PE_MONO) ? (count * 4) : (count * 8));
   for (i = 0; i < song->voices; i++)
     {
-      if(song->voice[i].status != VOICE_FREE)
-	mix_voice(song, song->buffer_pointer, i, count);
+      if (song->voice[i].status == VOICE_OFF &&
+	  voice_amplitude(song, i) < CULL_AMP_VALUE)
+	kill_note(song, i); /* Released and inaudible, just ramp it out */
+    }
+  if (!mix_voices_threaded(song, count))
+    {
+      for (i = 0; i < song->voices; i++)
+	if(song->voice[i].status != VOICE_FREE)
+	  mix_voice(song, song->buffer_pointer, song->resample_buffer, i, count);
     }
   song->current_sample += count;
 }
@@ -656,6 +940,13 @@ Uint32 Timidity_GetSongLength(MidiSong *song)
   return retvalue;
 }
 
+Uint32 Timidity_GetSongTime(MidiSong *song)
+{
+  Uint32 retvalue = (song->current_sample / song->rate) * 1000;
+  retvalue       += (song->current_sample % song->rate) * 1000 / song->rate;
+  return retvalue;
+}
+
 int Timidity_PlaySome(MidiSong *song, void *stream, Sint32 len)
 {
   Sint32 start_sample, end_sample, samples;
@@ -798,3 +1089,30 @@ void Timidity_SetVolume(MidiSong *song, int volume)
         apply_envelope_to_amp(song, i);
       }
 }
+
+void Timidity_SetMaxVoices(MidiSong *song, int voices)
+{
+  int i;
+  if (voices <= 0)
+    voices = DEFAULT_VOICES;
+  else
+  if (voices > MAX_VOICES)
+    voices = MAX_VOICES;
+
+  /* Voices past the new limit are no longer mixed, so drop them now */
+  for (i = voices; i < song->voices; i++)
+    if (song->voice[i].status != VOICE_FREE)
+      {
+	song->voice[i].status = VOICE_FREE;
+	song->cut_notes++;
+      }
+  song->voices = voices;
+}
+
+void Timidity_SetResampleMode(MidiSong *song, int mode)
+{
+  if (mode == RESAMPLE_NEAREST || mode == RESAMPLE_CUBIC)
+    song->resample_mode = mode;
+  else
+    song->resample_mode = RESAMPLE_LINEAR;
+}
@@ -51,3 +51,7 @@
 /* Anything but PANNED_MYSTERY only uses the left volume */
 
 #define ISDRUMCHANNEL(s, c) (((s)->drumchannels & (1<<(c))))
+
+/* Start the threads Timidity_SetThreads() asked for, and stop them */
+extern void start_voice_workers(void);
+extern void stop_voice_workers(void);
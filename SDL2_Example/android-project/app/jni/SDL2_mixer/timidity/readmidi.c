@@ -73,8 +73,23 @@ static int dumpstring(SDL_RWops *rw, Sint32 len, char *label)
   return 0;
 }
 
+/* Hand out an event for the linked list from the song's event blocks */
+static MidiEventList *new_midi_event(MidiSong *song)
+{
+  MidiEventBlock *block = song->evblocks;
+  if (!block || block->used == MIDI_EVENT_BLOCK)
+    {
+      if (!(block = safe_malloc(sizeof(MidiEventBlock))))
+	return 0;
+      block->next = song->evblocks;
+      block->used = 0;
+      song->evblocks = block;
+    }
+  return &block->events[block->used++];
+}
+
 #define MIDIEVENT(at,t,ch,pa,pb) \
-  new=safe_malloc(sizeof(MidiEventList)); \
+  if (!(new=new_midi_event(song))) return 0; \
   new->event.time=at; new->event.type=t; new->event.channel=ch; \
   new->event.a=pa; new->event.b=pb; new->next=0;\
   return new;
@@ -326,17 +341,32 @@ static int read_track(MidiSong *song, int append)
 /* Free the linked event list from memory. */
 static void free_midi_list(MidiSong *song)
 {
-  MidiEventList *meep, *next;
-  if (!(meep = song->evlist)) return;
-  while (meep)
+  MidiEventBlock *block, *next;
+  for (block = song->evblocks; block; block = next)
     {
-      next=meep->next;
-      free(meep);
-      meep=next;
+      next = block->next;
+      free(block);
     }
+  song->evblocks=0;
   song->evlist=0;
 }
 
+/* Mark the instrument a note will play for loading */
+static void mark_instrument(MidiSong *song, int channel, int note,
+			    int bank, int set, int program)
+{
+  if (ISDRUMCHANNEL(song, channel))
+    {
+      if (!(song->drumset[set]->instrument[note]))
+	song->drumset[set]->instrument[note] = MAGIC_LOAD_INSTRUMENT;
+    }
+  else if (program != SPECIAL_PROGRAM)
+    {
+      if (!(song->tonebank[bank]->instrument[program]))
+	song->tonebank[bank]->instrument[program] = MAGIC_LOAD_INSTRUMENT;
+    }
+}
+
 /* Allocate an array of MidiEvents and fill it from the linked list of
    events, marking used instruments for loading. Convert event times to
    samples: handle tempo changes. Strip unnecessary events from the list.
@@ -411,25 +441,10 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
 	case ME_NOTEON:
 	  if (counting_time)
 	    counting_time=1;
-	  if (ISDRUMCHANNEL(song, meep->event.channel))
-	    {
-	      /* Mark this instrument to be loaded */
-	      if (!(song->drumset[current_set[meep->event.channel]]
-		    ->instrument[meep->event.a]))
-		song->drumset[current_set[meep->event.channel]]
-		  ->instrument[meep->event.a] = MAGIC_LOAD_INSTRUMENT;
-	    }
-	  else
-	    {
-	      if (current_program[meep->event.channel]==SPECIAL_PROGRAM)
-		break;
-	      /* Mark this instrument to be loaded */
-	      if (!(song->tonebank[current_bank[meep->event.channel]]
-		    ->instrument[current_program[meep->event.channel]]))
-		song->tonebank[current_bank[meep->event.channel]]
-		  ->instrument[current_program[meep->event.channel]] =
-		    MAGIC_LOAD_INSTRUMENT;
-	    }
+	  mark_instrument(song, meep->event.channel, meep->event.a,
+			  current_bank[meep->event.channel],
+			  current_set[meep->event.channel],
+			  current_program[meep->event.channel]);
 	  break;
 
 	case ME_TONE_BANK:
@@ -485,6 +500,7 @@ static MidiEvent *groom_list(MidiSong *song, Sint32 divisions,Sint32 *eventsp,
   /* Add an End-of-Track event */
   lp->time=st;
   lp->type=ME_EOT;
+  lp->channel=lp->a=lp->b=0;
   our_event_count++;
   free_midi_list(song);
 
@@ -555,7 +571,8 @@ MidiEvent *read_midi_file(MidiSong *song, Sint32 *count, Sint32 *sp)
 	  format, tracks, divisions));
 
   /* Put a do-nothing event first in the list for easier processing */
-  song->evlist=safe_malloc(sizeof(MidiEventList));
+  if (!(song->evlist=new_midi_event(song)))
+    return 0;
   memset(song->evlist, 0, sizeof(MidiEventList));
   song->event_count++;
 
@@ -589,3 +606,126 @@ MidiEvent *read_midi_file(MidiSong *song, Sint32 *count, Sint32 *sp)
     }
   return groom_list(song, divisions, count, sp);
 }
+
+/* A groomed event list can be saved, and loaded back without parsing
+   the MIDI file again. The times are in samples, so the cache is only
+   good for the output rate it was made at. It is a 20 byte header:
+   "TMEV", the format version, the rate, the number of events and the
+   length in samples, then the events as they are in memory.
+   Everything is little-endian. */
+
+#define EVENT_CACHE_VERSION 1
+
+int write_event_cache(MidiSong *song, SDL_RWops *rw)
+{
+  Sint32 count = song->groomed_event_count;
+  MidiEvent *events = song->events;
+  int ok;
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  Sint32 i;
+  if (!(events = safe_malloc(count * sizeof(MidiEvent))))
+    return -1;
+  for (i = 0; i < count; i++)
+    {
+      events[i] = song->events[i];
+      events[i].time = SDL_SwapLE32(events[i].time);
+    }
+#endif
+
+  ok = (SDL_RWwrite(rw, "TMEV", 4, 1) == 1 &&
+	SDL_WriteLE32(rw, EVENT_CACHE_VERSION) &&
+	SDL_WriteLE32(rw, (Uint32) song->rate) &&
+	SDL_WriteLE32(rw, (Uint32) count) &&
+	SDL_WriteLE32(rw, (Uint32) song->samples) &&
+	SDL_RWwrite(rw, events, sizeof(MidiEvent), count) == (size_t) count);
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+  free(events);
+#endif
+  return ok ? 0 : -1;
+}
+
+MidiEvent *read_event_cache(MidiSong *song, Sint32 *count, Sint32 *sp)
+{
+  int current_bank[MAXCHAN], current_set[MAXCHAN], current_program[MAXCHAN];
+  MidiEvent *events, *ev;
+  Sint32 i, n, samples, time;
+  char tmp[4];
+
+  if (SDL_RWread(song->rw, tmp, 1, 4) != 4 || memcmp(tmp, "TMEV", 4) ||
+      SDL_ReadLE32(song->rw) != EVENT_CACHE_VERSION ||
+      SDL_ReadLE32(song->rw) != (Uint32) song->rate)
+    {
+      SNDDBG(("Not an event cache for this rate\n"));
+      return 0;
+    }
+  n = (Sint32) SDL_ReadLE32(song->rw);
+  samples = (Sint32) SDL_ReadLE32(song->rw);
+  if (n < 1 || n > 0x7FFFFFFF / (Sint32) sizeof(MidiEvent) || samples < 0)
+    return 0;
+
+  if (!(events = safe_malloc(n * sizeof(MidiEvent))))
+    return 0;
+  if (SDL_RWread(song->rw, events, sizeof(MidiEvent), n) != (size_t) n)
+    {
+      free(events);
+      return 0;
+    }
+
+  /* The file is trusted no further than a MIDI file would be: the
+     values index arrays of 128, and the times must run forward. */
+  for (i = 0; i < MAXCHAN; i++)
+    {
+      current_bank[i]=0;
+      current_set[i]=0;
+      current_program[i]=song->default_program;
+    }
+  time = 0;
+  for (i = 0, ev = events; i < n; i++, ev++)
+    {
+      ev->time = SDL_SwapLE32(ev->time);
+      if (ev->time < time || ev->time > samples ||
+	  ev->a > 0x7F || ev->b > 0x7F || ev->channel >= MAXCHAN ||
+	  (ev->type == ME_EOT) != (i == n - 1))
+	{
+	  SNDDBG(("Corrupt event cache\n"));
+	  free(events);
+	  return 0;
+	}
+      time = ev->time;
+
+      /* Redo what groom_list() did to mark the instruments, checking the
+	 banks again in case the configuration changed since */
+      switch (ev->type)
+	{
+	case ME_PROGRAM:
+	  if (ISDRUMCHANNEL(song, ev->channel))
+	    {
+	      if (!song->drumset[ev->a])
+		ev->a = 0;
+	      current_set[ev->channel] = ev->a;
+	    }
+	  else if (current_program[ev->channel] != SPECIAL_PROGRAM)
+	    current_program[ev->channel] = ev->a;
+	  break;
+
+	case ME_TONE_BANK:
+	  if (!song->tonebank[ev->a])
+	    ev->a = 0;
+	  current_bank[ev->channel] = ev->a;
+	  break;
+
+	case ME_NOTEON:
+	  mark_instrument(song, ev->channel, ev->a,
+			  current_bank[ev->channel],
+			  current_set[ev->channel],
+			  current_program[ev->channel]);
+	  break;
+	}
+    }
+
+  *count = n;
+  *sp = samples;
+  return events;
+}
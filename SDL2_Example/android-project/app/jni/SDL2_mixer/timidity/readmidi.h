@@ -11,3 +11,5 @@
    */
 
 extern MidiEvent *read_midi_file(MidiSong *song, Sint32 *count, Sint32 *sp);
+extern MidiEvent *read_event_cache(MidiSong *song, Sint32 *count, Sint32 *sp);
+extern int write_event_cache(MidiSong *song, SDL_RWops *rw);
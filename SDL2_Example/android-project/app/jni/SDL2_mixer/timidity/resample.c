@@ -27,27 +27,196 @@
 #include "tables.h"
 #include "resample.h"
 
+/* See mix.c, the same goes for the linear interpolation kernels here */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
+static SDL_bool resample_has_neon = SDL_FALSE;
+static SDL_bool resample_has_sse2 = SDL_FALSE;
+
+void init_resample(void)
+{
+#ifdef HAVE_NEON_INTRINSICS
+  resample_has_neon = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+  resample_has_sse2 = SDL_HasSSE2();
+#endif
+}
+
 #define PRECALC_LOOP_COUNT(start, end, incr) (((end) - (start) + (incr) - 1) / (incr))
 
+/* The two samples around 'ofs', packed the way a 16-bit lane pair sees them */
+#define SAMPLE_PAIR(src, ofs) \
+  ((Uint32)(Uint16)(src)[(ofs) >> FRACTION_BITS] | \
+   ((Uint32)(Uint16)(src)[((ofs) >> FRACTION_BITS) + 1] << 16))
+
+/* v1 + (((v2 - v1) * f) >> FRACTION_BITS) is the same as
+   (v1 * (ONE - f) + v2 * f) >> FRACTION_BITS, which is a single 16x16 bit
+   multiply-add per sample. Both weights fit in 16 bits. */
+#ifdef HAVE_SSE2_INTRINSICS
+static int resample_linear_sse2(sample_t *dest, const sample_t *src,
+				Sint32 ofs, Sint32 incr, int count)
+{
+  const __m128i one = _mm_set1_epi32(1 << FRACTION_BITS);
+  const __m128i mask = _mm_set1_epi32((int)FRACTION_MASK);
+  const __m128i step = _mm_set1_epi32(4 * incr);
+  __m128i o = _mm_setr_epi32(ofs, ofs + incr, ofs + 2*incr, ofs + 3*incr);
+  int i;
+  for (i = 0; i + 8 <= count; i += 8)
+    {
+      __m128i f, w, p, lo, hi;
+
+      f = _mm_and_si128(o, mask);
+      w = _mm_or_si128(_mm_slli_epi32(f, 16), _mm_sub_epi32(one, f));
+      p = _mm_setr_epi32((int)SAMPLE_PAIR(src, ofs), (int)SAMPLE_PAIR(src, ofs + incr),
+			 (int)SAMPLE_PAIR(src, ofs + 2*incr), (int)SAMPLE_PAIR(src, ofs + 3*incr));
+      lo = _mm_srai_epi32(_mm_madd_epi16(p, w), FRACTION_BITS);
+      o = _mm_add_epi32(o, step);
+      ofs += 4*incr;
+
+      f = _mm_and_si128(o, mask);
+      w = _mm_or_si128(_mm_slli_epi32(f, 16), _mm_sub_epi32(one, f));
+      p = _mm_setr_epi32((int)SAMPLE_PAIR(src, ofs), (int)SAMPLE_PAIR(src, ofs + incr),
+			 (int)SAMPLE_PAIR(src, ofs + 2*incr), (int)SAMPLE_PAIR(src, ofs + 3*incr));
+      hi = _mm_srai_epi32(_mm_madd_epi16(p, w), FRACTION_BITS);
+      o = _mm_add_epi32(o, step);
+      ofs += 4*incr;
+
+      _mm_storeu_si128((__m128i *)(dest + i), _mm_packs_epi32(lo, hi));
+    }
+  return i;
+}
+#endif /* HAVE_SSE2_INTRINSICS */
+
+#ifdef HAVE_NEON_INTRINSICS
+static int resample_linear_neon(sample_t *dest, const sample_t *src,
+				Sint32 ofs, Sint32 incr, int count)
+{
+  const int32x4_t mask = vdupq_n_s32((Sint32)FRACTION_MASK);
+  const int32x4_t step = vdupq_n_s32(4 * incr);
+  const int16x4_t one = vdup_n_s16(1 << FRACTION_BITS);
+  Sint32 start[4];
+  Uint32 pairs[4];
+  int32x4_t o;
+  int i;
+
+  start[0] = ofs;
+  start[1] = ofs + incr;
+  start[2] = ofs + 2*incr;
+  start[3] = ofs + 3*incr;
+  o = vld1q_s32(start);
+  for (i = 0; i + 4 <= count; i += 4)
+    {
+      int16x4_t f;
+      int16x4x2_t v;
+      int32x4_t acc;
+
+      pairs[0] = SAMPLE_PAIR(src, ofs);
+      pairs[1] = SAMPLE_PAIR(src, ofs + incr);
+      pairs[2] = SAMPLE_PAIR(src, ofs + 2*incr);
+      pairs[3] = SAMPLE_PAIR(src, ofs + 3*incr);
+      /* val[0] gets the first sample of each pair, val[1] the second */
+      v = vuzp_s16(vreinterpret_s16_u32(vld1_u32(pairs)),
+		   vreinterpret_s16_u32(vld1_u32(pairs + 2)));
+      f = vmovn_s32(vandq_s32(o, mask));
+      acc = vmull_s16(v.val[0], vsub_s16(one, f));
+      acc = vmlal_s16(acc, v.val[1], f);
+      vst1_s16(dest + i, vshrn_n_s32(acc, FRACTION_BITS));
+      o = vaddq_s32(o, step);
+      ofs += 4*incr;
+    }
+  return i;
+}
+#endif /* HAVE_NEON_INTRINSICS */
+
+/* Interpolate 'count' samples from 'src', starting at *ofsp and stepping
+   by 'incr', with the song's resampling mode. */
+static sample_t *resample_run(MidiSong *song, sample_t *dest, const sample_t *src,
+			      Sint32 *ofsp, Sint32 incr, Sint32 count)
+{
+  Sint32 ofs = *ofsp, i = 0;
+  Sint32 v1, v2, v3, v4;
+  float t, v;
+
+  switch (song->resample_mode)
+    {
+    case RESAMPLE_NEAREST:
+      for (; i < count; i++)
+	{
+	  dest[i] = src[ofs >> FRACTION_BITS];
+	  ofs += incr;
+	}
+      break;
+
+    case RESAMPLE_CUBIC:
+      /* Catmull-Rom. The loaded data always has two more samples after
+	 its end, but nothing before its start. */
+      for (; i < count; i++)
+	{
+	  const sample_t *vptr = src + (ofs >> FRACTION_BITS);
+	  v1 = (vptr > src) ? vptr[-1] : vptr[0];
+	  v2 = vptr[0];
+	  v3 = vptr[1];
+	  v4 = vptr[2];
+	  t = (ofs & FRACTION_MASK) * (1.0f / (1 << FRACTION_BITS));
+	  v = v2 + 0.5f * t * ((v3 - v1) +
+			       t * ((2*v1 - 5*v2 + 4*v3 - v4) +
+				    t * (3*(v2 - v3) + v4 - v1)));
+	  dest[i] = (sample_t)((v > 32767) ? 32767 : ((v < -32768) ? -32768 : v));
+	  ofs += incr;
+	}
+      break;
+
+    default:
+#ifdef HAVE_NEON_INTRINSICS
+      if (resample_has_neon)
+	i = resample_linear_neon(dest, src, ofs, incr, count);
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+      if (resample_has_sse2)
+	i = resample_linear_sse2(dest, src, ofs, incr, count);
+#endif
+      ofs += i * incr;
+      for (; i < count; i++)
+	{
+	  v1 = src[ofs >> FRACTION_BITS];
+	  v2 = src[(ofs >> FRACTION_BITS)+1];
+	  dest[i] = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
+	  ofs += incr;
+	}
+      break;
+    }
+
+  *ofsp = ofs;
+  return dest + count;
+}
+
 /*************** resampling with fixed increment *****************/
 
-static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
+static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr,
+			  sample_t *buffer)
 {
 
   /* Play sample until end, then free the voice. */
 
-  sample_t v1, v2;
   Voice 
     *vp=&(song->voice[v]);
   sample_t 
-    *dest=song->resample_buffer,
+    *dest=buffer,
     *src=vp->sample->data;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->data_length,
     count=*countptr;
-  Sint32 i, j;
+  Sint32 i;
 
   if (incr<0) incr = -incr; /* In case we're coming out of a bidir loop */
 
@@ -62,13 +231,7 @@ static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
     } 
   else count -= i;
 
-  for (j = 0; j < i; j++)
-    {
-      v1 = src[ofs >> FRACTION_BITS];
-      v2 = src[(ofs >> FRACTION_BITS)+1];
-      *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-      ofs += incr;
-    }
+  dest = resample_run(song, dest, src, &ofs, incr, i);
 
   if (ofs >= le) 
     {
@@ -79,24 +242,24 @@ static sample_t *rs_plain(MidiSong *song, int v, Sint32 *countptr)
     }
   
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
-static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count)
+static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count,
+			  sample_t *buffer)
 {
 
   /* Play sample until end-of-loop, skip back and continue. */
 
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment,
     le=vp->sample->loop_end, 
     ll=le - vp->sample->loop_start;
   sample_t
-    *dest=song->resample_buffer,
+    *dest=buffer,
     *src=vp->sample->data;
-  Sint32 i, j;
+  Sint32 i;
   
   while (count) 
     {
@@ -110,34 +273,28 @@ static sample_t *rs_loop(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	} 
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
     }
 
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
-static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
+static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count,
+			  sample_t *buffer)
 {
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset,
     incr=vp->sample_increment,
     le=vp->sample->loop_end,
     ls=vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer, 
+    *dest=buffer, 
     *src=vp->sample->data;
   Sint32
     le2 = le<<1,
     ls2 = ls<<1,
-    i, j;
+    i;
   /* Play normally until inside the loop region */
 
   if (incr > 0 && ofs < ls)
@@ -152,13 +309,7 @@ static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	} 
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
     }
 
   /* Then do the bidirectional looping */
@@ -173,13 +324,7 @@ static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	  count = 0;
 	} 
       else count -= i;
-      for (j = 0; j < i; j++)
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
       if (ofs>=le) 
 	{
 	  /* fold the overshoot back in */
@@ -195,7 +340,7 @@ static sample_t *rs_bidir(MidiSong *song, Voice *vp, Sint32 count)
 
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
 /*********************** vibrato versions ***************************/
@@ -275,15 +420,15 @@ static Sint32 update_vibrato(MidiSong *song, Voice *vp, int sign)
   return (Sint32) a;
 }
 
-static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr)
+static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr,
+			  sample_t *buffer)
 {
 
   /* Play sample until end, then free the voice. */
 
-  sample_t v1, v2;
   Voice *vp=&(song->voice[v]);
   sample_t 
-    *dest=song->resample_buffer, 
+    *dest=buffer, 
     *src=vp->sample->data;
   Sint32 
     le=vp->sample->data_length,
@@ -304,10 +449,7 @@ static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr)
 	  cc=vp->vibrato_control_ratio;
 	  incr=update_vibrato(song, vp, 0);
 	}
-      v1 = src[ofs >> FRACTION_BITS];
-      v2 = src[(ofs >> FRACTION_BITS)+1];
-      *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-      ofs += incr;
+      dest = resample_run(song, dest, src, &ofs, incr, 1);
       if (ofs >= le)
 	{
 	  if (ofs == le)
@@ -321,26 +463,26 @@ static sample_t *rs_vib_plain(MidiSong *song, int v, Sint32 *countptr)
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
-static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
+static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count,
+			  sample_t *buffer)
 {
 
   /* Play sample until end-of-loop, skip back and continue. */
   
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment, 
     le=vp->sample->loop_end,
     ll=le - vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer, 
+    *dest=buffer, 
     *src=vp->sample->data;
   int 
     cc=vp->vibrato_control_counter;
-  Sint32 i, j;
+  Sint32 i;
   int
     vibflag=0;
 
@@ -360,13 +502,7 @@ static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
 	} 
       else cc -= i;
       count -= i;
-      for (j = 0; j < i; j++)
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
       if(vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -378,26 +514,26 @@ static sample_t *rs_vib_loop(MidiSong *song, Voice *vp, Sint32 count)
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
-static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
+static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count,
+			  sample_t *buffer)
 {
-  sample_t v1, v2;
   Sint32 
     ofs=vp->sample_offset, 
     incr=vp->sample_increment,
     le=vp->sample->loop_end, 
     ls=vp->sample->loop_start;
   sample_t 
-    *dest=song->resample_buffer, 
+    *dest=buffer, 
     *src=vp->sample->data;
   int 
     cc=vp->vibrato_control_counter;
   Sint32
     le2=le<<1,
     ls2=ls<<1,
-    i, j;
+    i;
   int
     vibflag = 0;
 
@@ -413,13 +549,7 @@ static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	} 
       else cc -= i;
       count -= i;
-      for (j = 0; j < i; j++)
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
       if (vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -442,13 +572,7 @@ static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
 	} 
       else cc -= i;
       count -= i;
-      while (i--) 
-	{
-          v1 = src[ofs >> FRACTION_BITS];
-          v2 = src[(ofs >> FRACTION_BITS)+1];
-          *dest++ = v1 + (((v2 - v1) * (ofs & FRACTION_MASK)) >> FRACTION_BITS);
-	  ofs += incr;
-	}
+      dest = resample_run(song, dest, src, &ofs, incr, i);
       if (vibflag) 
 	{
 	  cc = vp->vibrato_control_ratio;
@@ -471,10 +595,11 @@ static sample_t *rs_vib_bidir(MidiSong *song, Voice *vp, Sint32 count)
   vp->vibrato_control_counter=cc;
   vp->sample_increment=incr;
   vp->sample_offset=ofs; /* Update offset */
-  return song->resample_buffer;
+  return buffer;
 }
 
-sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr)
+sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr,
+			 sample_t *buffer)
 {
   Sint32 ofs;
   Uint8 modes;
@@ -510,12 +635,12 @@ sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr)
 	   (vp->status==VOICE_ON || vp->status==VOICE_SUSTAINED)))
 	{
 	  if (modes & MODES_PINGPONG)
-	    return rs_vib_bidir(song, vp, *countptr);
+	    return rs_vib_bidir(song, vp, *countptr, buffer);
 	  else
-	    return rs_vib_loop(song, vp, *countptr);
+	    return rs_vib_loop(song, vp, *countptr, buffer);
 	}
       else
-	return rs_vib_plain(song, v, countptr);
+	return rs_vib_plain(song, v, countptr, buffer);
     }
   else
     {
@@ -524,12 +649,12 @@ sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr)
 	   (vp->status==VOICE_ON || vp->status==VOICE_SUSTAINED)))
 	{
 	  if (modes & MODES_PINGPONG)
-	    return rs_bidir(song, vp, *countptr);
+	    return rs_bidir(song, vp, *countptr, buffer);
 	  else
-	    return rs_loop(song, vp, *countptr);
+	    return rs_loop(song, vp, *countptr, buffer);
 	}
       else
-	return rs_plain(song, v, countptr);
+	return rs_plain(song, v, countptr, buffer);
     }
 }
 
@@ -9,5 +9,9 @@
     resample.h
 */
 
-extern sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr);
+extern void init_resample(void);
+/* The voice's next samples, in 'buffer' (room for song->buffer_size of
+   them) unless the sample is already at the output rate */
+extern sample_t *resample_voice(MidiSong *song, int v, Sint32 *countptr,
+				sample_t *buffer);
 extern void pre_resample(MidiSong *song, Sample *sp);
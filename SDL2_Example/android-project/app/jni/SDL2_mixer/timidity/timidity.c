@@ -25,6 +25,8 @@
 #include "playmidi.h"
 #include "readmidi.h"
 #include "output.h"
+#include "mix.h"
+#include "resample.h"
 
 #include "tables.h"
 
@@ -32,6 +34,12 @@ ToneBank *master_tonebank[MAXBANK], *master_drumset[MAXBANK];
 
 static char def_instr_name[256] = "";
 
+/* The config is read once and kept through Timidity_Close(), for as long
+   as TIMIDITY_CFG names the same file. config_env is what it was, NULL
+   when it wasn't set. */
+static int config_loaded = 0;
+static char *config_env = NULL;
+
 #define MAXWORDS 10
 
 /* Quick-and-dirty fgets() replacement. */
@@ -411,6 +419,11 @@ int Timidity_Init_NoConfig()
   master_drumset[0]->tone = safe_malloc(128 * sizeof(ToneBankElement));
   memset(master_drumset[0]->tone, 0, 128 * sizeof(ToneBankElement));
 
+  init_mix();
+  init_resample();
+  init_output();
+  start_voice_workers();
+
   return 0;
 }
 
@@ -418,6 +431,19 @@ int Timidity_Init()
 {
   const char *env = SDL_getenv("TIMIDITY_CFG");
 
+  if (config_loaded)
+  {
+    if ((!env && !config_env) || (env && config_env && !strcmp(env, config_env)))
+    {
+      init_mix();
+      init_resample();
+      init_output();
+      start_voice_workers();
+      return 0;
+    }
+    Timidity_Exit();
+  }
+
   /* !!! FIXME: This may be ugly, but slightly less so than requiring the
    *            default search path to have only one element. I think.
    *
@@ -444,15 +470,24 @@ int Timidity_Init()
     if (read_config_file(CONFIG_FILE)<0) {
       if (read_config_file(CONFIG_FILE_ETC)<0) {
         if (read_config_file(CONFIG_FILE_ETC_TIMIDITY_FREEPATS)<0) {
+          /* The next try starts over rather than adding to this one */
+          Timidity_Exit();
           return(-1);
         }
       }
     }
   }
+
+  if (env && (config_env = safe_malloc(strlen(env) + 1)) != NULL)
+    strcpy(config_env, env);
+  config_loaded = (!env || config_env);
   return 0;
 }
 
-MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
+/* Set up a song for the output format, reading its events from rw with
+   read_events(), which is read_midi_file() or read_event_cache() */
+static MidiSong *load_song(SDL_RWops *rw, SDL_AudioSpec *audio,
+			   MidiEvent *(*read_events)(MidiSong *, Sint32 *, Sint32 *))
 {
   MidiSong *song;
   int i;
@@ -482,6 +517,7 @@ MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
 
   song->amplification = DEFAULT_AMPLIFICATION;
   song->voices = DEFAULT_VOICES;
+  song->resample_mode = RESAMPLE_LINEAR;
   song->drumchannels = DEFAULT_DRUMCHANNELS;
 
   song->rw = rw;
@@ -546,7 +582,7 @@ MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
   song->lost_notes = 0;
   song->cut_notes = 0;
 
-  song->events = read_midi_file(song, &(song->groomed_event_count),
+  song->events = read_events(song, &(song->groomed_event_count),
       &song->samples);
 
   /* The RWops can safely be closed at this point, but let's make that the
@@ -555,7 +591,7 @@ MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
   
   /* Make sure everything is okay */
   if (!song->events) {
-    free(song);
+    Timidity_FreeSong(song);
     return(NULL);
   }
 
@@ -570,6 +606,21 @@ MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
   return(song);
 }
 
+MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio)
+{
+  return load_song(rw, audio, read_midi_file);
+}
+
+MidiSong *Timidity_LoadSongCache(SDL_RWops *rw, SDL_AudioSpec *audio)
+{
+  return load_song(rw, audio, read_event_cache);
+}
+
+int Timidity_SaveSongCache(MidiSong *song, SDL_RWops *rw)
+{
+  return write_event_cache(song, rw);
+}
+
 void Timidity_FreeSong(MidiSong *song)
 {
   int i;
@@ -587,6 +638,7 @@ void Timidity_FreeSong(MidiSong *song)
   free(song->common_buffer);
   free(song->resample_buffer);
   free(song->events);
+  free(song->checkpoints);
   free(song);
 }
 
@@ -628,5 +680,17 @@ void Timidity_Exit(void)
     }
   }
 
+  stop_voice_workers();
+  free_instrument_cache();
   free_pathlist();
+  free_file_index();
+
+  free(config_env);
+  config_env = NULL;
+  config_loaded = 0;
+}
+
+void Timidity_Close(void)
+{
+  free_instrument_cache();
 }
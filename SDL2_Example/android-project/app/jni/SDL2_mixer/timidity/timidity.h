@@ -24,6 +24,13 @@ typedef Sint32 final_volume_t;
 #define MAXCHAN	16
 /* #define MAXCHAN	64 */
 #define MAXBANK	128
+/* Extra threads voices can be mixed on, see Timidity_SetThreads() */
+#define MAX_VOICE_THREADS	7
+
+/* Sample interpolation, see Timidity_SetResampleMode() */
+#define RESAMPLE_LINEAR		0
+#define RESAMPLE_NEAREST	1
+#define RESAMPLE_CUBIC		2
 
 typedef struct {
   Sint32
@@ -105,6 +112,21 @@ typedef struct {
     void *next;
 } MidiEventList;
 
+/* The linked list is allocated this many events at a time */
+#define MIDI_EVENT_BLOCK 1024
+
+typedef struct _MidiEventBlock {
+    struct _MidiEventBlock *next;
+    int used;
+    MidiEventList events[MIDI_EVENT_BLOCK];
+} MidiEventBlock;
+
+/* The channels where a seek gets to a point of the song, see seek_forward() */
+typedef struct {
+    Sint32 event; /* first event at or after the point */
+    Channel channel[MAXCHAN];
+} SeekCheckpoint;
+
 typedef struct {
     int playing;
     SDL_RWops *rw;
@@ -129,6 +151,7 @@ typedef struct {
     Channel channel[MAXCHAN];
     Voice voice[MAX_VOICES];
     int voices;
+    int resample_mode;
     Sint32 drumchannels;
     Sint32 buffered_count;
     Sint32 control_ratio;
@@ -138,10 +161,13 @@ typedef struct {
     MidiEvent *events;
     MidiEvent *current_event;
     MidiEventList *evlist;
+    MidiEventBlock *evblocks;
     Sint32 current_sample;
     Sint32 event_count;
     Sint32 at;
     Sint32 groomed_event_count;
+    SeekCheckpoint *checkpoints; /* made by the first seek far enough */
+    int checkpoint_count;
 } MidiSong;
 
 /* Some of these are not defined in timidity.c but are here for convenience */
@@ -149,13 +175,29 @@ typedef struct {
 extern int Timidity_Init(void);
 extern int Timidity_Init_NoConfig(void);
 extern void Timidity_SetVolume(MidiSong *song, int volume);
+extern void Timidity_SetMaxVoices(MidiSong *song, int voices); /* <= 0 for the default */
+extern void Timidity_SetResampleMode(MidiSong *song, int mode); /* RESAMPLE_* */
 extern int Timidity_PlaySome(MidiSong *song, void *stream, Sint32 len);
+/* Mix the voices of a buffer on 'threads' extra threads (up to
+   MAX_VOICE_THREADS) once at least 'min_voices' are sounding, 0 mixes them
+   all on the calling thread.  The output is the same either way.  Kept
+   through Timidity_Exit(), which stops the threads until the next
+   Timidity_Init().  Returns 0, or -1 if the threads couldn't be started. */
+extern int Timidity_SetThreads(int threads, int min_voices);
 extern MidiSong *Timidity_LoadSong(SDL_RWops *rw, SDL_AudioSpec *audio);
+/* Save the parsed events of a song, and load a song from them for the same
+   output rate, skipping the MIDI parsing. */
+extern int Timidity_SaveSongCache(MidiSong *song, SDL_RWops *rw);
+extern MidiSong *Timidity_LoadSongCache(SDL_RWops *rw, SDL_AudioSpec *audio);
 extern void Timidity_Start(MidiSong *song);
 extern void Timidity_Seek(MidiSong *song, Uint32 ms);
 extern Uint32 Timidity_GetSongLength(MidiSong *song); /* returns millseconds */
+extern Uint32 Timidity_GetSongTime(MidiSong *song); /* returns millseconds */
 extern void Timidity_FreeSong(MidiSong *song);
 extern void Timidity_Exit(void);
+/* Free the instruments no song uses, and keep the config for the next
+   Timidity_Init() */
+extern void Timidity_Close(void);
 
 #ifdef __cplusplus
 }
@@ -6,6 +6,19 @@ LOCAL_MODULE := SDL2_ttf
 
 FREETYPE_LIBRARY_PATH := external/freetype-2.4.12
 
+# Enable this to build only the FreeType drivers for TrueType and OpenType
+# fonts, as listed in ftmodule.h, instead of every format FreeType reads
+TRUETYPE_ONLY ?= true
+
+# Enable this to shape text with HarfBuzz, see TTF_SetFontShaping().  It's
+# linked as the static module named below, which must be built separately
+SUPPORT_HARFBUZZ ?= false
+HARFBUZZ_LIBRARY := harfbuzz
+
+# Enable this to mark glyph loads and text rendering as sections in
+# systrace and Perfetto captures, on Android 6.0 and up
+SUPPORT_TRACE ?= false
+
 LOCAL_C_INCLUDES := $(LOCAL_PATH)
 
 LOCAL_SRC_FILES := SDL_ttf.c \
@@ -13,6 +26,25 @@ LOCAL_SRC_FILES := SDL_ttf.c \
 ifneq ($(FREETYPE_LIBRARY_PATH),)
     LOCAL_C_INCLUDES += $(LOCAL_PATH)/$(FREETYPE_LIBRARY_PATH)/include
     LOCAL_CFLAGS += -DFT2_BUILD_LIBRARY
+ifeq ($(TRUETYPE_ONLY),true)
+    LOCAL_CFLAGS += -DFT_CONFIG_MODULES_H='<ftmodule.h>'
+    LOCAL_SRC_FILES += \
+        $(FREETYPE_LIBRARY_PATH)/src/autofit/autofit.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftbase.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftbitmap.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftdebug.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftglyph.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftinit.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftstroke.c \
+        $(FREETYPE_LIBRARY_PATH)/src/base/ftsystem.c \
+        $(FREETYPE_LIBRARY_PATH)/src/cff/cff.c \
+        $(FREETYPE_LIBRARY_PATH)/src/pshinter/pshinter.c \
+        $(FREETYPE_LIBRARY_PATH)/src/psnames/psmodule.c \
+        $(FREETYPE_LIBRARY_PATH)/src/raster/raster.c \
+        $(FREETYPE_LIBRARY_PATH)/src/sfnt/sfnt.c \
+        $(FREETYPE_LIBRARY_PATH)/src/smooth/smooth.c \
+        $(FREETYPE_LIBRARY_PATH)/src/truetype/truetype.c
+else
     LOCAL_SRC_FILES += \
         $(FREETYPE_LIBRARY_PATH)/src/autofit/autofit.c \
         $(FREETYPE_LIBRARY_PATH)/src/base/ftbase.c \
@@ -58,9 +90,20 @@ ifneq ($(FREETYPE_LIBRARY_PATH),)
         $(FREETYPE_LIBRARY_PATH)/src/type42/type42.c \
         $(FREETYPE_LIBRARY_PATH)/src/winfonts/winfnt.c
 endif
+endif
 
 LOCAL_SHARED_LIBRARIES := SDL2
 
+ifeq ($(SUPPORT_HARFBUZZ),true)
+    LOCAL_CFLAGS += -DTTF_USE_HARFBUZZ
+    LOCAL_STATIC_LIBRARIES += $(HARFBUZZ_LIBRARY)
+endif
+
+ifeq ($(SUPPORT_TRACE),true)
+    LOCAL_CFLAGS += -DTTF_USE_ATRACE
+    LOCAL_LDLIBS += -ldl
+endif
+
 LOCAL_EXPORT_C_INCLUDES += $(LOCAL_C_INCLUDES)
 
 include $(BUILD_SHARED_LIBRARY)
@@ -29,12 +29,63 @@
 #include FT_OUTLINE_H
 #include FT_STROKER_H
 #include FT_GLYPH_H
+#include FT_SIZES_H
+#include FT_MODULE_H
 #include FT_TRUETYPE_IDS_H
 
+#ifdef TTF_USE_HARFBUZZ
+#include <hb.h>
+#include <hb-ft.h>
+#endif
+
 #include "SDL.h"
 #include "SDL_endian.h"
 #include "SDL_ttf.h"
 
+/* The blended glyph kernels are vectorized where the compiler allows it,
+   and only used if the CPU reports support for it */
+#if defined(__ARM_NEON) || defined(__ARM_NEON__) || defined(__aarch64__)
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+
+/* Loading glyphs and rendering text show up as sections in systrace and
+   Perfetto captures when TTF_USE_ATRACE is defined, and cost nothing
+   otherwise.  The NDK only has ATrace from API level 23, so it's looked
+   up by TTF_Init(). */
+#if defined(TTF_USE_ATRACE) && defined(__ANDROID__)
+#include <dlfcn.h>
+
+static void (*TTF_trace_begin)(const char *name) = NULL;
+static void (*TTF_trace_end)(void) = NULL;
+
+static void Load_Trace( void )
+{
+    void *android = dlopen( "libandroid.so", RTLD_NOW | RTLD_LOCAL );
+
+    if ( android ) {
+        void (*begin)(const char *) = (void (*)(const char *))dlsym( android, "ATrace_beginSection" );
+        void (*end)(void) = (void (*)(void))dlsym( android, "ATrace_endSection" );
+        if ( begin && end ) {
+            TTF_trace_begin = begin;
+            TTF_trace_end = end;
+        }
+    }
+}
+
+#define TTF_TRACE_BEGIN(name) \
+    do { if ( TTF_trace_begin ) TTF_trace_begin( name ); } while ( 0 )
+#define TTF_TRACE_END() \
+    do { if ( TTF_trace_end ) TTF_trace_end(); } while ( 0 )
+#else
+#define TTF_TRACE_BEGIN(name)
+#define TTF_TRACE_END()
+#endif
+
 /* FIXME: Right now we assume the gray-scale renderer Freetype is using
    supports 256 shades of gray, but we should instead key off of num_grays
    in the result FT_Bitmap after the FT_Render_Glyph() call. */
@@ -47,26 +98,258 @@
 #define CACHED_METRICS  0x10
 #define CACHED_BITMAP   0x01
 #define CACHED_PIXMAP   0x02
+#define CACHED_SDF      0x04
+
+/* Distance field glyphs reach this many pixels past the pixmap edges */
+#define SDF_SPREAD      4
+
+/* The subpixel phase of a glyph goes in bits 2 and 3 of its variant, which
+   are free because underline and strikethrough don't change glyphs */
+#define VARIANT_PHASE_SHIFT 2
+#if TTF_SUBPIXEL_PHASES > 4
+#error "TTF_SUBPIXEL_PHASES is more than a glyph variant has room for"
+#endif
+
+/* The glyph cache is set-associative: a code point can live in any of the
+   CACHE_WAYS slots of its set, and the least recently used one is replaced.
+   The number of sets doubles while the font stays under its memory budget.
+ */
+#define CACHE_WAYS          4
+#define CACHE_MIN_SETS      64
+#define CACHE_DEFAULT_BUDGET    (1024 * 1024)
+
+/* Glyphs drawn with TTF_Draw*() are packed left to right on shelves of a
+   square texture, this many pixels apart so filtering doesn't bleed */
+#define ATLAS_PADDING       1
+#define ATLAS_MIN_SIZE      256
+#define ATLAS_MAX_SIZE      2048
+
+/* Kerning deltas are remembered per glyph pair in a direct-mapped table,
+   a pair that collides just replaces the one that was there */
+#define KERN_CACHE_SIZE     1024
+
+/* Glyph indices of code points below this are kept in a direct table,
+   the rest in an open addressed hash that doubles at 3/4 full */
+#define INDEX_DIRECT_SIZE   0x250
+#define INDEX_HASH_MIN_SIZE 64
+
+/* Slots of the ASCII glyphs last found, so plain text skips the set lookup */
+#define ASCII_GLYPHS        0x80
+
+/* FreeType's small allocations come from size classes of ARENA_MIN_BLOCK
+   bytes times a power of two, carved out of ARENA_CHUNK_SIZE chunks and
+   recycled through a free list per class until TTF_Quit() */
+#define ARENA_MIN_BLOCK     16
+#define ARENA_CLASSES       9   /* up to 4096 bytes */
+#define ARENA_CHUNK_SIZE    (64 * 1024)
+
+/* Glyph files start with this, then the format version */
+#define GLYPH_FILE_MAGIC    0x43465454  /* "TTFC" */
+#define GLYPH_FILE_VERSION  1
+#define GLYPH_FILE_FIELDS   11          /* words of a glyph before its bitmaps */
+
+/* Strings a TTF_TextCache holds when it's created with no size */
+#define TEXT_CACHE_DEFAULT_SIZE 32
+
+/* Wrapped text is composited a line per job on the render threads, when
+   there are at least this many lines, see TTF_SetRenderThreads() */
+#define RENDER_MAX_THREADS  16
+#define WRAP_PARALLEL_LINES 4
+
+/* Strings each font keeps the shaping of, see TTF_SetFontShaping() */
+#define SHAPE_CACHE_SIZE    64
+
+/* Rendered images of a glyph, allocated from the font's pool the first
+   time one of them is needed so a glyph that's only measured stays small */
+typedef struct glyph_bits {
+    FT_Bitmap bitmap;
+    FT_Bitmap pixmap;
+    FT_Bitmap sdf;      /* pixmap plus SDF_SPREAD on every side */
+} glyph_bits;
 
 /* Cached glyph information */
 typedef struct cached_glyph {
     int stored;
     FT_UInt index;
-    FT_Bitmap bitmap;
-    FT_Bitmap pixmap;
+    glyph_bits *bits;   /* NULL until a bitmap, pixmap or SDF is rendered */
+    int source;         /* 0, or 1 + the fallback font the glyph came from */
     int minx;
     int maxx;
     int miny;
     int maxy;
     int yoffset;
     int advance;
-    Uint16 cached;
+    FT_Pos linear_advance;  /* unhinted advance in 26.6, for subpixel positioning */
+    Uint32 cached;      /* the code point */
+    int variant;        /* font->variant and subpixel phase it was rendered with */
+    Uint32 lru;
+    SDL_Rect atlas;     /* w is 0 until the glyph is in the atlas */
 } c_glyph;
 
+/* A glyph HarfBuzz placed, in 26.6 */
+typedef struct shaped_glyph {
+    FT_UInt index;
+    FT_Pos x_advance;
+    FT_Pos x_offset;
+    FT_Pos y_offset;    /* up from the baseline */
+} shaped_glyph;
+
+/* The shaping of a string, text is NULL if the entry is free */
+typedef struct shaped_text {
+    Uint32 hash;
+    int shaping;
+    int hinting;
+    int kerning;
+    char *text;
+    size_t len;
+    shaped_glyph *glyphs;
+    int num_glyphs;
+    Uint32 lru;
+} shaped_text;
+
+/* Threads that take the items of one job at a time, the caller of
+   Run_Jobs() works through them too.  Only one job runs at once, another
+   caller meanwhile does all of its items itself. */
+typedef struct render_pool {
+    SDL_mutex *lock;
+    SDL_cond *wake;
+    SDL_cond *done;
+    SDL_Thread *threads[RENDER_MAX_THREADS];
+    int count;
+    int quit;
+    int busy;
+    void (*job)(void *data, int item);
+    void *data;
+    int items;
+    int next;           /* next item to take */
+    int active;         /* items being worked on */
+} render_pool;
+
+/* The items of one job spread over the threads of a job handler, see
+   TTF_SetJobHandler().  Its threads may get to it after the caller has
+   done every item, so it lives until the last of them lets go. */
+typedef struct job_batch {
+    void (*job)(void *data, int item);
+    void *data;
+    int items;
+    SDL_atomic_t next;
+    SDL_atomic_t finished;
+    SDL_atomic_t refs;
+    SDL_sem *done;
+} job_batch;
+
+/* A glyph of wrapped text, where it lands relative to its line */
+typedef struct wrap_glyph {
+    const c_glyph *glyph;
+    int x;
+    int y;
+} wrap_glyph;
+
+/* Everything the lines of a wrapped render need once their glyphs are in
+   the cache, line_start[line] is the first of its glyphs */
+typedef struct wrap_job {
+    SDL_Surface *textbuf;
+    Uint32 pixel;
+    int height;
+    int outline;
+    int num_lines;
+    wrap_glyph *glyphs;
+    int *line_start;
+} wrap_job;
+
+/* Texture the TTF_Draw*() functions copy glyphs from */
+typedef struct glyph_atlas {
+    SDL_Renderer *renderer;
+    SDL_Texture *texture;
+    int size;
+    int x, y;           /* next free spot on the current shelf */
+    int shelf;          /* height of the current shelf */
+    Uint32 *scratch;
+    int scratch_size;
+} glyph_atlas;
+
+/* Glyph index of a code point, ch is 0 if the entry is unused */
+typedef struct char_index {
+    Uint32 ch;
+    FT_UInt index;
+} char_index;
+
+/* Kerning between two glyph indices, in pixels */
+typedef struct kern_pair {
+    Uint32 pair;        /* prev_index << 16 | index, 0 if unused */
+    int delta;
+} kern_pair;
+
+/* A string rendered through a TTF_TextCache, with everything that
+   changes its pixels */
+typedef struct cached_text {
+    Uint32 font_id;     /* font->id, 0 if the entry is free */
+    Uint32 hash;
+    int style;
+    int outline;
+    int kerning;
+    int hinting;
+    int subpixel;
+    Uint32 color;
+    char *text;
+    SDL_Surface *surface;
+    SDL_Texture *texture;   /* replaces the surface once it's uploaded,
+                               unless the cache retains surfaces */
+    Uint32 lru;
+} cached_text;
+
+struct _TTF_TextCache {
+    SDL_Renderer *renderer;
+    cached_text *entries;
+    int num_entries;
+    Uint32 tick;
+    SDL_bool retain;
+};
+
+/* Precedes every block handed to FreeType */
+typedef union arena_header {
+    size_t size;                /* what FreeType asked for */
+    union arena_header *next;   /* next free block of the class */
+    double align;
+} arena_header;
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    double align;
+} arena_chunk;
+
+/* The pool behind the FT_Memory of the library */
+typedef struct ft_arena {
+    SDL_SpinLock lock;          /* FreeType calls aren't all under library_lock */
+    arena_header *free[ARENA_CLASSES];
+    arena_chunk *chunks;
+    Uint8 *next;                /* unused part of the newest chunk */
+    size_t left;
+    size_t active;
+    size_t peak;
+} ft_arena;
+
+/* A line of text laid out by TTF_Layout() */
+struct _TTF_TextRun {
+    TTF_Font *font;
+    Uint32 generation;  /* font->generation the layout is valid for */
+    char *text;         /* copy of the text for relayout, NULL for scratch */
+    TTF_RunGlyph *glyphs;
+    int num_glyphs;
+    int max_glyphs;
+    int w, h;           /* what TTF_SizeUTF8() reports */
+};
+
 /* The structure used to hold internal font information */
 struct _TTF_Font {
     /* Freetype2 maintains all sorts of useful info itself */
     FT_Face face;
+    FT_Size size;           /* made active before anything size dependent */
+    Uint32 id;              /* never reused, so text caches can't mix fonts up */
+    int *face_refs;         /* fonts sharing the face, NULL if only one */
+
+    /* Held by every call that reads or updates anything below */
+    SDL_mutex *lock;
 
     /* We'll cache these ourselves */
     int height;
@@ -82,6 +365,17 @@ struct _TTF_Font {
     /* Whether kerning is desired */
     int kerning;
 
+    /* Whether glyphs are placed at fractional pixels */
+    int subpixel;
+
+    /* TTF_SHAPING_*, and the strings shaped so far */
+    int shaping;
+    shaped_text *shapes;    /* SHAPE_CACHE_SIZE entries once text is shaped */
+    Uint32 shape_tick;
+#ifdef TTF_USE_HARFBUZZ
+    hb_font_t *hb_font;
+#endif
+
     /* Extra width in glyph bounds for text styles */
     int glyph_overhang;
     float glyph_italics;
@@ -90,14 +384,62 @@ struct _TTF_Font {
     int underline_offset;
     int underline_height;
 
-    /* Cache for style-transformed glyphs */
+    /* Cache for style-transformed glyphs, each style and outline width has
+       its own copy of a glyph so switching between them flushes nothing */
+    int variant;            /* Glyph_Variant() of the current settings */
+    FT_Stroker stroker;     /* created the first time a glyph is outlined */
     c_glyph *current;
-    c_glyph cache[257]; /* 257 is a prime */
+    c_glyph *cache;         /* cache_sets * CACHE_WAYS slots */
+    c_glyph *ascii[ASCII_GLYPHS];   /* may be stale, checked on every use */
+    int cache_sets;
+    Uint32 cache_tick;
+    size_t cache_bytes;     /* bitmap and pixmap memory held by the slots */
+    ft_arena pool;          /* where the glyph_bits and their buffers live */
+    struct FT_MemoryRec_ pool_memory;
+    size_t cache_budget;
+    size_t cache_counted;   /* what the font adds to TTF_cache_total */
+    int cache_entries;      /* slots holding a glyph, see TTF_GetCacheStats() */
+    Uint32 cache_hits;
+    Uint32 cache_misses;
+    Uint32 cache_evictions;
+    TTF_Font *next_font;    /* in TTF_fonts */
+    int glyphs_added;       /* FreeType rendered glyphs the glyph file lacks */
+
+    /* Lazily created the first time the font is drawn to a renderer */
+    glyph_atlas atlas;
+
+    /* Lazily created the first time a pair is kerned */
+    kern_pair *kern_cache;
+
+    /* Glyph indices looked up so far, kept when their glyphs are evicted */
+    FT_UInt *index_direct;  /* index + 1, 0 if not looked up yet */
+    char_index *index_hash;
+    int index_hash_size;
+    int index_hash_count;
+
+    /* Fonts the glyphs this one lacks are drawn from, see TTF_SetFontFallbacks(),
+       and which of them each code point was found in: index is its source */
+    TTF_Font **fallbacks;
+    int num_fallbacks;
+    char_index *source_hash;
+    int source_hash_size;
+    int source_hash_count;
+
+    /* Bumped whenever a setting changes the layout of text */
+    Uint32 generation;
+
+    /* Layout of the string the TTF_Size/Render functions are working on */
+    TTF_TextRun run;
+
+    /* Line breaks of the last string wrapped with Wrap_Lines() */
+    TTF_LineSpan *lines;
+    int max_lines;
 
     /* We are responsible for closing the font stream */
     SDL_RWops *src;
     int freesrc;
     FT_Open_Args args;
+    Uint8 *mem;             /* whole font file, if it was read up front */
 
     /* For non-scalable formats, we must remember which font index size */
     int font_size_family;
@@ -114,13 +456,30 @@ struct _TTF_Font {
 #define TTF_HANDLE_STYLE_UNDERLINE(font) ((font)->style & TTF_STYLE_UNDERLINE)
 #define TTF_HANDLE_STYLE_STRIKETHROUGH(font) ((font)->style & TTF_STYLE_STRIKETHROUGH)
 
-/* Font styles that does not impact glyph drawing */
-#define TTF_STYLE_NO_GLYPH_CHANGE   (TTF_STYLE_UNDERLINE | TTF_STYLE_STRIKETHROUGH)
-
 /* The FreeType font engine/library */
 static FT_Library library;
+static SDL_mutex *library_lock = NULL;  /* held around FreeType calls, they share its state */
 static int TTF_initialized = 0;
+static ft_arena TTF_arena;
+
+/* Every open font, and the glyph memory they hold between them, so the
+   caches can share a budget.  The list is guarded by library_lock. */
+static TTF_Font *TTF_fonts = NULL;
+static SDL_atomic_t TTF_cache_total;
+static SDL_atomic_t TTF_total_budget;   /* 0 for no limit */
+
+/* Where fonts keep their glyph files, NULL if they don't */
+static char *TTF_glyph_dir = NULL;
+static SDL_SpinLock TTF_glyph_dir_lock = 0;
+static SDL_atomic_t TTF_font_serial;
+/* The FreeType error of each thread's last missing glyph, see TTF_GetError() */
+static SDL_TLSID TTF_glyph_error = 0;
 static int TTF_byteswapped = 0;
+static SDL_bool TTF_has_neon = SDL_FALSE;
+static SDL_bool TTF_has_sse2 = SDL_FALSE;
+static render_pool TTF_render_pool;
+static TTF_JobHandler TTF_job_handler = NULL;
+static void *TTF_job_handler_udata = NULL;
 
 #define TTF_CHECKPOINTER(p, errval)                 \
     if ( !TTF_initialized ) {                   \
@@ -282,6 +641,162 @@ static void TTF_drawLine_Blended(const TTF_Font *font, const SDL_Surface *textbu
     }
 }
 
+/* Glyph boxes overlap wherever text is kerned or slanted, so coverage
+   is composited by keeping the larger alpha rather than ORing the two
+   together.  Pixels a glyph doesn't cover are left alone, so the same
+   kernels work on surfaces that already hold other colors.
+
+   Each SIMD kernel handles 16 coverage bytes at a time and returns how
+   many it did, Blend_Row() finishes off the rest.  Rows are not assumed
+   to be aligned.
+ */
+#ifdef HAVE_NEON_INTRINSICS
+static uint32x4_t Blend_NEON( uint32x4_t d, uint32x4_t a, uint32x4_t color )
+{
+    const uint32x4_t amask = vdupq_n_u32( 0xFF000000 );
+    uint8x16_t m = vmaxq_u8( vreinterpretq_u8_u32( a ), vreinterpretq_u8_u32( vandq_u32( d, amask ) ) );
+    uint32x4_t blended = vorrq_u32( color, vreinterpretq_u32_u8( m ) );
+
+    return vbslq_u32( vceqq_u32( a, vdupq_n_u32( 0 ) ), d, blended );
+}
+
+static int Blend_Row_NEON( Uint32 *dst, const Uint8 *src, int n, Uint32 pixel )
+{
+    const uint32x4_t color = vdupq_n_u32( pixel );
+    int i;
+
+    for ( i = 0; i + 16 <= n; i += 16 ) {
+        uint8x16_t a = vld1q_u8( src + i );
+        uint16x8_t lo = vmovl_u8( vget_low_u8( a ) );
+        uint16x8_t hi = vmovl_u8( vget_high_u8( a ) );
+        Uint32 *d = dst + i;
+
+        vst1q_u32( d +  0, Blend_NEON( vld1q_u32( d +  0 ), vshlq_n_u32( vmovl_u16( vget_low_u16( lo ) ), 24 ), color ) );
+        vst1q_u32( d +  4, Blend_NEON( vld1q_u32( d +  4 ), vshlq_n_u32( vmovl_u16( vget_high_u16( lo ) ), 24 ), color ) );
+        vst1q_u32( d +  8, Blend_NEON( vld1q_u32( d +  8 ), vshlq_n_u32( vmovl_u16( vget_low_u16( hi ) ), 24 ), color ) );
+        vst1q_u32( d + 12, Blend_NEON( vld1q_u32( d + 12 ), vshlq_n_u32( vmovl_u16( vget_high_u16( hi ) ), 24 ), color ) );
+    }
+    return i;
+}
+#endif /* HAVE_NEON_INTRINSICS */
+
+#ifdef HAVE_SSE2_INTRINSICS
+static __m128i Blend_SSE2( __m128i d, __m128i a, __m128i color )
+{
+    const __m128i amask = _mm_set1_epi32( (int)0xFF000000 );
+    __m128i blended = _mm_or_si128( color, _mm_max_epu8( a, _mm_and_si128( d, amask ) ) );
+    __m128i keep = _mm_cmpeq_epi32( a, _mm_setzero_si128() );
+
+    return _mm_or_si128( _mm_and_si128( keep, d ), _mm_andnot_si128( keep, blended ) );
+}
+
+static int Blend_Row_SSE2( Uint32 *dst, const Uint8 *src, int n, Uint32 pixel )
+{
+    const __m128i color = _mm_set1_epi32( (int)pixel );
+    const __m128i zero = _mm_setzero_si128();
+    int i;
+
+    for ( i = 0; i + 16 <= n; i += 16 ) {
+        /* Interleaving zeros below each byte twice leaves it in the top byte */
+        __m128i a = _mm_loadu_si128( (const __m128i *)(src + i) );
+        __m128i lo = _mm_unpacklo_epi8( zero, a );
+        __m128i hi = _mm_unpackhi_epi8( zero, a );
+        __m128i *d = (__m128i *)(dst + i);
+
+        _mm_storeu_si128( d + 0, Blend_SSE2( _mm_loadu_si128( d + 0 ), _mm_unpacklo_epi16( zero, lo ), color ) );
+        _mm_storeu_si128( d + 1, Blend_SSE2( _mm_loadu_si128( d + 1 ), _mm_unpackhi_epi16( zero, lo ), color ) );
+        _mm_storeu_si128( d + 2, Blend_SSE2( _mm_loadu_si128( d + 2 ), _mm_unpacklo_epi16( zero, hi ), color ) );
+        _mm_storeu_si128( d + 3, Blend_SSE2( _mm_loadu_si128( d + 3 ), _mm_unpackhi_epi16( zero, hi ), color ) );
+    }
+    return i;
+}
+#endif /* HAVE_SSE2_INTRINSICS */
+
+/* Composite n coverage values from src as the alpha of pixel into dst,
+   which has already been clipped to the surface */
+static void Blend_Row( Uint32 *dst, const Uint8 *src, int n, Uint32 pixel )
+{
+    int i = 0;
+
+#ifdef HAVE_NEON_INTRINSICS
+    if ( TTF_has_neon ) {
+        i = Blend_Row_NEON( dst, src, n, pixel );
+    }
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if ( TTF_has_sse2 ) {
+        i = Blend_Row_SSE2( dst, src, n, pixel );
+    }
+#endif
+    for ( ; i < n; ++i ) {
+        Uint32 alpha = src[i];
+        if ( alpha ) {
+            Uint32 old = dst[i] >> 24;
+            dst[i] = pixel | (SDL_max(alpha, old) << 24);
+        }
+    }
+}
+
+/* The 8-bit renderers OR glyphs into the surface, 16 bytes at a time
+   where the SIMD units allow */
+static void Or_Row( Uint8 *dst, const Uint8 *src, int n )
+{
+    int i = 0;
+
+#ifdef HAVE_NEON_INTRINSICS
+    if ( TTF_has_neon ) {
+        for ( ; i + 16 <= n; i += 16 ) {
+            vst1q_u8( dst + i, vorrq_u8( vld1q_u8( dst + i ), vld1q_u8( src + i ) ) );
+        }
+    }
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if ( TTF_has_sse2 ) {
+        for ( ; i + 16 <= n; i += 16 ) {
+            __m128i *d = (__m128i *)(dst + i);
+            _mm_storeu_si128( d, _mm_or_si128( _mm_loadu_si128( d ), _mm_loadu_si128( (const __m128i *)(src + i) ) ) );
+        }
+    }
+#endif
+    for ( ; i < n; ++i ) {
+        dst[i] |= src[i];
+    }
+}
+
+/* Put width columns of an 8-bit glyph at (x, y) of the surface, clipped
+   to it.  Nothing has been drawn at or right of *right yet, and ORing
+   into zeros is a copy, so glyphs that don't overlap the ones before
+   them are copied a row at a time. */
+static void Copy_Glyph_8( SDL_Surface *textbuf, const FT_Bitmap *bitmap,
+                          int width, int x, int y, int *right )
+{
+    const int col0 = SDL_max( 0, -x );
+    const int col1 = SDL_min( width, textbuf->w - x );
+    const int row0 = SDL_max( 0, -y );
+    const int row1 = SDL_min( bitmap->rows, textbuf->h - y );
+    const Uint8 *src;
+    Uint8 *dst;
+    int row;
+
+    if ( col0 >= col1 || row0 >= row1 ) {
+        return;
+    }
+    dst = (Uint8 *)textbuf->pixels + (y + row0) * textbuf->pitch + x + col0;
+    src = bitmap->buffer + row0 * bitmap->pitch + col0;
+    for ( row = row0; row < row1; ++row ) {
+        if ( x + col0 >= *right ) {
+            SDL_memcpy( dst, src, col1 - col0 );
+        } else {
+            Or_Row( dst, src, col1 - col0 );
+        }
+        dst += textbuf->pitch;
+        src += bitmap->pitch;
+    }
+    if ( *right < x + col1 ) {
+        *right = x + col1;
+    }
+}
+
 /* rcg06192001 get linked library's version. */
 const SDL_version *TTF_Linked_Version(void)
 {
@@ -331,154 +846,481 @@ static void TTF_SetFTError(const char *msg, FT_Error error)
 #endif /* USE_FREETYPE_ERRORS */
 }
 
-int TTF_Init( void )
+/* A missing glyph fails the text drawn with it, which can be every frame,
+   so only the FreeType error is noted; TTF_GetError() makes the message */
+static void TTF_SetGlyphError(FT_Error error)
 {
-    int status = 0;
+    /* With SDL's error cleared, any error set after this one shows */
+    SDL_ClearError();
+    SDL_TLSSet( TTF_glyph_error, (void *)(uintptr_t)(unsigned int)error, NULL );
+}
 
-    if ( ! TTF_initialized ) {
-        FT_Error error = FT_Init_FreeType( &library );
-        if ( error ) {
-            TTF_SetFTError("Couldn't init FreeType engine", error);
-            status = -1;
-        }
-    }
-    if ( status == 0 ) {
-        ++TTF_initialized;
+/* The glyph error of this thread, if it's still the latest error */
+static FT_Error TTF_PendingGlyphError(void)
+{
+    FT_Error error = (FT_Error)(uintptr_t)SDL_TLSGet( TTF_glyph_error );
+
+    if ( error && *SDL_GetError() != '\0' ) {
+        SDL_TLSSet( TTF_glyph_error, NULL, NULL );
+        error = 0;
     }
-    return status;
+    return error;
 }
 
-static unsigned long RWread(
-    FT_Stream stream,
-    unsigned long offset,
-    unsigned char* buffer,
-    unsigned long count
-)
+const char *TTF_GetError(void)
 {
-    SDL_RWops *src;
+    FT_Error error = TTF_PendingGlyphError();
 
-    src = (SDL_RWops *)stream->descriptor.pointer;
-    SDL_RWseek( src, (int)offset, RW_SEEK_SET );
-    if ( count == 0 ) {
-        return 0;
+    if ( error ) {
+        SDL_TLSSet( TTF_glyph_error, NULL, NULL );
+        TTF_SetFTError( "Couldn't find glyph", error );
     }
-    return (unsigned long)SDL_RWread( src, buffer, 1, (int)count );
+    return SDL_GetError();
 }
 
-TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long index )
+int TTF_GetFTError(void)
 {
-    TTF_Font* font;
-    FT_Error error;
-    FT_Face face;
-    FT_Fixed scale;
-    FT_Stream stream;
-    FT_CharMap found;
-    Sint64 position;
-    int i;
+    return (int)TTF_PendingGlyphError();
+}
 
-    if ( ! TTF_initialized ) {
-        TTF_SetError( "Library not initialized" );
-        if ( src && freesrc ) {
-            SDL_RWclose( src );
+/* The size class of a block, ARENA_CLASSES if it's too big for one */
+static int Arena_Class( size_t size )
+{
+    int c = 0;
+    size_t block = ARENA_MIN_BLOCK;
+
+    while ( c < ARENA_CLASSES && block < size ) {
+        block *= 2;
+        ++c;
+    }
+    return c;
+}
+
+static void *Arena_Alloc( FT_Memory memory, long size )
+{
+    ft_arena *arena = (ft_arena *)memory->user;
+    arena_header *block;
+    size_t bytes;
+    int c = Arena_Class( size );
+
+    SDL_AtomicLock( &arena->lock );
+    if ( c == ARENA_CLASSES ) {
+        block = (arena_header *)SDL_malloc( sizeof( *block ) + size );
+    } else if ( arena->free[c] ) {
+        block = arena->free[c];
+        arena->free[c] = block->next;
+    } else {
+        bytes = sizeof( *block ) + ((size_t)ARENA_MIN_BLOCK << c);
+        if ( arena->left < bytes ) {
+            arena_chunk *chunk = (arena_chunk *)SDL_malloc( sizeof( *chunk ) + ARENA_CHUNK_SIZE );
+            if ( !chunk ) {
+                SDL_AtomicUnlock( &arena->lock );
+                return NULL;
+            }
+            chunk->next = arena->chunks;
+            arena->chunks = chunk;
+            arena->next = (Uint8 *)(chunk + 1);
+            arena->left = ARENA_CHUNK_SIZE;
         }
-        return NULL;
+        block = (arena_header *)arena->next;
+        arena->next += bytes;
+        arena->left -= bytes;
+    }
+    if ( block ) {
+        block->size = size;
+        arena->active += size;
+        if ( arena->peak < arena->active ) {
+            arena->peak = arena->active;
+        }
+        ++block;
     }
+    SDL_AtomicUnlock( &arena->lock );
+    return block;
+}
 
-    if ( ! src ) {
-        TTF_SetError( "Passed a NULL font source" );
-        return NULL;
+static void Arena_Free( FT_Memory memory, void *ptr )
+{
+    ft_arena *arena = (ft_arena *)memory->user;
+    arena_header *block = (arena_header *)ptr - 1;
+    int c = Arena_Class( block->size );
+
+    SDL_AtomicLock( &arena->lock );
+    arena->active -= block->size;
+    if ( c == ARENA_CLASSES ) {
+        SDL_free( block );
+    } else {
+        block->next = arena->free[c];
+        arena->free[c] = block;
     }
+    SDL_AtomicUnlock( &arena->lock );
+}
 
-    /* Check to make sure we can seek in this stream */
-    position = SDL_RWtell(src);
-    if ( position < 0 ) {
-        TTF_SetError( "Can't seek in stream" );
-        if ( freesrc ) {
-            SDL_RWclose( src );
+static void *Arena_Realloc( FT_Memory memory, long cur_size, long new_size, void *ptr )
+{
+    ft_arena *arena = (ft_arena *)memory->user;
+    arena_header *block = (arena_header *)ptr - 1;
+    void *copy;
+    int c = Arena_Class( block->size );
+
+    /* Blocks that stay in their class, or are too big for any, stay put */
+    if ( c == Arena_Class( new_size ) ) {
+        if ( c == ARENA_CLASSES ) {
+            block = (arena_header *)SDL_realloc( block, sizeof( *block ) + new_size );
+            if ( !block ) {
+                return NULL;
+            }
         }
-        return NULL;
+        SDL_AtomicLock( &arena->lock );
+        arena->active += new_size - block->size;
+        if ( arena->peak < arena->active ) {
+            arena->peak = arena->active;
+        }
+        block->size = new_size;
+        SDL_AtomicUnlock( &arena->lock );
+        return block + 1;
     }
 
-    font = (TTF_Font*)SDL_malloc(sizeof *font);
-    if ( font == NULL ) {
-        TTF_SetError( "Out of memory" );
-        if ( freesrc ) {
-            SDL_RWclose( src );
-        }
-        return NULL;
+    copy = Arena_Alloc( memory, new_size );
+    if ( copy ) {
+        SDL_memcpy( copy, ptr, SDL_min( cur_size, new_size ) );
+        Arena_Free( memory, ptr );
     }
-    SDL_memset(font, 0, sizeof(*font));
+    return copy;
+}
 
-    font->src = src;
-    font->freesrc = freesrc;
+/* Give every chunk back once the library is gone */
+static void Arena_Done( ft_arena *arena )
+{
+    while ( arena->chunks ) {
+        arena_chunk *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        SDL_free( chunk );
+    }
+    SDL_memset( arena, 0, sizeof( *arena ) );
+}
 
-    stream = (FT_Stream)SDL_malloc(sizeof(*stream));
-    if ( stream == NULL ) {
-        TTF_SetError( "Out of memory" );
-        TTF_CloseFont( font );
-        return NULL;
+static struct FT_MemoryRec_ TTF_memory = {
+    &TTF_arena, Arena_Alloc, Arena_Free, Arena_Realloc
+};
+
+/* Glyph bitmaps come from a pool per font, so a font's glyphs sit together
+   and closing it gives all of their memory back at once */
+static void Init_Glyph_Pool( TTF_Font* font )
+{
+    font->pool_memory.user = &font->pool;
+    font->pool_memory.alloc = Arena_Alloc;
+    font->pool_memory.free = Arena_Free;
+    font->pool_memory.realloc = Arena_Realloc;
+}
+
+static void *Glyph_Alloc( TTF_Font* font, size_t size )
+{
+    return Arena_Alloc( &font->pool_memory, (long)size );
+}
+
+static void Glyph_Free( TTF_Font* font, void *ptr )
+{
+    if ( ptr ) {
+        Arena_Free( &font->pool_memory, ptr );
     }
-    SDL_memset(stream, 0, sizeof(*stream));
+}
 
-    stream->read = RWread;
-    stream->descriptor.pointer = src;
-    stream->pos = (unsigned long)position;
-    stream->size = (unsigned long)(SDL_RWsize(src) - position);
+static int SDLCALL Render_Thread( void *data )
+{
+    render_pool *pool = (render_pool *)data;
+
+    SDL_LockMutex( pool->lock );
+    while ( !pool->quit ) {
+        if ( pool->job && pool->next < pool->items ) {
+            int item = pool->next++;
+
+            ++pool->active;
+            SDL_UnlockMutex( pool->lock );
+            pool->job( pool->data, item );
+            SDL_LockMutex( pool->lock );
+            if ( --pool->active == 0 && pool->next >= pool->items ) {
+                SDL_CondSignal( pool->done );
+            }
+            continue;
+        }
+        SDL_CondWait( pool->wake, pool->lock );
+    }
+    SDL_UnlockMutex( pool->lock );
+    return 0;
+}
 
-    font->args.flags = FT_OPEN_STREAM;
-    font->args.stream = stream;
+static void Stop_Render_Pool( render_pool *pool )
+{
+    int i;
 
-    error = FT_Open_Face( library, &font->args, index, &font->face );
-    if ( error ) {
-        TTF_SetFTError( "Couldn't load font file", error );
-        TTF_CloseFont( font );
-        return NULL;
+    if ( !pool->lock ) {
+        return;
     }
-    face = font->face;
+    SDL_LockMutex( pool->lock );
+    pool->quit = 1;
+    SDL_CondBroadcast( pool->wake );
+    SDL_UnlockMutex( pool->lock );
+    for ( i = 0; i < pool->count; ++i ) {
+        SDL_WaitThread( pool->threads[i], NULL );
+    }
+    SDL_DestroyCond( pool->done );
+    SDL_DestroyCond( pool->wake );
+    SDL_DestroyMutex( pool->lock );
+    SDL_memset( pool, 0, sizeof( *pool ) );
+}
 
-    /* Set charmap for loaded font */
-    found = 0;
-    for (i = 0; i < face->num_charmaps; i++) {
-        FT_CharMap charmap = face->charmaps[i];
-        if ((charmap->platform_id == 3 && charmap->encoding_id == 1) /* Windows Unicode */
-         || (charmap->platform_id == 3 && charmap->encoding_id == 0) /* Windows Symbol */
-         || (charmap->platform_id == 2 && charmap->encoding_id == 1) /* ISO Unicode */
-         || (charmap->platform_id == 0)) { /* Apple Unicode */
-            found = charmap;
-            break;
+static int Start_Render_Pool( render_pool *pool, int count )
+{
+    pool->lock = SDL_CreateMutex();
+    pool->wake = SDL_CreateCond();
+    pool->done = SDL_CreateCond();
+    if ( !pool->lock || !pool->wake || !pool->done ) {
+        Stop_Render_Pool( pool );
+        return -1;
+    }
+    while ( pool->count < count ) {
+        pool->threads[pool->count] = SDL_CreateThread( Render_Thread, "SDL_ttf render", pool );
+        if ( !pool->threads[pool->count] ) {
+            Stop_Render_Pool( pool );
+            return -1;
         }
+        ++pool->count;
     }
-    if ( found ) {
-        /* If this fails, continue using the default charmap */
-        FT_Set_Charmap(face, found);
+    return 0;
+}
+
+static void Release_Batch( job_batch *batch )
+{
+    if ( SDL_AtomicAdd( &batch->refs, -1 ) == 1 ) {
+        SDL_DestroySemaphore( batch->done );
+        SDL_free( batch );
     }
+}
 
-    /* Make sure that our font face is scalable (global metrics) */
-    if ( FT_IS_SCALABLE(face) ) {
-        /* Set the character size and use default DPI (72) */
-        error = FT_Set_Char_Size( font->face, 0, ptsize * 64, 0, 0 );
-        if ( error ) {
-            TTF_SetFTError( "Couldn't set font size", error );
-            TTF_CloseFont( font );
-            return NULL;
+static void Work_Batch( job_batch *batch )
+{
+    int item;
+
+    while ( (item = SDL_AtomicAdd( &batch->next, 1 )) < batch->items ) {
+        batch->job( batch->data, item );
+        if ( SDL_AtomicAdd( &batch->finished, 1 ) == batch->items - 1 ) {
+            SDL_SemPost( batch->done );
         }
+    }
+}
 
-        /* Get the scalable font metrics for this font */
-        scale = face->size->metrics.y_scale;
-        font->ascent  = FT_CEIL(FT_MulFix(face->ascender, scale));
-        font->descent = FT_CEIL(FT_MulFix(face->descender, scale));
-        font->height  = font->ascent - font->descent + /* baseline */ 1;
-        font->lineskip = FT_CEIL(FT_MulFix(face->height, scale));
-        font->underline_offset = FT_FLOOR(FT_MulFix(face->underline_position, scale));
-        font->underline_height = FT_FLOOR(FT_MulFix(face->underline_thickness, scale));
+static void SDLCALL Batch_Helper( void *data )
+{
+    job_batch *batch = (job_batch *)data;
+
+    Work_Batch( batch );
+    Release_Batch( batch );
+}
+
+/* Run_Jobs() on the job handler's threads, returns -1 if it couldn't start */
+static int Run_Handled_Jobs( void (*job)(void *data, int item), void *data, int items )
+{
+    job_batch *batch;
+    int helpers, i;
+
+    batch = (job_batch *)SDL_calloc( 1, sizeof( *batch ) );
+    if ( !batch ) {
+        return -1;
+    }
+    batch->done = SDL_CreateSemaphore( 0 );
+    if ( !batch->done ) {
+        SDL_free( batch );
+        return -1;
+    }
+    batch->job = job;
+    batch->data = data;
+    batch->items = items;
+    helpers = SDL_min( items - 1, SDL_GetCPUCount() - 1 );
+    SDL_AtomicSet( &batch->refs, 1 + helpers );
+    for ( i = 0; i < helpers; ++i ) {
+        if ( TTF_job_handler( Batch_Helper, batch, TTF_job_handler_udata ) != 0 ) {
+            SDL_AtomicAdd( &batch->refs, -(helpers - i) );
+            break;
+        }
+    }
+
+    /* Whoever finishes the last item posts, which may be the caller */
+    Work_Batch( batch );
+    SDL_SemWait( batch->done );
+    Release_Batch( batch );
+    return 0;
+}
+
+/* Call job for items 0 to items - 1, spread over the job handler's or the
+   render threads if they're free, and return once all of them are done */
+static void Run_Jobs( void (*job)(void *data, int item), void *data, int items )
+{
+    render_pool *pool = &TTF_render_pool;
+    int item;
+
+    if ( TTF_job_handler && items > 1 && Run_Handled_Jobs( job, data, items ) == 0 ) {
+        return;
+    }
+    if ( pool->count > 0 ) {
+        SDL_LockMutex( pool->lock );
+        if ( !pool->busy ) {
+            pool->busy = 1;
+            pool->job = job;
+            pool->data = data;
+            pool->items = items;
+            pool->next = 0;
+            SDL_CondBroadcast( pool->wake );
+            while ( pool->next < pool->items ) {
+                item = pool->next++;
+                ++pool->active;
+                SDL_UnlockMutex( pool->lock );
+                job( data, item );
+                SDL_LockMutex( pool->lock );
+                --pool->active;
+            }
+            while ( pool->active > 0 ) {
+                SDL_CondWait( pool->done, pool->lock );
+            }
+            pool->job = NULL;
+            pool->busy = 0;
+            SDL_UnlockMutex( pool->lock );
+            return;
+        }
+        SDL_UnlockMutex( pool->lock );
+    }
+    for ( item = 0; item < items; ++item ) {
+        job( data, item );
+    }
+}
+
+int TTF_SetRenderThreads( int count )
+{
+    if ( !TTF_initialized ) {
+        TTF_SetError( "Library not initialized" );
+        return -1;
+    }
+    if ( count < 0 ) {
+        count = SDL_GetCPUCount() - 1;
+    }
+    count = SDL_min( count, RENDER_MAX_THREADS );
+    if ( count == TTF_render_pool.count ) {
+        return 0;
+    }
+    Stop_Render_Pool( &TTF_render_pool );
+    if ( count > 0 && Start_Render_Pool( &TTF_render_pool, count ) < 0 ) {
+        TTF_SetError( "Couldn't start the render threads" );
+        return -1;
+    }
+    return 0;
+}
+
+int TTF_GetRenderThreads( void )
+{
+    return TTF_render_pool.count;
+}
+
+void TTF_SetJobHandler( TTF_JobHandler handler, void *udata )
+{
+    TTF_job_handler = handler;
+    TTF_job_handler_udata = udata;
+}
+
+int TTF_Init( void )
+{
+    int status = 0;
+
+    if ( ! TTF_initialized ) {
+        FT_Error error = FT_New_Library( &TTF_memory, &library );
+        if ( error ) {
+            TTF_SetFTError("Couldn't init FreeType engine", error);
+            Arena_Done( &TTF_arena );
+            status = -1;
+        } else {
+            FT_Add_Default_Modules( library );
+            library_lock = SDL_CreateMutex();
+            if ( TTF_glyph_error == 0 ) {
+                /* TLS slots are never given back, so this one is kept */
+                TTF_glyph_error = SDL_TLSCreate();
+            }
+            if ( !library_lock ) {
+                TTF_SetError( "Couldn't create library lock" );
+                FT_Done_Library( library );
+                Arena_Done( &TTF_arena );
+                return -1;
+            }
+#ifdef HAVE_NEON_INTRINSICS
+            TTF_has_neon = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+            TTF_has_sse2 = SDL_HasSSE2();
+#endif
+#if defined(TTF_USE_ATRACE) && defined(__ANDROID__)
+            Load_Trace();
+#endif
+        }
+    }
+    if ( status == 0 ) {
+        ++TTF_initialized;
+    }
+    return status;
+}
+
+static int Alloc_Cache( TTF_Font* font, int sets );
+static void Count_Cache( TTF_Font* font );
+static void Read_Glyph_File( TTF_Font* font );
+static void Write_Glyph_File( TTF_Font* font );
+static Uint32 Hash_Bytes( Uint32 hash, const void *data, size_t size );
+static void Clear_Font_Atlas( TTF_Font *font );
+
+static unsigned long RWread(
+    FT_Stream stream,
+    unsigned long offset,
+    unsigned char* buffer,
+    unsigned long count
+)
+{
+    SDL_RWops *src;
+
+    src = (SDL_RWops *)stream->descriptor.pointer;
+    SDL_RWseek( src, (int)offset, RW_SEEK_SET );
+    if ( count == 0 ) {
+        return 0;
+    }
+    return (unsigned long)SDL_RWread( src, buffer, 1, (int)count );
+}
+
+/* Size font->size for ptsize and cache the metrics that depend on it */
+static int Set_Font_Size( TTF_Font* font, int ptsize )
+{
+    FT_Face face = font->face;
+    FT_Fixed scale;
+    FT_Error error;
+
+    /* Make sure that our font face is scalable (global metrics) */
+    if ( FT_IS_SCALABLE(face) ) {
+        /* Set the character size and use default DPI (72) */
+        error = FT_Set_Char_Size( face, 0, ptsize * 64, 0, 0 );
+        if ( error ) {
+            TTF_SetFTError( "Couldn't set font size", error );
+            return -1;
+        }
+
+        /* Get the scalable font metrics for this font */
+        scale = face->size->metrics.y_scale;
+        font->ascent  = FT_CEIL(FT_MulFix(face->ascender, scale));
+        font->descent = FT_CEIL(FT_MulFix(face->descender, scale));
+        font->height  = font->ascent - font->descent + /* baseline */ 1;
+        font->lineskip = FT_CEIL(FT_MulFix(face->height, scale));
+        font->underline_offset = FT_FLOOR(FT_MulFix(face->underline_position, scale));
+        font->underline_height = FT_FLOOR(FT_MulFix(face->underline_thickness, scale));
 
     } else {
         /* Non-scalable font case.  ptsize determines which family
          * or series of fonts to grab from the non-scalable format.
          * It is not the point size of the font.
          * */
-        if ( ptsize >= font->face->num_fixed_sizes )
-            ptsize = font->face->num_fixed_sizes - 1;
+        if ( ptsize >= face->num_fixed_sizes )
+            ptsize = face->num_fixed_sizes - 1;
         font->font_size_family = ptsize;
         error = FT_Set_Pixel_Sizes( face,
                 face->available_sizes[ptsize].width,
@@ -513,6 +1355,162 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
         TTF_underline_top_row(font), TTF_strikethrough_top_row(font));
 #endif
 
+    font->glyph_overhang = face->size->metrics.y_ppem / 10;
+    /* x offset = cos(((90.0-12)/360)*2*M_PI), or 12 degree angle */
+    font->glyph_italics = 0.207f;
+    font->glyph_italics *= font->height;
+    return 0;
+}
+
+TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long index )
+{
+    TTF_Font* font;
+    FT_Error error;
+    FT_Face face;
+    FT_Stream stream;
+    FT_CharMap found;
+    Sint64 position;
+    int i;
+
+    if ( ! TTF_initialized ) {
+        TTF_SetError( "Library not initialized" );
+        if ( src && freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+
+    if ( ! src ) {
+        TTF_SetError( "Passed a NULL font source" );
+        return NULL;
+    }
+
+    /* Check to make sure we can seek in this stream */
+    position = SDL_RWtell(src);
+    if ( position < 0 ) {
+        TTF_SetError( "Can't seek in stream" );
+        if ( freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+
+    font = (TTF_Font*)SDL_malloc(sizeof *font);
+    if ( font == NULL ) {
+        TTF_SetError( "Out of memory" );
+        if ( freesrc ) {
+            SDL_RWclose( src );
+        }
+        return NULL;
+    }
+    SDL_memset(font, 0, sizeof(*font));
+    Init_Glyph_Pool( font );
+
+    font->src = src;
+    font->freesrc = freesrc;
+
+    font->id = (Uint32)SDL_AtomicAdd( &TTF_font_serial, 1 ) + 1;
+    font->lock = SDL_CreateMutex();
+    if ( font->lock == NULL ) {
+        TTF_SetError( "Couldn't create font lock" );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+
+    font->cache_budget = CACHE_DEFAULT_BUDGET;
+    if ( Alloc_Cache( font, CACHE_MIN_SETS ) < 0 ) {
+        TTF_SetError( "Out of memory" );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+
+    if ( src->type == SDL_RWOPS_MEMORY || src->type == SDL_RWOPS_MEMORY_RO ) {
+        /* FreeType can read the data where it already is */
+        font->args.flags = FT_OPEN_MEMORY;
+        font->args.memory_base = src->hidden.mem.base + position;
+        font->args.memory_size = (FT_Long)(src->hidden.mem.stop - font->args.memory_base);
+
+    } else if ( src->type == SDL_RWOPS_JNIFILE ) {
+        /* Every small read of an Android asset is a trip through JNI, so
+           read the whole file once rather than on every glyph load */
+        Sint64 size = SDL_RWsize(src) - position;
+
+        font->mem = (size > 0) ? (Uint8 *)SDL_malloc((size_t)size) : NULL;
+        if ( font->mem == NULL ) {
+            TTF_SetError( "Out of memory" );
+            TTF_CloseFont( font );
+            return NULL;
+        }
+        if ( SDL_RWread(src, font->mem, (size_t)size, 1) != 1 ) {
+            TTF_SetError( "Couldn't read font file" );
+            TTF_CloseFont( font );
+            return NULL;
+        }
+        font->args.flags = FT_OPEN_MEMORY;
+        font->args.memory_base = font->mem;
+        font->args.memory_size = (FT_Long)size;
+
+    } else {
+        stream = (FT_Stream)SDL_malloc(sizeof(*stream));
+        if ( stream == NULL ) {
+            TTF_SetError( "Out of memory" );
+            TTF_CloseFont( font );
+            return NULL;
+        }
+        SDL_memset(stream, 0, sizeof(*stream));
+
+        stream->read = RWread;
+        stream->descriptor.pointer = src;
+        stream->pos = (unsigned long)position;
+        stream->size = (unsigned long)(SDL_RWsize(src) - position);
+
+        font->args.flags = FT_OPEN_STREAM;
+        font->args.stream = stream;
+    }
+
+    SDL_LockMutex( library_lock );
+    error = FT_Open_Face( library, &font->args, index, &font->face );
+    SDL_UnlockMutex( library_lock );
+    if ( error ) {
+        TTF_SetFTError( "Couldn't load font file", error );
+        TTF_CloseFont( font );
+        return NULL;
+    }
+    face = font->face;
+
+    /* Set charmap for loaded font, preferring a full Unicode one over
+       those limited to the BMP */
+    found = 0;
+    for (i = 0; i < face->num_charmaps; i++) {
+        FT_CharMap charmap = face->charmaps[i];
+        if ((charmap->platform_id == 3 && charmap->encoding_id == 10) /* Windows UCS-4 */
+         || (charmap->platform_id == 0 && charmap->encoding_id == 4)  /* Unicode full */
+         || (charmap->platform_id == 0 && charmap->encoding_id == 6)) { /* Unicode full (format 13) */
+            found = charmap;
+            break;
+        }
+    }
+    for (i = 0; !found && i < face->num_charmaps; i++) {
+        FT_CharMap charmap = face->charmaps[i];
+        if ((charmap->platform_id == 3 && charmap->encoding_id == 1) /* Windows Unicode */
+         || (charmap->platform_id == 3 && charmap->encoding_id == 0) /* Windows Symbol */
+         || (charmap->platform_id == 2 && charmap->encoding_id == 1) /* ISO Unicode */
+         || (charmap->platform_id == 0)) { /* Apple Unicode */
+            found = charmap;
+            break;
+        }
+    }
+    if ( found ) {
+        /* If this fails, continue using the default charmap */
+        FT_Set_Charmap(face, found);
+    }
+
+    font->size = face->size;
+    if ( Set_Font_Size( font, ptsize ) < 0 ) {
+        TTF_CloseFont( font );
+        return NULL;
+    }
+
     /* Initialize the font face style */
     font->face_style = TTF_STYLE_NORMAL;
     if ( font->face->style_flags & FT_STYLE_FLAG_BOLD ) {
@@ -526,14 +1524,101 @@ TTF_Font* TTF_OpenFontIndexRW( SDL_RWops *src, int freesrc, int ptsize, long ind
     font->style = font->face_style;
     font->outline = 0;
     font->kerning = 1;
-    font->glyph_overhang = face->size->metrics.y_ppem / 10;
-    /* x offset = cos(((90.0-12)/360)*2*M_PI), or 12 degree angle */
-    font->glyph_italics = 0.207f;
-    font->glyph_italics *= font->height;
 
+    SDL_LockMutex( library_lock );
+    font->next_font = TTF_fonts;
+    TTF_fonts = font;
+    Count_Cache( font );
+    SDL_UnlockMutex( library_lock );
+
+    Read_Glyph_File( font );
     return font;
 }
 
+static TTF_Font* Open_Font_Size( TTF_Font *font, int ptsize )
+{
+    TTF_Font *sized;
+    FT_Error error;
+
+    if ( !font->face_refs ) {
+        font->face_refs = (int *)SDL_malloc( sizeof( *font->face_refs ) );
+        if ( !font->face_refs ) {
+            TTF_SetError( "Out of memory" );
+            return NULL;
+        }
+        *font->face_refs = 1;
+    }
+
+    sized = (TTF_Font *)SDL_malloc( sizeof( *sized ) );
+    if ( sized == NULL ) {
+        TTF_SetError( "Out of memory" );
+        return NULL;
+    }
+    SDL_memset( sized, 0, sizeof( *sized ) );
+    Init_Glyph_Pool( sized );
+
+    /* The face and its stream stay open until the last of them is closed */
+    sized->face = font->face;
+    sized->face_refs = font->face_refs;
+    ++*sized->face_refs;
+    sized->src = font->src;
+    sized->freesrc = font->freesrc;
+    sized->args = font->args;
+    sized->mem = font->mem;
+
+    sized->id = (Uint32)SDL_AtomicAdd( &TTF_font_serial, 1 ) + 1;
+    sized->lock = SDL_CreateMutex();
+    if ( sized->lock == NULL ) {
+        TTF_SetError( "Couldn't create font lock" );
+        TTF_CloseFont( sized );
+        return NULL;
+    }
+
+    sized->cache_budget = CACHE_DEFAULT_BUDGET;
+    if ( Alloc_Cache( sized, CACHE_MIN_SETS ) < 0 ) {
+        TTF_SetError( "Out of memory" );
+        TTF_CloseFont( sized );
+        return NULL;
+    }
+
+    error = FT_New_Size( sized->face, &sized->size );
+    if ( error ) {
+        TTF_SetFTError( "Couldn't create font size", error );
+        TTF_CloseFont( sized );
+        return NULL;
+    }
+    FT_Activate_Size( sized->size );
+    if ( Set_Font_Size( sized, ptsize ) < 0 ) {
+        TTF_CloseFont( sized );
+        return NULL;
+    }
+
+    sized->face_style = font->face_style;
+    sized->style = sized->face_style;
+    sized->outline = 0;
+    sized->kerning = 1;
+
+    sized->next_font = TTF_fonts;
+    TTF_fonts = sized;
+    Count_Cache( sized );
+
+    Read_Glyph_File( sized );
+    return sized;
+}
+
+TTF_Font* TTF_OpenFontSize( TTF_Font *font, int ptsize )
+{
+    TTF_Font *sized;
+
+    TTF_CHECKPOINTER(font, NULL);
+
+    /* The face and its reference count are shared with the other sizes */
+    SDL_LockMutex( library_lock );
+    sized = Open_Font_Size( font, ptsize );
+    SDL_UnlockMutex( library_lock );
+    return sized;
+}
+
 TTF_Font* TTF_OpenFontRW( SDL_RWops *src, int freesrc, int ptsize )
 {
     return TTF_OpenFontIndexRW(src, freesrc, ptsize, 0);
@@ -553,53 +1638,407 @@ TTF_Font* TTF_OpenFont( const char *file, int ptsize )
     return TTF_OpenFontIndex(file, ptsize, 0);
 }
 
-static void Flush_Glyph( c_glyph* glyph )
+TTF_Font* TTF_OpenFontIndexMem( const void *mem, int size, int ptsize, long index )
 {
-    glyph->stored = 0;
-    glyph->index = 0;
-    if ( glyph->bitmap.buffer ) {
-        SDL_free( glyph->bitmap.buffer );
-        glyph->bitmap.buffer = 0;
-    }
-    if ( glyph->pixmap.buffer ) {
-        SDL_free( glyph->pixmap.buffer );
-        glyph->pixmap.buffer = 0;
+    SDL_RWops *rw = SDL_RWFromConstMem(mem, size);
+    if ( rw == NULL ) {
+        return NULL;
+    }
+    return TTF_OpenFontIndexRW(rw, 1, ptsize, index);
+}
+
+TTF_Font* TTF_OpenFontMem( const void *mem, int size, int ptsize )
+{
+    return TTF_OpenFontIndexMem(mem, size, ptsize, 0);
+}
+
+/* The glyph's images, allocated empty the first time they're asked for */
+static glyph_bits *Glyph_Bits( TTF_Font* font, c_glyph* glyph )
+{
+    if ( !glyph->bits ) {
+        glyph->bits = (glyph_bits *)Glyph_Alloc( font, sizeof( *glyph->bits ) );
+        if ( glyph->bits ) {
+            SDL_memset( glyph->bits, 0, sizeof( *glyph->bits ) );
+        }
+    }
+    return glyph->bits;
+}
+
+static void Flush_Glyph( TTF_Font* font, c_glyph* glyph )
+{
+    glyph->stored = 0;
+    glyph->index = 0;
+    if ( glyph->bits ) {
+        Glyph_Free( font, glyph->bits->bitmap.buffer );
+        Glyph_Free( font, glyph->bits->pixmap.buffer );
+        Glyph_Free( font, glyph->bits->sdf.buffer );
+        Glyph_Free( font, glyph->bits );
+        glyph->bits = NULL;
     }
+    glyph->source = 0;
+    glyph->atlas.w = 0;
     glyph->cached = 0;
 }
 
+static size_t Glyph_Bytes( const c_glyph* glyph )
+{
+    size_t size = 0;
+
+    if ( !glyph->bits ) {
+        return 0;
+    }
+    size += sizeof( *glyph->bits );
+    if ( glyph->bits->bitmap.buffer ) {
+        size += glyph->bits->bitmap.pitch * glyph->bits->bitmap.rows;
+    }
+    if ( glyph->bits->pixmap.buffer ) {
+        size += glyph->bits->pixmap.pitch * glyph->bits->pixmap.rows;
+    }
+    if ( glyph->bits->sdf.buffer ) {
+        size += glyph->bits->sdf.pitch * glyph->bits->sdf.rows;
+    }
+    return size;
+}
+
 static void Flush_Cache( TTF_Font* font )
 {
     int i;
-    int size = sizeof( font->cache ) / sizeof( font->cache[0] );
+    int size = font->cache_sets * CACHE_WAYS;
+
+    for ( i = 0; i < size; ++i ) {
+        if ( font->cache[i].stored ) {
+            Flush_Glyph( font, &font->cache[i] );
+        }
+    }
+    font->cache_bytes = 0;
+    font->cache_entries = 0;
+    ++font->generation;
+
+    /* Nothing refers to the packed glyphs any more */
+    font->atlas.x = 0;
+    font->atlas.y = 0;
+    font->atlas.shelf = 0;
+}
+
+static int Cache_Set( const TTF_Font* font, Uint32 ch, int variant )
+{
+    /* Neighbouring code points land in neighbouring sets, so a run of text
+       from one script doesn't collide with itself, and the planes above the
+       BMP don't alias onto it.  The fold must not depend on the table size,
+       or growing could overfill a set. */
+    return (int)(((ch ^ (ch >> 8) ^ (ch >> 16)) + variant * 37) & (font->cache_sets - 1));
+}
+
+/* The settings that change how a glyph is rendered, as a cache key */
+static int Glyph_Variant( const TTF_Font* font )
+{
+    int variant = 0;
+
+    if ( TTF_HANDLE_STYLE_BOLD(font) ) {
+        variant |= TTF_STYLE_BOLD;
+    }
+    if ( TTF_HANDLE_STYLE_ITALIC(font) ) {
+        variant |= TTF_STYLE_ITALIC;
+    }
+    return variant | (font->outline << 4);
+}
+
+/* Replace the slot array with an empty one of the given number of sets */
+static int Alloc_Cache( TTF_Font* font, int sets )
+{
+    c_glyph *cache;
+
+    cache = (c_glyph *)SDL_calloc( sets * CACHE_WAYS, sizeof( *cache ) );
+    if ( !cache ) {
+        return -1;
+    }
+    if ( font->cache ) {
+        Flush_Cache( font );
+        SDL_free( font->cache );
+    }
+    font->cache = cache;
+    font->cache_sets = sets;
+    font->current = NULL;
+    SDL_memset( font->ascii, 0, sizeof( font->ascii ) );
+    return 0;
+}
+
+/* Double the number of sets, keeping every cached glyph.  Each old set
+   splits across two new ones, so nothing is evicted by the move. */
+static int Grow_Cache( TTF_Font* font )
+{
+    c_glyph *old = font->cache;
+    int size = font->cache_sets * CACHE_WAYS;
+    size_t bytes = font->cache_bytes;
+    int i, way;
+
+    size_t budget = (size_t)SDL_AtomicGet( &TTF_total_budget );
+
+    if ( (size_t)size * 2 * sizeof( *old ) + bytes > font->cache_budget ) {
+        return -1;
+    }
+    if ( budget && (size_t)SDL_AtomicGet( &TTF_cache_total ) + (size_t)size * sizeof( *old ) > budget ) {
+        return -1;
+    }
+    font->cache = NULL;
+    if ( Alloc_Cache( font, font->cache_sets * 2 ) < 0 ) {
+        font->cache = old;
+        return -1;
+    }
+    for ( i = 0; i < size; ++i ) {
+        c_glyph *slot;
+
+        if ( !old[i].stored ) {
+            continue;
+        }
+        slot = &font->cache[Cache_Set( font, old[i].cached, old[i].variant ) * CACHE_WAYS];
+        for ( way = 0; slot[way].stored; ++way ) {
+            continue;
+        }
+        slot[way] = old[i];
+    }
+    font->cache_bytes = bytes;
+    SDL_free( old );
+    return 0;
+}
+
+/* Bring TTF_cache_total up to date with what the font holds now */
+static void Count_Cache( TTF_Font* font )
+{
+    size_t bytes = font->cache_sets * CACHE_WAYS * sizeof( c_glyph ) + font->cache_bytes;
+
+    SDL_AtomicAdd( &TTF_cache_total, (int)bytes - (int)font->cache_counted );
+    font->cache_counted = bytes;
+}
+
+/* Drop the least recently used glyph, returns 0 if there was none */
+static int Evict_Glyph( TTF_Font* font )
+{
+    int size = font->cache_sets * CACHE_WAYS;
+    c_glyph *victim = NULL;
+    int i;
 
     for ( i = 0; i < size; ++i ) {
-        if ( font->cache[i].cached ) {
-            Flush_Glyph( &font->cache[i] );
+        c_glyph *glyph = &font->cache[i];
+        if ( glyph == font->current || !Glyph_Bytes( glyph ) ) {
+            continue;
+        }
+        if ( !victim || (Sint32)(glyph->lru - victim->lru) < 0 ) {
+            victim = glyph;
+        }
+    }
+    if ( !victim ) {
+        return 0;
+    }
+    font->cache_bytes -= Glyph_Bytes( victim );
+    Flush_Glyph( font, victim );
+    --font->cache_entries;
+    ++font->cache_evictions;
+    return 1;
+}
+
+/* Take glyphs back from the other fonts holding more than their share of
+   the total budget.  Fonts busy in another thread are skipped, they trim
+   themselves on their next miss. */
+static void Trim_Others( TTF_Font* font, size_t budget )
+{
+    TTF_Font *other;
+    size_t share;
+    int count = 0;
+
+    SDL_LockMutex( library_lock );
+    for ( other = TTF_fonts; other; other = other->next_font ) {
+        ++count;
+    }
+    share = budget / (count ? count : 1);
+    for ( other = TTF_fonts; other; other = other->next_font ) {
+        if ( other == font || SDL_TryLockMutex( other->lock ) != 0 ) {
+            continue;
+        }
+        while ( (size_t)SDL_AtomicGet( &TTF_cache_total ) > budget &&
+                other->cache_counted > share && Evict_Glyph( other ) ) {
+            Count_Cache( other );
+        }
+        SDL_UnlockMutex( other->lock );
+        if ( (size_t)SDL_AtomicGet( &TTF_cache_total ) <= budget ) {
+            break;
+        }
+    }
+    SDL_UnlockMutex( library_lock );
+}
+
+/* Drop least recently used glyphs until the font fits its budget again,
+   and the open fonts together fit the total budget */
+static void Trim_Cache( TTF_Font* font )
+{
+    size_t slots = font->cache_sets * CACHE_WAYS * sizeof( c_glyph );
+    size_t budget = (size_t)SDL_AtomicGet( &TTF_total_budget );
+
+    while ( font->cache_bytes > 0 && slots + font->cache_bytes > font->cache_budget ) {
+        if ( !Evict_Glyph( font ) ) {
+            break;
+        }
+    }
+    Count_Cache( font );
+
+    if ( budget && (size_t)SDL_AtomicGet( &TTF_cache_total ) > budget ) {
+        Trim_Others( font, budget );
+        while ( (size_t)SDL_AtomicGet( &TTF_cache_total ) > budget && Evict_Glyph( font ) ) {
+            Count_Cache( font );
+        }
+    }
+}
+
+static char_index *Find_Char_Index( char_index *table, int size, Uint32 ch )
+{
+    int i = (int)((ch * 2654435761u) >> 8) & (size - 1);
+
+    while ( table[i].ch && table[i].ch != ch ) {
+        i = (i + 1) & (size - 1);
+    }
+    return &table[i];
+}
+
+static int Grow_Char_Index( char_index **hash, int *hash_size )
+{
+    char_index *table;
+    char_index *entry;
+    int size;
+    int i;
+
+    size = *hash_size ? *hash_size * 2 : INDEX_HASH_MIN_SIZE;
+    table = (char_index *)SDL_calloc( size, sizeof( *table ) );
+    if ( !table ) {
+        return -1;
+    }
+    for ( i = 0; i < *hash_size; ++i ) {
+        if ( (*hash)[i].ch ) {
+            entry = Find_Char_Index( table, size, (*hash)[i].ch );
+            *entry = (*hash)[i];
+        }
+    }
+    SDL_free( *hash );
+    *hash = table;
+    *hash_size = size;
+    return 0;
+}
+
+/* The cmap lookup is a binary search, so remember its answer for as long
+   as the font is open.  If the tables can't be allocated the lookup just
+   isn't remembered. */
+static FT_UInt Get_Char_Index( TTF_Font* font, Uint32 ch )
+{
+    char_index *entry;
+    FT_UInt index;
+
+    if ( ch < INDEX_DIRECT_SIZE ) {
+        if ( !font->index_direct ) {
+            font->index_direct = (FT_UInt *)SDL_calloc( INDEX_DIRECT_SIZE, sizeof( *font->index_direct ) );
+        }
+        if ( font->index_direct && font->index_direct[ch] ) {
+            return font->index_direct[ch] - 1;
+        }
+        index = FT_Get_Char_Index( font->face, ch );
+        if ( font->index_direct ) {
+            font->index_direct[ch] = index + 1;
+        }
+        return index;
+    }
+
+    if ( font->index_hash ) {
+        entry = Find_Char_Index( font->index_hash, font->index_hash_size, ch );
+        if ( entry->ch ) {
+            return entry->index;
         }
+    }
+    index = FT_Get_Char_Index( font->face, ch );
+    if ( (font->index_hash_count + 1) * 4 > font->index_hash_size * 3 ) {
+        if ( Grow_Char_Index( &font->index_hash, &font->index_hash_size ) < 0 ) {
+            return index;
+        }
+    }
+    entry = Find_Char_Index( font->index_hash, font->index_hash_size, ch );
+    entry->ch = ch;
+    entry->index = index;
+    ++font->index_hash_count;
+    return index;
+}
 
+/* Where in the chain of fonts ch is drawn from: 0 if the font has it or
+   no fallback does, else 1 + the first fallback that has it.  Called with
+   library_lock held, which the fallbacks' faces are only read under. */
+static int Glyph_Source( TTF_Font* font, Uint32 ch )
+{
+    char_index *entry;
+    int source = 0;
+    int i;
+
+    if ( !font->num_fallbacks || !ch || (ch & TTF_GLYPH_INDEX) ) {
+        return 0;
     }
+    if ( font->source_hash ) {
+        entry = Find_Char_Index( font->source_hash, font->source_hash_size, ch );
+        if ( entry->ch ) {
+            return (int)entry->index;
+        }
+    }
+    if ( !Get_Char_Index( font, ch ) ) {
+        for ( i = 0; i < font->num_fallbacks; ++i ) {
+            if ( FT_Get_Char_Index( font->fallbacks[i]->face, ch ) ) {
+                source = i + 1;
+                break;
+            }
+        }
+    }
+    if ( (font->source_hash_count + 1) * 4 > font->source_hash_size * 3 ) {
+        if ( Grow_Char_Index( &font->source_hash, &font->source_hash_size ) < 0 ) {
+            return source;
+        }
+    }
+    entry = Find_Char_Index( font->source_hash, font->source_hash_size, ch );
+    entry->ch = ch;
+    entry->index = (FT_UInt)source;
+    ++font->source_hash_count;
+    return source;
 }
 
-static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want )
+static FT_Error Load_Glyph( TTF_Font* font, Uint32 ch, c_glyph* cached, int want )
 {
+    TTF_Font *source;
     FT_Face face;
     FT_Error error;
     FT_GlyphSlot glyph;
     FT_Glyph_Metrics* metrics;
     FT_Outline* outline;
+    FT_Pos shift;
 
     if ( !font || !font->face ) {
         return FT_Err_Invalid_Handle;
     }
 
-    face = font->face;
+    /* A glyph the font lacks is loaded from a fallback's face and size,
+       then styled and placed on the baseline like one of the font's own */
+    if ( !cached->stored ) {
+        cached->source = Glyph_Source( font, ch );
+    }
+    source = cached->source ? font->fallbacks[cached->source - 1] : font;
+
+    face = source->face;
+    if ( face->size != source->size ) {
+        FT_Activate_Size( source->size );
+    }
 
     /* Load the glyph */
     if ( ! cached->index ) {
-        cached->index = FT_Get_Char_Index( face, ch );
+        if ( ch & TTF_GLYPH_INDEX ) {
+            cached->index = ch & ~TTF_GLYPH_INDEX;
+        } else if ( source == font ) {
+            cached->index = Get_Char_Index( font, ch );
+        } else {
+            cached->index = FT_Get_Char_Index( face, ch );
+        }
     }
-    error = FT_Load_Glyph( face, cached->index, FT_LOAD_DEFAULT | font->hinting);
+    error = FT_Load_Glyph( face, cached->index, FT_LOAD_DEFAULT | source->hinting);
     if ( error ) {
         return error;
     }
@@ -609,16 +2048,33 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
     metrics = &glyph->metrics;
     outline = &glyph->outline;
 
+    /* Move the outline right by the subpixel phase of this copy */
+    shift = 0;
+    if ( glyph->format == FT_GLYPH_FORMAT_OUTLINE ) {
+        shift = (cached->variant >> VARIANT_PHASE_SHIFT) % TTF_SUBPIXEL_PHASES * 64 / TTF_SUBPIXEL_PHASES;
+    }
+
     /* Get the glyph metrics if desired */
     if ( (want & CACHED_METRICS) && !(cached->stored & CACHED_METRICS) ) {
         if ( FT_IS_SCALABLE( face ) ) {
-            /* Get the bounding box */
-            cached->minx = FT_FLOOR(metrics->horiBearingX);
-            cached->maxx = FT_CEIL(metrics->horiBearingX + metrics->width);
+            /* Get the bounding box, a shifted copy covers the pixels
+               its outline lands on */
+            if ( shift ) {
+                FT_BBox cbox;
+                FT_Outline_Get_CBox( outline, &cbox );
+                cbox.xMin += shift;
+                cbox.xMax += shift;
+                cached->minx = FT_FLOOR(cbox.xMin);
+                cached->maxx = FT_CEIL(cbox.xMax);
+            } else {
+                cached->minx = FT_FLOOR(metrics->horiBearingX);
+                cached->maxx = FT_CEIL(metrics->horiBearingX + metrics->width);
+            }
             cached->maxy = FT_FLOOR(metrics->horiBearingY);
             cached->miny = cached->maxy - FT_CEIL(metrics->height);
             cached->yoffset = font->ascent - cached->maxy;
             cached->advance = FT_CEIL(metrics->horiAdvance);
+            cached->linear_advance = glyph->linearHoriAdvance >> 10;
         } else {
             /* Get the bounding box for non-scalable format.
              * Again, freetype2 fills in many of the font metrics
@@ -629,9 +2085,10 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
             cached->minx = FT_FLOOR(metrics->horiBearingX);
             cached->maxx = FT_CEIL(metrics->horiBearingX + metrics->width);
             cached->maxy = FT_FLOOR(metrics->horiBearingY);
-            cached->miny = cached->maxy - FT_CEIL(face->available_sizes[font->font_size_family].height);
+            cached->miny = cached->maxy - FT_CEIL(face->available_sizes[source->font_size_family].height);
             cached->yoffset = 0;
             cached->advance = FT_CEIL(metrics->horiAdvance);
+            cached->linear_advance = cached->advance * 64;
         }
 
         /* Adjust for bold and italic text */
@@ -663,18 +2120,21 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
 
             FT_Outline_Transform( outline, &shear );
         }
+        if ( shift ) {
+            FT_Outline_Translate( outline, shift, 0 );
+        }
 
         /* Render as outline */
         if ( (font->outline > 0) && glyph->format != FT_GLYPH_FORMAT_BITMAP ) {
-            FT_Stroker stroker;
-            FT_Get_Glyph( glyph, &bitmap_glyph );
-            error = FT_Stroker_New( library, &stroker );
-            if ( error ) {
-                return error;
+            if ( !font->stroker ) {
+                error = FT_Stroker_New( library, &font->stroker );
+                if ( error ) {
+                    return error;
+                }
             }
-            FT_Stroker_Set( stroker, font->outline * 64, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0 );
-            FT_Glyph_Stroke( &bitmap_glyph, stroker, 1 /* delete the original glyph */ );
-            FT_Stroker_Done( stroker );
+            FT_Get_Glyph( glyph, &bitmap_glyph );
+            FT_Stroker_Set( font->stroker, font->outline * 64, FT_STROKER_LINECAP_ROUND, FT_STROKER_LINEJOIN_ROUND, 0 );
+            FT_Glyph_Stroke( &bitmap_glyph, font->stroker, 1 /* delete the original glyph */ );
             /* Render the glyph */
             error = FT_Glyph_To_Bitmap( &bitmap_glyph, mono ? ft_render_mode_mono : ft_render_mode_normal, 0, 1 );
             if ( error ) {
@@ -691,12 +2151,19 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
             src = &glyph->bitmap;
         }
         /* Copy over information to cache */
+        if ( !Glyph_Bits( font, cached ) ) {
+            if ( bitmap_glyph ) {
+                FT_Done_Glyph( bitmap_glyph );
+            }
+            return FT_Err_Out_Of_Memory;
+        }
         if ( mono ) {
-            dst = &cached->bitmap;
+            dst = &cached->bits->bitmap;
         } else {
-            dst = &cached->pixmap;
+            dst = &cached->bits->pixmap;
         }
         SDL_memcpy( dst, src, sizeof( *dst ) );
+        dst->buffer = NULL;
 
         /* FT_Render_Glyph() and .fon fonts always generate a
          * two-color (black and white) glyphslot surface, even
@@ -729,7 +2196,7 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
         }
 
         if (dst->rows != 0) {
-            dst->buffer = (unsigned char *)SDL_malloc( dst->pitch * dst->rows );
+            dst->buffer = (unsigned char *)Glyph_Alloc( font, dst->pitch * dst->rows );
             if ( !dst->buffer ) {
                 return FT_Err_Out_Of_Memory;
             }
@@ -895,111 +2362,464 @@ static FT_Error Load_Glyph( TTF_Font* font, Uint16 ch, c_glyph* cached, int want
     return 0;
 }
 
-static FT_Error Find_Glyph( TTF_Font* font, Uint16 ch, int want )
+/* Turn the glyph's pixmap into a signed distance field: 128 on the edge,
+   rising by 127 / SDF_SPREAD per pixel inside and falling as much outside.
+   Partly covered pixels sit on the edge, offset by their coverage; every
+   other pixel measures to the nearest pixel on the other side of it.
+ */
+static FT_Error Build_SDF( TTF_Font* font, c_glyph* glyph )
 {
-    int retval = 0;
-    int hsize = sizeof( font->cache ) / sizeof( font->cache[0] );
+    const FT_Bitmap *src = &glyph->bits->pixmap;
+    FT_Bitmap *dst = &glyph->bits->sdf;
+    int x, y, dx, dy;
+
+    *dst = *src;
+    dst->width = src->width + SDF_SPREAD * 2;
+    dst->rows = src->rows + SDF_SPREAD * 2;
+    dst->pitch = dst->width;
+    dst->buffer = (unsigned char *)Glyph_Alloc( font, dst->pitch * dst->rows );
+    if ( !dst->buffer ) {
+        return FT_Err_Out_Of_Memory;
+    }
+
+    for ( y = 0; y < dst->rows; ++y ) {
+        for ( x = 0; x < dst->width; ++x ) {
+            int sx = x - SDF_SPREAD, sy = y - SDF_SPREAD;
+            int cov = 0, inside, best = (SDF_SPREAD + 1) * (SDF_SPREAD + 1);
+            float dist;
 
-    int h = ch % hsize;
-    font->current = &font->cache[h];
+            if ( sx >= 0 && sx < src->width && sy >= 0 && sy < src->rows ) {
+                cov = src->buffer[sy * src->pitch + sx];
+            }
+            inside = (cov >= 128);
 
-    if (font->current->cached != ch)
-        Flush_Glyph( font->current );
+            if ( cov > 0 && cov < NUM_GRAYS - 1 ) {
+                dist = (cov - 127.5f) / (NUM_GRAYS - 1);
+            } else {
+                for ( dy = -SDF_SPREAD; dy <= SDF_SPREAD; ++dy ) {
+                    int ty = sy + dy;
+                    for ( dx = -SDF_SPREAD; dx <= SDF_SPREAD; ++dx ) {
+                        int tx = sx + dx, other = 0;
+                        if ( tx >= 0 && tx < src->width && ty >= 0 && ty < src->rows ) {
+                            other = src->buffer[ty * src->pitch + tx];
+                        }
+                        if ( (other >= 128) != inside && dx * dx + dy * dy < best ) {
+                            best = dx * dx + dy * dy;
+                        }
+                    }
+                }
+                dist = (float)SDL_sqrt( (double)best ) - 0.5f;
+                if ( !inside ) {
+                    dist = -dist;
+                }
+            }
 
-    if ( (font->current->stored & want) != want ) {
-        retval = Load_Glyph( font, ch, font->current, want );
+            dist = 128.0f + dist * 127.0f / SDF_SPREAD;
+            dst->buffer[y * dst->pitch + x] = (unsigned char)(dist < 0.0f ? 0 : dist > 255.0f ? 255 : dist + 0.5f);
+        }
     }
-    return retval;
+    glyph->stored |= CACHED_SDF;
+    return 0;
 }
 
-void TTF_CloseFont( TTF_Font* font )
+/* The slot caching ch in the given variant, or a free or least recently
+   used one emptied for it */
+static c_glyph *Claim_Glyph( TTF_Font* font, Uint32 ch, int variant )
 {
-    if ( font ) {
-        Flush_Cache( font );
-        if ( font->face ) {
-            FT_Done_Face( font->face );
+    c_glyph *slot;
+    c_glyph *glyph = NULL;
+    int way;
+
+    slot = &font->cache[Cache_Set( font, ch, variant ) * CACHE_WAYS];
+    for ( way = 0; way < CACHE_WAYS; ++way ) {
+        if ( slot[way].stored && slot[way].cached == ch && slot[way].variant == variant ) {
+            glyph = &slot[way];
+            break;
         }
-        if ( font->args.stream ) {
-            SDL_free( font->args.stream );
+    }
+
+    if ( !glyph ) {
+        /* Take a free way, or grow rather than evict while we can afford it */
+        for ( way = 0; way < CACHE_WAYS && slot[way].stored; ++way ) {
+            continue;
         }
-        if ( font->freesrc ) {
-            SDL_RWclose( font->src );
+        if ( way == CACHE_WAYS && Grow_Cache( font ) == 0 ) {
+            return Claim_Glyph( font, ch, variant );
         }
-        SDL_free( font );
+        if ( way == CACHE_WAYS ) {
+            glyph = &slot[0];
+            for ( way = 1; way < CACHE_WAYS; ++way ) {
+                if ( (Sint32)(slot[way].lru - glyph->lru) < 0 ) {
+                    glyph = &slot[way];
+                }
+            }
+            font->cache_bytes -= Glyph_Bytes( glyph );
+            --font->cache_entries;
+            ++font->cache_evictions;
+        } else {
+            glyph = &slot[way];
+        }
+        Flush_Glyph( font, glyph );
+        glyph->cached = ch;
+        glyph->variant = variant;
     }
+    return glyph;
 }
 
-/* Gets the number of bytes used by a null terminated UCS2 string */
-static size_t UCS2_len(const Uint16 *text)
+static FT_Error Find_Glyph_Variant( TTF_Font* font, Uint32 ch, int want, int variant )
 {
-    size_t count = 0;
-    while (*text++) {
-        ++count;
-    }
-    return count * sizeof(*text);
-}
+    int retval = 0;
+    c_glyph *glyph;
 
-/* Convert a Latin-1 string to a UTF-8 string */
-static void LATIN1_to_UTF8(const char *src, Uint8 *dst)
-{
-    while (*src) {
-        Uint8 ch = *(Uint8*)src++;
-        if (ch <= 0x7F) {
-            *dst++ = ch;
+    glyph = Claim_Glyph( font, ch, variant );
+    font->current = glyph;
+    glyph->lru = ++font->cache_tick;
+
+    if ( (glyph->stored & want) == want ) {
+        ++font->cache_hits;
+    } else {
+        size_t bytes = Glyph_Bytes( glyph );
+        int empty = !glyph->stored;
+
+        ++font->cache_misses;
+
+        /* The distance field is built from the pixmap, not by FreeType */
+        if ( want & CACHED_SDF ) {
+            want = (want & ~CACHED_SDF) | CACHED_PIXMAP;
+            if ( (glyph->stored & want) != want ) {
+                TTF_TRACE_BEGIN( "Load_Glyph" );
+                SDL_LockMutex( library_lock );
+                retval = Load_Glyph( font, ch, glyph, want );
+                SDL_UnlockMutex( library_lock );
+                TTF_TRACE_END();
+            }
+            if ( !retval && !(glyph->stored & CACHED_SDF) ) {
+                retval = Build_SDF( font, glyph );
+            }
         } else {
-            *dst++ = 0xC0 | ((ch >> 6) & 0x1F);
-            *dst++ = 0x80 | (ch & 0x3F);
+            TTF_TRACE_BEGIN( "Load_Glyph" );
+            SDL_LockMutex( library_lock );
+            retval = Load_Glyph( font, ch, glyph, want );
+            SDL_UnlockMutex( library_lock );
+            TTF_TRACE_END();
         }
+        font->cache_bytes += Glyph_Bytes( glyph ) - bytes;
+        if ( empty && glyph->stored ) {
+            ++font->cache_entries;
+        }
+        font->glyphs_added = 1;
+        Trim_Cache( font );
     }
-    *dst = '\0';
+    return retval;
 }
 
-/* Convert a UCS-2 string to a UTF-8 string */
-static void UCS2_to_UTF8(const Uint16 *src, Uint8 *dst)
+static FT_Error Find_Glyph( TTF_Font* font, Uint32 ch, int want )
 {
-    int swapped = TTF_byteswapped;
+    return Find_Glyph_Variant( font, ch, want, font->variant );
+}
 
-    while (*src) {
-        Uint16 ch = *(Uint16*)src++;
-        if (ch == UNICODE_BOM_NATIVE) {
-            swapped = 0;
-            continue;
-        }
-        if (ch == UNICODE_BOM_SWAPPED) {
-            swapped = 1;
-            continue;
-        }
-        if (swapped) {
-            ch = SDL_Swap16(ch);
-        }
-        if (ch <= 0x7F) {
-            *dst++ = (Uint8) ch;
-        } else if (ch <= 0x7FF) {
-            *dst++ = 0xC0 | (Uint8) ((ch >> 6) & 0x1F);
-            *dst++ = 0x80 | (Uint8) (ch & 0x3F);
-        } else {
-            *dst++ = 0xE0 | (Uint8) ((ch >> 12) & 0x0F);
-            *dst++ = 0x80 | (Uint8) ((ch >> 6) & 0x3F);
-            *dst++ = 0x80 | (Uint8) (ch & 0x3F);
-        }
+/* Find_Glyph() for code points below ASCII_GLYPHS, which checks the slot
+   the character was last found in before searching its set.  The slot
+   may since have been emptied or given to another glyph, but it's always
+   in the current slot array since Alloc_Cache() clears the table. */
+static FT_Error Find_ASCII_Glyph( TTF_Font* font, Uint32 ch, int want )
+{
+    c_glyph *glyph = font->ascii[ch];
+    FT_Error error;
+
+    if ( glyph && glyph->cached == ch && glyph->variant == font->variant &&
+         (glyph->stored & want) == want ) {
+        font->current = glyph;
+        glyph->lru = ++font->cache_tick;
+        ++font->cache_hits;
+        return 0;
     }
-    *dst = '\0';
+    error = Find_Glyph( font, ch, want );
+    if ( !error ) {
+        font->ascii[ch] = font->current;
+    }
+    return error;
 }
 
-/* Gets a unicode value from a UTF-8 encoded string and advance the string */
-#define UNKNOWN_UNICODE 0xFFFD
-static Uint32 UTF8_getch(const char **src, size_t *srclen)
+/* Find the copy of a glyph rendered at the phase the layout placed it at */
+static FT_Error Find_Run_Glyph( TTF_Font* font, const TTF_RunGlyph* placed, int want )
 {
-    const Uint8 *p = *(const Uint8**)src;
-    size_t left = 0;
-    SDL_bool overlong = SDL_FALSE;
-    SDL_bool underflow = SDL_FALSE;
-    Uint32 ch = UNKNOWN_UNICODE;
-
-    if (*srclen == 0) {
-        return UNKNOWN_UNICODE;
+    if ( placed->ch < ASCII_GLYPHS && !placed->phase ) {
+        return Find_ASCII_Glyph( font, placed->ch, want );
     }
-    if (p[0] >= 0xFC) {
+    return Find_Glyph_Variant( font, placed->ch, want,
+                               font->variant | (placed->phase << VARIANT_PHASE_SHIFT) );
+}
+
+/* The face size never changes after the font is opened, so neither do
+   the kerning deltas and the table is never flushed */
+static FT_Error Get_Kerning( TTF_Font* font, FT_UInt prev_index, FT_UInt index, int* delta )
+{
+    kern_pair *entry = NULL;
+    Uint32 pair = 0;
+    FT_Vector vec;
+    FT_Error error;
+
+    *delta = 0;
+    if ( prev_index <= 0xFFFF && index <= 0xFFFF ) {
+        pair = (prev_index << 16) | index;
+    }
+    if ( pair ) {
+        if ( !font->kern_cache ) {
+            font->kern_cache = (kern_pair *)SDL_calloc( KERN_CACHE_SIZE, sizeof( *font->kern_cache ) );
+        }
+        if ( font->kern_cache ) {
+            entry = &font->kern_cache[(prev_index * 31 + index) & (KERN_CACHE_SIZE - 1)];
+            if ( entry->pair == pair ) {
+                *delta = entry->delta;
+                return 0;
+            }
+        }
+    }
+
+    SDL_LockMutex( library_lock );
+    if ( font->face->size != font->size ) {
+        FT_Activate_Size( font->size );
+    }
+    error = FT_Get_Kerning( font->face, prev_index, index, ft_kerning_default, &vec );
+    SDL_UnlockMutex( library_lock );
+    if ( error ) {
+        return error;
+    }
+    *delta = vec.x >> 6;
+    if ( entry ) {
+        entry->pair = pair;
+        entry->delta = *delta;
+    }
+    return 0;
+}
+
+static void Free_Shapes( TTF_Font* font )
+{
+    int i;
+
+    if ( font->shapes ) {
+        for ( i = 0; i < SHAPE_CACHE_SIZE; ++i ) {
+            SDL_free( font->shapes[i].text );
+            SDL_free( font->shapes[i].glyphs );
+        }
+        SDL_free( font->shapes );
+        font->shapes = NULL;
+    }
+#ifdef TTF_USE_HARFBUZZ
+    if ( font->hb_font ) {
+        hb_font_destroy( font->hb_font );
+        font->hb_font = NULL;
+    }
+#endif
+}
+
+void TTF_CloseFont( TTF_Font* font )
+{
+    TTF_Font **link;
+    int shared;
+
+    if ( font ) {
+        if ( font->glyphs_added ) {
+            Write_Glyph_File( font );
+        }
+
+        /* No other font may trim this one from here on */
+        SDL_LockMutex( library_lock );
+        for ( link = &TTF_fonts; *link; link = &(*link)->next_font ) {
+            if ( *link == font ) {
+                *link = font->next_font;
+                break;
+            }
+        }
+        SDL_AtomicAdd( &TTF_cache_total, -(int)font->cache_counted );
+        SDL_UnlockMutex( library_lock );
+
+        Clear_Font_Atlas( font );
+        if ( font->cache ) {
+            Flush_Cache( font );
+            SDL_free( font->cache );
+        }
+        Arena_Done( &font->pool );
+        SDL_free( font->run.glyphs );
+        SDL_free( font->lines );
+        SDL_free( font->kern_cache );
+        SDL_free( font->index_direct );
+        SDL_free( font->index_hash );
+        SDL_free( font->fallbacks );
+        SDL_free( font->source_hash );
+        Free_Shapes( font );
+        if ( font->stroker ) {
+            FT_Stroker_Done( font->stroker );
+        }
+        if ( font->lock ) {
+            SDL_DestroyMutex( font->lock );
+        }
+        SDL_LockMutex( library_lock );
+        shared = ( font->face_refs && --*font->face_refs > 0 );
+        if ( shared ) {
+            /* Other sizes still use the face, only drop ours */
+            if ( font->size ) {
+                FT_Done_Size( font->size );
+            }
+        } else {
+            SDL_free( font->face_refs );
+            if ( font->face ) {
+                FT_Done_Face( font->face );
+            }
+        }
+        SDL_UnlockMutex( library_lock );
+        if ( shared ) {
+            SDL_free( font );
+            return;
+        }
+        if ( font->args.stream ) {
+            SDL_free( font->args.stream );
+        }
+        SDL_free( font->mem );
+        if ( font->freesrc ) {
+            SDL_RWclose( font->src );
+        }
+        SDL_free( font );
+    }
+}
+
+/* Gets the number of bytes used by a null terminated UCS2 string */
+static size_t UCS2_len(const Uint16 *text)
+{
+    size_t count = 0;
+    while (*text++) {
+        ++count;
+    }
+    return count * sizeof(*text);
+}
+
+/* Convert a Latin-1 string to a UTF-8 string */
+static void LATIN1_to_UTF8(const char *src, Uint8 *dst)
+{
+    while (*src) {
+        Uint8 ch = *(Uint8*)src++;
+        if (ch <= 0x7F) {
+            *dst++ = ch;
+        } else {
+            *dst++ = 0xC0 | ((ch >> 6) & 0x1F);
+            *dst++ = 0x80 | (ch & 0x3F);
+        }
+    }
+    *dst = '\0';
+}
+
+/* Convert a code point to UTF-8, returning the end of the sequence */
+static Uint8 *UCS4_to_UTF8(Uint32 ch, Uint8 *dst)
+{
+    if (ch <= 0x7F) {
+        *dst++ = (Uint8) ch;
+    } else if (ch <= 0x7FF) {
+        *dst++ = 0xC0 | (Uint8) ((ch >> 6) & 0x1F);
+        *dst++ = 0x80 | (Uint8) (ch & 0x3F);
+    } else if (ch <= 0xFFFF) {
+        *dst++ = 0xE0 | (Uint8) ((ch >> 12) & 0x0F);
+        *dst++ = 0x80 | (Uint8) ((ch >> 6) & 0x3F);
+        *dst++ = 0x80 | (Uint8) (ch & 0x3F);
+    } else {
+        *dst++ = 0xF0 | (Uint8) ((ch >> 18) & 0x07);
+        *dst++ = 0x80 | (Uint8) ((ch >> 12) & 0x3F);
+        *dst++ = 0x80 | (Uint8) ((ch >> 6) & 0x3F);
+        *dst++ = 0x80 | (Uint8) (ch & 0x3F);
+    }
+    return dst;
+}
+
+/* Convert a UCS-2 string to a UTF-8 string, joining surrogate pairs into
+   the code points above the BMP they stand for */
+static void UCS2_to_UTF8(const Uint16 *src, Uint8 *dst)
+{
+    int swapped = TTF_byteswapped;
+
+    while (*src) {
+        Uint32 ch = *(Uint16*)src++;
+        if (ch == UNICODE_BOM_NATIVE) {
+            swapped = 0;
+            continue;
+        }
+        if (ch == UNICODE_BOM_SWAPPED) {
+            swapped = 1;
+            continue;
+        }
+        if (swapped) {
+            ch = SDL_Swap16((Uint16)ch);
+        }
+        if (ch >= 0xD800 && ch <= 0xDBFF) {
+            Uint16 low = swapped ? SDL_Swap16(*src) : *src;
+            if (low >= 0xDC00 && low <= 0xDFFF) {
+                ch = 0x10000 + ((ch - 0xD800) << 10) + (low - 0xDC00);
+                ++src;
+            }
+        }
+        dst = UCS4_to_UTF8(ch, dst);
+    }
+    *dst = '\0';
+}
+
+/* The number of bytes at the start of text below 0x80, which are their
+   own code points and need no decoding.  The text is tested 16 bytes at a
+   time for a set high bit where the SIMD units allow, else a word at a
+   time. */
+static size_t ASCII_Span(const char *text, size_t textlen)
+{
+    const Uint8 *p = (const Uint8 *)text;
+    const Uint8 *end = p + textlen;
+    const size_t high = (size_t)~0 / 0xFF * 0x80;
+    size_t word;
+
+#ifdef HAVE_NEON_INTRINSICS
+    if (TTF_has_neon) {
+        while (end - p >= 16) {
+            uint64x2_t h = vreinterpretq_u64_u8(vandq_u8(vld1q_u8(p), vdupq_n_u8(0x80)));
+            if (vgetq_lane_u64(h, 0) | vgetq_lane_u64(h, 1)) {
+                break;
+            }
+            p += 16;
+        }
+    }
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+    if (TTF_has_sse2) {
+        while (end - p >= 16) {
+            if (_mm_movemask_epi8(_mm_loadu_si128((const __m128i *)p))) {
+                break;
+            }
+            p += 16;
+        }
+    }
+#endif
+    while ((size_t)(end - p) >= sizeof(word)) {
+        SDL_memcpy(&word, p, sizeof(word));
+        if (word & high) {
+            break;
+        }
+        p += sizeof(word);
+    }
+    while (p < end && !(*p & 0x80)) {
+        ++p;
+    }
+    return p - (const Uint8 *)text;
+}
+
+/* Gets a unicode value from a UTF-8 encoded string and advance the string */
+#define UNKNOWN_UNICODE 0xFFFD
+static Uint32 UTF8_getch(const char **src, size_t *srclen)
+{
+    const Uint8 *p = *(const Uint8**)src;
+    size_t left = 0;
+    SDL_bool overlong = SDL_FALSE;
+    SDL_bool underflow = SDL_FALSE;
+    Uint32 ch = UNKNOWN_UNICODE;
+
+    if (*srclen == 0) {
+        return UNKNOWN_UNICODE;
+    }
+    if (p[0] >= 0xFC) {
         if ((p[0] & 0xFE) == 0xFC) {
             if (p[0] == 0xFC && (p[1] & 0xFC) == 0x80) {
                 overlong = SDL_TRUE;
@@ -1103,7 +2923,53 @@ int TTF_GetFontKerning(const TTF_Font *font)
 
 void TTF_SetFontKerning(TTF_Font *font, int allowed)
 {
+    SDL_LockMutex(font->lock);
+    if ( font->kerning != allowed ) {
+        ++font->generation;
+    }
     font->kerning = allowed;
+    SDL_UnlockMutex(font->lock);
+}
+
+int TTF_GetFontShaping(const TTF_Font *font)
+{
+    return(font->shaping);
+}
+
+int TTF_SetFontShaping(TTF_Font *font, int shaping)
+{
+    if ( shaping != TTF_SHAPING_NONE && shaping != TTF_SHAPING_LTR && shaping != TTF_SHAPING_RTL ) {
+        TTF_SetError("Unknown shaping %d", shaping);
+        return -1;
+    }
+#ifndef TTF_USE_HARFBUZZ
+    if ( shaping != TTF_SHAPING_NONE ) {
+        TTF_SetError("SDL_ttf was built without HarfBuzz");
+        return -1;
+    }
+#endif
+    SDL_LockMutex(font->lock);
+    if ( font->shaping != shaping ) {
+        ++font->generation;
+    }
+    font->shaping = shaping;
+    SDL_UnlockMutex(font->lock);
+    return 0;
+}
+
+int TTF_GetFontSubpixel(const TTF_Font *font)
+{
+    return(font->subpixel);
+}
+
+void TTF_SetFontSubpixel(TTF_Font *font, int allowed)
+{
+    SDL_LockMutex(font->lock);
+    if ( font->subpixel != allowed ) {
+        ++font->generation;
+    }
+    font->subpixel = allowed;
+    SDL_UnlockMutex(font->lock);
 }
 
 long TTF_FontFaces(const TTF_Font *font)
@@ -1128,17 +2994,27 @@ char *TTF_FontFaceStyleName(const TTF_Font *font)
 
 int TTF_GlyphIsProvided(const TTF_Font *font, Uint16 ch)
 {
-  return(FT_Get_Char_Index(font->face, ch));
+  return TTF_GlyphIsProvided32(font, ch);
 }
 
-int TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
+int TTF_GlyphIsProvided32(const TTF_Font *font, Uint32 ch)
+{
+  int index;
+
+  SDL_LockMutex(library_lock);
+  index = FT_Get_Char_Index(font->face, ch);
+  SDL_UnlockMutex(library_lock);
+  return(index);
+}
+
+static int Glyph_Metrics(TTF_Font *font, Uint32 ch,
                      int* minx, int* maxx, int* miny, int* maxy, int* advance)
 {
     FT_Error error;
 
     error = Find_Glyph(font, ch, CACHED_METRICS);
     if ( error ) {
-        TTF_SetFTError("Couldn't find glyph", error);
+        TTF_SetGlyphError(error);
         return -1;
     }
 
@@ -1166,6 +3042,23 @@ int TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
     return 0;
 }
 
+int TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
+                     int* minx, int* maxx, int* miny, int* maxy, int* advance)
+{
+    return TTF_GlyphMetrics32(font, ch, minx, maxx, miny, maxy, advance);
+}
+
+int TTF_GlyphMetrics32(TTF_Font *font, Uint32 ch,
+                     int* minx, int* maxx, int* miny, int* maxy, int* advance)
+{
+    int status;
+
+    SDL_LockMutex(font->lock);
+    status = Glyph_Metrics(font, ch, minx, maxx, miny, maxy, advance);
+    SDL_UnlockMutex(font->lock);
+    return status;
+}
+
 int TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h)
 {
     int status = -1;
@@ -1184,25 +3077,187 @@ int TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h)
     return status;
 }
 
-int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
+/* Decode, kern and measure the text once, recording where each glyph goes.
+   The renderers then only have to look the glyphs up again to draw them.
+ */
+/* Find the glyph of c and where it goes, after kerning it against the
+   previous glyph.  The pen is kept in 26.6 so fractional advances add up;
+   the glyph lands at *x pixels plus *phase subpixel steps, and is left in
+   font->current rendered at that phase.
+ */
+static FT_Error Place_Glyph(TTF_Font *font, Uint32 c, FT_Long use_kerning,
+                FT_UInt prev_index, FT_Pos *pen, int *x, int *phase)
+{
+    FT_Error error;
+    FT_Pos steps;
+    int delta;
+
+    if ( c < ASCII_GLYPHS ) {
+        error = Find_ASCII_Glyph(font, c, CACHED_METRICS);
+    } else {
+        error = Find_Glyph(font, c, CACHED_METRICS);
+    }
+    if ( error ) {
+        return error;
+    }
+    if ( use_kerning && prev_index && font->current->index && !font->current->source ) {
+        Get_Kerning( font, prev_index, font->current->index, &delta );
+        *pen += delta * 64;
+    }
+
+    /* Round to the nearest phase, the whole pixel lands on *x */
+    steps = *pen * TTF_SUBPIXEL_PHASES + 32;
+    steps = FT_FLOOR( steps );
+    *phase = (int)(steps & (TTF_SUBPIXEL_PHASES - 1));
+    *x = (int)((steps - *phase) / TTF_SUBPIXEL_PHASES);
+    if ( *phase ) {
+        error = Find_Glyph_Variant(font, c, CACHED_METRICS,
+                                   font->variant | (*phase << VARIANT_PHASE_SHIFT));
+    }
+    return error;
+}
+
+/* How far a glyph moves the pen, in 26.6 */
+static FT_Pos Glyph_Advance(const TTF_Font *font, const c_glyph *glyph)
+{
+    if ( font->subpixel && FT_IS_SCALABLE( font->face ) ) {
+        return glyph->linear_advance;
+    }
+    return glyph->advance * 64;
+}
+
+#ifdef TTF_USE_HARFBUZZ
+/* The shaping of text in the font's direction, from the cache if the
+   string was shaped before with the same hinting and kerning, else from
+   HarfBuzz in place of the least recently used entry */
+static shaped_text *Shape_Text(TTF_Font *font, const char *text, size_t textlen)
+{
+    Uint32 hash = Hash_Bytes(2166136261u, text, textlen);
+    shaped_text *entry;
+    shaped_text *victim;
+    shaped_glyph *glyphs;
+    char *copy;
+    hb_buffer_t *buffer;
+    hb_glyph_info_t *info;
+    hb_glyph_position_t *pos;
+    hb_feature_t kern;
+    unsigned int count, i;
+
+    if ( !font->shapes ) {
+        font->shapes = (shaped_text *)SDL_calloc(SHAPE_CACHE_SIZE, sizeof(*font->shapes));
+        if ( !font->shapes ) {
+            TTF_SetError("Out of memory");
+            return NULL;
+        }
+    }
+    victim = &font->shapes[0];
+    for ( i = 0; i < SHAPE_CACHE_SIZE; ++i ) {
+        entry = &font->shapes[i];
+        if ( !entry->text ) {
+            if ( victim->text ) {
+                victim = entry;
+            }
+            continue;
+        }
+        if ( entry->hash == hash && entry->len == textlen &&
+             entry->shaping == font->shaping && entry->hinting == font->hinting &&
+             entry->kerning == font->kerning && SDL_memcmp(entry->text, text, textlen) == 0 ) {
+            entry->lru = ++font->shape_tick;
+            return entry;
+        }
+        if ( victim->text && (Sint32)(entry->lru - victim->lru) < 0 ) {
+            victim = entry;
+        }
+    }
+
+    buffer = hb_buffer_create();
+    hb_buffer_add_utf8(buffer, text, (int)textlen, 0, (int)textlen);
+    hb_buffer_set_direction(buffer, font->shaping == TTF_SHAPING_RTL ? HB_DIRECTION_RTL : HB_DIRECTION_LTR);
+    hb_buffer_guess_segment_properties(buffer);
+    kern.tag = HB_TAG('k', 'e', 'r', 'n');
+    kern.value = font->kerning ? 1 : 0;
+    kern.start = 0;
+    kern.end = (unsigned int)-1;
+
+    /* HarfBuzz reads the face at whichever size is active */
+    SDL_LockMutex(library_lock);
+    if ( font->face->size != font->size ) {
+        FT_Activate_Size(font->size);
+    }
+    if ( !font->hb_font ) {
+        font->hb_font = hb_ft_font_create(font->face, NULL);
+    }
+    hb_ft_font_changed(font->hb_font);
+    hb_ft_font_set_load_flags(font->hb_font, FT_LOAD_DEFAULT | font->hinting);
+    hb_shape(font->hb_font, buffer, &kern, 1);
+    SDL_UnlockMutex(library_lock);
+
+    if ( !hb_buffer_allocation_successful(buffer) ) {
+        hb_buffer_destroy(buffer);
+        TTF_SetError("Out of memory");
+        return NULL;
+    }
+    info = hb_buffer_get_glyph_infos(buffer, &count);
+    pos = hb_buffer_get_glyph_positions(buffer, &count);
+    glyphs = (shaped_glyph *)SDL_malloc(SDL_max(count, 1) * sizeof(*glyphs));
+    copy = (char *)SDL_malloc(SDL_max(textlen, 1));
+    if ( !glyphs || !copy ) {
+        SDL_free(glyphs);
+        SDL_free(copy);
+        hb_buffer_destroy(buffer);
+        TTF_SetError("Out of memory");
+        return NULL;
+    }
+    for ( i = 0; i < count; ++i ) {
+        glyphs[i].index = info[i].codepoint;
+        glyphs[i].x_advance = pos[i].x_advance;
+        glyphs[i].x_offset = pos[i].x_offset;
+        glyphs[i].y_offset = pos[i].y_offset;
+    }
+    hb_buffer_destroy(buffer);
+    SDL_memcpy(copy, text, textlen);
+
+    SDL_free(victim->text);
+    SDL_free(victim->glyphs);
+    victim->hash = hash;
+    victim->shaping = font->shaping;
+    victim->hinting = font->hinting;
+    victim->kerning = font->kerning;
+    victim->text = copy;
+    victim->len = textlen;
+    victim->glyphs = glyphs;
+    victim->num_glyphs = (int)count;
+    victim->lru = ++font->shape_tick;
+    return victim;
+}
+#endif /* TTF_USE_HARFBUZZ */
+
+static int Layout_Span(TTF_Font *font, const char *text, size_t textlen, TTF_TextRun *run)
 {
-    int status;
     int x, z;
+    int phase;
+    FT_Pos pen;
     int minx, maxx;
     int miny, maxy;
+    int xoffset;
     c_glyph *glyph;
     FT_Error error;
     FT_Long use_kerning;
     FT_UInt prev_index = 0;
     int outline_delta = 0;
-    size_t textlen;
-
-    TTF_CHECKPOINTER(text, -1);
+    size_t ascii = 0;
+    shaped_text *shape = NULL;
+    int shaped = 0;
+    FT_Pos next = 0;
 
     /* Initialize everything to 0 */
-    status = 0;
+    run->font = font;
+    run->generation = font->generation;
+    run->num_glyphs = 0;
+    run->w = run->h = 0;
     minx = maxx = 0;
     miny = maxy = 0;
+    xoffset = 0;
 
     /* check kerning */
     use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
@@ -1212,47 +3267,73 @@ int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
         outline_delta = font->outline * 2;
     }
 
+#ifdef TTF_USE_HARFBUZZ
+    if ( font->shaping != TTF_SHAPING_NONE ) {
+        shape = Shape_Text(font, text, textlen);
+        if ( !shape ) {
+            return -1;
+        }
+        use_kerning = 0;
+    }
+#endif
+
     /* Load each character and sum it's bounding box */
-    textlen = SDL_strlen(text);
-    x= 0;
-    while ( textlen > 0 ) {
-        Uint16 c = UTF8_getch(&text, &textlen);
-        if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
-            continue;
+    pen = 0;
+    while ( shape ? shaped < shape->num_glyphs : textlen > 0 ) {
+        Uint32 c;
+        int y = 0;
+
+        if ( shape ) {
+            /* Shaped glyphs are placed by index where HarfBuzz put them */
+            const shaped_glyph *placed = &shape->glyphs[shaped++];
+            c = TTF_GLYPH_INDEX | placed->index;
+            next = pen + placed->x_advance;
+            pen += placed->x_offset;
+            y = FT_FLOOR((32 - placed->y_offset));
+        } else {
+            /* ASCII runs are taken a byte at a time, they can't hold a BOM */
+            if ( ascii == 0 ) {
+                ascii = ASCII_Span(text, textlen);
+            }
+            if ( ascii > 0 ) {
+                c = (Uint8)*text++;
+                --textlen;
+                --ascii;
+            } else {
+                c = UTF8_getch(&text, &textlen);
+                if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
+                    continue;
+                }
+            }
         }
 
-        error = Find_Glyph(font, c, CACHED_METRICS);
+        error = Place_Glyph(font, c, use_kerning, prev_index, &pen, &x, &phase);
         if ( error ) {
-            TTF_SetFTError("Couldn't find glyph", error);
+            TTF_SetGlyphError(error);
             return -1;
         }
         glyph = font->current;
 
-        /* handle kerning */
-        if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            x += delta.x >> 6;
-        }
-
-#if 0
-        if ( (ch == text) && (glyph->minx < 0) ) {
-        /* Fixes the texture wrapping bug when the first letter
-         * has a negative minx value or horibearing value.  The entire
-         * bounding box must be adjusted to be bigger so the entire
-         * letter can fit without any texture corruption or wrapping.
-         *
-         * Effects: First enlarges bounding box.
-         * Second, xstart has to start ahead of its normal spot in the
-         * negative direction of the negative minx value.
-         * (pushes everything to the right).
-         *
-         * This will make the memory copy of the glyph bitmap data
-         * work out correctly.
-         * */
-            z -= glyph->minx;
+        /* Compensate for the wrap around bug with negative minx's */
+        if ( run->num_glyphs == 0 && glyph->minx < 0 ) {
+            xoffset = -glyph->minx;
         }
-#endif
+
+        if ( run->num_glyphs == run->max_glyphs ) {
+            int size = run->max_glyphs ? run->max_glyphs * 2 : 64;
+            TTF_RunGlyph *glyphs = (TTF_RunGlyph *)SDL_realloc( run->glyphs, size * sizeof( *glyphs ) );
+            if ( !glyphs ) {
+                TTF_SetError( "Out of memory" );
+                return -1;
+            }
+            run->glyphs = glyphs;
+            run->max_glyphs = size;
+        }
+        run->glyphs[run->num_glyphs].ch = c;
+        run->glyphs[run->num_glyphs].x = x + xoffset;
+        run->glyphs[run->num_glyphs].phase = phase;
+        run->glyphs[run->num_glyphs].y = y;
+        ++run->num_glyphs;
 
         z = x + glyph->minx;
         if ( minx > z ) {
@@ -1260,6 +3341,8 @@ int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
         }
         if ( TTF_HANDLE_STYLE_BOLD(font) ) {
             x += font->glyph_overhang;
+            pen += font->glyph_overhang * 64;
+            next += font->glyph_overhang * 64;
         }
         if ( glyph->advance > glyph->maxx ) {
             z = x + glyph->advance;
@@ -1269,58 +3352,205 @@ int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
         if ( maxx < z ) {
             maxx = z;
         }
-        x += glyph->advance;
+        if ( shape ) {
+            pen = next;
+        } else {
+            pen += Glyph_Advance(font, glyph);
+        }
 
-        if ( glyph->miny < miny ) {
-            miny = glyph->miny;
+        if ( glyph->miny - y < miny ) {
+            miny = glyph->miny - y;
         }
-        if ( glyph->maxy > maxy ) {
-            maxy = glyph->maxy;
+        if ( glyph->maxy - y > maxy ) {
+            maxy = glyph->maxy - y;
         }
-        prev_index = glyph->index;
+        prev_index = glyph->source ? 0 : glyph->index;
     }
 
     /* Fill the bounds rectangle */
-    if ( w ) {
-        /* Add outline extra width */
-        *w = (maxx - minx) + outline_delta;
-    }
-    if ( h ) {
-        /* Some fonts descend below font height (FletcherGothicFLF) */
-        /* Add outline extra height */
-        *h = (font->ascent - miny) + outline_delta;
-        if ( *h < font->height ) {
-            *h = font->height;
-        }
-        /* Update height according to the needs of the underline style */
-        if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
-            int bottom_row = TTF_underline_bottom_row(font);
-            if ( *h < bottom_row ) {
-                *h = bottom_row;
-            }
+    /* Add outline extra width */
+    run->w = (maxx - minx) + outline_delta;
+
+    /* Some fonts descend below font height (FletcherGothicFLF) */
+    /* Add outline extra height */
+    run->h = (font->ascent - miny) + outline_delta;
+    if ( run->h < font->height ) {
+        run->h = font->height;
+    }
+    /* Update height according to the needs of the underline style */
+    if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+        int bottom_row = TTF_underline_bottom_row(font);
+        if ( run->h < bottom_row ) {
+            run->h = bottom_row;
         }
     }
-    return status;
+    return 0;
 }
 
-int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
+static int TTF_Layout(TTF_Font *font, const char *text, TTF_TextRun *run)
 {
-    int status = -1;
-    Uint8 *utf8;
-
-    TTF_CHECKPOINTER(text, -1);
+    return Layout_Span(font, text, SDL_strlen(text), run);
+}
 
-    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
-    if ( utf8 ) {
-        UCS2_to_UTF8(text, utf8);
-        status = TTF_SizeUTF8(font, (char *)utf8, w, h);
+/* Lay the run out again if the font settings changed since it was made */
+static int Refresh_Run(TTF_TextRun *run)
+{
+    if ( run->generation == run->font->generation ) {
+        return 0;
+    }
+    if ( !run->text ) {
+        TTF_SetError("Text run is out of date");
+        return -1;
+    }
+    return TTF_Layout(run->font, run->text, run);
+}
+
+int TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h)
+{
+    int status;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    SDL_LockMutex(font->lock);
+    status = TTF_Layout(font, text, &font->run);
+    if ( status == 0 ) {
+        if ( w ) {
+            *w = font->run.w;
+        }
+        if ( h ) {
+            *h = font->run.h;
+        }
+    }
+    SDL_UnlockMutex(font->lock);
+    return status;
+}
+
+int TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h)
+{
+    int status = -1;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        status = TTF_SizeUTF8(font, (char *)utf8, w, h);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return status;
+}
+
+TTF_TextRun *TTF_LayoutText(TTF_Font *font, const char *text)
+{
+    TTF_TextRun *run = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, SDL_strlen(text)*2+1);
+    if ( utf8 ) {
+        LATIN1_to_UTF8(text, utf8);
+        run = TTF_LayoutUTF8(font, (char *)utf8);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return run;
+}
+
+TTF_TextRun *TTF_LayoutUTF8(TTF_Font *font, const char *text)
+{
+    TTF_TextRun *run;
+    int status;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    run = (TTF_TextRun *)SDL_calloc(1, sizeof(*run));
+    if ( run == NULL ) {
+        TTF_SetError( "Out of memory" );
+        return NULL;
+    }
+    run->text = SDL_strdup(text);
+    if ( run->text == NULL ) {
+        TTF_SetError( "Out of memory" );
+        SDL_free(run);
+        return NULL;
+    }
+    SDL_LockMutex(font->lock);
+    status = TTF_Layout(font, run->text, run);
+    SDL_UnlockMutex(font->lock);
+    if ( status < 0 ) {
+        TTF_FreeTextRun(run);
+        return NULL;
+    }
+    return run;
+}
+
+TTF_TextRun *TTF_LayoutUNICODE(TTF_Font *font, const Uint16 *text)
+{
+    TTF_TextRun *run = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        run = TTF_LayoutUTF8(font, (char *)utf8);
         SDL_stack_free(utf8);
     } else {
         SDL_OutOfMemory();
     }
+    return run;
+}
+
+int TTF_SizeTextRun(TTF_TextRun *run, int *w, int *h)
+{
+    int status;
+
+    TTF_CHECKPOINTER(run, -1);
+
+    SDL_LockMutex(run->font->lock);
+    status = Refresh_Run(run);
+    if ( status == 0 ) {
+        if ( w ) {
+            *w = run->w;
+        }
+        if ( h ) {
+            *h = run->h;
+        }
+    }
+    SDL_UnlockMutex(run->font->lock);
     return status;
 }
 
+const TTF_RunGlyph *TTF_TextRunGlyphs(TTF_TextRun *run, int *count)
+{
+    int status;
+
+    TTF_CHECKPOINTER(run, NULL);
+
+    SDL_LockMutex(run->font->lock);
+    status = Refresh_Run(run);
+    if ( status == 0 && count ) {
+        *count = run->num_glyphs;
+    }
+    SDL_UnlockMutex(run->font->lock);
+    return (status == 0) ? run->glyphs : NULL;
+}
+
+void TTF_FreeTextRun(TTF_TextRun *run)
+{
+    if ( run ) {
+        SDL_free(run->glyphs);
+        SDL_free(run->text);
+        SDL_free(run);
+    }
+}
+
 SDL_Surface *TTF_RenderText_Solid(TTF_Font *font,
                 const char *text, SDL_Color fg)
 {
@@ -1340,45 +3570,34 @@ SDL_Surface *TTF_RenderText_Solid(TTF_Font *font,
     return surface;
 }
 
-SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
-                const char *text, SDL_Color fg)
+static SDL_Surface *Render_Run_Solid(TTF_TextRun *run, SDL_Color fg)
 {
-    SDL_bool first;
+    TTF_Font *font;
     int xstart;
     int width;
-    int height;
     SDL_Surface* textbuf;
     SDL_Palette* palette;
-    Uint8* src;
-    Uint8* dst;
-    Uint8 *dst_check;
-    int row, col;
+    int right = 0;
+    int row;
+    int i;
     c_glyph *glyph;
 
     FT_Bitmap *current;
     FT_Error error;
-    FT_Long use_kerning;
-    FT_UInt prev_index = 0;
-    size_t textlen;
-
-    TTF_CHECKPOINTER(text, NULL);
 
     /* Get the dimensions of the text surface */
-    if ( ( TTF_SizeUTF8(font, text, &width, &height) < 0 ) || !width ) {
+    if ( ( Refresh_Run(run) < 0 ) || !run->w ) {
         TTF_SetError( "Text has zero width" );
         return NULL;
     }
+    font = run->font;
 
     /* Create the target surface */
-    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
+    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, run->w, run->h, 8, 0, 0, 0, 0);
     if ( textbuf == NULL ) {
         return NULL;
     }
 
-    /* Adding bound checking to avoid all kinds of memory corruption errors
-       that may occur. */
-    dst_check = (Uint8*)textbuf->pixels + textbuf->pitch * textbuf->h;
-
     /* Fill the palette with the foreground color */
     palette = textbuf->format->palette;
     palette->colors[0].r = 255 - fg.r;
@@ -1389,69 +3608,25 @@ SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
     palette->colors[1].b = fg.b;
     SDL_SetColorKey( textbuf, SDL_TRUE, 0 );
 
-    /* check kerning */
-    use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-
-    /* Load and render each character */
-    textlen = SDL_strlen(text);
-    first = SDL_TRUE;
-    xstart = 0;
-    while ( textlen > 0 ) {
-        Uint16 c = UTF8_getch(&text, &textlen);
-        if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
-            continue;
-        }
-
-        error = Find_Glyph(font, c, CACHED_METRICS|CACHED_BITMAP);
+    /* Render each glyph where the layout put it */
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_BITMAP);
         if ( error ) {
-            TTF_SetFTError("Couldn't find glyph", error);
+            TTF_SetGlyphError(error);
             SDL_FreeSurface( textbuf );
             return NULL;
         }
         glyph = font->current;
-        current = &glyph->bitmap;
+        current = &glyph->bits->bitmap;
         /* Ensure the width of the pixmap is correct. On some cases,
          * freetype may report a larger pixmap than possible.*/
         width = current->width;
         if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
             width = glyph->maxx - glyph->minx;
         }
-        /* do kerning, if possible AC-Patch */
-        if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
-        }
-        /* Compensate for wrap around bug with negative minx's */
-        if ( first && (glyph->minx < 0) ) {
-            xstart -= glyph->minx;
-        }
-        first = SDL_FALSE;
-
-        for ( row = 0; row < current->rows; ++row ) {
-            /* Make sure we don't go either over, or under the
-             * limit */
-            if ( row+glyph->yoffset < 0 ) {
-                continue;
-            }
-            if ( row+glyph->yoffset >= textbuf->h ) {
-                continue;
-            }
-            dst = (Uint8*) textbuf->pixels +
-                (row+glyph->yoffset) * textbuf->pitch +
-                xstart + glyph->minx;
-            src = current->buffer + row * current->pitch;
-
-            for ( col=width; col>0 && dst < dst_check; --col ) {
-                *dst++ |= *src++;
-            }
-        }
+        xstart = run->glyphs[i].x;
 
-        xstart += glyph->advance;
-        if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-            xstart += font->glyph_overhang;
-        }
-        prev_index = glyph->index;
+        Copy_Glyph_8( textbuf, current, width, xstart + glyph->minx, glyph->yoffset + run->glyphs[i].y, &right );
     }
 
     /* Handle the underline style */
@@ -1468,6 +3643,39 @@ SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
     return textbuf;
 }
 
+SDL_Surface *TTF_RenderTextRun_Solid(TTF_TextRun *run, SDL_Color fg)
+{
+    SDL_Surface *textbuf;
+
+    TTF_CHECKPOINTER(run, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderTextRun_Solid" );
+    SDL_LockMutex(run->font->lock);
+    textbuf = Render_Run_Solid(run, fg);
+    SDL_UnlockMutex(run->font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
+SDL_Surface *TTF_RenderUTF8_Solid(TTF_Font *font,
+                const char *text, SDL_Color fg)
+{
+    SDL_Surface *textbuf = NULL;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Solid" );
+    SDL_LockMutex(font->lock);
+    if ( TTF_Layout(font, text, &font->run) < 0 ) {
+        TTF_SetError("Text has zero width");
+    } else {
+        textbuf = Render_Run_Solid(&font->run, fg);
+    }
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
 SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg)
 {
@@ -1489,10 +3697,14 @@ SDL_Surface *TTF_RenderUNICODE_Solid(TTF_Font *font,
 
 SDL_Surface *TTF_RenderGlyph_Solid(TTF_Font *font, Uint16 ch, SDL_Color fg)
 {
-    Uint16 ucs2[2] = { ch, 0 };
-    Uint8 utf8[4];
+    return TTF_RenderGlyph32_Solid(font, ch, fg);
+}
+
+SDL_Surface *TTF_RenderGlyph32_Solid(TTF_Font *font, Uint32 ch, SDL_Color fg)
+{
+    Uint8 utf8[5];
 
-    UCS2_to_UTF8(ucs2, utf8);
+    *UCS4_to_UTF8(ch, utf8) = '\0';
     return TTF_RenderUTF8_Solid(font, (char *)utf8, fg);
 }
 
@@ -1515,50 +3727,37 @@ SDL_Surface *TTF_RenderText_Shaded(TTF_Font *font,
     return surface;
 }
 
-/* Convert the UTF-8 text to UNICODE and render it
-*/
-SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
-                const char *text, SDL_Color fg, SDL_Color bg)
+static SDL_Surface *Render_Run_Shaded(TTF_TextRun *run, SDL_Color fg, SDL_Color bg)
 {
-    SDL_bool first;
+    TTF_Font *font;
     int xstart;
     int width;
-    int height;
     SDL_Surface* textbuf;
     SDL_Palette* palette;
     int index;
     int rdiff;
     int gdiff;
     int bdiff;
-    Uint8* src;
-    Uint8* dst;
-    Uint8* dst_check;
-    int row, col;
+    int right = 0;
+    int row;
+    int i;
     FT_Bitmap* current;
     c_glyph *glyph;
     FT_Error error;
-    FT_Long use_kerning;
-    FT_UInt prev_index = 0;
-    size_t textlen;
-
-    TTF_CHECKPOINTER(text, NULL);
 
     /* Get the dimensions of the text surface */
-    if ( ( TTF_SizeUTF8(font, text, &width, &height) < 0 ) || !width ) {
+    if ( ( Refresh_Run(run) < 0 ) || !run->w ) {
         TTF_SetError("Text has zero width");
         return NULL;
     }
+    font = run->font;
 
     /* Create the target surface */
-    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 8, 0, 0, 0, 0);
+    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, run->w, run->h, 8, 0, 0, 0, 0);
     if ( textbuf == NULL ) {
         return NULL;
     }
 
-    /* Adding bound checking to avoid all kinds of memory corruption errors
-       that may occur. */
-    dst_check = (Uint8*)textbuf->pixels + textbuf->pitch * textbuf->h;
-
     /* Fill the palette with NUM_GRAYS levels of shading from bg to fg */
     palette = textbuf->format->palette;
     rdiff = fg.r - bg.r;
@@ -1571,68 +3770,25 @@ SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
         palette->colors[index].b = bg.b + (index*bdiff) / (NUM_GRAYS-1);
     }
 
-    /* check kerning */
-    use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-
-    /* Load and render each character */
-    textlen = SDL_strlen(text);
-    first = SDL_TRUE;
-    xstart = 0;
-    while ( textlen > 0 ) {
-        Uint16 c = UTF8_getch(&text, &textlen);
-        if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
-            continue;
-        }
-
-        error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
+    /* Render each glyph where the layout put it */
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
         if ( error ) {
-            TTF_SetFTError("Couldn't find glyph", error);
+            TTF_SetGlyphError(error);
             SDL_FreeSurface( textbuf );
             return NULL;
         }
         glyph = font->current;
         /* Ensure the width of the pixmap is correct. On some cases,
          * freetype may report a larger pixmap than possible.*/
-        width = glyph->pixmap.width;
+        width = glyph->bits->pixmap.width;
         if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
             width = glyph->maxx - glyph->minx;
         }
-        /* do kerning, if possible AC-Patch */
-        if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
-        }
-        /* Compensate for the wrap around with negative minx's */
-        if ( first && (glyph->minx < 0) ) {
-            xstart -= glyph->minx;
-        }
-        first = SDL_FALSE;
-
-        current = &glyph->pixmap;
-        for ( row = 0; row < current->rows; ++row ) {
-            /* Make sure we don't go either over, or under the
-             * limit */
-            if ( row+glyph->yoffset < 0 ) {
-                continue;
-            }
-            if ( row+glyph->yoffset >= textbuf->h ) {
-                continue;
-            }
-            dst = (Uint8*) textbuf->pixels +
-                (row+glyph->yoffset) * textbuf->pitch +
-                xstart + glyph->minx;
-            src = current->buffer + row * current->pitch;
-            for ( col=width; col>0 && dst < dst_check; --col ) {
-                *dst++ |= *src++;
-            }
-        }
+        xstart = run->glyphs[i].x;
 
-        xstart += glyph->advance;
-        if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-            xstart += font->glyph_overhang;
-        }
-        prev_index = glyph->index;
+        current = &glyph->bits->pixmap;
+        Copy_Glyph_8( textbuf, current, width, xstart + glyph->minx, glyph->yoffset + run->glyphs[i].y, &right );
     }
 
     /* Handle the underline style */
@@ -1649,6 +3805,41 @@ SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
     return textbuf;
 }
 
+SDL_Surface *TTF_RenderTextRun_Shaded(TTF_TextRun *run, SDL_Color fg, SDL_Color bg)
+{
+    SDL_Surface *textbuf;
+
+    TTF_CHECKPOINTER(run, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderTextRun_Shaded" );
+    SDL_LockMutex(run->font->lock);
+    textbuf = Render_Run_Shaded(run, fg, bg);
+    SDL_UnlockMutex(run->font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
+/* Convert the UTF-8 text to UNICODE and render it
+*/
+SDL_Surface *TTF_RenderUTF8_Shaded(TTF_Font *font,
+                const char *text, SDL_Color fg, SDL_Color bg)
+{
+    SDL_Surface *textbuf = NULL;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Shaded" );
+    SDL_LockMutex(font->lock);
+    if ( TTF_Layout(font, text, &font->run) < 0 ) {
+        TTF_SetError("Text has zero width");
+    } else {
+        textbuf = Render_Run_Shaded(&font->run, fg, bg);
+    }
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
 SDL_Surface* TTF_RenderUNICODE_Shaded( TTF_Font* font,
                        const Uint16* text,
                        SDL_Color fg,
@@ -1675,10 +3866,17 @@ SDL_Surface* TTF_RenderGlyph_Shaded( TTF_Font* font,
                      SDL_Color fg,
                      SDL_Color bg )
 {
-    Uint16 ucs2[2] = { ch, 0 };
-    Uint8 utf8[4];
+    return TTF_RenderGlyph32_Shaded(font, ch, fg, bg);
+}
+
+SDL_Surface* TTF_RenderGlyph32_Shaded( TTF_Font* font,
+                     Uint32 ch,
+                     SDL_Color fg,
+                     SDL_Color bg )
+{
+    Uint8 utf8[5];
 
-    UCS2_to_UTF8(ucs2, utf8);
+    *UCS4_to_UTF8(ch, utf8) = '\0';
     return TTF_RenderUTF8_Shaded(font, (char *)utf8, fg, bg);
 }
 
@@ -1701,113 +3899,74 @@ SDL_Surface *TTF_RenderText_Blended(TTF_Font *font,
     return surface;
 }
 
-SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *font,
-                const char *text, SDL_Color fg)
+static SDL_Surface *Render_Run_Blended(TTF_TextRun *run, SDL_Color fg)
 {
-    SDL_bool first;
+    TTF_Font *font;
     int xstart;
-    int width, height;
+    int width;
     SDL_Surface *textbuf;
-    Uint32 alpha;
     Uint32 pixel;
     Uint8 *src;
     Uint32 *dst;
-    Uint32 *dst_check;
-    int row, col;
+    int row, col0, col1;
+    int i;
     c_glyph *glyph;
     FT_Error error;
-    FT_Long use_kerning;
-    FT_UInt prev_index = 0;
-    size_t textlen;
-
-    TTF_CHECKPOINTER(text, NULL);
 
     /* Get the dimensions of the text surface */
-    if ( ( TTF_SizeUTF8(font, text, &width, &height) < 0 ) || !width ) {
+    if ( ( Refresh_Run(run) < 0 ) || !run->w ) {
         TTF_SetError("Text has zero width");
         return(NULL);
     }
+    font = run->font;
 
     /* Create the target surface */
-    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, width, height, 32,
+    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE, run->w, run->h, 32,
                                0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
     if ( textbuf == NULL ) {
         return(NULL);
     }
 
-    /* Adding bound checking to avoid all kinds of memory corruption errors
-       that may occur. */
-    dst_check = (Uint32*)textbuf->pixels + textbuf->pitch/4 * textbuf->h;
-
-    /* check kerning */
-    use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
-
-    /* Load and render each character */
-    textlen = SDL_strlen(text);
-    first = SDL_TRUE;
-    xstart = 0;
+    /* Render each glyph where the layout put it */
     pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
     SDL_FillRect(textbuf, NULL, pixel); /* Initialize with fg and 0 alpha */
-    while ( textlen > 0 ) {
-        Uint16 c = UTF8_getch(&text, &textlen);
-        if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
-            continue;
-        }
-
-        error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
         if ( error ) {
-            TTF_SetFTError("Couldn't find glyph", error);
+            TTF_SetGlyphError(error);
             SDL_FreeSurface( textbuf );
             return NULL;
         }
         glyph = font->current;
         /* Ensure the width of the pixmap is correct. On some cases,
          * freetype may report a larger pixmap than possible.*/
-        width = glyph->pixmap.width;
+        width = glyph->bits->pixmap.width;
         if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
             width = glyph->maxx - glyph->minx;
         }
-        /* do kerning, if possible AC-Patch */
-        if ( use_kerning && prev_index && glyph->index ) {
-            FT_Vector delta;
-            FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-            xstart += delta.x >> 6;
-        }
-
-        /* Compensate for the wrap around bug with negative minx's */
-        if ( first && (glyph->minx < 0) ) {
-            xstart -= glyph->minx;
-        }
-        first = SDL_FALSE;
+        xstart = run->glyphs[i].x + glyph->minx;
 
-        for ( row = 0; row < glyph->pixmap.rows; ++row ) {
+        /* Clip the glyph against the surface once, not per pixel */
+        col0 = SDL_max(0, -xstart);
+        col1 = SDL_min(width, textbuf->w - xstart);
+        for ( row = 0; row < glyph->bits->pixmap.rows && col0 < col1; ++row ) {
             /* Make sure we don't go either over, or under the
              * limit */
-            if ( row+glyph->yoffset < 0 ) {
+            if ( row+glyph->yoffset+run->glyphs[i].y < 0 ) {
                 continue;
             }
-            if ( row+glyph->yoffset >= textbuf->h ) {
+            if ( row+glyph->yoffset+run->glyphs[i].y >= textbuf->h ) {
                 continue;
             }
             dst = (Uint32*) textbuf->pixels +
-                (row+glyph->yoffset) * textbuf->pitch/4 +
-                xstart + glyph->minx;
+                (row+glyph->yoffset+run->glyphs[i].y) * textbuf->pitch/4 + xstart;
 
             /* Added code to adjust src pointer for pixmaps to
              * account for pitch.
              * */
-            src = (Uint8*) (glyph->pixmap.buffer + glyph->pixmap.pitch * row);
-            for ( col = width; col>0 && dst < dst_check; --col) {
-                alpha = *src++;
-                *dst++ |= pixel | (alpha << 24);
-            }
-        }
-
-        xstart += glyph->advance;
-        if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-            xstart += font->glyph_overhang;
+            src = (Uint8*) (glyph->bits->pixmap.buffer + glyph->bits->pixmap.pitch * row);
+            Blend_Row( dst + col0, src + col0, col1 - col0, pixel );
         }
-        prev_index = glyph->index;
     }
 
     /* Handle the underline style */
@@ -1824,6 +3983,39 @@ SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *font,
     return(textbuf);
 }
 
+SDL_Surface *TTF_RenderTextRun_Blended(TTF_TextRun *run, SDL_Color fg)
+{
+    SDL_Surface *textbuf;
+
+    TTF_CHECKPOINTER(run, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderTextRun_Blended" );
+    SDL_LockMutex(run->font->lock);
+    textbuf = Render_Run_Blended(run, fg);
+    SDL_UnlockMutex(run->font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
+SDL_Surface *TTF_RenderUTF8_Blended(TTF_Font *font,
+                const char *text, SDL_Color fg)
+{
+    SDL_Surface *textbuf = NULL;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Blended" );
+    SDL_LockMutex(font->lock);
+    if ( TTF_Layout(font, text, &font->run) < 0 ) {
+        TTF_SetError("Text has zero width");
+    } else {
+        textbuf = Render_Run_Blended(&font->run, fg);
+    }
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
 SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg)
 {
@@ -1843,332 +4035,1871 @@ SDL_Surface *TTF_RenderUNICODE_Blended(TTF_Font *font,
     return surface;
 }
 
-
-SDL_Surface *TTF_RenderText_Blended_Wrapped(TTF_Font *font, const char *text, SDL_Color fg, Uint32 wrapLength)
+int TTF_RenderText_Blended_Into(TTF_Font *font, const char *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y)
 {
-    SDL_Surface *surface = NULL;
+    int status = -1;
     Uint8 *utf8;
 
-    TTF_CHECKPOINTER(text, NULL);
+    TTF_CHECKPOINTER(text, -1);
 
     utf8 = SDL_stack_alloc(Uint8, SDL_strlen(text)*2+1);
     if ( utf8 ) {
         LATIN1_to_UTF8(text, utf8);
-        surface = TTF_RenderUTF8_Blended_Wrapped(font, (char *)utf8, fg, wrapLength);
+        status = TTF_RenderUTF8_Blended_Into(font, (char *)utf8, fg, pixels, pitch, w, h, x, y);
         SDL_stack_free(utf8);
     } else {
         SDL_OutOfMemory();
     }
-    return surface;
+    return status;
+}
+
+/* Blend rows [row, row + height) of a solid line into the buffer */
+static void TTF_drawLine_Into(Uint8 *pixels, int pitch, int w, int h,
+                int x, int y, int width, int row, int height, Uint32 color)
+{
+    int line, col;
+    int x0 = SDL_max(x, 0);
+    int x1 = SDL_min(x + width, w);
+    Uint32 *dst;
+
+    for ( line = y + row; line < y + row + height; ++line ) {
+        if ( line < 0 || line >= h ) {
+            continue;
+        }
+        dst = (Uint32 *)(pixels + line * pitch);
+        for ( col = x0; col < x1; ++col ) {
+            dst[col] = color | 0xFF000000;
+        }
+    }
+}
+
+static int Render_Run_Blended_Into(TTF_TextRun *run, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y)
+{
+    TTF_Font *font;
+    int width;
+    Uint32 pixel;
+    Uint8 *src;
+    Uint32 *dst;
+    int row, dx, dy;
+    int col0, col1;
+    int i;
+    c_glyph *glyph;
+    FT_Error error;
+
+    TTF_CHECKPOINTER(pixels, -1);
+
+    if ( Refresh_Run(run) < 0 ) {
+        return -1;
+    }
+    font = run->font;
+
+    /* Render each glyph where the layout put it */
+    pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
+        if ( error ) {
+            TTF_SetGlyphError(error);
+            return -1;
+        }
+        glyph = font->current;
+        /* Ensure the width of the pixmap is correct. On some cases,
+         * freetype may report a larger pixmap than possible.*/
+        width = glyph->bits->pixmap.width;
+        if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
+            width = glyph->maxx - glyph->minx;
+        }
+
+        /* Clip the glyph against the buffer once, not per pixel */
+        dx = x + run->glyphs[i].x + glyph->minx;
+        col0 = SDL_max(0, -dx);
+        col1 = SDL_min(width, w - dx);
+        for ( row = 0; row < glyph->bits->pixmap.rows && col0 < col1; ++row ) {
+            dy = y + glyph->yoffset + run->glyphs[i].y + row;
+            if ( dy < 0 || dy >= h ) {
+                continue;
+            }
+            dst = (Uint32 *)((Uint8 *)pixels + dy * pitch) + dx;
+            src = (Uint8*) (glyph->bits->pixmap.buffer + glyph->bits->pixmap.pitch * row);
+            Blend_Row( dst + col0, src + col0, col1 - col0, pixel );
+        }
+    }
+
+    if ( TTF_HANDLE_STYLE_UNDERLINE(font) || TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+        int height = font->underline_height;
+
+        /* Take outline into account */
+        if ( font->outline > 0 ) {
+            height += font->outline * 2;
+        }
+        if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+            TTF_drawLine_Into((Uint8 *)pixels, pitch, w, h, x, y, run->w,
+                              TTF_underline_top_row(font), height, pixel);
+        }
+        if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+            TTF_drawLine_Into((Uint8 *)pixels, pitch, w, h, x, y, run->w,
+                              TTF_strikethrough_top_row(font), height, pixel);
+        }
+    }
+    return 0;
+}
+
+int TTF_RenderTextRun_Blended_Into(TTF_TextRun *run, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y)
+{
+    int status;
+
+    TTF_CHECKPOINTER(run, -1);
+
+    TTF_TRACE_BEGIN( "TTF_RenderTextRun_Blended_Into" );
+    SDL_LockMutex(run->font->lock);
+    status = Render_Run_Blended_Into(run, fg, pixels, pitch, w, h, x, y);
+    SDL_UnlockMutex(run->font->lock);
+    TTF_TRACE_END();
+    return status;
+}
+
+int TTF_RenderUTF8_Blended_Into(TTF_Font *font, const char *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y)
+{
+    int status;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Blended_Into" );
+    SDL_LockMutex(font->lock);
+    status = TTF_Layout(font, text, &font->run);
+    if ( status == 0 ) {
+        status = Render_Run_Blended_Into(&font->run, fg, pixels, pitch, w, h, x, y);
+    }
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return status;
+}
+
+int TTF_RenderUNICODE_Blended_Into(TTF_Font *font, const Uint16 *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y)
+{
+    int status = -1;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        status = TTF_RenderUTF8_Blended_Into(font, (char *)utf8, fg, pixels, pitch, w, h, x, y);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return status;
+}
+
+SDL_Surface *TTF_RenderText_Blended_Wrapped(TTF_Font *font, const char *text, SDL_Color fg, Uint32 wrapLength)
+{
+    SDL_Surface *surface = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, SDL_strlen(text)*2+1);
+    if ( utf8 ) {
+        LATIN1_to_UTF8(text, utf8);
+        surface = TTF_RenderUTF8_Blended_Wrapped(font, (char *)utf8, fg, wrapLength);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return surface;
+}
+
+static SDL_bool CharacterIsDelimiter(char c, const char *delimiters)
+{
+    while (*delimiters) {
+        if (c == *delimiters) {
+            return SDL_TRUE;
+        }
+        ++delimiters;
+    }
+    return SDL_FALSE;
+}
+
+static int Add_Line(TTF_Font *font, int line, const char *text, const char *start, const char *end, int w)
+{
+    if ( line == font->max_lines ) {
+        int size = font->max_lines ? font->max_lines * 2 : 16;
+        TTF_LineSpan *lines = (TTF_LineSpan *)SDL_realloc( font->lines, size * sizeof( *lines ) );
+        if ( !lines ) {
+            TTF_SetError( "Out of memory" );
+            return -1;
+        }
+        font->lines = lines;
+        font->max_lines = size;
+    }
+    font->lines[line].offset = (int)(start - text);
+    font->lines[line].length = (int)(end - start);
+    font->lines[line].w = w;
+    return 0;
+}
+
+/* Break text into lines no wider than wrapLength in one pass, measuring
+   with the same rules as TTF_SizeUTF8().  Lines break at \r, \n and \r\n,
+   and otherwise after the last word that fits; trailing whitespace is left
+   out of a line and a word that doesn't fit on its own gets a line to
+   itself.  The lines are left in font->lines and their number returned.
+ */
+static int Wrap_Lines(TTF_Font *font, const char *text, Uint32 wrapLength)
+{
+    const char *wrapDelims = " \t\r\n";
+    const char *end = text + SDL_strlen(text);
+    const char *p = text;
+    const char *start, *fit_end, *brk_end, *brk_next;
+    int fit_w, brk_w;
+    int x, z, minx, maxx;
+    int phase;
+    FT_Pos pen;
+    int outline_delta = 0;
+    int num_lines = 0;
+    SDL_bool in_space;
+    FT_Long use_kerning;
+    FT_UInt prev_index;
+    c_glyph *glyph;
+    FT_Error error;
+
+    use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
+    if ( font->outline > 0 ) {
+        outline_delta = font->outline * 2;
+    }
+
+    do {
+        start = fit_end = p;
+        brk_end = brk_next = NULL;
+        fit_w = brk_w = 0;
+        pen = minx = maxx = 0;
+        prev_index = 0;
+        in_space = SDL_FALSE;
+
+        while ( p < end ) {
+            const char *here = p;
+            size_t left = end - p;
+            Uint32 c;
+
+            if ( (Uint8)*p < 0x80 ) {
+                c = (Uint8)*p++;
+            } else {
+                c = UTF8_getch(&p, &left);
+                if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
+                    continue;
+                }
+            }
+
+            if ( c == '\r' || c == '\n' ) {
+                if ( c == '\r' && p < end && *p == '\n' ) {
+                    ++p;
+                }
+                break;
+            }
+
+            if ( c < 0x80 && CharacterIsDelimiter((char)c, wrapDelims) ) {
+                if ( !in_space && fit_end > start ) {
+                    brk_end = fit_end;
+                    brk_w = fit_w;
+                    brk_next = NULL;
+                }
+                in_space = SDL_TRUE;
+            } else {
+                if ( in_space && brk_end && !brk_next ) {
+                    brk_next = here;
+                }
+                in_space = SDL_FALSE;
+            }
+
+            /* Advance the pen exactly as TTF_Layout() does */
+            error = Place_Glyph(font, c, use_kerning, prev_index, &pen, &x, &phase);
+            if ( error ) {
+                TTF_SetGlyphError(error);
+                return -1;
+            }
+            glyph = font->current;
+            z = x + glyph->minx;
+            if ( minx > z ) {
+                minx = z;
+            }
+            if ( TTF_HANDLE_STYLE_BOLD(font) ) {
+                x += font->glyph_overhang;
+                pen += font->glyph_overhang * 64;
+            }
+            z = x + SDL_max(glyph->advance, glyph->maxx);
+            if ( maxx < z ) {
+                maxx = z;
+            }
+            pen += Glyph_Advance(font, glyph);
+            prev_index = glyph->source ? 0 : glyph->index;
+
+            if ( !in_space ) {
+                int w = (maxx - minx) + outline_delta;
+                if ( (Uint32)w > wrapLength && brk_next ) {
+                    /* Finish the line at the last break and start the
+                       next one with the word that didn't fit */
+                    fit_end = brk_end;
+                    fit_w = brk_w;
+                    p = brk_next;
+                    break;
+                }
+                fit_end = p;
+                fit_w = w;
+            }
+        }
+
+        if ( Add_Line(font, num_lines, text, start, fit_end, fit_w) < 0 ) {
+            return -1;
+        }
+        ++num_lines;
+    } while ( p < end );
+
+    return num_lines;
+}
+
+int TTF_WrapUTF8(TTF_Font *font, const char *text, Uint32 wrapLength,
+                 TTF_LineSpan *lines, int maxlines)
+{
+    int num_lines;
+
+    TTF_CHECKPOINTER(font, -1);
+    TTF_CHECKPOINTER(text, -1);
+
+    SDL_LockMutex(font->lock);
+    num_lines = Wrap_Lines(font, text, wrapLength);
+    if ( num_lines > 0 && lines && maxlines > 0 ) {
+        SDL_memcpy(lines, font->lines, SDL_min(num_lines, maxlines) * sizeof(*lines));
+    }
+    SDL_UnlockMutex(font->lock);
+    return num_lines;
+}
+
+/* Composite one line of a wrapped render.  The line only writes the rows
+   from its top to the next line's, so lines can be done in any order and
+   at the same time. */
+static void Blend_Wrapped_Line(void *data, int line)
+{
+    const wrap_job *job = (const wrap_job *)data;
+    SDL_Surface *textbuf = job->textbuf;
+    int top = job->height * line;
+    int bottom = (line == job->num_lines - 1) ? textbuf->h : top + job->height;
+    int i;
+
+    for ( i = job->line_start[line]; i < job->line_start[line + 1]; ++i ) {
+        const c_glyph *glyph = job->glyphs[i].glyph;
+        const FT_Bitmap *pixmap = &glyph->bits->pixmap;
+        int width = pixmap->width;
+        int xstart, col0, col1, row, row0, row1;
+
+        /* Ensure the width of the pixmap is correct. On some cases,
+         * freetype may report a larger pixmap than possible.*/
+        if ( job->outline <= 0 && width > glyph->maxx - glyph->minx ) {
+            width = glyph->maxx - glyph->minx;
+        }
+        xstart = job->glyphs[i].x + glyph->minx;
+
+        /* Clip the glyph against the surface and the line once */
+        col0 = SDL_max(0, -xstart);
+        col1 = SDL_min(width, textbuf->w - xstart);
+        row0 = SDL_max(0, -job->glyphs[i].y);
+        row1 = SDL_min(pixmap->rows, bottom - top - job->glyphs[i].y);
+        for ( row = row0; row < row1 && col0 < col1; ++row ) {
+            Uint32 *dst = (Uint32 *)((Uint8 *)textbuf->pixels +
+                          (top + job->glyphs[i].y + row) * textbuf->pitch) + xstart;
+            const Uint8 *src = pixmap->buffer + pixmap->pitch * row;
+            Blend_Row( dst + col0, src + col0, col1 - col0, job->pixel );
+        }
+    }
+}
+
+/* Lay out every line and find its glyphs, for Blend_Wrapped_Line().  The
+   glyphs are only pointed to, so this fails if finding later ones moved
+   or emptied slots that earlier ones were in. */
+static int Gather_Wrapped(TTF_Font *font, const char *text, Uint32 wrapLength, wrap_job *job)
+{
+    const c_glyph *cache = font->cache;
+    Uint32 evictions = font->cache_evictions;
+    int count = 0, max = 0;
+    int line, i, status;
+    FT_Error error;
+
+    for ( line = 0; line < job->num_lines; ++line ) {
+        if ( wrapLength > 0 && *text ) {
+            status = Layout_Span(font, text + font->lines[line].offset,
+                                 font->lines[line].length, &font->run);
+        } else {
+            status = TTF_Layout(font, text, &font->run);
+        }
+        if ( status < 0 ) {
+            return -1;
+        }
+        if ( count + font->run.num_glyphs > max ) {
+            wrap_glyph *glyphs;
+
+            max = SDL_max(max * 2, count + font->run.num_glyphs);
+            glyphs = (wrap_glyph *)SDL_realloc(job->glyphs, max * sizeof(*glyphs));
+            if ( !glyphs ) {
+                TTF_SetError("Out of memory");
+                return -1;
+            }
+            job->glyphs = glyphs;
+        }
+        job->line_start[line] = count;
+        for ( i = 0; i < font->run.num_glyphs; ++i ) {
+            error = Find_Run_Glyph(font, &font->run.glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
+            if ( error ) {
+                TTF_SetGlyphError(error);
+                return -1;
+            }
+            job->glyphs[count].glyph = font->current;
+            job->glyphs[count].x = font->run.glyphs[i].x;
+            job->glyphs[count].y = font->current->yoffset + font->run.glyphs[i].y;
+            ++count;
+        }
+    }
+    job->line_start[job->num_lines] = count;
+    return ( font->cache == cache && font->cache_evictions == evictions ) ? 0 : 1;
+}
+
+static SDL_Surface *Render_Wrapped(TTF_Font *font,
+                                    const char *text, SDL_Color fg, Uint32 wrapLength)
+{
+    int xstart;
+    int width, height;
+    SDL_Surface *textbuf;
+    Uint32 pixel;
+    Uint8 *src;
+    Uint32 *dst;
+    int row, col0, col1;
+    int i;
+    c_glyph *glyph;
+    FT_Error error;
+    const int lineSpace = 2;
+    int line, numLines, rowSize;
+    int status;
+
+    /* Get the dimensions of the text surface */
+    if ( (TTF_SizeUTF8(font, text, &width, &height) < 0) || !width ) {
+        TTF_SetError("Text has zero width");
+        return(NULL);
+    }
+
+    numLines = 1;
+    if ( wrapLength > 0 && *text ) {
+        numLines = Wrap_Lines(font, text, wrapLength);
+        if ( numLines < 0 ) {
+            return(NULL);
+        }
+    }
+
+    /* Create the target surface */
+    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE,
+            (numLines > 1) ? wrapLength : width,
+            height * numLines + (lineSpace * (numLines - 1)),
+            32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    if ( textbuf == NULL ) {
+        return(NULL);
+    }
+
+    rowSize = textbuf->pitch/4 * height;
+
+    /* Render each line where its layout puts the glyphs */
+    pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
+    SDL_FillRect(textbuf, NULL, pixel); /* Initialize with fg and 0 alpha */
+
+    /* Once every glyph is cached the lines are independent, and long text
+       is composited a line per job.  If the cache is too small to hold
+       them all at once the second try does no better, and the lines are
+       rendered one after the other below. */
+    if ( numLines >= WRAP_PARALLEL_LINES && (TTF_render_pool.count > 0 || TTF_job_handler) ) {
+        wrap_job job;
+
+        SDL_zero(job);
+        job.textbuf = textbuf;
+        job.pixel = pixel;
+        job.height = height;
+        job.outline = font->outline;
+        job.num_lines = numLines;
+        job.line_start = (int *)SDL_malloc((numLines + 1) * sizeof(*job.line_start));
+        status = 1;
+        for ( i = 0; i < 2 && status > 0 && job.line_start; ++i ) {
+            status = Gather_Wrapped(font, text, wrapLength, &job);
+        }
+        if ( status == 0 ) {
+            Run_Jobs(Blend_Wrapped_Line, &job, numLines);
+        }
+        SDL_free(job.glyphs);
+        SDL_free(job.line_start);
+        if ( status < 0 ) {
+            SDL_FreeSurface( textbuf );
+            return NULL;
+        }
+        if ( status == 0 ) {
+            return(textbuf);
+        }
+    }
+
+    for ( line = 0; line < numLines; line++ ) {
+        if ( wrapLength > 0 && *text ) {
+            status = Layout_Span(font, text + font->lines[line].offset,
+                                 font->lines[line].length, &font->run);
+        } else {
+            status = TTF_Layout(font, text, &font->run);
+        }
+        if ( status < 0 ) {
+            SDL_FreeSurface( textbuf );
+            return NULL;
+        }
+        for ( i = 0; i < font->run.num_glyphs; ++i ) {
+            error = Find_Run_Glyph(font, &font->run.glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
+            if ( error ) {
+                TTF_SetGlyphError(error);
+                SDL_FreeSurface( textbuf );
+                return NULL;
+            }
+            glyph = font->current;
+            /* Ensure the width of the pixmap is correct. On some cases,
+             * freetype may report a larger pixmap than possible.*/
+            width = glyph->bits->pixmap.width;
+            if ( font->outline <= 0 && width > glyph->maxx - glyph->minx ) {
+                width = glyph->maxx - glyph->minx;
+            }
+            xstart = font->run.glyphs[i].x + glyph->minx;
+
+            /* Clip the glyph against the surface once, not per pixel */
+            col0 = SDL_max(0, -xstart);
+            col1 = SDL_min(width, textbuf->w - xstart);
+            for ( row = 0; row < glyph->bits->pixmap.rows && col0 < col1; ++row ) {
+                /* Make sure we don't go either over, or under the
+                 * limit */
+                int dy = height * line + row + glyph->yoffset + font->run.glyphs[i].y;
+                if ( row+glyph->yoffset+font->run.glyphs[i].y < 0 ) {
+                    continue;
+                }
+                if ( dy >= textbuf->h || (line < numLines - 1 && dy >= height * (line + 1)) ) {
+                    continue;
+                }
+                dst = ((Uint32*)textbuf->pixels + rowSize * line) +
+                (row+glyph->yoffset+font->run.glyphs[i].y) * textbuf->pitch/4 + xstart;
+
+                /* Added code to adjust src pointer for pixmaps to
+                 * account for pitch.
+                 * */
+                src = (Uint8*) (glyph->bits->pixmap.buffer + glyph->bits->pixmap.pitch * row);
+                Blend_Row( dst + col0, src + col0, col1 - col0, pixel );
+            }
+        }
+
+        /* Handle the underline style *
+        if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+            row = TTF_underline_top_row(font);
+            TTF_drawLine_Blended(font, textbuf, row, pixel);
+        }
+        */
+
+        /* Handle the strikethrough style *
+        if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+            row = TTF_strikethrough_top_row(font);
+            TTF_drawLine_Blended(font, textbuf, row, pixel);
+        }
+        */
+    }
+
+    return(textbuf);
+}
+
+SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *font,
+                                    const char *text, SDL_Color fg, Uint32 wrapLength)
+{
+    SDL_Surface * textbuf;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Blended_Wrapped" );
+    SDL_LockMutex(font->lock);
+    textbuf = Render_Wrapped(font, text, fg, wrapLength);
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
+SDL_Surface *TTF_RenderUNICODE_Blended_Wrapped(TTF_Font *font, const Uint16* text,
+                                               SDL_Color fg, Uint32 wrapLength)
+{
+    SDL_Surface *surface = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        surface = TTF_RenderUTF8_Blended_Wrapped(font, (char *)utf8, fg, wrapLength);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return surface;
+}
+
+SDL_Surface *TTF_RenderGlyph_Blended(TTF_Font *font, Uint16 ch, SDL_Color fg)
+{
+    return TTF_RenderGlyph32_Blended(font, ch, fg);
+}
+
+SDL_Surface *TTF_RenderGlyph32_Blended(TTF_Font *font, Uint32 ch, SDL_Color fg)
+{
+    Uint8 utf8[5];
+
+    *UCS4_to_UTF8(ch, utf8) = '\0';
+    return TTF_RenderUTF8_Blended(font, (char *)utf8, fg);
+}
+
+SDL_Surface *TTF_RenderText_Scaled(TTF_Font *font, const char *text, SDL_Color fg, float scale)
+{
+    SDL_Surface *surface = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, SDL_strlen(text)*2+1);
+    if ( utf8 ) {
+        LATIN1_to_UTF8(text, utf8);
+        surface = TTF_RenderUTF8_Scaled(font, (char *)utf8, fg, scale);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return surface;
+}
+
+/* Bilinear sample of the distance field at (u, v) in its pixel grid */
+static float Sample_SDF( const FT_Bitmap *sdf, float u, float v )
+{
+    int x0 = (int)SDL_floor( u ), y0 = (int)SDL_floor( v );
+    float fx = u - x0, fy = v - y0;
+    float p[4];
+    int i;
+
+    for ( i = 0; i < 4; ++i ) {
+        int x = x0 + (i & 1), y = y0 + (i >> 1);
+        p[i] = 0.0f;
+        if ( x >= 0 && x < sdf->width && y >= 0 && y < sdf->rows ) {
+            p[i] = sdf->buffer[y * sdf->pitch + x];
+        }
+    }
+    return (p[0] * (1.0f - fx) + p[1] * fx) * (1.0f - fy) +
+           (p[2] * (1.0f - fx) + p[3] * fx) * fy;
+}
+
+static void TTF_drawLine_Scaled(const TTF_Font *font, SDL_Surface *textbuf, int row, float scale, Uint32 pixel)
+{
+    SDL_Rect rect;
+    int height = font->underline_height;
+
+    /* Take outline into account */
+    if ( font->outline > 0 ) {
+        height += font->outline * 2;
+    }
+    rect.x = 0;
+    rect.y = (int)(row * scale);
+    rect.w = textbuf->w;
+    rect.h = SDL_max(1, (int)(height * scale + 0.5f));
+    SDL_FillRect(textbuf, &rect, pixel | 0xFF000000);
+}
+
+/* Lays text out at the font's own size and draws it scale times as big
+   from each glyph's distance field, so any size costs one rasterization */
+static SDL_Surface *Render_Scaled(TTF_Font *font, const char *text, SDL_Color fg, float scale)
+{
+    TTF_TextRun *run;
+    SDL_Surface *textbuf;
+    Uint32 pixel;
+    c_glyph *glyph;
+    FT_Error error;
+    int i, x, y;
+
+    if ( scale <= 0.0f ) {
+        TTF_SetError("Scale must be positive");
+        return(NULL);
+    }
+    if ( TTF_Layout(font, text, &font->run) < 0 || !font->run.w ) {
+        TTF_SetError("Text has zero width");
+        return(NULL);
+    }
+    run = &font->run;
+
+    /* Create the target surface */
+    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE,
+                               (int)SDL_ceil(run->w * scale), (int)SDL_ceil(run->h * scale), 32,
+                               0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
+    if ( textbuf == NULL ) {
+        return(NULL);
+    }
+
+    pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
+    SDL_FillRect(textbuf, NULL, pixel); /* Initialize with fg and 0 alpha */
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        float left, top;
+        int x0, x1, y0, y1;
+
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_SDF);
+        if ( error ) {
+            TTF_SetGlyphError(error);
+            SDL_FreeSurface( textbuf );
+            return NULL;
+        }
+        glyph = font->current;
+        if ( !glyph->bits || !glyph->bits->sdf.buffer ) {
+            continue;
+        }
+
+        /* The field's top left corner, in unscaled surface pixels */
+        left = (float)(run->glyphs[i].x + glyph->minx - SDF_SPREAD);
+        top = (float)(glyph->yoffset + run->glyphs[i].y - SDF_SPREAD);
+        x0 = SDL_max(0, (int)SDL_floor(left * scale));
+        y0 = SDL_max(0, (int)SDL_floor(top * scale));
+        x1 = SDL_min(textbuf->w, (int)SDL_ceil((left + glyph->bits->sdf.width) * scale));
+        y1 = SDL_min(textbuf->h, (int)SDL_ceil((top + glyph->bits->sdf.rows) * scale));
+
+        for ( y = y0; y < y1; ++y ) {
+            Uint32 *dst = (Uint32 *)((Uint8 *)textbuf->pixels + y * textbuf->pitch);
+            float v = (y + 0.5f) / scale - top - 0.5f;
+
+            for ( x = x0; x < x1; ++x ) {
+                float u = (x + 0.5f) / scale - left - 0.5f;
+                /* Distance to the edge in output pixels decides coverage */
+                float d = (Sample_SDF(&glyph->bits->sdf, u, v) - 128.0f) * SDF_SPREAD / 127.0f * scale + 0.5f;
+                Uint32 alpha, old;
+
+                if ( d <= 0.0f ) {
+                    continue;
+                }
+                alpha = (d >= 1.0f) ? 255 : (Uint32)(d * 255.0f);
+                old = dst[x] >> 24;
+                dst[x] = pixel | (SDL_max(alpha, old) << 24);
+            }
+        }
+    }
+
+    /* Handle the underline style */
+    if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+        TTF_drawLine_Scaled(font, textbuf, TTF_underline_top_row(font), scale, pixel);
+    }
+
+    /* Handle the strikethrough style */
+    if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+        TTF_drawLine_Scaled(font, textbuf, TTF_strikethrough_top_row(font), scale, pixel);
+    }
+    return(textbuf);
+}
+
+SDL_Surface *TTF_RenderUTF8_Scaled(TTF_Font *font, const char *text, SDL_Color fg, float scale)
+{
+    SDL_Surface * textbuf;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    TTF_TRACE_BEGIN( "TTF_RenderUTF8_Scaled" );
+    SDL_LockMutex(font->lock);
+    textbuf = Render_Scaled(font, text, fg, scale);
+    SDL_UnlockMutex(font->lock);
+    TTF_TRACE_END();
+    return textbuf;
+}
+
+SDL_Surface *TTF_RenderUNICODE_Scaled(TTF_Font *font, const Uint16 *text, SDL_Color fg, float scale)
+{
+    SDL_Surface *surface = NULL;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, NULL);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        surface = TTF_RenderUTF8_Scaled(font, (char *)utf8, fg, scale);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return surface;
+}
+
+static void Clear_Font_Atlas( TTF_Font *font )
+{
+    int i;
+
+    if ( font->atlas.texture ) {
+        SDL_DestroyTexture( font->atlas.texture );
+    }
+    SDL_free( font->atlas.scratch );
+    SDL_memset( &font->atlas, 0, sizeof( font->atlas ) );
+    for ( i = 0; font->cache && i < font->cache_sets * CACHE_WAYS; ++i ) {
+        font->cache[i].atlas.w = 0;
+    }
+}
+
+void TTF_ClearFontAtlas( TTF_Font *font )
+{
+    if ( !font ) {
+        return;
+    }
+    SDL_LockMutex( font->lock );
+    Clear_Font_Atlas( font );
+    SDL_UnlockMutex( font->lock );
+}
+
+static int Create_Atlas( TTF_Font *font, SDL_Renderer *renderer )
+{
+    glyph_atlas *atlas = &font->atlas;
+    int size;
+
+    TTF_ClearFontAtlas( font );
+
+    /* Room for a few hundred glyphs of this size */
+    for ( size = ATLAS_MIN_SIZE; size < font->height * 16 && size < ATLAS_MAX_SIZE; size *= 2 ) {
+        continue;
+    }
+    atlas->texture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888,
+                                        SDL_TEXTUREACCESS_STATIC, size, size );
+    if ( !atlas->texture ) {
+        return -1;
+    }
+    SDL_SetTextureBlendMode( atlas->texture, SDL_BLENDMODE_BLEND );
+    atlas->renderer = renderer;
+    atlas->size = size;
+    return 0;
+}
+
+/* Forget every packed glyph and start filling the atlas from the top */
+static void Reset_Atlas( TTF_Font *font )
+{
+    int i;
+
+    for ( i = 0; i < font->cache_sets * CACHE_WAYS; ++i ) {
+        font->cache[i].atlas.w = 0;
+    }
+    font->atlas.x = 0;
+    font->atlas.y = 0;
+    font->atlas.shelf = 0;
+}
+
+/* Copy the glyph's pixmap into a free spot of the atlas as white pixels,
+   with the coverage in the alpha channel */
+static int Pack_Glyph( TTF_Font *font, c_glyph *glyph, int width )
+{
+    glyph_atlas *atlas = &font->atlas;
+    int rows = glyph->bits->pixmap.rows;
+    int row, col;
+    Uint8 *src;
+    Uint32 *dst;
+
+    if ( width + ATLAS_PADDING > atlas->size || rows + ATLAS_PADDING > atlas->size ) {
+        TTF_SetError( "Glyph doesn't fit in the atlas" );
+        return -1;
+    }
+    if ( atlas->x + width > atlas->size ) {
+        atlas->x = 0;
+        atlas->y += atlas->shelf;
+        atlas->shelf = 0;
+    }
+    if ( atlas->y + rows > atlas->size ) {
+        Reset_Atlas( font );
+    }
+
+    if ( width * rows > atlas->scratch_size ) {
+        Uint32 *scratch = (Uint32 *)SDL_realloc( atlas->scratch, width * rows * sizeof( *scratch ) );
+        if ( !scratch ) {
+            TTF_SetError( "Out of memory" );
+            return -1;
+        }
+        atlas->scratch = scratch;
+        atlas->scratch_size = width * rows;
+    }
+    dst = atlas->scratch;
+    for ( row = 0; row < rows; ++row ) {
+        src = glyph->bits->pixmap.buffer + row * glyph->bits->pixmap.pitch;
+        for ( col = 0; col < width; ++col ) {
+            *dst++ = ((Uint32)src[col] << 24) | 0x00FFFFFF;
+        }
+    }
+
+    glyph->atlas.x = atlas->x;
+    glyph->atlas.y = atlas->y;
+    glyph->atlas.w = width;
+    glyph->atlas.h = rows;
+    if ( SDL_UpdateTexture( atlas->texture, &glyph->atlas, atlas->scratch, width * sizeof( *dst ) ) < 0 ) {
+        glyph->atlas.w = 0;
+        return -1;
+    }
+
+    atlas->x += width + ATLAS_PADDING;
+    if ( atlas->shelf < rows + ATLAS_PADDING ) {
+        atlas->shelf = rows + ATLAS_PADDING;
+    }
+    return 0;
+}
+
+/* Draw a line of the same height TTF_drawLine_Blended() would */
+static void TTF_drawLine_Renderer(const TTF_Font *font, SDL_Renderer *renderer, int x, int y, int w, int row, SDL_Color fg)
+{
+    SDL_Rect rect;
+    Uint8 r, g, b, a;
+
+    rect.x = x;
+    rect.y = y + row;
+    rect.w = w;
+    rect.h = font->underline_height;
+    if ( font->outline > 0 ) {
+        rect.h += font->outline * 2;
+    }
+    SDL_GetRenderDrawColor( renderer, &r, &g, &b, &a );
+    SDL_SetRenderDrawColor( renderer, fg.r, fg.g, fg.b, 0xFF );
+    SDL_RenderFillRect( renderer, &rect );
+    SDL_SetRenderDrawColor( renderer, r, g, b, a );
+}
+
+int TTF_DrawText(SDL_Renderer *renderer, TTF_Font *font,
+                const char *text, int x, int y, SDL_Color fg)
+{
+    int status = -1;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    utf8 = SDL_stack_alloc(Uint8, SDL_strlen(text)*2+1);
+    if ( utf8 ) {
+        LATIN1_to_UTF8(text, utf8);
+        status = TTF_DrawUTF8(renderer, font, (char *)utf8, x, y, fg);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return status;
+}
+
+/* Lays glyphs out exactly like TTF_RenderUTF8_Blended(), with (x, y) as
+   the top left corner of the surface that function would return */
+static int Draw_Run(SDL_Renderer *renderer, TTF_TextRun *run,
+                int x, int y, SDL_Color fg)
+{
+    TTF_Font *font;
+    int width;
+    int i;
+    SDL_Rect dst;
+    c_glyph *glyph;
+    FT_Error error;
+
+    if ( Refresh_Run(run) < 0 ) {
+        return -1;
+    }
+    font = run->font;
+
+    if ( font->atlas.renderer != renderer || !font->atlas.texture ) {
+        if ( Create_Atlas( font, renderer ) < 0 ) {
+            return -1;
+        }
+    }
+    SDL_SetTextureColorMod( font->atlas.texture, fg.r, fg.g, fg.b );
+
+    /* Draw each glyph where the layout put it */
+    for ( i = 0; i < run->num_glyphs; ++i ) {
+        error = Find_Run_Glyph(font, &run->glyphs[i], CACHED_METRICS|CACHED_PIXMAP);
+        if ( error ) {
+            TTF_SetGlyphError(error);
+            return -1;
+        }
+        glyph = font->current;
+        /* Ensure the width of the pixmap is correct. On some cases,
+         * freetype may report a larger pixmap than possible.*/
+        width = glyph->bits->pixmap.width;
+        if (font->outline <= 0 && width > glyph->maxx - glyph->minx) {
+            width = glyph->maxx - glyph->minx;
+        }
+
+        if ( width > 0 && glyph->bits->pixmap.rows > 0 ) {
+            if ( !glyph->atlas.w && Pack_Glyph( font, glyph, width ) < 0 ) {
+                return -1;
+            }
+            dst.x = x + run->glyphs[i].x + glyph->minx;
+            dst.y = y + glyph->yoffset + run->glyphs[i].y;
+            dst.w = glyph->atlas.w;
+            dst.h = glyph->atlas.h;
+            SDL_RenderCopy( renderer, font->atlas.texture, &glyph->atlas, &dst );
+        }
+    }
+
+    if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
+        TTF_drawLine_Renderer(font, renderer, x, y, run->w, TTF_underline_top_row(font), fg);
+    }
+    if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
+        TTF_drawLine_Renderer(font, renderer, x, y, run->w, TTF_strikethrough_top_row(font), fg);
+    }
+    return 0;
+}
+
+int TTF_DrawTextRun(SDL_Renderer *renderer, TTF_TextRun *run,
+                int x, int y, SDL_Color fg)
+{
+    int status;
+
+    TTF_CHECKPOINTER(run, -1);
+    TTF_CHECKPOINTER(renderer, -1);
+
+    SDL_LockMutex(run->font->lock);
+    status = Draw_Run(renderer, run, x, y, fg);
+    SDL_UnlockMutex(run->font->lock);
+    return status;
+}
+
+int TTF_DrawUTF8(SDL_Renderer *renderer, TTF_Font *font,
+                const char *text, int x, int y, SDL_Color fg)
+{
+    int status;
+
+    TTF_CHECKPOINTER(text, -1);
+    TTF_CHECKPOINTER(renderer, -1);
+
+    SDL_LockMutex(font->lock);
+    status = TTF_Layout(font, text, &font->run);
+    if ( status == 0 ) {
+        status = Draw_Run(renderer, &font->run, x, y, fg);
+    }
+    SDL_UnlockMutex(font->lock);
+    return status;
+}
+
+int TTF_DrawUNICODE(SDL_Renderer *renderer, TTF_Font *font,
+                const Uint16 *text, int x, int y, SDL_Color fg)
+{
+    int status = -1;
+    Uint8 *utf8;
+
+    TTF_CHECKPOINTER(text, -1);
+
+    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
+    if ( utf8 ) {
+        UCS2_to_UTF8(text, utf8);
+        status = TTF_DrawUTF8(renderer, font, (char *)utf8, x, y, fg);
+        SDL_stack_free(utf8);
+    } else {
+        SDL_OutOfMemory();
+    }
+    return status;
+}
+
+TTF_TextCache *TTF_CreateTextCache(SDL_Renderer *renderer, int max_entries)
+{
+    TTF_TextCache *cache;
+
+    if ( max_entries <= 0 ) {
+        max_entries = TEXT_CACHE_DEFAULT_SIZE;
+    }
+    cache = (TTF_TextCache *)SDL_calloc(1, sizeof(*cache));
+    if ( cache ) {
+        cache->entries = (cached_text *)SDL_calloc(max_entries, sizeof(*cache->entries));
+    }
+    if ( !cache || !cache->entries ) {
+        TTF_SetError("Out of memory");
+        SDL_free(cache);
+        return NULL;
+    }
+    cache->renderer = renderer;
+    cache->num_entries = max_entries;
+    return cache;
+}
+
+static void Flush_Text(cached_text *entry)
+{
+    if ( entry->surface ) {
+        SDL_FreeSurface(entry->surface);
+    }
+    if ( entry->texture ) {
+        SDL_DestroyTexture(entry->texture);
+    }
+    SDL_free(entry->text);
+    SDL_memset(entry, 0, sizeof(*entry));
+}
+
+void TTF_ClearTextCache(TTF_TextCache *cache)
+{
+    int i;
+
+    if ( !cache ) {
+        return;
+    }
+    for ( i = 0; i < cache->num_entries; ++i ) {
+        Flush_Text(&cache->entries[i]);
+    }
+}
+
+void TTF_SetTextCacheRetain(TTF_TextCache *cache, int retain)
+{
+    if ( cache ) {
+        cache->retain = retain ? SDL_TRUE : SDL_FALSE;
+    }
+}
+
+void TTF_ReleaseTextCacheTextures(TTF_TextCache *cache)
+{
+    int i;
+
+    if ( !cache ) {
+        return;
+    }
+    for ( i = 0; i < cache->num_entries; ++i ) {
+        cached_text *entry = &cache->entries[i];
+        if ( entry->texture ) {
+            SDL_DestroyTexture(entry->texture);
+            entry->texture = NULL;
+        }
+    }
+}
+
+void TTF_FreeTextCache(TTF_TextCache *cache)
+{
+    if ( cache ) {
+        TTF_ClearTextCache(cache);
+        SDL_free(cache->entries);
+        SDL_free(cache);
+    }
+}
+
+static Uint32 Hash_Text(const char *text)
+{
+    Uint32 hash = 5381;
+
+    while ( *text ) {
+        hash = hash * 33 + (Uint8)*text++;
+    }
+    return hash;
+}
+
+/* Finds the entry for text as the font would render it right now, or
+   makes the least recently used entry an empty one for it */
+static cached_text *Find_Text(TTF_TextCache *cache, TTF_Font *font,
+                const char *text, SDL_Color fg)
+{
+    cached_text key;
+    cached_text *entry;
+    cached_text *victim = NULL;
+    int i;
+
+    SDL_memset(&key, 0, sizeof(key));
+    key.font_id = font->id;
+    key.hash = Hash_Text(text);
+    key.style = font->style;
+    key.outline = font->outline;
+    key.kerning = font->kerning;
+    key.hinting = font->hinting;
+    key.subpixel = font->subpixel;
+    key.color = ((Uint32)fg.r << 24) | ((Uint32)fg.g << 16) | ((Uint32)fg.b << 8) | fg.a;
+
+    for ( i = 0; i < cache->num_entries; ++i ) {
+        entry = &cache->entries[i];
+        if ( !entry->font_id ) {
+            if ( !victim || victim->font_id ) {
+                victim = entry;
+            }
+            continue;
+        }
+        if ( entry->font_id == key.font_id && entry->hash == key.hash &&
+             entry->style == key.style && entry->outline == key.outline &&
+             entry->kerning == key.kerning && entry->hinting == key.hinting &&
+             entry->subpixel == key.subpixel &&
+             entry->color == key.color && SDL_strcmp(entry->text, text) == 0 ) {
+            entry->lru = ++cache->tick;
+            return entry;
+        }
+        if ( !victim || (victim->font_id && (Sint32)(entry->lru - victim->lru) < 0) ) {
+            victim = entry;
+        }
+    }
+
+    key.text = SDL_strdup(text);
+    if ( !key.text ) {
+        TTF_SetError("Out of memory");
+        return NULL;
+    }
+    Flush_Text(victim);
+    *victim = key;
+    victim->lru = ++cache->tick;
+    return victim;
+}
+
+SDL_Surface *TTF_CachedUTF8_Blended(TTF_TextCache *cache, TTF_Font *font,
+                const char *text, SDL_Color fg)
+{
+    cached_text *entry;
+
+    TTF_CHECKPOINTER(cache, NULL);
+    TTF_CHECKPOINTER(font, NULL);
+    TTF_CHECKPOINTER(text, NULL);
+
+    entry = Find_Text(cache, font, text, fg);
+    if ( !entry ) {
+        return NULL;
+    }
+    if ( !entry->surface ) {
+        entry->surface = TTF_RenderUTF8_Blended(font, text, fg);
+        if ( !entry->surface ) {
+            Flush_Text(entry);
+            return NULL;
+        }
+    }
+    return entry->surface;
+}
+
+SDL_Texture *TTF_CachedUTF8_Texture(TTF_TextCache *cache, TTF_Font *font,
+                const char *text, SDL_Color fg)
+{
+    cached_text *entry;
+
+    TTF_CHECKPOINTER(cache, NULL);
+    TTF_CHECKPOINTER(font, NULL);
+    TTF_CHECKPOINTER(text, NULL);
+
+    if ( !cache->renderer ) {
+        TTF_SetError("Text cache has no renderer");
+        return NULL;
+    }
+    entry = Find_Text(cache, font, text, fg);
+    if ( !entry ) {
+        return NULL;
+    }
+    if ( !entry->texture ) {
+        if ( !entry->surface ) {
+            entry->surface = TTF_RenderUTF8_Blended(font, text, fg);
+        }
+        if ( entry->surface ) {
+            entry->texture = SDL_CreateTextureFromSurface(cache->renderer, entry->surface);
+            if ( !cache->retain ) {
+                SDL_FreeSurface(entry->surface);
+                entry->surface = NULL;
+            }
+        }
+        if ( !entry->texture ) {
+            Flush_Text(entry);
+            return NULL;
+        }
+    }
+    return entry->texture;
+}
+
+void TTF_SetFontStyle( TTF_Font* font, int style )
+{
+    int prev_style;
+
+    SDL_LockMutex( font->lock );
+    prev_style = font->style;
+    font->style = style | font->face_style;
+
+    /* Glyphs of the new style are cached next to the old ones, but text
+     * laid out with the old style has to be laid out again.
+     * */
+    if ( font->style != prev_style ) {
+        font->variant = Glyph_Variant( font );
+        ++font->generation;
+    }
+    SDL_UnlockMutex( font->lock );
+}
+
+int TTF_GetFontStyle( const TTF_Font* font )
+{
+    return font->style;
+}
+
+void TTF_SetFontOutline( TTF_Font* font, int outline )
+{
+    SDL_LockMutex( font->lock );
+    if ( font->outline != outline ) {
+        font->outline = outline;
+        font->variant = Glyph_Variant( font );
+        ++font->generation;
+    }
+    SDL_UnlockMutex( font->lock );
+}
+
+int TTF_GetFontOutline( const TTF_Font* font )
+{
+    return font->outline;
+}
+
+static void Set_Font_Hinting( TTF_Font* font, int hinting )
+{
+    if (hinting == TTF_HINTING_LIGHT)
+        font->hinting = FT_LOAD_TARGET_LIGHT;
+    else if (hinting == TTF_HINTING_MONO)
+        font->hinting = FT_LOAD_TARGET_MONO;
+    else if (hinting == TTF_HINTING_NONE)
+        font->hinting = FT_LOAD_NO_HINTING;
+    else
+        font->hinting = 0;
+
+    /* The glyphs are still worth keeping for the old hinting */
+    if ( font->glyphs_added ) {
+        Write_Glyph_File( font );
+    }
+    Flush_Cache( font );
+    Read_Glyph_File( font );
+}
+
+int TTF_SetFontFallbacks( TTF_Font* font, TTF_Font* const* fallbacks, int count )
+{
+    TTF_Font **chain = NULL;
+    int i;
+
+    if ( !font || count < 0 || (count > 0 && !fallbacks) ) {
+        TTF_SetError( "Passed a NULL pointer" );
+        return -1;
+    }
+    for ( i = 0; i < count; ++i ) {
+        if ( !fallbacks[i] || fallbacks[i] == font ) {
+            TTF_SetError( "Fallback %d isn't another font", i );
+            return -1;
+        }
+    }
+    if ( count > 0 ) {
+        chain = (TTF_Font **)SDL_malloc( count * sizeof( *chain ) );
+        if ( !chain ) {
+            TTF_SetError( "Out of memory" );
+            return -1;
+        }
+        SDL_memcpy( chain, fallbacks, count * sizeof( *chain ) );
+    }
+
+    SDL_LockMutex( font->lock );
+    /* The glyphs taken from the old chain are dropped with the rest,
+       the font's own come back from its glyph file */
+    if ( font->glyphs_added ) {
+        Write_Glyph_File( font );
+    }
+    Flush_Cache( font );
+    SDL_free( font->fallbacks );
+    font->fallbacks = chain;
+    font->num_fallbacks = count;
+    SDL_free( font->source_hash );
+    font->source_hash = NULL;
+    font->source_hash_size = 0;
+    font->source_hash_count = 0;
+    Read_Glyph_File( font );
+    SDL_UnlockMutex( font->lock );
+    return 0;
+}
+
+void TTF_SetFontHinting( TTF_Font* font, int hinting )
+{
+    SDL_LockMutex(font->lock);
+    Set_Font_Hinting(font, hinting);
+    SDL_UnlockMutex(font->lock);
+}
+
+static void Set_Cache_Budget( TTF_Font* font, int bytes )
+{
+    size_t slots;
+
+    if ( bytes <= 0 ) {
+        bytes = CACHE_DEFAULT_BUDGET;
+    }
+    font->cache_budget = (size_t)bytes;
+
+    /* Start over from the smallest table if the slots alone no longer fit */
+    slots = font->cache_sets * CACHE_WAYS * sizeof( c_glyph );
+    if ( slots > font->cache_budget && font->cache_sets > CACHE_MIN_SETS ) {
+        Alloc_Cache( font, CACHE_MIN_SETS );
+    }
+    font->current = NULL;
+    Trim_Cache( font );
+}
+
+void TTF_SetTotalCacheBudget( int bytes )
+{
+    SDL_AtomicSet( &TTF_total_budget, bytes > 0 ? bytes : 0 );
+}
+
+int TTF_GetTotalCacheBudget( void )
+{
+    return SDL_AtomicGet( &TTF_total_budget );
+}
+
+int TTF_GetTotalCacheBytes( void )
+{
+    return SDL_AtomicGet( &TTF_cache_total );
+}
+
+/* Add what the font's cache holds to 'stats' */
+static void Add_Cache_Stats( const TTF_Font* font, TTF_CacheStats* stats )
+{
+    stats->bytes += (int)font->cache_counted;
+    stats->entries += font->cache_entries;
+    stats->hits += font->cache_hits;
+    stats->misses += font->cache_misses;
+    stats->evictions += font->cache_evictions;
+}
+
+int TTF_GetCacheStats( TTF_Font* font, TTF_CacheStats* stats )
+{
+    TTF_Font *other;
+
+    if ( !stats ) {
+        TTF_SetError( "stats parameter was NULL" );
+        return -1;
+    }
+    SDL_zerop( stats );
+    if ( font ) {
+        SDL_LockMutex( font->lock );
+        Add_Cache_Stats( font, stats );
+        SDL_UnlockMutex( font->lock );
+    } else if ( TTF_initialized ) {
+        /* A font loading a glyph holds its lock while it waits for
+           library_lock, so the others are read as they are, a glyph or
+           so behind for the fonts in use right now */
+        SDL_LockMutex( library_lock );
+        for ( other = TTF_fonts; other; other = other->next_font ) {
+            Add_Cache_Stats( other, stats );
+            ++stats->fonts;
+        }
+        SDL_UnlockMutex( library_lock );
+    }
+    SDL_AtomicLock( &TTF_arena.lock );
+    stats->freetype_bytes = (int)TTF_arena.active;
+    stats->freetype_peak = (int)TTF_arena.peak;
+    SDL_AtomicUnlock( &TTF_arena.lock );
+    return 0;
 }
 
-static SDL_bool CharacterIsDelimiter(char c, const char *delimiters)
+void TTF_SetFontCacheBudget( TTF_Font* font, int bytes )
 {
-    while (*delimiters) {
-        if (c == *delimiters) {
-            return SDL_TRUE;
+    SDL_LockMutex(font->lock);
+    Set_Cache_Budget(font, bytes);
+    SDL_UnlockMutex(font->lock);
+}
+
+int TTF_GetFontCacheBudget( const TTF_Font* font )
+{
+    return (int)font->cache_budget;
+}
+
+static int Preload_Glyphs( TTF_Font* font, Uint32 first, Uint32 last )
+{
+    FT_Error error;
+    Sint64 ch;
+
+    for ( ch = first; ch <= last; ++ch ) {
+        if ( ch == UNICODE_BOM_NATIVE || ch == UNICODE_BOM_SWAPPED ) {
+            continue;
+        }
+        error = Find_Glyph( font, (Uint32)ch, CACHED_METRICS|CACHED_BITMAP|CACHED_PIXMAP );
+        if ( error ) {
+            TTF_SetGlyphError(error);
+            return -1;
         }
-        ++delimiters;
     }
-    return SDL_FALSE;
+    return 0;
 }
 
-SDL_Surface *TTF_RenderUTF8_Blended_Wrapped(TTF_Font *font,
-                                    const char *text, SDL_Color fg, Uint32 wrapLength)
+int TTF_PreloadGlyphs( TTF_Font* font, Uint32 first, Uint32 last )
 {
-    SDL_bool first;
-    int xstart;
-    int width, height;
-    SDL_Surface *textbuf;
-    Uint32 alpha;
-    Uint32 pixel;
-    Uint8 *src;
-    Uint32 *dst;
-    Uint32 *dst_check;
-    int row, col;
-    c_glyph *glyph;
-    FT_Error error;
-    FT_Long use_kerning;
-    FT_UInt prev_index = 0;
-    const int lineSpace = 2;
-    int line, numLines, rowSize;
-    char *str, **strLines;
-    size_t textlen;
+    int status;
 
-    TTF_CHECKPOINTER(text, NULL);
+    TTF_CHECKPOINTER(font, -1);
 
-    /* Get the dimensions of the text surface */
-    if ( (TTF_SizeUTF8(font, text, &width, &height) < 0) || !width ) {
-        TTF_SetError("Text has zero width");
-        return(NULL);
-    }
+    SDL_LockMutex(font->lock);
+    status = Preload_Glyphs(font, first, last);
+    SDL_UnlockMutex(font->lock);
+    return status;
+}
 
-    numLines = 1;
-    str = NULL;
-    strLines = NULL;
-    if ( wrapLength > 0 && *text ) {
-        const char *wrapDelims = " \t\r\n";
-        int w, h;
-        int line = 0;
-        char *spot, *tok, *next_tok, *end;
-        char delim;
-        size_t str_len = SDL_strlen(text);
+/* FNV-1a, for the key and the checksum of glyph files */
+static Uint32 Hash_Bytes( Uint32 hash, const void *data, size_t size )
+{
+    const Uint8 *p = (const Uint8 *)data;
 
-        numLines = 0;
+    while ( size-- > 0 ) {
+        hash = (hash ^ *p++) * 16777619u;
+    }
+    return hash;
+}
 
-        str = SDL_stack_alloc(char, str_len+1);
-        if ( str == NULL ) {
-            TTF_SetError("Out of memory");
-            return(NULL);
+/* What the cached glyphs of a font depend on besides their variant, the
+   first of these goes in the file name */
+static void Glyph_File_Key( const TTF_Font* font, Uint32 key[GLYPH_FILE_FIELDS] )
+{
+    const FT_Face face = font->face;
+    const char *names[2];
+    Uint32 hash = 2166136261u;
+    int i, j;
+
+    key[1] = (Uint32)face->num_glyphs;
+    key[2] = (Uint32)face->units_per_EM;
+    key[3] = (Uint32)face->stream->size;
+    key[4] = (Uint32)face->face_index;
+    key[5] = (Uint32)font->size->metrics.x_scale;
+    key[6] = (Uint32)font->size->metrics.y_scale;
+    key[7] = (Uint32)font->font_size_family;
+    key[8] = (Uint32)font->hinting;
+    key[9] = (Uint32)font->ascent;
+    key[10] = (Uint32)font->glyph_overhang;
+
+    /* The names and the numbers above */
+    names[0] = face->family_name;
+    names[1] = face->style_name;
+    for ( i = 0; i < 2; ++i ) {
+        if ( names[i] ) {
+            hash = Hash_Bytes( hash, names[i], SDL_strlen( names[i] ) );
         }
+    }
+    for ( i = 1; i < GLYPH_FILE_FIELDS; ++i ) {
+        for ( j = 0; j < 32; j += 8 ) {
+            Uint8 byte = (Uint8)(key[i] >> j);
+            hash = Hash_Bytes( hash, &byte, 1 );
+        }
+    }
+    key[0] = hash;
+}
 
-        SDL_strlcpy(str, text, str_len+1);
-        tok = str;
-        end = str + str_len;
-        do {
-            strLines = (char **)SDL_realloc(strLines, (numLines+1)*sizeof(*strLines));
-            if (!strLines) {
-                TTF_SetError("Out of memory");
-                return(NULL);
-            }
-            strLines[numLines++] = tok;
+/* Writes a glyph file, summing up what went into it */
+typedef struct glyph_writer {
+    SDL_RWops *dst;
+    Uint32 sum;
+    int ok;
+} glyph_writer;
 
-            /* Look for the end of the line */
-            if ((spot = SDL_strchr(tok, '\r')) != NULL ||
-                (spot = SDL_strchr(tok, '\n')) != NULL) {
-                if (*spot == '\r') {
-                    ++spot;
-                }
-                if (*spot == '\n') {
-                    ++spot;
-                }
-            } else {
-                spot = end;
-            }
-            next_tok = spot;
-
-            /* Get the longest string that will fit in the desired space */
-            for ( ; ; ) {
-                /* Strip trailing whitespace */
-                while ( spot > tok &&
-                        CharacterIsDelimiter(spot[-1], wrapDelims) ) {
-                    --spot;
-                }
-                if ( spot == tok ) {
-                    if (CharacterIsDelimiter(*spot, wrapDelims)) {
-                        *spot = '\0';
-                    }
-                    break;
-                }
-                delim = *spot;
-                *spot = '\0';
+static void Put_Bytes( glyph_writer *writer, const void *data, size_t size )
+{
+    if ( writer->ok && size > 0 ) {
+        writer->ok = ( SDL_RWwrite( writer->dst, data, size, 1 ) == 1 );
+        writer->sum = Hash_Bytes( writer->sum, data, size );
+    }
+}
 
-                TTF_SizeUTF8(font, tok, &w, &h);
-                if ((Uint32)w <= wrapLength) {
-                    break;
-                } else {
-                    /* Back up and try again... */
-                    *spot = delim;
-                }
+static void Put_Word( glyph_writer *writer, Uint32 word )
+{
+    Uint8 bytes[4];
 
-                while ( spot > tok &&
-                        !CharacterIsDelimiter(spot[-1], wrapDelims) ) {
-                    --spot;
-                }
-                if ( spot > tok ) {
-                    next_tok = spot;
-                }
-            }
-            tok = next_tok;
-        } while (tok < end);
+    bytes[0] = (Uint8)word;
+    bytes[1] = (Uint8)(word >> 8);
+    bytes[2] = (Uint8)(word >> 16);
+    bytes[3] = (Uint8)(word >> 24);
+    Put_Bytes( writer, bytes, sizeof( bytes ) );
+}
+
+static void Put_Bitmap( glyph_writer *writer, const FT_Bitmap *bitmap )
+{
+    int rows = bitmap->buffer ? bitmap->rows : 0;
+
+    Put_Word( writer, (Uint32)bitmap->width );
+    Put_Word( writer, (Uint32)rows );
+    Put_Word( writer, (Uint32)bitmap->pitch );
+    Put_Word( writer, (Uint32)bitmap->num_grays );
+    Put_Word( writer, (Uint32)bitmap->pixel_mode );
+    if ( rows > 0 && bitmap->pitch > 0 ) {
+        Put_Bytes( writer, bitmap->buffer, (size_t)bitmap->pitch * rows );
     }
+}
 
-    /* Create the target surface */
-    textbuf = SDL_CreateRGBSurface(SDL_SWSURFACE,
-            (numLines > 1) ? wrapLength : width,
-            height * numLines + (lineSpace * (numLines - 1)),
-            32, 0x00FF0000, 0x0000FF00, 0x000000FF, 0xFF000000);
-    if ( textbuf == NULL ) {
-        if ( strLines ) {
-            SDL_free(strLines);
-            SDL_stack_free(str);
+/* File format, all words little endian:
+     magic, version, the GLYPH_FILE_FIELDS words of Glyph_File_Key(),
+     number of glyphs, then for each glyph
+     code point, variant, index, what's stored, minx, maxx, miny, maxy,
+     yoffset, advance, linear advance, and for the bitmap and/or pixmap
+     width, rows, pitch, grays, pixel mode and pitch * rows bytes,
+     and last the Hash_Bytes() of everything before it.
+ */
+static int Save_Glyphs( TTF_Font* font, SDL_RWops *dst )
+{
+    const int saved = CACHED_METRICS|CACHED_BITMAP|CACHED_PIXMAP;
+    Uint32 key[GLYPH_FILE_FIELDS];
+    glyph_writer writer;
+    int size = font->cache_sets * CACHE_WAYS;
+    int count = 0;
+    int i;
+
+    /* Glyphs from the fallbacks depend on the chain, they aren't saved */
+    for ( i = 0; i < size; ++i ) {
+        if ( (font->cache[i].stored & CACHED_METRICS) && !font->cache[i].source ) {
+            ++count;
         }
-        return(NULL);
     }
+    writer.dst = dst;
+    writer.sum = 2166136261u;
+    writer.ok = 1;
+    Glyph_File_Key( font, key );
+    Put_Word( &writer, GLYPH_FILE_MAGIC );
+    Put_Word( &writer, GLYPH_FILE_VERSION );
+    for ( i = 0; i < GLYPH_FILE_FIELDS; ++i ) {
+        Put_Word( &writer, key[i] );
+    }
+    Put_Word( &writer, (Uint32)count );
 
-    rowSize = textbuf->pitch/4 * height;
+    for ( i = 0; i < size; ++i ) {
+        const c_glyph *glyph = &font->cache[i];
 
-    /* Adding bound checking to avoid all kinds of memory corruption errors
-     that may occur. */
-    dst_check = (Uint32*)textbuf->pixels + textbuf->pitch/4 * textbuf->h;
+        if ( !(glyph->stored & CACHED_METRICS) || glyph->source ) {
+            continue;
+        }
+        Put_Word( &writer, glyph->cached );
+        Put_Word( &writer, (Uint32)glyph->variant );
+        Put_Word( &writer, (Uint32)glyph->index );
+        Put_Word( &writer, (Uint32)(glyph->stored & saved) );
+        Put_Word( &writer, (Uint32)glyph->minx );
+        Put_Word( &writer, (Uint32)glyph->maxx );
+        Put_Word( &writer, (Uint32)glyph->miny );
+        Put_Word( &writer, (Uint32)glyph->maxy );
+        Put_Word( &writer, (Uint32)glyph->yoffset );
+        Put_Word( &writer, (Uint32)glyph->advance );
+        Put_Word( &writer, (Uint32)glyph->linear_advance );
+        if ( glyph->stored & CACHED_BITMAP ) {
+            Put_Bitmap( &writer, &glyph->bits->bitmap );
+        }
+        if ( glyph->stored & CACHED_PIXMAP ) {
+            Put_Bitmap( &writer, &glyph->bits->pixmap );
+        }
+    }
+    Put_Word( &writer, writer.sum );
+    if ( !writer.ok ) {
+        TTF_SetError( "Couldn't write glyph file" );
+        return -1;
+    }
+    return 0;
+}
 
-    /* check kerning */
-    use_kerning = FT_HAS_KERNING( font->face ) && font->kerning;
+static Uint32 Get_Word( const Uint8 **p )
+{
+    const Uint8 *b = *p;
 
-    /* Load and render each character */
-    pixel = (fg.r<<16)|(fg.g<<8)|fg.b;
-    SDL_FillRect(textbuf, NULL, pixel); /* Initialize with fg and 0 alpha */
+    *p += 4;
+    return (Uint32)b[0] | ((Uint32)b[1] << 8) | ((Uint32)b[2] << 16) | ((Uint32)b[3] << 24);
+}
 
-    for ( line = 0; line < numLines; line++ ) {
-        if ( strLines ) {
-            text = strLines[line];
-        }
-        textlen = SDL_strlen(text);
-        first = SDL_TRUE;
-        xstart = 0;
-        while ( textlen > 0 ) {
-            Uint16 c = UTF8_getch(&text, &textlen);
-            if ( c == UNICODE_BOM_NATIVE || c == UNICODE_BOM_SWAPPED ) {
-                continue;
-            }
+static int Read_Bitmap( TTF_Font* font, const Uint8 **p, const Uint8 *end, FT_Bitmap *bitmap )
+{
+    size_t bytes;
 
-            error = Find_Glyph(font, c, CACHED_METRICS|CACHED_PIXMAP);
-            if ( error ) {
-                TTF_SetFTError("Couldn't find glyph", error);
-                SDL_FreeSurface( textbuf );
-                return NULL;
-            }
-            glyph = font->current;
-            /* Ensure the width of the pixmap is correct. On some cases,
-             * freetype may report a larger pixmap than possible.*/
-            width = glyph->pixmap.width;
-            if ( font->outline <= 0 && width > glyph->maxx - glyph->minx ) {
-                width = glyph->maxx - glyph->minx;
-            }
-            /* do kerning, if possible AC-Patch */
-            if ( use_kerning && prev_index && glyph->index ) {
-                FT_Vector delta;
-                FT_Get_Kerning( font->face, prev_index, glyph->index, ft_kerning_default, &delta );
-                xstart += delta.x >> 6;
-            }
+    if ( end - *p < 5 * 4 ) {
+        return -1;
+    }
+    SDL_memset( bitmap, 0, sizeof( *bitmap ) );
+    bitmap->width = (int)Get_Word( p );
+    bitmap->rows = (int)Get_Word( p );
+    bitmap->pitch = (int)Get_Word( p );
+    bitmap->num_grays = (short)Get_Word( p );
+    bitmap->pixel_mode = (char)Get_Word( p );
+    if ( bitmap->rows < 0 || bitmap->rows > 0xFFFF ||
+         bitmap->pitch < 0 || bitmap->pitch > 0xFFFF || bitmap->width < 0 ) {
+        return -1;
+    }
+    bytes = (size_t)bitmap->pitch * bitmap->rows;
+    if ( (size_t)(end - *p) < bytes ) {
+        return -1;
+    }
+    if ( bytes ) {
+        bitmap->buffer = (unsigned char *)Glyph_Alloc( font, bytes );
+        if ( !bitmap->buffer ) {
+            return -1;
+        }
+        SDL_memcpy( bitmap->buffer, *p, bytes );
+        *p += bytes;
+    }
+    return 0;
+}
 
-            /* Compensate for the wrap around bug with negative minx's */
-            if ( first && (glyph->minx < 0) ) {
-                xstart -= glyph->minx;
-            }
-            first = SDL_FALSE;
+/* Put the glyphs of a file written by Save_Glyphs() in the cache, unless
+   the cache already has them */
+static int Load_Glyphs( TTF_Font* font, const Uint8 *p, const Uint8 *end )
+{
+    const int saved = CACHED_METRICS|CACHED_BITMAP|CACHED_PIXMAP;
+    Uint32 key[GLYPH_FILE_FIELDS];
+    const Uint8 *sum;
+    Uint32 count;
+    int i;
 
-            for ( row = 0; row < glyph->pixmap.rows; ++row ) {
-                /* Make sure we don't go either over, or under the
-                 * limit */
-                if ( row+glyph->yoffset < 0 ) {
-                    continue;
-                }
-                if ( row+glyph->yoffset >= textbuf->h ) {
-                    continue;
-                }
-                dst =  ((Uint32*)textbuf->pixels + rowSize * line) +
-                (row+glyph->yoffset) * textbuf->pitch/4 +
-                xstart + glyph->minx;
+    if ( end - p < (2 + GLYPH_FILE_FIELDS + 2) * 4 ||
+         Get_Word( &p ) != GLYPH_FILE_MAGIC || Get_Word( &p ) != GLYPH_FILE_VERSION ) {
+        TTF_SetError( "Not a glyph file" );
+        return -1;
+    }
+    sum = end - 4;
+    if ( Get_Word( &sum ) != Hash_Bytes( 2166136261u, p - 8, (end - 4) - (p - 8) ) ) {
+        TTF_SetError( "Glyph file is corrupt" );
+        return -1;
+    }
+    end -= 4;
+    Glyph_File_Key( font, key );
+    for ( i = 0; i < GLYPH_FILE_FIELDS; ++i ) {
+        if ( Get_Word( &p ) != key[i] ) {
+            TTF_SetError( "Glyph file is for another font, size or hinting" );
+            return -1;
+        }
+    }
 
-                /* Added code to adjust src pointer for pixmaps to
-                 * account for pitch.
-                 * */
-                src = (Uint8*) (glyph->pixmap.buffer + glyph->pixmap.pitch * row);
-                for ( col = width; col>0 && dst < dst_check; --col) {
-                    alpha = *src++;
-                    *dst++ |= pixel | (alpha << 24);
-                }
-            }
+    font->current = NULL;
+    for ( count = Get_Word( &p ); count > 0; --count ) {
+        c_glyph loaded;
+        c_glyph *glyph;
 
-            xstart += glyph->advance;
-            if ( TTF_HANDLE_STYLE_BOLD(font) ) {
-                xstart += font->glyph_overhang;
-            }
-            prev_index = glyph->index;
+        if ( end - p < GLYPH_FILE_FIELDS * 4 ) {
+            break;
         }
-
-        /* Handle the underline style *
-        if ( TTF_HANDLE_STYLE_UNDERLINE(font) ) {
-            row = TTF_underline_top_row(font);
-            TTF_drawLine_Blended(font, textbuf, row, pixel);
+        SDL_memset( &loaded, 0, sizeof( loaded ) );
+        loaded.cached = Get_Word( &p );
+        loaded.variant = (int)Get_Word( &p );
+        loaded.index = (FT_UInt)Get_Word( &p );
+        loaded.stored = (int)Get_Word( &p );
+        loaded.minx = (int)Get_Word( &p );
+        loaded.maxx = (int)Get_Word( &p );
+        loaded.miny = (int)Get_Word( &p );
+        loaded.maxy = (int)Get_Word( &p );
+        loaded.yoffset = (int)Get_Word( &p );
+        loaded.advance = (int)Get_Word( &p );
+        loaded.linear_advance = (FT_Pos)(Sint32)Get_Word( &p );
+        if ( (loaded.stored & ~saved) || !(loaded.stored & CACHED_METRICS) ||
+             ((loaded.stored & (CACHED_BITMAP|CACHED_PIXMAP)) && !Glyph_Bits( font, &loaded )) ||
+             ((loaded.stored & CACHED_BITMAP) && Read_Bitmap( font, &p, end, &loaded.bits->bitmap ) < 0) ||
+             ((loaded.stored & CACHED_PIXMAP) && Read_Bitmap( font, &p, end, &loaded.bits->pixmap ) < 0) ) {
+            Flush_Glyph( font, &loaded );
+            break;
         }
-        */
 
-        /* Handle the strikethrough style *
-        if ( TTF_HANDLE_STYLE_STRIKETHROUGH(font) ) {
-            row = TTF_strikethrough_top_row(font);
-            TTF_drawLine_Blended(font, textbuf, row, pixel);
+        /* A fallback may have what the font drew as a missing glyph */
+        if ( !loaded.index && font->num_fallbacks ) {
+            Flush_Glyph( font, &loaded );
+            continue;
         }
-        */
+        glyph = Claim_Glyph( font, loaded.cached, loaded.variant );
+        if ( glyph->stored ) {
+            Flush_Glyph( font, &loaded );
+            continue;
+        }
+        loaded.lru = ++font->cache_tick;
+        *glyph = loaded;
+        font->cache_bytes += Glyph_Bytes( glyph );
+        ++font->cache_entries;
+        Trim_Cache( font );
     }
-
-    if ( strLines ) {
-        SDL_free(strLines);
-        SDL_stack_free(str);
+    if ( count > 0 ) {
+        TTF_SetError( "Glyph file is corrupt" );
+        return -1;
     }
-    return(textbuf);
+    return 0;
 }
 
-SDL_Surface *TTF_RenderUNICODE_Blended_Wrapped(TTF_Font *font, const Uint16* text,
-                                               SDL_Color fg, Uint32 wrapLength)
+int TTF_SaveGlyphsRW( TTF_Font* font, SDL_RWops *dst, int freedst )
 {
-    SDL_Surface *surface = NULL;
-    Uint8 *utf8;
-
-    TTF_CHECKPOINTER(text, NULL);
+    int status = -1;
 
-    utf8 = SDL_stack_alloc(Uint8, UCS2_len(text)*3+1);
-    if ( utf8 ) {
-        UCS2_to_UTF8(text, utf8);
-        surface = TTF_RenderUTF8_Blended_Wrapped(font, (char *)utf8, fg, wrapLength);
-        SDL_stack_free(utf8);
+    if ( font && dst ) {
+        SDL_LockMutex( font->lock );
+        status = Save_Glyphs( font, dst );
+        SDL_UnlockMutex( font->lock );
     } else {
-        SDL_OutOfMemory();
+        TTF_SetError( "Passed a NULL pointer" );
     }
-    return surface;
+    if ( freedst && dst ) {
+        SDL_RWclose( dst );
+    }
+    return status;
 }
 
-SDL_Surface *TTF_RenderGlyph_Blended(TTF_Font *font, Uint16 ch, SDL_Color fg)
+int TTF_LoadGlyphsRW( TTF_Font* font, SDL_RWops *src, int freesrc )
 {
-    Uint16 ucs2[2] = { ch, 0 };
-    Uint8 utf8[4];
+    Sint64 size;
+    Uint8 *data = NULL;
+    int status = -1;
 
-    UCS2_to_UTF8(ucs2, utf8);
-    return TTF_RenderUTF8_Blended(font, (char *)utf8, fg);
+    if ( !font || !src ) {
+        TTF_SetError( "Passed a NULL pointer" );
+    } else if ( (size = SDL_RWsize( src )) < 0 || (Uint64)size > SDL_MAX_SINT32 ) {
+        TTF_SetError( "Couldn't get the size of the glyph file" );
+    } else if ( (data = (Uint8 *)SDL_malloc( (size_t)size + 1 )) == NULL ) {
+        TTF_SetError( "Out of memory" );
+    } else if ( SDL_RWread( src, data, 1, (size_t)size ) != (size_t)size ) {
+        TTF_SetError( "Couldn't read glyph file" );
+    } else {
+        SDL_LockMutex( font->lock );
+        status = Load_Glyphs( font, data, data + size );
+        SDL_UnlockMutex( font->lock );
+    }
+    SDL_free( data );
+    if ( freesrc && src ) {
+        SDL_RWclose( src );
+    }
+    return status;
 }
 
-void TTF_SetFontStyle( TTF_Font* font, int style )
+int TTF_SetGlyphCacheDir( const char *path )
 {
-    int prev_style = font->style;
-    font->style = style | font->face_style;
+    char *dir = NULL;
 
-    /* Flush the cache if the style has changed.
-     * Ignore UNDERLINE which does not impact glyph drawning.
-     * */
-    if ( (font->style | TTF_STYLE_NO_GLYPH_CHANGE ) != ( prev_style | TTF_STYLE_NO_GLYPH_CHANGE )) {
-        Flush_Cache( font );
+    if ( path ) {
+        dir = SDL_strdup( path );
+        if ( !dir ) {
+            TTF_SetError( "Out of memory" );
+            return -1;
+        }
     }
+    SDL_AtomicLock( &TTF_glyph_dir_lock );
+    SDL_free( TTF_glyph_dir );
+    TTF_glyph_dir = dir;
+    SDL_AtomicUnlock( &TTF_glyph_dir_lock );
+    return 0;
 }
 
-int TTF_GetFontStyle( const TTF_Font* font )
+/* The glyph file of the font in TTF_glyph_dir, NULL if there's no dir */
+static char *Glyph_File_Path( const TTF_Font* font )
 {
-    return font->style;
+    Uint32 key[GLYPH_FILE_FIELDS];
+    char *path = NULL;
+
+    Glyph_File_Key( font, key );
+    SDL_AtomicLock( &TTF_glyph_dir_lock );
+    if ( TTF_glyph_dir ) {
+        size_t len = SDL_strlen( TTF_glyph_dir ) + 32;
+        path = (char *)SDL_malloc( len );
+        if ( path ) {
+            SDL_snprintf( path, len, "%s/ttf-%08x.glyphs", TTF_glyph_dir, key[0] );
+        }
+    }
+    SDL_AtomicUnlock( &TTF_glyph_dir_lock );
+    return path;
 }
 
-void TTF_SetFontOutline( TTF_Font* font, int outline )
+/* Called with the font locked, or before anyone else has it.  A missing
+   or stale file just means the glyphs come from FreeType. */
+static void Read_Glyph_File( TTF_Font* font )
 {
-    font->outline = outline;
-    Flush_Cache( font );
-}
+    char *path = Glyph_File_Path( font );
+    SDL_RWops *src;
 
-int TTF_GetFontOutline( const TTF_Font* font )
-{
-    return font->outline;
+    if ( path ) {
+        src = SDL_RWFromFile( path, "rb" );
+        if ( src ) {
+            TTF_LoadGlyphsRW( font, src, 1 );
+        }
+        SDL_free( path );
+    }
+    font->glyphs_added = 0;
 }
 
-void TTF_SetFontHinting( TTF_Font* font, int hinting )
+static void Write_Glyph_File( TTF_Font* font )
 {
-    if (hinting == TTF_HINTING_LIGHT)
-        font->hinting = FT_LOAD_TARGET_LIGHT;
-    else if (hinting == TTF_HINTING_MONO)
-        font->hinting = FT_LOAD_TARGET_MONO;
-    else if (hinting == TTF_HINTING_NONE)
-        font->hinting = FT_LOAD_NO_HINTING;
-    else
-        font->hinting = 0;
+    char *path = Glyph_File_Path( font );
+    SDL_RWops *dst;
 
-    Flush_Cache( font );
+    if ( path ) {
+        dst = SDL_RWFromFile( path, "wb" );
+        if ( dst ) {
+            TTF_SaveGlyphsRW( font, dst, 1 );
+        }
+        SDL_free( path );
+    }
+    font->glyphs_added = 0;
 }
 
 int TTF_GetFontHinting( const TTF_Font* font )
@@ -2186,11 +5917,27 @@ void TTF_Quit( void )
 {
     if ( TTF_initialized ) {
         if ( --TTF_initialized == 0 ) {
-            FT_Done_FreeType( library );
+            Stop_Render_Pool( &TTF_render_pool );
+            FT_Done_Library( library );
+            Arena_Done( &TTF_arena );
+            SDL_DestroyMutex( library_lock );
+            library_lock = NULL;
         }
     }
 }
 
+void TTF_GetFreeTypeMemory( size_t *active, size_t *peak )
+{
+    SDL_AtomicLock( &TTF_arena.lock );
+    if ( active ) {
+        *active = TTF_arena.active;
+    }
+    if ( peak ) {
+        *peak = TTF_arena.peak;
+    }
+    SDL_AtomicUnlock( &TTF_arena.lock );
+}
+
 int TTF_WasInit( void )
 {
     return TTF_initialized;
@@ -2199,16 +5946,19 @@ int TTF_WasInit( void )
 /* don't use this function. It's just here for binary compatibility. */
 int TTF_GetFontKerningSize(TTF_Font* font, int prev_index, int index)
 {
-    FT_Vector delta;
-    FT_Get_Kerning( font->face, prev_index, index, ft_kerning_default, &delta );
-    return (delta.x >> 6);
+    int delta;
+
+    SDL_LockMutex(font->lock);
+    Get_Kerning( font, prev_index, index, &delta );
+    SDL_UnlockMutex(font->lock);
+    return delta;
 }
 
-int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, Uint16 previous_ch, Uint16 ch)
+static int Kerning_Size_Glyphs(TTF_Font *font, Uint32 previous_ch, Uint32 ch)
 {
     int error;
     int glyph_index, prev_index;
-    FT_Vector delta;
+    int delta;
 
     if (ch == UNICODE_BOM_NATIVE || ch == UNICODE_BOM_SWAPPED) {
         return 0;
@@ -2220,23 +5970,38 @@ int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, Uint16 previous_ch, Uint16 ch)
 
     error = Find_Glyph(font, ch, CACHED_METRICS);
     if (error) {
-        TTF_SetFTError("Couldn't find glyph", error);
+        TTF_SetGlyphError(error);
         return -1;
     }
     glyph_index = font->current->index;
 
     error = Find_Glyph(font, previous_ch, CACHED_METRICS);
     if (error) {
-        TTF_SetFTError("Couldn't find glyph", error);
+        TTF_SetGlyphError(error);
         return -1;
     }
     prev_index = font->current->index;
 
-    error = FT_Get_Kerning(font->face, prev_index, glyph_index, ft_kerning_default, &delta);
+    error = Get_Kerning(font, prev_index, glyph_index, &delta);
     if (error) {
         TTF_SetFTError("Couldn't get glyph kerning", error);
         return -1;
     }
-    return (delta.x >> 6);
+    return delta;
+}
+
+int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, Uint16 previous_ch, Uint16 ch)
+{
+    return TTF_GetFontKerningSizeGlyphs32(font, previous_ch, ch);
+}
+
+int TTF_GetFontKerningSizeGlyphs32(TTF_Font *font, Uint32 previous_ch, Uint32 ch)
+{
+    int status;
+
+    SDL_LockMutex(font->lock);
+    status = Kerning_Size_Glyphs(font, previous_ch, ch);
+    SDL_UnlockMutex(font->lock);
+    return status;
 }
 
@@ -91,12 +91,33 @@ extern DECLSPEC int SDLCALL TTF_Init(void);
 /* Open a font file and create a font of the specified point size.
  * Some .fon fonts will have several sizes embedded in the file, so the
  * point size becomes the index of choosing which size.  If the value
- * is too high, the last indexed size will be the default. */
+ * is too high, the last indexed size will be the default.
+ * Fonts may be used from several threads at once.  Calls on the same font
+ * take turns, calls on different fonts only wait for each other while
+ * FreeType loads a glyph that isn't cached yet.  Surfaces and text runs
+ * returned for a font are only as shared as the caller makes them. */
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFont(const char *file, int ptsize);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndex(const char *file, int ptsize, long index);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontRW(SDL_RWops *src, int freesrc, int ptsize);
 extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndexRW(SDL_RWops *src, int freesrc, int ptsize, long index);
 
+/* Open a font from a file that is already in memory, such as a mapped
+   Android asset.  FreeType reads the data in place, so it must stay valid
+   until the font is closed.  Memory RWops passed to TTF_OpenFontRW() are
+   read in place the same way, and Android asset RWops are read into
+   memory once when the font is opened, so glyph loads never go back to
+   the stream.
+ */
+extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontMem(const void *mem, int size, int ptsize);
+extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontIndexMem(const void *mem, int size, int ptsize, long index);
+
+/* Open another point size of an open font.  The new font shares the file,
+   the FreeType face and its character maps with the original, so neither
+   is parsed or loaded again; only the glyph cache is its own.  The fonts
+   can be closed in any order, and used from different threads.
+ */
+extern DECLSPEC TTF_Font * SDLCALL TTF_OpenFontSize(TTF_Font *font, int ptsize);
+
 /* Set and retrieve the font style */
 #define TTF_STYLE_NORMAL        0x00
 #define TTF_STYLE_BOLD          0x01
@@ -116,6 +137,90 @@ extern DECLSPEC void SDLCALL TTF_SetFontOutline(TTF_Font *font, int outline);
 extern DECLSPEC int SDLCALL TTF_GetFontHinting(const TTF_Font *font);
 extern DECLSPEC void SDLCALL TTF_SetFontHinting(TTF_Font *font, int hinting);
 
+/* Set and retrieve how many bytes of glyph cache the font may hold.
+   The cache grows up to this size before it starts replacing the least
+   recently used glyphs.  A value of 0 or less restores the default of 1 MB.
+ */
+extern DECLSPEC int SDLCALL TTF_GetFontCacheBudget(const TTF_Font *font);
+extern DECLSPEC void SDLCALL TTF_SetFontCacheBudget(TTF_Font *font, int bytes);
+
+/* Set and retrieve how many bytes of glyph cache all open fonts may hold
+   together, on top of each font's own budget.  A font that needs room
+   past it takes glyphs back from the fonts holding more than an even share
+   first, then from its own least recently used ones.  A value of 0 or less
+   means no limit, which is the default.  TTF_GetTotalCacheBytes() returns
+   what the fonts hold now.
+ */
+extern DECLSPEC int SDLCALL TTF_GetTotalCacheBudget(void);
+extern DECLSPEC void SDLCALL TTF_SetTotalCacheBudget(int bytes);
+extern DECLSPEC int SDLCALL TTF_GetTotalCacheBytes(void);
+
+/* How the glyph cache of a font has done since it was opened, or that of
+   all open fonts together if font is NULL.  The FreeType memory, the
+   faces and what FreeType keeps for them, is that of all fonts either way.
+   Returns 0, or -1 on error.
+ */
+typedef struct TTF_CacheStats {
+    int bytes;              /* glyph slots and bitmaps, what the budgets count */
+    int entries;            /* glyphs cached */
+    Uint32 hits;            /* glyphs found rendered the way they were wanted */
+    Uint32 misses;          /* glyphs FreeType had to render */
+    Uint32 evictions;       /* glyphs dropped to make room */
+    int fonts;              /* open fonts counted, 0 for a single font */
+    int freetype_bytes;
+    int freetype_peak;
+} TTF_CacheStats;
+
+extern DECLSPEC int SDLCALL TTF_GetCacheStats(TTF_Font *font, TTF_CacheStats *stats);
+
+/* Rasterize the code points first through last into the glyph cache, so
+   the first strings drawn with them don't have to wait on FreeType, e.g.
+   TTF_PreloadGlyphs(font, 0x20, 0xFF) for Latin-1.
+   This can run on a loading thread while another thread renders with
+   the same font.
+   This function returns 0, or -1 if a glyph couldn't be loaded.
+ */
+extern DECLSPEC int SDLCALL TTF_PreloadGlyphs(TTF_Font *font, Uint32 first, Uint32 last);
+
+/* Write the glyphs in the font's cache, with their metrics and bitmaps, and
+   read them back into the cache of the same font opened at the same size
+   and hinting, e.g. in a later run of the program.  Glyphs read back are
+   drawn without going through FreeType.  A file written for another font,
+   size or hinting is refused.
+   These functions return 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL TTF_SaveGlyphsRW(TTF_Font *font, SDL_RWops *dst, int freedst);
+extern DECLSPEC int SDLCALL TTF_LoadGlyphsRW(TTF_Font *font, SDL_RWops *src, int freesrc);
+
+/* Keep a glyph file for each font and size in 'path', e.g. from
+   SDL_GetPrefPath().  Fonts read theirs when they're opened and when
+   their hinting changes, and write it back when they're closed if
+   FreeType had to render glyphs it was missing.  The directory has to
+   exist.  NULL turns this off, which is the default.
+   Returns 0, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL TTF_SetGlyphCacheDir(const char *path);
+
+/* Set how many threads TTF_RenderUTF8_Blended_Wrapped() and friends may
+   composite the lines of long text on, on top of the calling thread.
+   -1 picks one less than the number of CPUs, 0 turns it off, which is
+   the default.  The threads are shared by all fonts and stopped by
+   TTF_Quit().  TTF_GetRenderThreads() returns how many are running.
+   Returns 0, or -1 if the threads couldn't be started.
+ */
+extern DECLSPEC int SDLCALL TTF_SetRenderThreads(int count);
+extern DECLSPEC int SDLCALL TTF_GetRenderThreads(void);
+
+/* Composite on the application's threads instead of the render threads.
+   The handler is called with a job to run once with data on some other
+   thread, and returns 0 if it took it or -1 if it didn't.  The caller
+   works on the text as well and returns once it's done, the jobs that
+   get to run after that find nothing left and return at once.  NULL
+   goes back to the render threads, if any.
+ */
+typedef int (SDLCALL *TTF_JobHandler)(void (SDLCALL *job)(void *data), void *data, void *udata);
+extern DECLSPEC void SDLCALL TTF_SetJobHandler(TTF_JobHandler handler, void *udata);
+
 /* Get the total height of the font - usually equal to point size */
 extern DECLSPEC int SDLCALL TTF_FontHeight(const TTF_Font *font);
 
@@ -136,6 +241,34 @@ extern DECLSPEC int SDLCALL TTF_FontLineSkip(const TTF_Font *font);
 extern DECLSPEC int SDLCALL TTF_GetFontKerning(const TTF_Font *font);
 extern DECLSPEC void SDLCALL TTF_SetFontKerning(TTF_Font *font, int allowed);
 
+/* Get/Set whether glyphs are placed at fractional pixel positions.  Each
+   glyph is then rendered at up to TTF_SUBPIXEL_PHASES offsets within a
+   pixel, every offset cached like any other glyph, and advanced by its
+   unhinted width.  This evens out the spacing of small text, and looks
+   best with TTF_HINTING_LIGHT or TTF_HINTING_NONE.  It's off by default
+   and has no effect on bitmap fonts.
+ */
+#define TTF_SUBPIXEL_PHASES 4
+extern DECLSPEC int SDLCALL TTF_GetFontSubpixel(const TTF_Font *font);
+extern DECLSPEC void SDLCALL TTF_SetFontSubpixel(TTF_Font *font, int allowed);
+
+/* Get/Set how text is turned into glyphs.  TTF_SHAPING_NONE, the default,
+   places one glyph per code point with pairwise kerning.  The others have
+   HarfBuzz shape each string in that direction, for the ligatures,
+   contextual forms, reordering and mark placement scripts like Arabic and
+   Devanagari need.  A font remembers the shaping of the last strings it
+   laid out, so text drawn every frame is only shaped once, and the glyphs
+   go through the same cache and atlas as unshaped ones.  Wrapped text is
+   broken into lines at unshaped widths, then each line is shaped.
+   This function returns 0, or -1 if SDL_ttf was built without HarfBuzz.
+ */
+#define TTF_SHAPING_NONE    0
+#define TTF_SHAPING_LTR     1
+#define TTF_SHAPING_RTL     2
+#define TTF_GLYPH_INDEX     0x80000000  /* in TTF_RunGlyph ch, see above */
+extern DECLSPEC int SDLCALL TTF_GetFontShaping(const TTF_Font *font);
+extern DECLSPEC int SDLCALL TTF_SetFontShaping(TTF_Font *font, int shaping);
+
 /* Get the number of faces of the font */
 extern DECLSPEC long SDLCALL TTF_FontFaces(const TTF_Font *font);
 
@@ -144,8 +277,24 @@ extern DECLSPEC int SDLCALL TTF_FontFaceIsFixedWidth(const TTF_Font *font);
 extern DECLSPEC char * SDLCALL TTF_FontFaceFamilyName(const TTF_Font *font);
 extern DECLSPEC char * SDLCALL TTF_FontFaceStyleName(const TTF_Font *font);
 
-/* Check wether a glyph is provided by the font or not */
+/* Check wether a glyph is provided by the font or not.  The 32 versions
+   of the glyph functions take any code point, including those above the
+   BMP, the others are limited to 16 bits.
+ */
 extern DECLSPEC int SDLCALL TTF_GlyphIsProvided(const TTF_Font *font, Uint16 ch);
+extern DECLSPEC int SDLCALL TTF_GlyphIsProvided32(const TTF_Font *font, Uint32 ch);
+
+/* Draw the code points the font has no glyph for with the first of the
+   fallback fonts that does, e.g. a CJK font behind a Latin one, so mixed
+   strings still lay out, render and draw in one call on the font.  The
+   fallback glyphs are loaded at the fallbacks' own sizes and hinting but
+   styled like the font, share its glyph cache and atlas, and sit on its
+   baseline.  Which font each code point comes from is remembered until
+   the chain is set again; count 0 removes it.
+   The fallbacks must stay open while the font uses them.
+   This function returns 0, or -1 if a fallback is NULL or the font itself.
+ */
+extern DECLSPEC int SDLCALL TTF_SetFontFallbacks(TTF_Font *font, TTF_Font * const *fallbacks, int count);
 
 /* Get the metrics (dimensions) of a glyph
    To understand what these metrics mean, here is a useful link:
@@ -154,12 +303,41 @@ extern DECLSPEC int SDLCALL TTF_GlyphIsProvided(const TTF_Font *font, Uint16 ch)
 extern DECLSPEC int SDLCALL TTF_GlyphMetrics(TTF_Font *font, Uint16 ch,
                      int *minx, int *maxx,
                                      int *miny, int *maxy, int *advance);
+extern DECLSPEC int SDLCALL TTF_GlyphMetrics32(TTF_Font *font, Uint32 ch,
+                     int *minx, int *maxx,
+                                     int *miny, int *maxy, int *advance);
 
 /* Get the dimensions of a rendered string of text */
 extern DECLSPEC int SDLCALL TTF_SizeText(TTF_Font *font, const char *text, int *w, int *h);
 extern DECLSPEC int SDLCALL TTF_SizeUTF8(TTF_Font *font, const char *text, int *w, int *h);
 extern DECLSPEC int SDLCALL TTF_SizeUNICODE(TTF_Font *font, const Uint16 *text, int *w, int *h);
 
+/* A line of text that has been decoded, kerned and measured once, so it
+   can be sized and drawn any number of times without doing that again.
+   If the font style, outline, hinting, kerning or subpixel positioning
+   changes, the run is laid out again the next time it is used.  Free
+   runs before their font.
+ */
+typedef struct _TTF_TextRun TTF_TextRun;
+
+typedef struct TTF_RunGlyph {
+    Uint32 ch;      /* the code point, or TTF_GLYPH_INDEX | index if shaped */
+    int x;          /* pen position of the glyph origin in the rendered text */
+    int phase;      /* and how far right of it, in 1/TTF_SUBPIXEL_PHASES pixels */
+    int y;          /* pixels below the baseline shaping moved it, else 0 */
+} TTF_RunGlyph;
+
+extern DECLSPEC TTF_TextRun * SDLCALL TTF_LayoutText(TTF_Font *font, const char *text);
+extern DECLSPEC TTF_TextRun * SDLCALL TTF_LayoutUTF8(TTF_Font *font, const char *text);
+extern DECLSPEC TTF_TextRun * SDLCALL TTF_LayoutUNICODE(TTF_Font *font, const Uint16 *text);
+extern DECLSPEC void SDLCALL TTF_FreeTextRun(TTF_TextRun *run);
+
+/* Get the dimensions the run renders at, same as TTF_SizeUTF8() */
+extern DECLSPEC int SDLCALL TTF_SizeTextRun(TTF_TextRun *run, int *w, int *h);
+
+/* Get the glyphs of the run in order, valid until the run changes */
+extern DECLSPEC const TTF_RunGlyph * SDLCALL TTF_TextRunGlyphs(TTF_TextRun *run, int *count);
+
 /* Create an 8-bit palettized surface and render the given text at
    fast quality with the given font and color.  The 0 pixel is the
    colorkey, giving a transparent background, and the 1 pixel is set
@@ -172,6 +350,8 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUTF8_Solid(TTF_Font *font,
                 const char *text, SDL_Color fg);
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Solid(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderTextRun_Solid(TTF_TextRun *run,
+                SDL_Color fg);
 
 /* Create an 8-bit palettized surface and render the given glyph at
    fast quality with the given font and color.  The 0 pixel is the
@@ -182,6 +362,8 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Solid(TTF_Font *font,
 */
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph_Solid(TTF_Font *font,
                     Uint16 ch, SDL_Color fg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph32_Solid(TTF_Font *font,
+                    Uint32 ch, SDL_Color fg);
 
 /* Create an 8-bit palettized surface and render the given text at
    high quality with the given font and colors.  The 0 pixel is background,
@@ -194,6 +376,8 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUTF8_Shaded(TTF_Font *font,
                 const char *text, SDL_Color fg, SDL_Color bg);
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Shaded(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg, SDL_Color bg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderTextRun_Shaded(TTF_TextRun *run,
+                SDL_Color fg, SDL_Color bg);
 
 /* Create an 8-bit palettized surface and render the given glyph at
    high quality with the given font and colors.  The 0 pixel is background,
@@ -204,6 +388,8 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Shaded(TTF_Font *font,
 */
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph_Shaded(TTF_Font *font,
                 Uint16 ch, SDL_Color fg, SDL_Color bg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph32_Shaded(TTF_Font *font,
+                Uint32 ch, SDL_Color fg, SDL_Color bg);
 
 /* Create a 32-bit ARGB surface and render the given text at high quality,
    using alpha blending to dither the font with the given color.
@@ -215,6 +401,30 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUTF8_Blended(TTF_Font *font,
                 const char *text, SDL_Color fg);
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Blended(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderTextRun_Blended(TTF_TextRun *run,
+                SDL_Color fg);
+
+/* Render the given text like TTF_RenderUTF8_Blended(), but into an existing
+   w x h buffer of 32-bit ARGB pixels, with the top left corner of the text
+   at (x, y).  Nothing is allocated, so one buffer (for instance a locked
+   streaming texture) can be reused for text that changes every frame.
+   Pixels the text covers take the foreground color and keep the larger of
+   the old and new alpha; clear the area first to get the same pixels the
+   surface functions would return.  Text outside the buffer is clipped.
+   This function returns 0, or -1 if there was an error.
+*/
+extern DECLSPEC int SDLCALL TTF_RenderText_Blended_Into(TTF_Font *font,
+                const char *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y);
+extern DECLSPEC int SDLCALL TTF_RenderUTF8_Blended_Into(TTF_Font *font,
+                const char *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y);
+extern DECLSPEC int SDLCALL TTF_RenderUNICODE_Blended_Into(TTF_Font *font,
+                const Uint16 *text, SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y);
+extern DECLSPEC int SDLCALL TTF_RenderTextRun_Blended_Into(TTF_TextRun *run,
+                SDL_Color fg,
+                void *pixels, int pitch, int w, int h, int x, int y);
 
 
 /* Create a 32-bit ARGB surface and render the given text at high quality,
@@ -230,6 +440,22 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUTF8_Blended_Wrapped(TTF_Font *f
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Blended_Wrapped(TTF_Font *font,
                 const Uint16 *text, SDL_Color fg, Uint32 wrapLength);
 
+/* Where TTF_RenderUTF8_Blended_Wrapped() breaks a string into lines: each
+   line is length bytes of the text starting at offset, and w wide.
+ */
+typedef struct TTF_LineSpan {
+    int offset;
+    int length;
+    int w;
+} TTF_LineSpan;
+
+/* Break UTF-8 text into lines no wider than wrapLength without rendering
+   it, e.g. to paginate.  Up to maxlines lines are stored in lines.
+   This function returns the total number of lines, or -1 on error.
+ */
+extern DECLSPEC int SDLCALL TTF_WrapUTF8(TTF_Font *font, const char *text,
+                Uint32 wrapLength, TTF_LineSpan *lines, int maxlines);
+
 /* Create a 32-bit ARGB surface and render the given glyph at high quality,
    using alpha blending to dither the font with the given color.
    The glyph is rendered without any padding or centering in the X
@@ -238,6 +464,83 @@ extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Blended_Wrapped(TTF_Font
 */
 extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph_Blended(TTF_Font *font,
                         Uint16 ch, SDL_Color fg);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderGlyph32_Blended(TTF_Font *font,
+                        Uint32 ch, SDL_Color fg);
+
+/* Create a 32-bit ARGB surface and render the given text scale times the
+   font's size, e.g. to follow SDL_RenderSetLogicalSize() or a zoom level.
+   The glyphs are drawn from signed distance fields kept in the glyph
+   cache, so changing the scale never rasterizes them again.  Layout and
+   kerning are those of the font's own size, scaled.
+   This function returns the new surface, or NULL if there was an error.
+*/
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderText_Scaled(TTF_Font *font,
+                const char *text, SDL_Color fg, float scale);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUTF8_Scaled(TTF_Font *font,
+                const char *text, SDL_Color fg, float scale);
+extern DECLSPEC SDL_Surface * SDLCALL TTF_RenderUNICODE_Scaled(TTF_Font *font,
+                const Uint16 *text, SDL_Color fg, float scale);
+
+/* Draw the given text straight to a renderer, with the top left corner of
+   what TTF_RenderUTF8_Blended() would return at (x, y).  Glyphs are packed
+   into a texture owned by the font the first time they are drawn, so
+   redrawing text that changes every frame costs no surface or upload.
+   The font keeps one texture, for the last renderer it was drawn to.
+   This function returns 0, or -1 if there was an error.
+*/
+extern DECLSPEC int SDLCALL TTF_DrawText(SDL_Renderer *renderer, TTF_Font *font,
+                const char *text, int x, int y, SDL_Color fg);
+extern DECLSPEC int SDLCALL TTF_DrawUTF8(SDL_Renderer *renderer, TTF_Font *font,
+                const char *text, int x, int y, SDL_Color fg);
+extern DECLSPEC int SDLCALL TTF_DrawUNICODE(SDL_Renderer *renderer, TTF_Font *font,
+                const Uint16 *text, int x, int y, SDL_Color fg);
+extern DECLSPEC int SDLCALL TTF_DrawTextRun(SDL_Renderer *renderer, TTF_TextRun *run,
+                int x, int y, SDL_Color fg);
+
+/* Destroy the texture used by the TTF_Draw*() functions.  Call this before
+   destroying the renderer, and after SDL_RENDER_DEVICE_RESET, since the
+   texture contents are lost.  The next draw builds a new one.
+*/
+extern DECLSPEC void SDLCALL TTF_ClearFontAtlas(TTF_Font *font);
+
+/* A cache of rendered strings, for UI text that is drawn every frame but
+   rarely changes.  Entries are matched on the font, its style, outline,
+   kerning and hinting, the text and the color, and the least recently
+   used one is replaced when the cache is full.  A max_entries of 0 or
+   less holds 32 strings.  The renderer may be NULL if only surfaces are
+   wanted.  A cache must only be used from one thread at a time.
+ */
+typedef struct _TTF_TextCache TTF_TextCache;
+extern DECLSPEC TTF_TextCache * SDLCALL TTF_CreateTextCache(SDL_Renderer *renderer, int max_entries);
+
+/* Return text rendered like TTF_RenderUTF8_Blended() would, or the same
+   text uploaded to a texture of the cache's renderer, rendering it only if
+   the cache doesn't hold it yet.  The cache keeps ownership, and the
+   result stays valid until it is replaced by a later call.
+   These functions return NULL if there was an error.
+ */
+extern DECLSPEC SDL_Surface * SDLCALL TTF_CachedUTF8_Blended(TTF_TextCache *cache,
+                TTF_Font *font, const char *text, SDL_Color fg);
+extern DECLSPEC SDL_Texture * SDLCALL TTF_CachedUTF8_Texture(TTF_TextCache *cache,
+                TTF_Font *font, const char *text, SDL_Color fg);
+
+/* Keep the surface of a string after it's uploaded, so the texture can be
+   made again from it without rendering the text.  Off by default.
+ */
+extern DECLSPEC void SDLCALL TTF_SetTextCacheRetain(TTF_TextCache *cache, int retain);
+
+/* Destroy the textures of the cache but keep its strings, for after
+   SDL_RENDER_DEVICE_RESET.  Each is uploaded again the next time it's
+   asked for, from its surface if the cache retains them.
+ */
+extern DECLSPEC void SDLCALL TTF_ReleaseTextCacheTextures(TTF_TextCache *cache);
+
+/* Drop every string in the cache.  Call this after SDL_RENDER_DEVICE_RESET,
+   if the strings aren't wanted again, and free the cache before destroying
+   its renderer.
+ */
+extern DECLSPEC void SDLCALL TTF_ClearTextCache(TTF_TextCache *cache);
+extern DECLSPEC void SDLCALL TTF_FreeTextCache(TTF_TextCache *cache);
 
 /* For compatibility with previous versions, here are the old functions */
 #define TTF_RenderText(font, text, fg, bg)  \
@@ -256,6 +559,13 @@ extern DECLSPEC void SDLCALL TTF_Quit(void);
 /* Check if the TTF engine is initialized */
 extern DECLSPEC int SDLCALL TTF_WasInit(void);
 
+/* Get how many bytes FreeType has allocated right now, and the most it
+   has had at once since TTF_Init().  Small blocks FreeType frees are kept
+   for reuse by later allocations, and go back to the system at TTF_Quit().
+   Either pointer may be NULL.
+ */
+extern DECLSPEC void SDLCALL TTF_GetFreeTypeMemory(size_t *active, size_t *peak);
+
 /* Get the kerning size of two glyphs indices */
 /* DEPRECATED: this function requires FreeType font indexes, not glyphs,
    by accident, which we don't expose through this API, so it could give
@@ -266,10 +576,17 @@ extern DECLSPEC int TTF_GetFontKerningSize(TTF_Font *font, int prev_index, int i
 
 /* Get the kerning size of two glyphs */
 extern DECLSPEC int TTF_GetFontKerningSizeGlyphs(TTF_Font *font, Uint16 previous_ch, Uint16 ch);
+extern DECLSPEC int TTF_GetFontKerningSizeGlyphs32(TTF_Font *font, Uint32 previous_ch, Uint32 ch);
 
-/* We'll use SDL for reporting errors */
+/* We'll use SDL for reporting errors.  Text that fails on a glyph the
+   font can't provide doesn't make its message until TTF_GetError() is
+   called on the same thread, so call it rather than SDL_GetError().
+   TTF_GetFTError() gives the FreeType error of such a failure, 0 if the
+   thread's last error wasn't one or TTF_GetError() has reported it.
+ */
 #define TTF_SetError    SDL_SetError
-#define TTF_GetError    SDL_GetError
+extern DECLSPEC const char * SDLCALL TTF_GetError(void);
+extern DECLSPEC int SDLCALL TTF_GetFTError(void);
 
 /* Ends C function definitions when using C++ */
 #ifdef __cplusplus
@@ -0,0 +1,22 @@
+/*
+ *  The FreeType modules SDL_ttf registers when it's built with
+ *  TRUETYPE_ONLY, see Android.mk.  FT_Init_FreeType() sets up and
+ *  FT_Open_Face() probes only these, instead of every driver in
+ *  <freetype/config/ftmodule.h>.
+ *
+ *  TrueType and OpenType (CFF) outlines, the auto-hinter for
+ *  TTF_HINTING_LIGHT, and the mono and gray renderers.  psnames and
+ *  pshinter are what the CFF driver needs for glyph names and hinting.
+ *
+ */
+
+FT_USE_MODULE( FT_Module_Class, autofit_module_class )
+FT_USE_MODULE( FT_Driver_ClassRec, tt_driver_class )
+FT_USE_MODULE( FT_Driver_ClassRec, cff_driver_class )
+FT_USE_MODULE( FT_Module_Class, psnames_module_class )
+FT_USE_MODULE( FT_Module_Class, pshinter_module_class )
+FT_USE_MODULE( FT_Renderer_Class, ft_raster1_renderer_class )
+FT_USE_MODULE( FT_Module_Class, sfnt_module_class )
+FT_USE_MODULE( FT_Renderer_Class, ft_smooth_renderer_class )
+
+/* EOF */
@@ -0,0 +1,296 @@
+/*
+  ttfbench:  A benchmark for the SDL_ttf library.
+  Copyright (C) 2001-2016 Sam Lantinga <slouken@libsdl.org>
+
+  This software is provided 'as-is', without any express or implied
+  warranty.  In no event will the authors be held liable for any damages
+  arising from the use of this software.
+
+  Permission is granted to anyone to use this software for any purpose,
+  including commercial applications, and to alter it and redistribute it
+  freely, subject to the following restrictions:
+
+  1. The origin of this software must not be misrepresented; you must not
+     claim that you wrote the original software. If you use this software
+     in a product, an acknowledgment in the product documentation would be
+     appreciated but is not required.
+  2. Altered source versions must be plainly marked as such, and must not be
+     misrepresented as being the original software.
+  3. This notice may not be removed or altered from any source distribution.
+*/
+
+/* Renders to surfaces only, so it needs no window and the numbers only
+   depend on the CPU.  Each case is run a few times and the fastest run is
+   reported, which keeps the results stable enough to compare builds and
+   ABIs against each other.  A warm run renders from a glyph cache that
+   already holds the string, a cold run flushes the cache before every
+   string.
+
+   With -j every result is printed as a line of JSON instead, for
+   bench/runbench.sh to collect, and the last line is the peak resident
+   set size of the process.
+ */
+
+/* quiet windows compiler warnings */
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+#ifdef __linux__
+#include <sys/resource.h>
+#endif
+
+#include "SDL.h"
+#include "SDL_ttf.h"
+
+#define DEFAULT_PTSIZE  18
+#define BENCH_RUNS      3
+#define WRAP_WIDTH      240
+
+enum {
+    MODE_SOLID,
+    MODE_SHADED,
+    MODE_BLENDED,
+    MODE_WRAPPED,
+    NUM_MODES
+};
+
+static const char *mode_names[NUM_MODES] = {
+    "solid", "shaded", "blended", "wrapped"
+};
+
+static const struct {
+    const char *name;
+    const char *text;
+} strings[] = {
+    { "latin short", "Lives: 3" },
+    { "latin", "The quick brown fox jumped over the lazy dog" },
+    { "latin long", "The quick brown fox jumped over the lazy dog.  "
+                    "Pack my box with five dozen liquor jugs.  "
+                    "How vexingly quick daft zebras jump!  "
+                    "AVAWAY To. Wo. Ty. 0123456789 ~!@#$%^&*()" },
+    { "accented", "\xC3\x80 la fa\xC3\xA7on d'un na\xC3\xAF" "f, \xC3\xA9t\xC3\xA9 \xC3\xA0 Z\xC3\xBCrich" },
+    { "cyrillic", "\xD0\x9F\xD1\x80\xD0\xB8\xD0\xB2\xD0\xB5\xD1\x82, \xD0\xBC\xD0\xB8\xD1\x80! "
+                  "\xD0\xA1\xD1\x87\xD1\x91\xD1\x82: 12345" },
+    { "greek", "\xCE\x9A\xCE\xB1\xCE\xBB\xCE\xB7\xCE\xBC\xCE\xAD\xCF\x81\xCE\xB1 "
+               "\xCE\xBA\xCF\x8C\xCF\x83\xCE\xBC\xCE\xB5" },
+    { "cjk", "\xE4\xBD\xA0\xE5\xA5\xBD\xEF\xBC\x8C\xE4\xB8\x96\xE7\x95\x8C"
+             "\xE3\x81\x93\xE3\x82\x93\xE3\x81\xAB\xE3\x81\xA1\xE3\x81\xAF" }
+};
+
+static int bench_iterations = 200;
+static int bench_json = 0;
+
+static void Usage(char *argv0)
+{
+    SDL_Log("Usage: %s [-j] [-p ptsize] [-n iterations] <font>.ttf\n", argv0);
+}
+
+static void print_json_string(const char *text)
+{
+    putchar('"');
+    for (; *text; ++text) {
+        if (*text == '"' || *text == '\\') {
+            printf("\\%c", *text);
+        } else if ((unsigned char)*text < 0x20) {
+            printf("\\u%04x", (unsigned char)*text);
+        } else {
+            putchar(*text);
+        }
+    }
+    putchar('"');
+}
+
+/* In kilobytes, -1 where it can't be told */
+static long peak_rss_kb(void)
+{
+#ifdef __linux__
+    struct rusage usage;
+
+    if (getrusage(RUSAGE_SELF, &usage) == 0) {
+        return usage.ru_maxrss;
+    }
+#endif
+    return -1;
+}
+
+static SDL_Surface *render(TTF_Font *font, int mode, const char *text)
+{
+    SDL_Color fg = { 0xFF, 0xFF, 0xFF, 0xFF };
+    SDL_Color bg = { 0x00, 0x00, 0x00, 0xFF };
+
+    switch (mode) {
+        case MODE_SOLID:    return TTF_RenderUTF8_Solid(font, text, fg);
+        case MODE_SHADED:   return TTF_RenderUTF8_Shaded(font, text, fg, bg);
+        case MODE_BLENDED:  return TTF_RenderUTF8_Blended(font, text, fg);
+        default:            return TTF_RenderUTF8_Blended_Wrapped(font, text, fg, WRAP_WIDTH);
+    }
+}
+
+/* Setting the hinting flushes the glyph cache */
+static void flush_glyphs(TTF_Font *font)
+{
+    TTF_SetFontHinting(font, TTF_GetFontHinting(font));
+}
+
+/* Render the text bench_iterations times and report the best of BENCH_RUNS */
+static void run_bench(TTF_Font *font, int mode, int s, int cold)
+{
+    const char *text = strings[s].text;
+    TTF_TextRun *run;
+    Uint64 start, best = 0;
+    double seconds, sps;
+    char name[64];
+    int glyphs = 0;
+    int i, r;
+
+    run = TTF_LayoutUTF8(font, text);
+    if (run == NULL) {
+        SDL_Log("Couldn't lay out \"%s\": %s\n", strings[s].name, TTF_GetError());
+        return;
+    }
+    TTF_TextRunGlyphs(run, &glyphs);
+    TTF_FreeTextRun(run);
+
+    for (r = 0; r < BENCH_RUNS; ++r) {
+        Uint64 total = 0;
+
+        SDL_FreeSurface(render(font, mode, text));
+        for (i = 0; i < bench_iterations; ++i) {
+            SDL_Surface *surface;
+
+            if (cold) {
+                flush_glyphs(font);
+            }
+            start = SDL_GetPerformanceCounter();
+            surface = render(font, mode, text);
+            total += SDL_GetPerformanceCounter() - start;
+            if (surface == NULL) {
+                SDL_Log("Couldn't render \"%s\": %s\n", strings[s].name, TTF_GetError());
+                return;
+            }
+            SDL_FreeSurface(surface);
+        }
+        if (r == 0 || total < best) {
+            best = total;
+        }
+    }
+
+    seconds = (double)best / SDL_GetPerformanceFrequency();
+    sps = (seconds > 0.0) ? bench_iterations / seconds : 0.0;
+    SDL_snprintf(name, sizeof(name), "%s %s %s%s", mode_names[mode], strings[s].name,
+                 cold ? "cold" : "warm", TTF_GetFontKerning(font) ? "" : " nokern");
+    if (bench_json) {
+        printf("{\"case\":");
+        print_json_string(name);
+        printf(",\"strings_per_s\":%.0f,\"glyphs_per_s\":%.0f}\n", sps, sps * glyphs);
+    } else {
+        printf("%-36s %12.0f strings/s %14.0f glyphs/s\n", name, sps, sps * glyphs);
+    }
+}
+
+int main(int argc, char *argv[])
+{
+    TTF_Font *font;
+    int ptsize = DEFAULT_PTSIZE;
+    Uint64 start, best = 0;
+    double load_ms;
+    long rss;
+    int i, mode, s, cold, kerning;
+
+    for (i=1; argv[i] && (*argv[i] == '-'); ++i) {
+        if (strcmp(argv[i], "-j") == 0) {
+            bench_json = 1;
+        } else
+        if ((strcmp(argv[i], "-p") == 0) && argv[i+1]) {
+            ++i;
+            ptsize = atoi(argv[i]);
+        } else
+        if ((strcmp(argv[i], "-n") == 0) && argv[i+1]) {
+            ++i;
+            bench_iterations = atoi(argv[i]);
+        } else {
+            Usage(argv[0]);
+            return(1);
+        }
+    }
+    if (! argv[i] || ptsize <= 0 || bench_iterations <= 0) {
+        Usage(argv[0]);
+        return(1);
+    }
+
+#ifdef SDL_MAIN_HANDLED
+    /* Built as a command line program, nothing ran SDL_main() */
+    SDL_SetMainReady();
+#endif
+    if (SDL_Init(0) < 0) {
+        SDL_Log("Couldn't initialize SDL: %s\n",SDL_GetError());
+        return(255);
+    }
+    if (TTF_Init() < 0) {
+        SDL_Log("Couldn't initialize TTF: %s\n",SDL_GetError());
+        SDL_Quit();
+        return(255);
+    }
+    /* The font that's kept is the one from the last, fastest to be timed
+       open, so the file is in the page cache for all but the first */
+    font = NULL;
+    for (s = 0; s < BENCH_RUNS; ++s) {
+        if (font != NULL) {
+            TTF_CloseFont(font);
+        }
+        start = SDL_GetPerformanceCounter();
+        font = TTF_OpenFont(argv[i], ptsize);
+        start = SDL_GetPerformanceCounter() - start;
+        if (font == NULL) {
+            SDL_Log("Couldn't load %d pt font from %s: %s\n", ptsize, argv[i], SDL_GetError());
+            TTF_Quit();
+            SDL_Quit();
+            return(2);
+        }
+        if (s == 0 || start < best) {
+            best = start;
+        }
+    }
+    load_ms = (double)best * 1000.0 / SDL_GetPerformanceFrequency();
+
+    if (bench_json) {
+        printf("{\"case\":\"config\",\"file\":");
+        print_json_string(argv[i]);
+        printf(",\"ptsize\":%d,\"iterations\":%d,\"runs\":%d,\"simd\":\"%s\"}\n",
+               ptsize, bench_iterations, BENCH_RUNS,
+               SDL_HasNEON() ? "neon" : SDL_HasSSE2() ? "sse2" : "scalar");
+        printf("{\"case\":\"open font\",\"load_ms\":%.3f}\n", load_ms);
+    } else {
+        printf("%s, %d pt, %d strings per case, best of %d, %s\n", argv[i], ptsize,
+               bench_iterations, BENCH_RUNS, SDL_HasNEON() ? "NEON" : SDL_HasSSE2() ? "SSE2" : "scalar");
+        printf("%-36s %12.3f ms\n", "open font", load_ms);
+    }
+
+    for (kerning = 1; kerning >= 0; --kerning) {
+        TTF_SetFontKerning(font, kerning);
+        for (mode = 0; mode < NUM_MODES; ++mode) {
+            for (s = 0; s < (int)SDL_arraysize(strings); ++s) {
+                for (cold = 0; cold < 2; ++cold) {
+                    run_bench(font, mode, s, cold);
+                }
+            }
+        }
+    }
+
+    rss = peak_rss_kb();
+    if (bench_json) {
+        printf("{\"case\":\"process\",\"peak_rss_kb\":%ld}\n", rss);
+    } else if (rss >= 0) {
+        printf("%-36s %12ld kB\n", "peak rss", rss);
+    }
+
+    TTF_CloseFont(font);
+    TTF_Quit();
+    SDL_Quit();
+    return(0);
+}
+
+/* vi: set ts=4 sw=4 expandtab: */
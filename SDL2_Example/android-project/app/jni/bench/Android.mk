@@ -0,0 +1,37 @@
+LOCAL_PATH := $(call my-dir)
+
+# mixbench and ttfbench as command line programs for adb shell, which
+# runbench.sh builds per ABI.  They're left out of the app unless asked
+# for, like:
+#
+#   ndk-build BUILD_BENCH=true APP_MODULES="mixbench ttfbench"
+BUILD_BENCH ?= false
+ifeq ($(BUILD_BENCH),true)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := mixbench
+
+LOCAL_SRC_FILES := ../SDL2_mixer/mixbench.c
+
+LOCAL_CFLAGS := -DSDL_MAIN_HANDLED -fPIE
+LOCAL_LDFLAGS := -fPIE -pie
+
+LOCAL_SHARED_LIBRARIES := SDL2 SDL2_mixer
+
+include $(BUILD_EXECUTABLE)
+
+include $(CLEAR_VARS)
+
+LOCAL_MODULE := ttfbench
+
+LOCAL_SRC_FILES := ../SDL2_ttf/ttfbench.c
+
+LOCAL_CFLAGS := -DSDL_MAIN_HANDLED -fPIE
+LOCAL_LDFLAGS := -fPIE -pie
+
+LOCAL_SHARED_LIBRARIES := SDL2 SDL2_ttf
+
+include $(BUILD_EXECUTABLE)
+
+endif
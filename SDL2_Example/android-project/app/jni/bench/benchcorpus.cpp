@@ -0,0 +1,342 @@
+//
+// benchcorpus: writes the inputs runbench.sh gives mixbench, the same
+// bytes on every run so results from different days and devices can be
+// compared.  It needs nothing but a C++14 compiler on the host:
+//
+//   benchcorpus corpus [seconds]
+//
+// The PCM files hold a chord with a little noise under it, which is about
+// as hard on an encoder as music, so runbench.sh also encodes the 16 bit
+// WAV to Ogg, MP3 and FLAC when it finds oggenc, lame and flac.  The MIDI
+// and MOD files play a short tune over and over for about as long.
+//
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+using Bytes = std::vector<std::uint8_t>;
+
+static constexpr int defaultSeconds{ 20 };
+
+static void putLE16( Bytes& out, std::uint32_t value )
+{
+    out.emplace_back( (std::uint8_t)value );
+    out.emplace_back( (std::uint8_t)(value >> 8) );
+}
+
+static void putLE32( Bytes& out, std::uint32_t value )
+{
+    putLE16( out, value & 0xFFFF );
+    putLE16( out, value >> 16 );
+}
+
+static void putBE16( Bytes& out, std::uint32_t value )
+{
+    out.emplace_back( (std::uint8_t)(value >> 8) );
+    out.emplace_back( (std::uint8_t)value );
+}
+
+static void putBE32( Bytes& out, std::uint32_t value )
+{
+    putBE16( out, value >> 16 );
+    putBE16( out, value & 0xFFFF );
+}
+
+static void putTag( Bytes& out, const char *tag )
+{
+    out.insert( out.end(), tag, tag + 4 );
+}
+
+// A MIDI variable length quantity
+static void putVarLen( Bytes& out, std::uint32_t value )
+{
+    std::uint8_t bytes[5];
+    int count{ 0 };
+    do
+    {
+        bytes[count++] = value & 0x7F;
+        value >>= 7;
+    } while (value != 0);
+    while (count > 1)
+        out.emplace_back( bytes[--count] | 0x80 );
+    out.emplace_back( bytes[0] );
+}
+
+// Frame i of channel c, in -1 to 1: A minor over a slow tremolo, the
+// channels a fifth apart, with noise from a fixed seed
+static float sample( long i, int c, int rate, std::uint32_t& seed )
+{
+    static constexpr double twoPi{ 6.283185307179586 };
+    static constexpr double notes[]{ 220.0, 261.63, 329.63 };
+    double t{ (double)i / rate };
+    double value{ 0.0 };
+    for (auto note : notes)
+        value += std::sin( twoPi * note * (c ? 1.5 : 1.0) * t );
+    value *= 0.25 * (0.75 + 0.25 * std::sin( twoPi * 0.5 * t ));
+    seed = seed * 1664525u + 1013904223u;
+    value += ((int)(seed >> 16) - 32768) / 32768.0 * 0.02;
+    return (float)value;
+}
+
+// Interleaved 16 bit samples, little endian for WAV or big for AIFF
+static Bytes pcm16( int rate, int channels, int seconds, bool bigEndian )
+{
+    Bytes out;
+    std::uint32_t seed{ 1 };
+    for (long i{ 0 }; i < (long)rate * seconds; ++i)
+    {
+        for (int c{ 0 }; c < channels; ++c)
+        {
+            std::uint32_t value{ (std::uint16_t)(std::int16_t)std::lround( sample( i, c, rate, seed ) * 32767.f ) };
+            if (bigEndian)
+                putBE16( out, value );
+            else
+                putLE16( out, value );
+        }
+    }
+    return out;
+}
+
+// Unsigned 8 bit mono samples, as WAV and VOC store them
+static Bytes pcm8( int rate, int seconds )
+{
+    Bytes out;
+    std::uint32_t seed{ 1 };
+    for (long i{ 0 }; i < (long)rate * seconds; ++i)
+        out.emplace_back( (std::uint8_t)(128 + std::lround( sample( i, 0, rate, seed ) * 127.f )) );
+    return out;
+}
+
+static Bytes wav( int rate, int channels, int bits, const Bytes& data )
+{
+    Bytes out;
+    int frameSize{ channels * bits / 8 };
+    putTag( out, "RIFF" );
+    putLE32( out, (std::uint32_t)(36 + data.size()) );
+    putTag( out, "WAVE" );
+    putTag( out, "fmt " );
+    putLE32( out, 16 );
+    putLE16( out, 1 );
+    putLE16( out, channels );
+    putLE32( out, rate );
+    putLE32( out, rate * frameSize );
+    putLE16( out, frameSize );
+    putLE16( out, bits );
+    putTag( out, "data" );
+    putLE32( out, (std::uint32_t)data.size() );
+    out.insert( out.end(), data.begin(), data.end() );
+    return out;
+}
+
+static Bytes aiff( int rate, int channels, const Bytes& data )
+{
+    Bytes out;
+    std::uint32_t frames{ (std::uint32_t)(data.size() / (2 * channels)) };
+    putTag( out, "FORM" );
+    putBE32( out, (std::uint32_t)(4 + 26 + 16 + data.size()) );
+    putTag( out, "AIFF" );
+    putTag( out, "COMM" );
+    putBE32( out, 18 );
+    putBE16( out, channels );
+    putBE32( out, frames );
+    putBE16( out, 16 );
+
+    // The rate as an 80 bit extended float, which for a whole number is
+    // its bits shifted up to the top of the mantissa
+    int exponent{ 31 };
+    std::uint32_t mantissa{ (std::uint32_t)rate };
+    while (!(mantissa & 0x80000000u))
+    {
+        mantissa <<= 1;
+        --exponent;
+    }
+    putBE16( out, 16383 + exponent );
+    putBE32( out, mantissa );
+    putBE32( out, 0 );
+
+    putTag( out, "SSND" );
+    putBE32( out, (std::uint32_t)(8 + data.size()) );
+    putBE32( out, 0 );
+    putBE32( out, 0 );
+    out.insert( out.end(), data.begin(), data.end() );
+    return out;
+}
+
+// One sound data block and as many continuations as the 24 bit block
+// sizes need
+static Bytes voc( int rate, const Bytes& data )
+{
+    static constexpr std::size_t maxBlock{ 0xFFFFFF - 2 };
+    static const char header[]{ "Creative Voice File\x1A" };
+    Bytes out( header, header + 20 );
+    putLE16( out, 26 );
+    putLE16( out, 0x010A );
+    putLE16( out, 0x1129 );
+
+    std::size_t pos{ 0 };
+    while (pos < data.size())
+    {
+        std::size_t length{ std::min( data.size() - pos, maxBlock ) };
+        if (pos == 0)
+        {
+            out.emplace_back( 1 );
+            putLE16( out, (std::uint32_t)((length + 2) & 0xFFFF) );
+            out.emplace_back( (std::uint8_t)((length + 2) >> 16) );
+            out.emplace_back( (std::uint8_t)(256 - 1000000 / rate) );
+            out.emplace_back( 0 );
+        }
+        else
+        {
+            out.emplace_back( 2 );
+            putLE16( out, (std::uint32_t)(length & 0xFFFF) );
+            out.emplace_back( (std::uint8_t)(length >> 16) );
+        }
+        out.insert( out.end(), data.begin() + pos, data.begin() + pos + length );
+        pos += length;
+    }
+    out.emplace_back( 0 );
+    return out;
+}
+
+// A type 0 file at 120 bpm: a melody on piano over a bass line and a
+// drum beat, one bar of four beats repeated for 'seconds'
+static Bytes midi( int seconds )
+{
+    static constexpr int division{ 96 };
+    static constexpr int melody[]{ 69, 72, 76, 72, 74, 77, 81, 77 };
+    static constexpr int bass[]{ 45, 45, 50, 52 };
+    Bytes track;
+
+    putVarLen( track, 0 );
+    track.insert( track.end(), { 0xFF, 0x51, 0x03, 0x07, 0xA1, 0x20 } );
+    putVarLen( track, 0 );
+    track.insert( track.end(), { 0xC0, 0 } );
+    putVarLen( track, 0 );
+    track.insert( track.end(), { 0xC1, 33 } );
+
+    int beats{ seconds * 2 };
+    for (int beat{ 0 }; beat < beats; ++beat)
+    {
+        int note{ melody[(beat * 2) % 8] }, next{ melody[(beat * 2 + 1) % 8] };
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x90, (std::uint8_t)note, 96 } );
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x91, (std::uint8_t)bass[beat % 4], 100 } );
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x99, (std::uint8_t)(beat % 2 ? 38 : 36), 110 } );
+        putVarLen( track, division / 2 );
+        track.insert( track.end(), { 0x80, (std::uint8_t)note, 0 } );
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x90, (std::uint8_t)next, 96 } );
+        putVarLen( track, division / 2 );
+        track.insert( track.end(), { 0x80, (std::uint8_t)next, 0 } );
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x81, (std::uint8_t)bass[beat % 4], 0 } );
+        putVarLen( track, 0 );
+        track.insert( track.end(), { 0x89, (std::uint8_t)(beat % 2 ? 38 : 36), 0 } );
+    }
+    putVarLen( track, 0 );
+    track.insert( track.end(), { 0xFF, 0x2F, 0x00 } );
+
+    Bytes out;
+    putTag( out, "MThd" );
+    putBE32( out, 6 );
+    putBE16( out, 0 );
+    putBE16( out, 1 );
+    putBE16( out, division );
+    putTag( out, "MTrk" );
+    putBE32( out, (std::uint32_t)track.size() );
+    out.insert( out.end(), track.begin(), track.end() );
+    return out;
+}
+
+// A ProTracker module with one looped sample and one pattern, played
+// for 'seconds' at the default speed 6 and 125 bpm, 7.68 seconds a
+// pattern.  All four channels play, so the mixer does the full work.
+static Bytes mod( int seconds )
+{
+    static constexpr int sampleLength{ 64 };
+    static constexpr int periods[]{ 428, 381, 339, 320, 285, 254, 226, 214 };
+    Bytes out( 20, 0 );
+    const char title[]{ "benchcorpus" };
+    std::copy( title, title + sizeof(title) - 1, out.begin() );
+
+    for (int s{ 0 }; s < 31; ++s)
+    {
+        out.insert( out.end(), 22, 0 );
+        bool used{ s == 0 };
+        putBE16( out, used ? sampleLength / 2 : 0 );
+        out.emplace_back( 0 );
+        out.emplace_back( used ? 64 : 0 );
+        putBE16( out, 0 );
+        putBE16( out, used ? sampleLength / 2 : 1 );
+    }
+
+    int orders{ std::max( 1, std::min( 128, (seconds * 100 + 767) / 768 ) ) };
+    out.emplace_back( (std::uint8_t)orders );
+    out.emplace_back( 127 );
+    out.insert( out.end(), 128, 0 );
+    putTag( out, "M.K." );
+
+    for (int row{ 0 }; row < 64; ++row)
+    {
+        for (int channel{ 0 }; channel < 4; ++channel)
+        {
+            if ((row + channel) % 2)
+            {
+                out.insert( out.end(), 4, 0 );
+                continue;
+            }
+            int period{ periods[(row / 2 + channel * 2) % 8] >> (channel & 1) };
+            out.emplace_back( (std::uint8_t)(period >> 8) );
+            out.emplace_back( (std::uint8_t)period );
+            out.emplace_back( 0x10 );
+            out.emplace_back( 0 );
+        }
+    }
+
+    // A square wave, signed 8 bit
+    for (int i{ 0 }; i < sampleLength; ++i)
+        out.emplace_back( (std::uint8_t)(i < sampleLength / 2 ? 48 : -48) );
+    return out;
+}
+
+static bool writeFile( const std::string& path, const Bytes& data )
+{
+    FILE *file{ std::fopen( path.c_str(), "wb" ) };
+    if (file == nullptr || std::fwrite( data.data(), 1, data.size(), file ) != data.size())
+    {
+        std::perror( path.c_str() );
+        if (file != nullptr)
+            std::fclose( file );
+        return false;
+    }
+    std::fclose( file );
+    std::printf( "%s, %zu bytes\n", path.c_str(), data.size() );
+    return true;
+}
+
+int main( int argc, char *argv[] )
+{
+    int seconds{ argc == 3 ? std::atoi( argv[2] ) : defaultSeconds };
+    if (argc < 2 || argc > 3 || seconds <= 0)
+    {
+        std::fprintf( stderr, "Usage: %s directory [seconds]\n", argv[0] );
+        return 1;
+    }
+
+    const std::string dir{ argv[1] };
+    Bytes mono8( pcm8( 22050, seconds ) );
+    bool written{ writeFile( dir + "/tone_s16_44k.wav", wav( 44100, 2, 16, pcm16( 44100, 2, seconds, false ) ) ) &&
+                  writeFile( dir + "/tone_u8_22k.wav", wav( 22050, 1, 8, mono8 ) ) &&
+                  writeFile( dir + "/tone.aiff", aiff( 44100, 2, pcm16( 44100, 2, seconds, true ) ) ) &&
+                  writeFile( dir + "/tone.voc", voc( 22050, mono8 ) ) &&
+                  writeFile( dir + "/tune.mid", midi( seconds ) ) &&
+                  writeFile( dir + "/tune.mod", mod( seconds ) ) };
+    return written ? 0 : 1;
+}
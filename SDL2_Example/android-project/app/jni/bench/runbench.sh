@@ -0,0 +1,133 @@
+#!/bin/sh
+#
+# Builds mixbench and ttfbench for each ABI that ../Application.mk lists,
+# runs them over the benchmark corpus on the device adb talks to, and
+# writes what they print to bench-results/<abi>.jsonl, one JSON object a
+# line, each with the ABI and the run it came from added.
+#
+#   ./runbench.sh [seconds]
+#
+# 'seconds' is how long the generated files play, 20 by default.  The
+# mixer runs at 48000 Hz, the rate most devices output at.  These can be
+# set in the environment:
+#
+#   ABIS          the ABIs to run instead of APP_ABI
+#   ADB           adb, with -s <serial> if more than one device is attached
+#   NDK_BUILD     ndk-build, if it isn't on the PATH
+#   CXX           the host compiler that builds benchcorpus
+#   TIMIDITY_DIR  a directory with timidity.cfg and the patches it names,
+#                 for the MIDI case; it's skipped without one
+#   WORK          where the corpus and the builds go, _work by default
+#   RESULTS       where the results go, bench-results by default
+#
+# The corpus is what benchcorpus writes, the Ogg, MP3 and FLAC encodings
+# of its 16 bit WAV where oggenc, lame and flac are installed, and the
+# game's own sounds, music and font.  Each file is decoded by a process of
+# its own, so the peak RSS that ends each run is that of one workload.
+#
+
+set -e
+
+HERE=$(cd "$(dirname "$0")" && pwd)
+JNI=$(dirname "$HERE")
+APP=$(dirname "$JNI")
+ASSETS=$APP/src/main/assets
+
+BENCH_SECONDS=${1:-20}
+ABIS=${ABIS:-$(sed -n 's/^APP_ABI *:*= *//p' "$JNI/Application.mk")}
+ADB=${ADB:-adb}
+NDK_BUILD=${NDK_BUILD:-ndk-build}
+CXX=${CXX:-c++}
+WORK=${WORK:-$HERE/_work}
+RESULTS=${RESULTS:-$HERE/bench-results}
+DEVICE_DIR=/data/local/tmp/sdlbench
+
+mkdir -p "$WORK/corpus" "$RESULTS"
+
+# The corpus
+"$CXX" -std=c++14 -O2 -o "$WORK/benchcorpus" "$HERE/benchcorpus.cpp" -lm
+"$WORK/benchcorpus" "$WORK/corpus" "$BENCH_SECONDS"
+TONE=$WORK/corpus/tone_s16_44k.wav
+if command -v oggenc >/dev/null 2>&1; then
+    oggenc -Q -q 5 -o "$WORK/corpus/tone.ogg" "$TONE"
+fi
+if command -v lame >/dev/null 2>&1; then
+    lame --quiet -b 192 "$TONE" "$WORK/corpus/tone.mp3"
+fi
+if command -v flac >/dev/null 2>&1; then
+    flac -s -f -o "$WORK/corpus/tone.flac" "$TONE"
+fi
+cp "$ASSETS"/*.ogg "$ASSETS"/*.mp3 "$ASSETS"/*.ttf "$WORK/corpus/"
+
+"$ADB" shell "rm -rf $DEVICE_DIR && mkdir -p $DEVICE_DIR/corpus"
+for file in "$WORK/corpus"/*; do
+    "$ADB" push "$file" "$DEVICE_DIR/corpus/" >/dev/null
+done
+if [ -n "$TIMIDITY_DIR" ]; then
+    "$ADB" push "$TIMIDITY_DIR" "$DEVICE_DIR/timidity" >/dev/null
+fi
+
+DEVICE_ABIS=$("$ADB" shell getprop ro.product.cpu.abilist | tr -d '\r')
+if [ -z "$DEVICE_ABIS" ]; then
+    DEVICE_ABIS=$("$ADB" shell getprop ro.product.cpu.abi | tr -d '\r')
+fi
+
+# run <abi> <label> <directory> <command>: runs the command on the device
+# in the directory and appends its JSON lines to the ABI's results
+run() {
+    "$ADB" shell "cd $3 && LD_LIBRARY_PATH=$DEVICE_DIR/$1 $4" | tr -d '\r' |
+        sed -n "s/^{/{\"abi\":\"$1\",\"run\":\"$2\",/p" >>"$RESULTS/$1.jsonl"
+}
+
+for abi in $ABIS; do
+    OUT=$RESULTS/$abi.jsonl
+    : >"$OUT"
+    case ",$DEVICE_ABIS," in
+        *",$abi,"*) ;;
+        *)
+            echo "{\"abi\":\"$abi\",\"case\":\"skipped\",\"error\":\"the device runs $DEVICE_ABIS\"}" >"$OUT"
+            echo "$abi: skipped, the device runs $DEVICE_ABIS"
+            continue
+            ;;
+    esac
+
+    "$NDK_BUILD" -C "$APP" -j"$(getconf _NPROCESSORS_ONLN 2>/dev/null || echo 4)" \
+        NDK_PROJECT_PATH="$APP" \
+        APP_BUILD_SCRIPT="$JNI/Android.mk" \
+        NDK_APPLICATION_MK="$JNI/Application.mk" \
+        NDK_OUT="$WORK/obj" \
+        NDK_LIBS_OUT="$WORK/libs" \
+        APP_ABI="$abi" \
+        APP_MODULES="mixbench ttfbench" \
+        BUILD_BENCH=true
+
+    BIN=$DEVICE_DIR/$abi
+    "$ADB" shell "mkdir -p $BIN"
+    for file in "$WORK/libs/$abi"/*; do
+        "$ADB" push "$file" "$BIN/" >/dev/null
+    done
+    "$ADB" shell "chmod 755 $BIN/mixbench $BIN/ttfbench"
+
+    for file in "$WORK/corpus"/*; do
+        name=$(basename "$file")
+        case "$name" in
+            *.ttf)
+                run "$abi" "$name" "$BIN" "./ttfbench -j $DEVICE_DIR/corpus/$name"
+                ;;
+            *.mid)
+                if [ -n "$TIMIDITY_DIR" ]; then
+                    run "$abi" "$name" "$DEVICE_DIR/timidity" \
+                        "TIMIDITY_CFG=timidity.cfg $BIN/mixbench -j -r 48000 -d $DEVICE_DIR/corpus/$name"
+                else
+                    echo "{\"abi\":\"$abi\",\"run\":\"$name\",\"case\":\"skipped\",\"error\":\"TIMIDITY_DIR isn't set\"}" >>"$OUT"
+                fi
+                ;;
+            *)
+                run "$abi" "$name" "$BIN" "./mixbench -j -r 48000 -d $DEVICE_DIR/corpus/$name"
+                ;;
+        esac
+    done
+    run "$abi" "mix" "$BIN" "./mixbench -j -r 48000 $DEVICE_DIR/corpus/tone_s16_44k.wav"
+
+    echo "$abi: $(wc -l <"$OUT") results in $OUT"
+done
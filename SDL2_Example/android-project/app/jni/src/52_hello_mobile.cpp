@@ -6,6 +6,22 @@ and may not be redistributed without written permission.*/
 #include <stdio.h>
 #include <string>
 #include <string.h>
+#include <vector>
+#include <algorithm>
+#include "framepacer.h"
+
+//The NEON pixel kernels are built on ARM when the compiler allows it, the SSE2
+//ones on x86, and either is only used if the CPU reports support for it
+#if SDL_BYTEORDER == SDL_LIL_ENDIAN
+#if defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( __aarch64__ )
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#endif
+#endif
 
 //Texture wrapper class
 class LTexture
@@ -17,8 +33,8 @@ class LTexture
 		//Deallocates memory
 		~LTexture();
 
-		//Loads image at specified path
-		bool loadFromFile( std::string path );
+		//Loads image at specified path, pass SDL_TEXTUREACCESS_STREAMING to lock it later
+		bool loadFromFile( std::string path, SDL_TextureAccess access = SDL_TEXTUREACCESS_STATIC );
 
 		#ifdef _SDL_TTF_H
 		//Creates image from font string
@@ -28,6 +44,12 @@ class LTexture
 		//Creates blank texture
 		bool createBlank( int width, int height, SDL_TextureAccess = SDL_TEXTUREACCESS_STREAMING );
 
+		//Creates blank texture updated through a copy in memory, see lockTexture()
+		bool createDoubleBuffered( int width, int height );
+
+		//Makes this a view of a region of a texture it doesn't own, like an atlas
+		void setView( SDL_Texture* texture, SDL_Rect region );
+
 		//Deallocates texture
 		void free();
 
@@ -40,7 +62,7 @@ class LTexture
 		//Set alpha modulation
 		void setAlpha( Uint8 alpha );
 
-		//Renders texture at given point
+		//Renders texture at given point, the clip is relative to a view's region
 		void render( int x, int y, SDL_Rect* clip = NULL, double angle = 0.0, SDL_Point* center = NULL, SDL_RendererFlip flip = SDL_FLIP_NONE );
 
 		//Set self as render target
@@ -50,13 +72,18 @@ class LTexture
 		int getWidth();
 		int getHeight();
 
-		//Pixel manipulators
-		bool lockTexture();
+		//Pixel manipulators, locking only the rect that changes (all of it if NULL).
+		//A double buffered texture hands out its copy in memory and uploads the
+		//rect on unlock to the texture not being drawn, so it never waits for the GPU
+		bool lockTexture( const SDL_Rect* rect = NULL );
 		bool unlockTexture();
 		void* getPixels();
-		void copyPixels( void* pixels );
+		//Copies rows of the locked width, pitch bytes apart in the source (packed if 0)
+		void copyPixels( void* pixels, int pitch = 0 );
 		int getPitch();
 		Uint32 getPixel32( unsigned int x, unsigned int y );
+		//Replaces every pixel of one color in the locked rect by another
+		void replaceColor( Uint32 color, Uint32 replacement );
 
 	private:
 		//The actual hardware texture
@@ -67,8 +94,74 @@ class LTexture
 		//Image dimensions
 		int mWidth;
 		int mHeight;
+
+		//The part of the texture that is this image, and whether it's ours to free
+		SDL_Rect mRegion;
+		bool mOwnsTexture;
+
+		//The locked part of the image
+		SDL_Rect mLockRect;
+
+		//Double buffering: the texture not being drawn, the pixels in memory and
+		//the part of the back texture that is behind them
+		SDL_Texture* mBackTexture;
+		std::vector<Uint32> mShadow;
+		SDL_Rect mBackDirty;
 };
 
+//Packs images into one texture so drawing any of them never switches textures
+class LTextureAtlas
+{
+	public:
+		//Initializes variables
+		LTextureAtlas();
+
+		//Deallocates memory
+		~LTextureAtlas();
+
+		//Queues an image to be packed, returns its index
+		int addFile( std::string path );
+
+		//Packs the queued images into the smallest square texture up to maxSize that fits them,
+		//streaming access lets the views be locked
+		bool pack( int maxSize = 2048, SDL_TextureAccess access = SDL_TEXTUREACCESS_STATIC );
+
+		//Points a texture at a packed image, it stays valid until the atlas is freed
+		bool getTexture( int index, LTexture& view );
+
+		//Deallocates the atlas
+		void free();
+
+	private:
+		//Gutter around each image, filled with its edge pixels so linear
+		//filtering never blends in a neighbour
+		static const int PADDING = 1;
+
+		//Lays the images out in shelves, tallest first
+		bool layout( int size );
+
+		//The packed texture
+		SDL_Texture* mTexture;
+
+		//Images waiting to be packed, and where they ended up
+		std::vector<std::string> mPaths;
+		std::vector<SDL_Surface*> mSurfaces;
+		std::vector<SDL_Rect> mRegions;
+};
+
+//Picks the pixel kernels this CPU runs best
+void initPixelKernels();
+
+//Replaces every 32 bit pixel equal to color by replacement
+void replacePixels( Uint32* pixels, int count, Uint32 color, Uint32 replacement );
+
+//Expands 24 bit pixels, red first in memory if not bgr, to opaque RGBA8888
+void convert24ToRGBA8888( const Uint8* src, Uint32* dst, int count, bool bgr );
+
+//Loads a bitmap in RGBA8888 with cyan keyed out to transparent, from the
+//converted copy an earlier run left in the texture cache if there is one
+SDL_Surface* loadKeyedSurface( std::string path );
+
 //Starts up SDL and creates window
 bool init();
 
@@ -87,7 +180,16 @@ SDL_Renderer* gRenderer = NULL;
 //Screen dimensions
 SDL_Rect gScreenRect = { 0, 0, 320, 240 };
 
+//Where converted images are kept between runs, empty to convert them every time
+std::string gTextureCacheDir;
+
+//A converted image starts with these, its width and height and the size of the
+//bitmap it came from, followed by the keyed RGBA8888 pixels in packed rows
+const Uint32 TEXTURE_CACHE_MAGIC = 0x5845544C;	//"LTEX"
+const Uint32 TEXTURE_CACHE_VERSION = 1;
+
 //Scene textures
+LTextureAtlas gAtlas;
 LTexture gSplashTexture;
 
 LTexture::LTexture()
@@ -98,6 +200,11 @@ LTexture::LTexture()
 	mHeight = 0;
 	mPixels = NULL;
 	mPitch = 0;
+	mRegion = { 0, 0, 0, 0 };
+	mOwnsTexture = true;
+	mLockRect = { 0, 0, 0, 0 };
+	mBackTexture = NULL;
+	mBackDirty = { 0, 0, 0, 0 };
 }
 
 LTexture::~LTexture()
@@ -106,81 +213,313 @@ LTexture::~LTexture()
 	free();
 }
 
-bool LTexture::loadFromFile( std::string path )
+//Whether the SIMD kernels can be used on this CPU
+bool gPixelsHaveNEON = false;
+bool gPixelsHaveSSE2 = false;
+
+void initPixelKernels()
 {
-	//Get rid of preexisting texture
-	free();
+#ifdef HAVE_NEON_INTRINSICS
+	gPixelsHaveNEON = SDL_HasNEON();
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+	gPixelsHaveSSE2 = SDL_HasSSE2();
+#endif
+}
 
-	//The final texture.bmp
-	SDL_Texture* newTexture = NULL;
+void replacePixels( Uint32* pixels, int count, Uint32 color, Uint32 replacement )
+{
+	int i = 0;
 
-	//Load image at specified path
-	SDL_Surface* loadedSurface = SDL_LoadBMP( path.c_str() );
-	if( loadedSurface == NULL )
+	//Four pixels at a time, blending in the replacement where they match
+#ifdef HAVE_NEON_INTRINSICS
+	if( gPixelsHaveNEON )
 	{
-		SDL_Log( "Unable to load image %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		uint32x4_t key = vdupq_n_u32( color );
+		uint32x4_t with = vdupq_n_u32( replacement );
+		for( ; i + 4 <= count; i += 4 )
+		{
+			uint32x4_t p = vld1q_u32( pixels + i );
+			vst1q_u32( pixels + i, vbslq_u32( vceqq_u32( p, key ), with, p ) );
+		}
 	}
-	else
+#endif
+#ifdef HAVE_SSE2_INTRINSICS
+	if( gPixelsHaveSSE2 )
 	{
-		//Convert surface to display format
-		SDL_Surface* formattedSurface = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, NULL );
-		if( formattedSurface == NULL )
+		__m128i key = _mm_set1_epi32( (int)color );
+		__m128i with = _mm_set1_epi32( (int)replacement );
+		for( ; i + 4 <= count; i += 4 )
 		{
-			SDL_Log( "Unable to convert loaded surface to display format! %s\n", SDL_GetError() );
+			__m128i p = _mm_loadu_si128( (const __m128i*)( pixels + i ) );
+			__m128i match = _mm_cmpeq_epi32( p, key );
+			_mm_storeu_si128( (__m128i*)( pixels + i ), _mm_or_si128( _mm_and_si128( match, with ), _mm_andnot_si128( match, p ) ) );
 		}
-		else
+	}
+#endif
+
+	//Whatever the kernels left over
+	for( ; i < count; ++i )
+	{
+		if( pixels[ i ] == color )
+		{
+			pixels[ i ] = replacement;
+		}
+	}
+}
+
+void convert24ToRGBA8888( const Uint8* src, Uint32* dst, int count, bool bgr )
+{
+	int i = 0;
+
+	//Sixteen pixels at a time, stored as bytes alpha, blue, green, red
+#ifdef HAVE_NEON_INTRINSICS
+	if( gPixelsHaveNEON )
+	{
+		uint8x16_t alpha = vdupq_n_u8( 0xFF );
+		for( ; i + 16 <= count; i += 16 )
+		{
+			uint8x16x3_t in = vld3q_u8( src + i * 3 );
+			uint8x16x4_t out;
+			out.val[ 0 ] = alpha;
+			out.val[ 1 ] = bgr ? in.val[ 0 ] : in.val[ 2 ];
+			out.val[ 2 ] = in.val[ 1 ];
+			out.val[ 3 ] = bgr ? in.val[ 2 ] : in.val[ 0 ];
+			vst4q_u8( (Uint8*)( dst + i ), out );
+		}
+	}
+#endif
+	//Four pixels at a time, each read as 32 bits with a byte of the next one on
+	//top, so the last group stops short of the end of the row
+#ifdef HAVE_SSE2_INTRINSICS
+	if( gPixelsHaveSSE2 )
+	{
+		__m128i alpha = _mm_set1_epi32( 0xFF );
+		__m128i low = _mm_set1_epi32( 0xFF ), middle = _mm_set1_epi32( 0xFF00 ), high = _mm_set1_epi32( 0xFF0000 );
+		for( ; i + 5 <= count; i += 4 )
 		{
-			//Create blank streamable texture
-			newTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, formattedSurface->w, formattedSurface->h );
-			if( newTexture == NULL )
+			Uint32 in[ 4 ];
+			for( int j = 0; j < 4; ++j )
+			{
+				memcpy( &in[ j ], src + ( i + j ) * 3, 4 );
+			}
+			__m128i p = _mm_loadu_si128( (const __m128i*)in );
+			__m128i rgba;
+			if( bgr )
 			{
-				SDL_Log( "Unable to create blank texture! SDL Error: %s\n", SDL_GetError() );
+				rgba = _mm_slli_epi32( p, 8 );
 			}
 			else
 			{
-				//Enable blending on texture
-				SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
+				rgba = _mm_or_si128( _mm_or_si128( _mm_slli_epi32( _mm_and_si128( p, low ), 24 ),
+					_mm_slli_epi32( _mm_and_si128( p, middle ), 8 ) ),
+					_mm_srli_epi32( _mm_and_si128( p, high ), 8 ) );
+			}
+			_mm_storeu_si128( (__m128i*)( dst + i ), _mm_or_si128( rgba, alpha ) );
+		}
+	}
+#endif
 
-				//Lock texture for manipulation
-				SDL_LockTexture( newTexture, &formattedSurface->clip_rect, &mPixels, &mPitch );
+	//Whatever the kernels left over
+	int r = bgr ? 2 : 0, b = bgr ? 0 : 2;
+	for( ; i < count; ++i )
+	{
+		const Uint8* pixel = src + i * 3;
+		dst[ i ] = ( (Uint32)pixel[ r ] << 24 ) | ( (Uint32)pixel[ 1 ] << 16 ) | ( (Uint32)pixel[ b ] << 8 ) | 0xFF;
+	}
+}
 
-				//Copy loaded/formatted surface pixels
-				memcpy( mPixels, formattedSurface->pixels, formattedSurface->pitch * formattedSurface->h );
+std::string textureCachePath( std::string path )
+{
+	//Flatten the asset path into one file name
+	for( char& c : path )
+	{
+		if( c == '/' || c == '\\' )
+		{
+			c = '_';
+		}
+	}
 
-				//Get image dimensions
-				mWidth = formattedSurface->w;
-				mHeight = formattedSurface->h;
+	return gTextureCacheDir + path + ".ltex";
+}
+
+SDL_Surface* loadCachedSurface( std::string path, Sint64 sourceSize )
+{
+	if( gTextureCacheDir.empty() )
+	{
+		return NULL;
+	}
+
+	SDL_RWops* file = SDL_RWFromFile( textureCachePath( path ).c_str(), "rb" );
+	if( file == NULL )
+	{
+		return NULL;
+	}
+
+	//A copy of another version of the bitmap doesn't count
+	SDL_Surface* surface = NULL;
+	Uint32 magic = SDL_ReadLE32( file );
+	Uint32 version = SDL_ReadLE32( file );
+	int width = (int)SDL_ReadLE32( file );
+	int height = (int)SDL_ReadLE32( file );
+	Uint32 size = SDL_ReadLE32( file );
+	if( magic == TEXTURE_CACHE_MAGIC && version == TEXTURE_CACHE_VERSION && size == (Uint32)sourceSize &&
+		width > 0 && width <= 16384 && height > 0 && height <= 16384 )
+	{
+		surface = SDL_CreateRGBSurfaceWithFormat( 0, width, height, 32, SDL_PIXELFORMAT_RGBA8888 );
+		if( surface != NULL &&
+			( surface->pitch != width * 4 || SDL_RWread( file, surface->pixels, width * 4, height ) != (size_t)height ) )
+		{
+			SDL_FreeSurface( surface );
+			surface = NULL;
+		}
+	}
+
+	SDL_RWclose( file );
+	return surface;
+}
+
+void saveCachedSurface( std::string path, Sint64 sourceSize, SDL_Surface* surface )
+{
+	if( gTextureCacheDir.empty() )
+	{
+		return;
+	}
+
+	SDL_RWops* file = SDL_RWFromFile( textureCachePath( path ).c_str(), "wb" );
+	if( file == NULL )
+	{
+		SDL_Log( "Unable to write texture cache for %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		return;
+	}
+
+	//A short write leaves a file the next load turns down
+	SDL_WriteLE32( file, TEXTURE_CACHE_MAGIC );
+	SDL_WriteLE32( file, TEXTURE_CACHE_VERSION );
+	SDL_WriteLE32( file, surface->w );
+	SDL_WriteLE32( file, surface->h );
+	SDL_WriteLE32( file, (Uint32)sourceSize );
+	for( int y = 0; y < surface->h; ++y )
+	{
+		SDL_RWwrite( file, (Uint8*)surface->pixels + y * surface->pitch, surface->w * 4, 1 );
+	}
 
-				//Get pixel data in editable format
-				Uint32* pixels = (Uint32*)mPixels;
-				int pixelCount = ( mPitch / 4 ) * mHeight;
+	SDL_RWclose( file );
+}
+
+SDL_Surface* loadKeyedSurface( std::string path )
+{
+	//The converted surface
+	SDL_Surface* formattedSurface = NULL;
+
+	//Open image at specified path
+	SDL_RWops* source = SDL_RWFromFile( path.c_str(), "rb" );
+	if( source == NULL )
+	{
+		SDL_Log( "Unable to load image %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+		return NULL;
+	}
 
-				//Map colors
-				Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
-				Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
+	//A copy converted by an earlier run skips the decode, conversion and keying
+	Sint64 sourceSize = SDL_RWsize( source );
+	formattedSurface = loadCachedSurface( path, sourceSize );
+	if( formattedSurface != NULL )
+	{
+		SDL_RWclose( source );
+		return formattedSurface;
+	}
 
-				//Color key pixels
-				for( int i = 0; i < pixelCount; ++i )
+	//Load image
+	SDL_Surface* loadedSurface = SDL_LoadBMP_RW( source, 1 );
+	if( loadedSurface == NULL )
+	{
+		SDL_Log( "Unable to load image %s! SDL Error: %s\n", path.c_str(), SDL_GetError() );
+	}
+	else
+	{
+		//Convert surface to display format, 24 bit bitmaps with the kernels
+		Uint32 sourceFormat = loadedSurface->format->format;
+		if( sourceFormat == SDL_PIXELFORMAT_RGB24 || sourceFormat == SDL_PIXELFORMAT_BGR24 )
+		{
+			formattedSurface = SDL_CreateRGBSurfaceWithFormat( 0, loadedSurface->w, loadedSurface->h, 32, SDL_PIXELFORMAT_RGBA8888 );
+			if( formattedSurface != NULL )
+			{
+				for( int y = 0; y < loadedSurface->h; ++y )
 				{
-					if( pixels[ i ] == colorKey )
-					{
-						pixels[ i ] = transparent;
-					}
+					convert24ToRGBA8888( (const Uint8*)loadedSurface->pixels + y * loadedSurface->pitch,
+						(Uint32*)( (Uint8*)formattedSurface->pixels + y * formattedSurface->pitch ),
+						loadedSurface->w, sourceFormat == SDL_PIXELFORMAT_BGR24 );
 				}
+			}
+		}
+		else
+		{
+			formattedSurface = SDL_ConvertSurfaceFormat( loadedSurface, SDL_PIXELFORMAT_RGBA8888, NULL );
+		}
+		if( formattedSurface == NULL )
+		{
+			SDL_Log( "Unable to convert loaded surface to display format! %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Map colors
+			Uint32 colorKey = SDL_MapRGB( formattedSurface->format, 0, 0xFF, 0xFF );
+			Uint32 transparent = SDL_MapRGBA( formattedSurface->format, 0x00, 0xFF, 0xFF, 0x00 );
 
-				//Unlock texture to update
-				SDL_UnlockTexture( newTexture );
-				mPixels = NULL;
+			//Color key pixels
+			for( int y = 0; y < formattedSurface->h; ++y )
+			{
+				replacePixels( (Uint32*)( (Uint8*)formattedSurface->pixels + y * formattedSurface->pitch ),
+					formattedSurface->w, colorKey, transparent );
 			}
 
-			//Get rid of old formatted surface
-			SDL_FreeSurface( formattedSurface );
+			//Keep the result for the next run
+			saveCachedSurface( path, sourceSize, formattedSurface );
 		}
 
 		//Get rid of old loaded surface
 		SDL_FreeSurface( loadedSurface );
 	}
 
+	return formattedSurface;
+}
+
+bool LTexture::loadFromFile( std::string path, SDL_TextureAccess access )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//The final texture.bmp
+	SDL_Texture* newTexture = NULL;
+
+	//Load image with its color key applied
+	SDL_Surface* formattedSurface = loadKeyedSurface( path );
+	if( formattedSurface != NULL )
+	{
+		//Create blank texture, a static one keeps no copy of its pixels in memory
+		newTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, access, formattedSurface->w, formattedSurface->h );
+		if( newTexture == NULL )
+		{
+			SDL_Log( "Unable to create blank texture! SDL Error: %s\n", SDL_GetError() );
+		}
+		else
+		{
+			//Enable blending on texture
+			SDL_SetTextureBlendMode( newTexture, SDL_BLENDMODE_BLEND );
+
+			//Copy loaded/formatted surface pixels
+			SDL_UpdateTexture( newTexture, NULL, formattedSurface->pixels, formattedSurface->pitch );
+
+			//Get image dimensions
+			mWidth = formattedSurface->w;
+			mHeight = formattedSurface->h;
+			mRegion = { 0, 0, mWidth, mHeight };
+		}
+
+		//Get rid of old formatted surface
+		SDL_FreeSurface( formattedSurface );
+	}
+
 	//Return success
 	mTexture = newTexture;
 	return mTexture != NULL;
@@ -207,6 +546,7 @@ bool LTexture::loadFromRenderedText( std::string textureText, SDL_Color textColo
 			//Get image dimensions
 			mWidth = textSurface->w;
 			mHeight = textSurface->h;
+			mRegion = { 0, 0, mWidth, mHeight };
 		}
 
 		//Get rid of old surface
@@ -235,22 +575,73 @@ bool LTexture::createBlank( int width, int height, SDL_TextureAccess access )
 	{
 		mWidth = width;
 		mHeight = height;
+		mRegion = { 0, 0, mWidth, mHeight };
 	}
 
 	return mTexture != NULL;
 }
 
+bool LTexture::createDoubleBuffered( int width, int height )
+{
+	//Get rid of preexisting texture
+	free();
+
+	//Create both textures
+	if( !createBlank( width, height ) )
+	{
+		return false;
+	}
+	mBackTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, SDL_TEXTUREACCESS_STREAMING, width, height );
+	if( mBackTexture == NULL )
+	{
+		SDL_Log( "Unable to create back texture! SDL Error: %s\n", SDL_GetError() );
+		free();
+		return false;
+	}
+
+	//Both start out blank, like the copy in memory
+	mShadow.assign( width * height, 0 );
+	SDL_UpdateTexture( mTexture, NULL, mShadow.data(), width * 4 );
+	SDL_UpdateTexture( mBackTexture, NULL, mShadow.data(), width * 4 );
+	mBackDirty = { 0, 0, 0, 0 };
+
+	return true;
+}
+
+void LTexture::setView( SDL_Texture* texture, SDL_Rect region )
+{
+	//Get rid of preexisting texture
+	free();
+
+	mTexture = texture;
+	mRegion = region;
+	mWidth = region.w;
+	mHeight = region.h;
+	mOwnsTexture = false;
+}
+
 void LTexture::free()
 {
-	//Free texture if it exists
+	//Free texture if it exists, a view leaves it to its owner
 	if( mTexture != NULL )
 	{
-		SDL_DestroyTexture( mTexture );
+		if( mOwnsTexture )
+		{
+			SDL_DestroyTexture( mTexture );
+		}
+		if( mBackTexture != NULL )
+		{
+			SDL_DestroyTexture( mBackTexture );
+			mBackTexture = NULL;
+		}
+		mShadow.clear();
 		mTexture = NULL;
 		mWidth = 0;
 		mHeight = 0;
 		mPixels = NULL;
 		mPitch = 0;
+		mRegion = { 0, 0, 0, 0 };
+		mOwnsTexture = true;
 	}
 }
 
@@ -258,18 +649,30 @@ void LTexture::setColor( Uint8 red, Uint8 green, Uint8 blue )
 {
 	//Modulate texture rgb
 	SDL_SetTextureColorMod( mTexture, red, green, blue );
+	if( mBackTexture != NULL )
+	{
+		SDL_SetTextureColorMod( mBackTexture, red, green, blue );
+	}
 }
 
 void LTexture::setBlendMode( SDL_BlendMode blending )
 {
 	//Set blending function
 	SDL_SetTextureBlendMode( mTexture, blending );
+	if( mBackTexture != NULL )
+	{
+		SDL_SetTextureBlendMode( mBackTexture, blending );
+	}
 }
 
 void LTexture::setAlpha( Uint8 alpha )
 {
 	//Modulate texture alpha
 	SDL_SetTextureAlphaMod( mTexture, alpha );
+	if( mBackTexture != NULL )
+	{
+		SDL_SetTextureAlphaMod( mBackTexture, alpha );
+	}
 }
 
 void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* center, SDL_RendererFlip flip )
@@ -277,15 +680,22 @@ void LTexture::render( int x, int y, SDL_Rect* clip, double angle, SDL_Point* ce
 	//Set rendering space and render to screen
 	SDL_Rect renderQuad = { x, y, mWidth, mHeight };
 
+	//The part of the texture to draw
+	SDL_Rect source = mRegion;
+
 	//Set clip rendering dimensions
 	if( clip != NULL )
 	{
 		renderQuad.w = clip->w;
 		renderQuad.h = clip->h;
+		source.x += clip->x;
+		source.y += clip->y;
+		source.w = clip->w;
+		source.h = clip->h;
 	}
 
 	//Render to screen
-	SDL_RenderCopyEx( gRenderer, mTexture, clip, &renderQuad, angle, center, flip );
+	SDL_RenderCopyEx( gRenderer, mTexture, &source, &renderQuad, angle, center, flip );
 }
 
 void LTexture::setAsRenderTarget()
@@ -304,24 +714,42 @@ int LTexture::getHeight()
 	return mHeight;
 }
 
-bool LTexture::lockTexture()
+bool LTexture::lockTexture( const SDL_Rect* rect )
 {
 	bool success = true;
 
+	//The part of the texture to lock
+	SDL_Rect lockRect = mRegion;
+	if( rect != NULL )
+	{
+		lockRect = { mRegion.x + rect->x, mRegion.y + rect->y, rect->w, rect->h };
+	}
+
 	//Texture is already locked
 	if( mPixels != NULL )
 	{
 		SDL_Log( "Texture is already locked!\n" );
 		success = false;
 	}
+	//Lock the copy in memory
+	else if( mBackTexture != NULL )
+	{
+		mPitch = mWidth * 4;
+		mPixels = &mShadow[ lockRect.y * mWidth + lockRect.x ];
+		mLockRect = lockRect;
+	}
 	//Lock texture
 	else
 	{
-		if( SDL_LockTexture( mTexture, NULL, &mPixels, &mPitch ) != 0 )
+		if( SDL_LockTexture( mTexture, &lockRect, &mPixels, &mPitch ) != 0 )
 		{
 			SDL_Log( "Unable to lock texture! %s\n", SDL_GetError() );
 			success = false;
 		}
+		else
+		{
+			mLockRect = lockRect;
+		}
 	}
 
 	return success;
@@ -337,6 +765,19 @@ bool LTexture::unlockTexture()
 		SDL_Log( "Texture is not locked!\n" );
 		success = false;
 	}
+	//Upload to the texture not being drawn and draw that one from now on
+	else if( mBackTexture != NULL )
+	{
+		//It is also behind on what changed before the last swap
+		SDL_Rect upload;
+		SDL_UnionRect( &mBackDirty, &mLockRect, &upload );
+		SDL_UpdateTexture( mBackTexture, &upload, &mShadow[ upload.y * mWidth + upload.x ], mWidth * 4 );
+
+		std::swap( mTexture, mBackTexture );
+		mBackDirty = mLockRect;
+		mPixels = NULL;
+		mPitch = 0;
+	}
 	//Unlock texture
 	else
 	{
@@ -353,13 +794,21 @@ void* LTexture::getPixels()
 	return mPixels;
 }
 
-void LTexture::copyPixels( void* pixels )
+void LTexture::copyPixels( void* pixels, int pitch )
 {
 	//Texture is locked
 	if( mPixels != NULL )
 	{
-		//Copy to locked pixels
-		memcpy( mPixels, pixels, mPitch * mHeight );
+		//Copy the locked rows only
+		int rowBytes = mLockRect.w * 4;
+		if( pitch == 0 )
+		{
+			pitch = rowBytes;
+		}
+		for( int y = 0; y < mLockRect.h; ++y )
+		{
+			memcpy( (Uint8*)mPixels + y * mPitch, (Uint8*)pixels + y * pitch, rowBytes );
+		}
 	}
 }
 
@@ -377,6 +826,192 @@ Uint32 LTexture::getPixel32( unsigned int x, unsigned int y )
     return pixels[ ( y * ( mPitch / 4 ) ) + x ];
 }
 
+void LTexture::replaceColor( Uint32 color, Uint32 replacement )
+{
+	//Texture is locked
+	if( mPixels != NULL )
+	{
+		for( int y = 0; y < mLockRect.h; ++y )
+		{
+			replacePixels( (Uint32*)( (Uint8*)mPixels + y * mPitch ), mLockRect.w, color, replacement );
+		}
+	}
+}
+
+LTextureAtlas::LTextureAtlas()
+{
+	//Initialize
+	mTexture = NULL;
+}
+
+LTextureAtlas::~LTextureAtlas()
+{
+	//Deallocate
+	free();
+}
+
+int LTextureAtlas::addFile( std::string path )
+{
+	mPaths.push_back( path );
+	return (int)mPaths.size() - 1;
+}
+
+bool LTextureAtlas::layout( int size )
+{
+	//Place the tallest images first so each shelf wastes little height
+	std::vector<int> order( mSurfaces.size() );
+	for( int i = 0; i < (int)order.size(); ++i )
+	{
+		order[ i ] = i;
+	}
+	std::sort( order.begin(), order.end(), [ this ]( int a, int b ) { return mSurfaces[ a ]->h > mSurfaces[ b ]->h; } );
+
+	mRegions.assign( mSurfaces.size(), SDL_Rect{ 0, 0, 0, 0 } );
+	int x = 0, y = 0, shelfHeight = 0;
+	for( int i : order )
+	{
+		int w = mSurfaces[ i ]->w + 2 * PADDING;
+		int h = mSurfaces[ i ]->h + 2 * PADDING;
+
+		//Start a new shelf when this one is full
+		if( x + w > size )
+		{
+			x = 0;
+			y += shelfHeight;
+			shelfHeight = 0;
+		}
+		if( w > size || y + h > size )
+		{
+			return false;
+		}
+
+		mRegions[ i ] = { x + PADDING, y + PADDING, mSurfaces[ i ]->w, mSurfaces[ i ]->h };
+		x += w;
+		shelfHeight = std::max( shelfHeight, h );
+	}
+
+	return true;
+}
+
+bool LTextureAtlas::pack( int maxSize, SDL_TextureAccess access )
+{
+	//Get rid of a previous packing
+	if( mTexture != NULL )
+	{
+		SDL_DestroyTexture( mTexture );
+		mTexture = NULL;
+	}
+
+	//Loading success flag
+	bool success = true;
+
+	//Load the queued images
+	for( const std::string& path : mPaths )
+	{
+		SDL_Surface* surface = loadKeyedSurface( path );
+		if( surface == NULL )
+		{
+			success = false;
+		}
+		else
+		{
+			mSurfaces.push_back( surface );
+		}
+	}
+
+	//Find the smallest square that holds them all
+	int size = 64;
+	while( success && size <= maxSize && !layout( size ) )
+	{
+		size *= 2;
+	}
+	if( success && size > maxSize )
+	{
+		SDL_Log( "Unable to fit the images in a %dx%d atlas!\n", maxSize, maxSize );
+		success = false;
+	}
+
+	SDL_Surface* atlasSurface = NULL;
+	if( success )
+	{
+		atlasSurface = SDL_CreateRGBSurfaceWithFormat( 0, size, size, 32, SDL_PIXELFORMAT_RGBA8888 );
+		if( atlasSurface == NULL )
+		{
+			SDL_Log( "Unable to create atlas surface! SDL Error: %s\n", SDL_GetError() );
+			success = false;
+		}
+	}
+
+	if( success )
+	{
+		//Copy each image with its edges stretched out over the gutter
+		SDL_FillRect( atlasSurface, NULL, 0 );
+		for( int i = 0; i < (int)mSurfaces.size(); ++i )
+		{
+			SDL_Surface* image = mSurfaces[ i ];
+			const SDL_Rect& region = mRegions[ i ];
+			for( int dy = -PADDING; dy < image->h + PADDING; ++dy )
+			{
+				int sy = std::min( std::max( dy, 0 ), image->h - 1 );
+				Uint32* src = (Uint32*)( (Uint8*)image->pixels + sy * image->pitch );
+				Uint32* dst = (Uint32*)( (Uint8*)atlasSurface->pixels + ( region.y + dy ) * atlasSurface->pitch ) + region.x;
+				for( int dx = -PADDING; dx < image->w + PADDING; ++dx )
+				{
+					dst[ dx ] = src[ std::min( std::max( dx, 0 ), image->w - 1 ) ];
+				}
+			}
+		}
+
+		//Create the texture and upload it in one go
+		mTexture = SDL_CreateTexture( gRenderer, SDL_PIXELFORMAT_RGBA8888, access, size, size );
+		if( mTexture == NULL )
+		{
+			SDL_Log( "Unable to create atlas texture! SDL Error: %s\n", SDL_GetError() );
+			success = false;
+		}
+		else
+		{
+			SDL_SetTextureBlendMode( mTexture, SDL_BLENDMODE_BLEND );
+			SDL_UpdateTexture( mTexture, NULL, atlasSurface->pixels, atlasSurface->pitch );
+		}
+
+		SDL_FreeSurface( atlasSurface );
+	}
+
+	//The pixels are in the texture now
+	for( SDL_Surface* surface : mSurfaces )
+	{
+		SDL_FreeSurface( surface );
+	}
+	mSurfaces.clear();
+
+	return success;
+}
+
+bool LTextureAtlas::getTexture( int index, LTexture& view )
+{
+	if( mTexture == NULL || index < 0 || index >= (int)mRegions.size() )
+	{
+		SDL_Log( "No image %d in the atlas!\n", index );
+		return false;
+	}
+
+	view.setView( mTexture, mRegions[ index ] );
+	return true;
+}
+
+void LTextureAtlas::free()
+{
+	//Free texture if it exists
+	if( mTexture != NULL )
+	{
+		SDL_DestroyTexture( mTexture );
+		mTexture = NULL;
+	}
+	mPaths.clear();
+	mRegions.clear();
+}
+
 bool init()
 {
 	//Initialization flag
@@ -390,12 +1025,23 @@ bool init()
 	}
 	else
 	{
+		//Pick the pixel kernels before any image is loaded
+		initPixelKernels();
+
 		//Set texture filtering to linear
 		if( !SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" ) )
 		{
 			SDL_Log( "Warning: Linear texture filtering not enabled!" );
 		}
 
+        //Keep converted images around for the next run
+        char* prefPath = SDL_GetPrefPath( "", "hello_mobile" );
+        if( prefPath != NULL )
+        {
+            gTextureCacheDir = prefPath;
+            SDL_free( prefPath );
+        }
+
         //Get device display mode
         SDL_DisplayMode displayMode;
         if( SDL_GetCurrentDisplayMode( 0, &displayMode ) == 0 )
@@ -436,8 +1082,9 @@ bool loadMedia()
 	//Loading success flag
 	bool success = true;
 
-	//Load splash texture
-	if( !gSplashTexture.loadFromFile( "52_hello_mobile/hello.bmp" ) )
+	//Load splash texture into the atlas with any other sprites
+	int splash = gAtlas.addFile( "52_hello_mobile/hello.bmp" );
+	if( !gAtlas.pack() || !gAtlas.getTexture( splash, gSplashTexture ) )
 	{
 		SDL_Log( "Failed to load splash texture!\n" );
 		success = false;
@@ -448,8 +1095,9 @@ bool loadMedia()
 
 void close()
 {
-	//Free loaded images
+	//Free loaded images, the views before the atlas they point into
 	gSplashTexture.free();
+	gAtlas.free();
 
 	//Destroy window
 	SDL_DestroyRenderer( gRenderer );
@@ -483,11 +1131,15 @@ int main( int argc, char* args[] )
 			//Event handler
 			SDL_Event e;
 
+			//The splash never changes, so sleep until an event might need it redrawn
+			FramePacer pacer;
+			pacer.setIdle( true );
+
 			//While application is running
 			while( !quit )
 			{
 				//Handle events on queue
-				while( SDL_PollEvent( &e ) != 0 )
+				while( pacer.pollEvent( e ) )
 				{
 					//User requests quit
 					if( e.type == SDL_QUIT )
@@ -496,15 +1148,19 @@ int main( int argc, char* args[] )
 					}
 				}
 
-				//Clear screen
-				SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
-				SDL_RenderClear( gRenderer );
+				if( pacer.shouldDraw() )
+				{
+					//Clear screen
+					SDL_SetRenderDrawColor( gRenderer, 0xFF, 0xFF, 0xFF, 0xFF );
+					SDL_RenderClear( gRenderer );
 
-				//Render splash
-				gSplashTexture.render( ( gScreenRect.w - gSplashTexture.getWidth() ) / 2, ( gScreenRect.h - gSplashTexture.getHeight() ) / 2 );
+					//Render splash
+					gSplashTexture.render( ( gScreenRect.w - gSplashTexture.getWidth() ) / 2, ( gScreenRect.h - gSplashTexture.getHeight() ) / 2 );
 
-				//Update screen
-				SDL_RenderPresent( gRenderer );
+					//Update screen
+					SDL_RenderPresent( gRenderer );
+				}
+				pacer.endFrame();
 			}
 		}
 	}
@@ -13,12 +13,20 @@ LOCAL_C_INCLUDES := $(LOCAL_PATH)/$(SDL_PATH)/include \
                     $(LOCAL_PATH)/$(SDL_MIXER_PATH)/include
 
 # Add your application source files here...
-LOCAL_SRC_FILES := arkanoid.cpp
+LOCAL_SRC_FILES := arkanoid.cpp simulation.cpp touchbatch.cpp jobsystem.cpp assetpack.cpp spritebatch.cpp inputlog.cpp quality.cpp
 
 LOCAL_SHARED_LIBRARIES := SDL2 SDL2_ttf SDL2_mixer
 
-LOCAL_LDLIBS := -lGLESv1_CM -lGLESv2 -llog
+LOCAL_LDLIBS := -lGLESv1_CM -lGLESv2 -llog -landroid
 
-LOCAL_CPPFLAGS := -std=c++14 -frtti
+LOCAL_CPPFLAGS := -std=c++14 -fno-rtti
+
+# Enable this to mark the phases of each frame as sections in systrace
+# and Perfetto captures, on Android 6.0 and up
+SUPPORT_TRACE ?= false
+ifeq ($(SUPPORT_TRACE),true)
+    LOCAL_CPPFLAGS += -DARKANOID_TRACE
+    LOCAL_LDLIBS += -ldl
+endif
 
 include $(BUILD_SHARED_LIBRARY)
@@ -4,36 +4,44 @@
 
 #include <iostream>
 #include <memory>
-#include <typeinfo>
-#include <map>
 #include<string>
 #include <ostream>
 #include <vector>
 #include <algorithm>
 #include <cmath>
+#include <cstdint>
+#include <functional>
 
 #include <android/log.h>
+#ifdef __ANDROID__
+#include <jni.h>
+#include <android/asset_manager.h>
+#include <android/asset_manager_jni.h>
+#endif
 
 #include <SDL.h>
 #include <SDL_ttf.h>        // truetype font extension library
 #include <SDL_mixer.h>      // sound library
 
+#include "simulation.h"
+#include "framepacer.h"
+#include "renderscale.h"
+#include "quality.h"
+#include "assetpack.h"
+#include "jobsystem.h"
+#include "retained.h"
+#include "inputlog.h"
+#include "trace.h"
+
 const Uint8* gCurrentKeyStates = nullptr;
 
 // global vars, TODO - move these into the game
-SDL_Rect gScreenRect = { 0, 0, 800, 600 };
-SDL_Point gTouchLocation = { gScreenRect.w / 2, gScreenRect.h / 2 };
 bool gTouchTap = false;
 
 // AUDIO stuff, TODO - move into audio class
 //The music that will be played
 Mix_Music *gMusic = nullptr;
 
-//The sound effects that will be used
-Mix_Chunk *gHitPaddle = nullptr;
-Mix_Chunk *gHitBrick = nullptr;
-Mix_Chunk *gMissedPaddle = nullptr;
-
 /**
 * Log an SDL error with some error message to the output stream of our choice
 * @param os The output stream to write the message to
@@ -47,48 +55,387 @@ void logSDLError( std::ostream &os, const std::string &msg )
 }
 
 //
-// Load Audio
+// Load assets in the background
 //
-bool loadMedia()
+
+// Loads assets on the job system's workers while the render thread keeps
+// presenting frames.  A job is submitted once the jobs it depends on are
+// done, the lives text is rendered once its font is open, and is skipped
+// if one of them failed.  Sound effects are decoded by the mixer's loads,
+// which run on the job system too.  Whatever needs the renderer is left
+// to each job's finish function, which poll() calls on the render thread
+// as the jobs complete.
+class AssetLoader
 {
-    //Loading success flag
-    bool success = true;
+public:
+    // Runs on a worker, returns nullptr if the asset couldn't be loaded
+    using Load = std::function<void*()>;
+    // Runs on the render thread with what the load returned
+    using Finish = std::function<void( void* )>;
+    using FinishSound = std::function<void( Mix_Chunk* )>;
+
+    explicit AssetLoader( JobSystem& jobSystem )
+        : jobSystem( jobSystem ), lock( SDL_CreateMutex() ), changed( SDL_CreateCond() ) {}
+
+    ~AssetLoader()
+    {
+        wait();
+        SDL_DestroyCond( changed );
+        SDL_DestroyMutex( lock );
+    }
+
+    // Everything is added before start(), returns the job's number for
+    // the jobs that depend on it
+    int add( Load load, Finish finish, std::initializer_list<int> after = {} )
+    {
+        jobs.emplace_back( Job{ std::move( load ), std::move( finish ), after } );
+        return jobs.size() - 1;
+    }
+
+    // Takes over `src`, `name` is what the mixer caches the chunk as
+    void addSound( SDL_RWops *src, const char *name, FinishSound finish )
+    {
+        Mix_LoadHandle *handle( src != nullptr ? Mix_LoadWAVCachedAsync_RW( src, 1, name, nullptr, nullptr ) : nullptr );
+        sounds.emplace_back( Sound{ handle, std::move( finish ) } );
+    }
+
+    void start()
+    {
+        SDL_LockMutex( lock );
+        std::vector<int> ready( readyJobs() );
+        SDL_UnlockMutex( lock );
+        submit( ready );
+    }
+
+    // What a finished job loaded, for a job that depends on it
+    void* result( int job )
+    {
+        SDL_LockMutex( lock );
+        void *output( jobs[job].output );
+        SDL_UnlockMutex( lock );
+        return output;
+    }
+
+    // Hand the assets loaded since the last call to their finish
+    // functions, returns true once there are none left to come
+    bool poll()
+    {
+        handOver( false );
+        return handedOver == jobs.size() + sounds.size();
+    }
+
+    float progress() const
+    {
+        std::size_t total( jobs.size() + sounds.size() );
+        return total ? (float)handedOver / total : 1.f;
+    }
 
-    //Load music
-    gMusic = Mix_LoadMUS( "skate_music.mp3" );
-    if( gMusic == NULL )
+    // Block until everything is loaded and handed over
+    void wait()
     {
-        std::string msg = std::string("Failed to load music! SDL_mixer Error: ") + Mix_GetError();
-        logSDLError( std::cerr, msg);
-        success = false;
+        SDL_LockMutex( lock );
+        while (running > 0)
+            SDL_CondWait( changed, lock );
+        SDL_UnlockMutex( lock );
+        handOver( true );
     }
 
-    //Load sound effects
-    gHitPaddle = Mix_LoadWAV( "ping_pong_8bit_beeep.ogg" );
-    if( gHitPaddle == NULL )
+private:
+    enum class JobState
+    {
+        Pending,
+        Running,
+        Done,
+        HandedOver
+    };
+
+    struct Job
+    {
+        Load load;
+        Finish finish;
+        std::vector<int> after;
+        JobState state{ JobState::Pending };
+        bool skip{ false };
+        void *output{ nullptr };
+    };
+
+    struct Sound
+    {
+        Mix_LoadHandle *handle;     // nullptr once handed over, or if it couldn't start
+        FinishSound finish;
+        bool handedOver{ false };
+    };
+
+    JobSystem& jobSystem;
+    SDL_mutex *lock;
+    SDL_cond *changed;
+    std::vector<Job> jobs;
+    std::vector<Sound> sounds;
+    // Jobs submitted and not yet done
+    int running{ 0 };
+    std::size_t handedOver{ 0 };
+
+    // Marks the pending jobs whose dependencies are all done as running
+    // and returns them, with `skip` set if one of those failed.  Called
+    // with the lock held.
+    std::vector<int> readyJobs()
+    {
+        std::vector<int> ready;
+        for (std::size_t i{ 0 }; i < jobs.size(); ++i)
+        {
+            Job& job( jobs[i] );
+            if (job.state != JobState::Pending)
+                continue;
+
+            bool waiting{ false };
+            job.skip = false;
+            for (auto dependency : job.after)
+            {
+                if (jobs[dependency].state == JobState::Pending || jobs[dependency].state == JobState::Running)
+                    waiting = true;
+                else if (jobs[dependency].output == nullptr)
+                    job.skip = true;
+            }
+            if (waiting)
+                continue;
+            job.state = JobState::Running;
+            ++running;
+            ready.emplace_back( (int)i );
+        }
+        return ready;
+    }
+
+    // Without workers the loads hold up the caller instead
+    void submit( const std::vector<int>& ready )
     {
-        std::string msg = std::string("Failed to load hitPaddle sound! SDL_mixer Error: ") + Mix_GetError();
-        logSDLError( std::cerr, msg);
-        success = false;
+        for (auto job : ready)
+            if (!jobSystem.submit( [this, job] { run( job ); } ))
+                run( job );
     }
 
-    gHitBrick = Mix_LoadWAV( "ping_pong_8bit_plop.ogg" );
-    if( gHitBrick == NULL )
+    void run( int index )
     {
-        std::string msg = std::string("Failed to load hitBrick! SDL_mixer Error: ") + Mix_GetError();
-        logSDLError( std::cerr, msg);
-        success = false;
+        Job& job( jobs[index] );
+        void *output( job.skip ? nullptr : job.load() );
+        SDL_LockMutex( lock );
+        job.output = output;
+        job.state = JobState::Done;
+        std::vector<int> ready( readyJobs() );
+        --running;
+        SDL_CondBroadcast( changed );
+        SDL_UnlockMutex( lock );
+        submit( ready );
     }
 
-    gMissedPaddle = Mix_LoadWAV( "ping_pong_8bit_peeeeeep.ogg" );
-    if( gMissedPaddle == NULL )
+    void handOver( bool block )
     {
-        std::string msg = std::string("Failed to load missedPaddle! SDL_mixer Error: ") + Mix_GetError();
-        logSDLError( std::cerr, msg);
-        success = false;
+        std::vector<Job*> done;
+        SDL_LockMutex( lock );
+        for (auto& job : jobs)
+            if (job.state == JobState::Done)
+            {
+                job.state = JobState::HandedOver;
+                done.emplace_back( &job );
+            }
+        SDL_UnlockMutex( lock );
+
+        for (auto job : done)
+        {
+            job->finish( job->output );
+            ++handedOver;
+        }
+
+        for (auto& sound : sounds)
+        {
+            if (sound.handedOver || (!block && sound.handle != nullptr && !Mix_LoadReady( sound.handle )))
+                continue;
+            Mix_Chunk *chunk( sound.handle != nullptr ? Mix_LoadWait( sound.handle ) : nullptr );
+            sound.handle = nullptr;
+            sound.handedOver = true;
+            sound.finish( chunk );
+            ++handedOver;
+        }
     }
+};
 
-    return success;
+// A whole asset in memory.  On Android it's mapped straight from the APK,
+// so assets stored uncompressed cost no copy; anywhere else it's read
+// into a buffer.
+class AssetBuffer
+{
+public:
+    AssetBuffer() = default;
+    AssetBuffer( const AssetBuffer& ) = delete;
+    AssetBuffer& operator=( const AssetBuffer& ) = delete;
+    ~AssetBuffer() { close(); }
+
+    // Returns false with the SDL error set if the asset can't be read,
+    // missing() tells if that's because there's no such asset
+    bool open( const char *file )
+    {
+        close();
+        absent = false;
+#ifdef __ANDROID__
+        JNIEnv *env = static_cast<JNIEnv*>(SDL_AndroidGetJNIEnv());
+        jobject activity = static_cast<jobject>(SDL_AndroidGetActivity());
+        if (env == nullptr || activity == nullptr)
+        {
+            SDL_SetError( "No activity to get the assets from" );
+            return false;
+        }
+
+        jclass activityClass = env->GetObjectClass( activity );
+        jmethodID getAssets = env->GetMethodID( activityClass, "getAssets",
+                                                "()Landroid/content/res/AssetManager;" );
+        jobject assets = env->CallObjectMethod( activity, getAssets );
+        AAssetManager *manager = assets != nullptr ? AAssetManager_fromJava( env, assets ) : nullptr;
+        if (manager != nullptr)
+            asset = AAssetManager_open( manager, file, AASSET_MODE_BUFFER );
+        env->DeleteLocalRef( assets );
+        env->DeleteLocalRef( activityClass );
+        env->DeleteLocalRef( activity );
+
+        if (asset != nullptr)
+        {
+            bytes = AAsset_getBuffer( asset );
+            length = AAsset_getLength( asset );
+        }
+        else if (manager != nullptr)
+            absent = true;
+        if (bytes == nullptr)
+        {
+            close();
+            SDL_SetError( "Couldn't map asset %s", file );
+            return false;
+        }
+        return true;
+#else
+        SDL_RWops *rw = SDL_RWFromFile( file, "rb" );
+        if (rw == nullptr)
+        {
+            absent = true;
+            return false;
+        }
+        Sint64 size = SDL_RWsize( rw );
+        if (size >= 0)
+        {
+            copy.resize( (std::size_t)size );
+            if (SDL_RWread( rw, copy.data(), 1, copy.size() ) != copy.size())
+                size = -1;
+        }
+        SDL_RWclose( rw );
+        if (size < 0)
+        {
+            copy.clear();
+            SDL_SetError( "Couldn't read %s", file );
+            return false;
+        }
+        bytes = copy.data();
+        length = copy.size();
+        return true;
+#endif
+    }
+
+    void close()
+    {
+#ifdef __ANDROID__
+        if (asset != nullptr)
+            AAsset_close( asset );
+        asset = nullptr;
+#endif
+        copy.clear();
+        bytes = nullptr;
+        length = 0;
+    }
+
+    const void* data() const noexcept { return bytes; }
+    std::size_t size() const noexcept { return length; }
+    bool missing() const noexcept { return absent; }
+
+private:
+#ifdef __ANDROID__
+    AAsset *asset = nullptr;
+#endif
+    std::vector<Uint8> copy;
+    const void *bytes = nullptr;
+    std::size_t length = 0;
+    bool absent = false;
+};
+
+//
+// Load Audio
+//
+void queueMedia( AssetLoader& loader, const AssetPack& assets )
+{
+    //Keep the decoded sound effects and the rendered glyphs around so the
+    //next launch skips decoding and rasterizing them
+    char *cacheDir = SDL_GetPrefPath( "", "arkanoid" );
+    if( cacheDir != nullptr )
+    {
+        Mix_SetChunkCacheDir( cacheDir );
+        TTF_SetGlyphCacheDir( cacheDir );
+        SDL_free( cacheDir );
+    }
+
+    //When every channel is busy, drop a brick plop before a paddle hit,
+    //and never lose the missed paddle sound
+    Mix_SetVoiceStealing( MIX_STEAL_LOWEST_PRIORITY, -1 );
+
+    //The music is a 44.1 kHz mp3, have mpg123 synthesize it at whatever rate
+    //the device runs at rather than converting it afterwards
+    Mix_SetMP3DeviceRate( 1 );
+
+    //Decode the sound effects
+    loader.addSound( assets.stream( "ping_pong_8bit_beeep.ogg" ), "ping_pong_8bit_beeep.ogg", []( Mix_Chunk *chunk )
+                     {
+                         gHitPaddle = chunk;
+                         if( gHitPaddle == NULL )
+                         {
+                             std::string msg = std::string("Failed to load hitPaddle sound! SDL_mixer Error: ") + Mix_GetError();
+                             logSDLError( std::cerr, msg);
+                             return;
+                         }
+                         Mix_PriorityChunk( gHitPaddle, 1 );
+                         Mix_LimitChunk( gHitPaddle, 1, 1323 );
+                     } );
+    loader.addSound( assets.stream( "ping_pong_8bit_plop.ogg" ), "ping_pong_8bit_plop.ogg", []( Mix_Chunk *chunk )
+                     {
+                         gHitBrick = chunk;
+                         if( gHitBrick == NULL )
+                         {
+                             std::string msg = std::string("Failed to load hitBrick! SDL_mixer Error: ") + Mix_GetError();
+                             logSDLError( std::cerr, msg);
+                             return;
+                         }
+                         //A ball clearing several bricks in a frame plays one
+                         //plop, not a pile of them stacked a few samples apart
+                         //(1323 frames is 30 ms at 44.1 kHz)
+                         Mix_LimitChunk( gHitBrick, 2, 1323 );
+                     } );
+    loader.addSound( assets.stream( "ping_pong_8bit_peeeeeep.ogg" ), "ping_pong_8bit_peeeeeep.ogg", []( Mix_Chunk *chunk )
+                     {
+                         gMissedPaddle = chunk;
+                         if( gMissedPaddle == NULL )
+                         {
+                             std::string msg = std::string("Failed to load missedPaddle! SDL_mixer Error: ") + Mix_GetError();
+                             logSDLError( std::cerr, msg);
+                             return;
+                         }
+                         Mix_PriorityChunk( gMissedPaddle, 2 );
+                     } );
+
+    //Load music, the error is only set on the thread that failed
+    loader.add( [&assets]() -> void*
+                {
+                    Mix_Music *music = Mix_LoadMUS_RW( assets.stream( "skate_music.mp3" ), 1 );
+                    if( music == NULL )
+                    {
+                        std::string msg = std::string("Failed to load music! SDL_mixer Error: ") + Mix_GetError();
+                        logSDLError( std::cerr, msg);
+                    }
+                    return music;
+                },
+                []( void *music ) { gMusic = static_cast<Mix_Music*>(music); } );
 }
 
 /**
@@ -135,6 +482,51 @@ void renderTexture( SDL_Texture *tex, SDL_Renderer *ren, int x, int y, SDL_Rect
     renderTexture( tex, ren, dst, clip );
 }
 
+/**
+* Queue an SDL_Texture to be drawn at some destination rect, see
+* renderTexture above
+* @param tex The source texture we want to draw
+* @param queue The render queue to record the draw in
+* @param layer The layer of the queue to draw in
+* @param dst The destination rectangle to render the texture to
+* @param clip The sub-section of the texture to draw (clipping rect)
+*        default of nullptr draws the entire texture
+*/
+void renderTexture( SDL_Texture *tex, RenderQueue &queue, int layer, SDL_Rect dst,
+                    SDL_Rect *clip = nullptr )
+{
+    queue.copy( layer, tex, clip, dst );
+}
+
+/**
+* Queue an SDL_Texture to be drawn at position x, y, preserving its width
+* and height, or the clip's if one is passed
+* @param tex The source texture we want to draw
+* @param queue The render queue to record the draw in
+* @param layer The layer of the queue to draw in
+* @param x The x coordinate to draw to
+* @param y The y coordinate to draw to
+* @param clip The sub-section of the texture to draw (clipping rect)
+*        default of nullptr draws the entire texture
+*/
+void renderTexture( SDL_Texture *tex, RenderQueue &queue, int layer, int x, int y,
+                    SDL_Rect *clip = nullptr )
+{
+    SDL_Rect dst;
+    dst.x = x;
+    dst.y = y;
+    if (clip != nullptr)
+    {
+        dst.w = clip->w;
+        dst.h = clip->h;
+    }
+    else
+    {
+        SDL_QueryTexture( tex, NULL, NULL, &dst.w, &dst.h );
+    }
+    renderTexture( tex, queue, layer, dst, clip );
+}
+
 /**
 * Render the message we want to display to a texture for drawing
 * @param message The message we want to display
@@ -166,394 +558,674 @@ SDL_Texture* createText( const std::string &message, TTF_Font *font,
     return texture;
 }
 
-void fill_circle( SDL_Renderer *renderer, int cx, int cy, int radius, Uint8 r, Uint8 g, Uint8 b, Uint8 a )
+// Touch input, gathered over a frame.  However many motion events the
+// digitizer delivers, each one only replaces the latest sample.  The
+// motion across the frame gives a velocity that can carry the reported
+// position a little ahead, to hide part of the delay between the touch
+// and the frame that shows it.
+class TouchInput
 {
-    // Note that there is more to altering the bitrate of this
-    // method than just changing this value.  See how pixels are
-    // altered at the following web page for tips:
-    //   http://www.libsdl.org/intro.en/usingvideo.html
-    static const int BPP = 4;
+public:
+    static constexpr Uint32 maxPredictionMs{ 50 };
+    // A finger that hasn't moved for this long is taken to have stopped
+    static constexpr Uint32 staleMs{ 50 };
 
-    for (double dy = 1; dy <= radius; dy += 1.0)
+    // How far past the latest sample to predict, 0 reports it as it is
+    void setPrediction( Uint32 ms ) noexcept
     {
-        // This loop is unrolled a bit, only iterating through half of the
-        // height of the circle.  The result is used to draw a scan line and
-        // its mirror image below it.
-
-        // The following formula has been simplified from our original.  We
-        // are using half of the width of the circle because we are provided
-        // with a center and we need left/right coordinates.
-
-        double dx = floor( sqrt( (2.0 * radius * dy) - (dy * dy) ) );
-        int x = cx - dx;
-        SDL_SetRenderDrawColor( renderer, r, g, b, a );
-        SDL_RenderDrawLine( renderer, cx - dx, cy + dy - radius, cx + dx, cy + dy - radius );
-        SDL_RenderDrawLine( renderer, cx - dx, cy - dy + radius, cx + dx, cy - dy + radius );
+        predictionMs = std::min( ms, maxPredictionMs );
     }
-}
-
-
-class Entity
-{
-public:
-    bool destroyed{ false };
 
-    virtual ~Entity() {}
-    virtual void update() {}
-    virtual void draw( SDL_Renderer *renderer ) {}
-};
-
-class Manager
-{
-private:
-    std::vector<std::unique_ptr<Entity>> entities;
-    std::map<std::size_t, std::vector<Entity*>> groupedEntities;
-
-public:
-    template <typename T, typename... TArgs>
-    T& create( TArgs&&... mArgs )
+    void beginFrame() noexcept
     {
-        static_assert(std::is_base_of<Entity, T>::value,
-                      "`T` must be derived from `Entity`");
-
-        auto uPtr( std::make_unique<T>( std::forward<TArgs>( mArgs )... ) );
-        auto ptr( uPtr.get() );
-        groupedEntities[typeid(T).hash_code()].emplace_back( ptr );
-        entities.emplace_back( std::move( uPtr ) );
-
-        return *ptr;
+        tap = false;
     }
 
-    void refresh()
+    void handle( const SDL_Event& e ) noexcept
     {
-        for (auto& pair : groupedEntities)
+        latest = { e.tfinger.x * gScreenRect.w, e.tfinger.y * gScreenRect.h, e.tfinger.timestamp };
+        if (e.type == SDL_FINGERDOWN)
         {
-            auto& vector( pair.second );
-
-            vector.erase( std::remove_if( std::begin( vector ), std::end( vector ),
-                                          []( auto mPtr )
-                                          {
-                                              return mPtr->destroyed;
-                                          } ),
-                          std::end( vector ) );
+            tap = true;
+            down = true;
+            anchor = latest;
+            velocity = { 0.f, 0.f };
         }
-
-        entities.erase( std::remove_if( std::begin( entities ), std::end( entities ),
-                                        []( const auto& mUPtr )
-                                        {
-                                            return mUPtr->destroyed;
-                                        } ),
-                        std::end( entities ) );
+        else if (e.type == SDL_FINGERUP)
+            down = false;
     }
 
-    void clear()
+    // Work out where the finger is heading from how far it went since the
+    // last frame
+    void endFrame() noexcept
     {
-        groupedEntities.clear();
-        entities.clear();
+        if (latest.timestamp == anchor.timestamp)
+            return;
+        float dt( latest.timestamp - anchor.timestamp );
+        velocity = { (latest.x - anchor.x) / dt, (latest.y - anchor.y) / dt };
+        anchor = latest;
     }
 
-    template <typename T>
-    auto& getAll()
-    {
-        return groupedEntities[typeid(T).hash_code()];
-    }
+    bool tapped() const noexcept { return tap; }
 
-    template <typename T, typename TFunc>
-    void forEach( const TFunc& mFunc )
+    SDL_Point position( Uint32 now ) const noexcept
     {
-        for (auto ptr : getAll<T>()) mFunc( *reinterpret_cast<T*>(ptr) );
-    }
+        float x{ latest.x }, y{ latest.y };
+        Uint32 age{ now - latest.timestamp };
 
-    void update()
-    {
-        for (auto& e : entities) e->update();
+        if (down && predictionMs > 0 && age < staleMs)
+        {
+            float ahead( std::min( age + predictionMs, maxPredictionMs ) );
+            x = std::min( std::max( x + velocity.x * ahead, 0.f ), (float)gScreenRect.w );
+            y = std::min( std::max( y + velocity.y * ahead, 0.f ), (float)gScreenRect.h );
+        }
+        return { (int)x, (int)y };
     }
-    void draw( SDL_Renderer *renderer )
+
+private:
+    struct Sample
     {
-        for (auto& e : entities) e->draw( renderer );
-    }
-};
+        float x, y;
+        Uint32 timestamp;
+    };
 
-struct Vector2f
-{
-    float x, y;
+    Sample latest{ gScreenRect.w / 2.f, gScreenRect.h / 2.f, 0 };
+    Sample anchor{ latest };
+    Vector2f velocity{ 0.f, 0.f };     // pixels per millisecond
+    Uint32 predictionMs{ 0 };
+    bool down{ false };
+    bool tap{ false };
 };
 
-struct Shape
-{
-    float x, y;
-    float originX, originY;
-    SDL_Color fillColor;
-
-    void move( const Vector2f &vel ) { x += vel.x; y += vel.y; }
-    void setPosition( float mX, float mY ) { x = mX; y = mY; }
-    void setFillColor( const SDL_Color &defColor ) { fillColor = defColor; }
-    void setOrigin( float oX, float oY ) { originX = oX; originY = oY; }
-};
+constexpr Uint32 TouchInput::maxPredictionMs;
 
-struct Rectangle : public Shape
+// Times the phases of every frame with the performance counter.  The last
+// couple of seconds of frames are kept, with a histogram of whole frame
+// times, for an optional overlay, and every ten seconds or so a summary
+// goes to the log so devices can be compared from logcat.
+class FrameProfiler
 {
-    float w, h;
+public:
+    enum Phase
+    {
+        Events,
+        Update,
+        Collisions,
+        Refresh,
+        Draw,
+        Present,
+        PhaseCount
+    };
 
-    void setSize( float width, float height ) { w = width; h = height; }
-    float width() const noexcept { return w; }
-    float height() const noexcept { return h; }
-    float left() const noexcept { return x - width() / 2.f; }
-    float right() const noexcept { return x + width() / 2.f; }
-    float top() const noexcept { return y - height() / 2.f; }
-    float bottom() const noexcept { return y + height() / 2.f; }
+    static constexpr int historyFrames{ 120 };
+    static constexpr int logFrames{ 600 };
+    // 4 ms per bucket, the last one takes everything slower
+    static constexpr int buckets{ 10 };
+    static constexpr double bucketMs{ 4.0 };
 
-    void drawShape( SDL_Renderer *renderer )
+    // Adds the time until it goes out of scope to a phase of this frame,
+    // which is a trace section as well
+    class Scope
     {
-        SDL_Rect rect = { (int)(x-originX), (int)(y-originY), (int)w, (int)h };	// TODO - round
-        SDL_SetRenderDrawColor( renderer, fillColor.r, fillColor.g, fillColor.b, fillColor.a );
-        SDL_RenderFillRect( renderer, &rect );
-    }
-};
-
-// shape info
-struct Circle : public Shape
-{
-    float radius;
+    public:
+        Scope( FrameProfiler& mProfiler, Phase mPhase ) noexcept
+            : profiler( mProfiler ), phase( mPhase ), start( SDL_GetPerformanceCounter() )
+        {
+            trace::begin( phaseNames[phase] );
+        }
+        ~Scope()
+        {
+            trace::end();
+            profiler.frame.phases[phase] += SDL_GetPerformanceCounter() - start;
+        }
 
-    float left() const noexcept { return x - radius; }
-    float right() const noexcept { return x + radius; }
-    float top() const noexcept { return y - radius; }
-    float bottom() const noexcept { return y + radius; }
-    void setRadius( float r ) { radius = r; }
-    void drawShape( SDL_Renderer *renderer )
-    {	// TODO - round
-        fill_circle( renderer, x-originX, y-originY, radius, fillColor.r, fillColor.g, fillColor.b, fillColor.a );
-    }
-};
+    private:
+        FrameProfiler& profiler;
+        Phase phase;
+        Uint64 start;
+    };
 
-class Ball : public Entity, public Circle
-{
-public:
-    static const SDL_Color defColor;
-    static constexpr float defRadius{ 10.f }, defVelocity{ 8.f };
+    // A phase's time so far this frame
+    Uint64 elapsed( Phase phase ) const noexcept { return frame.phases[phase]; }
 
-    Vector2f velocity{ -defVelocity, -defVelocity };
+    // Time spent on this frame elsewhere, such as on the game thread
+    void add( Phase phase, Uint64 counts ) noexcept { frame.phases[phase] += counts; }
 
-    Ball( float mX, float mY )
+    void beginFrame() noexcept
     {
-        setPosition( mX, mY );
-        setRadius( defRadius );
-        setFillColor( defColor );
-        setOrigin( defRadius, defRadius );
+        trace::begin( "frame" );
+        frame = Sample{};
+        frameStart = SDL_GetPerformanceCounter();
     }
 
-    void update() override
+    void endFrame()
     {
-        move( velocity );
-        solveBoundCollisions();
-    }
+        frame.total = SDL_GetPerformanceCounter() - frameStart;
+        trace::end();
 
-    void draw( SDL_Renderer *renderer ) override
-    {
-        drawShape( renderer );
+        if (recorded == historyFrames)
+            --histogram[bucketOf( history[next].total )];
+        else
+            ++recorded;
+        history[next] = frame;
+        ++histogram[bucketOf( frame.total )];
+        next = (next + 1) % historyFrames;
+
+        if (++sinceLog >= logFrames)
+        {
+            sinceLog = 0;
+            log();
+        }
     }
 
-private:
-    void solveBoundCollisions() noexcept
+    void drawOverlay( SDL_Renderer *renderer, TTF_Font *font ) const
     {
-        if (left() < 0)
-            velocity.x = defVelocity;
-        else if (right() > gScreenRect.w)
-            velocity.x = -defVelocity;
+        static const SDL_Color textColor{ 255, 255, 255, 255 };
+        char line[128];
+        int x{ gScreenRect.w - 230 }, y{ 30 };
+        int lineHeight{ TTF_FontLineSkip( font ) };
+
+        SDL_Rect panel{ x - 5, y - 5, 225, (PhaseCount + 3) * lineHeight + 10 };
+        SDL_SetRenderDrawColor( renderer, 0, 0, 0, 160 );
+        SDL_RenderFillRect( renderer, &panel );
+
+        for (int phase{ 0 }; phase <= PhaseCount; ++phase)
+        {
+            double average, peak;
+            summary( phase, average, peak );
+            SDL_snprintf( line, sizeof(line), "%-10s %6.2f %6.2f ms",
+                          phase == PhaseCount ? "frame" : phaseNames[phase], average, peak );
+            TTF_DrawUTF8( renderer, font, line, x, y, textColor );
+            y += lineHeight;
+        }
 
-        if (top() < 0)
-            velocity.y = defVelocity;
-        else if (bottom() > gScreenRect.h)
+        // Two rows of five buckets each
+        for (int row{ 0 }; row < 2; ++row)
         {
-            // If the ball leaves the window towards the bottom,
-            // we destroy it.
-            destroyed = true;
-            if (gMissedPaddle != nullptr)
-                Mix_PlayChannel( -1, gMissedPaddle, 0 );
+            int used{ 0 };
+            for (int i{ row * buckets / 2 }; i < (row + 1) * buckets / 2; ++i)
+                used += SDL_snprintf( line + used, sizeof(line) - used, "%s%d+:%d",
+                                      used ? " " : "", (int)(i * bucketMs), histogram[i] );
+            TTF_DrawUTF8( renderer, font, line, x, y, textColor );
+            y += lineHeight;
         }
     }
-};
 
-const SDL_Color Ball::defColor{ 255,0,0,255 };
+private:
+    struct Sample
+    {
+        Uint64 phases[PhaseCount]{};
+        Uint64 total{ 0 };
+    };
 
-class Paddle : public Entity, public Rectangle
-{
-public:
-    static const SDL_Color defColor;
-    static constexpr float defWidth{ 60.f }, defHeight{ 20.f };
-    static constexpr float defVelocity{ 8.f };
+    static const char *phaseNames[PhaseCount];
 
-    Vector2f velocity = { 0,0 };
+    Sample frame;
+    Uint64 frameStart{ 0 };
+    Sample history[historyFrames];
+    int next{ 0 }, recorded{ 0 }, sinceLog{ 0 };
+    int histogram[buckets]{};
 
-    Paddle( float mX, float mY )
+    static double toMs( Uint64 counts ) noexcept
     {
-        setPosition( mX, mY );
-        setSize( defWidth, defHeight );
-        setFillColor( defColor );
-        setOrigin( defWidth / 2.f, defHeight / 2.f );
+        return counts * 1000.0 / SDL_GetPerformanceFrequency();
     }
 
-    void update() override
+    static int bucketOf( Uint64 counts ) noexcept
     {
-        processPlayerInput();
-        move( velocity );
+        return std::min( (int)(toMs( counts ) / bucketMs), buckets - 1 );
     }
 
-    void draw( SDL_Renderer *renderer ) override
+    // The average and the slowest over the history, PhaseCount for the
+    // whole frame
+    void summary( int phase, double& average, double& peak ) const noexcept
     {
-        drawShape( renderer );
+        Uint64 sum{ 0 }, most{ 0 };
+        for (int i{ 0 }; i < recorded; ++i)
+        {
+            Uint64 counts{ phase == PhaseCount ? history[i].total : history[i].phases[phase] };
+            sum += counts;
+            most = std::max( most, counts );
+        }
+        average = recorded ? toMs( sum ) / recorded : 0.0;
+        peak = toMs( most );
     }
 
-private:
-    void processPlayerInput()
+    void log() const
     {
-#if 0
-        if ((gCurrentKeyStates[SDL_SCANCODE_LEFT]) && left() > 0)
-            velocity.x = -defVelocity;
-        else if ((gCurrentKeyStates[SDL_SCANCODE_RIGHT]) && right() < gScreenRect.w)
-            velocity.x = defVelocity;
-        else
-            velocity.x = 0;
-#endif
-        x = gTouchLocation.x;
+        char line[256];
+        int used{ 0 };
+
+        for (int phase{ 0 }; phase <= PhaseCount; ++phase)
+        {
+            double average, peak;
+            summary( phase, average, peak );
+            used += SDL_snprintf( line + used, sizeof(line) - used, "%s%s %.2f/%.2f",
+                                  used ? ", " : "", phase == PhaseCount ? "frame" : phaseNames[phase],
+                                  average, peak );
+        }
+        __android_log_print( ANDROID_LOG_INFO, "MOOSE", "profile ms avg/max: %s", line );
+
+        used = 0;
+        for (int i{ 0 }; i < buckets; ++i)
+            used += SDL_snprintf( line + used, sizeof(line) - used, "%s%d+:%d",
+                                  used ? " " : "", (int)(i * bucketMs), histogram[i] );
+        __android_log_print( ANDROID_LOG_INFO, "MOOSE", "profile frame ms histogram: %s", line );
     }
 };
 
-const SDL_Color Paddle::defColor{ 255,0,0,255 };
+const char *FrameProfiler::phaseNames[FrameProfiler::PhaseCount] = {
+    "events", "update", "collisions", "refresh", "draw", "present"
+};
 
-class Brick : public Entity, public Rectangle
+// Passes frames from the game thread to the render thread in three slots:
+// the game thread fills one while the render thread draws from another,
+// and the third holds the latest finished frame.  The game thread waits
+// rather than overwrite a frame that was never drawn, so it runs at most
+// one frame ahead.
+template <typename T>
+class TripleBuffer
 {
 public:
-    static const SDL_Color defColorHits1;
-    static const SDL_Color defColorHits2;
-    static const SDL_Color defColorHits3;
-    static constexpr float defWidth{ 60.f }, defHeight{ 20.f };
-    static constexpr float defVelocity{ 8.f };
-
-    // Let's add a field for the required hits.
-    int requiredHits{ 1 };
+    TripleBuffer()
+        : lock( SDL_CreateMutex() ), changed( SDL_CreateCond() ) {}
 
-    Brick( float mX, float mY )
+    ~TripleBuffer()
     {
-        setPosition( mX, mY );
-        setSize( defWidth, defHeight );
-        setOrigin( defWidth / 2.f, defHeight / 2.f );
+        SDL_DestroyCond( changed );
+        SDL_DestroyMutex( lock );
     }
 
-    void update() override
+    // The slot the game thread fills, its own until publish()
+    T& back() noexcept { return slots[writing]; }
+
+    // Hand the back slot to the render thread and start on another,
+    // returns false once closed
+    bool publish()
     {
-        // Let's alter the color of the brick depending on the
-        // required hits.
-        if (requiredHits == 1)
-            setFillColor( defColorHits1 );
-        else if (requiredHits == 2)
-            setFillColor( defColorHits2 );
-        else
-            setFillColor( defColorHits3 );
+        SDL_LockMutex( lock );
+        while (fresh && !closed)
+            SDL_CondWait( changed, lock );
+        std::swap( writing, ready );
+        fresh = true;
+        bool open{ !closed };
+        SDL_CondBroadcast( changed );
+        SDL_UnlockMutex( lock );
+        return open;
     }
-    void draw( SDL_Renderer *renderer ) override
+
+    // Wait for a frame published since the last call, the render thread's
+    // until the next one.  Returns nullptr once closed.
+    T* acquire()
     {
-        drawShape( renderer );
+        T *frame{ nullptr };
+        SDL_LockMutex( lock );
+        while (!fresh && !closed)
+            SDL_CondWait( changed, lock );
+        if (!closed)
+        {
+            std::swap( reading, ready );
+            fresh = false;
+            frame = &slots[reading];
+            SDL_CondBroadcast( changed );
+        }
+        SDL_UnlockMutex( lock );
+        return frame;
     }
-};
-
-const SDL_Color Brick::defColorHits1{ 255, 255, 0, 80 };
-const SDL_Color Brick::defColorHits2{ 255, 255, 0, 170 };
-const SDL_Color Brick::defColorHits3{ 255, 255, 0, 255 };
 
-template <typename T1, typename T2>
-bool isIntersecting( const T1& mA, const T2& mB ) noexcept
-{
-    return mA.right() >= mB.left() && mA.left() <= mB.right() &&
-           mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
-}
-
-void solvePaddleBallCollision( const Paddle& mPaddle, Ball& mBall ) noexcept
-{
-    if (!isIntersecting( mPaddle, mBall ))
-        return;
-
-    mBall.velocity.y = -Ball::defVelocity;
-    mBall.velocity.x =
-            mBall.x < mPaddle.x ? -Ball::defVelocity : Ball::defVelocity;
-
-    if (gHitPaddle != nullptr)
-        Mix_PlayChannel( -1, gHitPaddle, 0 );
+    // Wake both threads for good
+    void close()
+    {
+        SDL_LockMutex( lock );
+        closed = true;
+        SDL_CondBroadcast( changed );
+        SDL_UnlockMutex( lock );
+    }
 
-}
+private:
+    SDL_mutex *lock;
+    SDL_cond *changed;
+    T slots[3];
+    int writing{ 0 }, ready{ 1 }, reading{ 2 };
+    bool fresh{ false };
+    bool closed{ false };
+};
 
-void solveBrickBallCollision( Brick& mBrick, Ball& mBall ) noexcept
+// Everything the game thread draws in a frame, recorded without touching
+// the renderer.  Once published the render thread only reads it, apart
+// from taking the shapes over.
+struct RenderList
 {
-    if (!isIntersecting( mBrick, mBall ))
-        return;
-
-    // Instead of immediately destroying the brick upon collision,
-    // we decrease and check its required hits first.
-    --mBrick.requiredHits;
-    if (mBrick.requiredHits <= 0)
-        mBrick.destroyed = true;
-
-    float overlapLeft{ mBall.right() - mBrick.left() };
-    float overlapRight{ mBrick.right() - mBall.left() };
-    float overlapTop{ mBall.bottom() - mBrick.top() };
-    float overlapBottom{ mBrick.bottom() - mBall.top() };
-
-    bool ballFromLeft( std::abs( overlapLeft ) < std::abs( overlapRight ) );
-    bool ballFromTop( std::abs( overlapTop ) < std::abs( overlapBottom ) );
-
-    float minOverlapX{ ballFromLeft ? overlapLeft : overlapRight };
-    float minOverlapY{ ballFromTop ? overlapTop : overlapBottom };
-
-    if (std::abs( minOverlapX ) < std::abs( minOverlapY ))
-        mBall.velocity.x =
-                ballFromLeft ? -Ball::defVelocity : Ball::defVelocity;
-    else
-        mBall.velocity.y = ballFromTop ? -Ball::defVelocity : Ball::defVelocity;
-
-    if (gHitBrick != nullptr)
-        Mix_PlayChannel( -1, gHitBrick, 0 );
-
-}
+    // Drawn from the text cache, so each string is rendered once
+    struct Text
+    {
+        TTF_Font *font;
+        char text[48];
+        int x, y;
+    };
 
+    // The input this frame was made from
+    unsigned inputSeq{ 0 };
+    // Nothing moves until there's more input
+    bool still{ false };
+    // The play field is shown, from the layer unless hasField
+    bool showField{ false };
+
+    // The bricks, only recorded when they changed or the render thread
+    // asked for them
+    bool hasField{ false };
+    ShapeBatch field;
+
+    ShapeBatch shapes;
+    // The debris, over the shapes
+    std::vector<SDL_Rect> debris;
+    std::vector<Text> texts;
+    // The lives left, -1 to leave them out
+    int lives{ -1 };
+
+    // The game thread's share of the frame times
+    Uint64 phases[FrameProfiler::PhaseCount]{};
+};
 
 class Game
 {
 private:
     // There now are two additional game states: `GameOver`
-    // and `Victory`.
+    // and `Victory`.  `Loading` shows progress until the assets are in.
     enum class State
     {
+        Loading,
         Paused,
         GameOver,
         InProgress,
         Victory
     };
 
+    // The built-in level, played when there's no level pack
     static constexpr int brkCountX{ 11 }, brkCountY{ 4 };
-    static constexpr int brkStartColumn{ 1 }, brkStartRow{ 2 };
-    static constexpr float brkSpacing{ 3.f }, brkOffsetX{ 22.f };
-
-    Manager manager;
+    // Room kept for balls in play at once
+    static constexpr int maxBalls{ 4 };
+
+    // The simulation always advances in steps of the same length however
+    // often frames are drawn.  A long stall is cut short rather than
+    // caught up all at once.
+    static constexpr double maxFrameSeconds{ 0.25 };
+
+    // Frame rate caps C steps through, 0 leaves the rate to vsync
+    static constexpr int fpsCaps[]{ 0, 30, 60, 90, 120 };
+
+    // Workers for the game's own jobs and those of the mixer and SDL_ttf,
+    // -1 for one less than the number of CPUs
+    static constexpr int jobWorkers{ -1 };
+
+    Simulation sim;
+    JobSystem jobSystem;
+    AssetLoader loader{ jobSystem };
+    TouchInput touch;
+    FrameProfiler profiler;
+    bool showProfiler{ false };
+    bool profilerPressedLastFrame{ false };
+    FramePacer pacer;
+    // The scene drops below the display's resolution when frames run late
+    RenderScale renderScale{ gScreenRect.w, gScreenRect.h };
+    // When the last frame was presented, 0 before the first
+    Uint64 lastPresent{ 0 };
+    // Lowers the quality of sound, particles and the scene when the device
+    // heats up, runs low on battery or keeps missing frames.  A replay
+    // stays at full quality, so its runs do the same work.
+    QualityGovernor quality;
+    int fpsCap{ 0 };
+    bool capPressedLastFrame{ false };
+    ShapeBatch shapes;
+    // Draws the render queue's flushes when the renderer is OpenGL ES 2
+    SpriteBatch spriteBatch;
     SDL_Window *window = nullptr;
     SDL_Renderer *renderer = nullptr;
     TTF_Font *font15 = nullptr;
     TTF_Font *font35 = nullptr;
-    SDL_Texture *textState = nullptr;
-    SDL_Texture *textLives = nullptr;
+    TTF_TextCache *textCache = nullptr;
+    // Kept as a surface too, the renderer can lose it in the background
+    RetainedTexture textLives;
+
+    // Layers of the render queue, each drawn over the ones before it
+    enum Layer
+    {
+        FieldLayer,
+        ShapeLayer,
+        TextLayer
+    };
+    RenderQueue queue;
+
+    // The bricks and the screen outline, redrawn only when a brick changes
+    SDL_Texture *fieldLayer = nullptr;
+    // The lives textLives shows
+    int livesShown{ 3 };
 
-    State state{ State::GameOver };
+    // What the render thread gathered for the game thread, taken under
+    // inputLock.  The game thread keeps its own copy to read from.
+    struct PostedInput
+    {
+        Uint8 keys[SDL_NUM_SCANCODES];
+        SDL_Point touch;
+        bool tap;
+        // The field layer lost its contents and needs the bricks again
+        bool redrawField;
+        // The app went into the background, so the game pauses
+        bool backgrounded;
+        // The most particles the quality level allows
+        std::size_t particleLimit{ ParticleEmitter::maxParticles };
+        unsigned seq;
+    };
+    SDL_mutex *inputLock = nullptr;
+    PostedInput posted{};
+    PostedInput gameInput{};
+
+    // The game thread advances the game and records frames into these for
+    // the render thread, see gameFrame()
+    SDL_Thread *gameThread = nullptr;
+    TripleBuffer<RenderList> frames;
+    FrameProfiler gameProfiler;
+    Uint64 lastCounter{ 0 };
+
+    // Records the game thread's input, or plays a recording back in place
+    // of the device's, see takeInput()
+    InputLog inputLog;
+    // Whether this run is a replay, for the render thread which doesn't
+    // wait for input that comes from the recording
+    bool replayRun{ false };
+    Uint64 replayStart{ 0 };
+    unsigned fieldRevision{ 0 };
+
+    State state{ State::Loading };
     bool pausePressedLastFrame{ false };
 
     // Let's keep track of the remaning lives in the game class.
     int remainingLives{ 0 };
 
+    // The asset pack, and the levels when they're not in it, mapped for as
+    // long as the game runs.  The fonts and the music read from the pack
+    // until they're closed.
+    AssetBuffer packData;
+    AssetPack assets;
+    AssetBuffer levelData;
+    LevelPack levels;
+    std::size_t level{ 0 };
+
+    // Simulated time not yet covered by a whole step
+    double accumulator{ 0.0 };
+    // Whether the last frame stepped the simulation.  The first frame after
+    // a pause may have slept waiting for the tap, so it adds no time.
+    bool simulating{ false };
+
+    void drawFieldShapes( ShapeBatch& field, SDL_BlendMode blend )
+    {
+        shapes.take( field );
+        shapes.flush( renderer, queue, FieldLayer, blend );
+
+        // draw screen outline
+        SDL_Color blue = { 0, 0, 255, 255 };
+        queue.drawLine( FieldLayer, 0,0, 0,gScreenRect.h, blue, blend );
+        queue.drawLine( FieldLayer, 0,0, gScreenRect.w-2,0, blue, blend );
+        queue.drawLine( FieldLayer, gScreenRect.w-2,0, gScreenRect.w-2,gScreenRect.h, blue, blend );
+    }
+
+    // Composite the field with one copy, redrawing the layer first if the
+    // frame brought the bricks along
+    void drawField( RenderList& frame )
+    {
+        if (fieldLayer == nullptr)
+        {
+            drawFieldShapes( frame.field, SDL_BLENDMODE_BLEND );
+            return;
+        }
+
+        if (frame.hasField)
+        {
+            // Bricks never overlap, so they are written to the layer as
+            // they are and blended once when it is copied to the screen
+            SDL_SetRenderTarget( renderer, fieldLayer );
+            SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_NONE );
+            SDL_SetRenderDrawColor( renderer, 0, 0, 0, 0 );
+            SDL_RenderClear( renderer );
+            drawFieldShapes( frame.field, SDL_BLENDMODE_NONE );
+            queue.flush( renderer );
+            SDL_SetRenderDrawBlendMode( renderer, SDL_BLENDMODE_BLEND );
+            renderScale.bind( renderer );
+        }
+        renderTexture( fieldLayer, queue, FieldLayer, gScreenRect );
+    }
+
+    // Without render targets the field is drawn straight to the screen
+    void createFieldLayer()
+    {
+        if (!SDL_RenderTargetSupported( renderer ))
+            return;
+        fieldLayer = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                        gScreenRect.w, gScreenRect.h );
+        if (fieldLayer == nullptr)
+            logSDLError( std::cerr, "CreateTexture" );
+        else
+            SDL_SetTextureBlendMode( fieldLayer, SDL_BLENDMODE_BLEND );
+    }
+
+    // After the renderer lost its textures.  What has a copy in memory is
+    // uploaded again as it's drawn, the field layer is made over empty and
+    // the glyphs go back in the atlas from the fonts' caches.
+    void releaseTextures()
+    {
+        textLives.release();
+        TTF_ReleaseTextCacheTextures( textCache );
+        TTF_ClearFontAtlas( font15 );
+        shapes.releaseSprites();
+        spriteBatch.release();
+        renderScale.create( renderer );
+        if (fieldLayer != nullptr)
+        {
+            SDL_DestroyTexture( fieldLayer );
+            fieldLayer = nullptr;
+            createFieldLayer();
+        }
+    }
+
+    // Sees the app go into the background and come back as it happens,
+    // on the thread that tells SDL, rather than when the events are polled
+    // after the app is back.  The mixer keeps its device and every sound,
+    // it only stops and starts the output.
+    static int SDLCALL lifecycleWatch( void *data, SDL_Event *e )
+    {
+        Game *game = static_cast<Game*>(data);
+        if (e->type == SDL_APP_WILLENTERBACKGROUND)
+        {
+            Mix_PauseOutput( 1 );
+            SDL_LockMutex( game->inputLock );
+            game->posted.backgrounded = true;
+            SDL_UnlockMutex( game->inputLock );
+        }
+        else if (e->type == SDL_APP_DIDENTERFOREGROUND)
+            Mix_PauseOutput( 0 );
+        return 1;
+    }
+
+    void startLoading()
+    {
+        queueMedia( loader, assets );
+
+        //Open the fonts, the error is only set on the thread that failed
+        auto openFont = [this]( int size ) -> std::function<void*()>
+        {
+            return [this, size]() -> void*
+            {
+                TTF_Font *font = TTF_OpenFontRW( assets.stream( "calibri.ttf" ), 1, size );
+                if (font == nullptr)
+                    logSDLError( std::cerr, "TTF_OpenFont" );
+                return font;
+            };
+        };
+        int font15Job = loader.add( openFont( 15 ), [this]( void *font ) { font15 = static_cast<TTF_Font*>(font); } );
+        loader.add( openFont( 35 ), [this]( void *font ) { font35 = static_cast<TTF_Font*>(font); } );
+
+        // Rendering the text needs its font, making a texture of it needs
+        // the render thread
+        loader.add( [this, font15Job]() -> void*
+                    {
+                        SDL_Color white = { 255, 255, 255, 255 };
+                        TTF_Font *font = static_cast<TTF_Font*>(loader.result( font15Job ));
+                        SDL_Surface *surf = TTF_RenderText_Blended( font, "Lives: 3", white );
+                        if (surf == nullptr)
+                            logSDLError( std::cerr, "TTF_RenderText" );
+                        return surf;
+                    },
+                    [this]( void *surf )
+                    {
+                        textLives.reset( static_cast<SDL_Surface*>(surf) );
+                    },
+                    { font15Job } );
+
+        loader.start();
+    }
+
+    // A bar across the middle of the screen, drawn without any of the
+    // assets still being loaded
+    void drawLoading()
+    {
+        SDL_Rect frame{ gScreenRect.w / 4, gScreenRect.h / 2 - 10, gScreenRect.w / 2, 20 };
+        SDL_Rect bar{ frame.x + 2, frame.y + 2, (int)((frame.w - 4) * loader.progress()), frame.h - 4 };
+
+        queue.drawRect( ShapeLayer, frame, SDL_Color{ 0, 0, 255, 255 } );
+        queue.fillRect( ShapeLayer, bar, SDL_Color{ 255, 255, 0, 255 } );
+        queue.flush( renderer );
+    }
+
+    // Everything is in, returns false if the game can't go on without
+    // what failed
+    bool finishLoading()
+    {
+        if (font15 == nullptr || font35 == nullptr || !textLives)
+            return false;
+
+        //Play the music
+        Mix_PlayMusic( gMusic, -1 );
+
+        state = State::GameOver;
+        return true;
+    }
+
 public:
 
     Game()
     {
     }
 
+    // Before run(), writes the input of every frame to `path`, or plays
+    // the frames recorded there instead of the device's input.  False
+    // with the SDL error set if the file can't be opened.
+    bool recordInput( const char *path ) { return inputLog.record( path ); }
+    bool replayInput( const char *path )
+    {
+        replayRun = inputLog.replay( path );
+        return replayRun;
+    }
+
     // returns -1 on error
     int init()
     {
@@ -565,6 +1237,7 @@ public:
             logSDLError( std::cerr, "SDL_Init" );
             return -1;
         }
+        jobSystem.start( jobWorkers );
 
         // init TTF system
         if (TTF_Init() != 0)
@@ -573,20 +1246,27 @@ public:
             SDL_Quit();
             return -1;
         }
+        // Long wrapped text is composited on the fast cores, a frame waits for it
+        TTF_SetJobHandler( JobSystem::submitC<JobSystem::Affinity::Big>, &jobSystem );
 
         // init audio system
-        //Initialize SDL_mixer
-        if( Mix_OpenAudio( 44100, MIX_DEFAULT_FORMAT, 2, 2048 ) < 0 )
+        //Initialize SDL_mixer, on the device's own low latency output when
+        //there is one and through SDL's audio device otherwise.  Float
+        //output spares the mixer converting what it mixed.
+        //The chunk size is left to the mixer to fit the device's burst.
+        if( Mix_OpenAudioNative( 44100, AUDIO_F32SYS, 2, 0 ) < 0 &&
+            Mix_OpenAudio( 0, MIX_DEFAULT_FORMAT, 2, 0 ) < 0 )
         {
             std::string msg = std::string("SDL_mixer could not initialize! SDL_mixer Error") + Mix_GetError();
             logSDLError( std::cerr, msg);
             return -1;
         }
-
-        if (loadMedia() == false)
-        {
-        //    return -1;
-        }
+        //Keep the mixing from being preempted by the game and render threads
+        Mix_SetAudioThreadPolicy( MIX_THREAD_REALTIME, 0 );
+        //Stop the output whenever nothing has played for a second
+        Mix_SetAutoSuspend( 1000 );
+        //Decode the sounds on the job system rather than the mixer's own threads
+        Mix_SetJobHandler( JobSystem::submitC<JobSystem::Affinity::Any>, &jobSystem );
 
         // Create window
         window = SDL_CreateWindow( "ARKANOID", SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED,
@@ -617,19 +1297,25 @@ public:
         }
         SDL_RenderSetLogicalSize(renderer, gScreenRect.w, gScreenRect.h);
 
-        //Open the font
-        font15 = TTF_OpenFont( "calibri.ttf", 15 );
-        font35 = TTF_OpenFont( "calibri.ttf", 35 );
-        if (font15 == nullptr || font35 == nullptr)
-        {
-            logSDLError( std::cerr, "TTF_OpenFont" );
-            return -1;
-        }
+        // Now that there's a display to read the refresh rate from
+        pacer.setTargetFps( fpsCaps[fpsCap] );
+        renderScale.setBudget( pacer.budgetSeconds() );
+        renderScale.create( renderer );
+        quality.setBudget( pacer.budgetSeconds() );
+        quality.start();
 
-        SDL_Color white = { 255, 255, 255, 255 };
-        textState = createText( "Paused", font35, white, renderer );
-        textLives = createText( "Lives: 3", font15, white, renderer );
-        if (textState == nullptr || textLives == nullptr)
+        if (spriteBatch.attach( renderer ))
+            queue.setBatch( &spriteBatch );
+
+        // Move the paddle half a frame ahead of the finger
+        touch.setPrediction( 8 );
+
+        createFieldLayer();
+
+        // The state messages never change, so each is rendered only once,
+        // and kept to upload again if the renderer loses its textures
+        textCache = TTF_CreateTextCache( renderer, 8 );
+        if (textCache == nullptr)
         {
             SDL_DestroyRenderer( renderer );
             SDL_DestroyWindow( window );
@@ -637,10 +1323,35 @@ public:
             SDL_Quit();
             return -1;
         }
+        TTF_SetTextCacheRetain( textCache, 1 );
 
-        //Play the music
-        Mix_PlayMusic( gMusic, -1 );
+        inputLock = SDL_CreateMutex();
+        SDL_AddEventWatch( lifecycleWatch, this );
+
+        // Without the pack every asset is opened on its own, which is how
+        // the game ships unless packassets made one, so only a pack that's
+        // there but broken is worth a word
+        if (packData.open( "assets.pak" ))
+        {
+            if (!assets.open( packData.data(), packData.size() ))
+                logSDLError( std::cerr, "assets.pak" );
+        }
+        else if (!packData.missing())
+            logSDLError( std::cerr, "assets.pak" );
 
+        // Without the levels there's still the built-in one
+        std::size_t levelSize{ 0 };
+        const void *levelBytes{ assets.find( "levels.ark", levelSize ) };
+        if (levelBytes == nullptr && levelData.open( "levels.ark" ))
+        {
+            levelBytes = levelData.data();
+            levelSize = levelData.size();
+        }
+        if (levelBytes == nullptr || !levels.open( levelBytes, levelSize ))
+            logSDLError( std::cerr, "levels.ark" );
+
+        // The first frames show the loading screen while these come in
+        startLoading();
 
         __android_log_print(ANDROID_LOG_INFO, "MOOSE", "%s", "GAME INIT END");
 
@@ -653,172 +1364,529 @@ public:
         remainingLives = 3;
 
         state = State::Paused;
-        manager.clear();
+        sim.reset();
+
+        // Only the first level allocates, every restart after it fills the
+        // same storage.  The balls' pool comes first so they update first.
+        sim.manager.reserve<Ball>( maxBalls );
+        sim.manager.reserve<Paddle>( 1 );
+        sim.bricks.reserve( brkCountX * brkCountY );
+        sim.debris.reserve( ParticleEmitter::maxParticles );
+
+        if (!sim.loadLevel( levels, level ))
+            for (int iX{ 0 }; iX < brkCountX; ++iX)
+                for (int iY{ 0 }; iY < brkCountY; ++iY)
+                {
+                    // Let's set the required hits for the bricks.
+                    sim.addBrick( LevelPack::columnX( iX ), LevelPack::rowY( iY ),
+                                  Brick::defWidth, Brick::defHeight, 1 + ((iX * iY) % 3) );
+                }
+
+        sim.manager.create<Ball>( gScreenRect.w / 2.f, gScreenRect.h / 2.f );
+        sim.manager.create<Paddle>( gScreenRect.w / 2.f, gScreenRect.h - 50.0f );
+    }
+
+    // Advance the game by one fixed step, returns true if a life was lost
+    bool step()
+    {
+        bool lostLife = false;
+        // If there are no more balls on the screen, spawn a
+        // new one and remove a life.
+        if (sim.manager.getAll<Ball>().empty())
+        {
+            sim.manager.create<Ball>( gScreenRect.w / 2.f, gScreenRect.h / 2.f );
+            lostLife = true;
+            --remainingLives;
+        }
+
+        sim.bricks.update();
+
+        // If there are no more bricks on the screen,
+        // the player won!
+        if (sim.bricks.remaining() == 0)
+            state = State::Victory;
+
+        // If the player has no more remaining lives,
+        // it's game over!
+        if (remainingLives <= 0)
+            state = State::GameOver;
+
+        {
+            FrameProfiler::Scope timing( gameProfiler, FrameProfiler::Update );
+            sim.update();
+        }
+
+        {
+            FrameProfiler::Scope timing( gameProfiler, FrameProfiler::Collisions );
+            sim.collide();
+        }
+
+        {
+            FrameProfiler::Scope timing( gameProfiler, FrameProfiler::Refresh );
+            sim.refresh();
+        }
+
+        return lostLife;
+    }
+
+    // Hand the input gathered this frame to the game thread, returns its
+    // number
+    unsigned postInput( bool redrawField )
+    {
+        const Uint8 *keys = SDL_GetKeyboardState( NULL );
+        SDL_LockMutex( inputLock );
+        SDL_memcpy( posted.keys, keys, sizeof(posted.keys) );
+        posted.touch = touch.position( SDL_GetTicks() );
+        // A tap or a lost layer is kept until the game thread has seen it
+        posted.tap = posted.tap || touch.tapped();
+        posted.redrawField = posted.redrawField || redrawField;
+        posted.particleLimit = quality.particleLimit();
+        unsigned seq{ ++posted.seq };
+        SDL_UnlockMutex( inputLock );
+        return seq;
+    }
+
+    // The game reads the input last posted through the globals.  A replay
+    // puts the recorded input and frame length in place of what the device
+    // gave, a recording keeps them, in the length the log can hold.
+    void takeInput( double& frameSeconds )
+    {
+        SDL_LockMutex( inputLock );
+        gameInput = posted;
+        posted.tap = false;
+        posted.redrawField = false;
+        posted.backgrounded = false;
+        SDL_UnlockMutex( inputLock );
+
+        if (inputLog.replaying())
+            playBackInput( frameSeconds );
+        else if (inputLog.recording())
+        {
+            frameSeconds = InputLog::quantize( frameSeconds );
+            inputLog.write( recordedInput( frameSeconds ) );
+        }
+
+        gCurrentKeyStates = gameInput.keys;
+        gTouchLocation = gameInput.touch;
+        gTouchTap = gameInput.tap;
+        sim.debris.setLimit( gameInput.particleLimit );
+    }
 
-        for (int iX{ 0 }; iX < brkCountX; ++iX)
-            for (int iY{ 0 }; iY < brkCountY; ++iY)
+    InputLog::Frame recordedInput( double frameSeconds ) const
+    {
+        Uint8 buttons{ 0 };
+        if (gameInput.tap)
+            buttons |= InputLog::Tap;
+        if (gameInput.keys[SDL_SCANCODE_P])
+            buttons |= InputLog::Pause;
+        if (gameInput.keys[SDL_SCANCODE_R])
+            buttons |= InputLog::Restart;
+        if (gameInput.keys[SDL_SCANCODE_LEFT])
+            buttons |= InputLog::Left;
+        if (gameInput.keys[SDL_SCANCODE_RIGHT])
+            buttons |= InputLog::Right;
+        if (gameInput.backgrounded)
+            buttons |= InputLog::Backgrounded;
+        return InputLog::Frame{ frameSeconds, gameInput.touch, buttons };
+    }
+
+    void playBackInput( double& frameSeconds )
+    {
+        if (replayStart == 0)
+            replayStart = SDL_GetPerformanceCounter();
+
+        InputLog::Frame frame;
+        if (!inputLog.read( frame ))
+        {
+            double seconds( (double)(SDL_GetPerformanceCounter() - replayStart) / SDL_GetPerformanceFrequency() );
+            SDL_Log( "Replayed %u frames in %.3f seconds\n", inputLog.frameCount(), seconds );
+            inputLog.close();
+            // The run is over, as far as a benchmark is concerned
+            SDL_Event quit{};
+            quit.type = SDL_QUIT;
+            SDL_PushEvent( &quit );
+            return;
+        }
+
+        // Only the redrawn field is the device's own, it's about its textures
+        SDL_memset( gameInput.keys, 0, sizeof(gameInput.keys) );
+        gameInput.keys[SDL_SCANCODE_P] = (frame.buttons & InputLog::Pause) != 0;
+        gameInput.keys[SDL_SCANCODE_R] = (frame.buttons & InputLog::Restart) != 0;
+        gameInput.keys[SDL_SCANCODE_LEFT] = (frame.buttons & InputLog::Left) != 0;
+        gameInput.keys[SDL_SCANCODE_RIGHT] = (frame.buttons & InputLog::Right) != 0;
+        gameInput.touch = frame.touch;
+        gameInput.tap = (frame.buttons & InputLog::Tap) != 0;
+        gameInput.backgrounded = (frame.buttons & InputLog::Backgrounded) != 0;
+        frameSeconds = frame.seconds;
+    }
+
+    // One frame of the game thread: take the latest input, advance the
+    // game by the time since the last frame and record how it looks
+    void gameFrame( RenderList& list )
+    {
+        Uint64 counter = SDL_GetPerformanceCounter();
+        double frameSeconds = (double)(counter - lastCounter) / SDL_GetPerformanceFrequency();
+        lastCounter = counter;
+
+        gameProfiler.beginFrame();
+        takeInput( frameSeconds );
+        list.inputSeq = gameInput.seq;
+
+        // Coming back to the game doesn't cost the ball that was in play
+        if (gameInput.backgrounded && state == State::InProgress)
+            state = State::Paused;
+
+        if (gCurrentKeyStates[SDL_SCANCODE_P] || gTouchTap)
+        {
+            if (!pausePressedLastFrame)
             {
-                float x{ (iX + brkStartColumn) * (Brick::defWidth + brkSpacing) };
-                float y{ (iY + brkStartRow) * (Brick::defHeight + brkSpacing) };
+                if (state == State::Paused)
+                    state = State::InProgress;
+#if 0
+                else if (state == State::InProgress)
+                    state = State::Paused;
+#endif
+            }
+            pausePressedLastFrame = true;
+        }
+        else
+            pausePressedLastFrame = false;
 
-                auto& brick( manager.create<Brick>( brkOffsetX + x, y ) );
+        if (gCurrentKeyStates[SDL_SCANCODE_R] || (state == State::GameOver && gTouchTap))
+            restart();
+        // After the last level the first comes round again
+        else if (state == State::Victory && gTouchTap)
+        {
+            level = levels.count() > 0 ? (level + 1) % levels.count() : 0;
+            restart();
+        }
 
-                // Let's set the required hits for the bricks.
-                brick.requiredHits = 1 + ((iX * iY) % 3);
+        list.texts.clear();
+        list.lives = -1;
+
+        // If the game is not in progress, do not update game elements
+        // and display information to the player.
+        if (state != State::InProgress)
+        {
+            const char *temp = "";
+            if (state == State::Paused)
+                temp = "Paused - Tap to Resume";
+            else if (state == State::GameOver)
+                temp = "Game over! - Tap to Play Again";
+            else if (state == State::Victory)
+                temp = "You won! - Tap for the Next Level";
+
+            list.texts.emplace_back( RenderList::Text{ font35, "", 10, 10 } );
+            SDL_strlcpy( list.texts.back().text, temp, sizeof(list.texts.back().text) );
+
+            // Time spent paused is not simulated afterwards
+            accumulator = 0.0;
+            simulating = false;
+        }
+        else
+        {
+            // Run as many whole steps as the time since the last frame
+            // covers, then draw that far between the last two of them
+            double stepSeconds{ sim.stepLength() };
+            if (simulating)
+                accumulator += std::min( frameSeconds, maxFrameSeconds );
+            simulating = true;
+            while (accumulator >= stepSeconds && state == State::InProgress)
+            {
+                step();
+                accumulator -= stepSeconds;
+            }
+        }
+
+        // However many steps hit something, each sound starts once a frame
+        gSounds.flush();
+
+        // The frame that ended the game still shows the field
+        list.showField = simulating;
+        list.still = !simulating;
+        list.hasField = false;
+        list.debris.clear();
+        if (list.showField)
+        {
+            FrameProfiler::Scope timing( gameProfiler, FrameProfiler::Draw );
+
+            // The layer keeps the bricks, they're only sent when they change
+            if (fieldLayer == nullptr || gameInput.redrawField || fieldRevision != Brick::revision)
+            {
+                sim.bricks.draw( list.field );
+                list.hasField = true;
+                fieldRevision = Brick::revision;
             }
 
-        manager.create<Ball>( gScreenRect.w / 2.f, gScreenRect.h / 2.f );
-        manager.create<Paddle>( gScreenRect.w / 2.f, gScreenRect.h - 50.0f );
+            float alpha( accumulator / sim.stepLength() );
+            sim.manager.draw<Paddle>( list.shapes, alpha );
+            sim.manager.draw<Ball>( list.shapes, alpha );
+            sim.debris.draw( list.debris, alpha );
+            list.lives = remainingLives;
+        }
+
+        for (int phase{ 0 }; phase < FrameProfiler::PhaseCount; ++phase)
+            list.phases[phase] = gameProfiler.elapsed( (FrameProfiler::Phase)phase );
     }
 
-    void run()
+    static int SDLCALL gameMain( void *data )
+    {
+        Game *game = static_cast<Game*>(data);
+        do
+            game->gameFrame( game->frames.back() );
+        while (game->frames.publish());
+        return 0;
+    }
+
+    // Draw a frame the game thread recorded
+    void drawFrame( RenderList& frame )
     {
         SDL_Color white = { 255, 255, 255, 255 };
+
+        if (frame.showField)
+            drawField( frame );
+        shapes.take( frame.shapes );
+        shapes.flush( renderer, queue, ShapeLayer );
+        // However many particles there are, they're one draw
+        queue.fillRects( ShapeLayer, frame.debris.data(), (int)frame.debris.size(),
+                         sim.debris.getColor() );
+
+        if (frame.lives >= 0)
+        {
+            // Update lives string and draw it.
+            if (frame.lives != livesShown)
+            {
+                std::string temp("Lives: " + std::to_string(frame.lives));
+                SDL_Surface *surf = TTF_RenderText_Blended( font15, temp.c_str(), white );
+                if (surf == nullptr)
+                    logSDLError( std::cerr, "TTF_RenderText" );
+                textLives.reset( surf );
+                livesShown = frame.lives;
+            }
+            SDL_Texture *texture = textLives.get( renderer );
+            if (texture != nullptr)
+                renderTexture( texture, queue, TextLayer, 10, 10 );
+        }
+
+        for (auto& text : frame.texts)
+        {
+            SDL_Texture *texture = TTF_CachedUTF8_Texture( textCache, text.font, text.text, white );
+            if (texture != nullptr)
+                renderTexture( texture, queue, TextLayer, text.x, text.y );
+        }
+        queue.flush( renderer );
+    }
+
+    // The loading screen, shown before the game thread starts.  Returns
+    // false if the game should quit rather than start.
+    bool runLoading()
+    {
         SDL_Event e;
-        bool quit = false;
-        while (!quit)
+        while (state == State::Loading)
         {
-            gTouchTap = false;
-            while (SDL_PollEvent( &e ))
+            profiler.beginFrame();
             {
-                //If user closes the window, presses escape
-                if (e.type == SDL_QUIT ||
-                    (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Events );
+                while (pacer.pollEvent( e ))
                 {
-                    quit = true;
+                    if (e.type == SDL_QUIT ||
+                        (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+                        return false;
                 }
+            }
 
-                    //Touch down
-                else if( e.type == SDL_FINGERDOWN )
-                {
-                    gTouchLocation.x = e.tfinger.x * gScreenRect.w;
-                    gTouchLocation.y = e.tfinger.y * gScreenRect.h;
-                    gTouchTap = true;
-                }
-                    //Touch motion
-                else if( e.type == SDL_FINGERMOTION )
-                {
-                    gTouchLocation.x = e.tfinger.x * gScreenRect.w;
-                    gTouchLocation.y = e.tfinger.y * gScreenRect.h;
-                }
-                    //Touch release
-                else if( e.type == SDL_FINGERUP )
-                {
-                    gTouchLocation.x = e.tfinger.x * gScreenRect.w;
-                    gTouchLocation.y = e.tfinger.y * gScreenRect.h;
-                }
+            // Pick up the assets loaded since the last frame, the game
+            // can't start without the fonts
+            if (loader.poll() && !finishLoading())
+                return false;
+
+            {
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Draw );
+                SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+                SDL_RenderClear( renderer );
+                drawLoading();
+            }
+            {
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Present );
+                SDL_RenderPresent( renderer );
             }
+            profiler.endFrame();
+            pacer.endFrame();
+        }
+        return true;
+    }
 
-            // key state
-            gCurrentKeyStates = SDL_GetKeyboardState( NULL );
+    // Events and drawing stay on this thread, which made the renderer,
+    // while the game thread simulates the next frame.  Without a game
+    // thread each frame is made here just before it's drawn.
+    void run()
+    {
+        SDL_Event e;
+        bool quit = !runLoading();
+        // Whether the last frame waits for input before anything moves
+        bool waitForInput = false;
 
-            /* Select the color for drawing. */
-            SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
-            //First clear the renderer with the draw color
-            SDL_RenderClear( renderer );
+        if (!quit)
+        {
+            lastCounter = SDL_GetPerformanceCounter();
+            gameThread = SDL_CreateThread( gameMain, "game", this );
+            if (gameThread == nullptr)
+                logSDLError( std::cerr, "CreateThread" );
+        }
 
-            if (gCurrentKeyStates[SDL_SCANCODE_ESCAPE])
-                break;
+        while (!quit)
+        {
+            bool redrawField = false;
+            unsigned inputSeq;
 
-            if (gCurrentKeyStates[SDL_SCANCODE_P] || gTouchTap)
+            profiler.beginFrame();
             {
-                if (!pausePressedLastFrame)
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Events );
+                touch.beginFrame();
+                while (pacer.pollEvent( e ))
                 {
-                    if (state == State::Paused)
-                        state = State::InProgress;
-#if 0
-                    else if (state == State::InProgress)
-                        state = State::Paused;
-#endif
+                    //If user closes the window, presses escape
+                    if (e.type == SDL_QUIT ||
+                        (e.type == SDL_KEYDOWN && e.key.keysym.sym == SDLK_ESCAPE))
+                    {
+                        quit = true;
+                    }
+
+                        //Touch down, motion and release
+                    else if( e.type == SDL_FINGERDOWN || e.type == SDL_FINGERMOTION ||
+                             e.type == SDL_FINGERUP )
+                    {
+                        touch.handle( e );
+                    }
+                        //The field layer's contents are gone
+                    else if( e.type == SDL_RENDER_TARGETS_RESET || e.type == SDL_RENDER_DEVICE_RESET )
+                    {
+                        redrawField = true;
+                        //So is every texture, the GL context went with the app
+                        if (e.type == SDL_RENDER_DEVICE_RESET)
+                            releaseTextures();
+                    }
+                        //The scene's target has to match the new size
+                    else if( e.type == SDL_WINDOWEVENT && e.window.event == SDL_WINDOWEVENT_SIZE_CHANGED )
+                    {
+                        renderScale.create( renderer );
+                    }
                 }
-                pausePressedLastFrame = true;
+
+                // Where the finger is by the time this frame is shown
+                touch.endFrame();
+                inputSeq = postInput( redrawField );
             }
-            else
-                pausePressedLastFrame = false;
+            if (quit)
+                break;
 
-            if (gCurrentKeyStates[SDL_SCANCODE_R] ||
-                    (state == State::GameOver && gTouchTap) )
-                restart();
+            // key state
+            const Uint8 *keys = SDL_GetKeyboardState( NULL );
+            if (keys[SDL_SCANCODE_ESCAPE])
+                break;
 
-            // If the game is not in progress, do not draw or update
-            // game elements and display information to the player.
-            if (state != State::InProgress)
+            // F shows or hides the frame times
+            if (keys[SDL_SCANCODE_F])
             {
-                std::string temp;
-                if (state == State::Paused)
-                    temp = "Paused - Tap to Resume";
-                else if (state == State::GameOver)
-                    temp = "Game over! - Tap to Play Again";
-                else if (state == State::Victory)
-                    temp = "You won!";
-
-                SDL_DestroyTexture(textState);
-                textState = createText(temp, font35, white, renderer);
-                renderTexture( textState, renderer, 10, 10 );
+                if (!profilerPressedLastFrame)
+                    showProfiler = !showProfiler;
+                profilerPressedLastFrame = true;
             }
             else
+                profilerPressedLastFrame = false;
+
+            // C steps through the frame rate caps
+            if (keys[SDL_SCANCODE_C])
             {
-                bool updateLives = false;
-                // If there are no more balls on the screen, spawn a
-                // new one and remove a life.
-                if (manager.getAll<Ball>().empty())
+                if (!capPressedLastFrame)
                 {
-                    manager.create<Ball>( gScreenRect.w / 2.f, gScreenRect.h / 2.f );
-                    updateLives = true;
-                    --remainingLives;
+                    fpsCap = (fpsCap + 1) % (int)SDL_arraysize( fpsCaps );
+                    pacer.setTargetFps( fpsCaps[fpsCap] );
+                    renderScale.setBudget( pacer.budgetSeconds() );
+                    quality.setBudget( pacer.budgetSeconds() );
+                    SDL_Log( "Frame rate cap %d\n", fpsCaps[fpsCap] );
                 }
+                capPressedLastFrame = true;
+            }
+            else
+                capPressedLastFrame = false;
 
-                // If there are no more bricks on the screen,
-                // the player won!
-                if (manager.getAll<Brick>().empty())
-                    state = State::Victory;
+            if (gameThread == nullptr)
+            {
+                gameFrame( frames.back() );
+                frames.publish();
+            }
 
-                // If the player has no more remaining lives,
-                // it's game over!
-                if (remainingLives <= 0)
-                    state = State::GameOver;
+            // After waiting for input the frame has to show what it did,
+            // not one the game thread made before it came
+            RenderList *frame = frames.acquire();
+            while (waitForInput && frame != nullptr && frame->inputSeq != inputSeq)
+                frame = frames.acquire();
+            if (frame == nullptr)
+                break;
 
-                manager.update();
+            for (int phase{ 0 }; phase < FrameProfiler::PhaseCount; ++phase)
+                profiler.add( (FrameProfiler::Phase)phase, frame->phases[phase] );
 
-                manager.forEach<Ball>( [this]( auto& mBall )
-                                       {
-                                           manager.forEach<Brick>( [&mBall]( auto& mBrick )
-                                                                   {
-                                                                       solveBrickBallCollision( mBrick, mBall );
-                                                                   } );
-                                           manager.forEach<Paddle>( [&mBall]( auto& mPaddle )
-                                                                    {
-                                                                        solvePaddleBallCollision( mPaddle, mBall );
-                                                                    } );
-                                       } );
+            {
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Draw );
+                renderScale.bind( renderer );
+                /* Select the color for drawing. */
+                SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+                //First clear the renderer with the draw color
+                SDL_RenderClear( renderer );
+                drawFrame( *frame );
+                renderScale.resolve( renderer );
+            }
 
-                manager.refresh();
+            // Drawn outside the phases it measures
+            if (showProfiler && font15 != nullptr)
+                profiler.drawOverlay( renderer, font15 );
 
-                manager.draw( renderer );
+            //Update the screen
+            {
+                FrameProfiler::Scope timing( profiler, FrameProfiler::Present );
+                SDL_RenderPresent( renderer );
+            }
+            profiler.endFrame();
 
-                // Update lives string and draw it.
-                if (updateLives)
+            // Only a frame that didn't wait for input says how long drawing takes
+            Uint64 presented{ SDL_GetPerformanceCounter() };
+            if (lastPresent != 0 && !waitForInput)
+            {
+                double seconds( (double)(presented - lastPresent) / SDL_GetPerformanceFrequency() );
+                renderScale.frameTime( seconds );
+                if (!replayRun)
                 {
-                    std::string temp("Lives: " + std::to_string(remainingLives));
-                    SDL_DestroyTexture(textLives);
-                    textLives = createText(temp, font15, white, renderer);
+                    int level( quality.level() );
+                    quality.frameTime( seconds );
+                    if (quality.level() != level)
+                        renderScale.limitScale( quality.maxRenderScale() );
                 }
-                renderTexture( textLives, renderer, 10, 10 );
-
-                // draw screen outline
-                SDL_SetRenderDrawColor( renderer, 0, 0, 255, 255 );
-                SDL_RenderDrawLine( renderer, 0,0, 0,gScreenRect.h);
-                SDL_RenderDrawLine( renderer, 0,0, gScreenRect.w-2,0);
-                SDL_RenderDrawLine( renderer, gScreenRect.w-2,0, gScreenRect.w-2,gScreenRect.h);
             }
+            lastPresent = presented;
 
-            //Update the screen
-            SDL_RenderPresent( renderer );
+            // A screen that only changes on input waits for it before the
+            // next frame, unless the frame times are up and still counting
+            waitForInput = frame->still && !showProfiler && !replayRun;
+            pacer.setIdle( waitForInput );
+            pacer.endFrame();
         }
 
+        // The game thread goes before what it uses is freed
+        frames.close();
+        if (gameThread != nullptr)
+            SDL_WaitThread( gameThread, nullptr );
+        inputLog.close();
 
         // cleanup
 
+        //Whatever is still loading is waited for, so it's freed below
+        loader.wait();
+        Mix_SetJobHandler( nullptr, nullptr );
+        TTF_SetJobHandler( nullptr, nullptr );
+        jobSystem.stop();
+
         //Free the sound effects
         Mix_FreeChunk( gHitBrick );
         Mix_FreeChunk( gHitPaddle );
@@ -827,10 +1895,19 @@ public:
         //Free the music
         Mix_FreeMusic( gMusic );
 
+        shapes.destroySprites();
+        spriteBatch.destroy();
+        renderScale.destroy();
+        quality.close();
+        TTF_ClearFontAtlas( font15 );
+        TTF_FreeTextCache( textCache );
         TTF_CloseFont( font15 );
         TTF_CloseFont( font35 );
-        SDL_DestroyTexture( textState );
-        SDL_DestroyTexture( textLives );
+        textLives.reset();
+        SDL_DelEventWatch( lifecycleWatch, this );
+        SDL_DestroyMutex( inputLock );
+        if (fieldLayer != nullptr)
+            SDL_DestroyTexture( fieldLayer );
         SDL_DestroyRenderer( renderer );
         SDL_DestroyWindow( window );
         SDL_Quit();
@@ -838,13 +1915,34 @@ public:
 
 };
 
-int main(int , char **)
+constexpr double Game::maxFrameSeconds;
+constexpr int Game::jobWorkers;
+constexpr int Game::fpsCaps[];
+
+int main(int argc, char *argv[])
 {
     Game game;
     if (game.init() < 0)
     {
         return -1;
     }
+
+    // --record or --replay a file of the game's input, for profiling runs
+    // that play the same way every time
+    for (int i{ 1 }; i + 1 < argc; ++i)
+    {
+        if (SDL_strcmp( argv[i], "--record" ) == 0)
+        {
+            if (!game.recordInput( argv[++i] ))
+                logSDLError( std::cerr, "Input recording" );
+        }
+        else if (SDL_strcmp( argv[i], "--replay" ) == 0)
+        {
+            if (!game.replayInput( argv[++i] ))
+                logSDLError( std::cerr, "Input replay" );
+        }
+    }
+
     game.restart();
     game.run();
     return 0;
@@ -0,0 +1,210 @@
+//
+// arkbench: steps the arkanoid simulation without a window or audio
+// device and reports how many steps it gets through in a second.  Build
+// it from this file and simulation.cpp against SDL2 and SDL2_mixer.
+//
+// The bricks take far more hits than a run lands and a paddle as wide as
+// the field sends every ball back up, so the work per step stays the same
+// from the first step to the last.  Each case is run a few times from the
+// same start and the fastest run is reported.  Last comes the box test
+// the pairwise narrow phase makes, timed brick by brick and batched.
+//
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+#include "simulation.h"
+
+static constexpr int benchRuns{ 3 };
+static constexpr int brickHits{ 1 << 30 };
+
+// Bricks fill the top half of the field in rows and columns shaped like
+// the game's own, the balls start scattered over the space below them
+static void setupField( Simulation& sim, int balls, int brickCount )
+{
+    const float fieldW( gScreenRect.w ), fieldH( gScreenRect.h / 2.f );
+    int columns{ std::max( 1, (int)std::ceil( std::sqrt( brickCount * fieldW / (3.f * fieldH) ) ) ) };
+    int rows{ (brickCount + columns - 1) / columns };
+    float pitchX{ fieldW / columns }, pitchY{ fieldH / rows };
+
+    sim.reset();
+    sim.manager.reserve<Paddle>( 1 );
+    sim.manager.reserve<Ball>( balls );
+    sim.bricks.reserve( brickCount );
+    sim.debris.reserve( ParticleEmitter::maxParticles );
+    for (int i{ 0 }; i < brickCount; ++i)
+    {
+        float x{ (i % columns + 0.5f) * pitchX }, y{ (i / columns + 0.5f) * pitchY };
+        sim.addBrick( x, y, std::max( 1.f, pitchX - 3.f ), std::max( 1.f, pitchY - 3.f ), brickHits );
+    }
+
+    Paddle& paddle( sim.manager.create<Paddle>( gScreenRect.w / 2.f, gScreenRect.h - 20.f ) );
+    paddle.setSize( fieldW, Paddle::defHeight );
+    paddle.setOrigin( fieldW / 2.f, Paddle::defHeight / 2.f );
+    gTouchLocation.x = gScreenRect.w / 2;
+
+    srand( 1 );
+    for (int i{ 0 }; i < balls; ++i)
+    {
+        float x{ Ball::defRadius + (fieldW - 2.f * Ball::defRadius) * rand() / RAND_MAX };
+        float y{ fieldH + Ball::defRadius + (gScreenRect.h - 60.f - fieldH) * rand() / RAND_MAX };
+        Ball& ball( sim.manager.create<Ball>( x, y ) );
+        ball.velocity.x = (rand() & 1) ? Ball::defVelocity : -Ball::defVelocity;
+        ball.velocity.y = (rand() & 1) ? Ball::defVelocity : -Ball::defVelocity;
+    }
+}
+
+static void runBench( bool broadphase, int balls, int bricks, int steps, int stepRate )
+{
+    Simulation sim;
+    Uint64 best{ 0 };
+    std::size_t ballsLeft{ 0 };
+
+    sim.setBroadphase( broadphase );
+    sim.setStepRate( stepRate );
+    for (int r{ 0 }; r < benchRuns; ++r)
+    {
+        setupField( sim, balls, bricks );
+
+        Uint64 start{ SDL_GetPerformanceCounter() };
+        for (int i{ 0 }; i < steps; ++i)
+        {
+            sim.bricks.update();
+            sim.step();
+        }
+        Uint64 total{ SDL_GetPerformanceCounter() - start };
+
+        if (r == 0 || total < best)
+            best = total;
+        ballsLeft = sim.manager.getAll<Ball>().size();
+    }
+
+    double seconds{ (double)best / SDL_GetPerformanceFrequency() };
+    double sps{ seconds > 0.0 ? steps / seconds : 0.0 };
+    printf( "%-10s %12.0f steps/s %14.0f ball steps/s  (%zu of %d balls left)\n",
+            broadphase ? "grid" : "pairwise", sps, sps * balls, ballsLeft, balls );
+}
+
+// The box test of the pairwise narrow phase on its own: a box for every
+// ball against every brick, one brick at a time through Brick and
+// isIntersecting() and then BrickField::maskLanes at a time
+struct BenchBox
+{
+    float l, t, r, b;
+
+    float left() const noexcept { return l; }
+    float right() const noexcept { return r; }
+    float top() const noexcept { return t; }
+    float bottom() const noexcept { return b; }
+};
+
+static void runOverlapBench( int balls, int bricks, int steps )
+{
+    Simulation sim;
+    setupField( sim, balls, bricks );
+
+    // A box the size of a grid cell per ball, anywhere on the field
+    std::vector<BenchBox> boxes;
+    const float size( BrickGrid::cellSize );
+    srand( 2 );
+    for (int i{ 0 }; i < balls; ++i)
+    {
+        float x{ (gScreenRect.w - size) * rand() / RAND_MAX }, y{ (gScreenRect.h - size) * rand() / RAND_MAX };
+        boxes.push_back( { x, y, x + size, y + size } );
+    }
+
+    Uint64 best[2]{ 0, 0 };
+    std::size_t found[2]{ 0, 0 };
+    for (int r{ 0 }; r < benchRuns; ++r)
+    {
+        for (int batched{ 0 }; batched < 2; ++batched)
+        {
+            std::size_t hits{ 0 };
+            Uint64 start{ SDL_GetPerformanceCounter() };
+            for (int i{ 0 }; i < steps; ++i)
+                for (const auto& box : boxes)
+                {
+                    if (batched)
+                    {
+                        for (std::size_t row{ 0 }; row < sim.bricks.size(); row += BrickField::maskLanes)
+                            for (std::uint32_t mask{ sim.bricks.overlapMask( row, box.l, box.t, box.r, box.b ) };
+                                 mask != 0; mask &= mask - 1)
+                                ++hits;
+                    }
+                    else
+                    {
+                        for (std::uint32_t row{ 0 }; row < sim.bricks.size(); ++row)
+                        {
+                            Brick brick{ sim.bricks, row };
+                            hits += !brick.destroyed() && isIntersecting( brick, box );
+                        }
+                    }
+                }
+            Uint64 total{ SDL_GetPerformanceCounter() - start };
+
+            if (r == 0 || total < best[batched])
+                best[batched] = total;
+            found[batched] = hits;
+        }
+    }
+
+    double tests{ (double)steps * boxes.size() * sim.bricks.size() };
+    for (int batched{ 0 }; batched < 2; ++batched)
+    {
+        double seconds{ (double)best[batched] / SDL_GetPerformanceFrequency() };
+        printf( "%-10s %12.0f box tests/s  (%zu overlaps)\n",
+                batched ? "batched" : "one by one", seconds > 0.0 ? tests / seconds : 0.0, found[batched] );
+    }
+}
+
+static void usage( const char *argv0 )
+{
+    SDL_Log( "Usage: %s [-b balls] [-m bricks] [-k steps] [-r steps per second]\n", argv0 );
+}
+
+int main( int argc, char *argv[] )
+{
+    int balls{ 64 }, bricks{ 400 }, steps{ 2000 }, stepRate{ 60 };
+
+    for (int i{ 1 }; i < argc; ++i)
+    {
+        int *value{ nullptr };
+        if (strcmp( argv[i], "-b" ) == 0)
+            value = &balls;
+        else if (strcmp( argv[i], "-m" ) == 0)
+            value = &bricks;
+        else if (strcmp( argv[i], "-k" ) == 0)
+            value = &steps;
+        else if (strcmp( argv[i], "-r" ) == 0)
+            value = &stepRate;
+
+        if (value == nullptr || i + 1 == argc)
+        {
+            usage( argv[0] );
+            return 1;
+        }
+        *value = atoi( argv[++i] );
+    }
+    if (balls < 0 || bricks < 1 || steps < 1 || stepRate < 1)
+    {
+        usage( argv[0] );
+        return 1;
+    }
+
+    if (SDL_Init( 0 ) < 0)
+    {
+        SDL_Log( "Couldn't initialize SDL: %s\n", SDL_GetError() );
+        return 255;
+    }
+
+    printf( "%d balls, %d bricks, %d steps at %d per second, best of %d\n",
+            balls, bricks, steps, stepRate, benchRuns );
+    runBench( true, balls, bricks, steps, stepRate );
+    runBench( false, balls, bricks, steps, stepRate );
+    runOverlapBench( balls, bricks, steps );
+
+    SDL_Quit();
+    return 0;
+}
@@ -0,0 +1,107 @@
+//
+// Reading the asset pack packassets writes
+//
+
+#include "assetpack.h"
+
+#include <cstring>
+
+constexpr std::uint32_t AssetPack::magic;
+constexpr std::uint32_t AssetPack::version;
+constexpr std::size_t AssetPack::headerSize;
+constexpr std::size_t AssetPack::entrySize;
+constexpr std::size_t AssetPack::alignment;
+
+static std::uint32_t readLE32( const Uint8 *p ) noexcept
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+bool AssetPack::open( const void *data, std::size_t size )
+{
+    bytes = static_cast<const Uint8*>(data);
+    assets = 0;
+
+    if (size < headerSize || readLE32( bytes ) != magic)
+    {
+        SDL_SetError( "Not an asset pack" );
+        return false;
+    }
+    if (readLE32( bytes + 4 ) != version)
+    {
+        SDL_SetError( "Unsupported asset pack version %u", (unsigned)readLE32( bytes + 4 ) );
+        return false;
+    }
+
+    std::uint32_t count{ readLE32( bytes + 8 ) };
+    if (count > (size - headerSize) / entrySize)
+    {
+        SDL_SetError( "Asset pack truncated" );
+        return false;
+    }
+    for (std::uint32_t i{ 0 }; i < count; ++i)
+    {
+        const Uint8 *entry{ bytes + headerSize + i * entrySize };
+        std::uint32_t nameOffset{ readLE32( entry + 4 ) }, nameLength{ readLE32( entry + 8 ) };
+        std::uint32_t offset{ readLE32( entry + 12 ) }, assetSize{ readLE32( entry + 16 ) };
+        // SDL_RWFromConstMem() takes an int
+        if (nameOffset > size || nameLength > size - nameOffset ||
+            offset > size || assetSize > size - offset || assetSize > (std::uint32_t)SDL_MAX_SINT32)
+        {
+            SDL_SetError( "Asset %u lies outside the asset pack", (unsigned)i );
+            return false;
+        }
+        if (i > 0 && readLE32( entry - entrySize ) > readLE32( entry ))
+        {
+            SDL_SetError( "Asset pack index out of order" );
+            return false;
+        }
+    }
+
+    assets = count;
+    return true;
+}
+
+const void* AssetPack::find( const char *name, std::size_t& size ) const noexcept
+{
+    std::uint32_t hash{ hashName( name ) };
+    std::size_t length{ std::strlen( name ) };
+
+    // The first entry with the hash, then each one that shares it
+    std::size_t low{ 0 }, high{ assets };
+    while (low < high)
+    {
+        std::size_t middle{ low + (high - low) / 2 };
+        if (readLE32( bytes + headerSize + middle * entrySize ) < hash)
+            low = middle + 1;
+        else
+            high = middle;
+    }
+    for (; low < assets; ++low)
+    {
+        const Uint8 *entry{ bytes + headerSize + low * entrySize };
+        if (readLE32( entry ) != hash)
+            break;
+        if (readLE32( entry + 8 ) == length && std::memcmp( bytes + readLE32( entry + 4 ), name, length ) == 0)
+        {
+            size = readLE32( entry + 16 );
+            return bytes + readLE32( entry + 12 );
+        }
+    }
+    return nullptr;
+}
+
+SDL_RWops* AssetPack::stream( const char *name ) const
+{
+    if (assets == 0)
+        return SDL_RWFromFile( name, "rb" );
+
+    std::size_t size;
+    const void *data{ find( name, size ) };
+    if (data == nullptr)
+    {
+        SDL_SetError( "%s isn't in the asset pack", name );
+        return nullptr;
+    }
+    return SDL_RWFromConstMem( data, (int)size );
+}
@@ -0,0 +1,60 @@
+//
+// The game's assets packed into one file, assets.pak, that packassets
+// writes.  It's stored uncompressed in the APK, so it's mapped once and
+// each asset is served as a read-only memory stream over its part of the
+// mapping, which the mixer and SDL_ttf read in place.  All little endian:
+//
+//   u32 magic "APAK", u32 version, u32 asset count
+//   per asset, sorted by name hash: u32 name hash, u32 name offset,
+//   u32 name length, u32 data offset, u32 data size
+//   the names, then the data of each asset aligned to `alignment` bytes
+//
+// Offsets are from the start of the pack, the hash is FNV-1a of the name.
+//
+
+#ifndef ARKANOID_ASSETPACK_H
+#define ARKANOID_ASSETPACK_H
+
+#include <cstddef>
+#include <cstdint>
+
+#include <SDL.h>
+
+class AssetPack
+{
+public:
+    static constexpr std::uint32_t magic{ 0x4B415041 }, version{ 1 };
+    static constexpr std::size_t headerSize{ 12 }, entrySize{ 20 };
+    // Enough for the widest samples a mapped chunk is mixed from
+    static constexpr std::size_t alignment{ 16 };
+
+    static std::uint32_t hashName( const char *name ) noexcept
+    {
+        std::uint32_t hash{ 2166136261u };
+        while (*name != '\0')
+            hash = (hash ^ (Uint8)*name++) * 16777619u;
+        return hash;
+    }
+
+    // Checks the header and that every name and asset lies within the
+    // data, which the caller keeps around.  Returns false with the SDL
+    // error set if it's not a pack this can read.
+    bool open( const void *data, std::size_t size );
+
+    std::size_t count() const noexcept { return assets; }
+
+    // The bytes of an asset in place, or nullptr if it isn't in the pack
+    const void* find( const char *name, std::size_t& size ) const noexcept;
+
+    // A stream over the asset for the Mix_Load*_RW() and TTF_OpenFontRW()
+    // calls, closed by whoever it's passed to.  Without a pack open, the
+    // file of that name is opened instead.  Returns nullptr with the SDL
+    // error set if there's neither.
+    SDL_RWops* stream( const char *name ) const;
+
+private:
+    const Uint8 *bytes{ nullptr };
+    std::size_t assets{ 0 };
+};
+
+#endif // ARKANOID_ASSETPACK_H
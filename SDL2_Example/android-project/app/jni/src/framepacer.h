@@ -0,0 +1,106 @@
+//
+// Paces a render loop beyond what SDL_RENDERER_PRESENTVSYNC does on its
+// own: frames can be capped below the display's rate, and a loop with
+// nothing changing on screen can sleep in SDL_WaitEvent instead of
+// presenting the same picture every refresh.
+//
+
+#ifndef FRAMEPACER_H
+#define FRAMEPACER_H
+
+#include <SDL.h>
+
+class FramePacer
+{
+public:
+    // Assumed when the display doesn't report its refresh rate
+    static constexpr int defaultRefreshRate{ 60 };
+
+    // Cap the frame rate at `fps`, such as 30, 60, 90 or 120, or leave it to
+    // vsync with 0, as it starts out.  Frames are kept a whole number of
+    // refreshes apart so they're evenly paced, which can put the rate below
+    // the cap: 90 on a 120 Hz display runs at 60.
+    void setTargetFps( int fps )
+    {
+        SDL_DisplayMode mode;
+        int refreshRate{ defaultRefreshRate };
+        if (SDL_GetCurrentDisplayMode( 0, &mode ) == 0 && mode.refresh_rate > 0)
+            refreshRate = mode.refresh_rate;
+
+        refreshPeriod = SDL_GetPerformanceFrequency() / refreshRate;
+        period = 0;
+        deadline = 0;
+        if (fps > 0 && fps < refreshRate)
+        {
+            int refreshes{ (refreshRate + fps - 1) / fps };
+            period = SDL_GetPerformanceFrequency() * refreshes / refreshRate;
+        }
+    }
+
+    // How long each frame has, at the cap or else the display's rate
+    double budgetSeconds() const noexcept
+    {
+        return (double)(period != 0 ? period : refreshPeriod) / SDL_GetPerformanceFrequency();
+    }
+
+    // While idle, the first pollEvent() of a frame waits for an event unless
+    // invalidate() asked for a redraw
+    void setIdle( bool enabled ) noexcept { idle = enabled; }
+    void invalidate() noexcept { dirty = true; }
+
+    // Something for the next frame to show: a window event or a lost
+    // renderer always counts, since the last picture may be gone
+    bool pollEvent( SDL_Event& e )
+    {
+        bool got;
+        if (idle && !dirty && !waited)
+        {
+            waited = true;
+            got = SDL_WaitEvent( &e ) == 1;
+        }
+        else
+            got = SDL_PollEvent( &e ) == 1;
+
+        if (got && (e.type == SDL_WINDOWEVENT || e.type == SDL_RENDER_TARGETS_RESET ||
+                    e.type == SDL_RENDER_DEVICE_RESET || e.type == SDL_APP_DIDENTERFOREGROUND))
+            dirty = true;
+        return got;
+    }
+
+    // While idle, whether anything asked for the frame to be drawn
+    bool shouldDraw() const noexcept { return !idle || dirty || waited; }
+
+    // Call once the frame is presented.  Sleeps off the rest of the frame's
+    // period, less a millisecond the next present's vsync wait absorbs.
+    void endFrame()
+    {
+        dirty = false;
+        waited = false;
+        if (period == 0)
+            return;
+
+        Uint64 now{ SDL_GetPerformanceCounter() };
+        // The first frame, or one that came in more than a period late,
+        // starts the schedule over rather than trying to catch up
+        if (deadline == 0 || now > deadline + period)
+            deadline = now;
+        deadline += period;
+
+        if (deadline > now)
+        {
+            Uint32 ms( (deadline - now) * 1000 / SDL_GetPerformanceFrequency() );
+            if (ms > 1)
+                SDL_Delay( ms - 1 );
+        }
+    }
+
+private:
+    Uint64 period{ 0 };
+    Uint64 refreshPeriod{ 0 };
+    Uint64 deadline{ 0 };
+    bool idle{ false };
+    bool dirty{ true };
+    bool waited{ false };
+};
+
+#endif // FRAMEPACER_H
@@ -0,0 +1,184 @@
+//
+// Recording and replaying the game's input
+//
+
+#include "inputlog.h"
+
+#include <algorithm>
+#include <cmath>
+
+constexpr std::uint32_t InputLog::magic;
+constexpr std::uint32_t InputLog::version;
+constexpr std::size_t InputLog::flushSize;
+
+static void putLE32( std::vector<Uint8>& bytes, std::uint32_t value )
+{
+    for (int i{ 0 }; i < 4; ++i)
+        bytes.push_back( (Uint8)(value >> (8 * i)) );
+}
+
+static std::uint32_t readLE32( const Uint8 *p ) noexcept
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+// Small moves either way take a byte
+static std::uint32_t zigzag( int value ) noexcept
+{
+    return ((std::uint32_t)value << 1) ^ (std::uint32_t)(value >> 31);
+}
+
+static int unzigzag( std::uint32_t value ) noexcept
+{
+    return (int)(value >> 1) ^ -(int)(value & 1);
+}
+
+bool InputLog::record( const char *path )
+{
+    close();
+    file = SDL_RWFromFile( path, "wb" );
+    if (file == nullptr)
+        return false;
+
+    bytes.clear();
+    putLE32( bytes, magic );
+    putLE32( bytes, version );
+    lastTouch = SDL_Point{ 0, 0 };
+    frames = 0;
+    return true;
+}
+
+bool InputLog::replay( const char *path )
+{
+    close();
+    SDL_RWops *src( SDL_RWFromFile( path, "rb" ) );
+    if (src == nullptr)
+        return false;
+
+    // Recordings are small, they're read whole so a frame never waits on the file
+    Sint64 size( SDL_RWsize( src ) );
+    bool ok( size >= 8 );
+    if (ok)
+    {
+        bytes.resize( (std::size_t)size );
+        ok = SDL_RWread( src, bytes.data(), 1, bytes.size() ) == bytes.size();
+        if (!ok)
+            SDL_SetError( "Couldn't read %s", path );
+    }
+    else
+        SDL_SetError( "%s isn't an input recording", path );
+    SDL_RWclose( src );
+
+    if (ok && readLE32( bytes.data() ) != magic)
+    {
+        SDL_SetError( "%s isn't an input recording", path );
+        ok = false;
+    }
+    else if (ok && readLE32( bytes.data() + 4 ) != version)
+    {
+        SDL_SetError( "Unsupported input recording version %u", (unsigned)readLE32( bytes.data() + 4 ) );
+        ok = false;
+    }
+    if (!ok)
+    {
+        bytes.clear();
+        return false;
+    }
+
+    playing = true;
+    readPos = 8;
+    lastTouch = SDL_Point{ 0, 0 };
+    frames = 0;
+    return true;
+}
+
+void InputLog::close()
+{
+    if (file != nullptr)
+    {
+        flush();
+        SDL_RWclose( file );
+        file = nullptr;
+    }
+    playing = false;
+    bytes.clear();
+    readPos = 0;
+}
+
+double InputLog::quantize( double seconds ) noexcept
+{
+    double micros( std::round( seconds * 1e6 ) );
+    if (!(micros > 0.0))
+        return 0.0;
+    return std::min( micros, (double)UINT32_MAX ) / 1e6;
+}
+
+void InputLog::write( const Frame& frame )
+{
+    if (file == nullptr)
+        return;
+
+    putVarint( (std::uint32_t)std::round( quantize( frame.seconds ) * 1e6 ) );
+    putVarint( zigzag( frame.touch.x - lastTouch.x ) );
+    putVarint( zigzag( frame.touch.y - lastTouch.y ) );
+    bytes.push_back( frame.buttons );
+    lastTouch = frame.touch;
+    ++frames;
+
+    if (bytes.size() >= flushSize)
+        flush();
+}
+
+bool InputLog::read( Frame& frame )
+{
+    if (!playing)
+        return false;
+
+    std::uint32_t micros, dx, dy;
+    if (!getVarint( micros ) || !getVarint( dx ) || !getVarint( dy ) || readPos == bytes.size())
+    {
+        // A frame cut short, as the last of a recording that was killed can
+        // be, ends the replay like the end of the file does
+        playing = false;
+        return false;
+    }
+    frame.seconds = micros / 1e6;
+    lastTouch.x += unzigzag( dx );
+    lastTouch.y += unzigzag( dy );
+    frame.touch = lastTouch;
+    frame.buttons = bytes[readPos++];
+    ++frames;
+    return true;
+}
+
+void InputLog::flush()
+{
+    if (!bytes.empty() && SDL_RWwrite( file, bytes.data(), 1, bytes.size() ) != bytes.size())
+        SDL_Log( "Input recording write error: %s", SDL_GetError() );
+    bytes.clear();
+}
+
+void InputLog::putVarint( std::uint32_t value )
+{
+    while (value >= 0x80)
+    {
+        bytes.push_back( (Uint8)(value | 0x80) );
+        value >>= 7;
+    }
+    bytes.push_back( (Uint8)value );
+}
+
+bool InputLog::getVarint( std::uint32_t& value )
+{
+    value = 0;
+    for (int shift{ 0 }; shift < 35; shift += 7)
+    {
+        if (readPos == bytes.size())
+            return false;
+        Uint8 byte( bytes[readPos++] );
+        value |= (std::uint32_t)(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0)
+            return true;
+    }
+    return false;
+}
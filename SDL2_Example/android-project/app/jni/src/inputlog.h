@@ -0,0 +1,96 @@
+//
+// The input the game thread took each frame, and the time the frame
+// advanced the game by, written to a file and fed back in place of the
+// device's.  The simulation takes whole steps of a fixed length, so a
+// replay runs the same steps on the same input and looks the same frame
+// for frame however fast the device draws, which makes profiling runs
+// repeatable.  The file is all little endian:
+//
+//   u32 magic "ARKI", u32 version
+//   per frame: the frame's length in microseconds, then the touch's move
+//   on x and on y since the last frame, zigzag encoded, all as varints,
+//   then a byte of Button flags
+//
+// A 60 Hz frame takes 6 bytes unless the finger moves far in it.
+//
+
+#ifndef ARKANOID_INPUTLOG_H
+#define ARKANOID_INPUTLOG_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include <SDL.h>
+
+class InputLog
+{
+public:
+    static constexpr std::uint32_t magic{ 0x494B5241 }, version{ 1 };
+
+    // What the game reads of the keys and the touch
+    enum Button : Uint8
+    {
+        Tap = 1 << 0,
+        Pause = 1 << 1,
+        Restart = 1 << 2,
+        Left = 1 << 3,
+        Right = 1 << 4,
+        Backgrounded = 1 << 5
+    };
+
+    struct Frame
+    {
+        double seconds;
+        SDL_Point touch;
+        Uint8 buttons;
+    };
+
+    InputLog() = default;
+    InputLog( const InputLog& ) = delete;
+    InputLog& operator=( const InputLog& ) = delete;
+    ~InputLog() { close(); }
+
+    // Starts a file of frames to come, false with the SDL error set if it
+    // can't be written
+    bool record( const char *path );
+
+    // Reads a recording to play back, false with the SDL error set if it
+    // can't be read or isn't one
+    bool replay( const char *path );
+
+    // Writes out what's left of a recording
+    void close();
+
+    bool recording() const noexcept { return file != nullptr; }
+    bool replaying() const noexcept { return playing; }
+
+    // The frames written or read so far
+    unsigned frameCount() const noexcept { return frames; }
+
+    // What the log keeps of a frame's length, the recording game advances
+    // by this so a replay takes the same steps
+    static double quantize( double seconds ) noexcept;
+
+    void write( const Frame& frame );
+
+    // The next recorded frame, false once there are no more
+    bool read( Frame& frame );
+
+private:
+    // Written out whenever this much is gathered
+    static constexpr std::size_t flushSize{ 4096 };
+
+    SDL_RWops *file{ nullptr };
+    bool playing{ false };
+    std::vector<Uint8> bytes;
+    std::size_t readPos{ 0 };
+    SDL_Point lastTouch{ 0, 0 };
+    unsigned frames{ 0 };
+
+    void flush();
+    void putVarint( std::uint32_t value );
+    bool getVarint( std::uint32_t& value );
+};
+
+#endif // ARKANOID_INPUTLOG_H
@@ -0,0 +1,241 @@
+//
+// The workers of the JobSystem and how they find the clusters to pin to
+//
+
+#include "jobsystem.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#ifdef __linux__
+#include <sched.h>
+#endif
+
+namespace
+{
+
+// The worker running on this thread, so its submits go on its own deque
+thread_local void *currentWorker{ nullptr };
+
+// The highest clock of a CPU in kHz, or 0 if the kernel doesn't say
+long maxFrequency( int cpu )
+{
+    char path[96];
+    std::snprintf( path, sizeof(path), "/sys/devices/system/cpu/cpu%d/cpufreq/cpuinfo_max_freq", cpu );
+    std::FILE *file( std::fopen( path, "r" ) );
+    if (file == nullptr)
+        return 0;
+    long frequency{ 0 };
+    if (std::fscanf( file, "%ld", &frequency ) != 1)
+        frequency = 0;
+    std::fclose( file );
+    return frequency;
+}
+
+}
+
+JobSystem::JobSystem()
+    : sleepLock( SDL_CreateMutex() ), wake( SDL_CreateCond() )
+{
+    SDL_AtomicSet( &nextWorker, 0 );
+}
+
+JobSystem::~JobSystem()
+{
+    stop();
+    SDL_DestroyCond( wake );
+    SDL_DestroyMutex( sleepLock );
+}
+
+int JobSystem::start( int count )
+{
+    if (!workers.empty())
+        return workerCount();
+    int cpuCount( SDL_GetCPUCount() );
+    if (count < 0)
+        count = std::max( 1, cpuCount - 1 );
+
+    // Every CPU clocked above the slowest is a big one.  Workers go to the
+    // fastest CPUs first, as many as there are of them.
+    std::vector<long> frequencies;
+    for (int cpu{ 0 }; cpu < cpuCount; ++cpu)
+        frequencies.emplace_back( maxFrequency( cpu ) );
+    long slowest( frequencies.empty() ? 0 : *std::min_element( frequencies.begin(), frequencies.end() ) );
+    std::vector<int> bigCpus, littleCpus;
+    for (int cpu{ 0 }; cpu < cpuCount; ++cpu)
+        (frequencies[cpu] > slowest ? bigCpus : littleCpus).emplace_back( cpu );
+    bool clustered( slowest > 0 && !bigCpus.empty() );
+
+    for (int i{ 0 }; i < count; ++i)
+    {
+        std::unique_ptr<Worker> worker( new Worker{ this, i, true, true, {}, SDL_CreateMutex(), {} } );
+        if (clustered)
+        {
+            worker->big = i % cpuCount < (int)bigCpus.size();
+            worker->little = !worker->big;
+            worker->cpus = worker->big ? bigCpus : littleCpus;
+        }
+        workers.emplace_back( std::move( worker ) );
+    }
+
+    // The workers wait for the lock before they look at the others, so
+    // the ones that couldn't be started can go first
+    quit = false;
+    SDL_LockMutex( sleepLock );
+    for (std::size_t i{ 0 }; i < workers.size(); ++i)
+    {
+        workers[i]->thread = SDL_CreateThread( workerMain, "job worker", workers[i].get() );
+        if (workers[i]->thread == nullptr)
+        {
+            for (std::size_t j{ i }; j < workers.size(); ++j)
+                SDL_DestroyMutex( workers[j]->lock );
+            workers.resize( i );
+        }
+    }
+    auto hasBig( std::any_of( workers.begin(), workers.end(), []( const std::unique_ptr<Worker>& w ) { return w->big; } ) );
+    auto hasLittle( std::any_of( workers.begin(), workers.end(), []( const std::unique_ptr<Worker>& w ) { return w->little; } ) );
+    for (auto& worker : workers)
+    {
+        worker->big = worker->big || !hasBig;
+        worker->little = worker->little || !hasLittle;
+    }
+    SDL_UnlockMutex( sleepLock );
+    return workerCount();
+}
+
+void JobSystem::stop()
+{
+    if (workers.empty())
+        return;
+    SDL_LockMutex( sleepLock );
+    quit = true;
+    SDL_CondBroadcast( wake );
+    SDL_UnlockMutex( sleepLock );
+    for (auto& worker : workers)
+        SDL_WaitThread( worker->thread, nullptr );
+    for (auto& worker : workers)
+        SDL_DestroyMutex( worker->lock );
+    workers.clear();
+}
+
+bool JobSystem::submit( Job job, Affinity affinity )
+{
+    if (workers.empty())
+        return false;
+
+    Worker *target( static_cast<Worker*>(currentWorker) );
+    if (target == nullptr || target->owner != this || !target->canRun( affinity ))
+    {
+        int count( workerCount() );
+        int first( (int)((unsigned)SDL_AtomicAdd( &nextWorker, 1 ) % count) );
+        target = nullptr;
+        for (int i{ 0 }; i < count && target == nullptr; ++i)
+        {
+            Worker *worker( workers[(first + i) % count].get() );
+            if (worker->canRun( affinity ))
+                target = worker;
+        }
+    }
+
+    // Counted first, so a worker that wakes now looks until it's there
+    SDL_LockMutex( sleepLock );
+    ++queued[(int)affinity];
+    SDL_UnlockMutex( sleepLock );
+
+    SDL_LockMutex( target->lock );
+    target->jobs.emplace_back( Queued{ std::move( job ), affinity } );
+    SDL_UnlockMutex( target->lock );
+
+    SDL_LockMutex( sleepLock );
+    SDL_CondBroadcast( wake );
+    SDL_UnlockMutex( sleepLock );
+    return true;
+}
+
+int SDLCALL JobSystem::workerMain( void *data )
+{
+    Worker *self( static_cast<Worker*>(data) );
+    SDL_LockMutex( self->owner->sleepLock );
+    SDL_UnlockMutex( self->owner->sleepLock );
+#ifdef __linux__
+    if (!self->cpus.empty())
+    {
+        cpu_set_t cpus;
+        CPU_ZERO( &cpus );
+        for (auto cpu : self->cpus)
+            CPU_SET( cpu, &cpus );
+        // Pid 0 is the calling thread
+        sched_setaffinity( 0, sizeof(cpus), &cpus );
+    }
+#endif
+    currentWorker = self;
+    self->owner->work( *self );
+    currentWorker = nullptr;
+    return 0;
+}
+
+void JobSystem::work( Worker& self )
+{
+    for (;;)
+    {
+        Queued queuedJob;
+        if (take( self, queuedJob ))
+        {
+            queuedJob.job();
+            continue;
+        }
+
+        SDL_LockMutex( sleepLock );
+        while (!runnable( self ) && !quit)
+            SDL_CondWait( wake, sleepLock );
+        bool done( quit && !runnable( self ) );
+        SDL_UnlockMutex( sleepLock );
+        if (done)
+            break;
+    }
+}
+
+// Its own newest job, or else the oldest of another worker's it may run
+bool JobSystem::take( Worker& self, Queued& out )
+{
+    bool found{ false };
+    SDL_LockMutex( self.lock );
+    if (!self.jobs.empty())
+    {
+        out = std::move( self.jobs.back() );
+        self.jobs.pop_back();
+        found = true;
+    }
+    SDL_UnlockMutex( self.lock );
+
+    int count( workerCount() );
+    for (int i{ 1 }; i < count && !found; ++i)
+    {
+        Worker& victim( *workers[(self.index + i) % count] );
+        SDL_LockMutex( victim.lock );
+        auto job( std::find_if( victim.jobs.begin(), victim.jobs.end(),
+                                [&self]( const Queued& q ) { return self.canRun( q.affinity ); } ) );
+        if (job != victim.jobs.end())
+        {
+            out = std::move( *job );
+            victim.jobs.erase( job );
+            found = true;
+        }
+        SDL_UnlockMutex( victim.lock );
+    }
+
+    if (found)
+    {
+        SDL_LockMutex( sleepLock );
+        --queued[(int)out.affinity];
+        SDL_UnlockMutex( sleepLock );
+    }
+    return found;
+}
+
+// Called with sleepLock held
+bool JobSystem::runnable( const Worker& self ) const
+{
+    return queued[(int)Affinity::Any] > 0 || (self.big && queued[(int)Affinity::Big] > 0) ||
+           (self.little && queued[(int)Affinity::Little] > 0);
+}
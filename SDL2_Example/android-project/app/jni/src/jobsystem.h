@@ -0,0 +1,99 @@
+//
+// A work-stealing job scheduler the game, the mixer's background loads
+// and SDL_ttf's text compositing share, instead of each starting threads
+// of its own.  Every worker has a deque: jobs a worker submits go on the
+// back of its own and it takes them from there, newest first, while the
+// workers that run dry steal the oldest from the front of the others'.
+// Jobs submitted from any other thread are dealt out round robin.
+//
+// On big.LITTLE devices the workers are pinned to the cluster they're
+// created for, and a job may ask for either one.  Where the cores are all
+// alike, or a cluster has no worker, every worker counts as both.
+//
+
+#ifndef ARKANOID_JOBSYSTEM_H
+#define ARKANOID_JOBSYSTEM_H
+
+#include <deque>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <SDL.h>
+
+class JobSystem
+{
+public:
+    using Job = std::function<void()>;
+
+    enum class Affinity
+    {
+        Any,
+        Big,        // the fast cores, for what a frame waits on
+        Little      // the efficient ones, for what can take its time
+    };
+
+    JobSystem();
+    JobSystem( const JobSystem& ) = delete;
+    JobSystem& operator=( const JobSystem& ) = delete;
+    ~JobSystem();
+
+    // Starts the workers, -1 for one less than the number of CPUs but at
+    // least one.  Returns how many could be started.
+    int start( int count = -1 );
+
+    // Runs what's queued, then waits for the workers to finish
+    void stop();
+
+    int workerCount() const { return (int)workers.size(); }
+
+    // Returns false, without running it, if no worker can take the job
+    bool submit( Job job, Affinity affinity = Affinity::Any );
+
+    // Mix_JobHandler and TTF_JobHandler, with the JobSystem as udata
+    template<Affinity affinity>
+    static int SDLCALL submitC( void (SDLCALL *job)( void *data ), void *data, void *udata )
+    {
+        JobSystem *self( static_cast<JobSystem*>(udata) );
+        return self->submit( [job, data] { job( data ); }, affinity ) ? 0 : -1;
+    }
+
+private:
+    struct Queued
+    {
+        Job job;
+        Affinity affinity;
+    };
+
+    struct Worker
+    {
+        JobSystem *owner;
+        int index;
+        bool big, little;
+        // The CPUs of its cluster, none when it isn't pinned
+        std::vector<int> cpus;
+        SDL_mutex *lock;
+        std::deque<Queued> jobs;
+        SDL_Thread *thread{ nullptr };
+
+        bool canRun( Affinity affinity ) const
+        {
+            return affinity == Affinity::Any || (affinity == Affinity::Big ? big : little);
+        }
+    };
+
+    std::vector<std::unique_ptr<Worker>> workers;
+    // Held by whoever sleeps or wakes the workers, and over `queued`
+    SDL_mutex *sleepLock;
+    SDL_cond *wake;
+    int queued[3]{};
+    bool quit{ false };
+    SDL_atomic_t nextWorker;
+
+    static int SDLCALL workerMain( void *data );
+    void work( Worker& self );
+    bool take( Worker& self, Queued& out );
+    bool runnable( const Worker& self ) const;
+};
+
+#endif // ARKANOID_JOBSYSTEM_H
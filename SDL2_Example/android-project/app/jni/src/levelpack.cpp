@@ -0,0 +1,145 @@
+//
+// levelpack: turns the text levels of levels.txt into the levels.ark pack
+// the game maps from its assets.  Build it from this file against the
+// SDL2 and SDL2_mixer headers, it links against neither:
+//
+//   levelpack levels.txt ../../src/main/assets/levels.ark
+//
+// A level is a block of lines, one character per brick on the grid
+// LevelPack lays levels out on: 1 to 9 for the hits the brick takes, any
+// other character for no brick there.  Blank lines end a level, lines
+// starting with # are comments.
+//
+
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+#include "simulation.h"
+
+struct Level
+{
+    std::vector<float> x, y, w, h;
+    std::vector<int> hits;
+};
+
+static void putLE32( std::vector<Uint8>& out, std::uint32_t value )
+{
+    for (int i{ 0 }; i < 4; ++i)
+        out.emplace_back( (Uint8)(value >> (8 * i)) );
+}
+
+static void putFloats( std::vector<Uint8>& out, const std::vector<float>& values )
+{
+    for (auto value : values)
+    {
+        std::uint32_t bits;
+        std::memcpy( &bits, &value, sizeof(bits) );
+        putLE32( out, bits );
+    }
+}
+
+static bool readLevels( FILE *in, std::vector<Level>& levels )
+{
+    const float width{ Brick::defWidth }, height{ Brick::defHeight };
+    char line[256];
+    int row{ 0 };
+    bool inLevel{ false };
+
+    while (std::fgets( line, sizeof(line), in ) != nullptr)
+    {
+        std::size_t length{ std::strcspn( line, "\r\n" ) };
+        if (line[0] == '#')
+            continue;
+        if (length == 0)
+        {
+            inLevel = false;
+            continue;
+        }
+        if (!inLevel)
+        {
+            levels.emplace_back();
+            inLevel = true;
+            row = 0;
+        }
+
+        Level& level( levels.back() );
+        for (std::size_t column{ 0 }; column < length; ++column)
+        {
+            if (line[column] < '1' || line[column] > '9')
+                continue;
+            level.x.emplace_back( LevelPack::columnX( (int)column ) );
+            level.y.emplace_back( LevelPack::rowY( row ) );
+            level.w.emplace_back( width );
+            level.h.emplace_back( height );
+            level.hits.emplace_back( line[column] - '0' );
+        }
+        ++row;
+    }
+    return !std::ferror( in );
+}
+
+static std::vector<Uint8> pack( const std::vector<Level>& levels )
+{
+    std::vector<Uint8> out;
+    putLE32( out, LevelPack::magic );
+    putLE32( out, LevelPack::version );
+    putLE32( out, (std::uint32_t)levels.size() );
+
+    std::size_t offset{ LevelPack::headerSize + levels.size() * LevelPack::entrySize };
+    for (auto& level : levels)
+    {
+        putLE32( out, (std::uint32_t)offset );
+        putLE32( out, (std::uint32_t)level.hits.size() );
+        offset += level.hits.size() * LevelPack::brickSize;
+    }
+
+    for (auto& level : levels)
+    {
+        putFloats( out, level.x );
+        putFloats( out, level.y );
+        putFloats( out, level.w );
+        putFloats( out, level.h );
+        for (auto hits : level.hits)
+            putLE32( out, (std::uint32_t)hits );
+    }
+    return out;
+}
+
+int main( int argc, char *argv[] )
+{
+    if (argc != 3)
+    {
+        std::fprintf( stderr, "Usage: %s levels.txt levels.ark\n", argv[0] );
+        return 1;
+    }
+
+    FILE *in{ std::fopen( argv[1], "r" ) };
+    if (in == nullptr)
+    {
+        std::perror( argv[1] );
+        return 1;
+    }
+    std::vector<Level> levels;
+    bool read{ readLevels( in, levels ) };
+    std::fclose( in );
+    if (!read || levels.empty())
+    {
+        std::fprintf( stderr, "%s: no levels read\n", argv[1] );
+        return 1;
+    }
+
+    std::vector<Uint8> out( pack( levels ) );
+    FILE *file{ std::fopen( argv[2], "wb" ) };
+    if (file == nullptr || std::fwrite( out.data(), 1, out.size(), file ) != out.size())
+    {
+        std::perror( argv[2] );
+        if (file != nullptr)
+            std::fclose( file );
+        return 1;
+    }
+    std::fclose( file );
+
+    std::printf( "%zu levels, %zu bytes\n", levels.size(), out.size() );
+    return 0;
+}
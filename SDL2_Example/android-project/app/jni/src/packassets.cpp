@@ -0,0 +1,128 @@
+//
+// packassets: packs the files given into the assets.pak the game maps
+// from its assets, see AssetPack.  Each is stored under its name without
+// the directory.  Build it from this file against the SDL2 headers, it
+// doesn't link against SDL2:
+//
+//   packassets ../../src/main/assets/assets.pak calibri.ttf skate_music.mp3 ...
+//
+// The game opens the files one by one when there's no pack.
+//
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include "assetpack.h"
+
+struct Asset
+{
+    std::string name;
+    std::uint32_t hash;
+    std::vector<Uint8> data;
+};
+
+static void putLE32( std::vector<Uint8>& out, std::uint32_t value )
+{
+    for (int i{ 0 }; i < 4; ++i)
+        out.emplace_back( (Uint8)(value >> (8 * i)) );
+}
+
+static std::size_t aligned( std::size_t offset )
+{
+    return (offset + AssetPack::alignment - 1) / AssetPack::alignment * AssetPack::alignment;
+}
+
+static bool readAsset( const char *path, Asset& asset )
+{
+    const char *slash{ std::strrchr( path, '/' ) };
+    asset.name = slash != nullptr ? slash + 1 : path;
+    asset.hash = AssetPack::hashName( asset.name.c_str() );
+
+    FILE *in{ std::fopen( path, "rb" ) };
+    if (in == nullptr)
+        return false;
+    Uint8 buffer[65536];
+    std::size_t got;
+    while ((got = std::fread( buffer, 1, sizeof(buffer), in )) > 0)
+        asset.data.insert( asset.data.end(), buffer, buffer + got );
+    bool read{ !std::ferror( in ) };
+    std::fclose( in );
+    return read;
+}
+
+static std::vector<Uint8> pack( const std::vector<Asset>& assets )
+{
+    std::vector<Uint8> out;
+    putLE32( out, AssetPack::magic );
+    putLE32( out, AssetPack::version );
+    putLE32( out, (std::uint32_t)assets.size() );
+
+    std::size_t nameOffset{ AssetPack::headerSize + assets.size() * AssetPack::entrySize };
+    std::size_t offset{ nameOffset };
+    for (auto& asset : assets)
+        offset += asset.name.size();
+    for (auto& asset : assets)
+    {
+        offset = aligned( offset );
+        putLE32( out, asset.hash );
+        putLE32( out, (std::uint32_t)nameOffset );
+        putLE32( out, (std::uint32_t)asset.name.size() );
+        putLE32( out, (std::uint32_t)offset );
+        putLE32( out, (std::uint32_t)asset.data.size() );
+        nameOffset += asset.name.size();
+        offset += asset.data.size();
+    }
+
+    for (auto& asset : assets)
+        out.insert( out.end(), asset.name.begin(), asset.name.end() );
+    for (auto& asset : assets)
+    {
+        out.resize( aligned( out.size() ), 0 );
+        out.insert( out.end(), asset.data.begin(), asset.data.end() );
+    }
+    return out;
+}
+
+int main( int argc, char *argv[] )
+{
+    if (argc < 3)
+    {
+        std::fprintf( stderr, "Usage: %s assets.pak file...\n", argv[0] );
+        return 1;
+    }
+
+    std::vector<Asset> assets( argc - 2 );
+    for (int i{ 2 }; i < argc; ++i)
+        if (!readAsset( argv[i], assets[i - 2] ))
+        {
+            std::perror( argv[i] );
+            return 1;
+        }
+    std::sort( assets.begin(), assets.end(), []( const Asset& a, const Asset& b )
+               {
+                   return a.hash != b.hash ? a.hash < b.hash : a.name < b.name;
+               } );
+    for (std::size_t i{ 1 }; i < assets.size(); ++i)
+        if (assets[i].name == assets[i - 1].name)
+        {
+            std::fprintf( stderr, "%s: packed twice\n", assets[i].name.c_str() );
+            return 1;
+        }
+
+    std::vector<Uint8> out( pack( assets ) );
+    FILE *file{ std::fopen( argv[1], "wb" ) };
+    if (file == nullptr || std::fwrite( out.data(), 1, out.size(), file ) != out.size())
+    {
+        std::perror( argv[1] );
+        if (file != nullptr)
+            std::fclose( file );
+        return 1;
+    }
+    std::fclose( file );
+
+    std::printf( "%zu assets, %zu bytes\n", assets.size(), out.size() );
+    return 0;
+}
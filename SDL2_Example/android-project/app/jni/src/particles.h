@@ -0,0 +1,142 @@
+//
+// Short-lived debris kept out of the entity Manager: a particle is a row
+// in a handful of float arrays rather than a heap object with a virtual
+// draw, so updating thousands of them is a few straight passes over
+// memory and drawing them is one array of rects for the RenderQueue.
+//
+
+#ifndef PARTICLES_H
+#define PARTICLES_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+
+#include <SDL.h>
+
+class ParticleEmitter
+{
+public:
+    // Bursts past this many live particles are cut short, or past the
+    // limit set lower
+    static constexpr std::size_t maxParticles{ 4096 };
+
+    // Particles start `size` pixels wide and shrink away over `lifetime`
+    // ticks, falling `gravity` pixels per tick faster every tick
+    ParticleEmitter( const SDL_Color& mColor, float mSize, float mLifetime, float mGravity ) noexcept
+        : color( mColor ), size( mSize ), lifetime( mLifetime ), gravity( mGravity )
+    {
+    }
+
+    const SDL_Color& getColor() const noexcept { return color; }
+    std::size_t count() const noexcept { return life.size(); }
+
+    // The particles already flying live out their time
+    void setLimit( std::size_t count ) noexcept { limit = std::min( count, maxParticles ); }
+
+    void reserve( std::size_t count )
+    {
+        for (auto column : { &x, &y, &vx, &vy, &life })
+            column->reserve( count );
+    }
+
+    // Keeps the storage
+    void clear()
+    {
+        for (auto column : { &x, &y, &vx, &vy, &life })
+            column->clear();
+    }
+
+    // `count` particles flying out of the point at up to `speed` pixels a
+    // tick in any direction
+    void burst( float mX, float mY, int count, float speed )
+    {
+        for (int i{ 0 }; i < count && life.size() < limit; ++i)
+        {
+            float angle{ random() * 6.2831853f };
+            float velocity{ speed * (0.25f + 0.75f * random()) };
+            x.emplace_back( mX );
+            y.emplace_back( mY );
+            vx.emplace_back( std::cos( angle ) * velocity );
+            vy.emplace_back( std::sin( angle ) * velocity );
+            life.emplace_back( lifetime * (0.5f + 0.5f * random()) );
+        }
+    }
+
+    void update( float ticks ) noexcept
+    {
+        lastTicks = ticks;
+        std::size_t count{ life.size() };
+        if (count == 0)
+            return;
+
+        // Each pass touches only the arrays it needs and has no branches,
+        // so the compiler turns it into vector code
+        float *mX{ x.data() }, *mY{ y.data() }, *mVx{ vx.data() }, *mVy{ vy.data() }, *mLife{ life.data() };
+        float fall{ gravity * ticks };
+        for (std::size_t i{ 0 }; i < count; ++i)
+            mVy[i] += fall;
+        for (std::size_t i{ 0 }; i < count; ++i)
+            mX[i] += mVx[i] * ticks;
+        for (std::size_t i{ 0 }; i < count; ++i)
+            mY[i] += mVy[i] * ticks;
+        for (std::size_t i{ 0 }; i < count; ++i)
+            mLife[i] -= ticks;
+
+        // Expired particles are replaced by the last one, the order of the
+        // rows doesn't matter
+        for (std::size_t i{ 0 }; i < count; )
+        {
+            if (mLife[i] > 0.f)
+            {
+                ++i;
+                continue;
+            }
+            --count;
+            mX[i] = mX[count];
+            mY[i] = mY[count];
+            mVx[i] = mVx[count];
+            mVy[i] = mVy[count];
+            mLife[i] = mLife[count];
+        }
+        for (auto column : { &x, &y, &vx, &vy, &life })
+            column->resize( count );
+    }
+
+    // The particles as squares `alpha` of the way from the last step to
+    // this one, all in the emitter's color so they're one SDL_RenderFillRects
+    void draw( std::vector<SDL_Rect>& rects, float alpha ) const
+    {
+        float back{ (1.f - alpha) * lastTicks };
+        rects.clear();
+        for (std::size_t i{ 0 }; i < life.size(); ++i)
+        {
+            int side{ (int)std::ceil( size * life[i] / lifetime ) };
+            rects.emplace_back( SDL_Rect{ (int)(x[i] - vx[i] * back) - side / 2,
+                                          (int)(y[i] - vy[i] * back) - side / 2, side, side } );
+        }
+    }
+
+private:
+    std::vector<float> x, y, vx, vy;
+    // Ticks left
+    std::vector<float> life;
+    std::size_t limit{ maxParticles };
+
+    SDL_Color color;
+    float size, lifetime, gravity;
+    float lastTicks{ 1.f };
+    std::uint32_t seed{ 0x9E3779B9u };
+
+    // A fixed xorshift sequence, so runs of the simulation repeat
+    float random() noexcept
+    {
+        seed ^= seed << 13;
+        seed ^= seed >> 17;
+        seed ^= seed << 5;
+        return (seed >> 8) * (1.f / 16777216.f);
+    }
+};
+
+#endif // PARTICLES_H
@@ -0,0 +1,212 @@
+//
+// Picking the quality level and setting what it stands for
+//
+
+#include "quality.h"
+
+#include <algorithm>
+
+#ifdef __ANDROID__
+#include <dlfcn.h>
+#endif
+
+#include <SDL_mixer.h>
+
+constexpr int QualityGovernor::levelCount;
+constexpr double QualityGovernor::periodSeconds;
+constexpr double QualityGovernor::lateFactor;
+constexpr double QualityGovernor::lateShare;
+constexpr double QualityGovernor::onTimeShare;
+constexpr int QualityGovernor::recoverPeriods;
+constexpr int QualityGovernor::lowBattery;
+constexpr int QualityGovernor::criticalBattery;
+
+namespace
+{
+
+// What each level sets, lowest first.  The top one is what the game ran
+// with before it had levels.
+struct Level
+{
+    int channels;
+    int midiVoices;
+    Mix_Resampler midiResampler;
+    Mix_ModResampler modResampler;
+    std::size_t particles;
+    float renderScale;
+};
+
+const Level levels[QualityGovernor::levelCount] = {
+    { 4, 32, MIX_RESAMPLE_NEAREST, MIX_MOD_RESAMPLE_NEAREST, 256, 0.625f },
+    { 6, 64, MIX_RESAMPLE_LINEAR, MIX_MOD_RESAMPLE_LINEAR, 1024, 0.75f },
+    { MIX_CHANNELS, 128, MIX_RESAMPLE_LINEAR, MIX_MOD_RESAMPLE_SPLINE, 2048, 0.875f },
+    { MIX_CHANNELS, 0, MIX_RESAMPLE_LINEAR, MIX_MOD_RESAMPLE_FIR, 4096, 1.f }
+};
+
+// AThermalStatus
+enum
+{
+    thermalModerate = 2,
+    thermalSevere = 3,
+    thermalCritical = 4
+};
+
+}
+
+#ifdef __ANDROID__
+
+struct QualityGovernor::Thermal
+{
+    void *library{ nullptr };
+    void *manager{ nullptr };
+    int (*getStatus)( void *manager ){ nullptr };
+    void (*release)( void *manager ){ nullptr };
+};
+
+#else
+
+struct QualityGovernor::Thermal
+{
+};
+
+#endif
+
+void QualityGovernor::start()
+{
+    current = levelCount - 1;
+    loadLevel = levelCount - 1;
+    calmPeriods = 0;
+    elapsed = 0.0;
+    frames = late = 0;
+    apply( current );
+}
+
+void QualityGovernor::close()
+{
+#ifdef __ANDROID__
+    if (thermal != nullptr)
+    {
+        thermal->release( thermal->manager );
+        dlclose( thermal->library );
+        delete thermal;
+    }
+#endif
+    thermal = nullptr;
+    thermalLookedUp = false;
+}
+
+void QualityGovernor::frameTime( double seconds )
+{
+    if (budget <= 0.0)
+        return;
+
+    ++frames;
+    if (seconds > budget * lateFactor)
+        ++late;
+    elapsed += seconds;
+    if (elapsed >= periodSeconds)
+    {
+        evaluate();
+        elapsed = 0.0;
+        frames = late = 0;
+    }
+}
+
+std::size_t QualityGovernor::particleLimit() const noexcept
+{
+    return levels[current].particles;
+}
+
+float QualityGovernor::maxRenderScale() const noexcept
+{
+    return levels[current].renderScale;
+}
+
+// The highest level the device's temperature allows
+int QualityGovernor::thermalCap()
+{
+#ifdef __ANDROID__
+    if (!thermalLookedUp)
+    {
+        thermalLookedUp = true;
+        void *android( dlopen( "libandroid.so", RTLD_NOW | RTLD_LOCAL ) );
+        if (android == nullptr)
+            return levelCount - 1;
+        auto acquire( reinterpret_cast<void* (*)()>(dlsym( android, "AThermal_acquireManager" )) );
+        auto getStatus( reinterpret_cast<int (*)( void* )>(dlsym( android, "AThermal_getCurrentThermalStatus" )) );
+        auto release( reinterpret_cast<void (*)( void* )>(dlsym( android, "AThermal_releaseManager" )) );
+        void *manager( acquire != nullptr && getStatus != nullptr && release != nullptr ? acquire() : nullptr );
+        if (manager == nullptr)
+        {
+            dlclose( android );
+            return levelCount - 1;
+        }
+        thermal = new Thermal{ android, manager, getStatus, release };
+    }
+    if (thermal == nullptr)
+        return levelCount - 1;
+
+    int status( thermal->getStatus( thermal->manager ) );
+    if (status >= thermalCritical)
+        return 0;
+    if (status == thermalSevere)
+        return 1;
+    if (status == thermalModerate)
+        return 2;
+#endif
+    return levelCount - 1;
+}
+
+// The highest level the battery left allows, any while charging
+int QualityGovernor::batteryCap() const
+{
+    int percent;
+    if (SDL_GetPowerInfo( nullptr, &percent ) != SDL_POWERSTATE_ON_BATTERY || percent < 0)
+        return levelCount - 1;
+    if (percent <= criticalBattery)
+        return 1;
+    if (percent <= lowBattery)
+        return 2;
+    return levelCount - 1;
+}
+
+void QualityGovernor::evaluate()
+{
+    double share( frames > 0 ? (double)late / frames : 0.0 );
+    if (share >= lateShare)
+    {
+        // Throttling that the thermal status doesn't show yet shows here
+        loadLevel = std::max( 0, std::min( loadLevel, current ) - 1 );
+        calmPeriods = 0;
+    }
+    else if (share > onTimeShare)
+        calmPeriods = 0;
+    else if (++calmPeriods >= recoverPeriods)
+    {
+        loadLevel = std::min( levelCount - 1, loadLevel + 1 );
+        calmPeriods = 0;
+    }
+
+    int target( std::min( { loadLevel, thermalCap(), batteryCap() } ) );
+    if (target != current)
+        apply( target );
+}
+
+void QualityGovernor::apply( int value )
+{
+    current = value;
+    const Level& level( levels[value] );
+
+    // Stealing picks what goes when there are fewer channels to play on
+    if (Mix_AllocateChannels( -1 ) != level.channels)
+        Mix_AllocateChannels( level.channels );
+    Mix_SetMIDIVoices( level.midiVoices );
+    Mix_SetMIDIResampler( level.midiResampler );
+
+    Mix_ModSettings mod;
+    Mix_GetModSettings( &mod );
+    mod.resampler = level.modResampler;
+    Mix_SetModSettings( &mod );
+
+    SDL_Log( "Quality level %d of %d\n", value + 1, levelCount );
+}
@@ -0,0 +1,87 @@
+//
+// Trades quality for time over a long session.  RenderScale reacts to a
+// few late frames within a second; this looks at how the device holds up
+// over minutes: its thermal status, how much battery it has left and how
+// many frames keep coming in late.  It picks one of a few quality levels
+// and sets the mixer's channels, the MIDI and ModPlug players' voices
+// and interpolation, how many particles the game bursts into and how
+// high the render scale goes to match.
+//
+// The thermal status comes from the NDK's AThermal, which only Android
+// 11 and up has, so it's looked up at runtime like trace.h does.
+//
+
+#ifndef ARKANOID_QUALITY_H
+#define ARKANOID_QUALITY_H
+
+#include <cstddef>
+
+#include <SDL.h>
+
+class QualityGovernor
+{
+public:
+    // Full quality is the highest, and what the game starts at
+    static constexpr int levelCount{ 4 };
+    // The device is looked at this often
+    static constexpr double periodSeconds{ 5.0 };
+    // A frame this far over the budget is late, as RenderScale counts it
+    static constexpr double lateFactor{ 1.2 };
+    // Periods with this share of late frames take a level away, and this
+    // many in a row with next to none give it back
+    static constexpr double lateShare{ 0.1 };
+    static constexpr double onTimeShare{ 0.01 };
+    static constexpr int recoverPeriods{ 6 };
+    // Battery left below which the levels are capped, in percent
+    static constexpr int lowBattery{ 30 };
+    static constexpr int criticalBattery{ 15 };
+
+    QualityGovernor() = default;
+    QualityGovernor( const QualityGovernor& ) = delete;
+    QualityGovernor& operator=( const QualityGovernor& ) = delete;
+    ~QualityGovernor() { close(); }
+
+    // Sets the knobs for full quality, once the mixer is open
+    void start();
+
+    // Lets go of the thermal service
+    void close();
+
+    // The time each frame has, as given to RenderScale::setBudget()
+    void setBudget( double seconds ) noexcept { budget = seconds; }
+
+    // The time from one present to the next, of frames that didn't wait
+    // for input.  Looks at the device once a period has passed.
+    void frameTime( double seconds );
+
+    int level() const noexcept { return current; }
+
+    // The most particles a burst leaves alive, see ParticleEmitter::setLimit()
+    std::size_t particleLimit() const noexcept;
+
+    // The highest the render scale goes, see RenderScale::limitScale()
+    float maxRenderScale() const noexcept;
+
+private:
+    struct Thermal;
+
+    Thermal *thermal{ nullptr };
+    bool thermalLookedUp{ false };
+
+    double budget{ 0.0 };
+    double elapsed{ 0.0 };
+    int frames{ 0 };
+    int late{ 0 };
+    int calmPeriods{ 0 };
+
+    // What the frame times alone would settle on, and the level set
+    int loadLevel{ levelCount - 1 };
+    int current{ levelCount - 1 };
+
+    int thermalCap();
+    int batteryCap() const;
+    void evaluate();
+    void apply( int value );
+};
+
+#endif // ARKANOID_QUALITY_H
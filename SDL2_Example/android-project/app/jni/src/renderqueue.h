@@ -0,0 +1,240 @@
+//
+// Draw calls recorded in any order and submitted sorted, so that draws
+// sharing a texture, blend mode and color go out back to back: the draw
+// color and blend mode are only set when they change, and a run of
+// filled or outlined rects is one SDL_RenderFillRects or
+// SDL_RenderDrawRects call.
+//
+// Layers are drawn in order, each over the ones before it.  Within a
+// layer draws are reordered freely, untextured ones first, so anything
+// that has to stay on top of something else goes in a later layer.
+//
+// Given a SpriteBatch, a flush goes out through it instead whenever it
+// can draw, as a draw or so per texture.
+//
+
+#ifndef RENDERQUEUE_H
+#define RENDERQUEUE_H
+
+#include <vector>
+#include <algorithm>
+#include <functional>
+
+#include <SDL.h>
+
+#include "spritebatch.h"
+
+class RenderQueue
+{
+public:
+    void fillRect( int layer, const SDL_Rect& rect, const SDL_Color& color,
+                   SDL_BlendMode blend = SDL_BLENDMODE_BLEND )
+    {
+        commands.emplace_back( Command{ layer, Fill, nullptr, blend, color, false, {}, rect, nullptr, 0 } );
+    }
+
+    // A whole array of filled rects as one draw, such as the particles of
+    // an emitter.  The array must stay as it is until the flush.
+    void fillRects( int layer, const SDL_Rect *rects, int count, const SDL_Color& color,
+                    SDL_BlendMode blend = SDL_BLENDMODE_BLEND )
+    {
+        if (count > 0)
+            commands.emplace_back( Command{ layer, Fill, nullptr, blend, color, false, {}, {}, rects, count } );
+    }
+
+    void drawRect( int layer, const SDL_Rect& rect, const SDL_Color& color,
+                   SDL_BlendMode blend = SDL_BLENDMODE_BLEND )
+    {
+        commands.emplace_back( Command{ layer, Outline, nullptr, blend, color, false, {}, rect, nullptr, 0 } );
+    }
+
+    void drawLine( int layer, int x1, int y1, int x2, int y2, const SDL_Color& color,
+                   SDL_BlendMode blend = SDL_BLENDMODE_BLEND )
+    {
+        // x2 and y2 ride in the rect's w and h
+        commands.emplace_back( Command{ layer, Line, nullptr, blend, color, false, {}, { x1, y1, x2, y2 }, nullptr, 0 } );
+    }
+
+    // The texture's own blend and color modulation apply, as with
+    // SDL_RenderCopy
+    void copy( int layer, SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect& dst )
+    {
+        commands.emplace_back( Command{ layer, Copy, texture, SDL_BLENDMODE_NONE, {},
+                                        src != nullptr, src != nullptr ? *src : SDL_Rect{}, dst, nullptr, 0 } );
+    }
+
+    bool empty() const noexcept { return commands.empty(); }
+
+    // Flush through `sprites`, or nullptr to always use the renderer
+    void setBatch( SpriteBatch *sprites ) noexcept { batch = sprites; }
+
+    // Submit everything recorded since the last flush to the renderer's
+    // current target.  The draw color and blend mode are left as the last
+    // draw set them, or as they were when the batch drew.
+    void flush( SDL_Renderer *renderer )
+    {
+        std::stable_sort( std::begin( commands ), std::end( commands ), drawsBefore );
+
+        if (batch != nullptr && batch->begin() && flushBatch( renderer ))
+        {
+            commands.clear();
+            return;
+        }
+
+        bool stateSet{ false };
+        SDL_BlendMode blend{ SDL_BLENDMODE_NONE };
+        SDL_Color color{};
+
+        for (std::size_t i{ 0 }; i < commands.size(); )
+        {
+            const Command& first( commands[i] );
+            std::size_t end{ i + 1 };
+            while (end < commands.size() && sameState( first, commands[end] ))
+                ++end;
+
+            if (first.kind == Copy)
+            {
+                for (std::size_t j{ i }; j < end; ++j)
+                    SDL_RenderCopy( renderer, first.texture, commands[j].hasSrc ? &commands[j].src : nullptr,
+                                    &commands[j].dst );
+                i = end;
+                continue;
+            }
+
+            if (!stateSet || blend != first.blend)
+                SDL_SetRenderDrawBlendMode( renderer, first.blend );
+            if (!stateSet || packColor( color ) != packColor( first.color ))
+                SDL_SetRenderDrawColor( renderer, first.color.r, first.color.g, first.color.b, first.color.a );
+            stateSet = true;
+            blend = first.blend;
+            color = first.color;
+
+            if (first.kind == Line)
+            {
+                for (std::size_t j{ i }; j < end; ++j)
+                {
+                    const SDL_Rect& line( commands[j].dst );
+                    SDL_RenderDrawLine( renderer, line.x, line.y, line.w, line.h );
+                }
+            }
+            else
+            {
+                rects.clear();
+                for (std::size_t j{ i }; j < end; ++j)
+                {
+                    if (commands[j].batch != nullptr)
+                        rects.insert( std::end( rects ), commands[j].batch,
+                                      commands[j].batch + commands[j].batchCount );
+                    else
+                        rects.emplace_back( commands[j].dst );
+                }
+                if (first.kind == Fill)
+                    SDL_RenderFillRects( renderer, rects.data(), (int)rects.size() );
+                else
+                    SDL_RenderDrawRects( renderer, rects.data(), (int)rects.size() );
+            }
+            i = end;
+        }
+        commands.clear();
+    }
+
+private:
+    enum Kind
+    {
+        Fill,
+        Outline,
+        Line,
+        Copy
+    };
+
+    struct Command
+    {
+        int layer;
+        Kind kind;
+        SDL_Texture *texture;
+        SDL_BlendMode blend;
+        SDL_Color color;
+        bool hasSrc;
+        SDL_Rect src;
+        SDL_Rect dst;
+        // Fills of a whole array, from fillRects()
+        const SDL_Rect *batch;
+        int batchCount;
+    };
+
+    // Kept from one flush to the next so they're not reallocated
+    std::vector<Command> commands;
+    std::vector<SDL_Rect> rects;
+    SpriteBatch *batch{ nullptr };
+
+    // A texture the batch can't read is copied by the renderer in between.
+    // Returns false, with the commands left for the renderer to draw, if
+    // the batch couldn't start again after that.
+    bool flushBatch( SDL_Renderer *renderer )
+    {
+        for (auto next( std::begin( commands ) ); next != std::end( commands ); ++next)
+        {
+            const Command& command( *next );
+            switch (command.kind)
+            {
+            case Fill:
+                if (command.batch != nullptr)
+                    for (int i{ 0 }; i < command.batchCount; ++i)
+                        batch->fillRect( command.batch[i], command.color, command.blend );
+                else
+                    batch->fillRect( command.dst, command.color, command.blend );
+                break;
+            case Outline:
+                batch->drawRect( command.dst, command.color, command.blend );
+                break;
+            case Line:
+                batch->drawLine( command.dst.x, command.dst.y, command.dst.w, command.dst.h,
+                                 command.color, command.blend );
+                break;
+            case Copy:
+                if (!batch->copy( command.texture, command.hasSrc ? &command.src : nullptr, command.dst ))
+                {
+                    batch->end();
+                    SDL_RenderCopy( renderer, command.texture, command.hasSrc ? &command.src : nullptr,
+                                    &command.dst );
+                    if (!batch->begin())
+                    {
+                        commands.erase( std::begin( commands ), next + 1 );
+                        return false;
+                    }
+                }
+                break;
+            }
+        }
+        batch->end();
+        return true;
+    }
+
+    static Uint32 packColor( const SDL_Color& color ) noexcept
+    {
+        return ((Uint32)color.r << 24) | ((Uint32)color.g << 16) | ((Uint32)color.b << 8) | color.a;
+    }
+
+    static bool drawsBefore( const Command& a, const Command& b ) noexcept
+    {
+        if (a.layer != b.layer)
+            return a.layer < b.layer;
+        if ((a.texture != nullptr) != (b.texture != nullptr))
+            return a.texture == nullptr;
+        if (a.texture != b.texture)
+            return std::less<SDL_Texture*>()( a.texture, b.texture );
+        if (a.blend != b.blend)
+            return a.blend < b.blend;
+        if (packColor( a.color ) != packColor( b.color ))
+            return packColor( a.color ) < packColor( b.color );
+        return a.kind < b.kind;
+    }
+
+    static bool sameState( const Command& a, const Command& b ) noexcept
+    {
+        return a.layer == b.layer && a.kind == b.kind && a.texture == b.texture &&
+               a.blend == b.blend && packColor( a.color ) == packColor( b.color );
+    }
+};
+
+#endif // RENDERQUEUE_H
@@ -0,0 +1,205 @@
+//
+// Dynamic resolution for a renderer with a logical size.  Below full scale
+// the scene is drawn into an offscreen target at that fraction of the
+// pixels the logical size covers on the display, and stretched over the
+// screen before it's presented, so a device short of fill rate draws
+// fewer pixels instead of missing frames.  The scale steps down as soon as
+// frames come in late and back up after a while of them being on time,
+// waiting longer each time a step up had to be taken back.
+//
+
+#ifndef ARKANOID_RENDERSCALE_H
+#define ARKANOID_RENDERSCALE_H
+
+#include <algorithm>
+#include <string>
+
+#include <SDL.h>
+
+class RenderScale
+{
+public:
+    // From half the pixels across up to all of them, an eighth at a time
+    static constexpr int levelCount{ 5 };
+    static constexpr float lowestScale{ 0.5f };
+    // A frame this far over the budget missed the refresh it was meant for
+    static constexpr double lateFactor{ 1.2 };
+    // Frames are judged this many at a time, and so many late among them
+    // step the scale down
+    static constexpr int windowFrames{ 30 };
+    static constexpr int lateFrames{ 3 };
+    // Time on budget before the next step up, doubled whenever one fails
+    static constexpr double upDelaySeconds{ 2.0 };
+    static constexpr double maxUpDelaySeconds{ 32.0 };
+
+    RenderScale( int width, int height ) noexcept
+        : logicalW( width ), logicalH( height )
+    {
+    }
+    RenderScale( const RenderScale& ) = delete;
+    RenderScale& operator=( const RenderScale& ) = delete;
+
+    // The time each frame has, such as the display's refresh period.  A
+    // new budget starts the scale search over.
+    void setBudget( double seconds ) noexcept
+    {
+        budget = seconds;
+        upDelay = upDelaySeconds;
+        steppedUp = false;
+        onTime = 0.0;
+        restartWindow();
+    }
+
+    float scale() const noexcept { return scaleOf( level ); }
+
+    // Keeps the scale at or below `highest`, as the quality level asks
+    void limitScale( float highest )
+    {
+        topLevel = 0;
+        while (topLevel < levelCount - 1 && scaleOf( topLevel + 1 ) <= highest)
+            ++topLevel;
+        if (level > topLevel)
+            setLevel( topLevel );
+    }
+
+    // Makes the target for the renderer's output size, again after the
+    // output changed size or the renderer lost its textures.  Without
+    // render targets the scene is always drawn at full scale.
+    void create( SDL_Renderer *renderer )
+    {
+        destroy();
+        if (!SDL_RenderTargetSupported( renderer ))
+            return;
+
+        // The pixels the logical size is letterboxed into
+        int outputW, outputH;
+        if (SDL_GetRendererOutputSize( renderer, &outputW, &outputH ) != 0)
+            return;
+        float fit{ std::min( (float)outputW / logicalW, (float)outputH / logicalH ) };
+        fullW = std::max( 1, (int)(logicalW * fit) );
+        fullH = std::max( 1, (int)(logicalH * fit) );
+
+        // Stretched smoothly, without changing how any other texture is
+        const char *quality( SDL_GetHint( SDL_HINT_RENDER_SCALE_QUALITY ) );
+        const std::string previous( quality != nullptr ? quality : "" );
+        SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, "1" );
+        target = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_TARGET,
+                                    fullW, fullH );
+        SDL_SetHint( SDL_HINT_RENDER_SCALE_QUALITY, quality != nullptr ? previous.c_str() : nullptr );
+        if (target == nullptr)
+            SDL_Log( "CreateTexture error: %s", SDL_GetError() );
+        else
+            SDL_SetTextureBlendMode( target, SDL_BLENDMODE_NONE );
+    }
+
+    // Must be called before the renderer goes away
+    void destroy()
+    {
+        if (target != nullptr)
+            SDL_DestroyTexture( target );
+        target = nullptr;
+    }
+
+    // Points drawing at the scene, in logical coordinates, which is also
+    // where to go back to after drawing into another target
+    void bind( SDL_Renderer *renderer )
+    {
+        if (!scaled())
+        {
+            SDL_SetRenderTarget( renderer, nullptr );
+            return;
+        }
+        SDL_SetRenderTarget( renderer, target );
+        // The viewport is given in scaled coordinates, so the scale goes first
+        SDL_RenderSetScale( renderer, sceneW() / (float)logicalW, sceneH() / (float)logicalH );
+        SDL_Rect viewport{ 0, 0, logicalW, logicalH };
+        SDL_RenderSetViewport( renderer, &viewport );
+    }
+
+    // Stretches the scene over the screen, which is drawn to from then on
+    void resolve( SDL_Renderer *renderer )
+    {
+        if (!scaled())
+            return;
+        SDL_SetRenderTarget( renderer, nullptr );
+        SDL_SetRenderDrawColor( renderer, 0, 0, 0, 255 );
+        SDL_RenderClear( renderer );
+        SDL_Rect src{ 0, 0, sceneW(), sceneH() };
+        SDL_Rect dst{ 0, 0, logicalW, logicalH };
+        SDL_RenderCopy( renderer, target, &src, &dst );
+    }
+
+    // The time from the last frame's present to this one's.  Frames that
+    // waited on anything but the renderer, such as for input, don't count.
+    void frameTime( double seconds )
+    {
+        if (budget <= 0.0)
+            return;
+
+        bool late( seconds > budget * lateFactor );
+        if (late)
+        {
+            ++lateCount;
+            onTime = 0.0;
+        }
+        else
+            onTime += seconds;
+
+        if (++windowCount == windowFrames)
+        {
+            if (lateCount >= lateFrames && level > 0)
+            {
+                // The step up that led here is put off for longer next time
+                if (steppedUp)
+                    upDelay = std::min( upDelay * 2.0, (double)maxUpDelaySeconds );
+                steppedUp = false;
+                setLevel( level - 1 );
+            }
+            restartWindow();
+        }
+        else if (onTime >= upDelay && level < topLevel)
+        {
+            steppedUp = true;
+            setLevel( level + 1 );
+            restartWindow();
+        }
+    }
+
+private:
+    int logicalW, logicalH;
+    int fullW{ 0 }, fullH{ 0 };
+    SDL_Texture *target{ nullptr };
+
+    int level{ levelCount - 1 };
+    int topLevel{ levelCount - 1 };
+    double budget{ 0.0 };
+    double upDelay{ upDelaySeconds };
+    bool steppedUp{ false };
+    int windowCount{ 0 };
+    int lateCount{ 0 };
+    double onTime{ 0.0 };
+
+    static float scaleOf( int value ) noexcept
+    {
+        return lowestScale + (1.f - lowestScale) * value / (levelCount - 1);
+    }
+
+    bool scaled() const noexcept { return target != nullptr && level < levelCount - 1; }
+    int sceneW() const noexcept { return std::max( 1, (int)(fullW * scale()) ); }
+    int sceneH() const noexcept { return std::max( 1, (int)(fullH * scale()) ); }
+
+    void setLevel( int value )
+    {
+        level = value;
+        onTime = 0.0;
+        SDL_Log( "Render scale %d%%\n", (int)(scale() * 100) );
+    }
+
+    void restartWindow() noexcept
+    {
+        windowCount = 0;
+        lateCount = 0;
+    }
+};
+
+#endif // ARKANOID_RENDERSCALE_H
@@ -0,0 +1,59 @@
+//
+// A texture that keeps the surface it was made from.  When the renderer
+// loses its textures, as it can while the app is in the background, the
+// texture is dropped and uploaded again from the surface the next time
+// it's drawn, instead of being rendered over from the assets.
+//
+
+#ifndef ARKANOID_RETAINED_H
+#define ARKANOID_RETAINED_H
+
+#include <SDL.h>
+
+class RetainedTexture
+{
+public:
+    RetainedTexture() = default;
+    RetainedTexture( const RetainedTexture& ) = delete;
+    RetainedTexture& operator=( const RetainedTexture& ) = delete;
+    ~RetainedTexture() { reset(); }
+
+    // Takes over `image`, which replaces the one kept so far
+    void reset( SDL_Surface *image = nullptr )
+    {
+        release();
+        if (surface != nullptr)
+            SDL_FreeSurface( surface );
+        surface = image;
+    }
+
+    // Uploads the surface if it isn't already, nullptr without one or if
+    // the upload failed
+    SDL_Texture* get( SDL_Renderer *renderer )
+    {
+        if (texture == nullptr && surface != nullptr)
+        {
+            texture = SDL_CreateTextureFromSurface( renderer, surface );
+            if (texture == nullptr)
+                SDL_Log( "CreateTexture error: %s", SDL_GetError() );
+        }
+        return texture;
+    }
+
+    // Drops the texture and keeps the surface.  Must be called before the
+    // renderer goes away, or once it has lost its textures.
+    void release()
+    {
+        if (texture != nullptr)
+            SDL_DestroyTexture( texture );
+        texture = nullptr;
+    }
+
+    explicit operator bool() const noexcept { return surface != nullptr; }
+
+private:
+    SDL_Surface *surface{ nullptr };
+    SDL_Texture *texture{ nullptr };
+};
+
+#endif // ARKANOID_RETAINED_H
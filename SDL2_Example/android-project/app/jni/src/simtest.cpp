@@ -0,0 +1,55 @@
+//
+// simtest: checks the arkanoid simulation against paths worked out by
+// hand and prints what doesn't match.  Build it like arkbench, from this
+// file and simulation.cpp against SDL2 and SDL2_mixer.  It exits with 1
+// if a check fails.
+//
+
+#include <cstdio>
+#include <cmath>
+
+#include "simulation.h"
+
+static int failures{ 0 };
+
+static void check( bool passed, const char *what )
+{
+    printf( "%-4s %s\n", passed ? "ok" : "FAIL", what );
+    if (!passed)
+        ++failures;
+}
+
+// A ball steps from near the top left corner into both walls.  Folded back
+// at them its path ends where it would have gone past them, mirrored, less
+// the hair it backs off each wall by.  Each bounce must leave the ball
+// only what the last one left of the step.
+static void checkCornerBounce()
+{
+    Simulation sim;
+    const float r{ Ball::defRadius };
+    const float startX{ r + 30.f }, startY{ r + 70.f };
+
+    sim.setStepRate( 4 );
+    sim.reset();
+    Ball& ball( sim.manager.create<Ball>( startX, startY ) );
+    ball.velocity = { -Ball::defVelocity, -Ball::defVelocity };
+
+    sim.step();
+
+    float ticks{ (float)(sim.stepLength() / Simulation::tickSeconds) };
+    float endX{ 2.f * r - (startX - Ball::defVelocity * ticks) };
+    float endY{ 2.f * r - (startY - Ball::defVelocity * ticks) };
+    check( ball.velocity.x > 0.f && ball.velocity.y > 0.f, "two bounces in one step turn the ball around" );
+    check( std::abs( ball.x - endX ) < 0.1f && std::abs( ball.y - endY ) < 0.1f,
+           "two bounces in one step leave the ball the rest of the step" );
+}
+
+int main( int argc, char *argv[] )
+{
+    (void)argc;
+    (void)argv;
+
+    checkCornerBounce();
+
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,465 @@
+//
+// The parts of the simulation that live outside its header
+//
+
+#include "simulation.h"
+
+// Every ABI the game ships for has these, as does any x86-64 arkbench is
+// built on, so they're picked when compiling rather than at runtime
+#if defined( __SSE2__ ) || defined( _M_X64 ) || defined( _M_AMD64 ) || ( defined( _M_IX86_FP ) && _M_IX86_FP >= 2 )
+#define HAVE_SSE2_INTRINSICS 1
+#include <emmintrin.h>
+#elif defined( __ARM_NEON ) || defined( __ARM_NEON__ ) || defined( __aarch64__ )
+#define HAVE_NEON_INTRINSICS 1
+#include <arm_neon.h>
+#endif
+
+SDL_Rect gScreenRect = { 0, 0, 800, 600 };
+SDL_Point gTouchLocation = { gScreenRect.w / 2, gScreenRect.h / 2 };
+
+Mix_Chunk *gHitPaddle = nullptr;
+Mix_Chunk *gHitBrick = nullptr;
+Mix_Chunk *gMissedPaddle = nullptr;
+
+SoundQueue gSounds;
+
+const SDL_Color Ball::defColor{ 255,0,0,255 };
+
+const SDL_Color Paddle::defColor{ 255,0,0,255 };
+
+unsigned Brick::revision{ 0 };
+
+const SDL_Color Brick::defColorHits1{ 255, 255, 0, 80 };
+const SDL_Color Brick::defColorHits2{ 255, 255, 0, 170 };
+const SDL_Color Brick::defColorHits3{ 255, 255, 0, 255 };
+
+std::uint32_t BrickField::add( float mX, float mY, float mW, float mH, int mHits )
+{
+    x.emplace_back( mX );
+    y.emplace_back( mY );
+    w.emplace_back( mW );
+    h.emplace_back( mH );
+    hits.emplace_back( mHits );
+    ++Brick::revision;
+
+    return hits.size() - 1;
+}
+
+void BrickField::assign( std::size_t count, const void *arrays )
+{
+    static_assert(sizeof(float) == 4 && sizeof(int) == 4, "the level format has 32 bit values");
+    const Uint8 *src{ static_cast<const Uint8*>(arrays) };
+
+    for (auto column : { &x, &y, &w, &h })
+    {
+        column->resize( count );
+        SDL_memcpy( column->data(), src, count * sizeof(float) );
+        src += count * sizeof(float);
+    }
+    hits.resize( count );
+    SDL_memcpy( hits.data(), src, count * sizeof(int) );
+
+#if SDL_BYTEORDER == SDL_BIG_ENDIAN
+    for (auto column : { &x, &y, &w, &h })
+        for (auto& value : *column)
+            value = SDL_SwapFloatLE( value );
+    for (auto& value : hits)
+        value = SDL_SwapLE32( value );
+#endif
+    ++Brick::revision;
+}
+
+constexpr std::size_t BrickField::maskLanes;
+
+// Four bricks' centres, sizes and hits against the box, the low four bits
+// of the mask
+static std::uint32_t overlapMask4( const float *x, const float *y, const float *w, const float *h,
+                                   const int *hits, float l, float t, float r, float b ) noexcept
+{
+#if defined( HAVE_SSE2_INTRINSICS )
+    const __m128 half{ _mm_set1_ps( 0.5f ) };
+    __m128 cx{ _mm_loadu_ps( x ) }, cy{ _mm_loadu_ps( y ) };
+    __m128 hw{ _mm_mul_ps( _mm_loadu_ps( w ), half ) }, hh{ _mm_mul_ps( _mm_loadu_ps( h ), half ) };
+    __m128 in{ _mm_and_ps( _mm_cmpge_ps( _mm_add_ps( cx, hw ), _mm_set1_ps( l ) ),
+                           _mm_cmple_ps( _mm_sub_ps( cx, hw ), _mm_set1_ps( r ) ) ) };
+    in = _mm_and_ps( in, _mm_and_ps( _mm_cmpge_ps( _mm_add_ps( cy, hh ), _mm_set1_ps( t ) ),
+                                     _mm_cmple_ps( _mm_sub_ps( cy, hh ), _mm_set1_ps( b ) ) ) );
+    __m128i standing{ _mm_cmpgt_epi32( _mm_loadu_si128( reinterpret_cast<const __m128i*>(hits) ),
+                                       _mm_setzero_si128() ) };
+    return (std::uint32_t)_mm_movemask_ps( _mm_and_ps( in, _mm_castsi128_ps( standing ) ) );
+#elif defined( HAVE_NEON_INTRINSICS )
+    static const std::uint32_t bits[4]{ 1, 2, 4, 8 };
+    float32x4_t cx{ vld1q_f32( x ) }, cy{ vld1q_f32( y ) };
+    float32x4_t hw{ vmulq_n_f32( vld1q_f32( w ), 0.5f ) }, hh{ vmulq_n_f32( vld1q_f32( h ), 0.5f ) };
+    uint32x4_t in{ vandq_u32( vcgeq_f32( vaddq_f32( cx, hw ), vdupq_n_f32( l ) ),
+                              vcleq_f32( vsubq_f32( cx, hw ), vdupq_n_f32( r ) ) ) };
+    in = vandq_u32( in, vandq_u32( vcgeq_f32( vaddq_f32( cy, hh ), vdupq_n_f32( t ) ),
+                                   vcleq_f32( vsubq_f32( cy, hh ), vdupq_n_f32( b ) ) ) );
+    in = vandq_u32( in, vcgtq_s32( vld1q_s32( hits ), vdupq_n_s32( 0 ) ) );
+    uint32x4_t picked{ vandq_u32( in, vld1q_u32( bits ) ) };
+    uint32x2_t sum{ vadd_u32( vget_low_u32( picked ), vget_high_u32( picked ) ) };
+    return vget_lane_u32( vpadd_u32( sum, sum ), 0 );
+#else
+    std::uint32_t mask{ 0 };
+    for (int i{ 0 }; i < 4; ++i)
+    {
+        float hw{ w[i] * 0.5f }, hh{ h[i] * 0.5f };
+        if (x[i] + hw >= l && x[i] - hw <= r && y[i] + hh >= t && y[i] - hh <= b && hits[i] > 0)
+            mask |= 1u << i;
+    }
+    return mask;
+#endif
+}
+
+std::uint32_t BrickField::overlapMask( std::size_t first, float l, float t, float r, float b ) const noexcept
+{
+    std::uint32_t mask{ 0 };
+    std::size_t count{ hits.size() };
+
+    for (std::size_t i{ first }; i < first + maskLanes && i < count; i += 4)
+    {
+        if (i + 4 <= count)
+        {
+            mask |= overlapMask4( &x[i], &y[i], &w[i], &h[i], &hits[i], l, t, r, b ) << (i - first);
+            continue;
+        }
+
+        // The last few, with bricks that are already gone after them
+        float cx[4]{}, cy[4]{}, cw[4]{}, ch[4]{};
+        int chits[4]{};
+        for (std::size_t j{ 0 }; i + j < count; ++j)
+        {
+            cx[j] = x[i + j];
+            cy[j] = y[i + j];
+            cw[j] = w[i + j];
+            ch[j] = h[i + j];
+            chits[j] = hits[i + j];
+        }
+        mask |= overlapMask4( cx, cy, cw, ch, chits, l, t, r, b ) << (i - first);
+    }
+    return mask;
+}
+
+std::uint32_t BrickField::overlapMask( const std::uint32_t *rows, std::size_t count,
+                                       float l, float t, float r, float b ) const noexcept
+{
+    // Gathered into lanes, anything past `count` already gone
+    float cx[maskLanes]{}, cy[maskLanes]{}, cw[maskLanes]{}, ch[maskLanes]{};
+    int chits[maskLanes]{};
+
+    count = std::min( count, maskLanes );
+    for (std::size_t i{ 0 }; i < count; ++i)
+    {
+        cx[i] = x[rows[i]];
+        cy[i] = y[rows[i]];
+        cw[i] = w[rows[i]];
+        ch[i] = h[rows[i]];
+        chits[i] = hits[rows[i]];
+    }
+
+    std::uint32_t mask{ 0 };
+    for (std::size_t i{ 0 }; i < count; i += 4)
+        mask |= overlapMask4( cx + i, cy + i, cw + i, ch + i, chits + i, l, t, r, b ) << i;
+    return mask;
+}
+
+void BrickField::draw( ShapeBatch& shapes ) const
+{
+    for (std::size_t i{ 0 }; i < hits.size(); ++i)
+    {
+        if (hits[i] <= 0)
+            continue;
+        SDL_Rect rect = { (int)(x[i] - w[i] / 2.f), (int)(y[i] - h[i] / 2.f), (int)w[i], (int)h[i] };
+
+        // Let's alter the color of the brick depending on the
+        // required hits.
+        if (hits[i] == 1)
+            shapes.addRect( rect, Brick::defColorHits1 );
+        else if (hits[i] == 2)
+            shapes.addRect( rect, Brick::defColorHits2 );
+        else
+            shapes.addRect( rect, Brick::defColorHits3 );
+    }
+}
+
+void SoundQueue::flush()
+{
+    Mix_Chunk *const chunks[(int)Sound::Count]{ gHitPaddle, gHitBrick, gMissedPaddle };
+    int order[(int)Sound::Count];
+    int count{ 0 };
+
+    for (int i{ 0 }; i < (int)Sound::Count; ++i)
+        if (pending[i].posted)
+            order[count++] = i;
+    std::stable_sort( order, order + count,
+                      [this]( int a, int b ) { return pending[a].priority > pending[b].priority; } );
+
+    for (int i{ 0 }; i < count; ++i)
+    {
+        pending[order[i]].posted = false;
+        if (chunks[order[i]] != nullptr)
+            Mix_QueuePlayChannel( -1, chunks[order[i]], 0 );
+    }
+}
+
+constexpr std::uint32_t LevelPack::magic;
+constexpr std::uint32_t LevelPack::version;
+constexpr std::size_t LevelPack::headerSize;
+constexpr std::size_t LevelPack::entrySize;
+constexpr std::size_t LevelPack::brickSize;
+
+static std::uint32_t readLE32( const Uint8 *p ) noexcept
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((std::uint32_t)p[3] << 24);
+}
+
+bool LevelPack::open( const void *data, std::size_t size )
+{
+    bytes = static_cast<const Uint8*>(data);
+    levels = 0;
+
+    if (size < headerSize || readLE32( bytes ) != magic)
+    {
+        SDL_SetError( "Not a level pack" );
+        return false;
+    }
+    if (readLE32( bytes + 4 ) != version)
+    {
+        SDL_SetError( "Unsupported level pack version %u", (unsigned)readLE32( bytes + 4 ) );
+        return false;
+    }
+
+    std::uint32_t count{ readLE32( bytes + 8 ) };
+    if (count > (size - headerSize) / entrySize)
+    {
+        SDL_SetError( "Level pack truncated" );
+        return false;
+    }
+    for (std::uint32_t i{ 0 }; i < count; ++i)
+    {
+        const Uint8 *entry{ bytes + headerSize + i * entrySize };
+        std::uint32_t offset{ readLE32( entry ) }, bricks{ readLE32( entry + 4 ) };
+        if (offset > size || bricks > (size - offset) / brickSize)
+        {
+            SDL_SetError( "Level %u lies outside the level pack", (unsigned)i );
+            return false;
+        }
+    }
+
+    levels = count;
+    return true;
+}
+
+bool LevelPack::load( std::size_t level, BrickField& field ) const
+{
+    if (level >= levels)
+        return false;
+
+    const Uint8 *entry{ bytes + headerSize + level * entrySize };
+    field.assign( readLE32( entry + 4 ), bytes + readLE32( entry ) );
+    return true;
+}
+
+void hitPaddle( const Paddle& mPaddle, Ball& mBall ) noexcept
+{
+    mBall.velocity.y = -Ball::defVelocity;
+    mBall.velocity.x =
+            mBall.x < mPaddle.x ? -Ball::defVelocity : Ball::defVelocity;
+
+    gSounds.post( Sound::HitPaddle, 1 );
+}
+
+void hitBrick( const Brick& mBrick ) noexcept
+{
+    // Instead of immediately destroying the brick upon collision,
+    // we decrease its required hits, it's gone once they run out.
+    --mBrick.requiredHits();
+    ++Brick::revision;
+
+    gSounds.post( Sound::HitBrick, 0 );
+}
+
+void solvePaddleBallCollision( const Paddle& mPaddle, Ball& mBall ) noexcept
+{
+    if (!isIntersecting( mPaddle, mBall ))
+        return;
+
+    hitPaddle( mPaddle, mBall );
+}
+
+void solveBrickBallCollision( const Brick& mBrick, Ball& mBall ) noexcept
+{
+    if (!isIntersecting( mBrick, mBall ))
+        return;
+
+    hitBrick( mBrick );
+
+    float overlapLeft{ mBall.right() - mBrick.left() };
+    float overlapRight{ mBrick.right() - mBall.left() };
+    float overlapTop{ mBall.bottom() - mBrick.top() };
+    float overlapBottom{ mBrick.bottom() - mBall.top() };
+
+    bool ballFromLeft( std::abs( overlapLeft ) < std::abs( overlapRight ) );
+    bool ballFromTop( std::abs( overlapTop ) < std::abs( overlapBottom ) );
+
+    float minOverlapX{ ballFromLeft ? overlapLeft : overlapRight };
+    float minOverlapY{ ballFromTop ? overlapTop : overlapBottom };
+
+    if (std::abs( minOverlapX ) < std::abs( minOverlapY ))
+        mBall.velocity.x =
+                ballFromLeft ? -Ball::defVelocity : Ball::defVelocity;
+    else
+        mBall.velocity.y = ballFromTop ? -Ball::defVelocity : Ball::defVelocity;
+}
+
+// Turn the ball away from the face or corner it touched
+void bounceBall( Ball& mBall, const Vector2f& normal ) noexcept
+{
+    if (std::abs( normal.x ) > std::abs( normal.y ))
+        mBall.velocity.x = normal.x < 0.f ? -Ball::defVelocity : Ball::defVelocity;
+    else
+        mBall.velocity.y = normal.y < 0.f ? -Ball::defVelocity : Ball::defVelocity;
+}
+
+void Simulation::sweepBall( Ball& mBall )
+{
+    float ticks{ (float)(stepSeconds / tickSeconds) };
+    Vector2f from{ mBall.prevX, mBall.prevY };
+    Vector2f motion{ mBall.x - from.x, mBall.y - from.y };
+    Vector2f normal, n;
+    // Ticks of the step the ball still has to move, each bounce uses up
+    // its share of what was left
+    float remaining{ ticks };
+
+    touchingBricks.clear();
+    touchingPaddles.clear();
+
+    int bounce{ 0 };
+    for (; bounce < maxBounces; ++bounce)
+    {
+        SweptBounds bounds{ std::min( from.x, from.x + motion.x ) - mBall.radius,
+                            std::min( from.y, from.y + motion.y ) - mBall.radius,
+                            std::max( from.x, from.x + motion.x ) + mBall.radius,
+                            std::max( from.y, from.y + motion.y ) + mBall.radius };
+        float first{ 2.f };
+        std::uint32_t brickHit{ 0 };
+        Paddle *paddleHit{ nullptr };
+        bool wallHit{ false };
+
+        // The side and top walls, the bottom is open and loses the ball
+        if (motion.x < 0.f && from.x - mBall.radius >= 0.f)
+            sweepWall( (mBall.radius - from.x) / motion.x, { 1.f, 0.f }, first, normal, wallHit );
+        else if (motion.x > 0.f && from.x + mBall.radius <= gScreenRect.w)
+            sweepWall( (gScreenRect.w - mBall.radius - from.x) / motion.x, { -1.f, 0.f }, first, normal, wallHit );
+        if (motion.y < 0.f && from.y - mBall.radius >= 0.f)
+            sweepWall( (mBall.radius - from.y) / motion.y, { 0.f, 1.f }, first, normal, wallHit );
+
+        // Only bricks whose boxes overlap the swept bounds can be reached,
+        // the batch test keeps those for the sweeps below in the order they
+        // came in
+        if (broadphase)
+        {
+            brickGrid.query( bounds, nearbyBricks );
+            std::size_t kept{ 0 };
+            for (std::size_t i{ 0 }; i < nearbyBricks.size(); i += BrickField::maskLanes)
+            {
+                std::size_t count{ std::min( BrickField::maskLanes, nearbyBricks.size() - i ) };
+                std::uint32_t mask{ bricks.overlapMask( &nearbyBricks[i], count, bounds.l, bounds.t, bounds.r, bounds.b ) };
+                for (std::size_t lane{ 0 }; lane < count; ++lane)
+                    if (mask & (1u << lane))
+                        nearbyBricks[kept++] = nearbyBricks[i + lane];
+            }
+            nearbyBricks.resize( kept );
+        }
+        else
+        {
+            nearbyBricks.clear();
+            for (std::size_t row{ 0 }; row < bricks.size(); row += BrickField::maskLanes)
+            {
+                std::uint32_t mask{ bricks.overlapMask( row, bounds.l, bounds.t, bounds.r, bounds.b ) };
+                for (std::size_t lane{ 0 }; mask != 0; ++lane, mask >>= 1)
+                    if (mask & 1u)
+                        nearbyBricks.emplace_back( (std::uint32_t)(row + lane) );
+            }
+        }
+        for (auto row : nearbyBricks)
+        {
+            float t{ sweepCircleBox( from, motion, mBall.radius, Brick{ bricks, row }, n ) };
+            if (t == 0.f && n.x == 0.f && n.y == 0.f)
+            {
+                if (std::find( std::begin( touchingBricks ), std::end( touchingBricks ), row ) == std::end( touchingBricks ))
+                    touchingBricks.emplace_back( row );
+            }
+            else if (t < first)
+            {
+                first = t;
+                normal = n;
+                brickHit = row;
+                wallHit = false;
+            }
+        }
+        manager.forEach<Paddle>( [&]( auto& mPaddle )
+                                 {
+                                     float t{ sweepCircleBox( from, motion, mBall.radius, mPaddle, n ) };
+                                     if (t == 0.f && n.x == 0.f && n.y == 0.f)
+                                     {
+                                         if (std::find( std::begin( touchingPaddles ), std::end( touchingPaddles ), &mPaddle ) == std::end( touchingPaddles ))
+                                             touchingPaddles.emplace_back( &mPaddle );
+                                     }
+                                     else if (t < first)
+                                     {
+                                         first = t;
+                                         normal = n;
+                                         paddleHit = &mPaddle;
+                                         wallHit = false;
+                                     }
+                                 } );
+
+        if (first > 1.f)
+            break;
+
+        // Back off a hair so the ball ends up just clear of what it hit
+        float length{ std::sqrt( motion.x * motion.x + motion.y * motion.y ) };
+        float t{ std::max( 0.f, first - 0.01f / length ) };
+        from = { from.x + motion.x * t, from.y + motion.y * t };
+        mBall.x = from.x;
+        mBall.y = from.y;
+
+        if (wallHit)
+            bounceBall( mBall, normal );
+        else if (paddleHit != nullptr)
+            hitPaddle( *paddleHit, mBall );
+        else
+        {
+            Brick brick{ bricks, brickHit };
+            hitBrick( brick );
+            bounceBall( mBall, normal );
+            if (brick.destroyed())
+                brickDestroyed( brick );
+        }
+
+        remaining *= (1.f - t);
+        motion = { mBall.velocity.x * remaining, mBall.velocity.y * remaining };
+        mBall.x = from.x + motion.x;
+        mBall.y = from.y + motion.y;
+    }
+
+    // Out of bounces, the rest of the path was never checked
+    if (bounce == maxBounces)
+    {
+        mBall.x = from.x;
+        mBall.y = from.y;
+    }
+
+    for (auto row : touchingBricks)
+    {
+        Brick brick{ bricks, row };
+        if (brick.destroyed())
+            continue;
+        solveBrickBallCollision( brick, mBall );
+        if (brick.destroyed())
+            brickDestroyed( brick );
+    }
+    for (auto paddle : touchingPaddles)
+        solvePaddleBallCollision( *paddle, mBall );
+}
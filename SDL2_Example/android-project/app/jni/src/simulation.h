@@ -0,0 +1,1164 @@
+//
+// The play field of the game: the entities, the bricks and the collisions
+// between them, stepped without a window, renderer or audio device so the
+// game and the headless arkbench share it.
+//
+
+#ifndef ARKANOID_SIMULATION_H
+#define ARKANOID_SIMULATION_H
+
+#include <vector>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <functional>
+#include <tuple>
+#include <type_traits>
+
+#include <SDL.h>
+#include <SDL_mixer.h>      // sound library
+
+#include "renderqueue.h"
+#include "particles.h"
+
+// global vars, TODO - move these into the game
+extern SDL_Rect gScreenRect;
+extern SDL_Point gTouchLocation;
+
+//The sound effects played on collisions, nothing is played while they're nullptr
+extern Mix_Chunk *gHitPaddle;
+extern Mix_Chunk *gHitBrick;
+extern Mix_Chunk *gMissedPaddle;
+
+// The sounds of the game, with the chunks above
+enum class Sound
+{
+    HitPaddle,
+    HitBrick,
+    MissedPaddle,
+    Count
+};
+
+// Sounds asked for during a frame.  Collisions only post them, whoever
+// runs the simulation plays them with one flush() a frame, so nothing
+// inside a step touches the mixer.
+class SoundQueue
+{
+public:
+    // Posting a sound again before the next flush only raises its priority
+    void post( Sound sound, int priority ) noexcept
+    {
+        Pending& mPending( pending[(int)sound] );
+        if (!mPending.posted || priority > mPending.priority)
+            mPending.priority = priority;
+        mPending.posted = true;
+    }
+
+    // Queue each sound posted since the last flush on the mixer once, the
+    // most important first, in case the mixer's command queue fills up
+    void flush();
+
+private:
+    struct Pending
+    {
+        bool posted{ false };
+        int priority{ 0 };
+    };
+
+    Pending pending[(int)Sound::Count];
+};
+
+extern SoundQueue gSounds;
+
+// Collects the filled shapes of a frame for a RenderQueue, which draws all
+// of those sharing a color with one SDL_RenderFillRects call, rather than
+// a call or two per brick and per scanline of every ball.  Circles are
+// drawn from a sprite rasterized once for each radius and color.
+class ShapeBatch
+{
+public:
+    void addRect( const SDL_Rect& rect, const SDL_Color& color )
+    {
+        rectsFor( color ).emplace_back( rect );
+    }
+
+    void addCircle( int cx, int cy, int radius, const SDL_Color& color )
+    {
+        circles.emplace_back( CircleDraw{ cx, cy, radius, color } );
+    }
+
+    // Queue the shapes in `layer`, the renderer is only needed to make the
+    // circle sprites
+    void flush( SDL_Renderer *renderer, RenderQueue& queue, int layer,
+                SDL_BlendMode blend = SDL_BLENDMODE_BLEND )
+    {
+        // A circle without a sprite is filled as scanlines with the rects
+        for (auto& circle : circles)
+        {
+            SDL_Texture *sprite( spriteFor( renderer, circle.radius, circle.color ) );
+            if (sprite == nullptr)
+                addScanlines( circle.cx, circle.cy, circle.radius, circle.color );
+            else
+            {
+                SDL_Rect dst{ circle.cx - circle.radius, circle.cy - circle.radius,
+                              2 * circle.radius + 1, 2 * circle.radius + 1 };
+                queue.copy( layer, sprite, nullptr, dst );
+            }
+        }
+        circles.clear();
+
+        for (auto& group : groups)
+        {
+            for (auto& rect : group.rects)
+                queue.fillRect( layer, rect, group.color, blend );
+            group.rects.clear();
+        }
+    }
+
+    // Take over the shapes another batch collected, that one is left this
+    // one's emptied arrays to fill again
+    void take( ShapeBatch& other ) noexcept
+    {
+        groups.swap( other.groups );
+        circles.swap( other.circles );
+    }
+
+    // Must be called before the renderer the sprites belong to goes away
+    void destroySprites()
+    {
+        releaseSprites();
+        sprites.clear();
+    }
+
+    // Drop the sprites' textures but keep their pixels, for when the
+    // renderer lost its textures.  They're uploaded again as they're drawn.
+    void releaseSprites()
+    {
+        for (auto& sprite : sprites)
+        {
+            if (sprite.texture != nullptr)
+                SDL_DestroyTexture( sprite.texture );
+            sprite.texture = nullptr;
+        }
+    }
+
+private:
+    struct Group
+    {
+        SDL_Color color;
+        std::vector<SDL_Rect> rects;
+    };
+
+    struct CircleDraw
+    {
+        int cx, cy, radius;
+        SDL_Color color;
+    };
+
+    struct Sprite
+    {
+        int radius;
+        SDL_Color color;
+        std::vector<Uint32> pixels;
+        SDL_Texture *texture;   // nullptr if it couldn't be made, or was released
+    };
+
+    // A frame only uses a handful of colors.  The groups are kept from one
+    // frame to the next so their arrays are not reallocated.
+    std::vector<Group> groups;
+    std::vector<CircleDraw> circles;
+    std::vector<Sprite> sprites;
+
+    static bool sameColor( const SDL_Color& a, const SDL_Color& b ) noexcept
+    {
+        return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+    }
+
+    std::vector<SDL_Rect>& rectsFor( const SDL_Color& color )
+    {
+        for (auto& group : groups)
+            if (sameColor( group.color, color ))
+                return group.rects;
+        groups.emplace_back( Group{ color, {} } );
+        return groups.back().rects;
+    }
+
+    SDL_Texture* spriteFor( SDL_Renderer *renderer, int radius, const SDL_Color& color )
+    {
+        for (auto& sprite : sprites)
+            if (sprite.radius == radius && sameColor( sprite.color, color ))
+            {
+                if (sprite.texture == nullptr && !sprite.pixels.empty())
+                    sprite.texture = uploadSprite( renderer, sprite );
+                return sprite.texture;
+            }
+        sprites.emplace_back( Sprite{ radius, color, rasterizeSprite( radius, color ), nullptr } );
+        sprites.back().texture = uploadSprite( renderer, sprites.back() );
+        if (sprites.back().texture == nullptr)
+            sprites.back().pixels.clear();
+        return sprites.back().texture;
+    }
+
+    // Rasterize an anti-aliased circle centred on the middle pixel of a
+    // (2 * radius + 1) square, counting 4x4 samples per pixel for coverage
+    static std::vector<Uint32> rasterizeSprite( int radius, const SDL_Color& color )
+    {
+        static constexpr int samples{ 4 };
+        int size{ 2 * radius + 1 };
+        float centre{ size / 2.f };
+        float r2{ (radius + 0.5f) * (radius + 0.5f) };
+        std::vector<Uint32> pixels( size * size );
+
+        for (int py{ 0 }; py < size; ++py)
+            for (int px{ 0 }; px < size; ++px)
+            {
+                int covered{ 0 };
+                for (int sy{ 0 }; sy < samples; ++sy)
+                    for (int sx{ 0 }; sx < samples; ++sx)
+                    {
+                        float dx{ px + (sx + 0.5f) / samples - centre };
+                        float dy{ py + (sy + 0.5f) / samples - centre };
+                        if (dx * dx + dy * dy <= r2)
+                            ++covered;
+                    }
+                Uint32 alpha( color.a * covered / (samples * samples) );
+                pixels[py * size + px] = (alpha << 24) | (color.r << 16) | (color.g << 8) | color.b;
+            }
+        return pixels;
+    }
+
+    static SDL_Texture* uploadSprite( SDL_Renderer *renderer, const Sprite& sprite )
+    {
+        int size{ 2 * sprite.radius + 1 };
+        SDL_Texture *texture = SDL_CreateTexture( renderer, SDL_PIXELFORMAT_ARGB8888,
+                                                  SDL_TEXTUREACCESS_STATIC, size, size );
+        if (texture == nullptr)
+        {
+            SDL_Log( "CreateTexture error: %s", SDL_GetError() );
+            return nullptr;
+        }
+        SDL_SetTextureBlendMode( texture, SDL_BLENDMODE_BLEND );
+        SDL_UpdateTexture( texture, nullptr, sprite.pixels.data(), size * sizeof(Uint32) );
+        return texture;
+    }
+
+    // The fallback when there is no sprite: one rect per scanline
+    void addScanlines( int cx, int cy, int radius, const SDL_Color& color )
+    {
+        auto& rects( rectsFor( color ) );
+
+        for (int dy{ 1 }; dy <= radius; ++dy)
+        {
+            // Half the width of the scanline dy rows in from the top, and
+            // of its mirror image the same distance up from the bottom
+            int dx{ (int)std::floor( std::sqrt( (2.0 * radius * dy) - (dy * dy) ) ) };
+            SDL_Rect line{ cx - dx, cy + dy - radius, 2 * dx + 1, 1 };
+            rects.emplace_back( line );
+            if (dy != radius)
+            {
+                line.y = cy - dy + radius;
+                rects.emplace_back( line );
+            }
+        }
+    }
+};
+
+
+class PoolBase;
+
+// Entities are kept by value in the pool of their type and updated and
+// drawn through it, on the final type, so nothing here is virtual.  A type
+// hides update() and draw() with its own, which the Manager calls directly.
+class Entity
+{
+public:
+    bool destroyed{ false };
+    // Set by the pool holding the entity
+    PoolBase *pool{ nullptr };
+
+    void update( float ticks ) {}
+    void draw( ShapeBatch& shapes, float alpha ) {}
+
+    // Flag the entity and tell its pool, which drops it on the next refresh
+    void destroy();
+};
+
+// A stable reference to an entity owned by a Manager.  The index names a
+// slot that survives the entity moving within its pool, the generation
+// tells a reused slot apart from the entity that held it before.
+struct EntityHandle
+{
+    std::uint32_t index{ 0 };
+    std::uint32_t generation{ 0 };
+
+    bool operator==( const EntityHandle& other ) const noexcept
+    {
+        return index == other.index && generation == other.generation;
+    }
+};
+
+// What an entity needs of the pool holding it, without knowing its type
+class PoolBase
+{
+public:
+    virtual void entityDestroyed( Entity& entity ) = 0;
+
+protected:
+    ~PoolBase() = default;
+};
+
+inline void Entity::destroy()
+{
+    if (destroyed)
+        return;
+    destroyed = true;
+    if (pool != nullptr)
+        pool->entityDestroyed( *this );
+}
+
+// All the entities of one type, packed by value into one array, so
+// updating or drawing them walks memory linearly and calls the final
+// type's functions directly.
+template <typename T>
+class Pool final : public PoolBase
+{
+private:
+    static constexpr std::uint32_t noItem{ 0xFFFFFFFF };
+
+    std::vector<T> items;
+    std::vector<std::uint32_t> itemSlots;       // slot of each item
+    std::vector<std::uint32_t> slotItems;       // item in each slot, or noItem
+    std::vector<std::uint32_t> slotGenerations;
+    std::vector<std::uint32_t> freeSlots;
+    std::vector<std::uint32_t> doomed;          // items destroyed since the last refresh
+
+    void releaseSlot( std::uint32_t slot )
+    {
+        slotItems[slot] = noItem;
+        ++slotGenerations[slot];
+        freeSlots.emplace_back( slot );
+    }
+
+public:
+    // The reference stays valid until the next create() of the same type
+    // or the next refresh(), keep a handle to find the entity later on.
+    template <typename... TArgs>
+    T& create( TArgs&&... mArgs )
+    {
+        std::uint32_t slot;
+        if (freeSlots.empty())
+        {
+            slot = slotItems.size();
+            slotItems.emplace_back( noItem );
+            slotGenerations.emplace_back( 0 );
+        }
+        else
+        {
+            slot = freeSlots.back();
+            freeSlots.pop_back();
+        }
+        slotItems[slot] = items.size();
+        itemSlots.emplace_back( slot );
+        items.emplace_back( std::forward<TArgs>( mArgs )... );
+        items.back().pool = this;
+
+        return items.back();
+    }
+
+    // Room for `count` entities, so creating up to that many never
+    // allocates or moves the others.  The storage is kept by clear(), so
+    // each level after the first reuses it as it is.
+    void reserve( std::size_t count )
+    {
+        items.reserve( count );
+        itemSlots.reserve( count );
+        slotItems.reserve( count );
+        slotGenerations.reserve( count );
+        freeSlots.reserve( count );
+        doomed.reserve( count );
+    }
+
+    std::vector<T>& getAll() { return items; }
+
+    EntityHandle handleOf( const T& item ) const
+    {
+        std::uint32_t slot{ itemSlots[&item - items.data()] };
+        return { slot, slotGenerations[slot] };
+    }
+
+    // Returns nullptr once the entity has been destroyed and refreshed away
+    T* get( EntityHandle handle )
+    {
+        if (handle.index >= slotItems.size() ||
+            slotGenerations[handle.index] != handle.generation ||
+            slotItems[handle.index] == noItem)
+            return nullptr;
+        return &items[slotItems[handle.index]];
+    }
+
+    void update( float ticks )
+    {
+        for (auto& e : items) e.update( ticks );
+    }
+    void draw( ShapeBatch& shapes, float alpha )
+    {
+        for (auto& e : items) e.draw( shapes, alpha );
+    }
+
+    void entityDestroyed( Entity& entity ) override
+    {
+        doomed.emplace_back( static_cast<T*>(&entity) - items.data() );
+    }
+
+    // Drop the entities destroyed since the last refresh by moving the last
+    // one into each hole.  Going from the highest index down, the last item
+    // is never one still waiting to be dropped.
+    void refresh()
+    {
+        if (doomed.empty())
+            return;
+
+        std::sort( std::begin( doomed ), std::end( doomed ), std::greater<std::uint32_t>() );
+        for (auto i : doomed)
+        {
+            std::uint32_t last( items.size() - 1 );
+
+            releaseSlot( itemSlots[i] );
+            if (i != last)
+            {
+                items[i] = std::move( items[last] );
+                itemSlots[i] = itemSlots[last];
+                slotItems[itemSlots[i]] = i;
+            }
+            items.pop_back();
+            itemSlots.pop_back();
+        }
+        doomed.clear();
+    }
+
+    // Keeps the storage, the next level fills the same memory
+    void clear()
+    {
+        for (auto slot : itemSlots) releaseSlot( slot );
+        items.clear();
+        itemSlots.clear();
+        doomed.clear();
+    }
+};
+
+template <typename T>
+constexpr std::uint32_t Pool<T>::noItem;
+
+// The entity types a Manager holds, in the order they update and draw in
+template <typename... TEntities>
+struct EntityTypes {};
+
+template <typename T, typename... TEntities>
+struct IsEntityType : std::false_type {};
+
+template <typename T, typename TFirst, typename... TRest>
+struct IsEntityType<T, TFirst, TRest...>
+    : std::integral_constant<bool, std::is_same<T, TFirst>::value ||
+                                   IsEntityType<T, TRest...>::value> {};
+
+template <typename TTypes>
+class BasicManager;
+
+// The pools of a fixed list of entity types, one member each rather than
+// a heap object behind a virtual interface, so update() and draw() expand
+// at compile time to one loop per type that the compiler can inline the
+// type's functions into.
+template <typename... TEntities>
+class BasicManager<EntityTypes<TEntities...>>
+{
+private:
+    std::tuple<Pool<TEntities>...> pools;
+
+    template <typename T>
+    Pool<T>& pool()
+    {
+        static_assert(std::is_base_of<Entity, T>::value,
+                      "`T` must be derived from `Entity`");
+        static_assert(IsEntityType<T, TEntities...>::value,
+                      "`T` must be one of the Manager's `EntityTypes`");
+
+        return std::get<Pool<T>>( pools );
+    }
+
+    // Call `mFunc` on each pool in the order of the type list
+    template <typename TFunc>
+    void forEachPool( const TFunc& mFunc )
+    {
+        using expand = int[];
+        (void)expand{ 0, (mFunc( std::get<Pool<TEntities>>( pools ) ), 0)... };
+    }
+
+public:
+    BasicManager() = default;
+
+    // The entities point at their pools
+    BasicManager( const BasicManager& ) = delete;
+    BasicManager& operator=( const BasicManager& ) = delete;
+
+    template <typename T, typename... TArgs>
+    T& create( TArgs&&... mArgs )
+    {
+        return pool<T>().create( std::forward<TArgs>( mArgs )... );
+    }
+
+    template <typename T>
+    void reserve( std::size_t count )
+    {
+        pool<T>().reserve( count );
+    }
+
+    void refresh()
+    {
+        forEachPool( []( auto& p ) { p.refresh(); } );
+    }
+
+    void clear()
+    {
+        forEachPool( []( auto& p ) { p.clear(); } );
+    }
+
+    template <typename T>
+    auto& getAll()
+    {
+        return pool<T>().getAll();
+    }
+
+    template <typename T>
+    EntityHandle handleOf( const T& entity )
+    {
+        return pool<T>().handleOf( entity );
+    }
+
+    template <typename T>
+    T* get( EntityHandle handle )
+    {
+        return pool<T>().get( handle );
+    }
+
+    template <typename T, typename TFunc>
+    void forEach( const TFunc& mFunc )
+    {
+        for (auto& e : getAll<T>()) mFunc( e );
+    }
+
+    void update( float ticks )
+    {
+        forEachPool( [ticks]( auto& p ) { p.update( ticks ); } );
+    }
+    void draw( ShapeBatch& shapes, float alpha )
+    {
+        forEachPool( [&shapes, alpha]( auto& p ) { p.draw( shapes, alpha ); } );
+    }
+    template <typename T>
+    void draw( ShapeBatch& shapes, float alpha )
+    {
+        pool<T>().draw( shapes, alpha );
+    }
+};
+
+struct Vector2f
+{
+    float x, y;
+};
+
+struct Shape
+{
+    float x, y;
+    float prevX, prevY;
+    float originX, originY;
+    SDL_Color fillColor;
+
+    void move( const Vector2f &vel ) { x += vel.x; y += vel.y; }
+    void setPosition( float mX, float mY ) { x = prevX = mX; y = prevY = mY; }
+    // Remember where the shape was before a simulation step, it is drawn
+    // part of the way from there to where the step left it
+    void keepPosition() noexcept { prevX = x; prevY = y; }
+    float drawX( float alpha ) const noexcept { return prevX + (x - prevX) * alpha; }
+    float drawY( float alpha ) const noexcept { return prevY + (y - prevY) * alpha; }
+    void setFillColor( const SDL_Color &defColor ) { fillColor = defColor; }
+    void setOrigin( float oX, float oY ) { originX = oX; originY = oY; }
+};
+
+struct Rectangle : public Shape
+{
+    float w, h;
+
+    void setSize( float width, float height ) { w = width; h = height; }
+    float width() const noexcept { return w; }
+    float height() const noexcept { return h; }
+    float left() const noexcept { return x - width() / 2.f; }
+    float right() const noexcept { return x + width() / 2.f; }
+    float top() const noexcept { return y - height() / 2.f; }
+    float bottom() const noexcept { return y + height() / 2.f; }
+
+    void drawShape( ShapeBatch& shapes, float alpha )
+    {
+        SDL_Rect rect = { (int)(drawX( alpha )-originX), (int)(drawY( alpha )-originY), (int)w, (int)h };	// TODO - round
+        shapes.addRect( rect, fillColor );
+    }
+};
+
+// shape info
+struct Circle : public Shape
+{
+    float radius;
+
+    float left() const noexcept { return x - radius; }
+    float right() const noexcept { return x + radius; }
+    float top() const noexcept { return y - radius; }
+    float bottom() const noexcept { return y + radius; }
+    void setRadius( float r ) { radius = r; }
+    void drawShape( ShapeBatch& shapes, float alpha )
+    {	// TODO - round
+        shapes.addCircle( drawX( alpha )-originX, drawY( alpha )-originY, radius, fillColor );
+    }
+};
+
+class Ball final : public Entity, public Circle
+{
+public:
+    static const SDL_Color defColor;
+    static constexpr float defRadius{ 10.f }, defVelocity{ 8.f };
+
+    Vector2f velocity{ -defVelocity, -defVelocity };
+
+    Ball( float mX, float mY )
+    {
+        setPosition( mX, mY );
+        setRadius( defRadius );
+        setFillColor( defColor );
+        setOrigin( defRadius, defRadius );
+    }
+
+    void update( float ticks )
+    {
+        keepPosition();
+        move( { velocity.x * ticks, velocity.y * ticks } );
+    }
+
+    void draw( ShapeBatch& shapes, float alpha )
+    {
+        drawShape( shapes, alpha );
+    }
+
+    // Called once the step's collisions are solved
+    void solveBoundCollisions() noexcept
+    {
+        if (left() < 0)
+            velocity.x = defVelocity;
+        else if (right() > gScreenRect.w)
+            velocity.x = -defVelocity;
+
+        if (top() < 0)
+            velocity.y = defVelocity;
+        else if (bottom() > gScreenRect.h)
+        {
+            // If the ball leaves the window towards the bottom,
+            // we destroy it.
+            destroy();
+            gSounds.post( Sound::MissedPaddle, 2 );
+        }
+    }
+};
+
+class Paddle final : public Entity, public Rectangle
+{
+public:
+    static const SDL_Color defColor;
+    static constexpr float defWidth{ 60.f }, defHeight{ 20.f };
+    static constexpr float defVelocity{ 8.f };
+
+    Vector2f velocity = { 0,0 };
+
+    Paddle( float mX, float mY )
+    {
+        setPosition( mX, mY );
+        setSize( defWidth, defHeight );
+        setFillColor( defColor );
+        setOrigin( defWidth / 2.f, defHeight / 2.f );
+    }
+
+    void update( float ticks )
+    {
+        keepPosition();
+        processPlayerInput();
+        move( { velocity.x * ticks, velocity.y * ticks } );
+    }
+
+    void draw( ShapeBatch& shapes, float alpha )
+    {
+        drawShape( shapes, alpha );
+    }
+
+private:
+    void processPlayerInput()
+    {
+#if 0
+        if ((gCurrentKeyStates[SDL_SCANCODE_LEFT]) && left() > 0)
+            velocity.x = -defVelocity;
+        else if ((gCurrentKeyStates[SDL_SCANCODE_RIGHT]) && right() < gScreenRect.w)
+            velocity.x = defVelocity;
+        else
+            velocity.x = 0;
+#endif
+        x = gTouchLocation.x;
+    }
+};
+
+// The entities of the game.  The bricks aren't among them, they're rows of
+// the BrickField below.
+using Manager = BasicManager<EntityTypes<Paddle, Ball>>;
+
+// The bricks of a level, one array per attribute so a pass over all of
+// them reads memory in order.  Bricks never move and a level never gains
+// any, so a brick keeps its row until the field is cleared for the next
+// level, a destroyed brick is a row with no hits left.
+class BrickField
+{
+public:
+    std::vector<float> x, y, w, h;
+    std::vector<int> hits;
+
+    std::uint32_t add( float mX, float mY, float mW, float mH, int mHits );
+
+    // Replace the bricks with `count` of them laid out as arrays of x, y,
+    // w, h and hits, little endian, one after the other
+    void assign( std::size_t count, const void *arrays );
+
+    std::size_t size() const noexcept { return hits.size(); }
+
+    // As of the last update()
+    int remaining() const noexcept { return standing; }
+
+    void reserve( std::size_t count )
+    {
+        x.reserve( count );
+        y.reserve( count );
+        w.reserve( count );
+        h.reserve( count );
+        hits.reserve( count );
+    }
+
+    // Keeps the storage for the next level
+    void clear()
+    {
+        x.clear();
+        y.clear();
+        w.clear();
+        h.clear();
+        hits.clear();
+        standing = 0;
+    }
+
+    // The per-step pass over every brick, a branch-free count of those
+    // still standing
+    void update() noexcept
+    {
+        const int *mHits{ hits.data() };
+        std::size_t count{ hits.size() };
+        int live{ 0 };
+
+        for (std::size_t i{ 0 }; i < count; ++i)
+            live += mHits[i] > 0;
+        standing = live;
+    }
+
+    // The most bricks overlapMask() tests at once
+    static constexpr std::size_t maskLanes{ 8 };
+
+    // Bit i set for brick `first` + i of the next maskLanes if it still
+    // stands and its box overlaps the box from (l, t) to (r, b), edges
+    // touching as isIntersecting() counts them.  Rows past the end are
+    // left out.  Tests four at a time with SSE2 or NEON where there is.
+    std::uint32_t overlapMask( std::size_t first, float l, float t, float r, float b ) const noexcept;
+
+    // The same for the `count` rows, at most maskLanes, at `rows`
+    std::uint32_t overlapMask( const std::uint32_t *rows, std::size_t count,
+                               float l, float t, float r, float b ) const noexcept;
+
+    void draw( ShapeBatch& shapes ) const;
+
+private:
+    int standing{ 0 };
+};
+
+// One row of a BrickField, with the interface the bricks had when each of
+// them was an entity of its own
+class Brick
+{
+public:
+    static const SDL_Color defColorHits1;
+    static const SDL_Color defColorHits2;
+    static const SDL_Color defColorHits3;
+    static constexpr float defWidth{ 60.f }, defHeight{ 20.f };
+
+    // Bumped whenever any brick is created or hit, so whatever shows the
+    // bricks can tell when it needs redrawing
+    static unsigned revision;
+
+    Brick( BrickField& mField, std::uint32_t mRow ) noexcept : field( &mField ), row( mRow ) {}
+
+    std::uint32_t index() const noexcept { return row; }
+
+    float left() const noexcept { return field->x[row] - field->w[row] / 2.f; }
+    float right() const noexcept { return field->x[row] + field->w[row] / 2.f; }
+    float top() const noexcept { return field->y[row] - field->h[row] / 2.f; }
+    float bottom() const noexcept { return field->y[row] + field->h[row] / 2.f; }
+
+    int& requiredHits() const noexcept { return field->hits[row]; }
+    bool destroyed() const noexcept { return field->hits[row] <= 0; }
+
+private:
+    BrickField *field;
+    std::uint32_t row;
+};
+
+template <typename T1, typename T2>
+bool isIntersecting( const T1& mA, const T2& mB ) noexcept
+{
+    return mA.right() >= mB.left() && mA.left() <= mB.right() &&
+           mA.bottom() >= mB.top() && mA.top() <= mB.bottom();
+}
+
+void hitPaddle( const Paddle& mPaddle, Ball& mBall ) noexcept;
+void hitBrick( const Brick& mBrick ) noexcept;
+void solvePaddleBallCollision( const Paddle& mPaddle, Ball& mBall ) noexcept;
+void solveBrickBallCollision( const Brick& mBrick, Ball& mBall ) noexcept;
+
+// Earliest fraction of the motion `d` from `p` at which a circle touches
+// the box, or a value above 1 if it doesn't get there.  The outward
+// normal of the face or corner it touches goes to `normal`.  A circle
+// that already overlaps the box returns 0 with a zero normal, the
+// discrete solvers above push it out.
+template <typename T>
+float sweepCircleBox( const Vector2f& p, const Vector2f& d, float radius,
+                      const T& mBox, Vector2f& normal ) noexcept
+{
+    float nearX{ std::min( std::max( p.x, mBox.left() ), mBox.right() ) };
+    float nearY{ std::min( std::max( p.y, mBox.top() ), mBox.bottom() ) };
+    if ((p.x - nearX) * (p.x - nearX) + (p.y - nearY) * (p.y - nearY) < radius * radius)
+    {
+        normal = { 0.f, 0.f };
+        return 0.f;
+    }
+
+    // Slab test against the box grown by the radius on every side
+    const float lo[2]{ mBox.left() - radius, mBox.top() - radius };
+    const float hi[2]{ mBox.right() + radius, mBox.bottom() + radius };
+    const float pos[2]{ p.x, p.y }, dir[2]{ d.x, d.y };
+    float enter{ 0.f }, exit{ 1.f };
+    Vector2f faceNormal{ 0.f, 0.f };
+
+    for (int axis{ 0 }; axis < 2; ++axis)
+    {
+        if (dir[axis] == 0.f)
+        {
+            if (pos[axis] < lo[axis] || pos[axis] > hi[axis])
+                return 2.f;
+            continue;
+        }
+
+        float t0{ (lo[axis] - pos[axis]) / dir[axis] };
+        float t1{ (hi[axis] - pos[axis]) / dir[axis] };
+        float side{ -1.f };
+        if (t0 > t1)
+        {
+            std::swap( t0, t1 );
+            side = 1.f;
+        }
+        if (t0 > enter)
+        {
+            enter = t0;
+            faceNormal = axis == 0 ? Vector2f{ side, 0.f } : Vector2f{ 0.f, side };
+        }
+        exit = std::min( exit, t1 );
+        if (enter > exit)
+            return 2.f;
+    }
+
+    // The grown box has square corners, the real shape is rounded there:
+    // past both edges of the box only the corner itself can be touched
+    float hitX{ p.x + d.x * enter }, hitY{ p.y + d.y * enter };
+    if ((hitX < mBox.left() || hitX > mBox.right()) &&
+        (hitY < mBox.top() || hitY > mBox.bottom()))
+    {
+        float cornerX{ hitX < mBox.left() ? mBox.left() : mBox.right() };
+        float cornerY{ hitY < mBox.top() ? mBox.top() : mBox.bottom() };
+        float mx{ p.x - cornerX }, my{ p.y - cornerY };
+        float a{ d.x * d.x + d.y * d.y };
+        float b{ mx * d.x + my * d.y };
+        float c{ mx * mx + my * my - radius * radius };
+        float disc{ b * b - a * c };
+        if (disc < 0.f || b >= 0.f)
+            return 2.f;
+
+        float t{ (-b - std::sqrt( disc )) / a };
+        if (t > 1.f)
+            return 2.f;
+        normal = { (p.x + d.x * t - cornerX) / radius, (p.y + d.y * t - cornerY) / radius };
+        return t;
+    }
+
+    if (faceNormal.x == 0.f && faceNormal.y == 0.f)
+        return 2.f;
+    normal = faceNormal;
+    return enter;
+}
+
+// Turn the ball away from the face or corner it touched
+void bounceBall( Ball& mBall, const Vector2f& normal ) noexcept;
+
+// A uniform grid over the play field listing the bricks that overlap each
+// cell, so a ball is only tested against the bricks around it.  Bricks
+// never move: the grid is filled once per level and a brick is only taken
+// out again when it is destroyed.
+class BrickGrid
+{
+public:
+    static constexpr float cellSize{ 64.f };
+
+    void reset( float width, float height )
+    {
+        columns = std::max( 1, (int)std::ceil( width / cellSize ) );
+        rows = std::max( 1, (int)std::ceil( height / cellSize ) );
+        cells.resize( columns * rows );
+        for (auto& cell : cells) cell.clear();
+    }
+
+    void insert( const Brick& brick )
+    {
+        forCells( brick, [&brick]( auto& cell )
+                  {
+                      cell.emplace_back( brick.index() );
+                  } );
+    }
+
+    void remove( const Brick& brick )
+    {
+        forCells( brick, [&brick]( auto& cell )
+                  {
+                      cell.erase( std::remove( std::begin( cell ), std::end( cell ), brick.index() ),
+                                  std::end( cell ) );
+                  } );
+    }
+
+    // Collect the rows of the bricks sharing a cell with the shape, each
+    // of them once
+    template <typename T>
+    void query( const T& shape, std::vector<std::uint32_t>& found )
+    {
+        found.clear();
+        forCells( shape, [&found]( auto& cell )
+                  {
+                      for (auto row : cell)
+                          if (std::find( std::begin( found ), std::end( found ), row ) == std::end( found ))
+                              found.emplace_back( row );
+                  } );
+    }
+
+private:
+    int columns{ 0 }, rows{ 0 };
+    std::vector<std::vector<std::uint32_t>> cells;
+
+    // Anything off the field is counted in the nearest edge cell
+    static int cellOf( float coord, int count ) noexcept
+    {
+        return std::min( std::max( (int)std::floor( coord / cellSize ), 0 ), count - 1 );
+    }
+
+    template <typename T, typename TFunc>
+    void forCells( const T& shape, const TFunc& mFunc )
+    {
+        int x0{ cellOf( shape.left(), columns ) }, x1{ cellOf( shape.right(), columns ) };
+        int y0{ cellOf( shape.top(), rows ) }, y1{ cellOf( shape.bottom(), rows ) };
+
+        for (int y{ y0 }; y <= y1; ++y)
+            for (int x{ x0 }; x <= x1; ++x)
+                mFunc( cells[y * columns + x] );
+    }
+};
+
+// Levels in the binary format levelpack writes, read from memory the
+// caller keeps around, such as a mapped asset.  All little endian:
+//
+//   u32 magic "ARKL", u32 version, u32 level count
+//   per level: u32 offset from the start of the data, u32 brick count
+//   at each offset, the level's bricks as BrickField::assign() takes them
+//
+// Positions are the centres of the bricks in pixels.  Levels are laid out
+// on the grid columnX() and rowY() describe, which the built-in level
+// uses too.
+class LevelPack
+{
+public:
+    static constexpr std::uint32_t magic{ 0x4C4B5241 }, version{ 1 };
+    static constexpr std::size_t headerSize{ 12 }, entrySize{ 8 };
+    // x, y, w, h and hits
+    static constexpr std::size_t brickSize{ 5 * 4 };
+
+    static constexpr int gridStartColumn{ 1 }, gridStartRow{ 2 };
+    static constexpr float gridSpacing{ 3.f }, gridOffsetX{ 22.f };
+
+    static float columnX( int column ) noexcept
+    {
+        return gridOffsetX + (column + gridStartColumn) * (Brick::defWidth + gridSpacing);
+    }
+    static float rowY( int row ) noexcept
+    {
+        return (row + gridStartRow) * (Brick::defHeight + gridSpacing);
+    }
+
+    // Checks the header and that every level lies within the data, so
+    // load() doesn't have to.  Returns false with the SDL error set if it's
+    // not a pack this can read.
+    bool open( const void *data, std::size_t size );
+
+    std::size_t count() const noexcept { return levels; }
+
+    // Copies the level's arrays into the field as they are, returns false
+    // if there's no such level
+    bool load( std::size_t level, BrickField& field ) const;
+
+private:
+    const Uint8 *bytes{ nullptr };
+    std::size_t levels{ 0 };
+};
+
+// Everything that moves or can be hit, advanced in fixed steps.  Velocities
+// are in pixels per tick, a step may cover several ticks.
+class Simulation
+{
+public:
+    static constexpr double tickSeconds{ 1.0 / 60.0 };
+    static constexpr int maxBounces{ 8 };
+
+    // Debris thrown out by each destroyed brick
+    static constexpr int debrisPerBrick{ 24 };
+
+    Manager manager;
+    BrickField bricks;
+    ParticleEmitter debris{ { 255, 255, 0, 255 }, 4.f, 40.f, 0.15f };
+
+    // Empty the field for a new level.  Nothing is freed, the level reuses
+    // the memory the last one had.
+    void reset()
+    {
+        manager.clear();
+        bricks.clear();
+        debris.clear();
+        brickGrid.reset( gScreenRect.w, gScreenRect.h );
+    }
+
+    std::uint32_t addBrick( float mX, float mY, float mW, float mH, int mHits )
+    {
+        std::uint32_t row{ bricks.add( mX, mY, mW, mH, mHits ) };
+        brickGrid.insert( Brick{ bricks, row } );
+        return row;
+    }
+
+    // Fill the emptied field with a level of the pack, returns false if
+    // the pack doesn't have it
+    bool loadLevel( const LevelPack& pack, std::size_t level )
+    {
+        if (!pack.load( level, bricks ))
+            return false;
+        for (std::uint32_t row{ 0 }; row < bricks.size(); ++row)
+            brickGrid.insert( Brick{ bricks, row } );
+        return true;
+    }
+
+    // Slow devices can take fewer, longer steps, the swept collisions keep
+    // the ball from passing through bricks however far it moves in one
+    void setStepRate( int stepsPerSecond )
+    {
+        stepSeconds = 1.0 / std::max( 1, stepsPerSecond );
+    }
+
+    double stepLength() const noexcept { return stepSeconds; }
+
+    // Without the grid every ball is tested against every brick, only
+    // there to measure what the grid saves
+    void setBroadphase( bool enabled ) noexcept { broadphase = enabled; }
+
+    // The phases of a step, apart so they can be timed apart
+    void update()
+    {
+        float ticks{ (float)(stepSeconds / tickSeconds) };
+        manager.update( ticks );
+        debris.update( ticks );
+    }
+
+    void collide()
+    {
+        manager.forEach<Ball>( [this]( auto& mBall )
+                               {
+                                   sweepBall( mBall );
+                                   mBall.solveBoundCollisions();
+                               } );
+    }
+
+    void refresh()
+    {
+        manager.refresh();
+    }
+
+    void step()
+    {
+        update();
+        collide();
+        refresh();
+    }
+
+private:
+    BrickGrid brickGrid;
+    bool broadphase{ true };
+    double stepSeconds{ tickSeconds };
+
+    std::vector<std::uint32_t> nearbyBricks;
+    std::vector<std::uint32_t> touchingBricks;
+    std::vector<Paddle*> touchingPaddles;
+
+    // The box a ball sweeps through during a step
+    struct SweptBounds
+    {
+        float l, t, r, b;
+
+        float left() const noexcept { return l; }
+        float right() const noexcept { return r; }
+        float top() const noexcept { return t; }
+        float bottom() const noexcept { return b; }
+    };
+
+    static void sweepWall( float t, const Vector2f& wallNormal, float& first,
+                           Vector2f& normal, bool& wallHit ) noexcept
+    {
+        if (t <= 1.f && t < first)
+        {
+            first = t;
+            normal = wallNormal;
+            wallHit = true;
+        }
+    }
+
+    // Out of the grid and into debris
+    void brickDestroyed( const Brick& brick )
+    {
+        brickGrid.remove( brick );
+        debris.burst( (brick.left() + brick.right()) / 2.f, (brick.top() + brick.bottom()) / 2.f,
+                      debrisPerBrick, 3.f );
+    }
+
+    // Ball::update moved the ball a whole step ahead.  Go back over that
+    // path and stop it at the first brick, paddle or wall it crosses, turn
+    // it there and spend the rest of the step on the new heading.  Bricks
+    // and paddles that already overlap the ball are left to the discrete
+    // solvers.
+    void sweepBall( Ball& mBall );
+};
+
+#endif // ARKANOID_SIMULATION_H
@@ -0,0 +1,452 @@
+//
+// The GL side of the SpriteBatch
+//
+
+#include "spritebatch.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+
+#include <GLES2/gl2.h>
+
+namespace
+{
+
+// Quads per draw, as far as 16-bit indices reach
+constexpr int maxQuadsPerDraw{ 65536 / 4 };
+
+// The first locations, which SDL's renderer uses as well, so begin()
+// saves which of them were enabled
+enum Attribute
+{
+    Position,
+    TexCoord,
+    Color
+};
+
+const char vertexSource[] =
+    "uniform vec4 u_transform;\n"
+    "attribute vec2 a_position;\n"
+    "attribute vec2 a_texCoord;\n"
+    "attribute vec4 a_color;\n"
+    "varying vec2 v_texCoord;\n"
+    "varying vec4 v_color;\n"
+    "void main()\n"
+    "{\n"
+    "    v_texCoord = a_texCoord;\n"
+    "    v_color = a_color;\n"
+    "    gl_Position = vec4(a_position * u_transform.xy + u_transform.zw, 0.0, 1.0);\n"
+    "}\n";
+
+// The textures of SDL's ARGB formats hold their bytes the other way round
+const char fragmentSource[] =
+    "precision mediump float;\n"
+    "uniform sampler2D u_texture;\n"
+    "uniform float u_swap;\n"
+    "varying vec2 v_texCoord;\n"
+    "varying vec4 v_color;\n"
+    "void main()\n"
+    "{\n"
+    "    vec4 texel = texture2D(u_texture, v_texCoord);\n"
+    "    gl_FragColor = mix(texel, texel.bgra, u_swap) * v_color;\n"
+    "}\n";
+
+// An offset into the bound vertex buffer, the way GL takes it
+const void* bufferOffset( std::size_t offset )
+{
+    return reinterpret_cast<const void*>( offset );
+}
+
+GLuint compileShader( GLenum type, const char *source )
+{
+    GLuint shader( glCreateShader( type ) );
+    glShaderSource( shader, 1, &source, nullptr );
+    glCompileShader( shader );
+    GLint compiled{ GL_FALSE };
+    glGetShaderiv( shader, GL_COMPILE_STATUS, &compiled );
+    if (compiled != GL_TRUE)
+    {
+        char log[512]{};
+        glGetShaderInfoLog( shader, sizeof(log), nullptr, log );
+        SDL_Log( "SpriteBatch shader: %s", log );
+        glDeleteShader( shader );
+        return 0;
+    }
+    return shader;
+}
+
+// Whether the shader can read the texture, and if it has to swap red and
+// blue.  SDL's OpenGL ES 2 renderer has textures in these formats only.
+bool readableFormat( Uint32 format, bool& swapRedBlue )
+{
+    switch (format)
+    {
+    case SDL_PIXELFORMAT_ARGB8888:
+    case SDL_PIXELFORMAT_RGB888:
+        swapRedBlue = true;
+        return true;
+    case SDL_PIXELFORMAT_ABGR8888:
+    case SDL_PIXELFORMAT_BGR888:
+        swapRedBlue = false;
+        return true;
+    default:
+        return false;
+    }
+}
+
+}
+
+bool SpriteBatch::attach( SDL_Renderer *target )
+{
+    SDL_RendererInfo info;
+    if (SDL_GetRendererInfo( target, &info ) != 0 || std::strcmp( info.name, "opengles2" ) != 0)
+        return false;
+    renderer = target;
+    return true;
+}
+
+void SpriteBatch::destroy()
+{
+    if (program != 0)
+    {
+        glDeleteProgram( program );
+        glDeleteBuffers( 1, &vertexBuffer );
+        glDeleteBuffers( 1, &indexBuffer );
+        glDeleteTextures( 1, &whiteTexture );
+    }
+    release();
+}
+
+void SpriteBatch::release() noexcept
+{
+    program = 0;
+    vertexBuffer = 0;
+    indexBuffer = 0;
+    whiteTexture = 0;
+    indexedQuads = 0;
+}
+
+bool SpriteBatch::createObjects()
+{
+    GLuint vertexShader( compileShader( GL_VERTEX_SHADER, vertexSource ) );
+    GLuint fragmentShader( compileShader( GL_FRAGMENT_SHADER, fragmentSource ) );
+    if (vertexShader == 0 || fragmentShader == 0)
+    {
+        glDeleteShader( vertexShader );
+        glDeleteShader( fragmentShader );
+        return false;
+    }
+
+    program = glCreateProgram();
+    glAttachShader( program, vertexShader );
+    glAttachShader( program, fragmentShader );
+    glBindAttribLocation( program, Position, "a_position" );
+    glBindAttribLocation( program, TexCoord, "a_texCoord" );
+    glBindAttribLocation( program, Color, "a_color" );
+    glLinkProgram( program );
+    glDeleteShader( vertexShader );
+    glDeleteShader( fragmentShader );
+    GLint linked{ GL_FALSE };
+    glGetProgramiv( program, GL_LINK_STATUS, &linked );
+    if (linked != GL_TRUE)
+    {
+        SDL_Log( "SpriteBatch shader didn't link" );
+        glDeleteProgram( program );
+        program = 0;
+        return false;
+    }
+    transformLocation = glGetUniformLocation( program, "u_transform" );
+    swapLocation = glGetUniformLocation( program, "u_swap" );
+    glUseProgram( program );
+    glUniform1i( glGetUniformLocation( program, "u_texture" ), 0 );
+
+    glGenBuffers( 1, &vertexBuffer );
+    glGenBuffers( 1, &indexBuffer );
+
+    // Drawn from for the quads without a texture of their own
+    const Uint8 white[4]{ 255, 255, 255, 255 };
+    glGenTextures( 1, &whiteTexture );
+    glBindTexture( GL_TEXTURE_2D, whiteTexture );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST );
+    glTexParameteri( GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST );
+    glTexImage2D( GL_TEXTURE_2D, 0, GL_RGBA, 1, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, white );
+    return true;
+}
+
+bool SpriteBatch::begin()
+{
+    if (renderer == nullptr || broken || SDL_GL_GetCurrentContext() == nullptr)
+        return false;
+    // Whatever SDL has queued goes first, and its viewport is set
+    if (SDL_RenderFlush( renderer ) != 0)
+        return false;
+
+    GLint value;
+    glGetIntegerv( GL_CURRENT_PROGRAM, &saved.program );
+    glGetIntegerv( GL_ARRAY_BUFFER_BINDING, &saved.arrayBuffer );
+    glGetIntegerv( GL_ELEMENT_ARRAY_BUFFER_BINDING, &saved.elementBuffer );
+    glGetIntegerv( GL_ACTIVE_TEXTURE, &saved.activeTexture );
+    glActiveTexture( GL_TEXTURE0 );
+    glGetIntegerv( GL_TEXTURE_BINDING_2D, &saved.texture );
+    saved.blend = glIsEnabled( GL_BLEND ) == GL_TRUE;
+    glGetIntegerv( GL_BLEND_SRC_RGB, &saved.blendSrcRGB );
+    glGetIntegerv( GL_BLEND_DST_RGB, &saved.blendDstRGB );
+    glGetIntegerv( GL_BLEND_SRC_ALPHA, &saved.blendSrcAlpha );
+    glGetIntegerv( GL_BLEND_DST_ALPHA, &saved.blendDstAlpha );
+    glGetIntegerv( GL_BLEND_EQUATION_RGB, &saved.blendEquationRGB );
+    glGetIntegerv( GL_BLEND_EQUATION_ALPHA, &saved.blendEquationAlpha );
+    glGetIntegerv( GL_MAX_VERTEX_ATTRIBS, &value );
+    attribCount = std::min( (int)value, maxSavedAttribs );
+    for (int i{ 0 }; i < attribCount; ++i)
+    {
+        glGetVertexAttribiv( i, GL_VERTEX_ATTRIB_ARRAY_ENABLED, &value );
+        saved.attribs[i] = value != 0;
+    }
+
+    if (program == 0 && !createObjects())
+    {
+        // Not tried again, the renderer draws everything from now on
+        broken = true;
+        active = true;
+        end();
+        return false;
+    }
+
+    // SDL's projection is of the viewport in pixels, after the render
+    // scale, upside down when drawing to a texture
+    GLint viewport[4];
+    glGetIntegerv( GL_VIEWPORT, viewport );
+    float scaleX, scaleY;
+    SDL_RenderGetScale( renderer, &scaleX, &scaleY );
+    float flip( SDL_GetRenderTarget( renderer ) != nullptr ? 1.f : -1.f );
+    transform[0] = 2.f * scaleX / std::max( 1, (int)viewport[2] );
+    transform[1] = flip * 2.f * scaleY / std::max( 1, (int)viewport[3] );
+    transform[2] = -1.f;
+    transform[3] = -flip;
+
+    vertices.clear();
+    runs.clear();
+    active = true;
+    return true;
+}
+
+void SpriteBatch::addQuad( SDL_Texture *texture, bool swapRedBlue, SDL_BlendMode blend,
+                           float x0, float y0, float x1, float y1,
+                           float u0, float v0, float u1, float v1, const SDL_Color& color )
+{
+    if (runs.empty() || runs.back().texture != texture || runs.back().blend != blend)
+        runs.emplace_back( Run{ texture, swapRedBlue, blend, (int)(vertices.size() / 4), 0 } );
+    ++runs.back().quads;
+
+    vertices.emplace_back( Vertex{ x0, y0, u0, v0, color } );
+    vertices.emplace_back( Vertex{ x1, y0, u1, v0, color } );
+    vertices.emplace_back( Vertex{ x1, y1, u1, v1, color } );
+    vertices.emplace_back( Vertex{ x0, y1, u0, v1, color } );
+}
+
+void SpriteBatch::fillRect( const SDL_Rect& rect, const SDL_Color& color, SDL_BlendMode blend )
+{
+    addQuad( nullptr, false, blend, rect.x, rect.y, rect.x + rect.w, rect.y + rect.h,
+             0.f, 0.f, 1.f, 1.f, color );
+}
+
+// The pixels SDL_RenderDrawRect() covers, as four thin fills
+void SpriteBatch::drawRect( const SDL_Rect& rect, const SDL_Color& color, SDL_BlendMode blend )
+{
+    if (rect.w <= 0 || rect.h <= 0)
+        return;
+    fillRect( SDL_Rect{ rect.x, rect.y, rect.w, 1 }, color, blend );
+    if (rect.h > 1)
+        fillRect( SDL_Rect{ rect.x, rect.y + rect.h - 1, rect.w, 1 }, color, blend );
+    if (rect.h > 2)
+    {
+        fillRect( SDL_Rect{ rect.x, rect.y + 1, 1, rect.h - 2 }, color, blend );
+        if (rect.w > 1)
+            fillRect( SDL_Rect{ rect.x + rect.w - 1, rect.y + 1, 1, rect.h - 2 }, color, blend );
+    }
+}
+
+// A pixel wide quad through the centres of the end pixels, which it
+// covers like SDL_RenderDrawLine() does
+void SpriteBatch::drawLine( int x1, int y1, int x2, int y2, const SDL_Color& color, SDL_BlendMode blend )
+{
+    if (x1 == x2 || y1 == y2)
+    {
+        fillRect( SDL_Rect{ std::min( x1, x2 ), std::min( y1, y2 ),
+                            std::abs( x2 - x1 ) + 1, std::abs( y2 - y1 ) + 1 }, color, blend );
+        return;
+    }
+
+    float dx( x2 - x1 ), dy( y2 - y1 );
+    float length( std::sqrt( dx * dx + dy * dy ) );
+    // Half a pixel along the line and across it
+    float ax( 0.5f * dx / length ), ay( 0.5f * dy / length );
+    float nx( -ay ), ny( ax );
+    float sx( x1 + 0.5f - ax ), sy( y1 + 0.5f - ay );
+    float ex( x2 + 0.5f + ax ), ey( y2 + 0.5f + ay );
+
+    if (runs.empty() || runs.back().texture != nullptr || runs.back().blend != blend)
+        runs.emplace_back( Run{ nullptr, false, blend, (int)(vertices.size() / 4), 0 } );
+    ++runs.back().quads;
+    vertices.emplace_back( Vertex{ sx + nx, sy + ny, 0.f, 0.f, color } );
+    vertices.emplace_back( Vertex{ ex + nx, ey + ny, 1.f, 0.f, color } );
+    vertices.emplace_back( Vertex{ ex - nx, ey - ny, 1.f, 1.f, color } );
+    vertices.emplace_back( Vertex{ sx - nx, sy - ny, 0.f, 1.f, color } );
+}
+
+bool SpriteBatch::copy( SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect& dst )
+{
+    Uint32 format;
+    int width, height;
+    bool swapRedBlue;
+    if (SDL_QueryTexture( texture, &format, nullptr, &width, &height ) != 0 ||
+        !readableFormat( format, swapRedBlue ))
+        return false;
+
+    SDL_Rect whole{ 0, 0, width, height };
+    if (src == nullptr)
+        src = &whole;
+    SDL_Color color;
+    SDL_BlendMode blend;
+    SDL_GetTextureColorMod( texture, &color.r, &color.g, &color.b );
+    SDL_GetTextureAlphaMod( texture, &color.a );
+    SDL_GetTextureBlendMode( texture, &blend );
+
+    // SDL's ES 2 textures are never padded, the coordinates span 0 to 1
+    addQuad( texture, swapRedBlue, blend, dst.x, dst.y, dst.x + dst.w, dst.y + dst.h,
+             (float)src->x / width, (float)src->y / height,
+             (float)(src->x + src->w) / width, (float)(src->y + src->h) / height, color );
+    return true;
+}
+
+void SpriteBatch::draw()
+{
+    int quads( (int)(vertices.size() / 4) );
+    int wanted( std::min( quads, maxQuadsPerDraw ) );
+    if (wanted > indexedQuads)
+    {
+        // Every quad is two triangles over its four vertices
+        int count{ std::max( 256, indexedQuads ) };
+        while (count < wanted)
+            count *= 2;
+        count = std::min( count, maxQuadsPerDraw );
+        std::vector<GLushort> indices( count * 6 );
+        for (int i{ 0 }; i < count; ++i)
+        {
+            GLushort first( (GLushort)(i * 4) );
+            GLushort quad[6]{ first, (GLushort)(first + 1), (GLushort)(first + 2),
+                              first, (GLushort)(first + 2), (GLushort)(first + 3) };
+            std::copy( quad, quad + 6, &indices[i * 6] );
+        }
+        glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+        glBufferData( GL_ELEMENT_ARRAY_BUFFER, indices.size() * sizeof(GLushort), indices.data(), GL_STATIC_DRAW );
+        indexedQuads = count;
+    }
+
+    // The whole flush in one upload, to a fresh buffer so the GPU needn't
+    // finish with the last one first
+    glBindBuffer( GL_ARRAY_BUFFER, vertexBuffer );
+    glBufferData( GL_ARRAY_BUFFER, vertices.size() * sizeof(Vertex), nullptr, GL_STREAM_DRAW );
+    glBufferSubData( GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(Vertex), vertices.data() );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, indexBuffer );
+
+    glUseProgram( program );
+    glUniform4fv( transformLocation, 1, transform );
+    for (int i{ 0 }; i < attribCount; ++i)
+        glDisableVertexAttribArray( i );
+    glEnableVertexAttribArray( Position );
+    glEnableVertexAttribArray( TexCoord );
+    glEnableVertexAttribArray( Color );
+
+    SDL_Texture *bound{ nullptr };
+    bool haveBlend{ false };
+    SDL_BlendMode blend{ SDL_BLENDMODE_NONE };
+    for (const Run& run : runs)
+    {
+        if (run.texture != nullptr)
+        {
+            float texW, texH;
+            if (SDL_GL_BindTexture( run.texture, &texW, &texH ) != 0)
+                continue;
+            bound = run.texture;
+        }
+        else
+            glBindTexture( GL_TEXTURE_2D, whiteTexture );
+        glUniform1f( swapLocation, run.swapRedBlue ? 1.f : 0.f );
+
+        if (!haveBlend || run.blend != blend)
+        {
+            switch (run.blend)
+            {
+            case SDL_BLENDMODE_BLEND:
+                glEnable( GL_BLEND );
+                glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA, GL_ONE, GL_ONE_MINUS_SRC_ALPHA );
+                break;
+            case SDL_BLENDMODE_ADD:
+                glEnable( GL_BLEND );
+                glBlendFuncSeparate( GL_SRC_ALPHA, GL_ONE, GL_ZERO, GL_ONE );
+                break;
+            case SDL_BLENDMODE_MOD:
+                glEnable( GL_BLEND );
+                glBlendFuncSeparate( GL_ZERO, GL_SRC_COLOR, GL_ZERO, GL_ONE );
+                break;
+            default:
+                glDisable( GL_BLEND );
+                break;
+            }
+            glBlendEquation( GL_FUNC_ADD );
+            haveBlend = true;
+            blend = run.blend;
+        }
+
+        // The indices start over from each draw's first vertex
+        for (int first{ run.firstQuad }; first < run.firstQuad + run.quads; first += maxQuadsPerDraw)
+        {
+            int count( std::min( maxQuadsPerDraw, run.firstQuad + run.quads - first ) );
+            std::size_t base( first * 4 * sizeof(Vertex) );
+            glVertexAttribPointer( Position, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                   bufferOffset( base + offsetof( Vertex, x ) ) );
+            glVertexAttribPointer( TexCoord, 2, GL_FLOAT, GL_FALSE, sizeof(Vertex),
+                                   bufferOffset( base + offsetof( Vertex, u ) ) );
+            glVertexAttribPointer( Color, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(Vertex),
+                                   bufferOffset( base + offsetof( Vertex, color ) ) );
+            glDrawElements( GL_TRIANGLES, count * 6, GL_UNSIGNED_SHORT, nullptr );
+        }
+    }
+
+    // With its last texture unbound SDL binds the next one it draws again
+    if (bound != nullptr)
+        SDL_GL_UnbindTexture( bound );
+}
+
+void SpriteBatch::end()
+{
+    if (!active)
+        return;
+    active = false;
+    if (!runs.empty())
+        draw();
+    vertices.clear();
+    runs.clear();
+
+    glUseProgram( saved.program );
+    glBindBuffer( GL_ARRAY_BUFFER, saved.arrayBuffer );
+    glBindBuffer( GL_ELEMENT_ARRAY_BUFFER, saved.elementBuffer );
+    glBindTexture( GL_TEXTURE_2D, saved.texture );
+    glActiveTexture( saved.activeTexture );
+    if (saved.blend)
+        glEnable( GL_BLEND );
+    else
+        glDisable( GL_BLEND );
+    glBlendFuncSeparate( saved.blendSrcRGB, saved.blendDstRGB, saved.blendSrcAlpha, saved.blendDstAlpha );
+    glBlendEquationSeparate( saved.blendEquationRGB, saved.blendEquationAlpha );
+    for (int i{ 0 }; i < attribCount; ++i)
+    {
+        if (saved.attribs[i])
+            glEnableVertexAttribArray( i );
+        else
+            glDisableVertexAttribArray( i );
+    }
+}
@@ -0,0 +1,118 @@
+//
+// Draws what a RenderQueue flush holds straight through OpenGL ES 2, on
+// the context of an SDL_Renderer that is using it.  Every quad of the
+// flush goes into one interleaved vertex buffer, with its color in the
+// vertex, and a single shader draws each run of quads sharing a texture
+// and blend mode with one glDrawElements: whatever their colors, the
+// bricks, the paddle, the balls' sprites and the particles of a layer go
+// out in a draw or two, where SDL_Renderer makes a call per color and
+// one per copy.
+//
+// The textures are SDL's own, bound with SDL_GL_BindTexture().  SDL's GL
+// state is put back as it was, so the renderer keeps drawing in between.
+//
+
+#ifndef ARKANOID_SPRITEBATCH_H
+#define ARKANOID_SPRITEBATCH_H
+
+#include <vector>
+
+#include <SDL.h>
+
+class SpriteBatch
+{
+public:
+    SpriteBatch() = default;
+    SpriteBatch( const SpriteBatch& ) = delete;
+    SpriteBatch& operator=( const SpriteBatch& ) = delete;
+
+    // Whether the renderer draws with OpenGL ES 2, which the batch can
+    // draw alongside.  The shader and buffers are made on the first begin().
+    bool attach( SDL_Renderer *renderer );
+
+    // Deletes the GL objects, must be called before the renderer goes away
+    void destroy();
+
+    // Forgets the GL objects without deleting them, after the renderer lost
+    // its context.  The next begin() makes them again.
+    void release() noexcept;
+
+    // Submits what SDL_Renderer has queued and takes over the GL state.
+    // Returns false if the batch can't draw, and the renderer has to.
+    bool begin();
+
+    void fillRect( const SDL_Rect& rect, const SDL_Color& color, SDL_BlendMode blend );
+    void drawRect( const SDL_Rect& rect, const SDL_Color& color, SDL_BlendMode blend );
+    void drawLine( int x1, int y1, int x2, int y2, const SDL_Color& color, SDL_BlendMode blend );
+
+    // The texture's own blend and color modulation apply, as with
+    // SDL_RenderCopy.  Returns false, drawing nothing, for a texture whose
+    // pixel format the shader doesn't read.
+    bool copy( SDL_Texture *texture, const SDL_Rect *src, const SDL_Rect& dst );
+
+    // Draws everything since begin() and gives the GL state back to SDL
+    void end();
+
+private:
+    struct Vertex
+    {
+        float x, y;
+        float u, v;
+        SDL_Color color;
+    };
+
+    // Quads drawn with the same texture, nullptr for plain color, and blend
+    struct Run
+    {
+        SDL_Texture *texture;
+        bool swapRedBlue;
+        SDL_BlendMode blend;
+        int firstQuad;
+        int quads;
+    };
+
+    // SDL's renderer uses fewer attributes than this
+    static constexpr int maxSavedAttribs{ 8 };
+
+    // The GL state begin() found and end() puts back
+    struct SavedState
+    {
+        int program;
+        int arrayBuffer;
+        int elementBuffer;
+        int activeTexture;
+        int texture;
+        bool blend;
+        int blendSrcRGB, blendDstRGB, blendSrcAlpha, blendDstAlpha;
+        int blendEquationRGB, blendEquationAlpha;
+        // Whether each of the first vertex attributes was enabled
+        bool attribs[maxSavedAttribs];
+    };
+
+    SDL_Renderer *renderer{ nullptr };
+    bool active{ false };
+    unsigned program{ 0 };
+    unsigned vertexBuffer{ 0 };
+    unsigned indexBuffer{ 0 };
+    unsigned whiteTexture{ 0 };
+    int attribCount{ 0 };
+    int transformLocation{ -1 };
+    int swapLocation{ -1 };
+    int indexedQuads{ 0 };
+    bool broken{ false };
+
+    // Logical coordinates to clip space: x and y scale, then offset
+    float transform[4]{};
+
+    SavedState saved{};
+    std::vector<Vertex> vertices;
+    std::vector<Run> runs;
+
+    bool createObjects();
+    void addQuad( SDL_Texture *texture, bool swapRedBlue, SDL_BlendMode blend,
+                  float x0, float y0, float x1, float y1,
+                  float u0, float v0, float u1, float v1, const SDL_Color& color );
+    void draw();
+};
+
+#endif // ARKANOID_SPRITEBATCH_H
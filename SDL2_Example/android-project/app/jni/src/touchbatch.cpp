@@ -0,0 +1,51 @@
+//
+// The native side of SDLActivity.onNativeTouchBatch(): the moves of every
+// pointer of a MotionEvent, along with the samples Android batched into
+// it, arrive in one float array instead of a JNI call per pointer.  Each
+// sample goes through SDL's own onNativeTouch() handler, so SDL's finger
+// and mouse state, the mouse it emulates with the first finger down, and
+// the event filters and watchers all see it as they would otherwise.
+//
+
+#ifdef __ANDROID__
+
+#include <android/input.h>
+#include <jni.h>
+
+// SDL_android.c, in libSDL2
+extern "C" JNIEXPORT void JNICALL
+Java_org_libsdl_app_SDLActivity_onNativeTouch( JNIEnv *env, jclass cls, jint touchDevId,
+                                               jint pointerFingerId, jint action,
+                                               jfloat x, jfloat y, jfloat p );
+
+namespace
+{
+
+// Floats per sample, SDLSurface.TOUCH_SAMPLE_SIZE
+constexpr int sampleSize{ 4 };
+
+}
+
+extern "C" JNIEXPORT void JNICALL
+Java_org_libsdl_app_SDLActivity_onNativeTouchBatch( JNIEnv *env, jclass cls, jint touchDevId,
+                                                    jfloatArray samples, jint count )
+{
+    if (count <= 0)
+        return;
+
+    // Not a critical region, SDL's handler may call back into Java
+    jfloat *values = env->GetFloatArrayElements( samples, nullptr );
+    if (values == nullptr)
+        return;
+
+    for (jint i{ 0 }; i < count; ++i)
+    {
+        const jfloat *sample{ values + i * sampleSize };
+        Java_org_libsdl_app_SDLActivity_onNativeTouch( env, cls, touchDevId, (jint)sample[0],
+                                                       AMOTION_EVENT_ACTION_MOVE,
+                                                       sample[1], sample[2], sample[3] );
+    }
+    env->ReleaseFloatArrayElements( samples, values, JNI_ABORT );
+}
+
+#endif // __ANDROID__
@@ -0,0 +1,78 @@
+//
+// Sections for Android's systrace and Perfetto.  They're built in when
+// ARKANOID_TRACE is defined, see Android.mk, and are empty inline calls
+// otherwise.  The NDK only has ATrace from API level 23, so it's looked
+// up the first time a section begins.  A section ends on the thread it
+// began on, and sections nest.
+//
+
+#ifndef ARKANOID_TRACE_H
+#define ARKANOID_TRACE_H
+
+#if defined(ARKANOID_TRACE) && defined(__ANDROID__)
+#include <dlfcn.h>
+#endif
+
+namespace trace
+{
+
+#if defined(ARKANOID_TRACE) && defined(__ANDROID__)
+
+struct Functions
+{
+    void (*begin)( const char *name ){ nullptr };
+    void (*end)(){ nullptr };
+
+    Functions()
+    {
+        void *android( dlopen( "libandroid.so", RTLD_NOW | RTLD_LOCAL ) );
+        if (android == nullptr)
+            return;
+        auto mBegin( reinterpret_cast<void (*)( const char* )>(dlsym( android, "ATrace_beginSection" )) );
+        auto mEnd( reinterpret_cast<void (*)()>(dlsym( android, "ATrace_endSection" )) );
+        if (mBegin != nullptr && mEnd != nullptr)
+        {
+            begin = mBegin;
+            end = mEnd;
+        }
+    }
+};
+
+inline const Functions& functions()
+{
+    static const Functions loaded;
+    return loaded;
+}
+
+inline void begin( const char *name )
+{
+    if (functions().begin != nullptr)
+        functions().begin( name );
+}
+
+inline void end()
+{
+    if (functions().end != nullptr)
+        functions().end();
+}
+
+#else
+
+inline void begin( const char * ) {}
+inline void end() {}
+
+#endif
+
+// A section until it goes out of scope
+class Scope
+{
+public:
+    explicit Scope( const char *name ) { begin( name ); }
+    Scope( const Scope& ) = delete;
+    Scope& operator=( const Scope& ) = delete;
+    ~Scope() { end(); }
+};
+
+}
+
+#endif // ARKANOID_TRACE_H
@@ -3,6 +3,7 @@ package org.libsdl.app;
 import java.io.IOException;
 import java.io.InputStream;
 import java.util.Arrays;
+import java.util.ArrayList;
 import java.lang.reflect.Method;
 
 import android.app.*;
@@ -122,7 +123,21 @@ public class SDLActivity extends Activity {
      * @return arguments for the native application.
      */
     protected String[] getArguments() {
-        return new String[0];
+        // Input to record or replay for a profiling run, given as extras of
+        // the intent, e.g.
+        // adb shell am start -n org.libsdl.app/.SDLActivity --es replay /sdcard/run.arki
+        ArrayList<String> arguments = new ArrayList<String>();
+        Intent intent = getIntent();
+        if (intent != null) {
+            for (String option : new String[] { "record", "replay" }) {
+                String path = intent.getStringExtra(option);
+                if (path != null) {
+                    arguments.add("--" + option);
+                    arguments.add(path);
+                }
+            }
+        }
+        return arguments.toArray(new String[arguments.size()]);
     }
 
     public static void initialize() {
@@ -527,6 +542,11 @@ public class SDLActivity extends Activity {
     public static native void onNativeTouch(int touchDevId, int pointerFingerId,
                                             int action, float x,
                                             float y, float p);
+    // Moves of every pointer of a MotionEvent, TOUCH_SAMPLE_SIZE floats
+    // a sample, see SDLSurface.onTouch().  Only there if the app's own
+    // library has it, SDL's doesn't.
+    public static native void onNativeTouchBatch(int touchDevId, float[] samples,
+                                                 int count);
     public static native void onNativeAccel(float x, float y, float z);
     public static native void onNativeClipboardChanged();
     public static native void onNativeSurfaceChanged();
@@ -1107,6 +1127,13 @@ class SDLSurface extends SurfaceView implements SurfaceHolder.Callback,
     // Keep track of the surface size to normalize touch events
     protected static float mWidth, mHeight;
 
+    // A touch sample for onNativeTouchBatch() is the pointer id, x, y and
+    // the pressure
+    protected static final int TOUCH_SAMPLE_SIZE = 4;
+    protected float[] mTouchSamples = new float[0];
+    // Cleared the first time onNativeTouchBatch() turns out to be missing
+    protected static boolean mHaveTouchBatch = true;
+
     // Startup
     public SDLSurface(Context context) {
         super(context);
@@ -1351,17 +1378,47 @@ class SDLSurface extends SurfaceView implements SurfaceHolder.Callback,
         } else {
             switch(action) {
                 case MotionEvent.ACTION_MOVE:
-                    for (i = 0; i < pointerCount; i++) {
-                        pointerFingerId = event.getPointerId(i);
-                        x = event.getX(i) / mWidth;
-                        y = event.getY(i) / mHeight;
-                        p = event.getPressure(i);
-                        if (p > 1.0f) {
-                            // may be larger than 1.0f on some devices
-                            // see the documentation of getPressure(i)
-                            p = 1.0f;
+                    // Every pointer, with the samples batched into the event
+                    // since the last one, goes over in a single call
+                    final int historySize = event.getHistorySize();
+                    final int needed = (historySize + 1) * pointerCount * TOUCH_SAMPLE_SIZE;
+                    if (mTouchSamples.length < needed) {
+                        mTouchSamples = new float[needed];
+                    }
+                    int count = 0;
+                    for (int h = 0; h <= historySize; h++) {
+                        final boolean current = (h == historySize);
+                        for (i = 0; i < pointerCount; i++) {
+                            pointerFingerId = event.getPointerId(i);
+                            x = (current ? event.getX(i) : event.getHistoricalX(i, h)) / mWidth;
+                            y = (current ? event.getY(i) : event.getHistoricalY(i, h)) / mHeight;
+                            p = current ? event.getPressure(i) : event.getHistoricalPressure(i, h);
+                            if (p > 1.0f) {
+                                // may be larger than 1.0f on some devices
+                                // see the documentation of getPressure(i)
+                                p = 1.0f;
+                            }
+                            final int o = count * TOUCH_SAMPLE_SIZE;
+                            mTouchSamples[o] = pointerFingerId;
+                            mTouchSamples[o + 1] = x;
+                            mTouchSamples[o + 2] = y;
+                            mTouchSamples[o + 3] = p;
+                            count++;
+                        }
+                    }
+                    if (mHaveTouchBatch) {
+                        try {
+                            SDLActivity.onNativeTouchBatch(touchDevId, mTouchSamples, count);
+                            break;
+                        } catch (UnsatisfiedLinkError e) {
+                            mHaveTouchBatch = false;
                         }
-                        SDLActivity.onNativeTouch(touchDevId, pointerFingerId, action, x, y, p);
+                    }
+                    for (i = 0; i < count; i++) {
+                        final int o = i * TOUCH_SAMPLE_SIZE;
+                        SDLActivity.onNativeTouch(touchDevId, (int) mTouchSamples[o], action,
+                                                  mTouchSamples[o + 1], mTouchSamples[o + 2],
+                                                  mTouchSamples[o + 3]);
                     }
                     break;
 
@@ -1,6 +1,8 @@
 package org.libsdl.app;
 
+import android.content.Context;
 import android.media.*;
+import android.os.Build;
 import android.util.Log;
 
 public class SDLAudioManager
@@ -54,6 +56,36 @@ public class SDLAudioManager
         return 0;
     }
 
+    /**
+     * This method is called by SDL_mixer using JNI.
+     * Returns the sample rate the device mixes its output at, or 0 if it doesn't say.
+     */
+    public static int getOutputSampleRate() {
+        return getOutputProperty("android.media.property.OUTPUT_SAMPLE_RATE");
+    }
+
+    /**
+     * This method is called by SDL_mixer using JNI.
+     * Returns the device's output burst in frames, or 0 if it doesn't say.
+     */
+    public static int getOutputFramesPerBuffer() {
+        return getOutputProperty("android.media.property.OUTPUT_FRAMES_PER_BUFFER");
+    }
+
+    protected static int getOutputProperty(String property) {
+        // AudioManager.getProperty() is API level 17
+        if (Build.VERSION.SDK_INT < 17 || SDL.getContext() == null) {
+            return 0;
+        }
+        try {
+            AudioManager audioManager = (AudioManager) SDL.getContext().getSystemService(Context.AUDIO_SERVICE);
+            String value = (String) audioManager.getClass().getMethod("getProperty", String.class).invoke(audioManager, property);
+            return value != null ? Integer.parseInt(value) : 0;
+        } catch(Exception e) {
+            return 0;
+        }
+    }
+
     /**
      * This method is called by SDL using JNI.
      */